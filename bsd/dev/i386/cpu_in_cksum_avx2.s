@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * AVX2 kernels for the 16-bit 1's complement sum (RFC 1071).
+ *
+ * Both routines treat the buffer as a stream of 32-bit little-endian
+ * words and add each one into a 64-bit lane, so no carry is ever lost
+ * and no end-around carry is needed inside the loop; the lanes are
+ * added together and folded to 33 bits on the way out.  The caller
+ * adds the result to its own 32-bit word accumulator, which means the
+ * result is valid for any alignment of the data pointer as long as the
+ * stream offset (not the address) is even.
+ *
+ * The caller must have checked for AVX2 (kHasAVX2_0) and must pass a
+ * length that is a multiple of 64 bytes.
+ *
+ *  uint64_t os_cpu_in_cksum_avx2(const void *data, uint32_t len);
+ *  uint64_t os_cpu_copy_in_cksum_avx2(const void *src, void *dst,
+ *      uint32_t len);
+ *
+ * This file is also assembled into the in_cksum unit test.
+ */
+
+#if defined(__x86_64__)
+
+	.text
+	.align	4
+	.globl	_os_cpu_in_cksum_avx2
+_os_cpu_in_cksum_avx2:
+	push	%rbp
+	mov	%rsp, %rbp
+	vpxor	%ymm0, %ymm0, %ymm0		/* lane sums, low dwords */
+	vpxor	%ymm1, %ymm1, %ymm1		/* lane sums, high dwords */
+	vpxor	%ymm5, %ymm5, %ymm5		/* zero for the unpacks */
+	mov	%esi, %ecx
+	shr	$6, %ecx			/* 64-byte blocks */
+	jz	L_sum_reduce
+L_sum_loop:
+	vmovdqu	(%rdi), %ymm2
+	vmovdqu	32(%rdi), %ymm3
+	prefetcht0 256(%rdi)
+	vpunpckldq %ymm5, %ymm2, %ymm4		/* dwords 0,1,4,5 -> qwords */
+	vpunpckhdq %ymm5, %ymm2, %ymm2		/* dwords 2,3,6,7 -> qwords */
+	vpaddq	%ymm4, %ymm0, %ymm0
+	vpaddq	%ymm2, %ymm1, %ymm1
+	vpunpckldq %ymm5, %ymm3, %ymm4
+	vpunpckhdq %ymm5, %ymm3, %ymm3
+	vpaddq	%ymm4, %ymm0, %ymm0
+	vpaddq	%ymm3, %ymm1, %ymm1
+	add	$64, %rdi
+	dec	%ecx
+	jnz	L_sum_loop
+L_sum_reduce:
+	vpaddq	%ymm1, %ymm0, %ymm0
+	vextracti128 $1, %ymm0, %xmm1
+	vpaddq	%xmm1, %xmm0, %xmm0
+	vpshufd	$0x4e, %xmm0, %xmm1		/* swap the two qwords */
+	vpaddq	%xmm1, %xmm0, %xmm0
+	vmovq	%xmm0, %rax
+	vzeroupper
+	mov	%rax, %rdx			/* fold 64 -> 33 bits */
+	shr	$32, %rdx
+	mov	%eax, %eax
+	add	%rdx, %rax
+	pop	%rbp
+	ret
+
+	.align	4
+	.globl	_os_cpu_copy_in_cksum_avx2
+_os_cpu_copy_in_cksum_avx2:
+	push	%rbp
+	mov	%rsp, %rbp
+	vpxor	%ymm0, %ymm0, %ymm0
+	vpxor	%ymm1, %ymm1, %ymm1
+	vpxor	%ymm5, %ymm5, %ymm5
+	mov	%edx, %ecx
+	shr	$6, %ecx
+	jz	L_copy_reduce
+L_copy_loop:
+	vmovdqu	(%rdi), %ymm2
+	vmovdqu	32(%rdi), %ymm3
+	prefetcht0 256(%rdi)
+	vmovdqu	%ymm2, (%rsi)
+	vmovdqu	%ymm3, 32(%rsi)
+	vpunpckldq %ymm5, %ymm2, %ymm4
+	vpunpckhdq %ymm5, %ymm2, %ymm2
+	vpaddq	%ymm4, %ymm0, %ymm0
+	vpaddq	%ymm2, %ymm1, %ymm1
+	vpunpckldq %ymm5, %ymm3, %ymm4
+	vpunpckhdq %ymm5, %ymm3, %ymm3
+	vpaddq	%ymm4, %ymm0, %ymm0
+	vpaddq	%ymm3, %ymm1, %ymm1
+	add	$64, %rdi
+	add	$64, %rsi
+	dec	%ecx
+	jnz	L_copy_loop
+L_copy_reduce:
+	vpaddq	%ymm1, %ymm0, %ymm0
+	vextracti128 $1, %ymm0, %xmm1
+	vpaddq	%xmm1, %xmm0, %xmm0
+	vpshufd	$0x4e, %xmm0, %xmm1
+	vpaddq	%xmm1, %xmm0, %xmm0
+	vmovq	%xmm0, %rax
+	vzeroupper
+	mov	%rax, %rdx
+	shr	$32, %rdx
+	mov	%eax, %eax
+	add	%rdx, %rax
+	pop	%rbp
+	ret
+
+#endif /* __x86_64__ */
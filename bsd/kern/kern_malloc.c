@@ -422,4 +422,30 @@ SYSCTL_PROC(_kern, OID_AUTO, zone_alloc_replenish_test,
     CTLTYPE_INT | CTLFLAG_MASKED | CTLFLAG_LOCKED | CTLFLAG_WR,
     0, 0, &sysctl_zone_alloc_replenish_test, "I", "Test zone alloc replenish");
 
+extern size_t zone_cache_stats_size(void);
+extern size_t zone_cache_stats_print(char *buf, size_t size);
+
+static int
+sysctl_zone_cache_stats SYSCTL_HANDLER_ARGS
+{
+#pragma unused(oidp, arg1, arg2)
+	size_t size = zone_cache_stats_size();
+	size_t len;
+	char *buf;
+	int error;
+
+	buf = kheap_alloc(KHEAP_TEMP, size, Z_WAITOK | Z_ZERO);
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+	len = zone_cache_stats_print(buf, size);
+	error = SYSCTL_OUT(req, buf, len + 1);
+	kheap_free(KHEAP_TEMP, buf, size);
+	return error;
+}
+
+SYSCTL_PROC(_kern, OID_AUTO, zone_cache_stats,
+    CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MASKED | CTLFLAG_LOCKED,
+    0, 0, &sysctl_zone_cache_stats, "A", "Magazine sizes, contention and GC counters of the cached zones");
+
 #endif /* DEBUG || DEVELOPMENT */
@@ -1160,6 +1160,22 @@ SYSCTL_PROC(_kern, OID_AUTO, memorystatus_disconnect_page_mappings, CTLTYPE_INT
 
 #endif /* DEVELOPMENT || DEBUG */
 
+/*
+ * The footprint its ledger has now, in pages.  Sorting a bucket reads it
+ * once per process into p_memstat_footprint_pages rather than once per
+ * comparison.
+ */
+static uint32_t
+memorystatus_footprint_pages(proc_t p)
+{
+	uint32_t pages = 0;
+
+	if (p->task != TASK_NULL) {
+		memorystatus_get_task_page_counts(p->task, &pages, NULL, NULL);
+	}
+	return pages;
+}
+
 /*
  * Sorts the given bucket.
  *
@@ -1243,6 +1259,8 @@ memorystatus_sort_bucket(unsigned int bucket_index, int sort_order)
 
 /*
  * Sort processes by size for a single jetsam bucket.
+ *
+ * Reads each footprint once, then sorts by the footprints it read.
  */
 
 static void
@@ -1250,7 +1268,7 @@ memorystatus_sort_by_largest_process_locked(unsigned int bucket_index)
 {
 	proc_t p = NULL, insert_after_proc = NULL, max_proc = NULL;
 	proc_t next_p = NULL, prev_max_proc = NULL;
-	uint32_t pages = 0, max_pages = 0;
+	uint32_t max_pages = 0;
 	memstat_bucket_t *current_bucket;
 
 	if (bucket_index >= MEMSTAT_BUCKET_COUNT) {
@@ -1259,20 +1277,22 @@ memorystatus_sort_by_largest_process_locked(unsigned int bucket_index)
 
 	current_bucket = &memstat_bucket[bucket_index];
 
+	TAILQ_FOREACH(p, &current_bucket->list, p_memstat_list) {
+		p->p_memstat_footprint_pages = memorystatus_footprint_pages(p);
+	}
+
 	p = TAILQ_FIRST(&current_bucket->list);
 
 	while (p) {
-		memorystatus_get_task_page_counts(p->task, &pages, NULL, NULL);
-		max_pages = pages;
+		max_pages = p->p_memstat_footprint_pages;
 		max_proc = p;
 		prev_max_proc = p;
 
 		while ((next_p = TAILQ_NEXT(p, p_memstat_list)) != NULL) {
 			/* traversing list until we find next largest process */
 			p = next_p;
-			memorystatus_get_task_page_counts(p->task, &pages, NULL, NULL);
-			if (pages > max_pages) {
-				max_pages = pages;
+			if (p->p_memstat_footprint_pages > max_pages) {
+				max_pages = p->p_memstat_footprint_pages;
 				max_proc = p;
 			}
 		}
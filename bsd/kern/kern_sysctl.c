@@ -4204,6 +4204,18 @@ extern uint32_t phantom_cache_thrashing_threshold_ssd;
 SYSCTL_INT(_vm, OID_AUTO, phantom_cache_eval_period_in_msecs, CTLFLAG_RW | CTLFLAG_LOCKED, &phantom_cache_eval_period_in_msecs, 0, "");
 SYSCTL_INT(_vm, OID_AUTO, phantom_cache_thrashing_threshold, CTLFLAG_RW | CTLFLAG_LOCKED, &phantom_cache_thrashing_threshold, 0, "");
 SYSCTL_INT(_vm, OID_AUTO, phantom_cache_thrashing_threshold_ssd, CTLFLAG_RW | CTLFLAG_LOCKED, &phantom_cache_thrashing_threshold_ssd, 0, "");
+
+extern uint32_t phantom_cache_balance_min_refaults;
+extern uint64_t vm_phantom_cache_refault_file;
+extern uint64_t vm_phantom_cache_refault_anon;
+extern uint64_t vm_phantom_cache_workingset_file;
+extern uint64_t vm_phantom_cache_workingset_anon;
+
+SYSCTL_UINT(_vm, OID_AUTO, phantom_cache_balance_min_refaults, CTLFLAG_RW | CTLFLAG_LOCKED, &phantom_cache_balance_min_refaults, 0, "");
+SYSCTL_QUAD(_vm, OID_AUTO, refault_file, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_phantom_cache_refault_file, "");
+SYSCTL_QUAD(_vm, OID_AUTO, refault_anon, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_phantom_cache_refault_anon, "");
+SYSCTL_QUAD(_vm, OID_AUTO, workingset_refault_file, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_phantom_cache_workingset_file, "");
+SYSCTL_QUAD(_vm, OID_AUTO, workingset_refault_anon, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_phantom_cache_workingset_anon, "");
 #endif
 
 #if CONFIG_BACKGROUND_QUEUE
@@ -876,3 +876,53 @@ m_sum16(struct mbuf *m, uint32_t off, uint32_t len)
 
 	return (uint16_t)os_cpu_in_cksum_mbuf(m, len, off, 0);
 }
+
+/*
+ * Copy len bytes at offset off from the mbuf chain into the buffer at
+ * vp, returning the same 16-bit 1's complement sum that m_sum16() would
+ * for that span.  The sum is computed as the data is copied, which saves
+ * a second pass for drivers that copy received frames without hardware
+ * checksum offload.
+ */
+uint16_t
+m_copydata_sum(struct mbuf *m, uint32_t off, uint32_t len, void *vp)
+{
+	uint8_t *cp = vp;
+	uint32_t sum = 0, done = 0;
+	int mlen;
+
+	if ((mlen = m_length2(m, NULL)) < (off + len)) {
+		panic("%s: mbuf %p len (%d) < off+len (%d+%d)\n", __func__,
+		    m, mlen, off, len);
+		/* NOTREACHED */
+	}
+
+	while (off >= (uint32_t)m->m_len) {
+		off -= m->m_len;
+		if (len == 0) {
+			return 0;
+		}
+		m = m->m_next;
+	}
+	while (len > 0) {
+		uint32_t count = MIN((uint32_t)m->m_len - off, len);
+		uint32_t psum;
+
+		psum = os_cpu_copy_in_cksum(mtod(m, uint8_t *) + off, cp,
+		    count, 0);
+		/* a span starting at an odd offset contributes swapped */
+		if (done & 1) {
+			psum = ((psum & 0xff) << 8) | (psum >> 8);
+		}
+		sum += psum;
+		cp += count;
+		done += count;
+		len -= count;
+		off = 0;
+		m = m->m_next;
+	}
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum = (sum >> 16) + (sum & 0xffff);
+
+	return (uint16_t)sum;
+}
@@ -2111,6 +2111,8 @@ sosend(struct socket *so, struct sockaddr *addr, struct uio *uio,
 	int sblocked = 0;
 	struct proc *p = current_proc();
 	uint16_t headroom = 0;
+	uint32_t dsum;
+	boolean_t csum_copy;
 	boolean_t en_tracing = FALSE;
 
 	if (uio != NULL) {
@@ -2248,6 +2250,21 @@ sosend(struct socket *so, struct sockaddr *addr, struct uio *uio,
 				    sosendjcl_ignore_capab) &&
 				    bigcl;
 
+				/*
+				 * For datagrams the whole payload is copied
+				 * in here in one go; sum each mbuf right after
+				 * its copy, while the data is still in cache,
+				 * so that the protocol does not have to make
+				 * another pass over it.  Filters may rewrite
+				 * the payload, so skip this when any are
+				 * attached.
+				 */
+				csum_copy = atomic && top == NULL &&
+				    (so->so_proto->pr_flags & PR_CSUM_COPY) &&
+				    so->so_filt == NULL &&
+				    !(so->so_flags & SOF_CONTENT_FILTER);
+				dsum = 0;
+
 				socket_unlock(so, 0);
 
 				do {
@@ -2429,6 +2446,18 @@ sosend(struct socket *so, struct sockaddr *addr, struct uio *uio,
 					if (error) {
 						break;
 					}
+					if (csum_copy) {
+						uint32_t psum;
+
+						psum = b_sum16(mtod(m, void *),
+						    len);
+						/* mbuf starting at an odd offset */
+						if ((top->m_pkthdr.len - len) & 1) {
+							psum = ((psum & 0xff) << 8) |
+							    (psum >> 8);
+						}
+						dsum += psum;
+					}
 					mp = &m->m_next;
 					if (resid <= 0) {
 						if (flags & MSG_EOR) {
@@ -2446,6 +2475,13 @@ sosend(struct socket *so, struct sockaddr *addr, struct uio *uio,
 				if (error) {
 					goto out_locked;
 				}
+				if (csum_copy) {
+					dsum = (dsum >> 16) + (dsum & 0xffff);
+					dsum = (dsum >> 16) + (dsum & 0xffff);
+					top->m_pkthdr.csum_tx_dsum = dsum;
+					top->m_pkthdr.csum_flags |=
+					    CSUM_TX_DSUM_VALID;
+				}
 			}
 
 			if (dontroute) {
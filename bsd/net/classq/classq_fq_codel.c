@@ -144,7 +144,6 @@ fq_head_drop(fq_if_t *fqs, fq_t *fq)
 	pktsched_pkt_t pkt;
 	volatile uint32_t *pkt_flags;
 	uint64_t *pkt_timestamp;
-	struct ifclassq *ifq = fqs->fqs_ifq;
 
 	_PKTSCHED_PKT_INIT(&pkt);
 	fq_getq_flow_internal(fqs, fq, &pkt);
@@ -166,8 +165,8 @@ fq_head_drop(fq_if_t *fqs, fq_t *fq)
 		__builtin_unreachable();
 	}
 
-	IFCQ_DROP_ADD(ifq, 1, pktsched_get_pkt_len(&pkt));
-	IFCQ_CONVERT_LOCK(ifq);
+	FQ_IF_DROP_ADD(fqs, 1, pktsched_get_pkt_len(&pkt));
+	FQS_CONVERT_LOCK(fqs);
 	pktsched_free_pkt(&pkt);
 }
 
@@ -181,7 +180,6 @@ fq_compressor(fq_if_t *fqs, fq_t *fq, fq_if_classq_t *fq_cl,
 	uint64_t *pkt_timestamp;
 	uint64_t old_timestamp = 0;
 	uint32_t old_pktlen = 0;
-	struct ifclassq *ifq = fqs->fqs_ifq;
 
 	if (__improbable(!tcp_do_ack_compression)) {
 		return 0;
@@ -212,15 +210,14 @@ fq_compressor(fq_if_t *fqs, fq_t *fq, fq_if_classq_t *fq_cl,
 		old_pktlen = m_pktlen(m);
 		old_timestamp = m->m_pkthdr.pkt_timestamp;
 
-		IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+		FQS_CONVERT_LOCK(fqs);
 		m_freem(m);
 	}
 
 	fq->fq_bytes -= old_pktlen;
 	fq_cl->fcl_stat.fcl_byte_cnt -= old_pktlen;
 	fq_cl->fcl_stat.fcl_pkt_cnt--;
-	IFCQ_DEC_LEN(ifq);
-	IFCQ_DEC_BYTES(ifq, old_pktlen);
+	FQ_IF_SUB_LEN(fqs, 1, old_pktlen);
 
 	*pkt_timestamp = old_timestamp;
 
@@ -454,7 +451,6 @@ fq_getq_flow_internal(fq_if_t *fqs, fq_t *fq, pktsched_pkt_t *pkt)
 	classq_pkt_t p = CLASSQ_PKT_INITIALIZER(p);
 	uint32_t plen;
 	fq_if_classq_t *fq_cl;
-	struct ifclassq *ifq = fqs->fqs_ifq;
 
 	fq_dequeue(fq, &p);
 	if (p.cp_ptype == QP_INVALID) {
@@ -471,8 +467,7 @@ fq_getq_flow_internal(fq_if_t *fqs, fq_t *fq, pktsched_pkt_t *pkt)
 	fq_cl = &fqs->fqs_classq[fq->fq_sc_index];
 	fq_cl->fcl_stat.fcl_byte_cnt -= plen;
 	fq_cl->fcl_stat.fcl_pkt_cnt--;
-	IFCQ_DEC_LEN(ifq);
-	IFCQ_DEC_BYTES(ifq, plen);
+	FQ_IF_SUB_LEN(fqs, 1, plen);
 
 	/* Reset getqtime so that we don't count idle times */
 	if (fq_empty(fq)) {
@@ -90,6 +90,48 @@ typedef struct flowq {
 	}                                                               \
 } while (0)
 
+/*
+ * Queue length accounting.  A single-queue instance runs under the ifclassq
+ * lock and updates the ifclassq counters directly; instances of a
+ * multi-queue set only hold their own lock, so the shared ifclassq
+ * counters are updated atomically.
+ */
+#define FQ_IF_ADD_LEN(_fqs, _cnt, _bytes) do {                          \
+	struct ifclassq *__ifq = (_fqs)->fqs_ifq;                       \
+	(_fqs)->fqs_len += (_cnt);                                      \
+	(_fqs)->fqs_bytes += (_bytes);                                  \
+	if (FQS_IS_MULTIQ(_fqs)) {                                      \
+	        atomic_add_32(&IFCQ_LEN(__ifq), (_cnt));                \
+	        atomic_add_32(&IFCQ_BYTES(__ifq), (_bytes));            \
+	} else {                                                        \
+	        IFCQ_ADD_LEN(__ifq, (_cnt));                            \
+	        IFCQ_INC_BYTES(__ifq, (_bytes));                        \
+	}                                                               \
+} while (0)
+
+#define FQ_IF_SUB_LEN(_fqs, _cnt, _bytes) do {                          \
+	struct ifclassq *__ifq = (_fqs)->fqs_ifq;                       \
+	(_fqs)->fqs_len -= (_cnt);                                      \
+	(_fqs)->fqs_bytes -= (_bytes);                                  \
+	if (FQS_IS_MULTIQ(_fqs)) {                                      \
+	        atomic_add_32(&IFCQ_LEN(__ifq), -(int32_t)(_cnt));      \
+	        atomic_add_32(&IFCQ_BYTES(__ifq), -(int32_t)(_bytes));  \
+	} else {                                                        \
+	        IFCQ_SUB_LEN(__ifq, (_cnt));                            \
+	        IFCQ_DEC_BYTES(__ifq, (_bytes));                        \
+	}                                                               \
+} while (0)
+
+#define FQ_IF_DROP_ADD(_fqs, _pkt, _len) do {                           \
+	struct ifclassq *__ifq = (_fqs)->fqs_ifq;                       \
+	if (FQS_IS_MULTIQ(_fqs)) {                                      \
+	        atomic_add_64(&__ifq->ifcq_dropcnt.packets, (_pkt));    \
+	        atomic_add_64(&__ifq->ifcq_dropcnt.bytes, (_len));      \
+	} else {                                                        \
+	        IFCQ_DROP_ADD(__ifq, (_pkt), (_len));                   \
+	}                                                               \
+} while (0)
+
 struct fq_codel_sched_data;
 struct fq_if_classq;
 
@@ -80,6 +80,9 @@
 #include <net/net_api_stats.h>
 #include <net/if_ports_used.h>
 #include <net/if_vlan_var.h>
+#if IF_BRIDGE
+#include <net/if_bridgevar.h>
+#endif /* IF_BRIDGE */
 #include <netinet/in.h>
 #if INET
 #include <netinet/in_var.h>
@@ -414,6 +417,7 @@ static errno_t dlil_clat46(ifnet_t, protocol_family_t *, mbuf_t *);
 static errno_t dlil_clat64(ifnet_t, protocol_family_t *, mbuf_t *);
 #if DEBUG || DEVELOPMENT
 static void dlil_verify_sum16(void);
+static void dlil_verify_sum16_chain(void);
 #endif /* DEBUG || DEVELOPMENT */
 static void dlil_output_cksum_dbg(struct ifnet *, struct mbuf *, uint32_t,
     protocol_family_t);
@@ -1786,6 +1790,7 @@ dlil_init(void)
 #if DEBUG || DEVELOPMENT
 	/* Run self-tests */
 	dlil_verify_sum16();
+	dlil_verify_sum16_chain();
 #endif /* DEBUG || DEVELOPMENT */
 
 	/* Initialize link layer table */
@@ -4468,6 +4473,8 @@ dlil_interface_filters_output(struct ifnet *ifp, struct mbuf **m_p,
 		    filter->filt_protocol == protocol_family)) {
 			lck_mtx_unlock(&ifp->if_flt_lock);
 
+			/* the filter may rewrite the payload */
+			(*m_p)->m_pkthdr.csum_flags &= ~CSUM_TX_DSUM_VALID;
 			result = filter->filt_output(filter->filt_cookie, ifp,
 			    protocol_family, m_p);
 
@@ -4915,6 +4922,10 @@ next:
 		if (iorefcnt == 1) {
 			/* If the next mbuf is on a different interface, unlock data-mov */
 			if (!m || (ifp != ifp_param && ifp != m->m_pkthdr.rcvif)) {
+#if IF_BRIDGE
+				/* send what the bridge batched from this run */
+				bridge_input_flush();
+#endif /* IF_BRIDGE */
 				ifnet_datamov_end(ifp);
 				iorefcnt = 0;
 			}
@@ -10476,6 +10487,254 @@ dlil_verify_sum16(void)
 
 	kprintf("PASSED\n");
 }
+
+/*
+ * Segment lengths for the chain tests; the last segment takes whatever
+ * is left.  Odd lengths put the segment boundaries at odd offsets, and
+ * the long segments take the vector paths of os_cpu_in_cksum_mbuf().
+ */
+#define SUMCHAIN_LEN    1500
+#define SUMCHAIN_SEGS   6
+static const uint16_t sumchain_segs[][SUMCHAIN_SEGS] = {
+	{ SUMCHAIN_LEN, 0, 0, 0, 0, 0 },
+	{ 1, 300, 3, 513, 257, 0 },
+	{ 255, 1, 1, 700, 0, 0 },
+	{ 7, 1024, 0, 0, 0, 0 },
+	{ 28, 1, 257, 2, 511, 0 },
+	{ 28, 299, 1, 1, 1, 0 },
+	{ 28, 0, 0, 0, 0, 0 },
+};
+#define SUMCHAIN_MAX    \
+	((int)sizeof (sumchain_segs) / (int)sizeof (sumchain_segs[0]))
+
+/*
+ * Build an mbuf chain holding len bytes of src, split per segs[]; the
+ * data of every mbuf starts align bytes into its cluster.
+ */
+static struct mbuf *
+dlil_sum16_chain(const uint8_t *src, uint32_t len, const uint16_t *segs,
+    int align)
+{
+	struct mbuf *top = NULL, **mp = &top;
+	uint32_t done = 0;
+	int i;
+
+	for (i = 0; done < len; i++) {
+		uint32_t count = len - done;
+		struct mbuf *m;
+
+		if (i < SUMCHAIN_SEGS && segs[i] != 0 && segs[i] < count) {
+			count = segs[i];
+		}
+		m = m_getcl(M_WAITOK, MT_DATA, (top == NULL) ? M_PKTHDR : 0);
+		m->m_data += align;
+		bcopy(src + done, mtod(m, void *), count);
+		m->m_len = (int32_t)count;
+		done += count;
+		*mp = m;
+		mp = &m->m_next;
+	}
+	top->m_pkthdr.len = len;
+
+	return top;
+}
+
+#if INET
+/*
+ * Sum the payload past the first mbuf the way sosend() does while
+ * copying it in, then let in_finalize_cksum() complete the UDP checksum
+ * from that sum.  Returns the checksum stored in the packet, which must
+ * match what the full software pass computes for the same chain.
+ */
+static uint16_t
+dlil_sum16_udp(const uint8_t *pkt, uint32_t len, const uint16_t *segs,
+    int align, boolean_t dsum_valid)
+{
+	struct mbuf *top, *m;
+	uint32_t dsum = 0, done = 0;
+	uint16_t csum, sumr;
+
+	top = dlil_sum16_chain(pkt, len, segs, align);
+	for (m = top->m_next; m != NULL; m = m->m_next) {
+		uint32_t psum;
+
+		psum = b_sum16(mtod(m, void *), m->m_len);
+		/* a span starting at an odd offset contributes swapped */
+		if (done & 1) {
+			psum = ((psum & 0xff) << 8) | (psum >> 8);
+		}
+		dsum += psum;
+		done += (uint32_t)m->m_len;
+	}
+	dsum = (dsum >> 16) + (dsum & 0xffff);
+	dsum = (dsum >> 16) + (dsum & 0xffff);
+
+	sumr = (uint16_t)in_cksum_mbuf_ref(top->m_next, (int)done, 0, 0);
+	if (dsum != sumr) {
+		panic_plain("\n%s: broken copy-in sum for len=%u align=%d "
+		    "sum=0x%04x [expected=0x%04x]\n", __func__, done, align,
+		    dsum, sumr);
+		/* NOTREACHED */
+	}
+
+	top->m_pkthdr.csum_flags = CSUM_UDP | CSUM_ZERO_INVERT;
+	top->m_pkthdr.csum_data = offsetof(struct udphdr, uh_sum);
+	if (dsum_valid) {
+		top->m_pkthdr.csum_flags |= CSUM_TX_DSUM_VALID;
+		top->m_pkthdr.csum_tx_dsum = dsum;
+	}
+	(void) in_finalize_cksum(top, 0, CSUM_DELAY_DATA);
+	m_copydata(top, sizeof(struct ip) + offsetof(struct udphdr, uh_sum),
+	    sizeof(csum), (caddr_t)&csum);
+	m_freem(top);
+
+	return csum;
+}
+#endif /* INET */
+
+static void
+dlil_verify_sum16_chain(void)
+{
+	struct mbuf *sm, *cm, *m;
+	uint8_t *src, *cbuf;
+	int n, i;
+
+	_CASSERT(SUMCHAIN_LEN + sizeof(uint64_t) <= MCLBYTES);
+
+	kprintf("DLIL: running SUM16 chain self-tests ... ");
+
+	/* Test data: the sum16 blob, perturbed on each repetition */
+	sm = m_getcl(M_WAITOK, MT_DATA, M_PKTHDR);
+	src = mtod(sm, uint8_t *);
+	for (i = 0; i < SUMCHAIN_LEN; i++) {
+		src[i] = sumdata[(size_t)i % sizeof(sumdata)] ^
+		    (uint8_t)((size_t)i / sizeof(sumdata));
+	}
+	/* Copy-out buffer for m_copydata_sum() */
+	cm = m_getcl(M_WAITOK, MT_DATA, M_PKTHDR);
+	cbuf = mtod(cm, uint8_t *);
+
+	for (n = 0; n < SUMCHAIN_MAX; n++) {
+		/* Verify for all possible alignments of each segment */
+		for (i = 0; i < (int)sizeof(uint64_t); i++) {
+			uint32_t off;
+
+			m = dlil_sum16_chain(src, SUMCHAIN_LEN,
+			    sumchain_segs[n], i);
+
+			/* Spans at even and odd offsets into the chain */
+			for (off = 0; off < 4; off++) {
+				uint32_t len = SUMCHAIN_LEN - off;
+				uint16_t sum, sumr;
+
+				sumr = (uint16_t)in_cksum_mbuf_ref(m, (int)len,
+				    (int)off, 0);
+				sum = m_sum16(m, off, len);
+
+				/* Something is horribly broken; stop now */
+				if (sum != sumr) {
+					panic_plain("\n%s: broken m_sum16() "
+					    "for chain=%d align=%d offset=%u "
+					    "sum=0x%04x [expected=0x%04x]\n",
+					    __func__, n, i, off, sum, sumr);
+					/* NOTREACHED */
+				}
+
+				sum = m_copydata_sum(m, off, len, cbuf);
+				if (sum != sumr) {
+					panic_plain("\n%s: broken "
+					    "m_copydata_sum() for chain=%d "
+					    "align=%d offset=%u sum=0x%04x "
+					    "[expected=0x%04x]\n", __func__,
+					    n, i, off, sum, sumr);
+					/* NOTREACHED */
+				} else if (bcmp(cbuf, src + off, len) != 0) {
+					panic_plain("\n%s: broken "
+					    "m_copydata_sum() copy for "
+					    "chain=%d align=%d offset=%u\n",
+					    __func__, n, i, off);
+					/* NOTREACHED */
+				}
+			}
+			m_freem(m);
+		}
+	}
+
+#if INET
+	{
+		struct ip *ip = (struct ip *)(void *)src;
+		struct udphdr *uh = (struct udphdr *)(void *)(ip + 1);
+		uint16_t ulen = (uint16_t)(SUMCHAIN_LEN - sizeof(*ip));
+		uint16_t fix = 0;
+		int pass;
+
+		/*
+		 * Lay an IPv4/UDP header over the test data, as udp_output()
+		 * leaves it for in_finalize_cksum().  The chains that start
+		 * with a 28 byte segment keep the header in its own mbuf,
+		 * like the header sosend() leaves room for.
+		 */
+		bzero(ip, sizeof(*ip) + sizeof(*uh));
+		ip->ip_vhl = IP_VHL_BORING;
+		ip->ip_len = htons(SUMCHAIN_LEN);
+		ip->ip_ttl = 64;
+		ip->ip_p = IPPROTO_UDP;
+		ip->ip_src.s_addr = htonl(0xc0a80001);
+		ip->ip_dst.s_addr = htonl(0xc0a800fe);
+		uh->uh_sport = htons(5353);
+		uh->uh_dport = htons(5353);
+		uh->uh_ulen = htons(ulen);
+
+		/*
+		 * The second pass stores the first pass's checksum in the
+		 * first payload word, which brings the checksum to zero;
+		 * RFC 768 has it sent as 0xffff.
+		 */
+		for (pass = 0; pass < 2; pass++) {
+			uint16_t *pw = (uint16_t *)(void *)(uh + 1);
+
+			*pw = fix;
+			for (n = 0; n < SUMCHAIN_MAX; n++) {
+				/* sosend() sums only what follows the header */
+				if (sumchain_segs[n][0] !=
+				    sizeof(*ip) + sizeof(*uh)) {
+					continue;
+				}
+				for (i = 0; i < (int)sizeof(uint64_t); i++) {
+					uint16_t sum, sumr;
+
+					uh->uh_sum = in_pseudo(ip->ip_src.s_addr,
+					    ip->ip_dst.s_addr,
+					    htons((uint16_t)(ulen + IPPROTO_UDP)));
+					sumr = dlil_sum16_udp(src, SUMCHAIN_LEN,
+					    sumchain_segs[n], i, FALSE);
+					sum = dlil_sum16_udp(src, SUMCHAIN_LEN,
+					    sumchain_segs[n], i, TRUE);
+
+					/* Something is horribly broken */
+					if (sum != sumr ||
+					    (pass == 1 && sum != 0xffff)) {
+						panic_plain("\n%s: broken UDP "
+						    "copy-in csum for chain=%d "
+						    "align=%d pass=%d "
+						    "csum=0x%04x "
+						    "[expected=0x%04x]\n",
+						    __func__, n, i, pass, sum,
+						    pass ? 0xffff : sumr);
+						/* NOTREACHED */
+					}
+					fix = sumr;
+				}
+			}
+		}
+	}
+#endif /* INET */
+
+	m_freem(cm);
+	m_freem(sm);
+
+	kprintf("PASSED\n");
+}
 #endif /* DEBUG || DEVELOPMENT */
 
 #define CASE_STRINGIFY(x) case x: return #x
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Multibit forwarding trie; see fib_trie.h for the overview.
+ *
+ * Every slot carries, on the writer side only, the length of the prefix
+ * that produced its value.  An insertion of a /p overwrites the slots in
+ * its range whose prefix length is <= p; a deletion of a /p hands the
+ * slots whose prefix length is exactly p to the next shorter covering
+ * prefix, which the caller looks up in its authoritative table.  Chunks
+ * that end up holding nothing more specific than their parent slot are
+ * folded back into it.
+ */
+
+#ifdef KERNEL
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/errno.h>
+#include <kern/kalloc.h>
+#include <net/fib_trie.h>
+
+#define FIB_ALLOC(_size)                                                \
+	kheap_alloc(KHEAP_DEFAULT, _size, Z_WAITOK | Z_ZERO)
+#define FIB_FREE(_p, _size)                                             \
+	kheap_free(KHEAP_DEFAULT, _p, _size)
+#else /* !KERNEL */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fib_trie.h"
+
+#define FIB_ALLOC(_size)        calloc(1, _size)
+#define FIB_FREE(_p, _size)     ((void)(_size), free(_p))
+#endif /* !KERNEL */
+
+#define FIB_DIR_INITIAL         256     /* initial # of chunk indices */
+
+struct fib_update {
+	unsigned int    fu_plen;        /* length of the prefix being changed */
+	uint32_t        fu_value;       /* new value, or replacement value */
+	unsigned int    fu_repl_plen;   /* replacement prefix length (delete) */
+	int             fu_delete;
+};
+
+static inline unsigned int
+fib_slot_index(const uint8_t *key, unsigned int base, unsigned int bits)
+{
+	if (bits == FIB_ROOT_BITS) {
+		return (key[0] << 8) | key[1];
+	}
+	return key[base / 8];
+}
+
+static inline size_t
+fib_dir_size(uint32_t n)
+{
+	return sizeof(struct fib_dir) + n * sizeof(struct fib_chunk *);
+}
+
+static struct fib_dir *
+fib_dir_alloc(uint32_t n)
+{
+	struct fib_dir *fd;
+
+	fd = FIB_ALLOC(fib_dir_size(n));
+	if (fd != NULL) {
+		fd->fd_size = n;
+	}
+	return fd;
+}
+
+static inline struct fib_chunk *
+fib_chunk_get(const struct fib_trie *ft, uint32_t slot)
+{
+	return ft->ft_dir->fd_chunks[slot & FIB_VALUE_MAX];
+}
+
+/*
+ * Hand out a chunk index, growing the directory if every index is in
+ * use.  The old directory may still be referenced by readers, so it is
+ * retired rather than freed.
+ */
+static int
+fib_index_alloc(struct fib_trie *ft, uint32_t *indexp)
+{
+	struct fib_dir *fd = ft->ft_dir, *nfd;
+	uint32_t *nfree;
+
+	if (ft->ft_nfree > 0) {
+		*indexp = ft->ft_free_index[--ft->ft_nfree];
+		return 0;
+	}
+	if (ft->ft_next_index == fd->fd_size) {
+		if (fd->fd_size > FIB_VALUE_MAX / 2) {
+			return ENOSPC;
+		}
+		nfd = fib_dir_alloc(fd->fd_size * 2);
+		nfree = FIB_ALLOC(fd->fd_size * 2 * sizeof(uint32_t));
+		if (nfd == NULL || nfree == NULL) {
+			if (nfd != NULL) {
+				FIB_FREE(nfd, fib_dir_size(fd->fd_size * 2));
+			}
+			if (nfree != NULL) {
+				FIB_FREE(nfree, fd->fd_size * 2 * sizeof(uint32_t));
+			}
+			return ENOMEM;
+		}
+		memcpy(nfd->fd_chunks, fd->fd_chunks,
+		    fd->fd_size * sizeof(struct fib_chunk *));
+		/* the free index stack is empty here; nothing to carry over */
+		FIB_FREE(ft->ft_free_index, fd->fd_size * sizeof(uint32_t));
+		ft->ft_free_index = nfree;
+
+		FIB_STORE_RELEASE(&ft->ft_dir, nfd);
+		fd->fd_retired = ft->ft_retired_dirs;
+		ft->ft_retired_dirs = fd;
+	}
+	*indexp = ft->ft_next_index++;
+	return 0;
+}
+
+/*
+ * Allocate a chunk whose slots all inherit the leaf it replaces.  The
+ * directory entry is set here; the caller links the chunk into its parent
+ * slot with a release store, which makes both visible to readers.
+ */
+static struct fib_chunk *
+fib_chunk_alloc(struct fib_trie *ft, uint32_t value, uint8_t plen)
+{
+	struct fib_chunk *fc;
+	uint32_t index;
+	unsigned int i;
+
+	fc = FIB_ALLOC(sizeof(*fc));
+	if (fc == NULL) {
+		return NULL;
+	}
+	if (fib_index_alloc(ft, &index) != 0) {
+		FIB_FREE(fc, sizeof(*fc));
+		return NULL;
+	}
+	for (i = 0; i < FIB_CHUNK_SLOTS; i++) {
+		fc->fc_slots[i] = value;
+		fc->fc_plen[i] = plen;
+	}
+	fc->fc_index = index;
+	ft->ft_dir->fd_chunks[index] = fc;
+	ft->ft_nchunks++;
+	return fc;
+}
+
+/*
+ * Fold a chunk back into its parent slot if none of its slots holds a
+ * prefix longer than the parent slot covers; all of its slots then carry
+ * the same value.  The chunk keeps its directory entry until reclaimed.
+ */
+static void
+fib_chunk_collapse(struct fib_trie *ft, uint32_t *slotp, uint8_t *plenp,
+    struct fib_chunk *fc, unsigned int base)
+{
+	unsigned int i;
+
+	for (i = 0; i < FIB_CHUNK_SLOTS; i++) {
+		if ((fc->fc_slots[i] & FIB_SLOT_CHUNK) || fc->fc_plen[i] > base) {
+			return;
+		}
+	}
+	*plenp = fc->fc_plen[0];
+	FIB_STORE_RELEASE(slotp, fc->fc_slots[0]);
+
+	fc->fc_retired = ft->ft_retired_chunks;
+	ft->ft_retired_chunks = fc;
+	ft->ft_nchunks--;
+}
+
+/*
+ * Apply an update to a slot lying entirely within the prefix; the slot
+ * covers key bits up to (but excluding) bit `end'.
+ */
+static void
+fib_slot_fill(struct fib_trie *ft, uint32_t *slotp, uint8_t *plenp,
+    const struct fib_update *fu, unsigned int end)
+{
+	struct fib_chunk *fc;
+	unsigned int i;
+
+	if (*slotp & FIB_SLOT_CHUNK) {
+		fc = fib_chunk_get(ft, *slotp);
+		for (i = 0; i < FIB_CHUNK_SLOTS; i++) {
+			fib_slot_fill(ft, &fc->fc_slots[i], &fc->fc_plen[i], fu,
+			    end + FIB_CHUNK_BITS);
+		}
+		if (fu->fu_delete) {
+			fib_chunk_collapse(ft, slotp, plenp, fc, end);
+		}
+		return;
+	}
+
+	if (fu->fu_delete) {
+		if (*plenp == fu->fu_plen) {
+			*plenp = (uint8_t)fu->fu_repl_plen;
+			FIB_STORE_RELEASE(slotp, fu->fu_value);
+		}
+	} else if (*plenp <= fu->fu_plen) {
+		*plenp = (uint8_t)fu->fu_plen;
+		FIB_STORE_RELEASE(slotp, fu->fu_value);
+	}
+}
+
+/*
+ * Apply an update to the level made of `slots', which indexes `bits' key
+ * bits starting at bit `base'.
+ */
+static int
+fib_level_update(struct fib_trie *ft, uint32_t *slots, uint8_t *plens,
+    unsigned int base, unsigned int bits, const uint8_t *key,
+    const struct fib_update *fu)
+{
+	unsigned int end = base + bits;
+	unsigned int idx, span, i;
+	struct fib_chunk *fc;
+	int error;
+
+	idx = fib_slot_index(key, base, bits);
+	if (fu->fu_plen <= end) {
+		/* the prefix ends at this level and spans 2^(end - plen) slots */
+		span = 1U << (end - fu->fu_plen);
+		idx &= ~(span - 1);
+		for (i = idx; i < idx + span; i++) {
+			fib_slot_fill(ft, &slots[i], &plens[i], fu, end);
+		}
+		return 0;
+	}
+
+	if (slots[idx] & FIB_SLOT_CHUNK) {
+		fc = fib_chunk_get(ft, slots[idx]);
+	} else if (fu->fu_delete) {
+		/* nothing this long was ever inserted here */
+		return ESRCH;
+	} else {
+		fc = fib_chunk_alloc(ft, slots[idx], plens[idx]);
+		if (fc == NULL) {
+			return ENOMEM;
+		}
+		FIB_STORE_RELEASE(&slots[idx], FIB_SLOT_CHUNK | fc->fc_index);
+	}
+
+	error = fib_level_update(ft, fc->fc_slots, fc->fc_plen, end,
+	    FIB_CHUNK_BITS, key, fu);
+	if (fu->fu_delete) {
+		fib_chunk_collapse(ft, &slots[idx], &plens[idx], fc, end);
+	}
+	return error;
+}
+
+struct fib_trie *
+fib_trie_create(unsigned int keylen)
+{
+	struct fib_trie *ft;
+
+	if (keylen < FIB_ROOT_BITS || keylen > 128 || (keylen % 8) != 0) {
+		return NULL;
+	}
+	ft = FIB_ALLOC(sizeof(*ft));
+	if (ft == NULL) {
+		return NULL;
+	}
+	ft->ft_keylen = (uint8_t)keylen;
+	ft->ft_root = FIB_ALLOC(FIB_ROOT_SLOTS * sizeof(uint32_t));
+	ft->ft_root_plen = FIB_ALLOC(FIB_ROOT_SLOTS * sizeof(uint8_t));
+	ft->ft_dir = fib_dir_alloc(FIB_DIR_INITIAL);
+	ft->ft_free_index = FIB_ALLOC(FIB_DIR_INITIAL * sizeof(uint32_t));
+	if (ft->ft_root == NULL || ft->ft_root_plen == NULL ||
+	    ft->ft_dir == NULL || ft->ft_free_index == NULL) {
+		fib_trie_destroy(ft);
+		return NULL;
+	}
+	return ft;
+}
+
+/*
+ * The caller guarantees that there are no readers left.
+ */
+void
+fib_trie_destroy(struct fib_trie *ft)
+{
+	struct fib_dir *fd;
+	uint32_t i, size;
+
+	fib_trie_reclaim(ft);
+	if ((fd = ft->ft_dir) != NULL) {
+		size = fd->fd_size;
+		for (i = 0; i < ft->ft_next_index; i++) {
+			if (fd->fd_chunks[i] != NULL) {
+				FIB_FREE(fd->fd_chunks[i], sizeof(struct fib_chunk));
+			}
+		}
+		FIB_FREE(fd, fib_dir_size(size));
+		if (ft->ft_free_index != NULL) {
+			FIB_FREE(ft->ft_free_index, size * sizeof(uint32_t));
+		}
+	}
+	if (ft->ft_root != NULL) {
+		FIB_FREE(ft->ft_root, FIB_ROOT_SLOTS * sizeof(uint32_t));
+	}
+	if (ft->ft_root_plen != NULL) {
+		FIB_FREE(ft->ft_root_plen, FIB_ROOT_SLOTS * sizeof(uint8_t));
+	}
+	FIB_FREE(ft, sizeof(*ft));
+}
+
+/*
+ * Map the prefix `key'/`plen' to `value', which must be non-zero.
+ * Inserting an existing prefix replaces its value.
+ */
+int
+fib_trie_insert(struct fib_trie *ft, const uint8_t *key, unsigned int plen,
+    uint32_t value)
+{
+	struct fib_update fu = {
+		.fu_plen = plen,
+		.fu_value = value,
+	};
+
+	if (plen > ft->ft_keylen || value == 0 || value > FIB_VALUE_MAX) {
+		return EINVAL;
+	}
+	return fib_level_update(ft, ft->ft_root, ft->ft_root_plen, 0,
+	           FIB_ROOT_BITS, key, &fu);
+}
+
+/*
+ * Remove the prefix `key'/`plen'.  The addresses it covered fall back to
+ * `repl_value', the value of the longest remaining prefix of length
+ * `repl_plen' < `plen' that covers it, or 0 if there is none.
+ */
+int
+fib_trie_delete(struct fib_trie *ft, const uint8_t *key, unsigned int plen,
+    uint32_t repl_value, unsigned int repl_plen)
+{
+	struct fib_update fu = {
+		.fu_plen = plen,
+		.fu_value = repl_value,
+		.fu_repl_plen = repl_plen,
+		.fu_delete = 1,
+	};
+
+	if (plen > ft->ft_keylen || repl_value > FIB_VALUE_MAX ||
+	    (repl_value != 0 && repl_plen >= plen)) {
+		return EINVAL;
+	}
+	if (repl_value == 0) {
+		fu.fu_repl_plen = 0;
+	}
+	return fib_level_update(ft, ft->ft_root, ft->ft_root_plen, 0,
+	           FIB_ROOT_BITS, key, &fu);
+}
+
+/*
+ * Free everything retired by earlier updates.  Must only be called once
+ * every lookup that started before those updates has completed.
+ */
+void
+fib_trie_reclaim(struct fib_trie *ft)
+{
+	struct fib_chunk *fc;
+	struct fib_dir *fd;
+
+	while ((fc = ft->ft_retired_chunks) != NULL) {
+		ft->ft_retired_chunks = fc->fc_retired;
+		ft->ft_dir->fd_chunks[fc->fc_index] = NULL;
+		ft->ft_free_index[ft->ft_nfree++] = fc->fc_index;
+		FIB_FREE(fc, sizeof(*fc));
+	}
+	while ((fd = ft->ft_retired_dirs) != NULL) {
+		ft->ft_retired_dirs = fd->fd_retired;
+		FIB_FREE(fd, fib_dir_size(fd->fd_size));
+	}
+}
+
+size_t
+fib_trie_memory(const struct fib_trie *ft)
+{
+	return sizeof(*ft) +
+	       FIB_ROOT_SLOTS * (sizeof(uint32_t) + sizeof(uint8_t)) +
+	       fib_dir_size(ft->ft_dir->fd_size) +
+	       ft->ft_dir->fd_size * sizeof(uint32_t) +
+	       (size_t)ft->ft_nchunks * sizeof(struct fib_chunk);
+}
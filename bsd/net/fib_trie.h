@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Multibit forwarding trie.
+ *
+ * A leaf-pushed, fixed-stride trie (16 bits at the root, then 8 bits per
+ * level) mapping address prefixes to 31-bit values.  It is a lookup
+ * accelerator only: the owner keeps the authoritative table elsewhere
+ * (the radix tree, for the routing code) and mirrors prefix additions and
+ * removals into it.
+ *
+ * Every slot is a 32-bit word.  A slot either holds a leaf value (0 means
+ * no match) or, with FIB_SLOT_CHUNK set, the index of a 256-slot chunk
+ * for the next 8 bits of the key.  A lookup is therefore at most one
+ * dependent load per level: 3 for IPv4, 15 for IPv6.
+ *
+ * Updates are serialized by the owner.  Lookups take no lock: chunks are
+ * fully initialized before they are linked in, slots are updated with
+ * single stores, and memory that a concurrent reader may still hold is
+ * put on a retire list.  The owner must wait for all readers to drain
+ * (see rt_fib_synchronize()) before calling fib_trie_reclaim().
+ *
+ * This file is also compiled into the userspace route lookup benchmark,
+ * so it must not depend on anything beyond allocation and atomics.
+ */
+
+#ifndef _NET_FIB_TRIE_H_
+#define _NET_FIB_TRIE_H_
+
+#if defined(BSD_KERNEL_PRIVATE) || !defined(KERNEL)
+
+#ifdef KERNEL
+#include <sys/types.h>
+#include <machine/atomic.h>
+#define FIB_LOAD_ACQUIRE(p)     os_atomic_load(p, acquire)
+#define FIB_STORE_RELEASE(p, v) os_atomic_store(p, v, release)
+#else /* !KERNEL */
+#include <sys/cdefs.h>
+#include <stdint.h>
+#include <stddef.h>
+#define FIB_LOAD_ACQUIRE(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define FIB_STORE_RELEASE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#endif /* !KERNEL */
+
+#define FIB_ROOT_BITS           16
+#define FIB_ROOT_SLOTS          (1U << FIB_ROOT_BITS)
+#define FIB_CHUNK_BITS          8
+#define FIB_CHUNK_SLOTS         (1U << FIB_CHUNK_BITS)
+
+#define FIB_SLOT_CHUNK          0x80000000U     /* slot refers to a chunk */
+#define FIB_VALUE_MAX           0x7fffffffU     /* largest leaf value */
+
+struct fib_chunk {
+	uint32_t                fc_slots[FIB_CHUNK_SLOTS]; /* read locklessly */
+	uint8_t                 fc_plen[FIB_CHUNK_SLOTS]; /* writer only */
+	uint32_t                fc_index;       /* index in the directory */
+	struct fib_chunk        *fc_retired;    /* retire list linkage */
+};
+
+/*
+ * The chunk directory maps a chunk index to its chunk.  It is replaced
+ * (never resized in place) when it runs out of room.
+ */
+struct fib_dir {
+	struct fib_dir          *fd_retired;    /* retire list linkage */
+	uint32_t                fd_size;        /* # of entries in fd_chunks */
+	struct fib_chunk        *fd_chunks[];
+};
+
+struct fib_trie {
+	uint32_t                *ft_root;       /* FIB_ROOT_SLOTS slots */
+	uint8_t                 *ft_root_plen;  /* writer only */
+	struct fib_dir          *ft_dir;        /* current chunk directory */
+	uint8_t                 ft_keylen;      /* key length in bits */
+	uint32_t                ft_nchunks;     /* # of live chunks */
+	uint32_t                ft_next_index;  /* next never-used index */
+	uint32_t                *ft_free_index; /* stack of reusable indices */
+	uint32_t                ft_nfree;       /* depth of ft_free_index */
+	struct fib_chunk        *ft_retired_chunks;
+	struct fib_dir          *ft_retired_dirs;
+};
+
+__BEGIN_DECLS
+extern struct fib_trie *fib_trie_create(unsigned int keylen);
+extern void fib_trie_destroy(struct fib_trie *);
+extern int fib_trie_insert(struct fib_trie *, const uint8_t *, unsigned int,
+    uint32_t);
+extern int fib_trie_delete(struct fib_trie *, const uint8_t *, unsigned int,
+    uint32_t, unsigned int);
+extern void fib_trie_reclaim(struct fib_trie *);
+extern size_t fib_trie_memory(const struct fib_trie *);
+__END_DECLS
+
+static inline int
+fib_trie_has_retired(const struct fib_trie *ft)
+{
+	return ft->ft_retired_chunks != NULL || ft->ft_retired_dirs != NULL;
+}
+
+/*
+ * Longest prefix match of a key of ft_keylen bits, in network byte order.
+ * Returns the leaf value, 0 if no prefix covers the key.
+ */
+static inline uint32_t
+fib_trie_lookup(const struct fib_trie *ft, const uint8_t *key)
+{
+	const struct fib_dir *fd;
+	uint32_t slot;
+	unsigned int i = FIB_ROOT_BITS / 8;
+
+	slot = FIB_LOAD_ACQUIRE(&ft->ft_root[(key[0] << 8) | key[1]]);
+	while (slot & FIB_SLOT_CHUNK) {
+		/* load the directory after the slot that named the chunk */
+		fd = FIB_LOAD_ACQUIRE(&ft->ft_dir);
+		slot = FIB_LOAD_ACQUIRE(
+			&fd->fd_chunks[slot & FIB_VALUE_MAX]->fc_slots[key[i++]]);
+	}
+	return slot;
+}
+
+#endif /* BSD_KERNEL_PRIVATE || !KERNEL */
+#endif /* _NET_FIB_TRIE_H_ */
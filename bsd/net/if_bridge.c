@@ -130,6 +130,10 @@
 #include <libkern/libkern.h>
 
 #include <kern/zalloc.h>
+#include <kern/clock.h>
+#include <kern/epoch.h>
+#include <kern/thread.h>
+#include <machine/atomic.h>
 
 #if NBPFILTER > 0
 #include <net/bpf.h>
@@ -297,6 +301,15 @@
 #define BRIDGE_MAC_NAT_ENTRY_MAX        64
 #endif /* BRIDGE_MAC_NAT_ENTRY_MAX */
 
+/*
+ * Forwarding batches: number of input threads that can batch at once,
+ * destination ports per batch, and frames queued per destination port
+ * before they are sent.
+ */
+#define BRIDGE_FWD_BATCH_SLOTS          16
+#define BRIDGE_FWD_BATCH_PORTS          8
+#define BRIDGE_FWD_BATCH_MAX            64
+
 /*
  * List of capabilities to possibly mask on the member interface.
  */
@@ -399,12 +412,19 @@ struct mac_nat_record {
 
 /*
  * Bridge route node.
+ *
+ * The hash chains are also walked without the bridge lock by the
+ * forwarding fast path (see bridge_rtnode_lookup_unlocked()), so a node
+ * is linked in only once it is fully initialized, keeps its brt_hash
+ * forward pointer after it is unlinked, and is freed only after the
+ * readers have drained (see bridge_rtable_commit()).
  */
 struct bridge_rtnode {
 	LIST_ENTRY(bridge_rtnode) brt_hash;     /* hash table linkage */
 	LIST_ENTRY(bridge_rtnode) brt_list;     /* list linkage */
 	struct bridge_iflist    *brt_dst;       /* destination if */
 	unsigned long           brt_expire;     /* expiration time */
+	uint32_t                brt_fwd_gen;    /* sc_member_gen when checked */
 	uint8_t                 brt_flags;      /* address flags */
 	uint8_t                 brt_addr[ETHER_ADDR_LEN];
 	uint16_t                brt_vlan;       /* vlan id */
@@ -440,8 +460,11 @@ struct bridge_softc {
 	decl_lck_mtx_data(, sc_mtx);
 	struct _bridge_rtnode_list *sc_rthash;  /* our forwarding table */
 	struct _bridge_rtnode_list sc_rtlist;   /* list version of above */
+	struct _bridge_rtnode_list sc_rtretired; /* unlinked, not yet freed */
 	uint32_t                sc_rthash_key;  /* key for hash */
 	uint32_t                sc_rthash_size; /* size of the hash table */
+	uint32_t                sc_rthash_seq;  /* odd while rehashing */
+	uint32_t                sc_member_gen;  /* member set/lladdr changes */
 	struct bridge_delayed_call sc_aging_timer;
 	struct bridge_delayed_call sc_resize_call;
 	TAILQ_HEAD(, bridge_iflist) sc_spanlist;        /* span ports list */
@@ -534,6 +557,8 @@ static void     bridge_rtdelete(struct bridge_softc *, struct ifnet *ifp, int);
 
 static void     bridge_forward(struct bridge_softc *, struct bridge_iflist *,
     struct mbuf *);
+static boolean_t bridge_forward_fast(struct bridge_softc *,
+    struct bridge_iflist *, struct ifnet *, struct mbuf *);
 
 static void     bridge_aging_timer(struct bridge_softc *sc);
 
@@ -565,6 +590,12 @@ static int      bridge_rtnode_insert(struct bridge_softc *,
     struct bridge_rtnode *);
 static void     bridge_rtnode_destroy(struct bridge_softc *,
     struct bridge_rtnode *);
+static struct bridge_rtnode *bridge_rtnode_lookup_unlocked(
+    struct bridge_softc *, const uint8_t *, uint16_t);
+static void     bridge_rtnode_validate(struct bridge_softc *,
+    const uint8_t *, uint16_t);
+static void     bridge_rtnode_unlink(struct bridge_rtnode *);
+static void     bridge_rtable_commit(struct bridge_softc *);
 #if BRIDGESTP
 static void     bridge_rtable_expire(struct ifnet *, int);
 static void     bridge_state_change(struct ifnet *, int);
@@ -723,6 +754,86 @@ SYSCTL_INT(_net_link_bridge, OID_AUTO, log_stp, CTLFLAG_RW,
     &log_stp, 0, "Log STP state changes");
 #endif /* BRIDGESTP */
 
+static int bridge_fast_forward = 1;
+SYSCTL_INT(_net_link_bridge, OID_AUTO, fast_forward,
+    CTLFLAG_RW | CTLFLAG_LOCKED,
+    &bridge_fast_forward, 0,
+    "Forward known unicast frames without the bridge lock");
+
+/*
+ * Lock-free forwarding table reads.
+ *
+ * bridge_forward_fast() looks up rtnodes without the bridge lock.  As
+ * for the route FIB, a reader publishes the current epoch in its per-CPU
+ * slot, with preemption disabled, for the duration of the lookup.
+ * Writers unlink under the bridge lock, then wait for every slot that
+ * still shows an older epoch before freeing an rtnode or a hash array.
+ * A reader that races with a writer misses, and the frame takes the
+ * locked path.
+ */
+static struct epoch bridge_rt_epoch;
+
+static inline void
+bridge_rt_enter(void)
+{
+	epoch_enter(&bridge_rt_epoch);
+}
+
+static inline void
+bridge_rt_exit(void)
+{
+	epoch_exit(&bridge_rt_epoch);
+}
+
+/*
+ * Wait until every reader that may have seen state unlinked before this
+ * call has left its critical section.
+ */
+static void
+bridge_rt_synchronize(void)
+{
+	epoch_synchronize(&bridge_rt_epoch);
+}
+
+/*
+ * Forwarding batches.
+ *
+ * Frames taken by bridge_forward_fast() are grouped by destination port
+ * and handed to bridge_enqueue() as one chain when DLIL finishes the
+ * run of packets it is delivering from a member (bridge_input_flush()),
+ * or earlier if a group fills up.  A batch belongs to the input thread
+ * that started it; threads that find no free slot send right away.
+ */
+struct bridge_fwd_port {
+	struct ifnet            *bfp_bridge_ifp;
+	struct ifnet            *bfp_ifp;
+	mbuf_t                  bfp_head;
+	mbuf_t                  *bfp_tail;
+	uint32_t                bfp_count;
+	uint32_t                bfp_bytes;
+};
+
+struct bridge_fwd_batch {
+	thread_t                bfb_owner;
+	uint32_t                bfb_nports;
+	struct bridge_fwd_port  bfb_ports[BRIDGE_FWD_BATCH_PORTS];
+};
+
+static struct bridge_fwd_batch bridge_fwd_batches[BRIDGE_FWD_BATCH_SLOTS];
+static uint32_t bridge_fwd_batches_active;
+
+/*
+ * Called with the bridge lock held whenever the member set or a member's
+ * link-layer address changes: destinations checked against the old set
+ * go back through the locked path once.
+ */
+static inline void
+bridge_member_changed(struct bridge_softc *sc)
+{
+	BRIDGE_LOCK_ASSERT_HELD(sc);
+	os_atomic_inc(&sc->sc_member_gen, relaxed);
+}
+
 struct bridge_control {
 	int             (*bc_func)(struct bridge_softc *, void *);
 	unsigned int    bc_argsize;
@@ -1225,6 +1336,8 @@ bridgeattach(int n)
 
 	LIST_INIT(&bridge_list);
 
+	epoch_init(&bridge_rt_epoch);
+
 #if BRIDGESTP
 	bstp_sys_init();
 #endif /* BRIDGESTP */
@@ -2004,6 +2117,13 @@ bridge_iff_input(void *cookie, ifnet_t ifp, protocol_family_t protocol,
 		}
 	}
 
+	if (bridge_forward_fast(sc, bif, ifp, m)) {
+		error = EJUSTRETURN;
+		goto out;
+	}
+	/* don't let this frame overtake the ones batched before it */
+	bridge_input_flush();
+
 	error = bridge_input(ifp, data);
 
 	/* Adjust packet back to original */
@@ -2122,6 +2242,12 @@ bridge_iff_event(void *cookie, ifnet_t ifp, protocol_family_t protocol,
 			BRIDGE_UNLOCK(sc);
 			break;
 		}
+		case KEV_DL_LINK_ADDRESS_CHANGED: {
+			BRIDGE_LOCK(sc);
+			bridge_member_changed(sc);
+			BRIDGE_UNLOCK(sc);
+			break;
+		}
 		case KEV_DL_PROTO_DETACHED:
 		case KEV_DL_PROTO_ATTACHED: {
 			bridge_proto_attach_changed(ifp);
@@ -2234,6 +2360,7 @@ bridge_delete_member(struct bridge_softc *sc, struct bridge_iflist *bif,
 	BRIDGE_XLOCK(sc);
 	TAILQ_REMOVE(&sc->sc_iflist, bif, bif_next);
 	BRIDGE_XDROP(sc);
+	bridge_member_changed(sc);
 
 	if (sc->sc_mac_nat_bif != NULL) {
 		if (bif == sc->sc_mac_nat_bif) {
@@ -2486,6 +2613,7 @@ bridge_ioctl_add(struct bridge_softc *sc, void *arg)
 	 * XXX: XLOCK HERE!?!
 	 */
 	TAILQ_INSERT_TAIL(&sc->sc_iflist, bif, bif_next);
+	bridge_member_changed(sc);
 
 #if HAS_IF_CAP
 	/* Set interface capabilities to the intersection set of all members */
@@ -4074,8 +4202,14 @@ bridge_transmit(struct ifnet * ifp, struct mbuf *m)
 	return error;
 }
 
-static int
-bridge_send(struct ifnet *src_ifp,
+/*
+ * bridge_send_prepare:
+ *
+ *	Apply the checksum operation and VLAN encapsulation to a frame
+ *	about to be sent on dst_ifp.  Returns NULL if the frame was dropped.
+ */
+static struct mbuf *
+bridge_send_prepare(struct ifnet *src_ifp,
     struct ifnet *dst_ifp, struct mbuf *m, ChecksumOperation cksum_op)
 {
 	switch (cksum_op) {
@@ -4105,12 +4239,12 @@ bridge_send(struct ifnet *src_ifp,
 			    "header\n", __func__, dst_ifp->if_xname);
 			(void) ifnet_stat_increment_out(dst_ifp,
 			    0, 0, 1);
-			return 0;
+			return NULL;
 		}
 		m->m_flags &= ~M_VLANTAG;
 	}
 #endif /* HAS_IF_CAP */
-	return bridge_transmit(dst_ifp, m);
+	return m;
 }
 
 static int
@@ -4169,10 +4303,32 @@ done:
 	return error;
 }
 
+/*
+ * bridge_enqueue_list:
+ *
+ *	Send a chain of prepared frames on dst_ifp with one dlil_output()
+ *	call and account for them on the bridge.
+ */
+static int
+bridge_enqueue_list(ifnet_t bridge_ifp, struct ifnet *dst_ifp,
+    struct mbuf *m, uint32_t count, uint32_t bytes)
+{
+	errno_t         error;
+
+	error = bridge_transmit(dst_ifp, m);
+	if (error == 0) {
+		(void) ifnet_stat_increment_out(bridge_ifp, count, bytes, 0);
+	} else {
+		(void) ifnet_stat_increment_out(bridge_ifp, 0, 0, count);
+	}
+	return error;
+}
+
 /*
  * bridge_enqueue:
  *
- *	Enqueue a packet on a bridge member interface.
+ *	Enqueue a packet, or a chain of packets linked by m_nextpkt, on a
+ *	bridge member interface.
  *
  */
 static int
@@ -4181,11 +4337,18 @@ bridge_enqueue(ifnet_t bridge_ifp, struct ifnet *src_ifp,
 {
 	errno_t         error = 0;
 	int             len;
+	struct mbuf     *head = NULL;
+	struct mbuf     **tail = &head;
+	uint32_t        count = 0;
+	uint32_t        bytes = 0;
 
 	VERIFY(dst_ifp != NULL);
 
 	/*
-	 * We may be sending a fragment so traverse the mbuf
+	 * We may be sending a fragment, or a batch of frames from
+	 * bridge_forward_fast(), so traverse the mbuf.  Frames that do not
+	 * need to be segmented are collected and passed to the interface
+	 * as a single list.
 	 *
 	 * NOTE: bridge_fragment() is called only when PFIL_HOOKS is enabled.
 	 */
@@ -4203,9 +4366,27 @@ bridge_enqueue(ifnet_t bridge_ifp, struct ifnet *src_ifp,
 		if (if_bridge_segmentation != 0 &&
 		    len > (bridge_ifp->if_mtu + ETHER_HDR_LEN) &&
 		    (dst_ifp->if_capabilities & IFCAP_TSO) != IFCAP_TSO) {
+			/* keep the frames in order */
+			if (head != NULL) {
+				_error = bridge_enqueue_list(bridge_ifp,
+				    dst_ifp, head, count, bytes);
+				if (error == 0 && _error != 0) {
+					error = _error;
+				}
+				head = NULL;
+				tail = &head;
+				count = bytes = 0;
+			}
 			_error = bridge_send_tso(dst_ifp, m);
 		} else {
-			_error = bridge_send(src_ifp, dst_ifp, m, cksum_op);
+			m = bridge_send_prepare(src_ifp, dst_ifp, m, cksum_op);
+			if (m != NULL) {
+				*tail = m;
+				tail = &m->m_nextpkt;
+				count++;
+				bytes += len;
+			}
+			continue;
 		}
 		/* Preserve first error value */
 		if (error == 0 && _error != 0) {
@@ -4217,6 +4398,15 @@ bridge_enqueue(ifnet_t bridge_ifp, struct ifnet *src_ifp,
 			(void) ifnet_stat_increment_out(bridge_ifp, 0, 0, 1);
 		}
 	}
+	if (head != NULL) {
+		errno_t _error;
+
+		_error = bridge_enqueue_list(bridge_ifp, dst_ifp, head, count,
+		    bytes);
+		if (error == 0 && _error != 0) {
+			error = _error;
+		}
+	}
 
 	return error;
 }
@@ -4783,6 +4973,241 @@ drop:
 	m_freem(m);
 }
 
+/*
+ * bridge_fwd_batch_get:
+ *
+ *	Return the forwarding batch owned by the current thread, claiming a
+ *	free one if it has none.  Returns NULL if every batch is in use.
+ */
+static struct bridge_fwd_batch *
+bridge_fwd_batch_get(void)
+{
+	struct bridge_fwd_batch *bfb;
+	thread_t self = current_thread();
+	int i;
+
+	if (os_atomic_load(&bridge_fwd_batches_active, relaxed) != 0) {
+		for (i = 0; i < BRIDGE_FWD_BATCH_SLOTS; i++) {
+			bfb = &bridge_fwd_batches[i];
+			if (os_atomic_load(&bfb->bfb_owner, relaxed) == self) {
+				return bfb;
+			}
+		}
+	}
+	for (i = 0; i < BRIDGE_FWD_BATCH_SLOTS; i++) {
+		bfb = &bridge_fwd_batches[i];
+		if (os_atomic_cmpxchg(&bfb->bfb_owner, THREAD_NULL, self,
+		    acquire)) {
+			os_atomic_inc(&bridge_fwd_batches_active, relaxed);
+			return bfb;
+		}
+	}
+	return NULL;
+}
+
+static void
+bridge_fwd_port_flush(struct bridge_fwd_port *bfp)
+{
+	mbuf_t m = bfp->bfp_head;
+
+	if (m == NULL) {
+		return;
+	}
+	(void) ifnet_stat_increment_in(bfp->bfp_bridge_ifp, bfp->bfp_count,
+	    bfp->bfp_bytes, 0);
+	bfp->bfp_head = NULL;
+	bfp->bfp_tail = &bfp->bfp_head;
+	bfp->bfp_count = 0;
+	bfp->bfp_bytes = 0;
+	(void) bridge_enqueue(bfp->bfp_bridge_ifp, NULL, bfp->bfp_ifp, m,
+	    kChecksumOperationClear);
+}
+
+/*
+ * bridge_fwd_batch_add:
+ *
+ *	Queue a frame for dst_ifp on the current thread's batch, or send it
+ *	right away if the thread cannot get one.
+ */
+static void
+bridge_fwd_batch_add(ifnet_t bridge_ifp, struct ifnet *dst_ifp, mbuf_t m)
+{
+	struct bridge_fwd_batch *bfb;
+	struct bridge_fwd_port *bfp = NULL;
+	uint32_t i;
+
+	bfb = bridge_fwd_batch_get();
+	if (bfb == NULL) {
+		(void) ifnet_stat_increment_in(bridge_ifp, 1,
+		    m->m_pkthdr.len, 0);
+		(void) bridge_enqueue(bridge_ifp, NULL, dst_ifp, m,
+		    kChecksumOperationClear);
+		return;
+	}
+	for (i = 0; i < bfb->bfb_nports; i++) {
+		if (bfb->bfb_ports[i].bfp_ifp == dst_ifp &&
+		    bfb->bfb_ports[i].bfp_bridge_ifp == bridge_ifp) {
+			bfp = &bfb->bfb_ports[i];
+			break;
+		}
+	}
+	if (bfp == NULL) {
+		if (bfb->bfb_nports == BRIDGE_FWD_BATCH_PORTS) {
+			/* out of ports, start over */
+			for (i = 0; i < bfb->bfb_nports; i++) {
+				bridge_fwd_port_flush(&bfb->bfb_ports[i]);
+			}
+			bfb->bfb_nports = 0;
+		}
+		bfp = &bfb->bfb_ports[bfb->bfb_nports++];
+		bfp->bfp_bridge_ifp = bridge_ifp;
+		bfp->bfp_ifp = dst_ifp;
+		bfp->bfp_head = NULL;
+		bfp->bfp_tail = &bfp->bfp_head;
+		bfp->bfp_count = 0;
+		bfp->bfp_bytes = 0;
+	}
+	*bfp->bfp_tail = m;
+	bfp->bfp_tail = &m->m_nextpkt;
+	bfp->bfp_bytes += m->m_pkthdr.len;
+	if (++bfp->bfp_count >= BRIDGE_FWD_BATCH_MAX) {
+		bridge_fwd_port_flush(bfp);
+	}
+}
+
+/*
+ * bridge_input_flush:
+ *
+ *	Send the frames that the current thread batched in
+ *	bridge_forward_fast() and release its batch.  Called by DLIL at the
+ *	end of each run of input packets from an interface, and by the
+ *	bridge before a frame takes the locked path so that frames are not
+ *	reordered.
+ */
+void
+bridge_input_flush(void)
+{
+	struct bridge_fwd_batch *bfb = NULL;
+	thread_t self;
+	uint32_t i;
+
+	if (os_atomic_load(&bridge_fwd_batches_active, relaxed) == 0) {
+		return;
+	}
+	self = current_thread();
+	for (i = 0; i < BRIDGE_FWD_BATCH_SLOTS; i++) {
+		if (os_atomic_load(&bridge_fwd_batches[i].bfb_owner,
+		    relaxed) == self) {
+			bfb = &bridge_fwd_batches[i];
+			break;
+		}
+	}
+	if (bfb == NULL) {
+		return;
+	}
+	for (i = 0; i < bfb->bfb_nports; i++) {
+		bridge_fwd_port_flush(&bfb->bfb_ports[i]);
+	}
+	bfb->bfb_nports = 0;
+	os_atomic_dec(&bridge_fwd_batches_active, relaxed);
+	os_atomic_store(&bfb->bfb_owner, THREAD_NULL, release);
+}
+
+/*
+ * bridge_forward_fast:
+ *
+ *	Forward a unicast frame to a known destination without taking the
+ *	bridge lock.  Only the plain case is handled: the source address is
+ *	already learned on this port, the destination was learned on
+ *	another running port and has been checked against the member
+ *	addresses (bridge_rtnode_validate()), and no feature that needs the
+ *	lock (spanning tree, span ports, host filter, MAC-NAT, PF member
+ *	filtering, bpf on the bridge) is in use.  Returns FALSE, without
+ *	touching the frame, for anything else.
+ */
+static boolean_t
+bridge_forward_fast(struct bridge_softc *sc, struct bridge_iflist *sbif,
+    struct ifnet *ifp, struct mbuf *m)
+{
+	struct bridge_rtnode *brt;
+	struct bridge_iflist *dbif;
+	struct ether_header *eh;
+	ifnet_t bridge_ifp = sc->sc_ifp;
+	struct ifnet *dst_if = NULL;
+	unsigned long expire;
+	uint32_t sbif_ifflags;
+	uint16_t vlan;
+
+	if (bridge_fast_forward == 0 ||
+	    (m->m_flags & (M_BCAST | M_MCAST)) != 0 ||
+	    (bridge_ifp->if_flags & IFF_RUNNING) == 0) {
+		return FALSE;
+	}
+#ifdef IFF_MONITOR
+	if ((bridge_ifp->if_flags & IFF_MONITOR) != 0) {
+		return FALSE;
+	}
+#endif /* IFF_MONITOR */
+	if ((PF_IS_ENABLED && (sc->sc_filter_flags & IFBF_FILT_MEMBER)) ||
+	    sc->sc_mac_nat_bif != NULL || sc->sc_bpf_input != NULL ||
+	    !TAILQ_EMPTY(&sc->sc_spanlist)) {
+		return FALSE;
+	}
+	sbif_ifflags = sbif->bif_ifflags;
+	if ((sbif_ifflags & IFBIF_STP) != 0 ||
+	    (sbif->bif_flags & BIFF_HOST_FILTER) != 0) {
+		return FALSE;
+	}
+	eh = mtod(m, struct ether_header *);
+	if (memcmp(eh->ether_dhost, IF_LLADDR(ifp), ETHER_ADDR_LEN) == 0 ||
+	    memcmp(eh->ether_dhost, IF_LLADDR(bridge_ifp),
+	    ETHER_ADDR_LEN) == 0) {
+		return FALSE;
+	}
+	vlan = VLANTAGOF(m);
+
+	bridge_rt_enter();
+	if ((sbif_ifflags & IFBIF_LEARNING) != 0) {
+		/* bridge_rtupdate() would only refresh the entry */
+		brt = bridge_rtnode_lookup_unlocked(sc, eh->ether_shost,
+		    vlan != 0 ? vlan : 1);
+		if (brt == NULL || brt->brt_dst != sbif) {
+			goto done;
+		}
+		/*
+		 * The expiry only moves once a second; skip the store, and
+		 * the cache line it would take from other CPUs, until then.
+		 */
+		expire = (unsigned long)net_uptime() + sc->sc_brttimeout;
+		if (os_atomic_load(&brt->brt_expire, relaxed) != expire) {
+			os_atomic_store(&brt->brt_expire, expire, relaxed);
+		}
+	}
+	brt = bridge_rtnode_lookup_unlocked(sc, eh->ether_dhost, vlan);
+	if (brt == NULL ||
+	    brt->brt_fwd_gen != os_atomic_load(&sc->sc_member_gen, relaxed)) {
+		goto done;
+	}
+	dbif = brt->brt_dst;
+	if (dbif->bif_ifp == ifp ||
+	    (dbif->bif_ifflags & IFBIF_STP) != 0 ||
+	    (sbif_ifflags & dbif->bif_ifflags & IFBIF_PRIVATE) != 0 ||
+	    (dbif->bif_ifp->if_flags & IFF_RUNNING) == 0) {
+		goto done;
+	}
+	dst_if = dbif->bif_ifp;
+done:
+	bridge_rt_exit();
+	if (dst_if == NULL) {
+		return FALSE;
+	}
+
+	mbuf_setflags_mask(m, 0, MBUF_PROMISC);
+	m->m_pkthdr.rcvif = bridge_ifp;
+	bridge_fwd_batch_add(bridge_ifp, dst_if, m);
+	return TRUE;
+}
+
 #if BRIDGE_DEBUG
 
 static char *
@@ -5303,6 +5728,9 @@ bridge_input(struct ifnet *ifp, mbuf_t *data)
 #undef CARP_CHECK_WE_ARE_SRC
 #undef GRAB_OUR_PACKETS
 
+	/* not for us or for any member: bridge_forward_fast() may use it */
+	bridge_rtnode_validate(sc, eh->ether_dhost, vlan);
+
 	/*
 	 * Perform the bridge forwarding function.
 	 *
@@ -5590,13 +6018,13 @@ bridge_rtupdate(struct bridge_softc *sc, const uint8_t *dst, uint16_t vlan,
 
 		memcpy(brt->brt_addr, dst, ETHER_ADDR_LEN);
 		brt->brt_vlan = vlan;
-
+		/* set before the node becomes visible to lock-free readers */
+		brt->brt_dst = bif;
 
 		if ((error = bridge_rtnode_insert(sc, brt)) != 0) {
 			zfree(bridge_rtnode_pool, brt);
 			return error;
 		}
-		brt->brt_dst = bif;
 		bif->bif_addrcnt++;
 #if BRIDGE_DEBUG
 		if (IF_BRIDGE_DEBUG(BR_DBGF_RT_TABLE)) {
@@ -5678,10 +6106,11 @@ bridge_rttrim(struct bridge_softc *sc)
 		if ((brt->brt_flags & IFBAF_TYPEMASK) == IFBAF_DYNAMIC) {
 			bridge_rtnode_destroy(sc, brt);
 			if (sc->sc_brtcnt <= sc->sc_brtmax) {
-				return;
+				break;
 			}
 		}
 	}
+	bridge_rtable_commit(sc);
 }
 
 /*
@@ -5726,6 +6155,7 @@ bridge_rtage(struct bridge_softc *sc)
 			}
 		}
 	}
+	bridge_rtable_commit(sc);
 	if (sc->sc_mac_nat_bif != NULL) {
 		bridge_mac_nat_age_entries(sc, now);
 	}
@@ -5748,6 +6178,7 @@ bridge_rtflush(struct bridge_softc *sc, int full)
 			bridge_rtnode_destroy(sc, brt);
 		}
 	}
+	bridge_rtable_commit(sc);
 }
 
 /*
@@ -5771,6 +6202,7 @@ bridge_rtdaddr(struct bridge_softc *sc, const uint8_t *addr, uint16_t vlan)
 		bridge_rtnode_destroy(sc, brt);
 		found = 1;
 	}
+	bridge_rtable_commit(sc);
 
 	return found ? 0 : ENOENT;
 }
@@ -5793,6 +6225,7 @@ bridge_rtdelete(struct bridge_softc *sc, struct ifnet *ifp, int full)
 			bridge_rtnode_destroy(sc, brt);
 		}
 	}
+	bridge_rtable_commit(sc);
 }
 
 /*
@@ -5820,6 +6253,8 @@ bridge_rtable_init(struct bridge_softc *sc)
 	sc->sc_rthash_key = RandomULong();
 
 	LIST_INIT(&sc->sc_rtlist);
+	LIST_INIT(&sc->sc_rtretired);
+	sc->sc_member_gen = 1;
 
 	return 0;
 }
@@ -5872,8 +6307,11 @@ bridge_rthash_delayed_resize(struct bridge_softc *sc)
 		goto out;
 	}
 	/*
-	 * Fail safe from here on
+	 * Fail safe from here on.  Lock-free readers see an odd
+	 * sc_rthash_seq and miss until every entry has moved over.
 	 */
+	os_atomic_inc(&sc->sc_rthash_seq, relaxed);
+	os_atomic_thread_fence(release);
 	old_rthash = sc->sc_rthash;
 	sc->sc_rthash = new_rthash;
 	sc->sc_rthash_size = new_rthash_size;
@@ -5889,9 +6327,10 @@ bridge_rthash_delayed_resize(struct bridge_softc *sc)
 	}
 
 	LIST_FOREACH(brt, &sc->sc_rtlist, brt_list) {
-		LIST_REMOVE(brt, brt_hash);
+		bridge_rtnode_unlink(brt);
 		(void) bridge_rtnode_hash(sc, brt);
 	}
+	os_atomic_inc(&sc->sc_rthash_seq, release);
 out:
 	if (error == 0) {
 #if BRIDGE_DEBUG
@@ -5901,6 +6340,8 @@ out:
 		}
 #endif /* BRIDGE_DEBUG */
 		if (old_rthash) {
+			/* readers may still be walking the old buckets */
+			bridge_rt_synchronize();
 			_FREE(old_rthash, M_DEVBUF);
 		}
 	} else {
@@ -5980,9 +6421,9 @@ do {                                                                    \
 } while ( /*CONSTCOND*/ 0)
 
 static __inline uint32_t
-bridge_rthash(struct bridge_softc *sc, const uint8_t *addr)
+bridge_rthash_key(uint32_t key, uint32_t mask, const uint8_t *addr)
 {
-	uint32_t a = 0x9e3779b9, b = 0x9e3779b9, c = sc->sc_rthash_key;
+	uint32_t a = 0x9e3779b9, b = 0x9e3779b9, c = key;
 
 	b += addr[5] << 8;
 	b += addr[4];
@@ -5993,11 +6434,18 @@ bridge_rthash(struct bridge_softc *sc, const uint8_t *addr)
 
 	mix(a, b, c);
 
-	return c & BRIDGE_RTHASH_MASK(sc);
+	return c & mask;
 }
 
 #undef mix
 
+static __inline uint32_t
+bridge_rthash(struct bridge_softc *sc, const uint8_t *addr)
+{
+	return bridge_rthash_key(sc->sc_rthash_key, BRIDGE_RTHASH_MASK(sc),
+	    addr);
+}
+
 static int
 bridge_rtnode_addr_cmp(const uint8_t *a, const uint8_t *b)
 {
@@ -6040,6 +6488,109 @@ bridge_rtnode_lookup(struct bridge_softc *sc, const uint8_t *addr,
 	return NULL;
 }
 
+/*
+ * bridge_rtnode_lookup_unlocked:
+ *
+ *	Lock-free variant of bridge_rtnode_lookup() for the forwarding fast
+ *	path; call it between bridge_rt_enter() and bridge_rt_exit().  It
+ *	may miss an entry that is being inserted, removed or rehashed, in
+ *	which case the caller falls back to the locked path.
+ */
+static struct bridge_rtnode *
+bridge_rtnode_lookup_unlocked(struct bridge_softc *sc, const uint8_t *addr,
+    uint16_t vlan)
+{
+	struct _bridge_rtnode_list *rthash;
+	struct bridge_rtnode *brt;
+	uint32_t key, mask, seq;
+	int dir;
+
+	seq = os_atomic_load(&sc->sc_rthash_seq, acquire);
+	if ((seq & 1) != 0) {
+		return NULL;
+	}
+	rthash = os_atomic_load(&sc->sc_rthash, relaxed);
+	key = os_atomic_load(&sc->sc_rthash_key, relaxed);
+	mask = os_atomic_load(&sc->sc_rthash_size, relaxed) - 1;
+	os_atomic_thread_fence(acquire);
+	if (os_atomic_load(&sc->sc_rthash_seq, relaxed) != seq) {
+		/* table, key and size may not belong together */
+		return NULL;
+	}
+
+	brt = os_atomic_load(&LIST_FIRST(&rthash[bridge_rthash_key(key, mask,
+	    addr)]), acquire);
+	while (brt != NULL) {
+		dir = bridge_rtnode_addr_cmp(addr, brt->brt_addr);
+		if (dir == 0 && (brt->brt_vlan == vlan || vlan == 0)) {
+			return brt;
+		}
+		if (dir > 0) {
+			return NULL;
+		}
+		brt = os_atomic_load(&LIST_NEXT(brt, brt_hash), acquire);
+	}
+
+	return NULL;
+}
+
+/*
+ * bridge_rtnode_link:
+ *
+ *	Link a fully initialized node into a hash chain in front of *prevp.
+ *	The store that makes it reachable is the last one.
+ */
+static void
+bridge_rtnode_link(struct bridge_rtnode **prevp, struct bridge_rtnode *brt)
+{
+	struct bridge_rtnode *next = *prevp;
+
+	brt->brt_hash.le_next = next;
+	brt->brt_hash.le_prev = prevp;
+	if (next != NULL) {
+		next->brt_hash.le_prev = &brt->brt_hash.le_next;
+	}
+	os_atomic_store(prevp, brt, release);
+}
+
+/*
+ * bridge_rtnode_unlink:
+ *
+ *	Unlink a node from its hash chain.  Unlike LIST_REMOVE() it leaves
+ *	the forward pointer alone, for readers still standing on the node.
+ */
+static void
+bridge_rtnode_unlink(struct bridge_rtnode *brt)
+{
+	struct bridge_rtnode *next = LIST_NEXT(brt, brt_hash);
+
+	if (next != NULL) {
+		next->brt_hash.le_prev = brt->brt_hash.le_prev;
+	}
+	os_atomic_store(brt->brt_hash.le_prev, next, relaxed);
+}
+
+/*
+ * bridge_rtnode_validate:
+ *
+ *	Record that the destination was checked against the addresses of
+ *	the bridge members, so that bridge_forward_fast() may use it until
+ *	the member set or a member address changes.
+ */
+static void
+bridge_rtnode_validate(struct bridge_softc *sc, const uint8_t *addr,
+    uint16_t vlan)
+{
+	struct bridge_rtnode *brt;
+
+	BRIDGE_LOCK_ASSERT_HELD(sc);
+
+	brt = bridge_rtnode_lookup(sc, addr, vlan);
+	if (brt != NULL) {
+		brt->brt_fwd_gen = sc->sc_member_gen;
+	}
+}
+
 /*
  * bridge_rtnode_hash:
  *
@@ -6060,7 +6611,7 @@ bridge_rtnode_hash(struct bridge_softc *sc, struct bridge_rtnode *brt)
 
 	lbrt = LIST_FIRST(&sc->sc_rthash[hash]);
 	if (lbrt == NULL) {
-		LIST_INSERT_HEAD(&sc->sc_rthash[hash], brt, brt_hash);
+		bridge_rtnode_link(&LIST_FIRST(&sc->sc_rthash[hash]), brt);
 		goto out;
 	}
 
@@ -6080,11 +6631,11 @@ bridge_rtnode_hash(struct bridge_softc *sc, struct bridge_rtnode *brt)
 			return EEXIST;
 		}
 		if (dir > 0) {
-			LIST_INSERT_BEFORE(lbrt, brt, brt_hash);
+			bridge_rtnode_link(lbrt->brt_hash.le_prev, brt);
 			goto out;
 		}
 		if (LIST_NEXT(lbrt, brt_hash) == NULL) {
-			LIST_INSERT_AFTER(lbrt, brt, brt_hash);
+			bridge_rtnode_link(&LIST_NEXT(lbrt, brt_hash), brt);
 			goto out;
 		}
 		lbrt = LIST_NEXT(lbrt, brt_hash);
@@ -6130,19 +6681,43 @@ bridge_rtnode_insert(struct bridge_softc *sc, struct bridge_rtnode *brt)
 /*
  * bridge_rtnode_destroy:
  *
- *	Destroy a bridge rtnode.
+ *	Destroy a bridge rtnode.  The node is freed by the caller's
+ *	bridge_rtable_commit().
  */
 static void
 bridge_rtnode_destroy(struct bridge_softc *sc, struct bridge_rtnode *brt)
 {
 	BRIDGE_LOCK_ASSERT_HELD(sc);
 
-	LIST_REMOVE(brt, brt_hash);
+	bridge_rtnode_unlink(brt);
 
 	LIST_REMOVE(brt, brt_list);
 	sc->sc_brtcnt--;
 	brt->brt_dst->bif_addrcnt--;
-	zfree(bridge_rtnode_pool, brt);
+	LIST_INSERT_HEAD(&sc->sc_rtretired, brt, brt_list);
+}
+
+/*
+ * bridge_rtable_commit:
+ *
+ *	Free the rtnodes destroyed since the last commit, once no lock-free
+ *	reader can still be looking at them.
+ */
+static void
+bridge_rtable_commit(struct bridge_softc *sc)
+{
+	struct bridge_rtnode *brt;
+
+	BRIDGE_LOCK_ASSERT_HELD(sc);
+
+	if (LIST_EMPTY(&sc->sc_rtretired)) {
+		return;
+	}
+	bridge_rt_synchronize();
+	while ((brt = LIST_FIRST(&sc->sc_rtretired)) != NULL) {
+		LIST_REMOVE(brt, brt_list);
+		zfree(bridge_rtnode_pool, brt);
+	}
 }
 
 #if BRIDGESTP
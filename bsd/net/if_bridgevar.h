@@ -546,6 +546,7 @@ struct bridge_hostfilter_stats {
 extern u_int8_t bstp_etheraddr[ETHER_ADDR_LEN];
 
 int     bridgeattach(int);
+void    bridge_input_flush(void);
 
 #endif /* XNU_KERNEL_PRIVATE */
 
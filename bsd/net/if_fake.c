@@ -805,6 +805,7 @@ static struct mbuf *
 copy_mbuf(struct mbuf *m)
 {
 	struct mbuf *   copy_m;
+	struct mbuf *   n;
 	uint32_t        pkt_len;
 	uint32_t        offset;
 
@@ -836,19 +837,37 @@ copy_mbuf(struct mbuf *m)
 	copy_m->m_pkthdr.len = pkt_len;
 	copy_m->m_pkthdr.pkt_svc = m->m_pkthdr.pkt_svc;
 	offset = 0;
-	while (m != NULL && offset < pkt_len) {
+	for (n = m; n != NULL && offset < pkt_len; n = n->m_next) {
 		uint32_t        frag_len;
 
-		frag_len = m->m_len;
+		frag_len = n->m_len;
 		if (frag_len > (pkt_len - offset)) {
 			printf("if_fake_: Large mbuf fragment %d > %d\n",
 			    frag_len, (pkt_len - offset));
 			goto failed;
 		}
-		m_copydata(m, 0, frag_len, mtod(copy_m, void *) + offset);
 		offset += frag_len;
-		m = m->m_next;
 	}
+	if (offset < pkt_len) {
+		printf("if_fake: copy_mbuf(): short mbuf chain %d < %d\n",
+		    offset, pkt_len);
+		goto failed;
+	}
+	if (pkt_len <= ETHER_HDR_LEN) {
+		m_copydata(m, 0, pkt_len, mtod(copy_m, void *));
+		return copy_m;
+	}
+
+	/*
+	 * Like a NIC without checksum offload whose driver copies the
+	 * frame anyway: sum the payload as it is copied and hand the
+	 * stack a partial checksum starting after the Ethernet header.
+	 */
+	m_copydata(m, 0, ETHER_HDR_LEN, mtod(copy_m, void *));
+	copy_m->m_pkthdr.csum_rx_val = m_copydata_sum(m, ETHER_HDR_LEN,
+	    pkt_len - ETHER_HDR_LEN, mtod(copy_m, uint8_t *) + ETHER_HDR_LEN);
+	copy_m->m_pkthdr.csum_rx_start = ETHER_HDR_LEN;
+	copy_m->m_pkthdr.csum_flags = CSUM_DATA_VALID | CSUM_PARTIAL;
 	return copy_m;
 
 failed:
@@ -914,6 +933,10 @@ feth_output_common(ifnet_t ifp, struct mbuf * m, ifnet_t peer,
 		m->m_pkthdr.csum_flags =
 		    CSUM_DATA_VALID | CSUM_PSEUDO_HDR |
 		    CSUM_IP_CHECKED | CSUM_IP_VALID;
+	} else if (trailer_len != 0 || fcs) {
+		/* the partial sum from copy_mbuf() won't cover these */
+		m->m_pkthdr.csum_flags &= ~(CSUM_DATA_VALID | CSUM_PARTIAL);
+		m->m_pkthdr.csum_data = 0;
 	}
 
 	(void)ifnet_stat_increment_out(ifp, 1, m->m_pkthdr.len, 0);
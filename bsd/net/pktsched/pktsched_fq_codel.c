@@ -32,6 +32,7 @@
 #include <net/ethernet.h>
 #include <net/if_var.h>
 #include <net/if.h>
+#include <net/flowhash.h>
 #include <net/classq/classq.h>
 #include <net/classq/classq_fq_codel.h>
 #include <net/pktsched/pktsched_fq_codel.h>
@@ -62,6 +63,18 @@
 #define FQ_CODEL_DRR_MAX_CTL       8
 
 static ZONE_DECLARE(fq_if_zone, "pktsched_fq_if", sizeof(fq_if_t), ZC_ZFREE_CLEARMEM);
+static ZONE_DECLARE(fq_if_mq_zone, "pktsched_fq_if_mq", sizeof(fq_if_mq_t),
+    ZC_ZFREE_CLEARMEM);
+static LCK_GRP_DECLARE(fq_if_mq_lock_group, "pktsched_fq_if_mq");
+
+/*
+ * Number of fq_codel instances to create for newly attached interfaces;
+ * 0 or 1 keeps the single instance protected by the ifclassq lock.
+ */
+static uint32_t fq_if_mq_count = 0;
+SYSCTL_UINT(_net_classq, OID_AUTO, fq_codel_mq_count,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &fq_if_mq_count, 0,
+    "number of fq_codel instances per interface");
 
 typedef STAILQ_HEAD(, flowq) flowq_dqlist_t;
 
@@ -80,6 +93,10 @@ static void fq_if_empty_new_flow(fq_t *fq, fq_if_classq_t *fq_cl,
     bool add_to_old);
 static void fq_if_empty_old_flow(fq_if_t *fqs, fq_if_classq_t *fq_cl,
     fq_t *fq, bool remove_hash, bool destroy);
+static void fq_if_dequeue_multi(fq_if_t *, u_int32_t, u_int32_t,
+    classq_pkt_t *, classq_pkt_t *, u_int32_t *, u_int32_t *);
+static void fq_if_dequeue_sc_multi(fq_if_t *, mbuf_svc_class_t, u_int32_t,
+    u_int32_t, classq_pkt_t *, classq_pkt_t *, u_int32_t *, u_int32_t *);
 
 #define FQ_IF_FLOW_HASH_ID(_flowid_) \
 	(((_flowid_) >> FQ_IF_HASH_TAG_SHIFT) & FQ_IF_HASH_TAG_MASK)
@@ -156,6 +173,7 @@ fq_if_alloc(struct ifnet *ifp, classq_pkt_type_t ptype)
 
 	fqs = zalloc_flags(fq_if_zone, Z_WAITOK | Z_ZERO);
 	fqs->fqs_ifq = &ifp->if_snd;
+	fqs->fqs_lock = &ifp->if_snd.ifcq_lock;
 	fqs->fqs_ptype = ptype;
 
 	/* Calculate target queue delay */
@@ -178,6 +196,63 @@ fq_if_destroy(fq_if_t *fqs)
 	zfree(fq_if_zone, fqs);
 }
 
+static void
+fq_if_mq_destroy(fq_if_mq_t *fqm)
+{
+	fq_if_t *fqs;
+	uint32_t i;
+
+	for (i = 0; i < fqm->fqm_count; i++) {
+		fqs = fqm->fqm_queues[i];
+		if (fqs == NULL) {
+			continue;
+		}
+		fqm->fqm_queues[i] = NULL;
+		FQS_LOCK(fqs);
+		fq_if_purge(fqs);
+		FQS_UNLOCK(fqs);
+		lck_mtx_destroy(&fqs->fqs_mq_lock, &fq_if_mq_lock_group);
+		fqs->fqs_ifq = NULL;
+		fqs->fqs_lock = NULL;
+		fqs->fqs_mq = NULL;
+		zfree(fq_if_zone, fqs);
+	}
+	zfree(fq_if_mq_zone, fqm);
+}
+
+/*
+ * Map a flow onto one of the instances of a multi-queue set.  The flow id
+ * is rehashed so that the instance choice is independent of the hash
+ * bucket (the top bits of the flow id) used within the instance.
+ */
+static inline fq_if_t *
+fq_if_mq_select(fq_if_t *fqs, uint32_t flowid)
+{
+	fq_if_mq_t *fqm = fqs->fqs_mq;
+	uint32_t idx;
+
+	if (fqm == NULL) {
+		return fqs;
+	}
+	idx = net_flowhash(&flowid, sizeof(flowid), fqm->fqm_seed) %
+	    fqm->fqm_count;
+	return fqm->fqm_queues[idx];
+}
+
+static inline uint32_t
+fq_if_mq_active_flows(fq_if_t *fqs)
+{
+	fq_if_classq_t *fq_cl;
+	uint32_t i, flows = 0;
+
+	for (i = 0; i < FQ_IF_MAX_CLASSES; i++) {
+		fq_cl = &fqs->fqs_classq[i];
+		flows += fq_cl->fcl_stat.fcl_newflows_cnt +
+		    fq_cl->fcl_stat.fcl_oldflows_cnt;
+	}
+	return flows;
+}
+
 static inline uint8_t
 fq_if_service_to_priority(fq_if_t *fqs, mbuf_svc_class_t svc)
 {
@@ -284,6 +359,13 @@ fq_if_enqueue_classq(struct ifclassq *ifq, classq_pkt_t *head,
 	pktsched_pkt_encap_chain(&pkt, head, tail, cnt, bytes);
 
 	fqs = (fq_if_t *)ifq->ifcq_disc;
+	if (FQS_IS_MULTIQ(fqs)) {
+		uint32_t pkt_flowid;
+
+		pktsched_get_pkt_vars(&pkt, NULL, NULL, &pkt_flowid, NULL,
+		    NULL, NULL);
+		fqs = fq_if_mq_select(fqs, pkt_flowid);
+	}
 	svc = pktsched_get_pkt_svc(&pkt);
 	pri = fq_if_service_to_priority(fqs, svc);
 	VERIFY(pri < FQ_IF_MAX_CLASSES);
@@ -298,7 +380,7 @@ fq_if_enqueue_classq(struct ifclassq *ifq, classq_pkt_t *head,
 		goto done;
 	}
 
-	IFCQ_LOCK_SPIN(ifq);
+	FQS_LOCK_SPIN(fqs);
 	ret = fq_addq(fqs, &pkt, fq_cl);
 	if (!(fqs->fqs_flags & FQS_DRIVER_MANAGED) &&
 	    !FQ_IF_CLASSQ_IDLE(fq_cl)) {
@@ -321,7 +403,7 @@ fq_if_enqueue_classq(struct ifclassq *ifq, classq_pkt_t *head,
 			ret = 0;
 			*pdrop = FALSE;
 		} else {
-			IFCQ_UNLOCK(ifq);
+			FQS_UNLOCK(fqs);
 			*pdrop = TRUE;
 			pktsched_free_pkt(&pkt);
 			switch (ret) {
@@ -345,9 +427,8 @@ fq_if_enqueue_classq(struct ifclassq *ifq, classq_pkt_t *head,
 	} else {
 		*pdrop = FALSE;
 	}
-	IFCQ_ADD_LEN(ifq, cnt);
-	IFCQ_INC_BYTES(ifq, bytes);
-	IFCQ_UNLOCK(ifq);
+	FQ_IF_ADD_LEN(fqs, cnt, bytes);
+	FQS_UNLOCK(fqs);
 done:
 #if DEBUG || DEVELOPMENT
 	if (__improbable((ret == EQFULL) && (ifclassq_flow_control_adv == 0))) {
@@ -373,6 +454,12 @@ fq_if_dequeue_sc_classq(struct ifclassq *ifq, mbuf_svc_class_t svc,
 	fq_if_classq_t *fq_cl;
 	uint8_t pri;
 
+	if (FQS_IS_MULTIQ(fqs)) {
+		(void) fq_if_dequeue_sc_classq_multi(ifq, svc, 1,
+		    CLASSQ_DEQUEUE_MAX_BYTE_LIMIT, pkt, NULL, NULL, NULL);
+		return;
+	}
+
 	pri = fq_if_service_to_priority(fqs, svc);
 	fq_cl = &fqs->fqs_classq[pri];
 
@@ -439,8 +526,8 @@ fq_dqlist_get_packet_list(flowq_dqlist_t *fq_dqlist_head, classq_pkt_t *head,
 	}
 }
 
-int
-fq_if_dequeue_classq_multi(struct ifclassq *ifq, u_int32_t maxpktcnt,
+static void
+fq_if_dequeue_multi(fq_if_t *fqs, u_int32_t maxpktcnt,
     u_int32_t maxbytecnt, classq_pkt_t *first_packet,
     classq_pkt_t *last_packet, u_int32_t *retpktcnt,
     u_int32_t *retbytecnt)
@@ -452,12 +539,9 @@ fq_if_dequeue_classq_multi(struct ifclassq *ifq, u_int32_t maxpktcnt,
 	fq_if_append_pkt_t append_pkt;
 	flowq_dqlist_t fq_dqlist_head;
 	fq_if_classq_t *fq_cl;
-	fq_if_t *fqs;
 	int pri;
 
-	IFCQ_LOCK_ASSERT_HELD(ifq);
-
-	fqs = (fq_if_t *)ifq->ifcq_disc;
+	FQS_LOCK_ASSERT_HELD(fqs);
 	STAILQ_INIT(&fq_dqlist_head);
 
 	switch (fqs->fqs_ptype) {
@@ -567,17 +651,13 @@ state_change:
 	if (retbytecnt != NULL) {
 		*retbytecnt = total_bytecnt;
 	}
-
-	IFCQ_XMIT_ADD(ifq, total_pktcnt, total_bytecnt);
-	return 0;
 }
 
-int
-fq_if_dequeue_sc_classq_multi(struct ifclassq *ifq, mbuf_svc_class_t svc,
+static void
+fq_if_dequeue_sc_multi(fq_if_t *fqs, mbuf_svc_class_t svc,
     u_int32_t maxpktcnt, u_int32_t maxbytecnt, classq_pkt_t *first_packet,
     classq_pkt_t *last_packet, u_int32_t *retpktcnt, u_int32_t *retbytecnt)
 {
-	fq_if_t *fqs = (fq_if_t *)ifq->ifcq_disc;
 	uint8_t pri;
 	u_int32_t total_pktcnt = 0, total_bytecnt = 0;
 	fq_if_classq_t *fq_cl;
@@ -642,6 +722,162 @@ fq_if_dequeue_sc_classq_multi(struct ifclassq *ifq, mbuf_svc_class_t svc,
 	if (retbytecnt != NULL) {
 		*retbytecnt = total_bytecnt;
 	}
+}
+
+/*
+ * Deficit round robin across the instances of a multi-queue set.  Each
+ * visit to a backlogged instance credits it with one quantum per active
+ * flow, so that a flow gets the same share of the link regardless of how
+ * many other flows were hashed onto its instance.
+ */
+static void
+fq_if_mq_dequeue(fq_if_mq_t *fqm, mbuf_svc_class_t svc, boolean_t drvmgt,
+    u_int32_t maxpktcnt, u_int32_t maxbytecnt, classq_pkt_t *first_packet,
+    classq_pkt_t *last_packet, u_int32_t *retpktcnt, u_int32_t *retbytecnt)
+{
+	classq_pkt_t first = CLASSQ_PKT_INITIALIZER(first);
+	classq_pkt_t last = CLASSQ_PKT_INITIALIZER(last);
+	uint32_t total_pktcnt = 0, total_bytecnt = 0;
+	uint32_t idle = 0;
+	fq_if_t *fqs;
+
+	while (total_pktcnt < maxpktcnt && total_bytecnt < maxbytecnt &&
+	    idle < fqm->fqm_count) {
+		classq_pkt_t head = CLASSQ_PKT_INITIALIZER(head);
+		classq_pkt_t tail = CLASSQ_PKT_INITIALIZER(tail);
+		uint32_t pktcnt = 0, bytecnt = 0, bytelimit;
+		boolean_t more = FALSE;
+
+		fqs = fqm->fqm_queues[fqm->fqm_next];
+		FQS_LOCK_SPIN(fqs);
+		if (fqs->fqs_len == 0) {
+			/* an idle instance does not accumulate credit */
+			fqs->fqs_mq_deficit = 0;
+			FQS_UNLOCK(fqs);
+			idle++;
+			goto next;
+		}
+		while (fqs->fqs_mq_deficit <= 0) {
+			fqs->fqs_mq_deficit += (int64_t)fqm->fqm_quantum *
+			    MAX(1, fq_if_mq_active_flows(fqs));
+		}
+		bytelimit = (uint32_t)MIN(maxbytecnt - total_bytecnt,
+		    (uint64_t)fqs->fqs_mq_deficit);
+
+		if (drvmgt) {
+			fq_if_dequeue_sc_multi(fqs, svc,
+			    (maxpktcnt - total_pktcnt), bytelimit, &head, &tail,
+			    &pktcnt, &bytecnt);
+		} else {
+			fq_if_dequeue_multi(fqs, (maxpktcnt - total_pktcnt),
+			    bytelimit, &head, &tail, &pktcnt, &bytecnt);
+		}
+		fqs->fqs_mq_deficit -= bytecnt;
+		more = (fqs->fqs_mq_deficit > 0 && fqs->fqs_len > 0);
+		FQS_UNLOCK(fqs);
+
+		if (head.cp_mbuf == NULL) {
+			idle++;
+			goto next;
+		}
+		idle = 0;
+		if (first.cp_mbuf == NULL) {
+			first = head;
+		} else {
+			ASSERT(last.cp_mbuf != NULL);
+			fq_if_append_mbuf(&last, &head);
+		}
+		last = tail;
+		total_pktcnt += pktcnt;
+		total_bytecnt += bytecnt;
+		if (more) {
+			/* stay on this instance until its deficit is used */
+			continue;
+		}
+next:
+		fqm->fqm_next = (fqm->fqm_next + 1) % fqm->fqm_count;
+	}
+
+	*first_packet = first;
+	*last_packet = last;
+	*retpktcnt = total_pktcnt;
+	*retbytecnt = total_bytecnt;
+}
+
+int
+fq_if_dequeue_classq_multi(struct ifclassq *ifq, u_int32_t maxpktcnt,
+    u_int32_t maxbytecnt, classq_pkt_t *first_packet,
+    classq_pkt_t *last_packet, u_int32_t *retpktcnt,
+    u_int32_t *retbytecnt)
+{
+	fq_if_t *fqs = (fq_if_t *)ifq->ifcq_disc;
+	classq_pkt_t first = CLASSQ_PKT_INITIALIZER(first);
+	classq_pkt_t last = CLASSQ_PKT_INITIALIZER(last);
+	uint32_t total_pktcnt = 0, total_bytecnt = 0;
+
+	IFCQ_LOCK_ASSERT_HELD(ifq);
+
+	if (FQS_IS_MULTIQ(fqs)) {
+		/* the instance locks may be converted while held */
+		IFCQ_CONVERT_LOCK(ifq);
+		fq_if_mq_dequeue(fqs->fqs_mq, MBUF_SC_UNSPEC, FALSE,
+		    maxpktcnt, maxbytecnt, &first, &last, &total_pktcnt,
+		    &total_bytecnt);
+	} else {
+		fq_if_dequeue_multi(fqs, maxpktcnt, maxbytecnt, &first, &last,
+		    &total_pktcnt, &total_bytecnt);
+	}
+
+	if (__probable(first_packet != NULL)) {
+		*first_packet = first;
+	}
+	if (last_packet != NULL) {
+		*last_packet = last;
+	}
+	if (retpktcnt != NULL) {
+		*retpktcnt = total_pktcnt;
+	}
+	if (retbytecnt != NULL) {
+		*retbytecnt = total_bytecnt;
+	}
+
+	IFCQ_XMIT_ADD(ifq, total_pktcnt, total_bytecnt);
+	return 0;
+}
+
+int
+fq_if_dequeue_sc_classq_multi(struct ifclassq *ifq, mbuf_svc_class_t svc,
+    u_int32_t maxpktcnt, u_int32_t maxbytecnt, classq_pkt_t *first_packet,
+    classq_pkt_t *last_packet, u_int32_t *retpktcnt, u_int32_t *retbytecnt)
+{
+	fq_if_t *fqs = (fq_if_t *)ifq->ifcq_disc;
+	classq_pkt_t first = CLASSQ_PKT_INITIALIZER(first);
+	classq_pkt_t last = CLASSQ_PKT_INITIALIZER(last);
+	uint32_t total_pktcnt = 0, total_bytecnt = 0;
+
+	IFCQ_LOCK_ASSERT_HELD(ifq);
+
+	if (FQS_IS_MULTIQ(fqs)) {
+		IFCQ_CONVERT_LOCK(ifq);
+		fq_if_mq_dequeue(fqs->fqs_mq, svc, TRUE, maxpktcnt,
+		    maxbytecnt, &first, &last, &total_pktcnt, &total_bytecnt);
+	} else {
+		fq_if_dequeue_sc_multi(fqs, svc, maxpktcnt, maxbytecnt,
+		    &first, &last, &total_pktcnt, &total_bytecnt);
+	}
+
+	if (__probable(first_packet != NULL)) {
+		*first_packet = first;
+	}
+	if (last_packet != NULL) {
+		*last_packet = last;
+	}
+	if (retpktcnt != NULL) {
+		*retpktcnt = total_pktcnt;
+	}
+	if (retbytecnt != NULL) {
+		*retbytecnt = total_bytecnt;
+	}
 
 	IFCQ_XMIT_ADD(ifq, total_pktcnt, total_bytecnt);
 
@@ -669,7 +905,7 @@ fq_if_purge_flow(fq_if_t *fqs, fq_t *fq, u_int32_t *pktsp,
 		bytes += pktsched_get_pkt_len(&pkt);
 		pktsched_free_pkt(&pkt);
 	}
-	IFCQ_DROP_ADD(fqs->fqs_ifq, pkts, bytes);
+	FQ_IF_DROP_ADD(fqs, pkts, bytes);
 
 	if (fq->fq_flags & FQF_NEW_FLOW) {
 		fq_if_empty_new_flow(fq, fq_cl, false);
@@ -721,7 +957,7 @@ fq_if_purge(fq_if_t *fqs)
 {
 	int i;
 
-	IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+	FQS_CONVERT_LOCK(fqs);
 	for (i = 0; i < FQ_IF_MAX_CLASSES; i++) {
 		fq_if_purge_classq(fqs, &fqs->fqs_classq[i]);
 	}
@@ -735,8 +971,17 @@ fq_if_purge(fq_if_t *fqs)
 
 	bzero(&fqs->fqs_bitmaps, sizeof(fqs->fqs_bitmaps));
 
-	IFCQ_LEN(fqs->fqs_ifq) = 0;
-	IFCQ_BYTES(fqs->fqs_ifq) = 0;
+	/*
+	 * The instances of a multi-queue set have already backed their
+	 * packets out of the shared counters one at a time above.
+	 */
+	if (!FQS_IS_MULTIQ(fqs)) {
+		IFCQ_LEN(fqs->fqs_ifq) = 0;
+		IFCQ_BYTES(fqs->fqs_ifq) = 0;
+	}
+	ASSERT(fqs->fqs_len == 0);
+	fqs->fqs_len = 0;
+	fqs->fqs_bytes = 0;
 }
 
 static void
@@ -744,7 +989,7 @@ fq_if_purge_sc(fq_if_t *fqs, cqrq_purge_sc_t *req)
 {
 	fq_t *fq;
 
-	IFCQ_LOCK_ASSERT_HELD(fqs->fqs_ifq);
+	FQS_LOCK_ASSERT_HELD(fqs);
 	req->packets = req->bytes = 0;
 	VERIFY(req->flow != 0);
 
@@ -831,7 +1076,7 @@ fq_if_mtu_update(fq_if_t *fqs)
 static void
 fq_if_event(fq_if_t *fqs, cqev_t ev)
 {
-	IFCQ_LOCK_ASSERT_HELD(fqs->fqs_ifq);
+	FQS_LOCK_ASSERT_HELD(fqs);
 
 	switch (ev) {
 	case CLASSQ_EV_LINK_UP:
@@ -866,12 +1111,9 @@ fq_if_classq_resume(fq_if_t *fqs, fq_if_classq_t *fq_cl)
 static int
 fq_if_throttle(fq_if_t *fqs, cqrq_throttle_t *tr)
 {
-	struct ifclassq *ifq = fqs->fqs_ifq;
 	uint8_t index;
-#if !MACH_ASSERT
-#pragma unused(ifq)
-#endif
-	IFCQ_LOCK_ASSERT_HELD(ifq);
+
+	FQS_LOCK_ASSERT_HELD(fqs);
 
 	if (!tr->set) {
 		tr->level = fqs->fqs_throttle;
@@ -913,18 +1155,15 @@ fq_if_stat_sc(fq_if_t *fqs, cqrq_stat_sc_t *stat)
 	stat->bytes = (uint32_t)fq_cl->fcl_stat.fcl_byte_cnt;
 }
 
-int
-fq_if_request_classq(struct ifclassq *ifq, cqrq_t rq, void *arg)
+static int
+fq_if_request(fq_if_t *fqs, cqrq_t rq, void *arg)
 {
 	int err = 0;
-	fq_if_t *fqs = (fq_if_t *)ifq->ifcq_disc;
-
-	IFCQ_LOCK_ASSERT_HELD(ifq);
 
 	/*
 	 * These are usually slow operations, convert the lock ahead of time
 	 */
-	IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+	FQS_CONVERT_LOCK(fqs);
 	switch (rq) {
 	case CLASSQRQ_PURGE:
 		fq_if_purge(fqs);
@@ -945,31 +1184,84 @@ fq_if_request_classq(struct ifclassq *ifq, cqrq_t rq, void *arg)
 	return err;
 }
 
-int
-fq_if_setup_ifclassq(struct ifclassq *ifq, u_int32_t flags,
-    classq_pkt_type_t ptype)
+static int
+fq_if_mq_request(fq_if_mq_t *fqm, cqrq_t rq, void *arg)
 {
-#pragma unused(flags)
-#define _FQ_CLASSQ_INIT(_fqs, _s, _q)                         \
-	fq_if_classq_init((_fqs), FQ_IF_ ## _s ## _INDEX,     \
-	FQ_CODEL_QUANTUM_ ## _s(_q), FQ_CODEL_DRR_MAX_ ## _s, \
-	MBUF_SC_ ## _s )
-
-	struct ifnet *ifp = ifq->ifcq_ifp;
-	fq_if_t *fqs = NULL;
-	uint16_t quantum;
+	cqrq_stat_sc_t *stat = NULL, sc_stat;
+	fq_if_t *fqs;
+	uint32_t i;
 	int err = 0;
 
+	switch (rq) {
+	case CLASSQRQ_PURGE_SC:
+		/* a flow only ever lives on one instance */
+		fqs = fq_if_mq_select(fqm->fqm_queues[0],
+		    ((cqrq_purge_sc_t *)arg)->flow);
+		FQS_LOCK(fqs);
+		err = fq_if_request(fqs, rq, arg);
+		FQS_UNLOCK(fqs);
+		return err;
+
+	case CLASSQRQ_THROTTLE:
+		if (!((cqrq_throttle_t *)arg)->set) {
+			fqs = fqm->fqm_queues[0];
+			FQS_LOCK(fqs);
+			err = fq_if_request(fqs, rq, arg);
+			FQS_UNLOCK(fqs);
+			return err;
+		}
+		break;
+
+	case CLASSQRQ_STAT_SC:
+		stat = (cqrq_stat_sc_t *)arg;
+		stat->packets = stat->bytes = 0;
+		sc_stat.sc = stat->sc;
+		arg = &sc_stat;
+		break;
+
+	default:
+		break;
+	}
+
+	for (i = 0; i < fqm->fqm_count; i++) {
+		fqs = fqm->fqm_queues[i];
+		FQS_LOCK(fqs);
+		err = fq_if_request(fqs, rq, arg);
+		FQS_UNLOCK(fqs);
+		if (stat != NULL) {
+			stat->packets += sc_stat.packets;
+			stat->bytes += sc_stat.bytes;
+		}
+	}
+
+	if (rq == CLASSQRQ_EVENT && (cqev_t)arg == CLASSQ_EV_LINK_MTU) {
+		fqm->fqm_quantum =
+		    fq_if_calc_quantum(fqm->fqm_queues[0]->fqs_ifq->ifcq_ifp);
+	}
+	return err;
+}
+
+int
+fq_if_request_classq(struct ifclassq *ifq, cqrq_t rq, void *arg)
+{
+	fq_if_t *fqs = (fq_if_t *)ifq->ifcq_disc;
+
 	IFCQ_LOCK_ASSERT_HELD(ifq);
-	VERIFY(ifq->ifcq_disc == NULL);
-	VERIFY(ifq->ifcq_type == PKTSCHEDT_NONE);
 
-	fqs = fq_if_alloc(ifp, ptype);
-	if (fqs == NULL) {
-		return ENOMEM;
+	if (FQS_IS_MULTIQ(fqs)) {
+		IFCQ_CONVERT_LOCK(ifq);
+		return fq_if_mq_request(fqs->fqs_mq, rq, arg);
 	}
+	return fq_if_request(fqs, rq, arg);
+}
 
-	quantum = fq_if_calc_quantum(ifp);
+static void
+fq_if_setup_classes(fq_if_t *fqs, u_int32_t flags, uint16_t quantum)
+{
+#define _FQ_CLASSQ_INIT(_fqs, _s, _q)                         \
+	fq_if_classq_init((_fqs), FQ_IF_ ## _s ## _INDEX,     \
+	FQ_CODEL_QUANTUM_ ## _s(_q), FQ_CODEL_DRR_MAX_ ## _s, \
+	MBUF_SC_ ## _s )
 
 	if (flags & PKTSCHEDF_QALG_DRIVER_MANAGED) {
 		fqs->fqs_flags |= FQS_DRIVER_MANAGED;
@@ -993,15 +1285,84 @@ fq_if_setup_ifclassq(struct ifclassq *ifq, u_int32_t flags,
 		_FQ_CLASSQ_INIT(fqs, VO, quantum);
 		_FQ_CLASSQ_INIT(fqs, CTL, quantum);
 	}
+#undef _FQ_CLASSQ_INIT
+}
+
+static fq_if_t *
+fq_if_mq_alloc(struct ifnet *ifp, classq_pkt_type_t ptype, uint32_t count,
+    u_int32_t flags, uint16_t quantum)
+{
+	fq_if_mq_t *fqm;
+	fq_if_t *fqs;
+	uint32_t i;
+
+	VERIFY(count > 1 && count <= FQ_IF_MQ_MAX);
+
+	fqm = zalloc_flags(fq_if_mq_zone, Z_WAITOK | Z_ZERO);
+	fqm->fqm_count = count;
+	fqm->fqm_seed = RandomULong();
+	fqm->fqm_quantum = quantum;
+
+	for (i = 0; i < count; i++) {
+		fqs = fq_if_alloc(ifp, ptype);
+		lck_mtx_init(&fqs->fqs_mq_lock, &fq_if_mq_lock_group,
+		    LCK_ATTR_NULL);
+		fqs->fqs_lock = &fqs->fqs_mq_lock;
+		fqs->fqs_mq = fqm;
+		/* each instance gets an equal share of the drop limit */
+		fqs->fqs_pkt_droplimit = MAX(1, fqs->fqs_pkt_droplimit / count);
+		fq_if_setup_classes(fqs, flags, quantum);
+		fqm->fqm_queues[i] = fqs;
+	}
+
+	/* the ifclassq refers to the set through its first instance */
+	return fqm->fqm_queues[0];
+}
+
+static void
+fq_if_destroy_all(fq_if_t *fqs)
+{
+	if (FQS_IS_MULTIQ(fqs)) {
+		fq_if_mq_destroy(fqs->fqs_mq);
+	} else {
+		fq_if_destroy(fqs);
+	}
+}
+
+int
+fq_if_setup_ifclassq(struct ifclassq *ifq, u_int32_t flags,
+    classq_pkt_type_t ptype)
+{
+	struct ifnet *ifp = ifq->ifcq_ifp;
+	fq_if_t *fqs = NULL;
+	uint16_t quantum;
+	uint32_t count;
+	int err = 0;
+
+	IFCQ_LOCK_ASSERT_HELD(ifq);
+	VERIFY(ifq->ifcq_disc == NULL);
+	VERIFY(ifq->ifcq_type == PKTSCHEDT_NONE);
+
+	quantum = fq_if_calc_quantum(ifp);
+	count = MIN(fq_if_mq_count, FQ_IF_MQ_MAX);
+
+	if (count > 1) {
+		fqs = fq_if_mq_alloc(ifp, ptype, count, flags, quantum);
+	} else {
+		fqs = fq_if_alloc(ifp, ptype);
+		if (fqs == NULL) {
+			return ENOMEM;
+		}
+		fq_if_setup_classes(fqs, flags, quantum);
+	}
 
 	err = ifclassq_attach(ifq, PKTSCHEDT_FQ_CODEL, fqs);
 	if (err != 0) {
 		os_log_error(OS_LOG_DEFAULT, "%s: error from ifclassq_attach, "
 		    "failed to attach fq_if: %d\n", __func__, err);
-		fq_if_destroy(fqs);
+		fq_if_destroy_all(fqs);
 	}
 	return err;
-#undef _FQ_CLASSQ_INIT
 }
 
 fq_t *
@@ -1030,7 +1391,7 @@ fq_if_hash_pkt(fq_if_t *fqs, u_int32_t flowid, mbuf_svc_class_t svc_class,
 		ASSERT(ptype == QP_MBUF);
 
 		/* If the flow is not already on the list, allocate it */
-		IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+		FQS_CONVERT_LOCK(fqs);
 		fq = fq_alloc(ptype);
 		if (fq != NULL) {
 			fq->fq_flowhash = flowid;
@@ -1063,7 +1424,7 @@ fq_if_destroy_flow(fq_if_t *fqs, fq_if_classq_t *fq_cl, fq_t *fq,
 	SLIST_REMOVE(&fqs->fqs_flows[hash_id], fq, flowq,
 	    fq_hashlink);
 	fq_cl->fcl_stat.fcl_flows_cnt--;
-	IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+	FQS_CONVERT_LOCK(fqs);
 	fq->fq_flags |= FQF_DESTROYED;
 	if (destroy_now) {
 		fq_destroy(fq);
@@ -1073,8 +1434,10 @@ fq_if_destroy_flow(fq_if_t *fqs, fq_if_classq_t *fq_cl, fq_t *fq,
 inline boolean_t
 fq_if_at_drop_limit(fq_if_t *fqs)
 {
-	return (IFCQ_LEN(fqs->fqs_ifq) >= fqs->fqs_pkt_droplimit) ?
-	       TRUE : FALSE;
+	uint32_t len;
+
+	len = FQS_IS_MULTIQ(fqs) ? fqs->fqs_len : IFCQ_LEN(fqs->fqs_ifq);
+	return (len >= fqs->fqs_pkt_droplimit) ? TRUE : FALSE;
 }
 
 static void
@@ -1137,7 +1500,7 @@ fq_if_drop_packet(fq_if_t *fqs)
 	pktsched_get_pkt_vars(&pkt, &pkt_flags, &pkt_timestamp, NULL, NULL,
 	    NULL, NULL);
 
-	IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+	FQS_CONVERT_LOCK(fqs);
 	*pkt_timestamp = 0;
 	switch (pkt.pktsched_ptype) {
 	case QP_MBUF:
@@ -1158,7 +1521,7 @@ fq_if_drop_packet(fq_if_t *fqs)
 			fq_if_empty_new_flow(fq, fq_cl, true);
 		}
 	}
-	IFCQ_DROP_ADD(fqs->fqs_ifq, 1, pktsched_get_pkt_len(&pkt));
+	FQ_IF_DROP_ADD(fqs, 1, pktsched_get_pkt_len(&pkt));
 
 	pktsched_free_pkt(&pkt);
 	fq_cl->fcl_stat.fcl_drop_overflow++;
@@ -1209,7 +1572,7 @@ fq_if_add_fcentry(fq_if_t *fqs, pktsched_pkt_t *pkt, uint8_t flowsrc,
 			return TRUE;
 		}
 	}
-	IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+	FQS_CONVERT_LOCK(fqs);
 	fce = pktsched_alloc_fcentry(pkt, fqs->fqs_ifq->ifcq_ifp, M_WAITOK);
 	if (fce != NULL) {
 		/* XXX Add number of bytes in the queue */
@@ -1229,7 +1592,7 @@ fq_if_flow_feedback(fq_if_t *fqs, fq_t *fq, fq_if_classq_t *fq_cl)
 {
 	struct flowadv_fcentry *fce = NULL;
 
-	IFCQ_CONVERT_LOCK(fqs->fqs_ifq);
+	FQS_CONVERT_LOCK(fqs);
 	STAILQ_FOREACH(fce, &fqs->fqs_fclist, fce_link) {
 		if (fce->fce_flowid == fq->fq_flowhash) {
 			break;
@@ -1384,7 +1747,7 @@ fq_if_teardown_ifclassq(struct ifclassq *ifq)
 	IFCQ_LOCK_ASSERT_HELD(ifq);
 	VERIFY(fqs != NULL && ifq->ifcq_type == PKTSCHEDT_FQ_CODEL);
 
-	fq_if_destroy(fqs);
+	fq_if_destroy_all(fqs);
 	ifq->ifcq_disc = NULL;
 	ifclassq_detach(ifq);
 }
@@ -1414,23 +1777,14 @@ fq_export_flowstats(fq_if_t *fqs, fq_t *fq,
 	}
 }
 
-int
-fq_if_getqstats_ifclassq(struct ifclassq *ifq, u_int32_t qid,
-    struct if_ifclassq_stats *ifqs)
+static void
+fq_if_export_classstats(fq_if_t *fqs, u_int32_t qid,
+    struct fq_codel_classstats *fcls)
 {
-	struct fq_codel_classstats *fcls;
 	fq_if_classq_t *fq_cl;
-	fq_if_t *fqs;
 	fq_t *fq = NULL;
 	u_int32_t i, flowstat_cnt;
 
-	if (qid >= FQ_IF_MAX_CLASSES) {
-		return EINVAL;
-	}
-
-	fqs = (fq_if_t *)ifq->ifcq_disc;
-	fcls = &ifqs->ifqs_fq_codel_stats;
-
 	fq_cl = &fqs->fqs_classq[qid];
 
 	fcls->fcls_pri = fq_cl->fcl_pri;
@@ -1488,5 +1842,80 @@ fq_if_getqstats_ifclassq(struct ifclassq *ifq, u_int32_t qid,
 	}
 	VERIFY(i <= flowstat_cnt);
 	fcls->fcls_flowstats_cnt = i;
+}
+
+/*
+ * Fold the class statistics of another instance of a multi-queue set
+ * into those already gathered; configuration fields are left alone.
+ */
+static void
+fq_if_mq_merge_classstats(struct fq_codel_classstats *fcls,
+    const struct fq_codel_classstats *other)
+{
+	u_int32_t i;
+
+	fcls->fcls_budget += other->fcls_budget;
+	fcls->fcls_flow_control += other->fcls_flow_control;
+	fcls->fcls_flow_feedback += other->fcls_flow_feedback;
+	fcls->fcls_dequeue_stall += other->fcls_dequeue_stall;
+	fcls->fcls_flow_control_fail += other->fcls_flow_control_fail;
+	fcls->fcls_drop_overflow += other->fcls_drop_overflow;
+	fcls->fcls_drop_early += other->fcls_drop_early;
+	fcls->fcls_drop_memfailure += other->fcls_drop_memfailure;
+	fcls->fcls_flows_cnt += other->fcls_flows_cnt;
+	fcls->fcls_newflows_cnt += other->fcls_newflows_cnt;
+	fcls->fcls_oldflows_cnt += other->fcls_oldflows_cnt;
+	fcls->fcls_pkt_cnt += other->fcls_pkt_cnt;
+	fcls->fcls_dequeue += other->fcls_dequeue;
+	fcls->fcls_dequeue_bytes += other->fcls_dequeue_bytes;
+	fcls->fcls_byte_cnt += other->fcls_byte_cnt;
+	fcls->fcls_throttle_on += other->fcls_throttle_on;
+	fcls->fcls_throttle_off += other->fcls_throttle_off;
+	fcls->fcls_throttle_drops += other->fcls_throttle_drops;
+	fcls->fcls_dup_rexmts += other->fcls_dup_rexmts;
+	fcls->fcls_pkts_compressible += other->fcls_pkts_compressible;
+	fcls->fcls_pkts_compressed += other->fcls_pkts_compressed;
+
+	for (i = 0; i < other->fcls_flowstats_cnt &&
+	    fcls->fcls_flowstats_cnt < FQ_IF_MAX_FLOWSTATS; i++) {
+		fcls->fcls_flowstats[fcls->fcls_flowstats_cnt++] =
+		    other->fcls_flowstats[i];
+	}
+}
+
+int
+fq_if_getqstats_ifclassq(struct ifclassq *ifq, u_int32_t qid,
+    struct if_ifclassq_stats *ifqs)
+{
+	struct fq_codel_classstats *fcls, other;
+	fq_if_mq_t *fqm;
+	fq_if_t *fqs;
+	u_int32_t i;
+
+	if (qid >= FQ_IF_MAX_CLASSES) {
+		return EINVAL;
+	}
+
+	fqs = (fq_if_t *)ifq->ifcq_disc;
+	fcls = &ifqs->ifqs_fq_codel_stats;
+
+	if (!FQS_IS_MULTIQ(fqs)) {
+		fq_if_export_classstats(fqs, qid, fcls);
+		return 0;
+	}
+
+	fqm = fqs->fqs_mq;
+	for (i = 0; i < fqm->fqm_count; i++) {
+		fqs = fqm->fqm_queues[i];
+		FQS_LOCK(fqs);
+		if (i == 0) {
+			fq_if_export_classstats(fqs, qid, fcls);
+		} else {
+			bzero(&other, sizeof(other));
+			fq_if_export_classstats(fqs, qid, &other);
+			fq_if_mq_merge_classstats(fcls, &other);
+		}
+		FQS_UNLOCK(fqs);
+	}
 	return 0;
 }
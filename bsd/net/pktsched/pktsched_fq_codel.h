@@ -127,8 +127,11 @@ typedef struct fq_if_classq {
 	struct fcl_stat fcl_stat;
 } fq_if_classq_t;
 
+struct fq_if_mq;
+
 typedef struct fq_codel_sched_data {
 	struct ifclassq *fqs_ifq;       /* back pointer to ifclassq */
+	lck_mtx_t       *fqs_lock;      /* ifcq_lock or fqs_mq_lock */
 	u_int64_t       fqs_target_qdelay;      /* Target queue delay (ns) */
 	u_int64_t       fqs_update_interval;    /* update interval (ns) */
 	flowq_list_t    fqs_flows[FQ_IF_HASH_TABLE_SIZE]; /* flows table */
@@ -141,8 +144,52 @@ typedef struct fq_codel_sched_data {
 	struct flowadv_fclist   fqs_fclist; /* flow control state */
 	struct flowq    *fqs_large_flow; /* flow has highest number of bytes */
 	classq_pkt_type_t       fqs_ptype;
+	u_int32_t       fqs_len;        /* packets in this instance */
+	u_int32_t       fqs_bytes;      /* bytes in this instance */
+	/* multi-queue state, only valid when fqs_mq is non-NULL */
+	struct fq_if_mq *fqs_mq;        /* owning multi-queue set */
+	int64_t         fqs_mq_deficit; /* DRR deficit across instances */
+	decl_lck_mtx_data(, fqs_mq_lock); /* per-instance lock */
 } fq_if_t;
 
+/*
+ * Multi-queue fq_codel: a set of independent fq_if_t instances that share
+ * one ifclassq.  Flows are hashed onto an instance, and each instance has
+ * its own lock so that senders on different CPUs only contend when their
+ * flows land on the same instance.  The dequeue side (which still runs
+ * under the ifclassq lock) visits the instances with a deficit round robin
+ * whose quantum is scaled by the number of active flows in the instance,
+ * which keeps the bandwidth share per flow rather than per instance.
+ */
+#define FQ_IF_MQ_MAX            16
+
+typedef struct fq_if_mq {
+	u_int32_t       fqm_count;      /* number of instances */
+	u_int32_t       fqm_next;       /* next instance for DRR */
+	u_int32_t       fqm_seed;       /* flow hash seed */
+	u_int32_t       fqm_quantum;    /* per-flow DRR quantum (bytes) */
+	fq_if_t         *fqm_queues[FQ_IF_MQ_MAX];
+} fq_if_mq_t;
+
+#define FQS_LOCK_ASSERT_HELD(_fqs)                                      \
+	LCK_MTX_ASSERT((_fqs)->fqs_lock, LCK_MTX_ASSERT_OWNED)
+
+#define FQS_LOCK(_fqs)                                                  \
+	lck_mtx_lock((_fqs)->fqs_lock)
+
+#define FQS_LOCK_SPIN(_fqs)                                             \
+	lck_mtx_lock_spin((_fqs)->fqs_lock)
+
+#define FQS_CONVERT_LOCK(_fqs) do {                                     \
+	FQS_LOCK_ASSERT_HELD(_fqs);                                     \
+	lck_mtx_convert_spin((_fqs)->fqs_lock);                         \
+} while (0)
+
+#define FQS_UNLOCK(_fqs)                                                \
+	lck_mtx_unlock((_fqs)->fqs_lock)
+
+#define FQS_IS_MULTIQ(_fqs)     ((_fqs)->fqs_mq != NULL)
+
 #endif /* BSD_KERNEL_PRIVATE */
 
 struct fq_codel_flowstats {
@@ -469,6 +469,8 @@ route_init(void)
 	rte_zone = zone_create(RTE_ZONE_NAME, size, ZC_NOENCRYPT);
 
 	TAILQ_INIT(&rttrash_head);
+
+	rt_fib_init();
 }
 
 /*
@@ -2045,6 +2047,12 @@ rtrequest_common_locked(int req, struct sockaddr *dst0,
 
 		RT_UNLOCK(rt);
 
+		/*
+		 * Take it out of the forwarding trie before the reference
+		 * held above can go away; this waits for lock-free readers.
+		 */
+		rt_fib_delete_locked(rt);
+
 		/*
 		 * This might result in another rtentry being freed if
 		 * we held its last reference.  Do this after the rtentry
@@ -2405,6 +2413,7 @@ makeroute:
 			RT_UNLOCK(rt);
 		}
 
+		rt_fib_insert_locked(rt);
 		nstat_route_new_entry(rt);
 		break;
 	}
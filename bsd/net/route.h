@@ -235,6 +235,7 @@ struct rtentry {
 	u_int8_t rtt_index;             /* Index into RTT history */
 	/* Event handler context for the rtentrt */
 	struct eventhandler_lists_ctxt rt_evhdlr_ctxt;
+	uint32_t rt_fibidx;             /* forwarding trie value, or 0 */
 };
 
 enum {
@@ -652,6 +653,13 @@ extern boolean_t rt_ifa_is_dst(struct sockaddr *, struct ifaddr *);
 extern struct sockaddr *sa_copy(struct sockaddr *, struct sockaddr_storage *,
     unsigned int *);
 
+/* lock-free forwarding trie mirroring the radix trees, see route_fib.c */
+extern void rt_fib_init(void);
+extern void rt_fib_insert_locked(struct rtentry *);
+extern void rt_fib_delete_locked(struct rtentry *);
+extern struct rtentry *rt_fib_lookup(int, const void *);
+extern boolean_t rt_fib_alloc(struct route *, unsigned int);
+
 /*
  * The following is used to enqueue work items for route events
  * and also used to pass route event while walking the tree
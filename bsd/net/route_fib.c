@@ -0,0 +1,652 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Lock-free forwarding lookups.
+ *
+ * When net.route.fib is set, every unscoped IPv4 and IPv6 route in the
+ * radix trees is mirrored into a multibit trie (see fib_trie.h) whose
+ * leaves index a table of rtentry pointers.  The radix trees remain the
+ * source of truth: the mirror is updated from rtrequest_common_locked()
+ * while rnh_lock is held, and any lookup the mirror cannot answer
+ * exactly is handed back to the caller, which falls back to the radix
+ * path.  That covers scoped lookups, routes that need cloning, routes
+ * whose lock is contended, and address families that saw a
+ * non-contiguous netmask or an allocation failure.
+ *
+ * Readers take no lock.  Each one publishes the current epoch in its
+ * per-CPU slot with preemption disabled for the duration of the lookup.
+ * Writers unlink first, then bump the epoch and wait for every slot that
+ * still shows an older epoch (rt_fib_synchronize()) before freeing trie
+ * memory or reusing a table index.  The table does not hold references
+ * on the routes: a route leaves the mirror, and the writer waits out the
+ * readers, before RTM_DELETE drops the reference that keeps it alive.
+ * A reader that found a route try-locks it inside the epoch section;
+ * once it holds the route lock the route cannot be freed underneath it,
+ * so the reference is taken after the section has ended, exactly as
+ * rt_lookup() does it.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/kernel.h>
+#include <sys/sysctl.h>
+#include <sys/socket.h>
+#include <sys/mcache.h>
+#include <kern/epoch.h>
+#include <kern/kalloc.h>
+#include <kern/locks.h>
+#include <machine/atomic.h>
+
+#include <net/if.h>
+#include <net/radix.h>
+#include <net/route.h>
+#include <net/fib_trie.h>
+
+#include <netinet/in.h>
+#include <netinet6/in6_var.h>
+
+/* value (trie leaf) to route table; replaced as a whole when it grows */
+struct rt_fib_nhtab {
+	struct rt_fib_nhtab     *rfn_retired;
+	uint32_t                rfn_size;
+	struct rtentry          *rfn_rt[];
+};
+
+struct rt_fib {
+	struct fib_trie         *rf_trie;       /* NULL unless enabled */
+	struct rt_fib_nhtab     *rf_nhtab;
+	struct rt_fib_nhtab     *rf_nhtab_retired;
+	uint32_t                *rf_nh_free;    /* reusable values */
+	uint32_t                rf_nh_nfree;
+	uint32_t                *rf_nh_pending; /* released, not yet reusable */
+	uint32_t                rf_nh_npending;
+	uint32_t                rf_nh_next;     /* next never-used value */
+	uint32_t                rf_count;       /* # of routes mirrored */
+	uint32_t                rf_keylen;      /* key length in bits */
+	boolean_t               rf_broken;      /* mirror can't be trusted */
+};
+
+#define RT_FIB_NH_INITIAL       1024
+
+static struct rt_fib rt_fib_inet = { .rf_keylen = 32 };
+static struct rt_fib rt_fib_inet6 = { .rf_keylen = 128 };
+
+static struct epoch rt_fib_epoch;
+
+static int rt_fib_enabled = 0;
+
+static int sysctl_rt_fib SYSCTL_HANDLER_ARGS;
+static int sysctl_rt_fib_stats SYSCTL_HANDLER_ARGS;
+
+SYSCTL_DECL(_net_route);
+SYSCTL_PROC(_net_route, OID_AUTO, fib,
+    CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_LOCKED, &rt_fib_enabled, 0,
+    sysctl_rt_fib, "I", "Serve forwarding lookups from a lock-free trie");
+SYSCTL_PROC(_net_route, OID_AUTO, fib_stats,
+    CTLTYPE_STRUCT | CTLFLAG_RD | CTLFLAG_LOCKED, 0, 0,
+    sysctl_rt_fib_stats, "S,rt_fib_stats", "Forwarding trie statistics");
+
+/* exported via net.route.fib_stats, one per address family */
+struct rt_fib_stats {
+	uint32_t        rfs_routes;
+	uint32_t        rfs_chunks;
+	uint32_t        rfs_broken;
+	uint64_t        rfs_memory;
+};
+
+void
+rt_fib_init(void)
+{
+	epoch_init(&rt_fib_epoch);
+}
+
+static inline struct rt_fib *
+rt_fib_af(int af)
+{
+	switch (af) {
+	case AF_INET:
+		return &rt_fib_inet;
+	case AF_INET6:
+		return &rt_fib_inet6;
+	default:
+		return NULL;
+	}
+}
+
+static inline const uint8_t *
+rt_fib_key(struct sockaddr *sa)
+{
+	if (sa->sa_family == AF_INET) {
+		return (const uint8_t *)&SIN(sa)->sin_addr;
+	}
+	return (const uint8_t *)&SIN6(sa)->sin6_addr;
+}
+
+/*
+ * Read-side critical section.  Preemption stays disabled throughout,
+ * which bounds how long rt_fib_synchronize() can spin.
+ */
+static inline void
+rt_fib_enter(void)
+{
+	epoch_enter(&rt_fib_epoch);
+}
+
+static inline void
+rt_fib_exit(void)
+{
+	epoch_exit(&rt_fib_epoch);
+}
+
+/*
+ * Wait until every reader that may have seen state unlinked before this
+ * call has left its critical section.
+ */
+static void
+rt_fib_synchronize(void)
+{
+	LCK_MTX_ASSERT(rnh_lock, LCK_MTX_ASSERT_OWNED);
+
+	epoch_synchronize(&rt_fib_epoch);
+}
+
+static inline size_t
+rt_fib_nhtab_size(uint32_t n)
+{
+	return sizeof(struct rt_fib_nhtab) + n * sizeof(struct rtentry *);
+}
+
+/*
+ * Finish an update: once readers are gone, free whatever the trie and
+ * the route table retired and make released values reusable.
+ */
+static void
+rt_fib_commit(struct rt_fib *rf)
+{
+	struct rt_fib_nhtab *rfn;
+
+	if (!fib_trie_has_retired(rf->rf_trie) &&
+	    rf->rf_nhtab_retired == NULL && rf->rf_nh_npending == 0) {
+		return;
+	}
+	rt_fib_synchronize();
+
+	fib_trie_reclaim(rf->rf_trie);
+	while ((rfn = rf->rf_nhtab_retired) != NULL) {
+		rf->rf_nhtab_retired = rfn->rfn_retired;
+		kheap_free(KHEAP_DEFAULT, rfn, rt_fib_nhtab_size(rfn->rfn_size));
+	}
+	while (rf->rf_nh_npending > 0) {
+		rf->rf_nh_free[rf->rf_nh_nfree++] =
+		    rf->rf_nh_pending[--rf->rf_nh_npending];
+	}
+}
+
+static int
+rt_fib_nh_alloc(struct rt_fib *rf, struct rtentry *rt, uint32_t *nhp)
+{
+	struct rt_fib_nhtab *rfn = rf->rf_nhtab, *nrfn;
+	uint32_t *nfree, *npending, size, nh;
+
+	if (rf->rf_nh_nfree > 0) {
+		nh = rf->rf_nh_free[--rf->rf_nh_nfree];
+	} else {
+		if (rf->rf_nh_next == rfn->rfn_size) {
+			if (rfn->rfn_size > FIB_VALUE_MAX / 2) {
+				return ENOSPC;
+			}
+			size = rfn->rfn_size * 2;
+			nrfn = kheap_alloc(KHEAP_DEFAULT, rt_fib_nhtab_size(size),
+			    Z_WAITOK | Z_ZERO);
+			nfree = kheap_alloc(KHEAP_DEFAULT, size * sizeof(uint32_t),
+			    Z_WAITOK);
+			npending = kheap_alloc(KHEAP_DEFAULT,
+			    size * sizeof(uint32_t), Z_WAITOK);
+			if (nrfn == NULL || nfree == NULL || npending == NULL) {
+				if (nrfn != NULL) {
+					kheap_free(KHEAP_DEFAULT, nrfn,
+					    rt_fib_nhtab_size(size));
+				}
+				if (nfree != NULL) {
+					kheap_free(KHEAP_DEFAULT, nfree,
+					    size * sizeof(uint32_t));
+				}
+				if (npending != NULL) {
+					kheap_free(KHEAP_DEFAULT, npending,
+					    size * sizeof(uint32_t));
+				}
+				return ENOMEM;
+			}
+			nrfn->rfn_size = size;
+			bcopy(rfn->rfn_rt, nrfn->rfn_rt,
+			    rfn->rfn_size * sizeof(struct rtentry *));
+			bcopy(rf->rf_nh_pending, npending,
+			    rf->rf_nh_npending * sizeof(uint32_t));
+			/* the free stack is empty, or we would not be growing */
+			kheap_free(KHEAP_DEFAULT, rf->rf_nh_free,
+			    rfn->rfn_size * sizeof(uint32_t));
+			kheap_free(KHEAP_DEFAULT, rf->rf_nh_pending,
+			    rfn->rfn_size * sizeof(uint32_t));
+			rf->rf_nh_free = nfree;
+			rf->rf_nh_pending = npending;
+
+			os_atomic_store(&rf->rf_nhtab, nrfn, release);
+			rfn->rfn_retired = rf->rf_nhtab_retired;
+			rf->rf_nhtab_retired = rfn;
+			rfn = nrfn;
+		}
+		nh = rf->rf_nh_next++;
+	}
+	/* published to readers by the trie store that installs nh */
+	rfn->rfn_rt[nh] = rt;
+	*nhp = nh;
+	return 0;
+}
+
+/*
+ * Prefix length of a radix mask, -1 if it isn't contiguous.  Host routes
+ * have no mask.
+ */
+static int
+rt_fib_masklen(const struct sockaddr *mask, const struct rt_fib *rf)
+{
+	const uint8_t *cp = (const uint8_t *)mask;
+	unsigned int off, len, i;
+	int plen = 0;
+	uint8_t b;
+
+	if (mask == NULL) {
+		return rf->rf_keylen;
+	}
+	off = (rf == &rt_fib_inet) ? offsetof(struct sockaddr_in, sin_addr) :
+	    offsetof(struct sockaddr_in6, sin6_addr);
+	len = MIN(mask->sa_len, off + rf->rf_keylen / 8);
+	for (i = off; i < len; i++) {
+		b = cp[i];
+		if (b == 0xff) {
+			plen += 8;
+			continue;
+		}
+		while (b & 0x80) {
+			plen++;
+			b <<= 1;
+		}
+		if (b != 0) {
+			return -1;
+		}
+		for (i++; i < len; i++) {
+			if (cp[i] != 0) {
+				return -1;
+			}
+		}
+	}
+	return plen;
+}
+
+/*
+ * Returns the mirror for the route's family if the route belongs in it,
+ * along with its prefix length.
+ */
+static struct rt_fib *
+rt_fib_eligible(struct rtentry *rt, int *plenp)
+{
+	struct sockaddr *dst = rt_key(rt);
+	struct rt_fib *rf;
+
+	if ((rf = rt_fib_af(dst->sa_family)) == NULL || rf->rf_trie == NULL) {
+		return NULL;
+	}
+	/* scoped routes are only reachable through the radix path */
+	if (rt->rt_flags & RTF_IFSCOPE) {
+		return NULL;
+	}
+	if (dst->sa_family == AF_INET6 &&
+	    IN6_IS_SCOPE_EMBED(&SIN6(dst)->sin6_addr)) {
+		return NULL;
+	}
+	if ((*plenp = rt_fib_masklen(rt_mask(rt), rf)) < 0) {
+		rf->rf_broken = TRUE;
+		return NULL;
+	}
+	return rf;
+}
+
+void
+rt_fib_insert_locked(struct rtentry *rt)
+{
+	struct rt_fib *rf;
+	uint32_t nh;
+	int plen, error;
+
+	LCK_MTX_ASSERT(rnh_lock, LCK_MTX_ASSERT_OWNED);
+
+	if (rt->rt_fibidx != 0 || (rf = rt_fib_eligible(rt, &plen)) == NULL) {
+		return;
+	}
+	if ((error = rt_fib_nh_alloc(rf, rt, &nh)) == 0 &&
+	    (error = fib_trie_insert(rf->rf_trie, rt_fib_key(rt_key(rt)),
+	    plen, nh)) == 0) {
+		rt->rt_fibidx = nh;
+		rf->rf_count++;
+	} else {
+		printf("%s: route trie out of sync, error %d\n", __func__,
+		    error);
+		rf->rf_broken = TRUE;
+	}
+	rt_fib_commit(rf);
+}
+
+struct rt_fib_repl {
+	struct rt_fib   *rfr_fib;
+	int             rfr_plen;       /* must be shorter than this */
+	int             rfr_found_plen;
+};
+
+static int
+rt_fib_repl_match(struct radix_node *rn, void *arg)
+{
+	struct rt_fib_repl *rfr = arg;
+	struct rtentry *rt = (struct rtentry *)rn;
+	int plen;
+
+	if ((rn->rn_flags & RNF_ROOT) || rt->rt_fibidx == 0) {
+		return 0;
+	}
+	plen = rt_fib_masklen(rt_mask(rt), rfr->rfr_fib);
+	if (plen < 0 || plen >= rfr->rfr_plen) {
+		return 0;
+	}
+	rfr->rfr_found_plen = plen;
+	return 1;
+}
+
+/*
+ * Called once the route has been removed from the radix tree, but while
+ * RTM_DELETE still holds its reference.
+ */
+void
+rt_fib_delete_locked(struct rtentry *rt)
+{
+	struct radix_node_head *rnh;
+	struct radix_node *rn;
+	struct rt_fib_repl rfr;
+	struct rt_fib *rf;
+	uint32_t nh, repl = 0;
+	int plen;
+
+	LCK_MTX_ASSERT(rnh_lock, LCK_MTX_ASSERT_OWNED);
+
+	if ((nh = rt->rt_fibidx) == 0) {
+		return;
+	}
+	rf = rt_fib_af(rt_key(rt)->sa_family);
+	VERIFY(rf != NULL && rf->rf_trie != NULL);
+	plen = rt_fib_masklen(rt_mask(rt), rf);
+	VERIFY(plen >= 0);
+
+	/* the addresses it covered now go to the next shorter mirrored route */
+	bzero(&rfr, sizeof(rfr));
+	rfr.rfr_fib = rf;
+	rfr.rfr_plen = plen;
+	rnh = rt_tables[rt_key(rt)->sa_family];
+	rn = rn_match_args(rt_key(rt), rnh, rt_fib_repl_match, &rfr);
+	if (rn != NULL && !(rn->rn_flags & RNF_ROOT)) {
+		repl = ((struct rtentry *)rn)->rt_fibidx;
+	}
+	if (fib_trie_delete(rf->rf_trie, rt_fib_key(rt_key(rt)), plen, repl,
+	    repl != 0 ? rfr.rfr_found_plen : 0) != 0) {
+		rf->rf_broken = TRUE;
+	}
+
+	rf->rf_nhtab->rfn_rt[nh] = NULL;
+	rf->rf_nh_pending[rf->rf_nh_npending++] = nh;
+	rt->rt_fibidx = 0;
+	rf->rf_count--;
+	rt_fib_commit(rf);
+}
+
+/*
+ * Lock-free longest prefix match for an unscoped destination.  Returns
+ * the route with a reference held, or NULL if the caller must fall back
+ * to the radix path.
+ */
+struct rtentry *
+rt_fib_lookup(int af, const void *addr)
+{
+	struct rt_fib_nhtab *rfn;
+	struct fib_trie *ft;
+	struct rtentry *rt = NULL;
+	struct rt_fib *rf;
+	uint32_t nh;
+
+	if ((rf = rt_fib_af(af)) == NULL) {
+		return NULL;
+	}
+
+	rt_fib_enter();
+	if ((ft = os_atomic_load(&rf->rf_trie, acquire)) != NULL &&
+	    !rf->rf_broken && (nh = fib_trie_lookup(ft, addr)) != 0) {
+		/* load the table after the leaf that named the entry */
+		rfn = os_atomic_load(&rf->rf_nhtab, acquire);
+		rt = rfn->rfn_rt[nh];
+		if (rt != NULL && !lck_mtx_try_lock_spin(&rt->rt_lock)) {
+			rt = NULL;
+		}
+	}
+	rt_fib_exit();
+
+	if (rt == NULL) {
+		return NULL;
+	}
+	/* the route lock keeps rt from being freed; see above */
+	if (!(rt->rt_flags & RTF_CLONING) && rt_validate(rt)) {
+		RT_ADDREF_LOCKED(rt);
+		RT_UNLOCK(rt);
+		return rt;
+	}
+	RT_UNLOCK(rt);
+	return NULL;
+}
+
+/*
+ * Forwarding fast path: fill in ro->ro_rt for ro->ro_dst if the trie can
+ * answer, and return FALSE if the caller must use rtalloc_scoped_ign().
+ */
+boolean_t
+rt_fib_alloc(struct route *ro, unsigned int ifscope)
+{
+	struct sockaddr *dst = &ro->ro_dst;
+	struct rtentry *rt;
+
+	if (!rt_fib_enabled || ifscope != IFSCOPE_NONE) {
+		return FALSE;
+	}
+	if (dst->sa_family == AF_INET6 &&
+	    IN6_IS_SCOPE_EMBED(&SIN6(dst)->sin6_addr)) {
+		return FALSE;
+	}
+	if ((rt = rt_fib_lookup(dst->sa_family, rt_fib_key(dst))) == NULL) {
+		return FALSE;
+	}
+	ro->ro_rt = rt;
+	RT_GENID_SYNC(rt);
+	return TRUE;
+}
+
+static int
+rt_fib_walk_insert(struct radix_node *rn, void *arg)
+{
+#pragma unused(arg)
+	rt_fib_insert_locked((struct rtentry *)rn);
+	return 0;
+}
+
+static int
+rt_fib_walk_clear(struct radix_node *rn, void *arg)
+{
+#pragma unused(arg)
+	((struct rtentry *)rn)->rt_fibidx = 0;
+	return 0;
+}
+
+static void
+rt_fib_teardown_locked(int af)
+{
+	struct rt_fib *rf = rt_fib_af(af);
+	struct fib_trie *ft = rf->rf_trie;
+	struct rt_fib_nhtab *rfn = rf->rf_nhtab;
+
+	if (ft == NULL) {
+		return;
+	}
+	if (rt_tables[af] != NULL) {
+		(void) rt_tables[af]->rnh_walktree(rt_tables[af],
+		    rt_fib_walk_clear, NULL);
+	}
+	rt_fib_commit(rf);
+	os_atomic_store(&rf->rf_trie, NULL, release);
+	rt_fib_synchronize();
+
+	fib_trie_destroy(ft);
+	kheap_free(KHEAP_DEFAULT, rf->rf_nh_free,
+	    rfn->rfn_size * sizeof(uint32_t));
+	kheap_free(KHEAP_DEFAULT, rf->rf_nh_pending,
+	    rfn->rfn_size * sizeof(uint32_t));
+	kheap_free(KHEAP_DEFAULT, rfn, rt_fib_nhtab_size(rfn->rfn_size));
+	rf->rf_nhtab = NULL;
+	rf->rf_nh_free = rf->rf_nh_pending = NULL;
+	rf->rf_nh_nfree = rf->rf_nh_npending = 0;
+	rf->rf_count = 0;
+	rf->rf_broken = FALSE;
+}
+
+static int
+rt_fib_setup_locked(int af)
+{
+	struct rt_fib *rf = rt_fib_af(af);
+	struct fib_trie *ft;
+
+	if (rf->rf_trie != NULL) {
+		return 0;
+	}
+	ft = fib_trie_create(rf->rf_keylen);
+	rf->rf_nhtab = kheap_alloc(KHEAP_DEFAULT,
+	    rt_fib_nhtab_size(RT_FIB_NH_INITIAL), Z_WAITOK | Z_ZERO);
+	rf->rf_nh_free = kheap_alloc(KHEAP_DEFAULT,
+	    RT_FIB_NH_INITIAL * sizeof(uint32_t), Z_WAITOK);
+	rf->rf_nh_pending = kheap_alloc(KHEAP_DEFAULT,
+	    RT_FIB_NH_INITIAL * sizeof(uint32_t), Z_WAITOK);
+	if (ft == NULL || rf->rf_nhtab == NULL || rf->rf_nh_free == NULL ||
+	    rf->rf_nh_pending == NULL) {
+		if (ft != NULL) {
+			fib_trie_destroy(ft);
+		}
+		if (rf->rf_nhtab != NULL) {
+			kheap_free(KHEAP_DEFAULT, rf->rf_nhtab,
+			    rt_fib_nhtab_size(RT_FIB_NH_INITIAL));
+			rf->rf_nhtab = NULL;
+		}
+		if (rf->rf_nh_free != NULL) {
+			kheap_free(KHEAP_DEFAULT, rf->rf_nh_free,
+			    RT_FIB_NH_INITIAL * sizeof(uint32_t));
+			rf->rf_nh_free = NULL;
+		}
+		if (rf->rf_nh_pending != NULL) {
+			kheap_free(KHEAP_DEFAULT, rf->rf_nh_pending,
+			    RT_FIB_NH_INITIAL * sizeof(uint32_t));
+			rf->rf_nh_pending = NULL;
+		}
+		return ENOMEM;
+	}
+	rf->rf_nhtab->rfn_size = RT_FIB_NH_INITIAL;
+	rf->rf_nh_next = 1;     /* 0 is the trie's "no route" */
+	os_atomic_store(&rf->rf_trie, ft, release);
+
+	if (rt_tables[af] != NULL) {
+		(void) rt_tables[af]->rnh_walktree(rt_tables[af],
+		    rt_fib_walk_insert, NULL);
+	}
+	return 0;
+}
+
+static int
+sysctl_rt_fib SYSCTL_HANDLER_ARGS
+{
+#pragma unused(arg1, arg2)
+	int i, err;
+
+	i = rt_fib_enabled;
+	err = sysctl_handle_int(oidp, &i, 0, req);
+	if (err != 0 || req->newptr == USER_ADDR_NULL) {
+		return err;
+	}
+
+	lck_mtx_lock(rnh_lock);
+	if (i != 0 && !rt_fib_enabled) {
+		if ((err = rt_fib_setup_locked(AF_INET)) == 0 &&
+		    (err = rt_fib_setup_locked(AF_INET6)) == 0) {
+			rt_fib_enabled = 1;
+		} else {
+			rt_fib_teardown_locked(AF_INET);
+			rt_fib_teardown_locked(AF_INET6);
+		}
+	} else if (i == 0 && rt_fib_enabled) {
+		rt_fib_enabled = 0;
+		rt_fib_teardown_locked(AF_INET);
+		rt_fib_teardown_locked(AF_INET6);
+	}
+	lck_mtx_unlock(rnh_lock);
+	return err;
+}
+
+static int
+sysctl_rt_fib_stats SYSCTL_HANDLER_ARGS
+{
+#pragma unused(oidp, arg1, arg2)
+	struct rt_fib_stats stats[2];
+	struct rt_fib *rf;
+	int i;
+
+	bzero(stats, sizeof(stats));
+	lck_mtx_lock(rnh_lock);
+	for (i = 0; i < 2; i++) {
+		rf = (i == 0) ? &rt_fib_inet : &rt_fib_inet6;
+		if (rf->rf_trie == NULL) {
+			continue;
+		}
+		stats[i].rfs_routes = rf->rf_count;
+		stats[i].rfs_chunks = rf->rf_trie->ft_nchunks;
+		stats[i].rfs_broken = rf->rf_broken;
+		stats[i].rfs_memory = fib_trie_memory(rf->rf_trie) +
+		    rt_fib_nhtab_size(rf->rf_nhtab->rfn_size);
+	}
+	lck_mtx_unlock(rnh_lock);
+
+	return SYSCTL_OUT(req, stats, sizeof(stats));
+}
@@ -64,6 +64,9 @@
 #include <libkern/libkern.h>
 #include <mach/boolean.h>
 #include <pexpert/pexpert.h>
+#if defined(__x86_64__)
+#include <machine/cpu_capabilities.h>
+#endif /* __x86_64__ */
 #define CKSUM_ERR(fmt, args...) kprintf(fmt, ## args)
 #else /* !KERNEL */
 #ifndef LIBSYSCALL_INTERFACE
@@ -103,6 +106,24 @@ struct _mbuf {
 
 extern uint32_t os_cpu_in_cksum(const void *, uint32_t, uint32_t);
 extern uint32_t os_cpu_in_cksum_mbuf(struct _mbuf *, int, int, uint32_t);
+#ifdef KERNEL
+extern uint32_t os_cpu_copy_in_cksum(const void *, void *, uint32_t, uint32_t);
+#endif /* KERNEL */
+
+#if defined(__x86_64__) && defined(KERNEL)
+/* bsd/dev/i386/cpu_in_cksum_avx2.s; len must be a multiple of 64 */
+extern uint64_t os_cpu_in_cksum_avx2(const void *, uint32_t);
+extern uint64_t os_cpu_copy_in_cksum_avx2(const void *, void *, uint32_t);
+
+/*
+ * Below this many bytes the setup and horizontal reduction of the
+ * vector loop cost more than the scalar loop saves.
+ */
+#define CKSUM_AVX2_MIN          256
+
+#define CKSUM_HAS_AVX2()        \
+	((_get_cpu_capabilities() & kHasAVX2_0) != 0)
+#endif /* __x86_64__ && KERNEL */
 
 uint32_t
 os_cpu_in_cksum(const void *data, uint32_t len, uint32_t initial_sum)
@@ -190,6 +211,46 @@ os_cpu_in_cksum(const void *data, uint32_t len, uint32_t initial_sum)
 	return os_cpu_in_cksum_mbuf(&m, len, 0, initial_sum);
 }
 
+#ifdef KERNEL
+/*
+ * Copy len bytes from src to dst and return the 16-bit 1's complement
+ * sum of the data added to initial_sum, not complemented (same as
+ * os_cpu_in_cksum().)  With AVX2 the bulk of the copy and the sum are
+ * done in the same pass over the data; otherwise the sum is taken from
+ * dst right after the copy, while it is still in the cache.
+ */
+uint32_t
+os_cpu_copy_in_cksum(const void *src, void *dst, uint32_t len,
+    uint32_t initial_sum)
+{
+#if defined(__x86_64__)
+	if (len >= CKSUM_AVX2_MIN && CKSUM_HAS_AVX2()) {
+		uint32_t vlen = len & ~63;
+		uint64_t sum;
+
+		sum = os_cpu_copy_in_cksum_avx2(src, dst, vlen) + initial_sum;
+		if (len > vlen) {
+			/* the tail starts at an even offset; sum it as is */
+			bcopy((const uint8_t *)src + vlen,
+			    (uint8_t *)dst + vlen, len - vlen);
+			sum += os_cpu_in_cksum((uint8_t *)dst + vlen,
+			    len - vlen, 0);
+		}
+
+		/* fold 64-bit to 16-bit (deferred carries) */
+		sum = (sum >> 32) + (sum & 0xffffffff); /* 33-bit */
+		sum = (sum >> 16) + (sum & 0xffff);     /* 17-bit + carry */
+		sum = (sum >> 16) + (sum & 0xffff);     /* 16-bit + carry */
+		sum = (sum >> 16) + (sum & 0xffff);     /* final carry */
+
+		return sum & 0xffff;
+	}
+#endif /* __x86_64__ */
+	bcopy(src, dst, len);
+	return os_cpu_in_cksum(dst, len, initial_sum);
+}
+#endif /* KERNEL */
+
 #if defined(__i386__) || defined(__x86_64__)
 
 /*
@@ -436,6 +497,16 @@ post_initial_offset:
 			data += 2;
 			mlen -= 2;
 		}
+#if defined(__x86_64__) && defined(KERNEL)
+		if (mlen >= CKSUM_AVX2_MIN && CKSUM_HAS_AVX2()) {
+			int vlen = mlen & ~63;
+
+			/* at most 33 bits, so partial can't overflow here */
+			partial += os_cpu_in_cksum_avx2(data, vlen);
+			data += vlen;
+			mlen -= vlen;
+		}
+#endif /* __x86_64__ && KERNEL */
 		while (mlen >= 64) {
 			__builtin_prefetch(data + 32);
 			__builtin_prefetch(data + 64);
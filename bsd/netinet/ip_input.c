@@ -3509,7 +3509,10 @@ ip_forward(struct mbuf *m, int srcrt, struct sockaddr_in *next_hop)
 		sin->sin_len = sizeof(*sin);
 		sin->sin_addr = pkt_dst;
 
-		rtalloc_scoped_ign(&fwd_rt, RTF_PRCLONING, ipoa.ipoa_boundif);
+		if (!rt_fib_alloc(&fwd_rt, ipoa.ipoa_boundif)) {
+			rtalloc_scoped_ign(&fwd_rt, RTF_PRCLONING,
+			    ipoa.ipoa_boundif);
+		}
 		if (fwd_rt.ro_rt == NULL) {
 			icmp_error(m, ICMP_UNREACH, ICMP_UNREACH_HOST, dest, 0);
 			goto done;
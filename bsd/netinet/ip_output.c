@@ -945,6 +945,9 @@ loopit:
 					ipf_pktopts.ippo_mcast_loop = loop;
 				}
 
+				/* filters may edit the payload */
+				m->m_pkthdr.csum_flags &= ~CSUM_TX_DSUM_VALID;
+
 				ipf_ref();
 
 				/*
@@ -1122,6 +1125,9 @@ sendit:
 			goto bad;
 		}
 
+		/* filters may edit the payload */
+		m->m_pkthdr.csum_flags &= ~CSUM_TX_DSUM_VALID;
+
 		ipf_ref();
 
 		/* 4135317 - always pass network byte order to filter */
@@ -1473,6 +1479,9 @@ sendit:
 			goto bad;
 		}
 
+		/* filters may edit the payload */
+		m->m_pkthdr.csum_flags &= ~CSUM_TX_DSUM_VALID;
+
 		ipf_ref();
 
 		/* 4135317 - always pass network byte order to filter */
@@ -2047,7 +2056,24 @@ in_finalize_cksum(struct mbuf *m, uint32_t hoff, uint32_t csum_flags)
 			/* NOTREACHED */
 		}
 
-		csum = inet_cksum(m, 0, offset, len);
+		if ((m->m_pkthdr.csum_flags & CSUM_TX_DSUM_VALID) &&
+		    ip->ip_p == IPPROTO_UDP && len >= sizeof(struct udphdr)) {
+			uint32_t sum;
+
+			/*
+			 * sosend() summed the payload as it was copied in;
+			 * only the UDP header (which holds the pseudo header
+			 * sum) is left to add.  The payload begins at an
+			 * even offset, so the two sums combine directly.
+			 */
+			sum = m_sum16(m, offset, sizeof(struct udphdr)) +
+			    m->m_pkthdr.csum_tx_dsum;
+			sum = (sum >> 16) + (sum & 0xffff);
+			sum = (sum >> 16) + (sum & 0xffff);
+			csum = ~sum & 0xffff;
+		} else {
+			csum = inet_cksum(m, 0, offset, len);
+		}
 
 		/* Update stats */
 		ip_out_cksum_stats(ip->ip_p, len);
@@ -2068,7 +2094,7 @@ in_finalize_cksum(struct mbuf *m, uint32_t hoff, uint32_t csum_flags)
 			bcopy(&csum, (mtod(m, char *) + offset), sizeof(csum));
 		}
 		m->m_pkthdr.csum_flags &= ~(CSUM_DELAY_DATA | CSUM_DATA_VALID |
-		    CSUM_PARTIAL | CSUM_ZERO_INVERT);
+		    CSUM_PARTIAL | CSUM_ZERO_INVERT | CSUM_TX_DSUM_VALID);
 	}
 
 	if (sw_csum & CSUM_DELAY_IP) {
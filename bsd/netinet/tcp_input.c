@@ -540,6 +540,28 @@ tcp_bwmeas_check(struct tcpcb *tp)
 	}
 }
 
+/*
+ * The reassembly queue is a list in sequence order, which tcp_reass()
+ * consumes from the head, and a tree over the same entries so that the
+ * insertion point of an out-of-order segment is found in O(log n).
+ * Queued segments never overlap and all lie within the receive window.
+ * A zero-length (FIN only) segment may share its sequence number with the
+ * segment that follows it, so the length breaks ties.
+ */
+static __inline int
+tcp_reass_cmp(const struct tseg_qent *a, const struct tseg_qent *b)
+{
+	if (SEQ_LT(a->tqe_th->th_seq, b->tqe_th->th_seq)) {
+		return -1;
+	}
+	if (SEQ_GT(a->tqe_th->th_seq, b->tqe_th->th_seq)) {
+		return 1;
+	}
+	return a->tqe_len - b->tqe_len;
+}
+
+RB_GENERATE_PREV(tsegqe_tree, tseg_qent, tqe_link, tcp_reass_cmp);
+
 static int
 tcp_reass(struct tcpcb *tp, struct tcphdr *th, int *tlenp, struct mbuf *m,
     struct ifnet *ifp, int *dowakeup)
@@ -548,6 +570,8 @@ tcp_reass(struct tcpcb *tp, struct tcphdr *th, int *tlenp, struct mbuf *m,
 	struct tseg_qent *p = NULL;
 	struct tseg_qent *nq;
 	struct tseg_qent *te = NULL;
+	struct tseg_qent find;
+	struct tcphdr find_th;
 	struct inpcb *inp = tp->t_inpcb;
 	struct socket *so = inp->inp_socket;
 	int flags = 0;
@@ -622,13 +646,17 @@ tcp_reass(struct tcpcb *tp, struct tcphdr *th, int *tlenp, struct mbuf *m,
 	tp->t_reassqlen++;
 
 	/*
-	 * Find a segment which begins after this one does.
+	 * Find a segment which begins after this one does, and the one
+	 * preceding it.
 	 */
-	LIST_FOREACH(q, &tp->t_segq, tqe_q) {
-		if (SEQ_GT(q->tqe_th->th_seq, th->th_seq)) {
-			break;
-		}
-		p = q;
+	find_th.th_seq = th->th_seq + 1;
+	find.tqe_th = &find_th;
+	find.tqe_len = 0;
+	q = RB_NFIND(tsegqe_tree, &tp->t_segq_tree, &find);
+	if (q != NULL) {
+		p = RB_PREV(tsegqe_tree, &tp->t_segq_tree, q);
+	} else {
+		p = RB_MAX(tsegqe_tree, &tp->t_segq_tree);
 	}
 
 	/*
@@ -739,6 +767,7 @@ tcp_reass(struct tcpcb *tp, struct tcphdr *th, int *tlenp, struct mbuf *m,
 
 		nq = LIST_NEXT(q, tqe_q);
 		LIST_REMOVE(q, tqe_q);
+		RB_REMOVE(tsegqe_tree, &tp->t_segq_tree, q);
 		m_freem(q->tqe_m);
 		zfree(tcp_reass_zone, q);
 		tp->t_reassqlen--;
@@ -750,6 +779,14 @@ tcp_reass(struct tcpcb *tp, struct tcphdr *th, int *tlenp, struct mbuf *m,
 	te->tqe_th = th;
 	te->tqe_len = *tlenp;
 
+	if (RB_INSERT(tsegqe_tree, &tp->t_segq_tree, te) != NULL) {
+		/* a duplicate of an already queued FIN */
+		m_freem(m);
+		zfree(tcp_reass_zone, te);
+		te = NULL;
+		tp->t_reassqlen--;
+		goto present;
+	}
 	if (p == NULL) {
 		LIST_INSERT_HEAD(&tp->t_segq, te, tqe_q);
 	} else {
@@ -786,6 +823,7 @@ present:
 		tp->rcv_nxt += q->tqe_len;
 		flags = q->tqe_th->th_flags & TH_FIN;
 		LIST_REMOVE(q, tqe_q);
+		RB_REMOVE(tsegqe_tree, &tp->t_segq_tree, q);
 		if (so->so_state & SS_CANTRCVMORE) {
 			m_freem(q->tqe_m);
 		} else {
@@ -117,8 +117,37 @@ SYSCTL_INT(_net_inet_tcp, OID_AUTO, sack_globalholes, CTLFLAG_RD | CTLFLAG_LOCKE
     &tcp_sack_globalholes, 0,
     "Global number of TCP SACK holes currently allocated");
 
+#if (DEVELOPMENT || DEBUG)
+static int tcp_sack_output_check = 0;
+SYSCTL_INT(_net_inet_tcp, OID_AUTO, sack_output_check,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &tcp_sack_output_check, 0,
+    "Cross-check the SACK output hint against a scoreboard walk");
+#endif /* DEVELOPMENT || DEBUG */
+
 extern struct zone *sack_hole_zone;
 
+/*
+ * The scoreboard is kept both as a list ordered by sequence number, which
+ * the hint and the in-order walks use, and as a tree keyed by the start of
+ * each hole, so that a SACK block far below snd_fack can be matched with
+ * its hole without walking the list.  Holes never overlap and they all lie
+ * between snd_una and snd_max, so comparing their starts in sequence space
+ * is a total order.
+ */
+static __inline int
+tcp_sackhole_cmp(const struct sackhole *a, const struct sackhole *b)
+{
+	if (SEQ_LT(a->start, b->start)) {
+		return -1;
+	}
+	if (SEQ_GT(a->start, b->start)) {
+		return 1;
+	}
+	return 0;
+}
+
+RB_GENERATE(sackhole_tree, sackhole, sclink, tcp_sackhole_cmp);
+
 #define TCP_VALIDATE_SACK_SEQ_NUMBERS(_tp_, _sb_, _ack_) \
     (SEQ_GT((_sb_)->end, (_sb_)->start) && \
     SEQ_GT((_sb_)->start, (_tp_)->snd_una) && \
@@ -301,6 +330,8 @@ tcp_sackhole_insert(struct tcpcb *tp, tcp_seq start, tcp_seq end,
 	} else {
 		TAILQ_INSERT_TAIL(&tp->snd_holes, hole, scblink);
 	}
+	VERIFY(RB_INSERT(sackhole_tree, &tp->snd_holes_tree, hole) == NULL);
+	tp->sackhint.sack_bytes_holes += (end - start);
 
 	/* Update SACK hint. */
 	if (tp->sackhint.nexthole == NULL) {
@@ -323,10 +354,30 @@ tcp_sackhole_remove(struct tcpcb *tp, struct sackhole *hole)
 
 	/* Remove this SACK hole. */
 	TAILQ_REMOVE(&tp->snd_holes, hole, scblink);
+	RB_REMOVE(sackhole_tree, &tp->snd_holes_tree, hole);
+	tp->sackhint.sack_bytes_holes -= (hole->end - hole->start);
 
 	/* Free this SACK hole. */
 	tcp_sackhole_free(tp, hole);
 }
+
+/*
+ * Return the last SACK hole that starts before seq, or NULL if there is
+ * none.  O(log n) in the number of holes.
+ */
+static struct sackhole *
+tcp_sackhole_lookup(struct tcpcb *tp, tcp_seq seq)
+{
+	struct sackhole find, *hole;
+
+	find.start = seq;
+	hole = RB_NFIND(sackhole_tree, &tp->snd_holes_tree, &find);
+	if (hole == NULL) {
+		return TAILQ_LAST(&tp->snd_holes, sackhole_head);
+	}
+	return TAILQ_PREV(hole, sackhole_head, scblink);
+}
+
 /*
  * When a new ack with SACK is received, check if it indicates packet
  * reordering. If there is packet reordering, the socket is marked and
@@ -503,7 +554,9 @@ tcp_sack_doack(struct tcpcb *tp, struct tcpopt *to, struct tcphdr *th,
 	 * In the while-loop below, incoming SACK blocks (sack_blocks[])
 	 * and SACK holes (snd_holes) are traversed from their tails with
 	 * just one pass in order to reduce the number of compares especially
-	 * when the bandwidth-delay product is large.
+	 * when the bandwidth-delay product is large.  Holes that lie entirely
+	 * between two SACK blocks are skipped with a tree lookup rather
+	 * than walked over one at a time.
 	 * Note: Typically, in the first RTT of SACK recovery, the highest
 	 * three or four SACK blocks with the same ack number are received.
 	 * In the second RTT, if retransmitted data segments are not lost,
@@ -568,9 +621,9 @@ tcp_sack_doack(struct tcpcb *tp, struct tcpopt *to, struct tcphdr *th,
 		if (SEQ_LEQ(sblkp->end, cur->start)) {
 			/*
 			 * SACKs data before the current hole.
-			 * Go to the previous hole.
+			 * Go to the last hole starting below this block.
 			 */
-			cur = TAILQ_PREV(cur, sackhole_head, scblink);
+			cur = tcp_sackhole_lookup(tp, sblkp->end);
 			continue;
 		}
 		tp->sackhint.sack_bytes_rexmit -= (cur->rxmit - cur->start);
@@ -599,6 +652,8 @@ tcp_sack_doack(struct tcpcb *tp, struct tcpopt *to, struct tcphdr *th,
 				tcp_sack_update_byte_counter(tp, cur->start, sblkp->end, newbytes_acked, after_rexmit_acked);
 				tcp_sack_detect_reordering(tp, cur,
 				    sblkp->end, old_snd_fack);
+				tp->sackhint.sack_bytes_holes -=
+				    (sblkp->end - cur->start);
 				cur->start = sblkp->end;
 				cur->rxmit = SEQ_MAX(cur->rxmit, cur->start);
 			}
@@ -609,6 +664,8 @@ tcp_sack_doack(struct tcpcb *tp, struct tcpopt *to, struct tcphdr *th,
 				tcp_sack_update_byte_counter(tp, sblkp->start, cur->end, newbytes_acked, after_rexmit_acked);
 				tcp_sack_detect_reordering(tp, cur,
 				    cur->end, old_snd_fack);
+				tp->sackhint.sack_bytes_holes -=
+				    (cur->end - sblkp->start);
 				cur->end = sblkp->start;
 				cur->rxmit = SEQ_MIN(cur->rxmit, cur->end);
 			} else {
@@ -628,6 +685,8 @@ tcp_sack_doack(struct tcpcb *tp, struct tcpopt *to, struct tcphdr *th,
 						        += (temp->rxmit
 						    - temp->start);
 					}
+					tp->sackhint.sack_bytes_holes -=
+					    (cur->end - sblkp->start);
 					cur->end = sblkp->start;
 					cur->rxmit = SEQ_MIN(cur->rxmit,
 					    cur->end);
@@ -722,9 +781,10 @@ tcp_sack_partialack(struct tcpcb *tp, struct tcphdr *th)
 	(void) tcp_output(tp);
 }
 
+#if (DEVELOPMENT || DEBUG)
 /*
- * Debug version of tcp_sack_output() that walks the scoreboard. Used for
- * now to sanity check the hint.
+ * Debug version of tcp_sack_output() that walks the scoreboard. Used to
+ * sanity check the hint when net.inet.tcp.sack_output_check is set.
  */
 static struct sackhole *
 tcp_sack_output_debug(struct tcpcb *tp, int *sack_bytes_rexmt)
@@ -744,6 +804,7 @@ tcp_sack_output_debug(struct tcpcb *tp, int *sack_bytes_rexmt)
 	}
 	return p;
 }
+#endif /* DEVELOPMENT || DEBUG */
 
 /*
  * Returns the next hole to retransmit and the number of retransmitted bytes
@@ -765,10 +826,8 @@ tcp_sack_output_debug(struct tcpcb *tp, int *sack_bytes_rexmt)
 struct sackhole *
 tcp_sack_output(struct tcpcb *tp, int *sack_bytes_rexmt)
 {
-	struct sackhole *hole = NULL, *dbg_hole = NULL;
-	int dbg_bytes_rexmt;
+	struct sackhole *hole = NULL;
 
-	dbg_hole = tcp_sack_output_debug(tp, &dbg_bytes_rexmt);
 	*sack_bytes_rexmt = tp->sackhint.sack_bytes_rexmit;
 	hole = tp->sackhint.nexthole;
 	if (hole == NULL || SEQ_LT(hole->rxmit, hole->end)) {
@@ -781,16 +840,24 @@ tcp_sack_output(struct tcpcb *tp, int *sack_bytes_rexmt)
 		}
 	}
 out:
-	if (dbg_hole != hole) {
-		printf("%s: Computed sack hole not the same as cached value\n", __func__);
-		hole = dbg_hole;
-	}
-	if (*sack_bytes_rexmt != dbg_bytes_rexmt) {
-		printf("%s: Computed sack_bytes_retransmitted (%d) not "
-		    "the same as cached value (%d)\n",
-		    __func__, dbg_bytes_rexmt, *sack_bytes_rexmt);
-		*sack_bytes_rexmt = dbg_bytes_rexmt;
+#if (DEVELOPMENT || DEBUG)
+	if (tcp_sack_output_check) {
+		struct sackhole *dbg_hole;
+		int dbg_bytes_rexmt;
+
+		dbg_hole = tcp_sack_output_debug(tp, &dbg_bytes_rexmt);
+		if (dbg_hole != hole) {
+			printf("%s: Computed sack hole not the same as cached value\n", __func__);
+			hole = dbg_hole;
+		}
+		if (*sack_bytes_rexmt != dbg_bytes_rexmt) {
+			printf("%s: Computed sack_bytes_retransmitted (%d) not "
+			    "the same as cached value (%d)\n",
+			    __func__, dbg_bytes_rexmt, *sack_bytes_rexmt);
+			*sack_bytes_rexmt = dbg_bytes_rexmt;
+		}
 	}
+#endif /* DEVELOPMENT || DEBUG */
 	return hole;
 }
 
@@ -819,9 +886,9 @@ tcp_sack_lost_rexmit(struct tcpcb *tp)
 void
 tcp_sack_adjust(struct tcpcb *tp)
 {
-	struct sackhole *p, *cur = TAILQ_FIRST(&tp->snd_holes);
+	struct sackhole *p, *cur;
 
-	if (cur == NULL) {
+	if (TAILQ_EMPTY(&tp->snd_holes)) {
 		return; /* No holes */
 	}
 	if (SEQ_GEQ(tp->snd_nxt, tp->snd_fack)) {
@@ -832,22 +899,15 @@ tcp_sack_adjust(struct tcpcb *tp)
 	 * i) snd_nxt lies between end of one hole and beginning of another
 	 * ii) snd_nxt lies between end of last hole and snd_fack
 	 */
-	while ((p = TAILQ_NEXT(cur, scblink)) != NULL) {
-		if (SEQ_LT(tp->snd_nxt, cur->end)) {
-			return;
-		}
-		if (SEQ_GEQ(tp->snd_nxt, p->start)) {
-			cur = p;
-		} else {
-			tp->snd_nxt = p->start;
-			return;
-		}
+	cur = tcp_sackhole_lookup(tp, tp->snd_nxt + 1);
+	if (cur == NULL || SEQ_LT(tp->snd_nxt, cur->end)) {
+		return; /* snd_nxt is in a hole, or below the first one */
 	}
-	if (SEQ_LT(tp->snd_nxt, cur->end)) {
-		return;
+	if ((p = TAILQ_NEXT(cur, scblink)) != NULL) {
+		tp->snd_nxt = p->start;
+	} else {
+		tp->snd_nxt = tp->snd_fack;
 	}
-	tp->snd_nxt = tp->snd_fack;
-	return;
 }
 
 /*
@@ -857,8 +917,8 @@ tcp_sack_adjust(struct tcpcb *tp)
 boolean_t
 tcp_sack_byte_islost(struct tcpcb *tp)
 {
-	u_int32_t unacked_bytes, sndhole_bytes = 0;
-	struct sackhole *sndhole;
+	u_int32_t unacked_bytes, sndhole_bytes;
+
 	if (!SACK_ENABLED(tp) || IN_FASTRECOVERY(tp) ||
 	    TAILQ_EMPTY(&tp->snd_holes) ||
 	    (tp->t_flagsext & TF_PKTS_REORDERED)) {
@@ -867,9 +927,7 @@ tcp_sack_byte_islost(struct tcpcb *tp)
 
 	unacked_bytes = tp->snd_max - tp->snd_una;
 
-	TAILQ_FOREACH(sndhole, &tp->snd_holes, scblink) {
-		sndhole_bytes += (sndhole->end - sndhole->start);
-	}
+	sndhole_bytes = tp->sackhint.sack_bytes_holes;
 
 	VERIFY(unacked_bytes >= sndhole_bytes);
 	return (unacked_bytes - sndhole_bytes) >
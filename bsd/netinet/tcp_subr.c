@@ -1045,12 +1045,14 @@ tcp_newtcpcb(struct inpcb *inp)
 
 	bzero((char *) tp, sizeof(struct tcpcb));
 	LIST_INIT(&tp->t_segq);
+	RB_INIT(&tp->t_segq_tree);
 	tp->t_maxseg = tp->t_maxopd = isipv6 ? tcp_v6mssdflt : tcp_mssdflt;
 
 	tp->t_flags = (TF_REQ_SCALE | TF_REQ_TSTMP);
 	tp->t_flagsext |= TF_SACK_ENABLE;
 
 	TAILQ_INIT(&tp->snd_holes);
+	RB_INIT(&tp->snd_holes_tree);
 	SLIST_INIT(&tp->t_rxt_segments);
 	SLIST_INIT(&tp->t_notify_ack);
 	tp->t_inpcb = inp;
@@ -1646,6 +1648,7 @@ tcp_freeq(struct tcpcb *tp)
 		zfree(tcp_reass_zone, q);
 		rv = 1;
 	}
+	RB_INIT(&tp->t_segq_tree);
 	tp->t_reassqlen = 0;
 	return rv;
 }
@@ -86,6 +86,8 @@ struct name {                           \
 
 #ifdef KERNEL_PRIVATE
 
+#include <sys/tree.h>
+
 #define TCP_RETRANSHZ   1000    /* granularity of TCP timestamps, 1ms */
 /* Minimum time quantum within which the timers are coalesced */
 #define TCP_TIMER_10MS_QUANTUM  (TCP_RETRANSHZ/100) /* every 10ms */
@@ -155,11 +157,13 @@ struct name {                           \
 /* TCP segment queue entry */
 struct tseg_qent {
 	LIST_ENTRY(tseg_qent) tqe_q;
+	RB_ENTRY(tseg_qent) tqe_link;   /* t_segq_tree linkage (TCP only) */
 	int     tqe_len;                /* TCP segment data length */
 	struct  tcphdr *tqe_th;         /* a pointer to tcp header */
 	struct  mbuf    *tqe_m;         /* mbuf contains packet */
 };
 LIST_HEAD(tsegqe_head, tseg_qent);
+RB_HEAD(tsegqe_tree, tseg_qent);
 
 struct sackblk {
 	tcp_seq start;          /* start seq no. of sack block */
@@ -172,12 +176,15 @@ struct sackhole {
 	tcp_seq rxmit;          /* next seq. no in hole to be retransmitted */
 	u_int32_t rxmit_start;  /* timestamp of first retransmission */
 	TAILQ_ENTRY(sackhole) scblink;  /* scoreboard linkage */
+	RB_ENTRY(sackhole) sclink;      /* scoreboard index, keyed by start */
 };
+RB_HEAD(sackhole_tree, sackhole);
 
 struct sackhint {
 	struct sackhole *nexthole;
 	int     sack_bytes_rexmit;
 	int sack_bytes_acked;
+	u_int32_t sack_bytes_holes;     /* sum of (end - start) of all holes */
 };
 
 struct tcp_rxt_seg {
@@ -253,6 +260,7 @@ struct tcp_ccstate {
  */
 struct tcpcb {
 	struct  tsegqe_head t_segq;
+	struct  tsegqe_tree t_segq_tree; /* t_segq, indexed by th_seq */
 	int     t_dupacks;              /* consecutive dup acks recd */
 	int     t_state;                /* state of this connection */
 	uint32_t t_timer[TCPT_NTIMERS]; /* tcp timers */
@@ -437,6 +445,7 @@ struct tcpcb {
 	                                 *   episode starts at this seq number */
 	TAILQ_HEAD(sackhole_head, sackhole) snd_holes;
 	/* SACK scoreboard (sorted) */
+	struct sackhole_tree snd_holes_tree; /* snd_holes, indexed by start */
 	tcp_seq snd_fack;               /* last seq number(+1) sack'd by rcv'r*/
 	int     rcv_numsacks;           /* # distinct sack blks present */
 	struct sackblk sackblks[MAX_SACK_BLKS]; /* seq nos. of sack blocks */
@@ -1464,6 +1473,11 @@ struct tcpprogressreq {
 #ifdef BSD_KERNEL_PRIVATE
 #include <sys/bitstring.h>
 
+RB_PROTOTYPE_SC_PREV(__private_extern__, tsegqe_tree, tseg_qent, tqe_link,
+    tcp_reass_cmp);
+RB_PROTOTYPE_SC(__private_extern__, sackhole_tree, sackhole, sclink,
+    tcp_sackhole_cmp);
+
 #define TCP_PKTLIST_CLEAR(tp) {                                         \
 	(tp)->t_pktlist_head = (tp)->t_pktlist_tail = NULL;             \
 	(tp)->t_lastchain = (tp)->t_pktlist_sentlen = 0;                \
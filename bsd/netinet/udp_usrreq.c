@@ -1778,10 +1778,13 @@ udp_output(struct inpcb *inp, struct mbuf *m, struct sockaddr *addr,
 	    (udpcksum && !(inp->inp_flags & INP_UDP_NOCKSUM))) {
 		ui->ui_sum = in_pseudo(ui->ui_src.s_addr, ui->ui_dst.s_addr,
 		    htons((u_short)len + sizeof(struct udphdr) + IPPROTO_UDP));
-		m->m_pkthdr.csum_flags = (CSUM_UDP | CSUM_ZERO_INVERT);
+		/* keep the payload sum taken by sosend(), if any */
+		m->m_pkthdr.csum_flags = (CSUM_UDP | CSUM_ZERO_INVERT) |
+		    (m->m_pkthdr.csum_flags & CSUM_TX_DSUM_VALID);
 		m->m_pkthdr.csum_data = offsetof(struct udphdr, uh_sum);
 	} else {
 		ui->ui_sum = 0;
+		m->m_pkthdr.csum_flags &= ~CSUM_TX_DSUM_VALID;
 	}
 	((struct ip *)ui)->ip_len = (uint16_t)(sizeof(struct udpiphdr) + len);
 	((struct ip *)ui)->ip_ttl = inp->inp_ip_ttl;    /* XXX */
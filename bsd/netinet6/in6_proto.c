@@ -169,7 +169,7 @@ struct ip6protosw inet6sw[] = {
 		.pr_type =              SOCK_DGRAM,
 		.pr_protocol =          IPPROTO_UDP,
 		.pr_flags =             PR_ATOMIC | PR_ADDR | PR_PROTOLOCK | PR_PCBLOCK |
-    PR_EVCONNINFO | PR_PRECONN_WRITE,
+    PR_EVCONNINFO | PR_PRECONN_WRITE | PR_CSUM_COPY,
 		.pr_input =             udp6_input,
 		.pr_ctlinput =          udp6_ctlinput,
 		.pr_ctloutput =         ip6_ctloutput,
@@ -431,8 +431,11 @@ skip_ipsec:
 			ROUTE_RELEASE(ip6forward_rt);
 
 			/* this probably fails but give it a try again */
-			rtalloc_scoped_ign((struct route *)ip6forward_rt,
-			    RTF_PRCLONING, ifscope);
+			if (!rt_fib_alloc((struct route *)ip6forward_rt,
+			    ifscope)) {
+				rtalloc_scoped_ign((struct route *)ip6forward_rt,
+				    RTF_PRCLONING, ifscope);
+			}
 			if ((rt = ip6forward_rt->ro_rt) != NULL) {
 				RT_LOCK(rt);
 				/* Take an extra ref for ourselves */
@@ -465,8 +468,10 @@ skip_ipsec:
 		dst->sin6_family = AF_INET6;
 		dst->sin6_addr = ip6->ip6_dst;
 
-		rtalloc_scoped_ign((struct route *)ip6forward_rt,
-		    RTF_PRCLONING, ifscope);
+		if (!rt_fib_alloc((struct route *)ip6forward_rt, ifscope)) {
+			rtalloc_scoped_ign((struct route *)ip6forward_rt,
+			    RTF_PRCLONING, ifscope);
+		}
 		if ((rt = ip6forward_rt->ro_rt) == NULL) {
 			ip6stat.ip6s_noroute++;
 			in6_ifstat_inc(m->m_pkthdr.rcvif, ifs6_in_noroute);
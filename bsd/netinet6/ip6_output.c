@@ -130,6 +130,7 @@
 #include <netinet/ip6.h>
 #include <netinet/kpi_ipfilter_var.h>
 #include <netinet/in_tclass.h>
+#include <netinet/udp.h>
 
 #include <netinet6/ip6protosw.h>
 #include <netinet/icmp6.h>
@@ -2102,7 +2103,22 @@ in6_finalize_cksum(struct mbuf *m, uint32_t hoff, int32_t optlen,
 		/* NOTREACHED */
 	}
 
-	csum = inet6_cksum(m, 0, offset, plen - olen);
+	if ((m->m_pkthdr.csum_flags & CSUM_TX_DSUM_VALID) &&
+	    nxt == IPPROTO_UDP && plen >= olen + sizeof(struct udphdr)) {
+		uint32_t sum;
+
+		/*
+		 * The payload was summed by sosend() as it was copied in;
+		 * see in_finalize_cksum().
+		 */
+		sum = m_sum16(m, offset, sizeof(struct udphdr)) +
+		    m->m_pkthdr.csum_tx_dsum;
+		sum = (sum >> 16) + (sum & 0xffff);
+		sum = (sum >> 16) + (sum & 0xffff);
+		csum = ~sum & 0xffff;
+	} else {
+		csum = inet6_cksum(m, 0, offset, plen - olen);
+	}
 
 	/* Update stats */
 	ip6_out_cksum_stats(nxt, plen - olen);
@@ -2123,7 +2139,7 @@ in6_finalize_cksum(struct mbuf *m, uint32_t hoff, int32_t optlen,
 		bcopy(&csum, (mtod(m, char *) + offset), sizeof(csum));
 	}
 	m->m_pkthdr.csum_flags &= ~(CSUM_DELAY_IPV6_DATA | CSUM_DATA_VALID |
-	    CSUM_PARTIAL | CSUM_ZERO_INVERT);
+	    CSUM_PARTIAL | CSUM_ZERO_INVERT | CSUM_TX_DSUM_VALID);
 
 done:
 	return sw_csum;
@@ -424,7 +424,9 @@ udp6_output(struct in6pcb *in6p, struct mbuf *m, struct sockaddr *addr6,
 
 		udp6->uh_sum = in6_pseudo(laddr, faddr,
 		    htonl(plen + IPPROTO_UDP));
-		m->m_pkthdr.csum_flags = (CSUM_UDPIPV6 | CSUM_ZERO_INVERT);
+		/* keep the payload sum taken by sosend(), if any */
+		m->m_pkthdr.csum_flags = (CSUM_UDPIPV6 | CSUM_ZERO_INVERT) |
+		    (m->m_pkthdr.csum_flags & CSUM_TX_DSUM_VALID);
 		m->m_pkthdr.csum_data = offsetof(struct udphdr, uh_sum);
 
 		if (!IN6_IS_ADDR_UNSPECIFIED(laddr)) {
@@ -449,7 +449,7 @@ struct pkthdr {
 	union builtin_mtag builtin_mtag;
 
 	uint32_t comp_gencnt;
-	uint32_t padding;
+	uint32_t csum_tx_dsum;          /* TX: payload sum, CSUM_TX_DSUM_VALID */
 	/*
 	 * Module private scratch space (32-bit aligned), currently 16-bytes
 	 * large. Anything stored here is not guaranteed to survive across
@@ -673,7 +673,8 @@ struct mbuf {
 
 #define CSUM_TX_FLAGS                                                   \
 	(CSUM_DELAY_IP | CSUM_DELAY_DATA | CSUM_DELAY_IPV6_DATA |       \
-	CSUM_DATA_VALID | CSUM_PARTIAL | CSUM_ZERO_INVERT)
+	CSUM_DATA_VALID | CSUM_PARTIAL | CSUM_ZERO_INVERT |             \
+	CSUM_TX_DSUM_VALID)
 
 #define CSUM_RX_FULL_FLAGS                                              \
 	(CSUM_IP_CHECKED | CSUM_IP_VALID | CSUM_PSEUDO_HDR |            \
@@ -697,6 +698,9 @@ struct mbuf {
 /* VLAN encapsulation present */
 #define CSUM_VLAN_ENCAP_PRESENT    0x00040000      /* mbuf has vlan encapsulation */
 
+/* csum_tx_dsum holds the 16-bit sum of the payload, taken at copyin */
+#define CSUM_TX_DSUM_VALID      0x00080000
+
 /* TCP Segment Offloading requested on this mbuf */
 #define CSUM_TSO_IPV4           0x00100000      /* This mbuf needs to be segmented by the NIC */
 #define CSUM_TSO_IPV6           0x00200000      /* This mbuf needs to be segmented by the NIC */
@@ -1559,6 +1563,8 @@ __private_extern__ mbuf_traffic_class_t m_get_traffic_class(struct mbuf *);
 __private_extern__ u_int16_t m_adj_sum16(struct mbuf *, u_int32_t,
     u_int32_t, u_int32_t, u_int32_t);
 __private_extern__ u_int16_t m_sum16(struct mbuf *, u_int32_t, u_int32_t);
+__private_extern__ u_int16_t m_copydata_sum(struct mbuf *, u_int32_t, u_int32_t,
+    void *);
 
 __private_extern__ void m_set_ext(struct mbuf *, struct ext_ref *,
     m_ext_free_func_t, caddr_t);
@@ -384,6 +384,7 @@ struct  proc {
 #if CONFIG_MEMORYSTATUS
 	/* Fields protected by proc list lock */
 	TAILQ_ENTRY(proc) p_memstat_list;               /* priority bucket link */
+	uint32_t          p_memstat_footprint_pages;    /* footprint the process was last sorted by in its bucket */
 	uint32_t          p_memstat_state;              /* state. Also used as a wakeup channel when the memstat's LOCKED bit changes */
 	int32_t           p_memstat_effectivepriority;  /* priority after transaction state accounted for */
 	int32_t           p_memstat_requestedpriority;  /* active priority */
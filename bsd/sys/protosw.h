@@ -311,6 +311,7 @@ struct protosw {
 #define PR_EVCONNINFO   0x2000  /* protocol generates conninfo event */
 #define PR_PRECONN_WRITE        0x4000  /* protocol supports preconnect write */
 #define PR_DATA_IDEMPOTENT      0x8000  /* protocol supports idempotent data at connectx-time */
+#define PR_CSUM_COPY    0x10000 /* sum payload while copying it in */
 #define PR_OLD          0x10000000 /* added via net_add_proto */
 
 /* pseudo-public domain flags */
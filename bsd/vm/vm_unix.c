@@ -3397,6 +3397,110 @@ extern uint64_t vm_copied_on_read;
 SYSCTL_QUAD(_vm, OID_AUTO, copied_on_read,
     CTLFLAG_RD | CTLFLAG_LOCKED, &vm_copied_on_read, "");
 
+extern unsigned int vm_fault_around_pages;
+SYSCTL_UINT(_vm, OID_AUTO, fault_around_pages,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_fault_around_pages, 0, "");
+extern uint64_t vm_fault_around_mapped;
+SYSCTL_QUAD(_vm, OID_AUTO, fault_around_mapped,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_fault_around_mapped, "");
+extern int vm_fault_speculative_enabled;
+SYSCTL_INT(_vm, OID_AUTO, fault_speculative,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_fault_speculative_enabled, 0, "");
+extern uint64_t vm_fault_speculative_count;
+SYSCTL_QUAD(_vm, OID_AUTO, fault_speculative_count,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_fault_speculative_count, "");
+
+extern unsigned int vm_page_zeroed_target;
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_target,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_page_zeroed_target, 0, "");
+extern unsigned int vm_page_zeroed_count;
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_count,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_count, 0, "");
+extern uint64_t vm_page_zeroed_hits;
+SYSCTL_QUAD(_vm, OID_AUTO, page_zeroed_hits,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_hits, "");
+extern uint64_t vm_page_zeroed_misses;
+SYSCTL_QUAD(_vm, OID_AUTO, page_zeroed_misses,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_misses, "");
+
+extern int vm_compressor_prefetch_enabled;
+SYSCTL_INT(_vm, OID_AUTO, compressor_prefetch,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_compressor_prefetch_enabled, 0, "");
+extern unsigned int vm_compressor_prefetch_window;
+SYSCTL_UINT(_vm, OID_AUTO, compressor_prefetch_window,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_compressor_prefetch_window, 0, "");
+extern uint64_t vm_compressor_prefetch_requests;
+SYSCTL_QUAD(_vm, OID_AUTO, compressor_prefetch_requests,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_compressor_prefetch_requests, "");
+extern uint64_t vm_compressor_prefetch_dropped;
+SYSCTL_QUAD(_vm, OID_AUTO, compressor_prefetch_dropped,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_compressor_prefetch_dropped, "");
+extern uint64_t vm_compressor_prefetch_pages;
+SYSCTL_QUAD(_vm, OID_AUTO, compressor_prefetch_pages,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_compressor_prefetch_pages, "");
+
+extern int vm_object_collapser_enabled;
+SYSCTL_INT(_vm, OID_AUTO, object_collapser,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_object_collapser_enabled, 0, "");
+extern unsigned int vm_object_collapser_depth;
+SYSCTL_UINT(_vm, OID_AUTO, object_collapser_depth,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_object_collapser_depth, 0, "");
+extern uint64_t vm_object_collapser_requests;
+SYSCTL_QUAD(_vm, OID_AUTO, object_collapser_requests,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_object_collapser_requests, "");
+extern uint64_t vm_object_collapser_dropped;
+SYSCTL_QUAD(_vm, OID_AUTO, object_collapser_dropped,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_object_collapser_dropped, "");
+extern uint64_t vm_object_collapser_busy;
+SYSCTL_QUAD(_vm, OID_AUTO, object_collapser_busy,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_object_collapser_busy, "");
+extern uint64_t vm_object_collapser_shortened;
+SYSCTL_QUAD(_vm, OID_AUTO, object_collapser_shortened,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_object_collapser_shortened, "");
+
+extern uint32_t vm_swapout_queue_depth;
+SYSCTL_UINT(_vm, OID_AUTO, swapout_queue_depth,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_swapout_queue_depth, 0, "");
+extern unsigned int vm_swapin_readahead_depth;
+SYSCTL_UINT(_vm, OID_AUTO, swapin_readahead_depth,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_swapin_readahead_depth, 0, "");
+extern unsigned int vm_swapin_readahead_window;
+SYSCTL_UINT(_vm, OID_AUTO, swapin_readahead_window,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_swapin_readahead_window, 0, "");
+extern uint64_t vm_swapin_readahead_requests;
+SYSCTL_QUAD(_vm, OID_AUTO, swapin_readahead_requests,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_swapin_readahead_requests, "");
+extern uint64_t vm_swapin_readahead_dropped;
+SYSCTL_QUAD(_vm, OID_AUTO, swapin_readahead_dropped,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_swapin_readahead_dropped, "");
+extern uint64_t vm_swapin_readahead_segments;
+SYSCTL_QUAD(_vm, OID_AUTO, swapin_readahead_segments,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_swapin_readahead_segments, "");
+extern uint64_t vm_swapin_readahead_bytes;
+SYSCTL_QUAD(_vm, OID_AUTO, swapin_readahead_bytes,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_swapin_readahead_bytes, "");
+
+#if defined(__x86_64__)
+extern int vm_superpage_enabled;
+SYSCTL_INT(_vm, OID_AUTO, superpage,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_superpage_enabled, 0, "");
+extern uint32_t vm_superpage_scan_interval_ms;
+SYSCTL_UINT(_vm, OID_AUTO, superpage_scan_interval_ms,
+    CTLFLAG_RW | CTLFLAG_LOCKED, &vm_superpage_scan_interval_ms, 0, "");
+extern uint64_t vm_superpage_fill_count;
+SYSCTL_QUAD(_vm, OID_AUTO, superpage_fill,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_superpage_fill_count, "");
+extern uint64_t vm_superpage_fill_failed;
+SYSCTL_QUAD(_vm, OID_AUTO, superpage_fill_failed,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_superpage_fill_failed, "");
+extern uint64_t vm_superpage_promoted;
+SYSCTL_QUAD(_vm, OID_AUTO, superpage_promoted,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &vm_superpage_promoted, "");
+extern uint64_t pmap_demote_count;
+SYSCTL_QUAD(_vm, OID_AUTO, superpage_demoted,
+    CTLFLAG_RD | CTLFLAG_LOCKED, &pmap_demote_count, "");
+#endif /* __x86_64__ */
+
 extern int vm_shared_region_count;
 extern int vm_shared_region_peak;
 SYSCTL_INT(_vm, OID_AUTO, shared_region_count,
@@ -138,7 +138,8 @@ protected:
 		kActionBlock     = 0x0004,
 		kSubClass0       = 0x0008,
 	};
-	uint8_t  eventSourceReserved1[1];
+	/* 1 + this source's bit in the work loop's pending set, 0 if it has none */
+	uint8_t  eventSlot;
 	uint16_t flags;
 #if __LP64__
 	uint8_t eventSourceReserved2[4];
@@ -153,6 +153,8 @@
 #define kIOUserClientMessageAppSuspendedKey     "IOUserClientMessageAppSuspended"
 #endif
 #define kIOUserClientDefaultLockingKey                  "IOUserClientDefaultLocking"
+// batches of calls from io_connect_method_batch() run in the gate of the user client's work loop
+#define kIOUserClientBatchGatedKey                      "IOUserClientBatchGated"
 // diagnostic string describing the creating task
 #define kIOUserClientCreatorKey         "IOUserClientCreator"
 // the expected cdhash value of the userspace driver executable
@@ -113,6 +113,35 @@ enum {
 	kIOCatalogServiceTerminate
 };
 
+// io_connect_method_batch
+/*!
+ *   @struct IOConnectMethodBatchCall
+ *   @abstract One call of a batch submitted with io_connect_method_batch().
+ *   @discussion The caller passes an array of these in its own memory. Each one is dispatched to IOUserClient::externalMethod() like an io_connect_method() with inband arguments, so the struct input and output are limited to sizeof(io_struct_inband_t). On return scalarOutputCount and structOutputSize hold what the method returned, and result its IOReturn.
+ */
+typedef struct IOConnectMethodBatchCall {
+	uint32_t selector;
+	uint32_t scalarInputCount;
+	uint64_t scalarInput[16];
+	uint64_t structInput;
+	uint32_t structInputSize;
+	uint32_t scalarOutputCount;
+	uint64_t scalarOutput[16];
+	uint64_t structOutput;
+	uint32_t structOutputSize;
+	IOReturn result;
+} IOConnectMethodBatchCall;
+
+/*!
+ *   @enum io_connect_method_batch options.
+ *   @constant kIOConnectMethodBatchStopOnError  Stops at the first call that does not return kIOReturnSuccess.
+ *   @constant kIOConnectMethodBatchMaxCalls  The largest number of calls in one batch.
+ */
+enum {
+	kIOConnectMethodBatchStopOnError = 0x00000001,
+	kIOConnectMethodBatchMaxCalls    = 256
+};
+
 
 #ifdef XNU_KERNEL_PRIVATE
 
@@ -2064,6 +2064,8 @@ private:
 	static IOPMRequest * acquirePMRequest( IOService * target, IOOptionBits type, IOPMRequest * active = NULL );
 	static void releasePMRequest( IOPMRequest * request );
 	static void pmDriverCallout( IOService * from );
+	static void __attribute__((__noreturn__)) pmDriverCalloutThread( void * arg, wait_result_t waitResult );
+	void pmDriverCalloutEnter( void );
 	static void pmTellAppWithResponse( OSObject * object, void * context );
 	static void pmTellClientWithResponse( OSObject * object, void * context );
 	static void pmTellCapabilityAppWithResponse( OSObject * object, void * arg );
@@ -2112,6 +2114,8 @@ private:
 	IOReturn updatePowerStatesReport( IOReportConfigureAction action, void *result, void *destination );
 	IOReturn configureSimplePowerReport(IOReportConfigureAction action, void *result );
 	IOReturn updateSimplePowerReport( IOReportConfigureAction action, void *result, void *destination );
+	IOReturn configurePowerChangeTimeReport( IOReportConfigureAction action, void *result );
+	IOReturn updatePowerChangeTimeReport( IOReportConfigureAction action, void *result, void *destination );
 	void waitForPMDriverCall( IOService * target = NULL );
 #endif /* XNU_KERNEL_PRIVATE */
 };
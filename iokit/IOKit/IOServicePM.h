@@ -58,6 +58,10 @@ typedef void (*IOPMCompletionAction)(void * target, void * param);
 #define kPMCurrStateChID  IOREPORT_MAKEID( 'P','M','C','u','r','S','t','\0' )
 #endif
 
+#ifndef kPMChangeTimeChID
+#define kPMChangeTimeChID  IOREPORT_MAKEID('P','M','C','h','g','T','i','m')
+#endif
+
 // state_id details in PM channels
 #define kPMReportPowerOn       0x01
 #define kPMReportDeviceUsable  0x02
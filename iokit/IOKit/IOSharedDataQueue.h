@@ -37,6 +37,7 @@
 #undef DISABLE_DATAQUEUE_WARNING
 
 typedef struct _IODataQueueEntry IODataQueueEntry;
+struct thread_call;
 
 /*!
  * @class IOSharedDataQueue : public IODataQueue
@@ -53,13 +54,28 @@ class IOSharedDataQueue : public IODataQueue
 {
 	OSDeclareDefaultStructors(IOSharedDataQueue);
 
+	friend class IOSharedDataQueueLanes;
+
 	struct ExpansionData {
 		UInt32 queueSize;
+		UInt32 reserveTail;
+		bool   reserving;
+		UInt32 notifyWatermark;
+		uint64_t notifyDelay;
+		struct thread_call * notifyCall;
+		volatile UInt32 notifyPending;
 	};
 /*! @var reserved
  *   Reserved for future use.  (Internal use only)  */
 	ExpansionData * _reserved;
 
+	IODataQueueEntry * allocateEntry(UInt32 tail, UInt32 head, UInt32 dataSize, UInt32 * newTail);
+	IODataQueueEntry * headEntry(UInt32 headOffset, UInt32 * entrySize, UInt32 * newHeadOffset);
+	bool commitTail(UInt32 tail, UInt32 newTail);
+	bool commitReserved();
+	void notifyDataAvailable(bool becameNonEmpty);
+	static void notifyCallout(void * queue, void * unused);
+
 protected:
 	virtual void free() APPLE_KEXT_OVERRIDE;
 
@@ -145,6 +161,55 @@ public:
  */
 	virtual Boolean enqueue(void *data, UInt32 dataSize) APPLE_KEXT_OVERRIDE;
 
+/*!
+ * @function enqueueReserve
+ * @abstract Reserves room for a new entry on the queue, without making it visible to the consumer.
+ * @discussion This method sets aside dataSize bytes after the entries already reserved and returns where the caller should write the entry data.  Any number of entries can be reserved back to back; none of them is seen by the consumer until enqueueCommit() is called, which publishes them all at once and sends at most one notification.  enqueue() fails while there are reserved entries that have not been committed.
+ * @param dataSize Size of the data of the new entry.
+ * @result Returns a pointer to dataSize bytes in the queue memory on success, or NULL if the queue is full.
+ */
+	void * enqueueReserve(UInt32 dataSize);
+
+/*!
+ * @function enqueueCommit
+ * @abstract Publishes the entries reserved with enqueueReserve().
+ * @discussion The reserved entries become visible to the consumer in the order they were reserved.  If the queue was empty, a single data available notification is sent for all of them, subject to setNotificationWatermark().
+ */
+	void enqueueCommit();
+
+/*!
+ * @function enqueueBatch
+ * @abstract Enqueues several entries at once.
+ * @discussion This method adds count entries to the queue, the size of each given by the sizes array and their data packed back to back in data.  The entries are published together and at most one notification is sent for the batch.  It stops at the first entry that does not fit.
+ * @param data Pointer to the data of the entries, back to back.
+ * @param sizes Array of count entry sizes.
+ * @param count Number of entries to add.
+ * @result Returns the number of entries that were added.
+ */
+	UInt32 enqueueBatch(const void * data, const UInt32 * sizes, UInt32 count);
+
+/*!
+ * @function dequeueBatch
+ * @abstract Dequeues several entries at once.
+ * @discussion This method copies up to count entries into data, back to back, and their sizes into sizes.  It stops at the first entry that does not fit in the remaining space.  The head is only moved once, after all the entries were copied.
+ * @param data Pointer to the memory region in which to copy the entries.
+ * @param dataSize Size of the data memory region.
+ * @param sizes Array that receives the size of each entry copied.
+ * @param count Maximum number of entries to copy, and the number of elements of sizes.
+ * @result Returns the number of entries that were dequeued.
+ */
+	UInt32 dequeueBatch(void * data, UInt32 dataSize, UInt32 * sizes, UInt32 count);
+
+/*!
+ * @function setNotificationWatermark
+ * @abstract Coalesces the data available notifications.
+ * @discussion By default a notification is sent every time an entry is added to an empty queue.  With a watermark, the notification is held back until the queue holds at least watermark bytes, or until delay microseconds have passed since the queue stopped being empty, whichever comes first.  Passing a watermark of zero restores the default behavior.
+ * @param watermark Number of queued bytes that triggers the notification.
+ * @param delay Longest time, in microseconds, a notification can be held back.  Must not be zero if watermark isn't.
+ * @result Returns true on success, false if the arguments are invalid or the timer can't be allocated.
+ */
+	Boolean setNotificationWatermark(UInt32 watermark, UInt32 delay);
+
 #ifdef PRIVATE
 /* workaround for queue.h redefine, please do not use */
 	__inline__ Boolean
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+#ifndef _IOKIT_IOSHAREDDATAQUEUELANES_H
+#define _IOKIT_IOSHAREDDATAQUEUELANES_H
+
+#include <libkern/c++/OSObject.h>
+#include <libkern/c++/OSPtr.h>
+#include <IOKit/IOSharedDataQueue.h>
+
+/*!
+ * @class IOSharedDataQueueLanes : public OSObject
+ * @abstract A set of IOSharedDataQueues, one per CPU, that any number of kernel producers can enqueue to.
+ * @discussion IOSharedDataQueue allows a single producer.  IOSharedDataQueueLanes gives each CPU its own queue, or lane, and enqueue() adds the entry to the lane of the CPU it runs on with interrupts disabled, so producers never contend with each other and the lanes keep the single producer layout.
+ *
+ * <br>Each lane is mapped into the consumer process on its own, with getMemoryDescriptor(), and drained like any IOSharedDataQueue.  The order of the entries is only kept within a lane; a consumer that needs a total order should put a timestamp in the entries and merge the lanes.
+ *
+ * <br>enqueue() must not be called from primary interrupt context, because it may send a notification.
+ */
+class IOSharedDataQueueLanes : public OSObject
+{
+	OSDeclareDefaultStructors(IOSharedDataQueueLanes);
+
+	IOSharedDataQueue ** lanes;
+	UInt32               laneCount;
+
+protected:
+	virtual void free() APPLE_KEXT_OVERRIDE;
+
+public:
+/*!
+ * @function withCapacity
+ * @abstract Static method that creates a new IOSharedDataQueueLanes instance with one lane per CPU.
+ * @param size The size of the data queue memory region of each lane, as for IOSharedDataQueue::withCapacity().
+ * @result Returns the newly allocated IOSharedDataQueueLanes instance.  Zero is returned on failure.
+ */
+	static OSPtr<IOSharedDataQueueLanes> withCapacity(UInt32 size);
+
+/*!
+ * @function initWithCapacity
+ * @abstract Initializes an IOSharedDataQueueLanes instance with one lane per CPU.
+ * @param size The size of the data queue memory region of each lane.
+ * @result Returns true on success and false on failure.
+ */
+	bool initWithCapacity(UInt32 size);
+
+/*!
+ * @function getLaneCount
+ * @abstract Returns the number of lanes.
+ */
+	UInt32 getLaneCount() const;
+
+/*!
+ * @function getLane
+ * @abstract Returns a lane, not retained.
+ * @param lane Index of the lane, less than getLaneCount().
+ * @result Returns the lane, or NULL if lane is out of range.
+ */
+	IOSharedDataQueue * getLane(UInt32 lane) const;
+
+/*!
+ * @function getMemoryDescriptor
+ * @abstract Returns a memory descriptor covering the IODataQueueMemory region of a lane, to be mapped into the consumer process.
+ * @param lane Index of the lane, less than getLaneCount().
+ * @result Returns a newly allocated IOMemoryDescriptor for the lane.  Returns zero on failure.
+ */
+	OSPtr<IOMemoryDescriptor> getMemoryDescriptor(UInt32 lane);
+
+/*!
+ * @function setNotificationPort
+ * @abstract Sets the data available notification port of all the lanes.
+ * @param port The mach port to be notified when any of the lanes has data available.
+ */
+	void setNotificationPort(mach_port_t port);
+
+/*!
+ * @function setNotificationWatermark
+ * @abstract Coalesces the data available notifications of all the lanes.
+ * @discussion See IOSharedDataQueue::setNotificationWatermark().  The watermark applies to each lane on its own.
+ * @result Returns true on success, false otherwise.
+ */
+	bool setNotificationWatermark(UInt32 watermark, UInt32 delay);
+
+/*!
+ * @function enqueue
+ * @abstract Enqueues a new entry on the lane of the current CPU.
+ * @param data Pointer to the data to be added to the queue.
+ * @param dataSize Size of the data pointed to by data.
+ * @result Returns true on success and false on failure.  Typically failure means that the lane is full.
+ */
+	bool enqueue(void * data, UInt32 dataSize);
+};
+
+#endif /* _IOKIT_IOSHAREDDATAQUEUELANES_H */
@@ -34,7 +34,7 @@
 #define IOSTATISTICS_SIG_WORKLOOP   'IOSW'
 
 /* Update when the binary format changes */
-#define IOSTATISTICS_VER                        0x2
+#define IOSTATISTICS_VER                        0x3
 
 enum {
 	kIOStatisticsDriverNameLength  = 64,
@@ -100,6 +100,12 @@ typedef struct IOStatisticsCommandQueues {
 	uint32_t actionCalls;
 } IOStatisticsCommandQueues;
 
+typedef struct IOStatisticsEventSourceDispatches {
+	uint32_t dispatches;
+	uint64_t dispatchLatency;
+	uint64_t maxDispatchLatency;
+} IOStatisticsEventSourceDispatches;
+
 typedef struct IOStatisticsUserClients {
 	uint32_t created;
 	uint32_t clientCalls;
@@ -171,6 +177,7 @@ typedef struct IOStatisticsCounter {
 	struct IOStatisticsCommandGates commandGateStatistics;
 	struct IOStatisticsCommandQueues commandQueueStatistics;
 	struct IOStatisticsDerivedEventSources derivedEventSourceStatistics;
+	struct IOStatisticsEventSourceDispatches eventSourceDispatchStatistics;
 } IOStatisticsCounter;
 
 typedef struct IOStatisticsKextIdentifier {
@@ -143,6 +143,10 @@ typedef struct IOEventSourceCounter {
 	uint64_t timeOnGate;
 	uint32_t closeGateCalls;
 	uint32_t openGateCalls;
+	uint64_t signalTimeStamp;
+	uint64_t dispatchLatency;
+	uint64_t maxDispatchLatency;
+	uint32_t dispatches;
 	union {
 		IOInterruptEventSourceCounter interrupt;
 		IOInterruptEventSourceCounter filter;
@@ -298,6 +302,29 @@ public:
 		}
 	}
 
+/* Dispatch latency, from an event source signaling work to the work loop calling its checkForWork() */
+	static inline void
+	countEventSourceSignal(IOEventSourceCounter *counter)
+	{
+		if (counter && !counter->signalTimeStamp) {
+			counter->signalTimeStamp = mach_absolute_time();
+		}
+	}
+
+	static inline void
+	countEventSourceDispatch(IOEventSourceCounter *counter)
+	{
+		if (counter && counter->signalTimeStamp) {
+			uint64_t latency = mach_absolute_time() - counter->signalTimeStamp;
+			counter->signalTimeStamp = 0;
+			counter->dispatchLatency += latency;
+			if (latency > counter->maxDispatchLatency) {
+				counter->maxDispatchLatency = latency;
+			}
+			counter->dispatches++;
+		}
+	}
+
 /* Interrupt */
 	static inline void
 	countInterruptCheckForWork(IOEventSourceCounter *counter)
@@ -237,7 +237,8 @@ public:
 	UInt8   __ipcFinal;
 	UInt8   messageAppSuspended:1,
 	    defaultLocking:1,
-	    __reservedA:6;
+	    batchGated:1,
+	    __reservedA:5;
 	volatile SInt32 __ipc;
 	queue_head_t owners;
 	IORWLock * lock;
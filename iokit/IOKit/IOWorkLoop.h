@@ -162,6 +162,10 @@ protected:
 #endif
 		uint64_t lockInterval;
 		uint64_t lockTime;
+		uint64_t pendingEventSources;
+		uint64_t polledEventSources;
+		IOEventSource *eventSlots[64];
+		bool eventSlotsOverflow;
 	};
 
 /*! @var reserved
@@ -348,6 +352,9 @@ protected:
 
 #if XNU_KERNEL_PRIVATE
 	void lockTime(void);
+	void signalEventSource(IOEventSource *source);
+	void updateEventSlots(void);
+	IOEventSource *takePendingEventSource(IOEventSource *after);
 #endif /* XNU_KERNEL_PRIVATE */
 
 protected:
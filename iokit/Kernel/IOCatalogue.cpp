@@ -62,6 +62,8 @@ extern "C" {
 #include <IOKit/assert.h>
 #include <IOKit/IOKitKeysPrivate.h>
 
+#include "IOKitKernelInternal.h"
+
 #if PRAGMA_MARK
 #pragma mark Internal Declarations
 #endif
@@ -76,10 +78,190 @@ OSSharedPtr<const OSSymbol> gIOModuleIdentifierKernelKey;
 OSSharedPtr<const OSSymbol> gIOHIDInterfaceClassName;
 IORWLock       * gIOCatalogLock;
 
+/*********************************************************************
+* The personalities of each IOProviderClass, compiled for findDrivers():
+* already in the order IOServiceOrdering would give them, and with their
+* IONameMatch resolved to symbols so a nub with plain name matching can
+* skip the ones naming something else. Compiled on first use and thrown
+* away whenever the class's personalities change.
+*********************************************************************/
+
+struct IOCatalogueMatchPredicate {
+	OSDictionary * personality;     // retained by the class's personalities
+	SInt32         score;
+	unsigned int   index;           // in the class's personalities
+	OSObject     * names;           // OSSymbol, OSSet of OSSymbol, or NULL for any
+};
+
+class _IOCatalogueCompiledClass : public OSObject
+{
+	OSDeclareDefaultStructors(_IOCatalogueCompiledClass);
+
+public:
+	IOCatalogueMatchPredicate * predicates;
+	unsigned int                count;
+
+	static OSSharedPtr<_IOCatalogueCompiledClass> withPersonalities(OSArray * array);
+	bool mayMatch(unsigned int idx, const OSSymbol * name) const;
+	virtual void free() APPLE_KEXT_OVERRIDE;
+};
+
+OSDefineMetaClassAndStructors(_IOCatalogueCompiledClass, OSObject)
+
+static OSSharedPtr<OSDictionary> gIOCatalogCompiled;
+static IOLock *                  gIOCatalogCompiledLock;
+
+extern "C" {
+void qsort(void *, size_t, size_t, int (*)(const void *, const void *));
+}
+
 #if PRAGMA_MARK
 #pragma mark Utility functions
 #endif
 
+static int
+IOCatalogueMatchPredicateCompare(const void * a, const void * b)
+{
+	const IOCatalogueMatchPredicate * p1 = (const IOCatalogueMatchPredicate *) a;
+	const IOCatalogueMatchPredicate * p2 = (const IOCatalogueMatchPredicate *) b;
+
+	// higher scores first, ties in catalogue order like OSOrderedSet
+	if (p1->score != p2->score) {
+		return (p1->score > p2->score) ? -1 : 1;
+	}
+	return (p1->index < p2->index) ? -1 : 1;
+}
+
+OSSharedPtr<_IOCatalogueCompiledClass>
+_IOCatalogueCompiledClass::withPersonalities(OSArray * array)
+{
+	OSSharedPtr<_IOCatalogueCompiledClass> compiled;
+	IOCatalogueMatchPredicate            * predicate;
+	OSDictionary                         * dict;
+	OSNumber                             * num;
+	OSObject                             * obj;
+	OSString                             * str;
+	OSSharedPtr<OSCollectionIterator>      iter;
+	OSSharedPtr<const OSSymbol>            sym;
+	OSSharedPtr<OSSet>                     set;
+	unsigned int                           idx;
+
+	compiled = OSMakeShared<_IOCatalogueCompiledClass>();
+	if (!compiled || !compiled->init()) {
+		return nullptr;
+	}
+	compiled->count = array->getCount();
+	compiled->predicates = IONewZero(IOCatalogueMatchPredicate, compiled->count);
+	if (compiled->count && !compiled->predicates) {
+		return nullptr;
+	}
+
+	for (idx = 0; (dict = (OSDictionary *) array->getObject(idx)); idx++) {
+		predicate = &compiled->predicates[idx];
+		predicate->personality = dict;
+		predicate->index       = idx;
+		num = OSDynamicCast(OSNumber, dict->getObject(gIOProbeScoreKey.get()));
+		predicate->score = num ? (SInt32) num->unsigned32BitValue() : kIODefaultProbeScore;
+
+		// IOCompatibilityMatch matches against other properties, don't guess
+		obj = dict->getObject(gIONameMatchKey);
+		if (!obj || dict->getObject(gIOCompatibilityMatchKey)) {
+			continue;
+		}
+		if ((str = OSDynamicCast(OSString, obj))) {
+			sym = OSSymbol::withString(str);
+			predicate->names = (OSObject *) sym.detach();
+		} else {
+			// the same names compareNames() would try
+			set = OSSet::withCapacity(4);
+			if (OSDynamicCast(OSCollection, obj)) {
+				iter = OSCollectionIterator::withCollection(OSDynamicCast(OSCollection, obj));
+			}
+			while (set && iter && (str = OSDynamicCast(OSString, iter->getNextObject()))) {
+				sym = OSSymbol::withString(str);
+				set->setObject(sym.get());
+			}
+			iter.reset();
+			predicate->names = set.detach();
+		}
+		if (!predicate->names) {
+			return nullptr;
+		}
+	}
+
+	qsort(compiled->predicates, compiled->count, sizeof(*compiled->predicates),
+	    &IOCatalogueMatchPredicateCompare);
+
+	return compiled;
+}
+
+/*********************************************************************
+* Whether a nub named name, matching names the default way, may match
+* the personality. NULL matches anything.
+*********************************************************************/
+bool
+_IOCatalogueCompiledClass::mayMatch(unsigned int idx, const OSSymbol * name) const
+{
+	OSObject * names = predicates[idx].names;
+	OSSet    * set;
+
+	if (!name || !names) {
+		return true;
+	}
+	if ((set = OSDynamicCast(OSSet, names))) {
+		return set->containsObject(name);
+	}
+	return names == name;
+}
+
+void
+_IOCatalogueCompiledClass::free()
+{
+	if (predicates) {
+		for (unsigned int idx = 0; idx < count; idx++) {
+			OSSafeReleaseNULL(predicates[idx].names);
+		}
+		IODelete(predicates, IOCatalogueMatchPredicate, count);
+	}
+	OSObject::free();
+}
+
+/*********************************************************************
+* Call with the catalogue lock held, for read or write.
+*********************************************************************/
+static OSSharedPtr<_IOCatalogueCompiledClass>
+IOCatalogueCopyCompiled(const OSSymbol * providerClass, OSArray * array)
+{
+	OSSharedPtr<_IOCatalogueCompiledClass> compiled;
+
+	IOLockLock(gIOCatalogCompiledLock);
+	compiled.reset(OSDynamicCast(_IOCatalogueCompiledClass,
+	    gIOCatalogCompiled->getObject(providerClass)), OSRetain);
+	if (!compiled) {
+		compiled = _IOCatalogueCompiledClass::withPersonalities(array);
+		if (compiled) {
+			gIOCatalogCompiled->setObject(providerClass, compiled.get());
+		}
+	}
+	IOLockUnlock(gIOCatalogCompiledLock);
+
+	return compiled;
+}
+
+/*********************************************************************
+* Call whenever the personalities of providerClass change.
+*********************************************************************/
+static void
+IOCatalogueInvalidateCompiled(const OSSymbol * providerClass)
+{
+	if (!gIOCatalogCompiledLock || !providerClass) {
+		return;
+	}
+	IOLockLock(gIOCatalogCompiledLock);
+	gIOCatalogCompiled->removeObject(providerClass);
+	IOLockUnlock(gIOCatalogCompiledLock);
+}
+
 #if PRAGMA_MARK
 #pragma mark IOCatalogue class implementation
 #endif
@@ -159,6 +341,7 @@ IOCatalogue::addPersonality(OSDictionary * dict)
 		OSSharedPtr<OSArray> sharedArr = OSArray::withObjects((const OSObject **)&dict, 1, 2);
 		personalities->setObject(sym, sharedArr.get());
 	}
+	IOCatalogueInvalidateCompiled(sym);
 }
 
 /*********************************************************************
@@ -176,6 +359,12 @@ IOCatalogue::init(OSArray * initArray)
 
 	generation = 1;
 
+	gIOCatalogCompiled = OSDictionary::withCapacity(32);
+	gIOCatalogCompiledLock = IOLockAlloc();
+	if (!gIOCatalogCompiled || !gIOCatalogCompiledLock) {
+		return false;
+	}
+
 	personalities = OSDictionary::withCapacity(32);
 	personalities->setOptions(OSCollection::kSort, OSCollection::kSort);
 	for (unsigned int idx = 0; (obj = initArray->getObject(idx)); idx++) {
@@ -216,26 +405,44 @@ IOCatalogue::findDrivers(
 	IOService * service,
 	SInt32 * generationCount)
 {
-	OSDictionary         * nextTable;
 	OSSharedPtr<OSOrderedSet> set;
+	OSSharedPtr<OSArray>      lists;
+	OSSharedPtr<const OSSymbol> name;
+	OSSharedPtr<_IOCatalogueCompiledClass> compiled;
+	_IOCatalogueCompiledClass * list;
+	_IOCatalogueCompiledClass * best;
+	unsigned int         * positions;
 	OSArray              * array;
+	OSObject             * obj;
+	OSDictionary         * nextTable;
 	const OSMetaClass    * meta;
-	unsigned int           idx;
+	unsigned int           idx, bestIdx;
+	bool                   compiledAll = true;
 
 	set = OSOrderedSet::withCapacity( 1, IOServiceOrdering,
 	    (void *)(gIOProbeScoreKey.get()));
-	if (!set) {
+	lists = OSArray::withCapacity(4);
+	if (!set || !lists) {
 		return NULL;
 	}
 
+	// personalities naming something else can't match a nub with plain names
+	if (IOServiceHasDefaultNameMatching(service)) {
+		name = service->copyName();
+	}
+
 	IORWLockRead(lock);
 
 	meta = service->getMetaClass();
 	while (meta) {
 		array = (OSArray *) personalities->getObject(meta->getClassNameSymbol());
 		if (array) {
-			for (idx = 0; (nextTable = (OSDictionary *) array->getObject(idx)); idx++) {
-				set->setObject(nextTable);
+			compiled = IOCatalogueCopyCompiled(meta->getClassNameSymbol(), array);
+			if (compiled) {
+				lists->setObject(compiled.get());
+			} else {
+				lists->setObject(array);
+				compiledAll = false;
 			}
 		}
 		if (meta == &IOService::gMetaClass) {
@@ -244,6 +451,48 @@ IOCatalogue::findDrivers(
 		meta = meta->getSuperClass();
 	}
 
+	/* Each list is sorted already, so merge them in the order inserting
+	 * them one by one would give: by score, ties going to the most
+	 * derived class.
+	 */
+	positions = compiledAll ? IONewZero(unsigned int, lists->getCount()) : NULL;
+	if (!positions) {
+		for (idx = 0; (obj = lists->getObject(idx)); idx++) {
+			if ((list = OSDynamicCast(_IOCatalogueCompiledClass, obj))) {
+				for (unsigned int pos = 0; pos < list->count; pos++) {
+					if (list->mayMatch(pos, name.get())) {
+						set->setObject(list->predicates[pos].personality);
+					}
+				}
+			} else {
+				array = (OSArray *) obj;
+				for (unsigned int pos = 0; (nextTable = (OSDictionary *) array->getObject(pos)); pos++) {
+					set->setObject(nextTable);
+				}
+			}
+		}
+	} else {
+		do {
+			best = NULL;
+			bestIdx = 0;
+			for (idx = 0; (list = (_IOCatalogueCompiledClass *) lists->getObject(idx)); idx++) {
+				while ((positions[idx] < list->count) && !list->mayMatch(positions[idx], name.get())) {
+					positions[idx]++;
+				}
+				if ((positions[idx] < list->count)
+				    && (!best || (list->predicates[positions[idx]].score
+				    > best->predicates[positions[bestIdx]].score))) {
+					best = list;
+					bestIdx = idx;
+				}
+			}
+			if (best) {
+				set->setLastObject(best->predicates[positions[bestIdx]++].personality);
+			}
+		} while (best);
+		IODelete(positions, unsigned int, lists->getCount());
+	}
+
 	*generationCount = getGenerationCount();
 
 	IORWLockUnlock(lock);
@@ -264,6 +513,7 @@ IOCatalogue::findDrivers(
 	OSSharedPtr<OSOrderedSet> set;
 	OSArray              * array;
 	const OSSymbol       * key;
+	OSString             * providerClass;
 	unsigned int           idx;
 
 	OSKext::uniquePersonalityProperties(matching);
@@ -278,8 +528,14 @@ IOCatalogue::findDrivers(
 		return nullptr;
 	}
 
+	// personalities are filed by IOProviderClass, only look at that class if given
+	providerClass = OSDynamicCast(OSString, matching->getObject(gIOProviderClassKey));
+
 	IORWLockRead(lock);
 	while ((key = (const OSSymbol *) iter->getNextObject())) {
+		if (providerClass && !providerClass->isEqualTo(key)) {
+			continue;
+		}
 		array = (OSArray *) personalities->getObject(key);
 		if (array) {
 			for (idx = 0; (dict = (OSDictionary *) array->getObject(idx)); idx++) {
@@ -388,6 +644,8 @@ IOCatalogue::addDrivers(
 			if (!result) {
 				break;
 			}
+			IOCatalogueInvalidateCompiled(OSDynamicCast(OSSymbol,
+			    personality->getObject(gIOProviderClassKey)));
 		}
 
 		set->setObject(personality);
@@ -434,6 +692,7 @@ IOCatalogue::removeDrivers(bool doNubMatching, bool (^shouldRemove)(OSDictionary
 					set->setObject(dict);
 					array->removeObject(idx);
 					idx--;
+					IOCatalogueInvalidateCompiled(key);
 				}
 			}
 		}
@@ -694,6 +953,7 @@ IOCatalogue::_removeDrivers(OSDictionary * matching)
 				if (dict->isEqualTo(matching, matching)) {
 					array->removeObject(idx);
 					idx--;
+					IOCatalogueInvalidateCompiled(key);
 				}
 			}
 		}
@@ -1145,6 +1405,7 @@ IOCatalogue::resetAndAddDrivers(OSArray * drivers, bool doNubMatching)
 					}
 					array->removeObject(idx);
 					idx--;
+					IOCatalogueInvalidateCompiled(key);
 				}
 			}
 		} // for...
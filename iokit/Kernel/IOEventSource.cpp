@@ -97,7 +97,7 @@ do { \
 void
 IOEventSource::signalWorkAvailable()
 {
-	workLoop->signalWorkAvailable();
+	workLoop->signalEventSource(this);
 }
 
 void
@@ -226,6 +226,8 @@ void     IOCPUInitialize(void);
 IOReturn IOInstallServicePlatformActions(IOService * service);
 IOReturn IOInstallServiceSleepPlatformActions(IOService * service);
 IOReturn IORemoveServicePlatformActions(IOService * service);
+void     IOServiceMatchIndexUpdate(IORegistryEntry * entry);
+bool     IOServiceHasDefaultNameMatching(IOService * service);
 void     IOCPUSleepKernel(void);
 void     IOPlatformActionsInitialize(void);
 
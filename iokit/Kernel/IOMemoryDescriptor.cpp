@@ -130,6 +130,26 @@ struct ioPLBlock {
 	unsigned int fFlags;        // Flags
 };
 
+// The physical segments of a wired descriptor as the unmapped kIOMDWalkSegments
+// walk finds them, each a run of contiguous pages within one iopl. The walk
+// builds them once per preparation and looks them up from then on, instead of
+// going through the page lists again for every I/O; complete() frees them
+// when the descriptor is unwired.
+struct IOMDSegment {
+	uint64_t fIOMDOffset;       // The offset of this segment in descriptor
+	uint64_t fAddress;
+	uint64_t fLength;
+};
+
+struct IOMDSegmentCache {
+	uint64_t    fPreparationID; // getPreparationID() the segments are for
+	UInt        fCount;         // 0 if there were too many to keep
+	IOMDSegment fSegments[0];
+};
+
+// Descriptors with more segments than this are walked the long way
+uint32_t gIOMemorySegmentCacheMax = 1024;
+
 enum { kMaxWireTags = 6 };
 
 struct ioGMDData {
@@ -138,6 +158,7 @@ struct ioGMDData {
 	uint64_t    fMappedBase;
 	uint64_t    fMappedLength;
 	uint64_t    fPreparationID;
+	IOMDSegmentCache * fSegmentCache;
 #if IOTRACKING
 	IOTracking  fWireTracking;
 #endif /* IOTRACKING */
@@ -2808,6 +2829,144 @@ IOMemoryDescriptor::getVMTag(vm_map_t map)
 	return IOMemoryTag(map);
 }
 
+// Finds the segments of the iopls of a wired descriptor the way the walk in
+// dmaCommandOperation() does, storing them if segments isn't NULL. Returns
+// false if there are more than max of them.
+static bool
+IOMDFindSegments(ioGMDData * dataP, UInt numIOPLs, uint64_t length,
+    IOMDSegment * segments, UInt max, UInt * count)
+{
+	const ioPLBlock * ioplList = getIOPLList(dataP);
+	upl_page_info_t * pageList;
+	uint64_t          offset, end, segLength, pageOffset;
+	ppnum_t           pageAddr;
+	UInt              ind, pageInd, found = 0;
+
+	for (ind = 0; ind < numIOPLs; ind++) {
+		const ioPLBlock & ioplInfo = ioplList[ind];
+
+		end = ((ind + 1) < numIOPLs) ? ioplList[ind + 1].fIOMDOffset : length;
+		if (ioplInfo.fFlags & kIOPLExternUPL) {
+			pageList = (upl_page_info_t *) ioplInfo.fPageInfo;
+		} else {
+			pageList = &getPageList(dataP)[ioplInfo.fPageInfo];
+		}
+
+		for (offset = ioplInfo.fIOMDOffset; offset < end; offset += segLength) {
+			if (found == max) {
+				return false;
+			}
+			pageOffset = offset - ioplInfo.fIOMDOffset + ioplInfo.fPageOffset;
+			segLength  = end - offset;
+			if (ioplInfo.fFlags & kIOPLOnDevice) {
+				pageAddr = pageList->phys_addr;
+			} else {
+				pageInd = atop_32(pageOffset);
+				pageOffset &= PAGE_MASK;
+				pageAddr = pageList[pageInd].phys_addr;
+				if (!pageAddr) {
+					return false;
+				}
+				// the segment ends where the pages stop being contiguous
+				IOByteCount contigLength = PAGE_SIZE - pageOffset;
+				ppnum_t     nextAddr = pageAddr;
+				while (contigLength < segLength
+				    && ++nextAddr == pageList[++pageInd].phys_addr) {
+					contigLength += PAGE_SIZE;
+				}
+				if (contigLength < segLength) {
+					segLength = contigLength;
+				}
+			}
+			if (segments) {
+				segments[found].fIOMDOffset = offset;
+				segments[found].fAddress    = ptoa_64(pageAddr) + pageOffset;
+				segments[found].fLength     = segLength;
+			}
+			found++;
+		}
+	}
+	*count = found;
+
+	return true;
+}
+
+static void
+IOMDSegmentCacheFree(IOMDSegmentCache * cache)
+{
+	IOFree(cache, sizeof(IOMDSegmentCache) + cache->fCount * sizeof(IOMDSegment));
+}
+
+// Returns the segments of a wired descriptor for this preparation, finding
+// them on first use, or NULL if the walk has to find each one itself.
+static IOMDSegmentCache *
+IOMDSegmentCacheGet(IOGeneralMemoryDescriptor * md, ioGMDData * dataP, UInt numIOPLs, uint64_t length)
+{
+	IOMDSegmentCache * cache;
+	UInt               count;
+
+	cache = dataP->fSegmentCache;
+	if (!cache) {
+		if (!IOMDFindSegments(dataP, numIOPLs, length, NULL, gIOMemorySegmentCacheMax, &count)) {
+			// keep an empty one so the next walk doesn't try again
+			count = 0;
+		}
+		cache = (typeof(cache)) IOMalloc(sizeof(IOMDSegmentCache) + count * sizeof(IOMDSegment));
+		if (!cache) {
+			return NULL;
+		}
+		cache->fPreparationID = md->getPreparationID();
+		cache->fCount         = count;
+		if (count) {
+			IOMDFindSegments(dataP, numIOPLs, length, &cache->fSegments[0], count, &count);
+		}
+		// walks of the same descriptor can race to make it
+		if (!OSCompareAndSwapPtr(NULL, cache, (void * volatile *) &dataP->fSegmentCache)) {
+			IOMDSegmentCacheFree(cache);
+			cache = dataP->fSegmentCache;
+		}
+	}
+	if (!cache->fCount || (cache->fPreparationID != dataP->fPreparationID)) {
+		return NULL;
+	}
+
+	return cache;
+}
+
+// Looks up the segment containing offset, trying the one at *hint and the one
+// after it first since walks go through the segments in order.
+static const IOMDSegment *
+IOMDSegmentCacheFind(const IOMDSegmentCache * cache, uint64_t offset, UInt * hint)
+{
+	const IOMDSegment * segment;
+	UInt                ind, lo, hi;
+
+	for (ind = *hint; (ind < cache->fCount) && (ind - *hint < 2); ind++) {
+		segment = &cache->fSegments[ind];
+		if ((offset >= segment->fIOMDOffset) && ((offset - segment->fIOMDOffset) < segment->fLength)) {
+			*hint = ind;
+			return segment;
+		}
+	}
+
+	lo = 0;
+	hi = cache->fCount;
+	while (lo < hi) {
+		ind = lo + ((hi - lo) / 2);
+		segment = &cache->fSegments[ind];
+		if (offset < segment->fIOMDOffset) {
+			hi = ind;
+		} else if ((offset - segment->fIOMDOffset) >= segment->fLength) {
+			lo = ind + 1;
+		} else {
+			*hint = ind;
+			return segment;
+		}
+	}
+
+	return NULL;
+}
+
 IOReturn
 IOGeneralMemoryDescriptor::dmaCommandOperation(DMACommandOps op, void *vData, UInt dataSize) const
 {
@@ -3105,6 +3264,23 @@ IOGeneralMemoryDescriptor::dmaCommandOperation(DMACommandOps op, void *vData, UI
 
 			assert(numIOPLs > 0);
 
+			// The iopls don't change until complete(), so once their segments
+			// have been found the unmapped walk only has to look them up
+			if (!mapped) {
+				IOMDSegmentCache *  cache;
+				const IOMDSegment * segment;
+				UInt                hint = params ? 0 : isP->fIndex;
+
+				if ((cache = IOMDSegmentCacheGet(md, dataP, numIOPLs, _length))
+				    && (segment = IOMDSegmentCacheFind(cache, offset, &hint))) {
+					address = segment->fAddress + (offset - segment->fIOMDOffset);
+					length  = segment->fLength - (offset - segment->fIOMDOffset);
+					ind     = hint;
+					off2Ind = segment->fIOMDOffset;
+					continue; // Done leave do/while(false) now
+				}
+			}
+
 			// Scan through iopl info blocks looking for block containing offset
 			while (ind < numIOPLs && offset >= ioplList[ind].fIOMDOffset) {
 				ind++;
@@ -4312,6 +4488,7 @@ IOGeneralMemoryDescriptor::initMemoryEntries(size_t size, IOMapper * mapper)
 	dataP->fDMAMapNumAddressBits = 64;
 	dataP->fDMAMapAlignment      = 0;
 	dataP->fPreparationID        = kIOPreparationIDUnprepared;
+	dataP->fSegmentCache         = NULL;
 	dataP->fCompletionError      = false;
 	dataP->fMappedBaseValid      = false;
 
@@ -4628,6 +4805,10 @@ IOGeneralMemoryDescriptor::complete(IODirection forDirection)
 					dmaUnmap(dataP->fMapper, NULL, 0, dataP->fMappedBase, dataP->fMappedLength);
 					dataP->fMappedBaseValid = dataP->fMappedBase = 0;
 				}
+				if (dataP->fSegmentCache) {
+					IOMDSegmentCacheFree(dataP->fSegmentCache);
+					dataP->fSegmentCache = NULL;
+				}
 #if IOTRACKING
 				if (dataP->fWireTracking.link.next) {
 					IOTrackingRemove(gIOWireTracking, &dataP->fWireTracking, ptoa(_pages));
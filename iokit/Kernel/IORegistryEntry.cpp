@@ -37,6 +37,8 @@
 #include <stdatomic.h>
 #include <IOKit/assert.h>
 #include <machine/atomic.h>
+#include <kern/epoch.h>
+#include <kern/thread_call.h>
 
 #include "IOKitKernelInternal.h"
 
@@ -60,11 +62,14 @@ OSDefineMetaClassAndStructors(IORegistryEntry, OSObject)
 
 #define KASLR_IOREG_DEBUG 0
 
+struct IORegistryPlaneLinks;
+
 struct IORegistryEntry::ExpansionData {
 	IORecursiveLock *        fLock;
 	uint64_t                 fRegistryEntryID;
 	SInt32                   fRegistryEntryGenerationCount;
 	OSObject       **_Atomic fIndexedProperties;
+	IORegistryPlaneLinks * _Atomic fPlaneLinks;
 };
 
 
@@ -89,6 +94,34 @@ enum { kIORegistryIDReserved = (1ULL << 32) + 255 };
 
 static uint64_t gIORegistryLastID = kIORegistryIDReserved;
 
+// The plane links of an entry as seen by readers that don't take
+// gIORegistryLock. makeLink() and breakLink() mirror every change they make to
+// the registryTable() link arrays into a list per plane and relation, in the
+// same order. Readers walk the lists in an IORegistryReadEnter() section.
+// A link that is unlinked is retired: it takes a reference on its entry and is
+// only freed, by IORegistryReclaimLinks(), once every reader that might still
+// be looking at it has left, so readers may retain what they find.
+struct IORegistryLink {
+	IORegistryLink * _Atomic next;
+	IORegistryEntry *        entry;
+	IORegistryLink *         retired;
+};
+
+struct IORegistryPlaneLinks {
+	// published once, never unlinked while the entry lives
+	IORegistryPlaneLinks *   next;
+	const IORegistryPlane *  plane;
+	IORegistryLink * _Atomic head[kNumSetIndex];
+	IORegistryLink *         tail[kNumSetIndex];
+	uint32_t _Atomic         count[kNumSetIndex];
+};
+
+static struct epoch              gIORegistryReadEpoch;
+static IORegistryLink * _Atomic  gIORegistryRetiredLinks;
+static thread_call_t             gIORegistryReclaimCall;
+
+static void IORegistryReclaimLinks(thread_call_param_t param0, thread_call_param_t param1);
+
 class IORegistryPlane : public OSObject {
 	friend class IORegistryEntry;
 
@@ -136,6 +169,256 @@ lck_grp_t       *gIORegistryLockGrp;
 lck_grp_attr_t  *gIORegistryLockGrpAttr;
 lck_attr_t      *gIORegistryLockAttr;
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Read-side section for walking plane links without gIORegistryLock.
+// Preemption stays disabled throughout, which bounds how long
+// IORegistryReclaimLinks() waits, so nothing in it may block.
+static inline void
+IORegistryReadEnter(void)
+{
+	epoch_enter(&gIORegistryReadEpoch);
+}
+
+static inline void
+IORegistryReadExit(void)
+{
+	epoch_exit(&gIORegistryReadEpoch);
+}
+
+// Frees the retired links once the readers that might still see them are gone.
+static void
+IORegistryReclaimLinks(__unused thread_call_param_t param0,
+    __unused thread_call_param_t param1)
+{
+	IORegistryLink * link;
+	IORegistryLink * next;
+
+	link = os_atomic_xchg(&gIORegistryRetiredLinks, NULL, acquire);
+	if (!link) {
+		return;
+	}
+
+	epoch_synchronize(&gIORegistryReadEpoch);
+
+	for (; link; link = next) {
+		next = link->retired;
+		link->entry->release();
+		IODelete(link, IORegistryLink, 1);
+	}
+}
+
+// call with gIORegistryLock held exclusive, before the link array drops entry
+static void
+IORegistryRetireLink(IORegistryLink * link)
+{
+	IORegistryLink * head;
+
+	link->entry->retain();
+	os_atomic_rmw_loop(&gIORegistryRetiredLinks, head, link, release, {
+		link->retired = head;
+	});
+	thread_call_enter(gIORegistryReclaimCall);
+}
+
+static IORegistryPlaneLinks *
+IORegistryFindPlaneLinks(IORegistryPlaneLinks * _Atomic * list,
+    const IORegistryPlane * plane)
+{
+	IORegistryPlaneLinks * planeLinks;
+
+	for (planeLinks = os_atomic_load(list, acquire);
+	    planeLinks && (planeLinks->plane != plane);
+	    planeLinks = planeLinks->next) {
+	}
+	return planeLinks;
+}
+
+// call with gIORegistryLock held exclusive
+static IORegistryPlaneLinks *
+IORegistryGetPlaneLinks(IORegistryPlaneLinks * _Atomic * list,
+    const IORegistryPlane * plane)
+{
+	IORegistryPlaneLinks * planeLinks;
+
+	planeLinks = IORegistryFindPlaneLinks(list, plane);
+	if (!planeLinks) {
+		planeLinks = IONew(IORegistryPlaneLinks, 1);
+		if (planeLinks) {
+			bzero(planeLinks, sizeof(*planeLinks));
+			planeLinks->plane = plane;
+			planeLinks->next = os_atomic_load(list, relaxed);
+			os_atomic_store(list, planeLinks, release);
+		}
+	}
+	return planeLinks;
+}
+
+// call with gIORegistryLock held exclusive, once the link array has entry
+static void
+IORegistryAppendLink(IORegistryPlaneLinks * planeLinks, unsigned int relation,
+    IORegistryLink * link)
+{
+	os_atomic_store(&link->next, NULL, relaxed);
+	if (planeLinks->tail[relation]) {
+		os_atomic_store(&planeLinks->tail[relation]->next, link, release);
+	} else {
+		os_atomic_store(&planeLinks->head[relation], link, release);
+	}
+	planeLinks->tail[relation] = link;
+	os_atomic_inc(&planeLinks->count[relation], relaxed);
+}
+
+// call with gIORegistryLock held exclusive, before the link array drops entry
+static void
+IORegistryRemoveLink(IORegistryPlaneLinks * planeLinks, unsigned int relation,
+    IORegistryEntry * entry)
+{
+	IORegistryLink * _Atomic * prev;
+	IORegistryLink *           link;
+	IORegistryLink *           last = NULL;
+
+	for (prev = &planeLinks->head[relation];
+	    (link = os_atomic_load(prev, relaxed));
+	    prev = &link->next) {
+		if (entry == link->entry) {
+			// readers on the link carry on past it
+			os_atomic_store(prev, os_atomic_load(&link->next, relaxed), release);
+			if (planeLinks->tail[relation] == link) {
+				planeLinks->tail[relation] = last;
+			}
+			os_atomic_dec(&planeLinks->count[relation], relaxed);
+			IORegistryRetireLink(link);
+			return;
+		}
+		last = link;
+	}
+}
+
+// call with gIORegistryLock held exclusive, before the link arrays are dropped
+static void
+IORegistryRemoveAllLinks(IORegistryPlaneLinks * planeLinks)
+{
+	IORegistryLink * link;
+	IORegistryLink * next;
+
+	for (unsigned int relation = 0; relation < kNumSetIndex; relation++) {
+		link = os_atomic_xchg(&planeLinks->head[relation], NULL, release);
+		planeLinks->tail[relation] = NULL;
+		os_atomic_store(&planeLinks->count[relation], 0, relaxed);
+		for (; link; link = next) {
+			next = os_atomic_load(&link->next, relaxed);
+			IORegistryRetireLink(link);
+		}
+	}
+}
+
+// For an entry being freed, whose links nobody can reach anymore.
+static void
+IORegistryFreePlaneLinks(IORegistryPlaneLinks * planeLinks)
+{
+	IORegistryPlaneLinks * nextLinks;
+	IORegistryLink *       link;
+	IORegistryLink *       next;
+
+	for (; planeLinks; planeLinks = nextLinks) {
+		nextLinks = planeLinks->next;
+		for (unsigned int relation = 0; relation < kNumSetIndex; relation++) {
+			for (link = os_atomic_load(&planeLinks->head[relation], relaxed); link; link = next) {
+				next = os_atomic_load(&link->next, relaxed);
+				IODelete(link, IORegistryLink, 1);
+			}
+		}
+		IODelete(planeLinks, IORegistryPlaneLinks, 1);
+	}
+}
+
+static uint32_t
+IORegistryLinkCount(IORegistryPlaneLinks * _Atomic * list,
+    const IORegistryPlane * plane, unsigned int relation)
+{
+	IORegistryPlaneLinks * planeLinks;
+
+	planeLinks = IORegistryFindPlaneLinks(list, plane);
+	return planeLinks ? os_atomic_load(&planeLinks->count[relation], relaxed) : 0;
+}
+
+// call in an IORegistryReadEnter() section
+static IORegistryLink *
+IORegistryFirstLink(IORegistryPlaneLinks * _Atomic * list,
+    const IORegistryPlane * plane, unsigned int relation)
+{
+	IORegistryPlaneLinks * planeLinks;
+
+	planeLinks = IORegistryFindPlaneLinks(list, plane);
+	return planeLinks ? os_atomic_load(&planeLinks->head[relation], acquire) : NULL;
+}
+
+// call in an IORegistryReadEnter() section
+static bool
+IORegistryLinkMember(IORegistryPlaneLinks * _Atomic * list,
+    const IORegistryPlane * plane, unsigned int relation,
+    const IORegistryEntry * entry)
+{
+	IORegistryLink * link;
+
+	for (link = IORegistryFirstLink(list, plane, relation);
+	    link && (link->entry != entry);
+	    link = os_atomic_load(&link->next, acquire)) {
+	}
+	return link != NULL;
+}
+
+// Copies the linked entries into a new array, without gIORegistryLock.
+static OSArray *
+IORegistryCopyLinks(IORegistryPlaneLinks * _Atomic * list,
+    const IORegistryPlane * plane, unsigned int relation)
+{
+	IORegistryLink *   link;
+	IORegistryEntry ** entries;
+	OSArray *          array;
+	uint32_t           capacity, count;
+
+	do {
+		// entries can't be allocated in the read section, so guess
+		// and start over if more were linked in the meantime
+		capacity = IORegistryLinkCount(list, plane, relation) + 4;
+		entries = IONew(IORegistryEntry *, capacity);
+		if (!entries) {
+			return NULL;
+		}
+		count = 0;
+		IORegistryReadEnter();
+		for (link = IORegistryFirstLink(list, plane, relation);
+		    link && (count < capacity);
+		    link = os_atomic_load(&link->next, acquire)) {
+			entries[count] = link->entry;
+			entries[count]->retain();
+			count++;
+		}
+		IORegistryReadExit();
+
+		if (link) {
+			while (count) {
+				entries[--count]->release();
+			}
+			IODelete(entries, IORegistryEntry *, capacity);
+		}
+	} while (link);
+
+	if (count) {
+		array = OSArray::withObjects((const OSObject **) entries, count, count);
+	} else {
+		array = OSArray::withCapacity(1);
+	}
+	while (count) {
+		entries[--count]->release();
+	}
+	IODelete(entries, IORegistryEntry *, capacity);
+
+	return array;
+}
+
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
@@ -151,12 +434,16 @@ IORegistryEntry::initialize( void )
 		lck_attr_rw_shared_priority(gIORegistryLockAttr);
 		lck_rw_init( &gIORegistryLock, gIORegistryLockGrp, gIORegistryLockAttr);
 
+		epoch_init(&gIORegistryReadEpoch);
+		gIORegistryReclaimCall = thread_call_allocate_with_options(
+			&IORegistryReclaimLinks, NULL, THREAD_CALL_PRIORITY_KERNEL, 0);
+
 		gRegistryRoot = new IORegistryEntry;
 		gPropertiesLock = IORecursiveLockAlloc();
 		gIORegistryPlanes = OSDictionary::withCapacity( 1 );
 
 		assert( gRegistryRoot && gPropertiesLock
-		    && gIORegistryPlanes );
+		    && gIORegistryPlanes && gIORegistryReclaimCall );
 		ok = gRegistryRoot->init();
 
 		if (ok) {
@@ -354,6 +641,13 @@ IORegistryEntry::init( IORegistryEntry * old,
 	OSArray *           all;
 	IORegistryEntry *           next;
 	unsigned int        index;
+	OSCollectionIterator *      iter;
+	const OSSymbol *            key;
+	const IORegistryPlane *     linkPlane;
+	IORegistryPlaneLinks *      planeLinks;
+	IORegistryLink *            link;
+	IORegistryLink *            spare;
+	bool                        ok;
 
 	if (!super::init()) {
 		return false;
@@ -373,6 +667,39 @@ IORegistryEntry::init( IORegistryEntry * old,
 
 	WLOCK;
 
+	// the links to mirror are allocated before anything changes,
+	// so that failing leaves old as it was
+	spare = NULL;
+	iter = OSCollectionIterator::withCollection( gIORegistryPlanes );
+	ok = (iter != NULL);
+	while (ok && (key = (const OSSymbol *) iter->getNextObject())) {
+		linkPlane = (const IORegistryPlane *) gIORegistryPlanes->getObject( key );
+		for (unsigned int relation = 0; ok && (relation < kNumSetIndex); relation++) {
+			all = (OSArray *) old->registryTable()->getObject( linkPlane->keys[relation] );
+			if (!all || !all->getCount()) {
+				continue;
+			}
+			ok = (NULL != IORegistryGetPlaneLinks( &reserved->fPlaneLinks, linkPlane ));
+			for (index = 0; ok && (index < all->getCount()); index++) {
+				link = IONew( IORegistryLink, 1 );
+				ok = (link != NULL);
+				if (ok) {
+					link->retired = spare;
+					spare = link;
+				}
+			}
+		}
+	}
+	if (!ok) {
+		UNLOCK;
+		for (; spare; spare = link) {
+			link = spare->retired;
+			IODelete( spare, IORegistryLink, 1 );
+		}
+		OSSafeReleaseNULL( iter );
+		return false;
+	}
+
 	reserved->fRegistryEntryID = old->reserved->fRegistryEntryID;
 
 	fPropertyTable = old->dictionaryWithProperties();
@@ -381,9 +708,32 @@ IORegistryEntry::init( IORegistryEntry * old,
 	old->fRegistryTable = (OSDictionary *) fRegistryTable->copyCollection();
 #endif /* IOREGSPLITTABLES */
 
+	if ((planeLinks = IORegistryFindPlaneLinks( &old->reserved->fPlaneLinks, plane ))) {
+		IORegistryRemoveAllLinks( planeLinks );
+	}
 	old->registryTable()->removeObject( plane->keys[kParentSetIndex] );
 	old->registryTable()->removeObject( plane->keys[kChildSetIndex] );
 
+	// the links came along with the table, in every plane
+	iter->reset();
+	while ((key = (const OSSymbol *) iter->getNextObject())) {
+		linkPlane = (const IORegistryPlane *) gIORegistryPlanes->getObject( key );
+		for (unsigned int relation = 0; relation < kNumSetIndex; relation++) {
+			all = (OSArray *) registryTable()->getObject( linkPlane->keys[relation] );
+			planeLinks = all ? IORegistryFindPlaneLinks( &reserved->fPlaneLinks, linkPlane ) : NULL;
+			for (index = 0;
+			    planeLinks && (next = (IORegistryEntry *) all->getObject(index));
+			    index++) {
+				link = spare;
+				spare = link->retired;
+				link->entry = next;
+				IORegistryAppendLink( planeLinks, relation, link );
+			}
+		}
+	}
+	OSSafeReleaseNULL( iter );
+	assert( spare == NULL );
+
 	all = getParentSetReference( plane );
 	if (all) {
 		for (index = 0;
@@ -441,6 +791,7 @@ IORegistryEntry::free( void )
 			}
 			IODelete(array, OSObject *, kIORegistryEntryIndexedPropertyCount);
 		}
+		IORegistryFreePlaneLinks(os_atomic_load(&reserved->fPlaneLinks, relaxed));
 		if (reserved->fLock) {
 			IORecursiveLockFree(reserved->fLock);
 		}
@@ -463,6 +814,8 @@ IORegistryEntry::setPropertyTable( OSDictionary * dict )
 
 	fPropertyTable = dict;
 	PUNLOCK;
+
+	IOServiceMatchIndexUpdate(this);
 }
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
@@ -739,6 +1092,10 @@ IORegistryEntry::removeProperty( const OSSymbol * aKey)
 	PLOCK;
 	getPropertyTable()->removeObject( aKey );
 	PUNLOCK;
+
+	if (aKey == gIOBSDNameKey) {
+		IOServiceMatchIndexUpdate(this);
+	}
 }
 
 #if KASLR_IOREG_DEBUG
@@ -767,6 +1124,10 @@ IORegistryEntry::setProperty( const OSSymbol * aKey, OSObject * anObject)
 	ret = getPropertyTable()->setObject( aKey, anObject );
 	PUNLOCK;
 
+	if (aKey == gIOBSDNameKey) {
+		IOServiceMatchIndexUpdate(this);
+	}
+
 #if KASLR_IOREG_DEBUG
 	if (anObject && strcmp(kIOKitDiagnosticsKey, aKey->getCStringNoCopy()) != 0) {
 		if (ScanForAddrInObject(anObject, 0)) {
@@ -1106,6 +1467,10 @@ IORegistryEntry::setName( const OSSymbol * name,
 		WLOCK;
 		registryTable()->setObject( key, (OSObject *) name);
 		UNLOCK;
+
+		if (!plane) {
+			IOServiceMatchIndexUpdate(this);
+		}
 	}
 }
 
@@ -1698,17 +2063,31 @@ IORegistryEntry::makeLink( IORegistryEntry * to,
     unsigned int relation,
     const IORegistryPlane * plane ) const
 {
-	OSArray *   links;
-	bool        result = false;
+	OSArray *               links;
+	IORegistryPlaneLinks *  planeLinks;
+	IORegistryLink *        link;
+	bool                    result = false;
+
+	planeLinks = IORegistryGetPlaneLinks( &reserved->fPlaneLinks, plane );
+	if (!planeLinks) {
+		return false;
+	}
 
 	if ((links = (OSArray *)
 	    registryTable()->getObject( plane->keys[relation] ))) {
 		result = arrayMember( links, to );
-		if (!result) {
-			result = links->setObject( to );
+		if (result) {
+			link = NULL;
+		} else {
+			link = IONew( IORegistryLink, 1 );
+			result = (link != NULL);
+			if (result) {
+				result = links->setObject( to );
+			}
 		}
 	} else {
-		links = OSArray::withObjects((const OSObject **) &to, 1, 1 );
+		link = IONew( IORegistryLink, 1 );
+		links = link ? OSArray::withObjects((const OSObject **) &to, 1, 1 ) : NULL;
 		result = (links != NULL);
 		if (result) {
 			result = registryTable()->setObject( plane->keys[relation],
@@ -1716,6 +2095,14 @@ IORegistryEntry::makeLink( IORegistryEntry * to,
 			links->release();
 		}
 	}
+	if (link) {
+		if (result) {
+			link->entry = to;
+			IORegistryAppendLink( planeLinks, relation, link );
+		} else {
+			IODelete( link, IORegistryLink, 1 );
+		}
+	}
 	reserved->fRegistryEntryGenerationCount++;
 
 	return result;
@@ -1728,10 +2115,14 @@ IORegistryEntry::breakLink( IORegistryEntry * to,
 {
 	OSArray *           links;
 	unsigned int        index;
+	IORegistryPlaneLinks * planeLinks;
 
 	if ((links = (OSArray *)
 	    registryTable()->getObject( plane->keys[relation]))) {
 		if (arrayMember( links, to, &index )) {
+			if ((planeLinks = IORegistryFindPlaneLinks( &reserved->fPlaneLinks, plane ))) {
+				IORegistryRemoveLink( planeLinks, relation, to );
+			}
 			links->removeObject( index );
 			if (0 == links->getCount()) {
 				registryTable()->removeObject( plane->keys[relation]);
@@ -1765,14 +2156,7 @@ IORegistryEntry::getParentIterator(
 		return NULL;
 	}
 
-	RLOCK;
-	links = getParentSetReference( plane );
-	if (NULL == links) {
-		links = OSArray::withCapacity( 1 );
-	} else {
-		links = OSArray::withArray( links, links->getCount());
-	}
-	UNLOCK;
+	links = IORegistryCopyLinks( &reserved->fPlaneLinks, plane, kParentSetIndex );
 
 	iter = IOLinkIterator::withCollection( links );
 
@@ -1787,16 +2171,16 @@ IORegistryEntry *
 IORegistryEntry::copyParentEntry( const IORegistryPlane * plane ) const
 {
 	IORegistryEntry *   entry = NULL;
-	OSArray *           links;
+	IORegistryLink *    link;
 
-	RLOCK;
+	IORegistryReadEnter();
 
-	if ((links = getParentSetReference( plane ))) {
-		entry = (IORegistryEntry *) links->getObject( 0 );
+	if ((link = IORegistryFirstLink( &reserved->fPlaneLinks, plane, kParentSetIndex ))) {
+		entry = link->entry;
 		entry->retain();
 	}
 
-	UNLOCK;
+	IORegistryReadExit();
 
 	return entry;
 }
@@ -1835,14 +2219,7 @@ IORegistryEntry::getChildIterator( const IORegistryPlane * plane ) const
 		return NULL;
 	}
 
-	RLOCK;
-	links = getChildSetReference( plane );
-	if (NULL == links) {
-		links = OSArray::withCapacity( 1 );
-	} else {
-		links = OSArray::withArray( links, links->getCount());
-	}
-	UNLOCK;
+	links = IORegistryCopyLinks( &reserved->fPlaneLinks, plane, kChildSetIndex );
 
 	iter = IOLinkIterator::withCollection( links );
 
@@ -1856,17 +2233,7 @@ IORegistryEntry::getChildIterator( const IORegistryPlane * plane ) const
 uint32_t
 IORegistryEntry::getChildCount( const IORegistryPlane * plane ) const
 {
-	OSArray * links;
-	uint32_t  count = 0;
-
-	RLOCK;
-	links = getChildSetReference( plane );
-	if (links) {
-		count = links->getCount();
-	}
-	UNLOCK;
-
-	return count;
+	return IORegistryLinkCount( &reserved->fPlaneLinks, plane, kChildSetIndex );
 }
 
 IORegistryEntry *
@@ -1874,16 +2241,16 @@ IORegistryEntry::copyChildEntry(
 	const IORegistryPlane * plane ) const
 {
 	IORegistryEntry *   entry = NULL;
-	OSArray *           links;
+	IORegistryLink *    link;
 
-	RLOCK;
+	IORegistryReadEnter();
 
-	if ((links = getChildSetReference( plane ))) {
-		entry = (IORegistryEntry *) links->getObject( 0 );
+	if ((link = IORegistryFirstLink( &reserved->fPlaneLinks, plane, kChildSetIndex ))) {
+		entry = link->entry;
 		entry->retain();
 	}
 
-	UNLOCK;
+	IORegistryReadExit();
 
 	return entry;
 }
@@ -1921,9 +2288,7 @@ IORegistryEntry::applyToChildren( IORegistryEntryApplierFunction applier,
 		return;
 	}
 
-	RLOCK;
-	array = OSArray::withArray( getChildSetReference( plane ));
-	UNLOCK;
+	array = IORegistryCopyLinks( &reserved->fPlaneLinks, plane, kChildSetIndex );
 	if (array) {
 		for (index = 0;
 		    (next = (IORegistryEntry *) array->getObject( index ));
@@ -1947,9 +2312,7 @@ IORegistryEntry::applyToParents( IORegistryEntryApplierFunction applier,
 		return;
 	}
 
-	RLOCK;
-	array = OSArray::withArray( getParentSetReference( plane ));
-	UNLOCK;
+	array = IORegistryCopyLinks( &reserved->fPlaneLinks, plane, kParentSetIndex );
 	if (array) {
 		for (index = 0;
 		    (next = (IORegistryEntry *) array->getObject( index ));
@@ -1965,21 +2328,21 @@ IORegistryEntry::isChild( IORegistryEntry * child,
     const IORegistryPlane * plane,
     bool onlyChild ) const
 {
-	OSArray *   links;
+	uint32_t    count;
 	bool        ret = false;
 
-	RLOCK;
+	IORegistryReadEnter();
 
-	if ((links = getChildSetReference( plane ))) {
-		if ((!onlyChild) || (1 == links->getCount())) {
-			ret = arrayMember( links, child );
+	if ((count = IORegistryLinkCount( &reserved->fPlaneLinks, plane, kChildSetIndex ))) {
+		if ((!onlyChild) || (1 == count)) {
+			ret = IORegistryLinkMember( &reserved->fPlaneLinks, plane, kChildSetIndex, child );
 		}
 	}
-	if (ret && (links = child->getParentSetReference( plane ))) {
-		ret = arrayMember( links, this );
+	if (ret && IORegistryLinkCount( &child->reserved->fPlaneLinks, plane, kParentSetIndex )) {
+		ret = IORegistryLinkMember( &child->reserved->fPlaneLinks, plane, kParentSetIndex, this );
 	}
 
-	UNLOCK;
+	IORegistryReadExit();
 
 	return ret;
 }
@@ -1989,21 +2352,21 @@ IORegistryEntry::isParent( IORegistryEntry * parent,
     const IORegistryPlane * plane,
     bool onlyParent ) const
 {
-	OSArray *   links;
+	uint32_t    count;
 	bool        ret = false;
 
-	RLOCK;
+	IORegistryReadEnter();
 
-	if ((links = getParentSetReference( plane ))) {
-		if ((!onlyParent) || (1 == links->getCount())) {
-			ret = arrayMember( links, parent );
+	if ((count = IORegistryLinkCount( &reserved->fPlaneLinks, plane, kParentSetIndex ))) {
+		if ((!onlyParent) || (1 == count)) {
+			ret = IORegistryLinkMember( &reserved->fPlaneLinks, plane, kParentSetIndex, parent );
 		}
 	}
-	if (ret && (links = parent->getChildSetReference( plane ))) {
-		ret = arrayMember( links, this );
+	if (ret && IORegistryLinkCount( &parent->reserved->fPlaneLinks, plane, kChildSetIndex )) {
+		ret = IORegistryLinkMember( &parent->reserved->fPlaneLinks, plane, kChildSetIndex, this );
 	}
 
-	UNLOCK;
+	IORegistryReadExit();
 
 	return ret;
 }
@@ -2011,46 +2374,22 @@ IORegistryEntry::isParent( IORegistryEntry * parent,
 bool
 IORegistryEntry::inPlane( const IORegistryPlane * plane ) const
 {
-	bool ret;
-
-	RLOCK;
+	IORegistryPlaneLinks * planeLinks;
 
 	if (plane) {
-		ret = (NULL != getParentSetReference( plane ));
-	} else {
-		// Check to see if this is in any plane.  If it is in a plane
-		// then the registryTable will contain a key with the ParentLinks
-		// suffix.  When we iterate over the keys looking for that suffix
-		ret = false;
-
-		OSCollectionIterator *iter =
-		    OSCollectionIterator::withCollection( registryTable());
-		if (iter) {
-			const OSSymbol *key;
-
-			while ((key = (OSSymbol *) iter->getNextObject())) {
-				size_t keysuffix;
+		return 0 != IORegistryLinkCount( &reserved->fPlaneLinks, plane, kParentSetIndex );
+	}
 
-				// Get a pointer to this keys suffix
-				keysuffix = key->getLength();
-				if (keysuffix <= kIORegPlaneParentSuffixLen) {
-					continue;
-				}
-				keysuffix -= kIORegPlaneParentSuffixLen;
-				if (!strncmp(key->getCStringNoCopy() + keysuffix,
-				    kIORegPlaneParentSuffix,
-				    kIORegPlaneParentSuffixLen + 1)) {
-					ret = true;
-					break;
-				}
-			}
-			iter->release();
+	// in any plane
+	for (planeLinks = os_atomic_load( &reserved->fPlaneLinks, acquire );
+	    planeLinks;
+	    planeLinks = planeLinks->next) {
+		if (os_atomic_load( &planeLinks->count[kParentSetIndex], relaxed )) {
+			return true;
 		}
 	}
 
-	UNLOCK;
-
-	return ret;
+	return false;
 }
 
 bool
@@ -2274,36 +2613,45 @@ IORegistryEntry::getDepth( const IORegistryPlane * plane ) const
 	unsigned int                oneDepth, maxParentDepth, count;
 	IORegistryEntry *           one;
 	const IORegistryEntry *     next;
+	IORegistryEntry *           fork = NULL;
+	IORegistryLink *            link;
 	unsigned int                index;
 
-	RLOCK;
+	IORegistryReadEnter();
 
 	next = this;
-	while ((parents = next->getParentSetReference( plane ))) {
-		count = parents->getCount();
-		if (0 == count) {
-			break;
-		}
+	while ((count = IORegistryLinkCount( &next->reserved->fPlaneLinks, plane, kParentSetIndex ))) {
 		if (1 == count) {
+			if (!(link = IORegistryFirstLink( &next->reserved->fPlaneLinks, plane, kParentSetIndex ))) {
+				break;
+			}
 			depth++;
-			next = (IORegistryEntry *) parents->getObject( 0 );
+			next = link->entry;
 		} else {
-			// painful
-			maxParentDepth = 0;
-			for (index = 0;
-			    (one = (IORegistryEntry *) parents->getObject( index ));
-			    index++) {
-				oneDepth = one->getDepth( plane );
-				if (oneDepth > maxParentDepth) {
-					maxParentDepth = oneDepth;
-				}
-			}
-			depth += maxParentDepth;
+			fork = (IORegistryEntry *) next;
+			fork->retain();
 			break;
 		}
 	}
 
-	UNLOCK;
+	IORegistryReadExit();
+
+	if (fork) {
+		// painful
+		maxParentDepth = 0;
+		parents = IORegistryCopyLinks( &fork->reserved->fPlaneLinks, plane, kParentSetIndex );
+		for (index = 0;
+		    parents && (one = (IORegistryEntry *) parents->getObject( index ));
+		    index++) {
+			oneDepth = one->getDepth( plane );
+			if (oneDepth > maxParentDepth) {
+				maxParentDepth = oneDepth;
+			}
+		}
+		depth += maxParentDepth;
+		OSSafeReleaseNULL( parents );
+		fork->release();
+	}
 
 	return depth;
 }
@@ -62,6 +62,7 @@
 #include <sys/errno.h>
 #include <sys/kdebug.h>
 #include <string.h>
+#include <os/hash.h>
 
 #include <machine/pal_routines.h>
 
@@ -317,6 +318,38 @@ static queue_head_t gArbitrationLockQueueWaiting;
 static queue_head_t gArbitrationLockQueueFree;
 static IOLock *     gArbitrationLockQueueLock;
 
+// Secondary indexes over the published services, so that matching on a
+// registry ID, a BSD name or a name doesn't visit every IOService instance.
+enum {
+	kIOServiceIndexID      = 0,
+	kIOServiceIndexBSDName = 1,
+	kIOServiceIndexName    = 2,
+	kIOServiceIndexCount   = 3
+};
+
+#define kIOServiceIndexBuckets  1024
+
+struct IOServiceIndexEntry {
+	queue_chain_t    link[kIOServiceIndexCount];
+	IOService *      service;
+	uint64_t         regID;
+	// retained BSD name and name symbols, unused for kIOServiceIndexID
+	const OSSymbol * key[kIOServiceIndexCount];
+	// kinds the service can't be filed under, see IOServiceIndexOpaqueKinds()
+	uint32_t         opaque;
+};
+
+static queue_head_t gIOServiceIndex[kIOServiceIndexCount][kIOServiceIndexBuckets];
+static queue_head_t gIOServiceIndexOpaque[kIOServiceIndexCount];
+static uint64_t     gIOServiceIndexGeneration;
+static IOLock *     gIOServiceIndexLock;
+// set for good once a published service couldn't be indexed,
+// from then on lookups visit every instance
+static bool         gIOServiceIndexIncomplete;
+
+static void IOServiceIndexAdd(IOService * service);
+static void IOServiceIndexRemove(IOService * service);
+
 bool
 IOService::isInactive( void ) const
 {
@@ -545,6 +578,14 @@ IOService::initialize( void )
 
 	gIOServiceBusyLock = IOLockAlloc();
 
+	gIOServiceIndexLock = IOLockAlloc();
+	for (uint32_t kind = 0; kind < kIOServiceIndexCount; kind++) {
+		for (uint32_t bucket = 0; bucket < kIOServiceIndexBuckets; bucket++) {
+			queue_init(&gIOServiceIndex[kind][bucket]);
+		}
+		queue_init(&gIOServiceIndexOpaque[kind]);
+	}
+
 	gIOConsoleUsersLock = IOLockAlloc();
 
 	err = semaphore_create(kernel_task, &gJobsSemaphore, SYNC_POLICY_FIFO, 0);
@@ -554,7 +595,7 @@ IOService::initialize( void )
 	IORegistryEntry::getRegistryRoot()->setProperty(gIOConsoleLockedKey, kOSBooleanTrue);
 
 	assert( gIOServiceBusyLock && gJobs && gJobsLock && gIOConsoleUsersLock
-	    && gIOConsoleLockCallout && (err == KERN_SUCCESS));
+	    && gIOConsoleLockCallout && gIOServiceIndexLock && (err == KERN_SUCCESS));
 
 	gIOResources = IOResources::resources();
 	gIOUserResources = IOUserResources::resources();
@@ -914,6 +955,7 @@ IOService::detach( IOService * provider )
 
 	if (kIOServiceInactiveState & __state[0]) {
 		getMetaClass()->removeInstance(this);
+		IOServiceIndexRemove(this);
 		IORemoveServicePlatformActions(this);
 	}
 
@@ -4795,6 +4837,7 @@ IOService::doServiceMatch( IOOptionBits options )
 			lockForArbitration();
 			if (0 == (__state[0] & kIOServiceFirstPublishState)) {
 				getMetaClass()->addInstance(this);
+				IOServiceIndexAdd(this);
 				notifiers[0] = copyNotifiers(gIOFirstPublishNotification,
 				    kIOServiceFirstPublishState, 0xffffffff );
 			}
@@ -5378,6 +5421,374 @@ _IOServiceJob::pingConfig( _IOServiceJob * job )
 	semaphore_signal( gJobsSemaphore );
 }
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+typedef bool (IORegistryEntry::*IOServiceIndexCompareNamesFn)(OSObject *, OSString **) const;
+typedef bool (IORegistryEntry::*IOServiceIndexCompareNameFn)(OSString *, OSString **) const;
+typedef const OSSymbol * (IORegistryEntry::*IOServiceIndexCopyNameFn)(const IORegistryPlane *) const;
+typedef void (IORegistryEntry::*IOServiceIndexSetNameFn)(const OSSymbol *, const IORegistryPlane *);
+typedef OSObject * (IORegistryEntry::*IOServiceIndexCopyPropertyFn)(const OSSymbol *) const;
+typedef bool (IORegistryEntry::*IOServiceIndexSetPropertyFn)(const OSSymbol *, OSObject *);
+typedef void (IORegistryEntry::*IOServiceIndexRemovePropertyFn)(const OSSymbol *);
+typedef void (IORegistryEntry::*IOServiceIndexSetPropertyTableFn)(OSDictionary *);
+
+// A service whose class overrides the accessors matchInternal() uses for a
+// key, or the setters that keep the index up to date, can't be filed under
+// that key. It goes on the opaque list instead, which every lookup visits.
+static uint32_t
+IOServiceIndexOpaqueKinds(IOService * service)
+{
+	IORegistryEntry * root = IORegistryEntry::getRegistryRoot();
+	uint32_t          opaque = 0;
+
+#define overridden(type, func)                                                  \
+	(OSMemberFunctionCast(void *, service, (type) &IORegistryEntry::func)   \
+	!= OSMemberFunctionCast(void *, root, (type) &IORegistryEntry::func))
+
+	if (overridden(IOServiceIndexCompareNamesFn, compareNames)
+	    || overridden(IOServiceIndexCompareNameFn, compareName)
+	    || overridden(IOServiceIndexCopyNameFn, copyName)
+	    || overridden(IOServiceIndexSetNameFn, setName)) {
+		opaque |= (1 << kIOServiceIndexName);
+	}
+	if (overridden(IOServiceIndexCopyPropertyFn, copyProperty)
+	    || overridden(IOServiceIndexSetPropertyFn, setProperty)
+	    || overridden(IOServiceIndexRemovePropertyFn, removeProperty)
+	    || overridden(IOServiceIndexSetPropertyTableFn, setPropertyTable)) {
+		opaque |= (1 << kIOServiceIndexBSDName);
+	}
+#undef overridden
+
+	return opaque;
+}
+
+// Whether IONameMatch on the service only depends on its name.
+bool
+IOServiceHasDefaultNameMatching(IOService * service)
+{
+	return 0 == ((1 << kIOServiceIndexName) & IOServiceIndexOpaqueKinds(service));
+}
+
+static queue_head_t *
+IOServiceIndexBucket(uint32_t kind, uint64_t regID, const OSSymbol * key)
+{
+	uint32_t hash;
+
+	if (kIOServiceIndexID == kind) {
+		hash = (uint32_t) regID;
+	} else {
+		hash = os_hash_kernel_pointer(key);
+	}
+	return &gIOServiceIndex[kind][hash & (kIOServiceIndexBuckets - 1)];
+}
+
+// call with gIOServiceIndexLock
+static IOServiceIndexEntry *
+IOServiceIndexFind(IOService * service)
+{
+	IOServiceIndexEntry * entry;
+	queue_head_t *        head;
+	uint64_t              regID = service->getRegistryEntryID();
+
+	head = IOServiceIndexBucket(kIOServiceIndexID, regID, NULL);
+	queue_iterate(head, entry, IOServiceIndexEntry *, link[kIOServiceIndexID]) {
+		if (service == entry->service) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+// call with gIOServiceIndexLock
+static void
+IOServiceIndexUnfile(IOServiceIndexEntry * entry, uint32_t kind)
+{
+	queue_head_t * head;
+
+	if ((1 << kind) & entry->opaque) {
+		head = &gIOServiceIndexOpaque[kind];
+	} else if (entry->key[kind]) {
+		head = IOServiceIndexBucket(kind, entry->regID, entry->key[kind]);
+	} else {
+		return;
+	}
+	queue_remove(head, entry, IOServiceIndexEntry *, link[kind]);
+}
+
+// call with gIOServiceIndexLock
+static void
+IOServiceIndexFile(IOServiceIndexEntry * entry, uint32_t kind)
+{
+	queue_head_t * head;
+
+	if ((1 << kind) & entry->opaque) {
+		head = &gIOServiceIndexOpaque[kind];
+	} else if (entry->key[kind]) {
+		head = IOServiceIndexBucket(kind, entry->regID, entry->key[kind]);
+	} else {
+		return;
+	}
+	queue_enter(head, entry, IOServiceIndexEntry *, link[kind]);
+}
+
+static void
+IOServiceIndexCopyKeys(IOService * service, uint32_t opaque,
+    const OSSymbol * keys[kIOServiceIndexCount])
+{
+	OSObject * prop;
+	OSString * str;
+
+	keys[kIOServiceIndexID]      = NULL;
+	keys[kIOServiceIndexBSDName] = NULL;
+	keys[kIOServiceIndexName]    = NULL;
+
+	if (!((1 << kIOServiceIndexBSDName) & opaque)
+	    && (prop = service->copyProperty(gIOBSDNameKey))) {
+		if ((str = OSDynamicCast(OSString, prop))) {
+			keys[kIOServiceIndexBSDName] = OSSymbol::withString(str);
+		}
+		prop->release();
+	}
+	if (!((1 << kIOServiceIndexName) & opaque)) {
+		keys[kIOServiceIndexName] = service->copyName();
+	}
+}
+
+// Refile an indexed service (or file a new entry) under its current keys.
+// The keys are copied without gIOServiceIndexLock held, so this retries if
+// anything changed an indexed key, or removed a service, in the meantime.
+static void
+IOServiceIndexRefile(IOService * service, IOServiceIndexEntry * newEntry)
+{
+	IOServiceIndexEntry * entry;
+	const OSSymbol *      keys[kIOServiceIndexCount];
+	uint64_t              generation;
+	uint32_t              opaque;
+	bool                  done;
+
+	do {
+		IOLockLock(gIOServiceIndexLock);
+		generation = gIOServiceIndexGeneration;
+		entry = newEntry ? newEntry : IOServiceIndexFind(service);
+		opaque = entry ? entry->opaque : 0;
+		IOLockUnlock(gIOServiceIndexLock);
+		if (!entry) {
+			return;
+		}
+
+		IOServiceIndexCopyKeys(service, opaque, keys);
+
+		IOLockLock(gIOServiceIndexLock);
+		done = (generation == gIOServiceIndexGeneration);
+		if (done) {
+			if (newEntry) {
+				queue_enter(IOServiceIndexBucket(kIOServiceIndexID, entry->regID, NULL),
+				    entry, IOServiceIndexEntry *, link[kIOServiceIndexID]);
+			}
+			for (uint32_t kind = kIOServiceIndexBSDName; kind < kIOServiceIndexCount; kind++) {
+				const OSSymbol * prior;
+
+				if (!newEntry) {
+					IOServiceIndexUnfile(entry, kind);
+				}
+				prior = entry->key[kind];
+				entry->key[kind] = keys[kind];
+				keys[kind] = prior;
+				IOServiceIndexFile(entry, kind);
+			}
+		}
+		IOLockUnlock(gIOServiceIndexLock);
+
+		// the keys that were replaced, or not used
+		OSSafeReleaseNULL(keys[kIOServiceIndexBSDName]);
+		OSSafeReleaseNULL(keys[kIOServiceIndexName]);
+	} while (!done);
+}
+
+// Called on the first publish of a service, with its arbitration lock held.
+static void
+IOServiceIndexAdd(IOService * service)
+{
+	IOServiceIndexEntry * entry;
+
+	entry = IONew(IOServiceIndexEntry, 1);
+	if (!entry) {
+		IOLockLock(gIOServiceIndexLock);
+		gIOServiceIndexIncomplete = true;
+		IOLockUnlock(gIOServiceIndexLock);
+		return;
+	}
+	bzero(entry, sizeof(*entry));
+	service->retain();
+	entry->service = service;
+	entry->regID   = service->getRegistryEntryID();
+	entry->opaque  = IOServiceIndexOpaqueKinds(service);
+
+	IOServiceIndexRefile(service, entry);
+}
+
+// Called when an inactive service is detached, with its arbitration lock held.
+static void
+IOServiceIndexRemove(IOService * service)
+{
+	IOServiceIndexEntry * entry;
+
+	IOLockLock(gIOServiceIndexLock);
+	entry = IOServiceIndexFind(service);
+	if (entry) {
+		for (uint32_t kind = 0; kind < kIOServiceIndexCount; kind++) {
+			if (kIOServiceIndexID == kind) {
+				queue_remove(IOServiceIndexBucket(kind, entry->regID, NULL),
+				    entry, IOServiceIndexEntry *, link[kind]);
+			} else {
+				IOServiceIndexUnfile(entry, kind);
+			}
+		}
+		gIOServiceIndexGeneration++;
+	}
+	IOLockUnlock(gIOServiceIndexLock);
+
+	if (!entry) {
+		return;
+	}
+	OSSafeReleaseNULL(entry->key[kIOServiceIndexBSDName]);
+	OSSafeReleaseNULL(entry->key[kIOServiceIndexName]);
+	entry->service->release();
+	IODelete(entry, IOServiceIndexEntry, 1);
+}
+
+// Called by IORegistryEntry when the name or the BSD name of an entry changes.
+void
+IOServiceMatchIndexUpdate(IORegistryEntry * regEntry)
+{
+	IOService * service;
+
+	if (!gIOServiceIndexLock || !(service = OSDynamicCast(IOService, regEntry))) {
+		return;
+	}
+	IOLockLock(gIOServiceIndexLock);
+	gIOServiceIndexGeneration++;
+	IOLockUnlock(gIOServiceIndexLock);
+
+	IOServiceIndexRefile(service, NULL);
+}
+
+// call with gIOServiceIndexLock
+static bool
+IOServiceIndexCollect(OSArray * candidates, uint32_t kind, uint64_t regID,
+    const OSSymbol * key)
+{
+	IOServiceIndexEntry * entry;
+	queue_head_t *        head;
+
+	head = IOServiceIndexBucket(kind, regID, key);
+	queue_iterate(head, entry, IOServiceIndexEntry *, link[kind]) {
+		if ((kIOServiceIndexID == kind) ? (regID == entry->regID) : (key == entry->key[kind])) {
+			if (!candidates->setObject(entry->service)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Returns the published services that may match the table's registry ID,
+// BSD name or name, or NULL if it has none of them and every instance
+// needs to be visited. matchInternal() still decides on each candidate.
+static OSArray *
+IOServiceIndexCopyCandidates(OSDictionary * table)
+{
+	IOServiceIndexEntry * entry;
+	OSArray *             candidates;
+	OSSet *               keys;
+	OSIterator *          iter;
+	OSNumber *            num;
+	OSString *            str;
+	OSObject *            obj;
+	const OSSymbol *      sym;
+	uint32_t              kind;
+	uint64_t              regID = 0;
+	bool                  ok;
+
+	keys = NULL;
+	iter = NULL;
+	if ((num = OSDynamicCast(OSNumber, table->getObject(gIORegistryEntryIDKey)))) {
+		kind  = kIOServiceIndexID;
+		regID = num->unsigned64BitValue();
+	} else if ((str = OSDynamicCast(OSString, table->getObject(gIOBSDNameKey)))) {
+		kind = kIOServiceIndexBSDName;
+		keys = OSSet::withCapacity(1);
+		if (keys && (sym = OSSymbol::existingSymbolForString(str))) {
+			ok = keys->setObject(sym);
+			sym->release();
+			if (!ok) {
+				OSSafeReleaseNULL(keys);
+			}
+		}
+	} else if ((obj = table->getObject(gIONameMatchKey))) {
+		// the same names compareNames() would try
+		kind = kIOServiceIndexName;
+		keys = OSSet::withCapacity(1);
+		if ((str = OSDynamicCast(OSString, obj))) {
+			if (keys && (sym = OSSymbol::existingSymbolForString(str))) {
+				ok = keys->setObject(sym);
+				sym->release();
+				if (!ok) {
+					OSSafeReleaseNULL(keys);
+				}
+			}
+		} else if (OSDynamicCast(OSCollection, obj)) {
+			iter = OSCollectionIterator::withCollection(OSDynamicCast(OSCollection, obj));
+			while (keys && iter && (str = OSDynamicCast(OSString, iter->getNextObject()))) {
+				if ((sym = OSSymbol::existingSymbolForString(str))) {
+					ok = keys->setObject(sym);
+					sym->release();
+					if (!ok) {
+						OSSafeReleaseNULL(keys);
+					}
+				}
+			}
+			OSSafeReleaseNULL(iter);
+		}
+	} else {
+		return NULL;
+	}
+	if ((kIOServiceIndexID != kind) && !keys) {
+		return NULL;
+	}
+
+	// a candidate left out would be a service the lookup never finds,
+	// so anything short of the full set falls back to visiting every instance
+	candidates = OSArray::withCapacity(4);
+	if (candidates) {
+		IOLockLock(gIOServiceIndexLock);
+		ok = !gIOServiceIndexIncomplete;
+		if (ok && (kIOServiceIndexID == kind)) {
+			ok = IOServiceIndexCollect(candidates, kind, regID, NULL);
+		} else if (ok) {
+			iter = OSCollectionIterator::withCollection(keys);
+			ok = (iter != NULL);
+			while (ok && (sym = (const OSSymbol *) iter->getNextObject())) {
+				ok = IOServiceIndexCollect(candidates, kind, 0, sym);
+			}
+			OSSafeReleaseNULL(iter);
+			queue_iterate(&gIOServiceIndexOpaque[kind], entry, IOServiceIndexEntry *, link[kind]) {
+				if (!ok) {
+					break;
+				}
+				ok = candidates->setObject(entry->service);
+			}
+		}
+		IOLockUnlock(gIOServiceIndexLock);
+		if (!ok) {
+			OSSafeReleaseNULL(candidates);
+		}
+	}
+	OSSafeReleaseNULL(keys);
+
+	return candidates;
+}
+
 struct IOServiceMatchContext {
 	OSDictionary * table;
 	OSObject *     result;
@@ -5463,6 +5874,7 @@ IOService::copyExistingServices( OSDictionary * matching,
 		}
 	} else {
 		IOServiceMatchContext ctx;
+		OSArray *             candidates;
 
 		options    |= kIOServiceClassDone;
 		ctx.table   = matching;
@@ -5472,7 +5884,17 @@ IOService::copyExistingServices( OSDictionary * matching,
 		ctx.options = options;
 		ctx.result  = NULL;
 
-		if ((str = OSDynamicCast(OSString, obj))) {
+		if (!matching->getObject(gIOCompatibilityMatchKey)
+		    && (candidates = IOServiceIndexCopyCandidates(matching))) {
+			// the candidates come from any class, so matchInternal() checks it
+			ctx.options &= ~kIOServiceClassDone;
+			for (unsigned int idx = 0; (service = (IOService *) candidates->getObject(idx)); idx++) {
+				if (instanceMatch(service, &ctx)) {
+					break;
+				}
+			}
+			candidates->release();
+		} else if ((str = OSDynamicCast(OSString, obj))) {
 			const OSSymbol * sym = OSSymbol::withString(str);
 			OSMetaClass::applyToInstancesOfClassName(sym, instanceMatch, &ctx);
 			sym->release();
@@ -8221,6 +8643,12 @@ IOService::configureReport(IOReportChannelList    *channelList,
 			} else {
 				return kIOReturnUnsupported;
 			}
+		} else if (channelList->channels[cnt].channel_id == kPMChangeTimeChID) {
+			if (pwrMgt) {
+				configurePowerChangeTimeReport(action, result);
+			} else {
+				return kIOReturnUnsupported;
+			}
 		}
 	}
 
@@ -8267,6 +8695,12 @@ IOService::updateReport(IOReportChannelList      *channelList,
 			} else {
 				return kIOReturnUnsupported;
 			}
+		} else if (channelList->channels[cnt].channel_id == kPMChangeTimeChID) {
+			if (pwrMgt) {
+				updatePowerChangeTimeReport(action, result, destination);
+			} else {
+				return kIOReturnUnsupported;
+			}
 		}
 	}
 
@@ -58,6 +58,9 @@
 #include "IOServicePMPrivate.h"
 #include "IOKitKernelInternal.h"
 
+extern "C" kern_return_t kernel_thread_start_priority(thread_continue_t continuation,
+    void *parameter, integer_t priority, thread_t *new_thread);
+
 #if USE_SETTLE_TIMER
 static void settle_timer_expired(thread_call_param_t, thread_call_param_t);
 #endif
@@ -119,6 +122,21 @@ static bool                  gIOPMAdvisoryTickleEnabled = true;
 static thread_t              gIOPMWatchDogThread        = NULL;
 uint32_t                     gCanSleepTimeout           = 0;
 
+// Threads making driver callouts, see pmDriverCalloutEnter()
+static IOLock *              gIOPMCalloutLock           = NULL;
+static queue_head_t          gIOPMCalloutQueue;
+static uint32_t              gIOPMCalloutThreads        = 0;
+static uint32_t              gIOPMCalloutIdle           = 0;
+uint32_t                     gIOPMCalloutThreadLimit    = 8;
+// BASEPRI_PREEMPT_HIGH, the priority of the thread call they used to run on
+static const integer_t       kIOPMCalloutThreadPriority = 93;
+
+// Power change time histogram, kPMChangeTimeChID
+enum {
+	kPMChangeTimeBuckets  = 32,
+	kPMChangeTimeBucketUS = 1000
+};
+
 static uint32_t
 getPMRequestType( void )
 {
@@ -129,6 +147,20 @@ getPMRequestType( void )
 	return type;
 }
 
+// Tally the power change all_done() is finishing, in us since startPowerChange().
+// Changes longer than the histogram go in its last bucket. PMLock held.
+static void
+tallyPowerChangeTime( IOServicePM * pwrMgt )
+{
+	int64_t changeUS;
+
+	changeUS = (int64_t) (computeTimeDeltaNS(&fChangeStartTime) / NSEC_PER_USEC);
+	if (changeUS > kPMChangeTimeBuckets * kPMChangeTimeBucketUS) {
+		changeUS = kPMChangeTimeBuckets * kPMChangeTimeBucketUS;
+	}
+	HISTREPORT_TALLYVALUE(fChangeTimeReportBuf, changeUS);
+}
+
 SYSCTL_UINT(_kern, OID_AUTO, pmtimeout, CTLFLAG_RW | CTLFLAG_LOCKED, &gCanSleepTimeout, 0, "Power Management Timeout");
 
 //******************************************************************************
@@ -390,7 +422,13 @@ IOService::PMinit( void )
 				    OSSymbol::withCStringNoCopy( "RootDomainPower" );
 			}
 
-			if (gIOPMRequestQueue && gIOPMReplyQueue && gIOPMCompletionQueue) {
+			gIOPMCalloutLock = IOLockAlloc();
+			queue_init(&gIOPMCalloutQueue);
+			PE_parse_boot_argn("pmcallouts", &gIOPMCalloutThreadLimit,
+			    sizeof(gIOPMCalloutThreadLimit));
+
+			if (gIOPMRequestQueue && gIOPMReplyQueue && gIOPMCompletionQueue &&
+			    gIOPMCalloutLock) {
 				gIOPMInitialized = true;
 			}
 
@@ -410,6 +448,7 @@ IOService::PMinit( void )
 		setProperty(kPwrMgtKey, pwrMgt);
 
 		queue_init(&pwrMgt->WorkChain);
+		queue_init(&pwrMgt->CalloutChain);
 		queue_init(&pwrMgt->RequestHead);
 		queue_init(&pwrMgt->PMDriverCallQueue);
 
@@ -581,6 +620,10 @@ IOService::PMfree( void )
 			IOFree(fReportBuf, STATEREPORT_BUFSIZE(fNumberOfPowerStates));
 			fReportBuf = NULL;
 		}
+		if (fChangeTimeReportBuf) {
+			IOFree(fChangeTimeReportBuf, HISTREPORT_BUFSIZE(kPMChangeTimeBuckets));
+			fChangeTimeReportBuf = NULL;
+		}
 		if (fPowerStates && fNumberOfPowerStates) {
 			IODelete(fPowerStates, IOPMPSEntry, fNumberOfPowerStates);
 			fNumberOfPowerStates = 0;
@@ -3554,6 +3597,7 @@ IOService::startPowerChange(
 
 	// Forks to either Driver or Parent initiated power change paths.
 
+	clock_get_uptime(&fChangeStartTime);
 	fHeadNoteChangeFlags      = changeFlags;
 	fHeadNotePowerState       = powerState;
 	fHeadNotePowerArrayEntry  = &fPowerStates[powerState];
@@ -3651,7 +3695,7 @@ IOService::notifyInterestedDrivers( void )
 	// Block state machine and wait for callout completion.
 	assert(!fDriverCallBusy);
 	fDriverCallBusy = true;
-	thread_call_enter( fDriverCallEntry );
+	pmDriverCalloutEnter();
 	return true;
 
 done:
@@ -3770,7 +3814,7 @@ IOService::notifyRootDomain( void )
 	// to avoid a deadlock.
 	fDriverCallReason = kRootDomainInformPreChange;
 	fDriverCallBusy   = true;
-	thread_call_enter( fDriverCallEntry );
+	pmDriverCalloutEnter();
 }
 
 void
@@ -3993,6 +4037,90 @@ IOService::actionDriverCalloutDone(
 	return kIOReturnSuccess;
 }
 
+//*********************************************************************************
+// [private] pmDriverCalloutEnter
+//
+// Hand the driver callout to an idle PM callout thread, or start one if there
+// are fewer than gIOPMCalloutThreadLimit. Once they are all busy the callout
+// goes to fDriverCallEntry on the thread call group shared with the rest of
+// the kernel, as all of them used to. The state machine waits for the callout
+// either way, so this only lets callouts for unrelated services overlap.
+//*********************************************************************************
+
+void
+IOService::pmDriverCalloutEnter( void )
+{
+	thread_t    thread;
+	bool        pooled = false;
+	bool        start = false;
+
+	// Released by pmDriverCalloutThread() after the callout
+	retain();
+
+	IOLockLock(gIOPMCalloutLock);
+	if ((gIOPMCalloutThreads - gIOPMCalloutIdle) < gIOPMCalloutThreadLimit) {
+		if (gIOPMCalloutIdle) {
+			gIOPMCalloutIdle--;
+			queue_enter(&gIOPMCalloutQueue, pwrMgt, IOServicePM *, CalloutChain);
+			IOLockWakeup(gIOPMCalloutLock, &gIOPMCalloutQueue, true);
+			pooled = true;
+		} else {
+			gIOPMCalloutThreads++;
+			start = true;
+		}
+	}
+	IOLockUnlock(gIOPMCalloutLock);
+
+	if (pooled) {
+		return;
+	}
+	if (start) {
+		if (KERN_SUCCESS == kernel_thread_start_priority(
+			    &IOService::pmDriverCalloutThread, this,
+			    kIOPMCalloutThreadPriority, &thread)) {
+			thread_set_thread_name(thread, "IOServicePMCallout");
+			thread_deallocate(thread);
+			return;
+		}
+
+		IOLockLock(gIOPMCalloutLock);
+		gIOPMCalloutThreads--;
+		IOLockUnlock(gIOPMCalloutLock);
+	}
+
+	release();
+	thread_call_enter( fDriverCallEntry );
+}
+
+//*********************************************************************************
+// [private] pmDriverCalloutThread
+//
+// Makes the callout it was started for, then the ones pmDriverCalloutEnter()
+// queues for it.
+//*********************************************************************************
+
+void
+IOService::pmDriverCalloutThread( void * arg, wait_result_t waitResult __unused )
+{
+	IOService *     service = (IOService *) arg;
+	IOServicePM *   pwrMgt;
+
+	for (;;) {
+		pmDriverCallout(service);
+		service->release();
+
+		IOLockLock(gIOPMCalloutLock);
+		gIOPMCalloutIdle++;
+		while (queue_empty(&gIOPMCalloutQueue)) {
+			IOLockSleep(gIOPMCalloutLock, &gIOPMCalloutQueue, THREAD_UNINT);
+		}
+		queue_remove_first(&gIOPMCalloutQueue, pwrMgt, IOServicePM *, CalloutChain);
+		IOLockUnlock(gIOPMCalloutLock);
+
+		service = pwrMgt->Owner;
+	}
+}
+
 void
 IOService::pmDriverCallout( IOService * from )
 {
@@ -4268,7 +4396,7 @@ IOService::notifyControllingDriver( void )
 	// Block state machine and wait for callout completion.
 	assert(!fDriverCallBusy);
 	fDriverCallBusy = true;
-	thread_call_enter( fDriverCallEntry );
+	pmDriverCalloutEnter();
 
 	return true;
 }
@@ -4403,6 +4531,9 @@ IOService::all_done( void )
 				ts = mach_absolute_time();
 				STATEREPORT_SETSTATE(fReportBuf, (uint16_t) fCurrentPowerState, ts);
 			}
+			if (fChangeTimeReportBuf) {
+				tallyPowerChangeTime(pwrMgt);
+			}
 			PM_UNLOCK();
 #if PM_VARS_SUPPORT
 			fPMVars->myCurrentState = fCurrentPowerState;
@@ -4459,6 +4590,9 @@ IOService::all_done( void )
 				ts = mach_absolute_time();
 				STATEREPORT_SETSTATE(fReportBuf, (uint16_t) fCurrentPowerState, ts);
 			}
+			if (fChangeTimeReportBuf) {
+				tallyPowerChangeTime(pwrMgt);
+			}
 			PM_UNLOCK();
 #if PM_VARS_SUPPORT
 			fPMVars->myCurrentState = fCurrentPowerState;
@@ -7155,6 +7289,119 @@ IOService::updateSimplePowerReport( IOReportConfigureAction action, void *result
 	return rc;
 }
 
+//*********************************************************************************
+//  configurePowerChangeTimeReport
+//
+//  Configures the IOHistogramReport for kPMChangeTimeChID
+//*********************************************************************************
+IOReturn
+IOService::configurePowerChangeTimeReport( IOReportConfigureAction action, void *result )
+{
+	IOReturn rc = kIOReturnSuccess;
+	size_t  reportSize;
+
+	if (!pwrMgt) {
+		return kIOReturnUnsupported;
+	}
+
+	if (!fNumberOfPowerStates) {
+		return kIOReturnSuccess;
+	}
+	PM_LOCK();
+
+	switch (action) {
+	case kIOReportEnable:
+		if (fChangeTimeReportBuf) {
+			fChangeTimeReportClientCnt++;
+			break;
+		}
+		reportSize = HISTREPORT_BUFSIZE(kPMChangeTimeBuckets);
+		fChangeTimeReportBuf = IOMalloc(reportSize);
+		if (!fChangeTimeReportBuf) {
+			rc = kIOReturnNoMemory;
+			break;
+		}
+
+		HISTREPORT_INIT(kPMChangeTimeBuckets, kPMChangeTimeBucketUS, fChangeTimeReportBuf,
+		    reportSize, getRegistryEntryID(), kPMChangeTimeChID, kIOReportCategoryPower);
+		fChangeTimeReportClientCnt++;
+		break;
+
+	case kIOReportDisable:
+		if (fChangeTimeReportClientCnt == 0) {
+			rc = kIOReturnBadArgument;
+			break;
+		}
+		if (fChangeTimeReportClientCnt == 1) {
+			IOFree(fChangeTimeReportBuf, HISTREPORT_BUFSIZE(kPMChangeTimeBuckets));
+			fChangeTimeReportBuf = NULL;
+		}
+		fChangeTimeReportClientCnt--;
+		break;
+
+	case kIOReportGetDimensions:
+		if (fChangeTimeReportBuf) {
+			HISTREPORT_UPDATERES(fChangeTimeReportBuf, kIOReportGetDimensions, result);
+		}
+		break;
+	}
+
+	PM_UNLOCK();
+
+	return rc;
+}
+
+//*********************************************************************************
+//  updatePowerChangeTimeReport
+//
+//  Updates the IOHistogramReport for kPMChangeTimeChID
+//*********************************************************************************
+IOReturn
+IOService::updatePowerChangeTimeReport( IOReportConfigureAction action, void *result, void *destination )
+{
+	uint32_t size2cpy;
+	void *data2cpy;
+	IOReturn rc = kIOReturnSuccess;
+	IOBufferMemoryDescriptor *dest = OSDynamicCast(IOBufferMemoryDescriptor, (OSObject *)destination);
+
+	if (!pwrMgt) {
+		return kIOReturnUnsupported;
+	}
+	if (!fNumberOfPowerStates) {
+		return kIOReturnSuccess;
+	}
+
+	if (!result || !dest) {
+		return kIOReturnBadArgument;
+	}
+	PM_LOCK();
+
+	switch (action) {
+	case kIOReportCopyChannelData:
+		if (!fChangeTimeReportBuf) {
+			rc = kIOReturnNotOpen;
+			break;
+		}
+
+		HISTREPORT_UPDATEPREP(fChangeTimeReportBuf, data2cpy, size2cpy);
+		if (size2cpy > (dest->getCapacity() - dest->getLength())) {
+			rc = kIOReturnOverrun;
+			break;
+		}
+
+		HISTREPORT_UPDATERES(fChangeTimeReportBuf, kIOReportCopyChannelData, result);
+		dest->appendBytes(data2cpy, size2cpy);
+		break;
+
+	default:
+		break;
+	}
+
+	PM_UNLOCK();
+
+	return rc;
+}
+
 
 
 // MARK: -
@@ -174,6 +174,9 @@ private:
 // Link IOServicePM objects on IOPMWorkQueue.
 	queue_chain_t           WorkChain;
 
+// Link IOServicePM objects waiting for a PM callout thread.
+	queue_chain_t           CalloutChain;
+
 // Queue of IOPMRequest objects.
 	queue_head_t            RequestHead;
 
@@ -314,6 +317,7 @@ private:
 	int                     OutOfBandParameter;
 
 	AbsoluteTime            DriverCallStartTime;
+	AbsoluteTime            ChangeStartTime;
 	IOPMPowerFlags          CurrentCapabilityFlags;
 	unsigned long           CurrentPowerConsumption;
 	IOPMPowerStateIndex     TempClampPowerState;
@@ -353,6 +357,8 @@ private:
 // IOReporter Data
 	uint32_t                ReportClientCnt;
 	void *                  ReportBuf;
+	uint32_t                ChangeTimeReportClientCnt;
+	void *                  ChangeTimeReportBuf;
 // Protected by PMLock - END
 
 #if PM_VARS_SUPPORT
@@ -433,6 +439,7 @@ private:
 #define fSerialNumber               pwrMgt->SerialNumber
 #define fOutOfBandParameter         pwrMgt->OutOfBandParameter
 #define fDriverCallStartTime        pwrMgt->DriverCallStartTime
+#define fChangeStartTime            pwrMgt->ChangeStartTime
 #define fCurrentCapabilityFlags     pwrMgt->CurrentCapabilityFlags
 #define fCurrentPowerConsumption    pwrMgt->CurrentPowerConsumption
 #define fTempClampPowerState        pwrMgt->TempClampPowerState
@@ -460,6 +467,8 @@ private:
 #define fRemoveInterestSet          pwrMgt->RemoveInterestSet
 #define fReportClientCnt            pwrMgt->ReportClientCnt
 #define fReportBuf                  pwrMgt->ReportBuf
+#define fChangeTimeReportClientCnt  pwrMgt->ChangeTimeReportClientCnt
+#define fChangeTimeReportBuf        pwrMgt->ChangeTimeReportBuf
 #define fPMVars                     pwrMgt->PMVars
 #define fPMActions                  pwrMgt->PMActions
 
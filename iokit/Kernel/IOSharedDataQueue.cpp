@@ -33,6 +33,7 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOMemoryDescriptor.h>
 #include <libkern/c++/OSSharedPtr.h>
+#include <kern/thread_call.h>
 
 #ifdef enqueue
 #undef enqueue
@@ -88,6 +89,7 @@ IOSharedDataQueue::initWithCapacity(UInt32 size)
 	if (!_reserved) {
 		return false;
 	}
+	bzero(_reserved, sizeof(struct ExpansionData));
 
 	if (size > UINT32_MAX - DATA_QUEUE_MEMORY_HEADER_SIZE - DATA_QUEUE_MEMORY_APPENDIX_SIZE) {
 		return false;
@@ -142,6 +144,11 @@ IOSharedDataQueue::free()
 	}
 
 	if (_reserved) {
+		if (_reserved->notifyCall) {
+			thread_call_cancel_wait(_reserved->notifyCall);
+			thread_call_free(_reserved->notifyCall);
+			_reserved->notifyCall = NULL;
+		}
 		IOFree(_reserved, sizeof(struct ExpansionData));
 		_reserved = NULL;
 	}
@@ -211,27 +218,20 @@ IOSharedDataQueue::peek()
 	return entry;
 }
 
-Boolean
-IOSharedDataQueue::enqueue(void * data, UInt32 dataSize)
+// Finds room for an entry of dataSize after tail and sets its size; the caller fills in the data.
+IODataQueueEntry *
+IOSharedDataQueue::allocateEntry(UInt32 tail, UInt32 head, UInt32 dataSize, UInt32 * newTail)
 {
-	UInt32             head;
-	UInt32             tail;
-	UInt32             newTail;
 	const UInt32       entrySize = dataSize + DATA_QUEUE_ENTRY_HEADER_SIZE;
 	IODataQueueEntry * entry;
 
-	// Force a single read of head and tail
-	// See rdar://problem/40780584 for an explanation of relaxed/acquire barriers
-	tail = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->tail, __ATOMIC_RELAXED);
-	head = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->head, __ATOMIC_ACQUIRE);
-
 	// Check for overflow of entrySize
 	if (dataSize > UINT32_MAX - DATA_QUEUE_ENTRY_HEADER_SIZE) {
-		return false;
+		return NULL;
 	}
 	// Check for underflow of (getQueueSize() - tail)
 	if (getQueueSize() < tail || getQueueSize() < head) {
-		return false;
+		return NULL;
 	}
 
 	if (tail >= head) {
@@ -240,19 +240,16 @@ IOSharedDataQueue::enqueue(void * data, UInt32 dataSize)
 		    ((tail + entrySize) <= getQueueSize())) {
 			entry = (IODataQueueEntry *)((UInt8 *)dataQueue->queue + tail);
 
-			entry->size = dataSize;
-			__nochk_memcpy(&entry->data, data, dataSize);
-
 			// The tail can be out of bound when the size of the new entry
 			// exactly matches the available space at the end of the queue.
 			// The tail can range from 0 to dataQueue->queueSize inclusive.
 
-			newTail = tail + entrySize;
+			*newTail = tail + entrySize;
 		} else if (head > entrySize) { // Is there enough room at the beginning?
 			// Wrap around to the beginning, but do not allow the tail to catch
 			// up to the head.
 
-			dataQueue->queue->size = dataSize;
+			entry = dataQueue->queue;
 
 			// We need to make sure that there is enough room to set the size before
 			// doing this. The user client checks for this and will look for the size
@@ -262,10 +259,9 @@ IOSharedDataQueue::enqueue(void * data, UInt32 dataSize)
 				((IODataQueueEntry *)((UInt8 *)dataQueue->queue + tail))->size = dataSize;
 			}
 
-			__nochk_memcpy(&dataQueue->queue->data, data, dataSize);
-			newTail = entrySize;
+			*newTail = entrySize;
 		} else {
-			return false; // queue is full
+			return NULL; // queue is full
 		}
 	} else {
 		// Do not allow the tail to catch up to the head when the queue is full.
@@ -273,15 +269,24 @@ IOSharedDataQueue::enqueue(void * data, UInt32 dataSize)
 
 		if ((head - tail) > entrySize) {
 			entry = (IODataQueueEntry *)((UInt8 *)dataQueue->queue + tail);
-
-			entry->size = dataSize;
-			__nochk_memcpy(&entry->data, data, dataSize);
-			newTail = tail + entrySize;
+			*newTail = tail + entrySize;
 		} else {
-			return false; // queue is full
+			return NULL; // queue is full
 		}
 	}
 
+	entry->size = dataSize;
+	return entry;
+}
+
+// Publishes the entries up to newTail, returns true if the consumer may have found the queue empty.
+bool
+IOSharedDataQueue::commitTail(UInt32 tail, UInt32 newTail)
+{
+	UInt32 head;
+
+	head = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->head, __ATOMIC_RELAXED);
+
 	// Publish the data we just enqueued
 	__c11_atomic_store((_Atomic UInt32 *)&dataQueue->tail, newTail, __ATOMIC_RELEASE);
 
@@ -299,13 +304,230 @@ IOSharedDataQueue::enqueue(void * data, UInt32 dataSize)
 		head = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->head, __ATOMIC_RELAXED);
 	}
 
-	if (tail == head) {
-		// Send notification (via mach message) that data is now available.
+	return tail == head;
+}
+
+void
+IOSharedDataQueue::notifyDataAvailable(bool becameNonEmpty)
+{
+	UInt32 watermark = _reserved->notifyWatermark;
+	UInt32 head;
+	UInt32 tail;
+	UInt32 queued;
+
+	if (!watermark) {
+		if (becameNonEmpty) {
+			// Send notification (via mach message) that data is now available.
+			sendDataAvailableNotification();
+		}
+		return;
+	}
+
+	if (becameNonEmpty) {
+		// Hold the notification back, but no longer than notifyDelay
+		if (OSCompareAndSwap(0, 1, &_reserved->notifyPending)) {
+			thread_call_enter_delayed(_reserved->notifyCall, mach_absolute_time() + _reserved->notifyDelay);
+		}
+	} else if (!_reserved->notifyPending) {
+		return;
+	}
+
+	tail = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->tail, __ATOMIC_RELAXED);
+	head = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->head, __ATOMIC_RELAXED);
+	queued = (tail >= head) ? (tail - head) : (getQueueSize() - head + tail);
+	if ((queued >= watermark) && OSCompareAndSwap(1, 0, &_reserved->notifyPending)) {
+		thread_call_cancel(_reserved->notifyCall);
+		sendDataAvailableNotification();
+	}
+}
+
+void
+IOSharedDataQueue::notifyCallout(void * queue, __unused void * unused)
+{
+	IOSharedDataQueue * me = (IOSharedDataQueue *) queue;
+
+	if (OSCompareAndSwap(1, 0, &me->_reserved->notifyPending)) {
+		me->sendDataAvailableNotification();
+	}
+}
+
+Boolean
+IOSharedDataQueue::setNotificationWatermark(UInt32 watermark, UInt32 delay)
+{
+	if (!_reserved || (watermark && !delay)) {
+		return false;
+	}
+
+	if (watermark && !_reserved->notifyCall) {
+		_reserved->notifyCall = thread_call_allocate(&IOSharedDataQueue::notifyCallout, this);
+		if (!_reserved->notifyCall) {
+			return false;
+		}
+	}
+	if (_reserved->notifyCall) {
+		clock_interval_to_absolutetime_interval(delay, kMicrosecondScale, &_reserved->notifyDelay);
+	}
+	_reserved->notifyWatermark = watermark;
+
+	// Don't leave a notification held back by the old watermark
+	if (!watermark && _reserved->notifyCall && OSCompareAndSwap(1, 0, &_reserved->notifyPending)) {
+		thread_call_cancel(_reserved->notifyCall);
 		sendDataAvailableNotification();
 	}
+
 	return true;
 }
 
+Boolean
+IOSharedDataQueue::enqueue(void * data, UInt32 dataSize)
+{
+	UInt32             head;
+	UInt32             tail;
+	UInt32             newTail;
+	IODataQueueEntry * entry;
+
+	if (!_reserved || _reserved->reserving) {
+		return false;
+	}
+
+	// Force a single read of head and tail
+	// See rdar://problem/40780584 for an explanation of relaxed/acquire barriers
+	tail = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->tail, __ATOMIC_RELAXED);
+	head = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->head, __ATOMIC_ACQUIRE);
+
+	entry = allocateEntry(tail, head, dataSize, &newTail);
+	if (!entry) {
+		return false;
+	}
+	__nochk_memcpy(&entry->data, data, dataSize);
+
+	notifyDataAvailable(commitTail(tail, newTail));
+	return true;
+}
+
+void *
+IOSharedDataQueue::enqueueReserve(UInt32 dataSize)
+{
+	UInt32             head;
+	UInt32             tail;
+	UInt32             newTail;
+	IODataQueueEntry * entry;
+
+	if (!dataQueue || !_reserved) {
+		return NULL;
+	}
+
+	if (_reserved->reserving) {
+		tail = _reserved->reserveTail;
+	} else {
+		tail = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->tail, __ATOMIC_RELAXED);
+	}
+	head = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->head, __ATOMIC_ACQUIRE);
+
+	entry = allocateEntry(tail, head, dataSize, &newTail);
+	if (!entry) {
+		return NULL;
+	}
+	_reserved->reserveTail = newTail;
+	_reserved->reserving   = true;
+
+	return &entry->data;
+}
+
+// Publishes the reserved entries, returns true if the consumer may have found the queue empty.
+bool
+IOSharedDataQueue::commitReserved()
+{
+	UInt32 tail;
+
+	if (!_reserved || !_reserved->reserving) {
+		return false;
+	}
+	_reserved->reserving = false;
+
+	tail = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->tail, __ATOMIC_RELAXED);
+	return commitTail(tail, _reserved->reserveTail);
+}
+
+void
+IOSharedDataQueue::enqueueCommit()
+{
+	if (_reserved && _reserved->reserving) {
+		notifyDataAvailable(commitReserved());
+	}
+}
+
+UInt32
+IOSharedDataQueue::enqueueBatch(const void * data, const UInt32 * sizes, UInt32 count)
+{
+	const UInt8 * next = (const UInt8 *) data;
+	void *        entry;
+	UInt32        idx;
+
+	if (!_reserved || _reserved->reserving) {
+		return 0;
+	}
+
+	for (idx = 0; idx < count; idx++) {
+		entry = enqueueReserve(sizes[idx]);
+		if (!entry) {
+			break;
+		}
+		__nochk_memcpy(entry, next, sizes[idx]);
+		next += sizes[idx];
+	}
+	enqueueCommit();
+
+	return idx;
+}
+
+// Finds the entry at headOffset and where the head goes past it, NULL if it isn't valid.
+IODataQueueEntry *
+IOSharedDataQueue::headEntry(UInt32 headOffset, UInt32 * entrySize, UInt32 * newHeadOffset)
+{
+	volatile IODataQueueEntry * entry    = NULL;
+	volatile IODataQueueEntry * head     = NULL;
+	UInt32                      headSize = 0;
+	UInt32                      queueSize = getQueueSize();
+
+	if (headOffset > queueSize) {
+		return NULL;
+	}
+
+	head         = (IODataQueueEntry *)((char *)dataQueue->queue + headOffset);
+	headSize     = head->size;
+
+	// we wrapped around to beginning, so read from there
+	// either there was not even room for the header
+	if ((headOffset > UINT32_MAX - DATA_QUEUE_ENTRY_HEADER_SIZE) ||
+	    (headOffset + DATA_QUEUE_ENTRY_HEADER_SIZE > queueSize) ||
+	    // or there was room for the header, but not for the data
+	    (headOffset + DATA_QUEUE_ENTRY_HEADER_SIZE > UINT32_MAX - headSize) ||
+	    (headOffset + headSize + DATA_QUEUE_ENTRY_HEADER_SIZE > queueSize)) {
+		// Note: we have to wrap to the beginning even with the UINT32_MAX checks
+		// because we have to support a queueSize of UINT32_MAX.
+		entry           = dataQueue->queue;
+		*entrySize      = entry->size;
+		if ((*entrySize > UINT32_MAX - DATA_QUEUE_ENTRY_HEADER_SIZE) ||
+		    (*entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE > queueSize)) {
+			return NULL;
+		}
+		*newHeadOffset  = *entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE;
+		// else it is at the end
+	} else {
+		entry           = head;
+		*entrySize      = entry->size;
+		if ((*entrySize > UINT32_MAX - DATA_QUEUE_ENTRY_HEADER_SIZE) ||
+		    (*entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE > UINT32_MAX - headOffset) ||
+		    (*entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE + headOffset > queueSize)) {
+			return NULL;
+		}
+		*newHeadOffset  = headOffset + *entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE;
+	}
+
+	return (IODataQueueEntry *) entry;
+}
+
 Boolean
 IOSharedDataQueue::dequeue(void *data, UInt32 *dataSize)
 {
@@ -326,44 +548,10 @@ IOSharedDataQueue::dequeue(void *data, UInt32 *dataSize)
 	tailOffset = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->tail, __ATOMIC_ACQUIRE);
 
 	if (headOffset != tailOffset) {
-		volatile IODataQueueEntry * head = NULL;
-		UInt32              headSize     = 0;
-		UInt32              queueSize    = getQueueSize();
-
-		if (headOffset > queueSize) {
+		entry = headEntry(headOffset, &entrySize, &newHeadOffset);
+		if (!entry) {
 			return false;
 		}
-
-		head         = (IODataQueueEntry *)((char *)dataQueue->queue + headOffset);
-		headSize     = head->size;
-
-		// we wrapped around to beginning, so read from there
-		// either there was not even room for the header
-		if ((headOffset > UINT32_MAX - DATA_QUEUE_ENTRY_HEADER_SIZE) ||
-		    (headOffset + DATA_QUEUE_ENTRY_HEADER_SIZE > queueSize) ||
-		    // or there was room for the header, but not for the data
-		    (headOffset + DATA_QUEUE_ENTRY_HEADER_SIZE > UINT32_MAX - headSize) ||
-		    (headOffset + headSize + DATA_QUEUE_ENTRY_HEADER_SIZE > queueSize)) {
-			// Note: we have to wrap to the beginning even with the UINT32_MAX checks
-			// because we have to support a queueSize of UINT32_MAX.
-			entry           = dataQueue->queue;
-			entrySize       = entry->size;
-			if ((entrySize > UINT32_MAX - DATA_QUEUE_ENTRY_HEADER_SIZE) ||
-			    (entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE > queueSize)) {
-				return false;
-			}
-			newHeadOffset   = entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE;
-			// else it is at the end
-		} else {
-			entry           = head;
-			entrySize       = entry->size;
-			if ((entrySize > UINT32_MAX - DATA_QUEUE_ENTRY_HEADER_SIZE) ||
-			    (entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE > UINT32_MAX - headOffset) ||
-			    (entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE + headOffset > queueSize)) {
-				return false;
-			}
-			newHeadOffset   = headOffset + entrySize + DATA_QUEUE_ENTRY_HEADER_SIZE;
-		}
 	} else {
 		// empty queue
 		return false;
@@ -392,6 +580,52 @@ IOSharedDataQueue::dequeue(void *data, UInt32 *dataSize)
 	return retVal;
 }
 
+UInt32
+IOSharedDataQueue::dequeueBatch(void * data, UInt32 dataSize, UInt32 * sizes, UInt32 count)
+{
+	volatile IODataQueueEntry *  entry;
+	UInt8 *             next            = (UInt8 *) data;
+	UInt32              entrySize       = 0;
+	UInt32              headOffset      = 0;
+	UInt32              tailOffset      = 0;
+	UInt32              newHeadOffset   = 0;
+	UInt32              idx;
+
+	if (!dataQueue || !data || !sizes) {
+		return 0;
+	}
+
+	// Read head and tail with acquire barrier
+	// See rdar://problem/40780584 for an explanation of relaxed/acquire barriers
+	headOffset = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->head, __ATOMIC_RELAXED);
+	tailOffset = __c11_atomic_load((_Atomic UInt32 *)&dataQueue->tail, __ATOMIC_ACQUIRE);
+
+	for (idx = 0; (idx < count) && (headOffset != tailOffset); idx++) {
+		entry = headEntry(headOffset, &entrySize, &newHeadOffset);
+		if (!entry || (entrySize > dataSize)) {
+			break;
+		}
+		__nochk_memcpy(next, (void *)entry->data, entrySize);
+		sizes[idx] = entrySize;
+		next      += entrySize;
+		dataSize  -= entrySize;
+		headOffset = newHeadOffset;
+	}
+
+	if (!idx) {
+		return 0;
+	}
+
+	__c11_atomic_store((_Atomic UInt32 *)&dataQueue->head, headOffset, __ATOMIC_RELEASE);
+
+	if (headOffset == tailOffset) {
+		// See ::dequeue
+		__c11_atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+
+	return idx;
+}
+
 UInt32
 IOSharedDataQueue::getQueueSize()
 {
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2020 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+#define IOKIT_ENABLE_SHARED_PTR
+
+#include <IOKit/IOSharedDataQueueLanes.h>
+#include <IOKit/IOLib.h>
+#include <IOKit/IOMemoryDescriptor.h>
+#include <libkern/c++/OSSharedPtr.h>
+#include <kern/cpu_number.h>
+#include <machine/machine_routines.h>
+
+#ifdef enqueue
+#undef enqueue
+#endif
+
+#define super OSObject
+
+OSDefineMetaClassAndStructors(IOSharedDataQueueLanes, OSObject)
+
+OSSharedPtr<IOSharedDataQueueLanes>
+IOSharedDataQueueLanes::withCapacity(UInt32 size)
+{
+	OSSharedPtr<IOSharedDataQueueLanes> me = OSMakeShared<IOSharedDataQueueLanes>();
+
+	if (me && !me->initWithCapacity(size)) {
+		return nullptr;
+	}
+
+	return me;
+}
+
+bool
+IOSharedDataQueueLanes::initWithCapacity(UInt32 size)
+{
+	UInt32 idx;
+
+	if (!super::init()) {
+		return false;
+	}
+
+	laneCount = ml_wait_max_cpus();
+	lanes = IONewZero(IOSharedDataQueue *, laneCount);
+	if (!lanes) {
+		return false;
+	}
+	for (idx = 0; idx < laneCount; idx++) {
+		lanes[idx] = IOSharedDataQueue::withCapacity(size).detach();
+		if (!lanes[idx]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+IOSharedDataQueueLanes::free()
+{
+	UInt32 idx;
+
+	if (lanes) {
+		for (idx = 0; idx < laneCount; idx++) {
+			OSSafeReleaseNULL(lanes[idx]);
+		}
+		IODelete(lanes, IOSharedDataQueue *, laneCount);
+		lanes = NULL;
+	}
+
+	super::free();
+}
+
+UInt32
+IOSharedDataQueueLanes::getLaneCount() const
+{
+	return laneCount;
+}
+
+IOSharedDataQueue *
+IOSharedDataQueueLanes::getLane(UInt32 lane) const
+{
+	if (lane >= laneCount) {
+		return NULL;
+	}
+	return lanes[lane];
+}
+
+OSSharedPtr<IOMemoryDescriptor>
+IOSharedDataQueueLanes::getMemoryDescriptor(UInt32 lane)
+{
+	if (lane >= laneCount) {
+		return nullptr;
+	}
+	return lanes[lane]->getMemoryDescriptor();
+}
+
+void
+IOSharedDataQueueLanes::setNotificationPort(mach_port_t port)
+{
+	UInt32 idx;
+
+	for (idx = 0; idx < laneCount; idx++) {
+		lanes[idx]->setNotificationPort(port);
+	}
+}
+
+bool
+IOSharedDataQueueLanes::setNotificationWatermark(UInt32 watermark, UInt32 delay)
+{
+	UInt32 idx;
+
+	for (idx = 0; idx < laneCount; idx++) {
+		if (!lanes[idx]->setNotificationWatermark(watermark, delay)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+IOSharedDataQueueLanes::enqueue(void * data, UInt32 dataSize)
+{
+	IOSharedDataQueue * lane;
+	void *              entry;
+	bool                notify = false;
+	boolean_t           istate;
+
+	// With interrupts off nothing else can produce on this CPU's lane,
+	// but the notification has to wait until they are back on.
+	istate = ml_set_interrupts_enabled(FALSE);
+	lane = lanes[cpu_number()];
+	entry = lane->enqueueReserve(dataSize);
+	if (entry) {
+		__nochk_memcpy(entry, data, dataSize);
+		notify = lane->commitReserved();
+	}
+	ml_set_interrupts_enabled(istate);
+
+	if (entry) {
+		lane->notifyDataAvailable(notify);
+	}
+
+	return entry != NULL;
+}
@@ -974,9 +974,17 @@ IOStatistics::copyCounterStatistics(IOStatisticsCounter *stats)
 			IOStatisticsCommandGates *cgc = &stats->commandGateStatistics;
 			IOStatisticsCommandQueues *cqc = &stats->commandQueueStatistics;
 			IOStatisticsDerivedEventSources *dec = &stats->derivedEventSourceStatistics;
+			IOStatisticsEventSourceDispatches *esd = &stats->eventSourceDispatchStatistics;
 
 			/* Event source counters */
 			SLIST_FOREACH(counter, &ce->counterList, link) {
+				/* Dispatch latency, from all the event sources of the class */
+				esd->dispatches += counter->dispatches;
+				esd->dispatchLatency += counter->dispatchLatency;
+				if (counter->maxDispatchLatency > esd->maxDispatchLatency) {
+					esd->maxDispatchLatency = counter->maxDispatchLatency;
+				}
+
 				switch (counter->type) {
 				case kIOStatisticsInterruptEventSourceCounter:
 					iec->created++;
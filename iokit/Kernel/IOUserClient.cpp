@@ -37,6 +37,7 @@
 #include <IOKit/IOCatalogue.h>
 #include <IOKit/IOMemoryDescriptor.h>
 #include <IOKit/IOBufferMemoryDescriptor.h>
+#include <IOKit/IOWorkLoop.h>
 #include <IOKit/IOLib.h>
 #include <IOKit/IOBSD.h>
 #include <IOKit/IOStatisticsPrivate.h>
@@ -4311,6 +4312,7 @@ is_io_service_open_extended(
 						}
 					}
 				}
+				client->batchGated = (kOSBooleanTrue == client->getProperty(kIOUserClientBatchGatedKey));
 			}
 			if (client->sharedInstance) {
 				IOLockUnlock(gIOUserClientOwnersLock);
@@ -4908,6 +4910,243 @@ is_io_connect_method
 	return ret;
 }
 
+// The struct input and output of one call of an io_connect_method_batch(),
+// staged in the kernel so that no copyin() or copyout() is made while the
+// client lock or gate is held.
+typedef struct IOUserClientBatchStage {
+	void     * input;
+	void     * output;
+	IOReturn   result;
+} IOUserClientBatchStage;
+
+static IOReturn
+IOUserClientBatchCopyIn(IOConnectMethodBatchCall * calls, uint32_t callCount,
+    IOUserClientBatchStage * stage, void ** buffer, vm_size_t * bufferSize)
+{
+	IOConnectMethodBatchCall * call;
+	uint8_t                  * next;
+	vm_size_t                  size;
+	uint32_t                   idx;
+
+	size = 0;
+	for (idx = 0; idx < callCount; idx++) {
+		call = &calls[idx];
+		if ((call->scalarInputCount > kIOExternalMethodScalarInputCountMax)
+		    || (call->scalarOutputCount > kIOExternalMethodScalarOutputCountMax)
+		    || (call->structInputSize > sizeof(io_struct_inband_t))
+		    || (call->structOutputSize > sizeof(io_struct_inband_t))) {
+			stage[idx].result = kIOReturnBadArgument;
+			continue;
+		}
+		stage[idx].result = kIOReturnSuccess;
+		size += call->structInputSize + call->structOutputSize;
+	}
+
+	*buffer = NULL;
+	*bufferSize = size;
+	if (size) {
+		*buffer = IOMalloc(size);
+		if (!*buffer) {
+			return kIOReturnNoMemory;
+		}
+	}
+
+	next = (uint8_t *) *buffer;
+	for (idx = 0; idx < callCount; idx++) {
+		call = &calls[idx];
+		stage[idx].input  = NULL;
+		stage[idx].output = NULL;
+		if (kIOReturnSuccess != stage[idx].result) {
+			continue;
+		}
+		if (call->structInputSize) {
+			stage[idx].input = next;
+			next += call->structInputSize;
+			if (copyin((user_addr_t) call->structInput, stage[idx].input, call->structInputSize)) {
+				stage[idx].result = kIOReturnVMError;
+			}
+		}
+		if (call->structOutputSize) {
+			stage[idx].output = next;
+			next += call->structOutputSize;
+		}
+	}
+
+	return kIOReturnSuccess;
+}
+
+static void
+IOUserClientBatchCopyOut(IOConnectMethodBatchCall * calls, uint32_t completed,
+    IOUserClientBatchStage * stage)
+{
+	IOConnectMethodBatchCall * call;
+	uint32_t                   idx;
+
+	for (idx = 0; idx < completed; idx++) {
+		call = &calls[idx];
+		if ((kIOReturnSuccess == stage[idx].result) && call->structOutputSize
+		    && copyout(stage[idx].output, (user_addr_t) call->structOutput, call->structOutputSize)) {
+			call->result = kIOReturnVMError;
+		}
+	}
+}
+
+// One call of an io_connect_method_batch(), with inband arguments only.
+static IOReturn
+IOUserClientBatchCall(IOUserClient * client, io_filter_policy_t filterPolicy,
+    IOConnectMethodBatchCall * call, IOUserClientBatchStage * stage)
+{
+	IOExternalMethodArguments args;
+	IOReturn                  ret;
+
+	if (kIOReturnSuccess != stage->result) {
+		return stage->result;
+	}
+
+	bzero(&args, sizeof(args));
+	args.version = kIOExternalMethodArgumentsCurrentVersion;
+
+	args.selector = call->selector;
+
+	args.asyncWakePort = MACH_PORT_NULL;
+
+	args.scalarInput = call->scalarInput;
+	args.scalarInputCount = call->scalarInputCount;
+	args.structureInput = stage->input;
+	args.structureInputSize = call->structInputSize;
+
+	args.scalarOutput = call->scalarOutput;
+	args.scalarOutputCount = call->scalarOutputCount;
+	bzero(&call->scalarOutput[0], sizeof(call->scalarOutput));
+	args.structureOutput = stage->output;
+	args.structureOutputSize = call->structOutputSize;
+
+	IOStatisticsClientCall();
+	ret = kIOReturnSuccess;
+	if (filterPolicy && gIOUCFilterCallbacks->io_filter_applier) {
+		ret = gIOUCFilterCallbacks->io_filter_applier(filterPolicy, io_filter_type_external_method, call->selector);
+	}
+	if (kIOReturnSuccess == ret) {
+		ret = client->externalMethod(call->selector, &args);
+	}
+
+	call->scalarOutputCount = min(args.scalarOutputCount, call->scalarOutputCount);
+	call->structOutputSize  = min(args.structureOutputSize, call->structOutputSize);
+
+	return ret;
+}
+
+static IOReturn
+IOUserClientRunBatch(IOUserClient * client, uint32_t options,
+    IOConnectMethodBatchCall * calls, IOUserClientBatchStage * stage,
+    uint32_t callCount, uint32_t * completed)
+{
+	io_filter_policy_t filterPolicy;
+	uint32_t           idx;
+
+	filterPolicy = client->filterForTask(current_task(), 0);
+	for (idx = 0; idx < callCount;) {
+		calls[idx].result = IOUserClientBatchCall(client, filterPolicy, &calls[idx], &stage[idx]);
+		if ((kIOReturnSuccess != calls[idx++].result)
+		    && (kIOConnectMethodBatchStopOnError & options)) {
+			break;
+		}
+	}
+	*completed = idx;
+
+	return kIOReturnSuccess;
+}
+
+/* Routine io_connect_method_batch */
+kern_return_t
+is_io_connect_method_batch
+(
+	io_connect_t connection,
+	uint32_t options,
+	mach_vm_address_t calls,
+	uint32_t call_count,
+	uint32_t *completed
+)
+{
+	CHECK( IOUserClient, connection, client );
+
+	IOConnectMethodBatchCall * batch;
+	IOUserClientBatchStage   * stage;
+	IOWorkLoop               * workLoop;
+	void                     * buffer;
+	vm_size_t                  batchSize;
+	vm_size_t                  stageSize;
+	vm_size_t                  bufferSize;
+	IOReturn                   ret;
+
+	*completed = 0;
+	if (!call_count || (call_count > kIOConnectMethodBatchMaxCalls)
+	    || (options & ~kIOConnectMethodBatchStopOnError)) {
+		return kIOReturnBadArgument;
+	}
+
+	batchSize = call_count * sizeof(IOConnectMethodBatchCall);
+	stageSize = call_count * sizeof(IOUserClientBatchStage);
+	batch = (typeof(batch))IOMalloc(batchSize);
+	stage = (typeof(stage))IOMalloc(stageSize);
+	if (!batch || !stage) {
+		ret = kIOReturnNoMemory;
+		goto finish;
+	}
+	if (copyin((user_addr_t) calls, batch, batchSize)) {
+		ret = kIOReturnVMError;
+		goto finish;
+	}
+
+	// Every struct input is copied in, and every struct output copied out,
+	// outside of the lock and gate so that a fault on the caller's memory
+	// never stalls the other clients of the driver.
+	buffer = NULL;
+	ret = IOUserClientBatchCopyIn(batch, call_count, stage, &buffer, &bufferSize);
+	if (kIOReturnSuccess != ret) {
+		goto finish;
+	}
+
+	// The lock, and the gate if the client asked for it, are taken once for
+	// the whole batch rather than once per call.
+	if (client->defaultLocking) {
+		IORWLockRead(client->lock);
+	}
+	workLoop = client->batchGated ? client->getWorkLoop() : NULL;
+	if (workLoop) {
+		ret = workLoop->runActionBlock(^IOReturn (void) {
+			return IOUserClientRunBatch(client, options, batch, stage, call_count, completed);
+		});
+	} else {
+		ret = IOUserClientRunBatch(client, options, batch, stage, call_count, completed);
+	}
+	if (client->defaultLocking) {
+		IORWLockUnlock(client->lock);
+	}
+
+	if (kIOReturnSuccess == ret) {
+		IOUserClientBatchCopyOut(batch, *completed, stage);
+	}
+	if (buffer) {
+		IOFree(buffer, bufferSize);
+	}
+
+	if ((kIOReturnSuccess == ret) && *completed
+	    && copyout(batch, (user_addr_t) calls, *completed * sizeof(IOConnectMethodBatchCall))) {
+		ret = kIOReturnVMError;
+	}
+
+finish:
+	if (stage) {
+		IOFree(stage, stageSize);
+	}
+	if (batch) {
+		IOFree(batch, batchSize);
+	}
+
+	return ret;
+}
+
 /* Routine io_async_user_client_method */
 kern_return_t
 is_io_connect_async_method
@@ -30,6 +30,10 @@
 #include <IOKit/IOWorkLoop.h>
 #include <IOKit/IOEventSource.h>
 #include <IOKit/IOInterruptEventSource.h>
+#include <IOKit/IOFilterInterruptEventSource.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <IOKit/IOCommandQueue.h>
+#include <IOKit/IODMAEventSource.h>
 #include <IOKit/IOCommandGate.h>
 #include <IOKit/IOCommandPool.h>
 #include <IOKit/IOTimeStamp.h>
@@ -78,6 +82,18 @@ ISSETP(void *addr, unsigned int flag)
 
 #define passiveEventChain       reserved->passiveEventChain
 
+/*
+ * Active event sources get a slot in a bitmap of pending sources, in the
+ * order they are chained, so that runEventSources() only calls checkForWork()
+ * on the ones that signaled work. Past that many sources the loop goes back
+ * to walking the whole chain.
+ */
+#define kIOWorkLoopEventSlots   64
+static_assert(kIOWorkLoopEventSlots == sizeof(((IOWorkLoop::ExpansionData *) NULL)->eventSlots) / sizeof(IOEventSource *),
+    "eventSlots must have kIOWorkLoopEventSlots entries");
+static_assert(kIOWorkLoopEventSlots <= 8 * sizeof(((IOWorkLoop::ExpansionData *) NULL)->pendingEventSources),
+    "eventSlots must have a bit in pendingEventSources");
+
 #if IOKITSTATS
 
 #define IOStatisticsRegisterCounter() \
@@ -112,6 +128,16 @@ do { \
 	IOStatistics::detachWorkLoopEventSource(reserved->counter, inEvent->reserved->counter); \
 } while(0)
 
+#define IOStatisticsSignalEventSource() \
+do { \
+	IOStatistics::countEventSourceSignal(source->reserved->counter); \
+} while(0)
+
+#define IOStatisticsDispatchEventSource() \
+do { \
+	IOStatistics::countEventSourceDispatch(evnt->reserved->counter); \
+} while(0)
+
 #else
 
 #define IOStatisticsRegisterCounter()
@@ -120,6 +146,8 @@ do { \
 #define IOStatisticsCloseGate()
 #define IOStatisticsAttachEventSource()
 #define IOStatisticsDetachEventSource()
+#define IOStatisticsSignalEventSource()
+#define IOStatisticsDispatchEventSource()
 
 #endif /* IOKITSTATS */
 
@@ -238,6 +266,7 @@ IOWorkLoop::releaseEventChain(LIBKERN_CONSUMED IOEventSource *eventChain)
 			next->retain();
 		}
 #endif
+		event->eventSlot = 0;
 		event->setWorkLoop(NULL);
 		event->setNext(NULL);
 		event->release();
@@ -398,19 +427,31 @@ IOWorkLoop::runEventSources()
 	}
 
 	bool more;
+	uint64_t again;
+	again = 0;
 	do {
 		CLRP(&fFlags, kLoopRestart);
 		more = false;
 		IOInterruptState is = IOSimpleLockLockDisableInterrupt(workToDoLock);
 		workToDo = false;
+		reserved->pendingEventSources |= again;
 		IOSimpleLockUnlockEnableInterrupt(workToDoLock, is);
-		/* NOTE: only loop over event sources in eventChain. Bypass "passive" event sources for performance */
-		for (IOEventSource *evnt = eventChain; evnt; evnt = evnt->getNext()) {
+		again = 0;
+		/*
+		 * NOTE: only loop over event sources in eventChain. Bypass "passive" event sources for performance.
+		 * Unless the chain is too long for the pending set, only visit the sources that signaled work,
+		 * plus the ones that have to be polled, in chain order.
+		 */
+		bool bySlot = !reserved->eventSlotsOverflow;
+		for (IOEventSource *evnt = bySlot ? takePendingEventSource(NULL) : eventChain; evnt;
+		    evnt = bySlot ? takePendingEventSource(evnt) : evnt->getNext()) {
 			if (traceES) {
 				IOTimeStampStartConstant(IODBG_WORKLOOP(IOWL_CLIENT), VM_KERNEL_ADDRHIDE(this), VM_KERNEL_ADDRHIDE(evnt));
 			}
 
-			more |= evnt->checkForWork();
+			IOStatisticsDispatchEventSource();
+			bool evntMore = evnt->checkForWork();
+			more |= evntMore;
 
 			if (traceES) {
 				IOTimeStampEndConstant(IODBG_WORKLOOP(IOWL_CLIENT), VM_KERNEL_ADDRHIDE(this), VM_KERNEL_ADDRHIDE(evnt));
@@ -422,6 +463,11 @@ IOWorkLoop::runEventSources()
 				more = true;
 				break;
 			}
+
+			// Still has work, look at it again on the next pass.
+			if (evntMore && bySlot) {
+				again |= 1ULL << (evnt->eventSlot - 1);
+			}
 		}
 	} while (more);
 
@@ -495,7 +541,100 @@ IOWorkLoop::inGate() const
 	return IORecursiveLockHaveLock(gateLock);
 }
 
+/*
+ * Event sources that only have work after they signal it. Subclasses may
+ * produce work some other way, so only these exact classes are trusted; any
+ * other active event source is polled on every pass, as it always was.
+ */
+static bool
+IOWorkLoopEventSourceSignalsWork(IOEventSource *inEventSource)
+{
+	const OSMetaClass * meta = inEventSource->getMetaClass();
+
+	return (meta == IOInterruptEventSource::metaClass)
+	       || (meta == IOFilterInterruptEventSource::metaClass)
+	       || (meta == IOTimerEventSource::metaClass)
+	       || (meta == IOCommandQueue::metaClass)
+	       || (meta == IODMAEventSource::metaClass);
+}
+
+// Renumber the active event sources after the chain changed. Called with the gate closed.
+void
+IOWorkLoop::updateEventSlots(void)
+{
+	IOEventSource *    event;
+	uint64_t           used = 0;
+	uint64_t           polled = 0;
+	uint32_t           slot = 0;
+	bool               overflow = false;
+	IOInterruptState   is;
+
+	is = IOSimpleLockLockDisableInterrupt(workToDoLock);
+	for (event = eventChain; event; event = event->getNext(), slot++) {
+		if (slot >= kIOWorkLoopEventSlots) {
+			event->eventSlot = 0;
+			overflow = true;
+			continue;
+		}
+		event->eventSlot = (uint8_t) (slot + 1);
+		reserved->eventSlots[slot] = event;
+		used |= 1ULL << slot;
+		if (!IOWorkLoopEventSourceSignalsWork(event)) {
+			polled |= 1ULL << slot;
+		}
+	}
+	for (; slot < kIOWorkLoopEventSlots; slot++) {
+		reserved->eventSlots[slot] = NULL;
+	}
+	// Signals may have landed on the old numbering, so look at everything once.
+	reserved->pendingEventSources = used;
+	reserved->polledEventSources = polled;
+	reserved->eventSlotsOverflow = overflow;
+	IOSimpleLockUnlockEnableInterrupt(workToDoLock, is);
+}
+
+// Next event source after "after" in chain order that is pending or polled. Called with the gate closed.
+IOEventSource *
+IOWorkLoop::takePendingEventSource(IOEventSource *after)
+{
+	IOEventSource *    event = NULL;
+	uint32_t           first = after ? after->eventSlot : 0;
+	uint64_t           bits;
+	IOInterruptState   is;
+
+	if (first >= kIOWorkLoopEventSlots) {
+		return NULL;
+	}
+
+	is = IOSimpleLockLockDisableInterrupt(workToDoLock);
+	bits = (reserved->pendingEventSources | reserved->polledEventSources) & (~0ULL << first);
+	if (bits) {
+		uint32_t slot = __builtin_ctzll(bits);
+		reserved->pendingEventSources &= ~(1ULL << slot);
+		event = reserved->eventSlots[slot];
+	}
+	IOSimpleLockUnlockEnableInterrupt(workToDoLock, is);
+
+	return event;
+}
+
 // Internal APIs used by event sources to control the thread
+void
+IOWorkLoop::signalEventSource(IOEventSource *source)
+{
+	IOStatisticsSignalEventSource();
+
+	if (workToDoLock && source->eventSlot) {
+		IOInterruptState is = IOSimpleLockLockDisableInterrupt(workToDoLock);
+		if (source->eventSlot) {
+			reserved->pendingEventSources |= 1ULL << (source->eventSlot - 1);
+		}
+		IOSimpleLockUnlockEnableInterrupt(workToDoLock, is);
+	}
+
+	signalWorkAvailable();
+}
+
 void
 IOWorkLoop::signalWorkAvailable()
 {
@@ -614,6 +753,7 @@ IOWorkLoop::_maintRequest(void *inC, void *inD, void *, void *)
 					}
 					event->setNext(inEvent);
 				}
+				updateEventSlots();
 			} else {
 				if (!passiveEventChain) {
 					passiveEventChain = inEvent;
@@ -653,6 +793,8 @@ IOWorkLoop::_maintRequest(void *inC, void *inD, void *, void *)
 					}
 					event->setNext(inEvent->getNext());
 				}
+				inEvent->eventSlot = 0;
+				updateEventSlots();
 			} else {
 				if (passiveEventChain == inEvent) {
 					passiveEventChain = inEvent->getNext();
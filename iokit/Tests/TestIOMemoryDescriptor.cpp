@@ -602,6 +602,112 @@ AllocationNameTest(int newValue)
 	return 0;
 }
 
+static uint64_t
+IOMemorySegmentTestVA(const IOAddressRange * ranges, uint32_t rangeCount, uint64_t offset)
+{
+	for (uint32_t idx = 0; idx < rangeCount; idx++) {
+		if (offset < ranges[idx].length) {
+			return ranges[idx].address + offset;
+		}
+		offset -= ranges[idx].length;
+	}
+	return 0;
+}
+
+static addr64_t
+IOMemorySegmentTestPhys(uint64_t va)
+{
+	return ptoa_64(pmap_find_phys(kernel_pmap, va)) + (va & page_mask);
+}
+
+// The unmapped walk of a wired descriptor looks its segments up once it has
+// found them; check what getPhysicalSegment() and an IODMACommand get from it
+// against the pmap, and again once the descriptor has been prepared anew.
+static int
+IOMemorySegmentCacheTest(int newValue)
+{
+	IOMemoryDescriptor * md;
+	IODMACommand       * dma;
+	IOAddressRange       ranges[3];
+	vm_offset_t          data = 0;
+	vm_size_t            bsize = ptoa(64);
+	uint64_t             offset, dmaOffset, total, va;
+	addr64_t             address;
+	IOByteCount          length;
+	IOReturn             ret;
+	kern_return_t        kr;
+	IODMACommand::SegmentOptions segOptions =
+	{
+		.fStructSize      = sizeof(segOptions),
+		.fNumAddressBits  = 64,
+		.fMaxSegmentSize  = 0,
+		.fMaxTransferSize = 0,
+		.fAlignment       = 1,
+		.fAlignmentLength = 1,
+		.fAlignmentInternalSegments = 1
+	};
+	IODMACommand::Segment64 segments[8];
+	UInt32                  numSegments;
+
+	kr = vm_allocate_kernel(kernel_map, &data, bsize, VM_FLAGS_ANYWHERE, VM_KERN_MEMORY_IOKIT);
+	assert(KERN_SUCCESS == kr);
+
+	// out of order, and not starting or ending on a page
+	ranges[0].address = data + 0x100;
+	ranges[0].length  = ptoa(20) - 0x300;
+	ranges[1].address = data + ptoa(40);
+	ranges[1].length  = ptoa(10) + 0x123;
+	ranges[2].address = data + ptoa(21);
+	ranges[2].length  = ptoa(15);
+
+	md = IOMemoryDescriptor::withAddressRanges(&ranges[0], 3, kIODirectionInOut, kernel_task);
+	assert(md);
+
+	for (uint32_t pass = 0; pass < 2; pass++) {
+		ret = md->prepare();
+		assert(kIOReturnSuccess == ret);
+
+		for (offset = 0; offset < md->getLength(); offset += 0x1f3) {
+			address = md->getPhysicalSegment(offset, &length, kIOMemoryMapperNone);
+			va = IOMemorySegmentTestVA(&ranges[0], 3, offset);
+			assert(length && (length <= (md->getLength() - offset)));
+			assertf(IOMemorySegmentTestPhys(va) == address, "0x%qx: 0x%qx", offset, address);
+			va = IOMemorySegmentTestVA(&ranges[0], 3, offset + length - 1);
+			assertf(IOMemorySegmentTestPhys(va) == (address + length - 1), "0x%qx: 0x%qx, 0x%qx", offset, address, (uint64_t) length);
+		}
+
+		dma = IODMACommand::withSpecification(kIODMACommandOutputHost64, &segOptions,
+		    kIODMAMapOptionUnmapped, NULL, NULL);
+		assert(dma);
+		ret = dma->setMemoryDescriptor(md, true);
+		assert(kIOReturnSuccess == ret);
+
+		total = dmaOffset = 0;
+		while (dmaOffset < md->getLength()) {
+			numSegments = sizeof(segments) / sizeof(segments[0]);
+			ret = dma->gen64IOVMSegments(&dmaOffset, &segments[0], &numSegments);
+			assert(kIOReturnSuccess == ret);
+			for (UInt32 idx = 0; idx < numSegments; idx++) {
+				va = IOMemorySegmentTestVA(&ranges[0], 3, total);
+				assertf(IOMemorySegmentTestPhys(va) == segments[idx].fIOVMAddr, "0x%qx: 0x%qx", total, segments[idx].fIOVMAddr);
+				total += segments[idx].fLength;
+			}
+		}
+		assert(md->getLength() == total);
+
+		ret = dma->clearMemoryDescriptor(true);
+		assert(kIOReturnSuccess == ret);
+		dma->release();
+
+		md->complete();
+	}
+
+	md->release();
+	vm_deallocate(kernel_map, data, bsize);
+
+	return 0;
+}
+
 int
 IOMemoryDescriptorTest(int newValue)
 {
@@ -876,6 +982,11 @@ IOMemoryDescriptorTest(int newValue)
 		return result;
 	}
 
+	result = IOMemorySegmentCacheTest(newValue);
+	if (result) {
+		return result;
+	}
+
 	IOGeneralMemoryDescriptor * md;
 	vm_offset_t data[2];
 	vm_size_t  bsize = 16 * 1024 * 1024;
@@ -184,6 +184,8 @@
 
 #if DEVELOPMENT || DEBUG
 
+#include <IOKit/IOBSD.h>
+#include <IOKit/IOCatalogue.h>
 #include <IOKit/IOWorkLoop.h>
 #include <IOKit/IOTimerEventSource.h>
 #include <IOKit/IOInterruptEventSource.h>
@@ -191,6 +193,9 @@
 #include <IOKit/IOPlatformExpert.h>
 #include <IOKit/IOSharedDataQueue.h>
 #include <IOKit/IODataQueueShared.h>
+#include <IOKit/IOUserClient.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include <IOKit/IODMACommand.h>
 #include <libkern/Block.h>
 #include <libkern/Block_private.h>
 #include <libkern/c++/OSAllocation.h>
@@ -198,10 +203,21 @@
 #include <libkern/c++/OSBoundedArrayRef.h>
 #include <libkern/c++/OSBoundedPtr.h>
 #include <libkern/c++/OSSharedPtr.h>
+#include <libkern/c++/OSSerialize.h>
+#include <libkern/c++/OSUnserialize.h>
+#include <kern/thread.h>
 #include <os/cpp_util.h>
+#include <sys/errno.h>
 
 static uint64_t gIOWorkLoopTestDeadline;
 
+// More than the work loop keeps a pending set for
+#define kIOWorkLoopTestSources 70
+static IOInterruptEventSource * gIOWorkLoopTestSources[kIOWorkLoopTestSources];
+static uint32_t gIOWorkLoopTestCalls[kIOWorkLoopTestSources];
+static uint32_t gIOWorkLoopTestOrder[2];
+static volatile uint32_t gIOWorkLoopTestRan;
+
 static void
 TESAction(OSObject * owner, IOTimerEventSource * tes)
 {
@@ -264,6 +280,47 @@ IOWorkLoopTest(int newValue)
 
 	wl->release();
 
+	// Only the signaled sources run, in chain order, with and without the pending set
+	static const uint32_t counts[] = { 8, kIOWorkLoopTestSources };
+	for (uint32_t count : counts) {
+		wl = IOWorkLoop::workLoop();
+		assert(wl);
+		bzero(gIOWorkLoopTestCalls, sizeof(gIOWorkLoopTestCalls));
+		gIOWorkLoopTestRan = 0;
+		for (idx = 0; idx < count; idx++) {
+			uint32_t which = idx;
+			ies = IOInterruptEventSource::interruptEventSource(wl, NULL, 0, ^void (IOInterruptEventSource *sender, int calls){
+				gIOWorkLoopTestCalls[which] += calls;
+				if (gIOWorkLoopTestRan < 2) {
+					gIOWorkLoopTestOrder[gIOWorkLoopTestRan] = which;
+				}
+				gIOWorkLoopTestRan++;
+			});
+			assert(ies);
+			err = wl->addEventSource(ies);
+			assert(kIOReturnSuccess == err);
+			gIOWorkLoopTestSources[idx] = ies;
+		}
+		IOSleep(1);
+		wl->runActionBlock(^IOReturn (void) {
+			gIOWorkLoopTestSources[5]->interruptOccurred(NULL, NULL, 0);
+			gIOWorkLoopTestSources[2]->interruptOccurred(NULL, NULL, 0);
+			return kIOReturnSuccess;
+		});
+		for (idx = 0; (idx < 1000) && (gIOWorkLoopTestRan < 2); idx++) {
+			IOSleep(1);
+		}
+		assert(2 == gIOWorkLoopTestRan);
+		assert((2 == gIOWorkLoopTestOrder[0]) && (5 == gIOWorkLoopTestOrder[1]));
+		for (idx = 0; idx < count; idx++) {
+			assert(gIOWorkLoopTestCalls[idx] == (((2 == idx) || (5 == idx)) ? 1U : 0U));
+			wl->removeEventSource(gIOWorkLoopTestSources[idx]);
+			gIOWorkLoopTestSources[idx]->release();
+			gIOWorkLoopTestSources[idx] = NULL;
+		}
+		wl->release();
+	}
+
 	return 0;
 }
 
@@ -443,6 +500,271 @@ IOSharedDataQueue_44636964(__unused int newValue)
 	return KERN_SUCCESS;
 }
 
+static int
+IOSharedDataQueueBatchTest(__unused int newValue)
+{
+	IOSharedDataQueue* sd = IOSharedDataQueue::withCapacity(4 * (DATA_QUEUE_ENTRY_HEADER_SIZE + sizeof(UInt64)));
+	UInt64 data[4] = { 1, 2, 3, 4 };
+	UInt32 sizes[4] = { sizeof(UInt64), sizeof(UInt64), sizeof(UInt64), sizeof(UInt64) };
+	UInt64 out[4] = { 0 };
+	UInt32 outSizes[4] = { 0 };
+	UInt64 * entry;
+
+	/* the whole batch fits, only one notification for it */
+	assert(sd->enqueueBatch(data, sizes, 4) == 4);
+	assert(sd->enqueueBatch(data, sizes, 1) == 0);
+	/* leaves the entry that doesn't fit in out behind */
+	assert(sd->dequeueBatch(out, 3 * sizeof(UInt64) + 1, outSizes, 4) == 3);
+	assert(out[0] == 1 && out[1] == 2 && out[2] == 3);
+	assert(outSizes[0] == sizeof(UInt64) && outSizes[2] == sizeof(UInt64));
+
+	/* reserved entries stay invisible until they are committed */
+	entry = (UInt64 *) sd->enqueueReserve(sizeof(UInt64));
+	assert(entry != NULL);
+	*entry = 5;
+	assert(!sd->enqueue(&data[0], sizeof(UInt64)));
+	assert(sd->dequeueBatch(out, sizeof(out), outSizes, 4) == 1);
+	assert(out[0] == 4);
+	assert(sd->peek() == NULL);
+	sd->enqueueCommit();
+	assert(sd->dequeueBatch(out, sizeof(out), outSizes, 4) == 1);
+	assert(out[0] == 5);
+	assert(sd->peek() == NULL);
+
+	sd->release();
+	return KERN_SUCCESS;
+}
+
+// The bison parser OSUnserializeXML() replaced, see OSUnserializeXMLReference.cpp
+extern OSObject * OSUnserializeXMLReference(const char * buffer, OSString ** errorString);
+
+// Unserializes xml with OSUnserializeXML() and OSUnserializeXMLReference()
+// and returns whether they agree: both make equal objects, with the same ones
+// shared through IDREFs, or both fail with the same error.
+static bool
+OSUnserializeXMLMatchesReference(const char * xml, bool * parsed)
+{
+	OSObject    * obj;
+	OSObject    * ref;
+	OSString    * error = NULL;
+	OSString    * refError = NULL;
+	OSSerialize * s = NULL;
+	OSSerialize * refS = NULL;
+	bool          matches;
+
+	obj = OSUnserializeXML(xml, &error);
+	ref = OSUnserializeXMLReference(xml, &refError);
+	if (!obj || !ref) {
+		matches = !obj && !ref && error && refError && error->isEqualTo(refError);
+	} else {
+		// sharing shows up as IDREFs in the serialization
+		s = OSSerialize::withCapacity(4096);
+		refS = OSSerialize::withCapacity(4096);
+		matches = s && refS && obj->isEqualTo(ref)
+		    && obj->serialize(s) && ref->serialize(refS)
+		    && !strcmp(s->text(), refS->text());
+	}
+	if (parsed) {
+		*parsed = (obj != NULL);
+	}
+	OSSafeReleaseNULL(obj);
+	OSSafeReleaseNULL(ref);
+	OSSafeReleaseNULL(error);
+	OSSafeReleaseNULL(refError);
+	OSSafeReleaseNULL(s);
+	OSSafeReleaseNULL(refS);
+
+	return matches;
+}
+
+static const struct {
+	const char * xml;
+	bool         parses;
+} gOSUnserializeXMLTestCases[] = {
+	{ "<plist version=\"1.0\"><dict><key>IOClass</key><string>AppleFoo</string>"
+	  "<key>IOProbeScore</key><integer size=\"32\">0x3e8</integer>"
+	  "<key>IOPCIMatch</key><string ID=\"1\">0x12348086&amp;0xffffffff</string>"
+	  "<key>IONameMatch</key><array><string IDREF=\"1\"/><string>pci8086,1234</string></array>"
+	  "<key>Enabled</key><true/><key>Disabled</key><false/>"
+	  "</dict></plist>", true },
+	{ "<set ID=\"2\"><string>a</string><string>b</string><integer>-1</integer></set>", true },
+	{ "<array><set ID=\"3\"/><set IDREF=\"3\"/><array/><dict/><string/></array>", true },
+	{ "<dict><key>hex</key><data format=\"hex\">001122aabbff</data>"
+	  "<key>base64</key><data>AAECAwQFBgc=\n</data><key>empty</key><data/></dict>", true },
+	{ "<!-- comment --><?xml version=\"1.0\"?><!DOCTYPE plist>"
+	  "<string>&lt;&gt;&amp;</string>", true },
+	{ "<integer>0xffffffffffffffff</integer>", true },
+	{ "<dict><key>a</key><string>1</string><key>a</key><string>2</string></dict>", false },
+	{ "<array><string IDREF=\"9\"/><string ID=\"9\">x</string></array>", false },
+	{ "<dict><key>a</key></dict>", false },
+	{ "<array><string>a</string>", false },
+	{ "<string>&bogus;</string>", false },
+	{ "<string>&quot;</string>", false },
+	{ "</array>", false },
+	{ "", false },
+};
+
+static int
+OSUnserializeXMLTest(__unused int newValue)
+{
+	char   * xml;
+	size_t   size, len;
+	bool     parsed;
+	uint32_t depth;
+
+	for (uint32_t idx = 0; idx < (sizeof(gOSUnserializeXMLTestCases) / sizeof(gOSUnserializeXMLTestCases[0])); idx++) {
+		assert(OSUnserializeXMLMatchesReference(gOSUnserializeXMLTestCases[idx].xml, &parsed));
+		assert(parsed == gOSUnserializeXMLTestCases[idx].parses);
+	}
+
+	// both run out of parser stack at the same depth, a little past 128 levels
+	size = 256 * (sizeof("<dict><key>k</key>") + sizeof("</array>")) + 1;
+	xml = (typeof(xml))IOMalloc(size);
+	assert(xml);
+	for (depth = 90; depth <= 256; depth += 2) {
+		len = 0;
+		for (uint32_t idx = 0; idx < depth; idx++) {
+			len += strlcpy(xml + len, (idx & 1) ? "<array>" : "<dict><key>k</key>", size - len);
+		}
+		for (uint32_t idx = depth; idx-- > 0;) {
+			len += strlcpy(xml + len, (idx & 1) ? "</array>" : "</dict>", size - len);
+		}
+		assert(OSUnserializeXMLMatchesReference(xml, &parsed));
+		if (!parsed) {
+			break;
+		}
+	}
+	assert((depth > 128) && (depth <= 256));
+	IOFree(xml, size);
+
+	return KERN_SUCCESS;
+}
+
+// XML serialization of an array of kOSUnserializeXMLTestPersonalities driver
+// personalities for tests/osunserialize_xml_perf.c:
+// kOSUnserializeXMLTestPopulate makes it, kOSUnserializeXMLTestParse and
+// kOSUnserializeXMLTestParseReference unserialize it once with
+// OSUnserializeXML() and OSUnserializeXMLReference(), and
+// kOSUnserializeXMLTestDepopulate frees it.
+#define kOSUnserializeXMLTestPopulate       7788
+#define kOSUnserializeXMLTestParse          7789
+#define kOSUnserializeXMLTestParseReference 7790
+#define kOSUnserializeXMLTestDepopulate     7791
+#define kOSUnserializeXMLTestPersonalities  2000
+
+static OSSerialize * gOSUnserializeXMLTestSerialize;
+
+static OSSerialize *
+OSUnserializeXMLTestSerialize(void)
+{
+	OSArray      * personalities;
+	OSDictionary * personality;
+	OSArray      * names;
+	OSSerialize  * s;
+	OSString     * str;
+	OSNumber     * num;
+	OSData       * data;
+	char           value[64];
+	uint8_t        bytes[16];
+	bool           ok;
+
+	personalities = OSArray::withCapacity(kOSUnserializeXMLTestPersonalities);
+	if (!personalities) {
+		return NULL;
+	}
+	memset(bytes, 0xa5, sizeof(bytes));
+	ok = true;
+	for (uint32_t idx = 0; ok && (idx < kOSUnserializeXMLTestPersonalities); idx++) {
+		personality = OSDictionary::withCapacity(8);
+		names = OSArray::withCapacity(2);
+		ok = personality && names;
+		if (ok) {
+			snprintf(value, sizeof(value), "com.apple.driver.IOUnserializeXMLTest%u", idx);
+			ok = (str = OSString::withCString(value)) && personality->setObject("CFBundleIdentifier", str);
+			OSSafeReleaseNULL(str);
+			ok = ok && personality->setObject("IOClass", gIOServiceKey)
+			    && personality->setObject("IOProviderClass", gIOServiceKey);
+			snprintf(value, sizeof(value), "0x%04x8086&0xffffffff", idx);
+			ok = ok && (str = OSString::withCString(value)) && personality->setObject("IOPCIMatch", str)
+			    && names->setObject(str);
+			OSSafeReleaseNULL(str);
+			snprintf(value, sizeof(value), "pci8086,%x", idx);
+			ok = ok && (str = OSString::withCString(value)) && names->setObject(str)
+			    && personality->setObject("IONameMatch", names);
+			OSSafeReleaseNULL(str);
+			ok = ok && (num = OSNumber::withNumber(idx, 32)) && personality->setObject("IOProbeScore", num);
+			OSSafeReleaseNULL(num);
+			ok = ok && (data = OSData::withBytes(bytes, sizeof(bytes))) && personality->setObject("IOTestData", data);
+			OSSafeReleaseNULL(data);
+			ok = ok && personality->setObject("IOMatchDefer", kOSBooleanTrue)
+			    && personalities->setObject(personality);
+		}
+		OSSafeReleaseNULL(names);
+		OSSafeReleaseNULL(personality);
+	}
+
+	s = NULL;
+	if (ok) {
+		s = OSSerialize::withCapacity(kOSUnserializeXMLTestPersonalities * 1024);
+		if (s && !personalities->serialize(s)) {
+			OSSafeReleaseNULL(s);
+		}
+	}
+	OSSafeReleaseNULL(personalities);
+
+	return s;
+}
+
+static int
+OSUnserializeXMLPerfTest(int newValue)
+{
+	OSSerialize * s;
+	OSObject    * obj;
+
+	switch (newValue) {
+	case kOSUnserializeXMLTestPopulate:
+		s = OSUnserializeXMLTestSerialize();
+		if (!s) {
+			return ENOMEM;
+		}
+		if (!OSCompareAndSwapPtr(NULL, s, (void * volatile *) &gOSUnserializeXMLTestSerialize)) {
+			s->release();
+			return EBUSY;
+		}
+		IOLog("OSUnserializeXMLPerfTest: %u byte serialization\n", s->getLength());
+		return 0;
+
+	case kOSUnserializeXMLTestParse:
+	case kOSUnserializeXMLTestParseReference:
+		s = gOSUnserializeXMLTestSerialize;
+		if (!s) {
+			return ENOENT;
+		}
+		if (kOSUnserializeXMLTestParse == newValue) {
+			obj = OSUnserializeXML(s->text());
+		} else {
+			obj = OSUnserializeXMLReference(s->text(), NULL);
+		}
+		if (!obj) {
+			return EINVAL;
+		}
+		obj->release();
+		return 0;
+
+	case kOSUnserializeXMLTestDepopulate:
+		s = gOSUnserializeXMLTestSerialize;
+		if (!s) {
+			return ENOENT;
+		}
+		// not meant to race with the other operations
+		gOSUnserializeXMLTestSerialize = NULL;
+		s->release();
+		return 0;
+	}
+
+	return EINVAL;
+}
+
 #if 0
 #include <IOKit/IOUserClient.h>
 class TestUserClient : public IOUserClient
@@ -528,6 +850,967 @@ IOServiceTest(int newValue)
 	return 0;
 }
 
+// Populates the registry with services to benchmark matching against, see
+// tests/ioregistry_matching_perf.c: kIORegistryMatchTestPopulate publishes
+// kIORegistryMatchTestCount nubs below a root nub, each with its own name,
+// BSD name and index property, and kIORegistryMatchTestDepopulate terminates
+// the root and with it all the nubs.
+#define kIORegistryMatchTestPopulate    7777
+#define kIORegistryMatchTestDepopulate  7778
+#define kIORegistryMatchTestCount       20000
+
+static IOService * gIORegistryMatchTestRoot;
+
+static int
+IORegistryMatchTest(int newValue)
+{
+	IOService * root;
+	IOService * nub;
+	char        name[64];
+
+	if (kIORegistryMatchTestDepopulate == newValue) {
+		do {
+			root = gIORegistryMatchTestRoot;
+			if (!root) {
+				return ENOENT;
+			}
+		} while (!OSCompareAndSwapPtr(root, NULL, (void * volatile *) &gIORegistryMatchTestRoot));
+		root->terminate(kIOServiceSynchronous);
+		root->release();
+		return 0;
+	}
+
+	root = new IOService;
+	if (!root || !root->init()) {
+		OSSafeReleaseNULL(root);
+		return ENOMEM;
+	}
+	if (!OSCompareAndSwapPtr(NULL, root, (void * volatile *) &gIORegistryMatchTestRoot)) {
+		root->release();
+		return EBUSY;
+	}
+	root->setName("IORegistryMatchTestRoot");
+	root->attach(IOService::getPlatform());
+	root->registerService();
+
+	for (uint32_t idx = 0; idx < kIORegistryMatchTestCount; idx++) {
+		nub = new IOService;
+		if (!nub || !nub->init()) {
+			OSSafeReleaseNULL(nub);
+			return ENOMEM;
+		}
+		snprintf(name, sizeof(name), "IORegistryMatchTest%u", idx);
+		nub->setName(name);
+		snprintf(name, sizeof(name), "iomt%u", idx);
+		nub->setProperty(kIOBSDNameKey, name);
+		nub->setProperty("IORegistryMatchTestIndex", idx, 32);
+		nub->attach(root);
+		nub->registerService();
+		nub->release();
+	}
+	root->waitQuiet();
+
+	return 0;
+}
+
+// Plane links in a plane of their own, for IORegistryLinkTest() and
+// tests/ioregistry_links_perf.c: kIORegistryLinkTestPopulate links
+// kIORegistryLinkTestParents parents below a root, with
+// kIORegistryLinkTestChildren children each; kIORegistryLinkTestRead looks up
+// the parent, depth and siblings of kIORegistryLinkTestReads random children,
+// and kIORegistryLinkTestReadLocked does the same with gIORegistryLock held
+// shared around each lookup, the way every lookup used to take it;
+// kIORegistryLinkTestChurnStart starts a thread that attaches and detaches
+// entries below the parents until kIORegistryLinkTestChurnStop, and
+// kIORegistryLinkTestDepopulate takes it all apart again.
+#define kIORegistryLinkTestPopulate     7792
+#define kIORegistryLinkTestRead         7793
+#define kIORegistryLinkTestReadLocked   7794
+#define kIORegistryLinkTestChurnStart   7795
+#define kIORegistryLinkTestChurnStop    7796
+#define kIORegistryLinkTestDepopulate   7797
+#define kIORegistryLinkTestParents      64
+#define kIORegistryLinkTestChildren     64
+#define kIORegistryLinkTestReads        10000
+
+extern lck_rw_t gIORegistryLock;
+
+static const IORegistryPlane * gIORegistryLinkTestPlane;
+static IORegistryEntry *       gIORegistryLinkTestRoot;
+static IORegistryEntry *       gIORegistryLinkTestEntries[kIORegistryLinkTestParents * (1 + kIORegistryLinkTestChildren)];
+static volatile bool           gIORegistryLinkTestChurning;
+static volatile bool           gIORegistryLinkTestChurnRunning;
+
+static const IORegistryPlane *
+IORegistryLinkTestPlane(void)
+{
+	// planes are never removed, so it is made once and kept
+	if (!gIORegistryLinkTestPlane) {
+		gIORegistryLinkTestPlane = IORegistryEntry::getPlane("IORegistryLinkTest");
+	}
+	if (!gIORegistryLinkTestPlane) {
+		gIORegistryLinkTestPlane = IORegistryEntry::makePlane("IORegistryLinkTest");
+	}
+	return gIORegistryLinkTestPlane;
+}
+
+static IORegistryEntry *
+IORegistryLinkTestEntry(IORegistryEntry * parent, const IORegistryPlane * plane)
+{
+	IORegistryEntry * entry;
+
+	entry = new IORegistryEntry;
+	if (!entry || !entry->init()) {
+		OSSafeReleaseNULL(entry);
+		return NULL;
+	}
+	if (parent && !entry->attachToParent(parent, plane)) {
+		OSSafeReleaseNULL(entry);
+	}
+	return entry;
+}
+
+static void
+IORegistryLinkTestChurn(__unused void * arg, __unused wait_result_t wr)
+{
+	const IORegistryPlane * plane = gIORegistryLinkTestPlane;
+	IORegistryEntry *       parent;
+	IORegistryEntry *       entry;
+	uint64_t                churns = 0, start, ns;
+
+	start = mach_absolute_time();
+	while (gIORegistryLinkTestChurning) {
+		parent = gIORegistryLinkTestEntries[churns % kIORegistryLinkTestParents];
+		entry = IORegistryLinkTestEntry(parent, plane);
+		if (entry) {
+			entry->detachFromParent(parent, plane);
+			entry->release();
+		}
+		churns++;
+	}
+	absolutetime_to_nanoseconds(mach_absolute_time() - start, &ns);
+	IOLog("IORegistryLinkTest: %llu attach/detach in %llu ms\n", churns, ns / NSEC_PER_MSEC);
+
+	gIORegistryLinkTestChurnRunning = false;
+	thread_terminate(current_thread());
+}
+
+static int
+IORegistryLinkTestRead(bool locked)
+{
+	const IORegistryPlane * plane = gIORegistryLinkTestPlane;
+	IORegistryEntry *       child;
+	IORegistryEntry *       parent;
+	OSIterator *            iter;
+	uint32_t                idx, siblings;
+
+	for (uint32_t read = 0; read < kIORegistryLinkTestReads; read++) {
+		idx = kIORegistryLinkTestParents + (((uint32_t) random()) % (kIORegistryLinkTestParents * kIORegistryLinkTestChildren));
+		child = gIORegistryLinkTestEntries[idx];
+		if (locked) {
+			lck_rw_lock_shared(&gIORegistryLock);
+		}
+		parent = child->copyParentEntry(plane);
+		if (!parent || !child->isParent(parent, plane) || (3 != child->getDepth(plane))) {
+			OSSafeReleaseNULL(parent);
+			if (locked) {
+				lck_rw_done(&gIORegistryLock);
+			}
+			return EINVAL;
+		}
+		if (0 == (read & 15)) {
+			siblings = 0;
+			if ((iter = parent->getChildIterator(plane))) {
+				while (iter->getNextObject()) {
+					siblings++;
+				}
+				iter->release();
+			}
+			if (siblings < kIORegistryLinkTestChildren) {
+				parent->release();
+				if (locked) {
+					lck_rw_done(&gIORegistryLock);
+				}
+				return EINVAL;
+			}
+		}
+		parent->release();
+		if (locked) {
+			lck_rw_done(&gIORegistryLock);
+		}
+	}
+	return 0;
+}
+
+static int
+IORegistryLinkTestPerf(int newValue)
+{
+	const IORegistryPlane * plane;
+	IORegistryEntry *       root;
+	IORegistryEntry *       parent;
+	thread_t                thread;
+	uint32_t                idx;
+
+	switch (newValue) {
+	case kIORegistryLinkTestPopulate:
+		if (!(plane = IORegistryLinkTestPlane())) {
+			return ENOMEM;
+		}
+		root = IORegistryLinkTestEntry(NULL, plane);
+		if (!root) {
+			return ENOMEM;
+		}
+		if (!OSCompareAndSwapPtr(NULL, root, (void * volatile *) &gIORegistryLinkTestRoot)) {
+			root->release();
+			return EBUSY;
+		}
+		// the parents first, then their children
+		idx = 0;
+		for (uint32_t p = 0; p < kIORegistryLinkTestParents; p++) {
+			gIORegistryLinkTestEntries[idx++] = IORegistryLinkTestEntry(root, plane);
+		}
+		for (uint32_t c = 0; c < kIORegistryLinkTestChildren; c++) {
+			for (uint32_t p = 0; p < kIORegistryLinkTestParents; p++) {
+				parent = gIORegistryLinkTestEntries[p];
+				gIORegistryLinkTestEntries[idx++] = parent ? IORegistryLinkTestEntry(parent, plane) : NULL;
+			}
+		}
+		for (idx = 0; idx < (sizeof(gIORegistryLinkTestEntries) / sizeof(gIORegistryLinkTestEntries[0])); idx++) {
+			if (!gIORegistryLinkTestEntries[idx]) {
+				return ENOMEM;
+			}
+		}
+		return 0;
+
+	case kIORegistryLinkTestRead:
+	case kIORegistryLinkTestReadLocked:
+		if (!gIORegistryLinkTestRoot) {
+			return ENOENT;
+		}
+		return IORegistryLinkTestRead(kIORegistryLinkTestReadLocked == newValue);
+
+	case kIORegistryLinkTestChurnStart:
+		if (!gIORegistryLinkTestRoot) {
+			return ENOENT;
+		}
+		if (!OSCompareAndSwap8(false, true, (volatile UInt8 *) &gIORegistryLinkTestChurnRunning)) {
+			return EBUSY;
+		}
+		gIORegistryLinkTestChurning = true;
+		if (KERN_SUCCESS != kernel_thread_start(&IORegistryLinkTestChurn, NULL, &thread)) {
+			gIORegistryLinkTestChurning = false;
+			gIORegistryLinkTestChurnRunning = false;
+			return ENOMEM;
+		}
+		thread_deallocate(thread);
+		return 0;
+
+	case kIORegistryLinkTestChurnStop:
+		gIORegistryLinkTestChurning = false;
+		while (gIORegistryLinkTestChurnRunning) {
+			IOSleep(1);
+		}
+		return 0;
+
+	case kIORegistryLinkTestDepopulate:
+		root = gIORegistryLinkTestRoot;
+		if (!root) {
+			return ENOENT;
+		}
+		// not meant to race with the other operations
+		gIORegistryLinkTestChurning = false;
+		while (gIORegistryLinkTestChurnRunning) {
+			IOSleep(1);
+		}
+		plane = gIORegistryLinkTestPlane;
+		root->detachAll(plane);
+		for (idx = 0; idx < (sizeof(gIORegistryLinkTestEntries) / sizeof(gIORegistryLinkTestEntries[0])); idx++) {
+			OSSafeReleaseNULL(gIORegistryLinkTestEntries[idx]);
+		}
+		gIORegistryLinkTestRoot = NULL;
+		root->release();
+		return 0;
+	}
+
+	return EINVAL;
+}
+
+// Checks what the lock-free plane link readers return as the links change.
+static int
+IORegistryLinkTest(__unused int newValue)
+{
+	const IORegistryPlane * plane;
+	IORegistryEntry *       root;
+	IORegistryEntry *       entries[3];
+	IORegistryEntry *       replacement;
+	OSIterator *            iter;
+
+	plane = IORegistryLinkTestPlane();
+	assert(plane);
+	root = IORegistryLinkTestEntry(NULL, plane);
+	assert(root);
+	for (uint32_t idx = 0; idx < 3; idx++) {
+		entries[idx] = IORegistryLinkTestEntry(root, plane);
+		assert(entries[idx]);
+	}
+	assert(!root->inPlane(plane));
+	assert(entries[0]->inPlane(plane) && entries[0]->inPlane(NULL));
+	assert(3 == root->getChildCount(plane));
+	assert(entries[0] == root->getChildEntry(plane));
+	assert(root == entries[1]->getParentEntry(plane));
+	assert(root->isChild(entries[1], plane) && !root->isChild(entries[1], plane, true));
+	assert(entries[1]->isParent(root, plane, true));
+	assert(2 == entries[2]->getDepth(plane));
+
+	// links keep the order they were made in
+	iter = root->getChildIterator(plane);
+	assert(iter);
+	for (uint32_t idx = 0; idx < 3; idx++) {
+		assert(entries[idx] == iter->getNextObject());
+	}
+	assert(!iter->getNextObject());
+	iter->release();
+
+	entries[1]->detachFromParent(root, plane);
+	assert(!entries[1]->inPlane(plane) && !entries[1]->getParentEntry(plane));
+	assert(2 == root->getChildCount(plane));
+	assert(!root->isChild(entries[1], plane));
+	iter = root->getChildIterator(plane);
+	assert(iter && (entries[0] == iter->getNextObject()) && (entries[2] == iter->getNextObject()));
+	assert(!iter->getNextObject());
+	iter->release();
+
+	// a second parent, a level further down
+	assert(entries[2]->attachToParent(entries[0], plane));
+	assert(3 == entries[2]->getDepth(plane));
+	assert(!entries[2]->isParent(root, plane, true));
+	assert(entries[2]->isParent(entries[0], plane));
+	iter = entries[2]->getParentIterator(plane);
+	assert(iter && (root == iter->getNextObject()) && (entries[0] == iter->getNextObject()));
+	iter->release();
+
+	// an entry that takes the place of another takes its links
+	replacement = new IORegistryEntry;
+	assert(replacement && replacement->init(entries[0], plane));
+	assert(!entries[0]->inPlane(plane) && !entries[0]->getChildCount(plane));
+	assert(root == replacement->getParentEntry(plane));
+	assert(entries[2] == replacement->getChildEntry(plane));
+	assert(entries[2]->isParent(replacement, plane) && !entries[2]->isParent(entries[0], plane));
+	assert(root->isChild(replacement, plane) && !root->isChild(entries[0], plane));
+
+	root->detachAll(plane);
+	assert(!root->getChildCount(plane) && !entries[2]->inPlane(plane) && !replacement->inPlane(plane));
+	replacement->release();
+	for (uint32_t idx = 0; idx < 3; idx++) {
+		entries[idx]->release();
+	}
+	root->release();
+
+	return KERN_SUCCESS;
+}
+
+// A wired buffer for tests/iodmacommand_segments_perf.c, the way a storage
+// driver keeps one around: kIODMACommandSegmentTestPopulate prepares
+// kIODMACommandSegmentTestSize of pageable memory through two descriptors,
+// one that keeps its segments once the unmapped walk has found them and one
+// first walked with gIOMemorySegmentCacheMax at 0, which finds them again on
+// every walk; kIODMACommandSegmentTestIO and kIODMACommandSegmentTestIOUncached
+// do kIODMACommandSegmentTestIOs I/Os of kIODMACommandSegmentTestIOSize
+// through an unmapped IODMACommand on one or the other, and
+// kIODMACommandSegmentTestDepopulate completes and frees them.
+#define kIODMACommandSegmentTestPopulate     7798
+#define kIODMACommandSegmentTestIO           7799
+#define kIODMACommandSegmentTestIOUncached   7800
+#define kIODMACommandSegmentTestDepopulate   7801
+#define kIODMACommandSegmentTestSize         (4 * 1024 * 1024)
+#define kIODMACommandSegmentTestIOSize       (128 * 1024)
+#define kIODMACommandSegmentTestIOs          10000
+
+extern uint32_t gIOMemorySegmentCacheMax;
+
+static IOBufferMemoryDescriptor * gIODMACommandSegmentTestBuffer;
+static IOMemoryDescriptor *       gIODMACommandSegmentTestUncached;
+
+static int
+IODMACommandSegmentTestIO(IOMemoryDescriptor * md)
+{
+	IODMACommand *          dma;
+	IODMACommand::Segment64 segments[32];
+	UInt32                  numSegments;
+	UInt64                  offset, dmaOffset;
+	IOReturn                ret;
+	IODMACommand::SegmentOptions segOptions =
+	{
+		.fStructSize      = sizeof(segOptions),
+		.fNumAddressBits  = 64,
+		.fMaxSegmentSize  = 0,
+		.fMaxTransferSize = kIODMACommandSegmentTestIOSize,
+		.fAlignment       = 1,
+		.fAlignmentLength = 1,
+		.fAlignmentInternalSegments = 1
+	};
+
+	dma = IODMACommand::withSpecification(kIODMACommandOutputHost64, &segOptions,
+	    kIODMAMapOptionUnmapped, NULL, NULL);
+	if (!dma) {
+		return ENOMEM;
+	}
+	ret = dma->setMemoryDescriptor(md, false);
+
+	for (uint32_t io = 0; (kIOReturnSuccess == ret) && (io < kIODMACommandSegmentTestIOs); io++) {
+		offset = (io * kIODMACommandSegmentTestIOSize) % kIODMACommandSegmentTestSize;
+		ret = dma->prepare(offset, kIODMACommandSegmentTestIOSize, false, false);
+		for (dmaOffset = 0; (kIOReturnSuccess == ret) && (dmaOffset < kIODMACommandSegmentTestIOSize);) {
+			numSegments = sizeof(segments) / sizeof(segments[0]);
+			ret = dma->gen64IOVMSegments(&dmaOffset, &segments[0], &numSegments);
+		}
+		if (kIOReturnSuccess == ret) {
+			ret = dma->complete(false, false);
+		}
+	}
+	dma->clearMemoryDescriptor(false);
+	dma->release();
+
+	return (kIOReturnSuccess == ret) ? 0 : EIO;
+}
+
+static int
+IODMACommandSegmentTest(int newValue)
+{
+	IOBufferMemoryDescriptor * bmd;
+	IOMemoryDescriptor *       md;
+	IOByteCount                length;
+	uint32_t                   cacheMax;
+
+	switch (newValue) {
+	case kIODMACommandSegmentTestPopulate:
+		bmd = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task,
+		    kIODirectionInOut | kIOMemoryPageable, kIODMACommandSegmentTestSize, page_size);
+		if (!bmd) {
+			return ENOMEM;
+		}
+		if (!OSCompareAndSwapPtr(NULL, bmd, (void * volatile *) &gIODMACommandSegmentTestBuffer)) {
+			bmd->release();
+			return EBUSY;
+		}
+		md = IOMemoryDescriptor::withAddressRange((mach_vm_address_t) bmd->getBytesNoCopy(),
+		    kIODMACommandSegmentTestSize, kIODirectionInOut, kernel_task);
+		if (!md) {
+			return ENOMEM;
+		}
+		gIODMACommandSegmentTestUncached = md;
+		if ((kIOReturnSuccess != bmd->prepare()) || (kIOReturnSuccess != md->prepare())) {
+			return ENOMEM;
+		}
+		bmd->getPhysicalSegment(0, &length, kIOMemoryMapperNone);
+		// anything else walked in between keeps no segments either, which
+		// only costs it the time this test measures
+		cacheMax = gIOMemorySegmentCacheMax;
+		gIOMemorySegmentCacheMax = 0;
+		md->getPhysicalSegment(0, &length, kIOMemoryMapperNone);
+		gIOMemorySegmentCacheMax = cacheMax;
+		return 0;
+
+	case kIODMACommandSegmentTestIO:
+	case kIODMACommandSegmentTestIOUncached:
+		if (!gIODMACommandSegmentTestUncached) {
+			return ENOENT;
+		}
+		return IODMACommandSegmentTestIO((kIODMACommandSegmentTestIO == newValue)
+		           ? (IOMemoryDescriptor *) gIODMACommandSegmentTestBuffer : gIODMACommandSegmentTestUncached);
+
+	case kIODMACommandSegmentTestDepopulate:
+		bmd = gIODMACommandSegmentTestBuffer;
+		if (!bmd) {
+			return ENOENT;
+		}
+		// not meant to race with the other operations, and free()
+		// completes what is still prepared
+		OSSafeReleaseNULL(gIODMACommandSegmentTestUncached);
+		gIODMACommandSegmentTestBuffer = NULL;
+		bmd->release();
+		return 0;
+	}
+
+	return EINVAL;
+}
+
+// A simulated power tree for tests/iopm_tree_wake_perf.c to time wake against
+// tree shape: kIOPMTreeTestPopulateWide, kIOPMTreeTestPopulateDeep and
+// kIOPMTreeTestPopulateBalanced put kIOPMTreeTestNodes services with an off
+// and an on power state under the root domain, as one parent of all the
+// others, a single chain or a binary tree, and bring them all up. Every
+// setPowerState() spins kIOPMTreeTestSetPowerStateUS, like a driver polling
+// its hardware. kIOPMTreeTestSleep and kIOPMTreeTestWake ask every node for
+// its off or on state and return once they are all there;
+// kIOPMTreeTestWakeThreadCall wakes with gIOPMCalloutThreadLimit at 0, so that
+// every callout goes to its thread call as it used to.
+// kIOPMTreeTestDepopulate checks the power change time report of the top node
+// against the changes it saw and takes the tree apart.
+#define kIOPMTreeTestPopulateWide       7802
+#define kIOPMTreeTestPopulateDeep       7803
+#define kIOPMTreeTestPopulateBalanced   7804
+#define kIOPMTreeTestSleep              7805
+#define kIOPMTreeTestWake               7806
+#define kIOPMTreeTestWakeThreadCall     7807
+#define kIOPMTreeTestDepopulate         7808
+#define kIOPMTreeTestNodes              255
+#define kIOPMTreeTestSetPowerStateUS    500
+#define kIOPMTreeTestTimeoutS           30
+#define kIOPMTreeTestReportBuckets      32
+
+extern uint32_t gIOPMCalloutThreadLimit;
+
+static IOPMPowerState gIOPMTreeTestPowerStates[2] =
+{
+	{   .version                = kIOPMPowerStateVersion1,
+	    .capabilityFlags        = 0,
+	    .outputPowerCharacter   = 0,
+	    .inputPowerRequirement  = 0 },
+	{   .version                = kIOPMPowerStateVersion1,
+	    .capabilityFlags        = kIOPMPowerOn | kIOPMDeviceUsable,
+	    .outputPowerCharacter   = kIOPMPowerOn,
+	    .inputPowerRequirement  = kIOPMPowerOn },
+};
+
+class IOPMTreeTestNode : public IOService
+{
+	OSDeclareDefaultStructors(IOPMTreeTestNode);
+public:
+	uint32_t fChanges;
+
+	virtual IOReturn setPowerState(unsigned long powerStateOrdinal,
+	    IOService * whatDevice) APPLE_KEXT_OVERRIDE;
+	virtual void powerChangeDone(unsigned long stateNumber) APPLE_KEXT_OVERRIDE;
+};
+
+OSDefineMetaClassAndStructors(IOPMTreeTestNode, IOService);
+
+static IOLock *        gIOPMTreeTestLock;
+static OSArray *       gIOPMTreeTestNodes;
+static unsigned long   gIOPMTreeTestState;
+static uint32_t        gIOPMTreeTestPending;
+
+IOReturn
+IOPMTreeTestNode::setPowerState(__unused unsigned long powerStateOrdinal,
+    __unused IOService * whatDevice)
+{
+	IODelay(kIOPMTreeTestSetPowerStateUS);
+	return IOPMAckImplied;
+}
+
+void
+IOPMTreeTestNode::powerChangeDone(unsigned long stateNumber)
+{
+	IOLockLock(gIOPMTreeTestLock);
+	fChanges++;
+	if ((getPowerState() == gIOPMTreeTestState) && (stateNumber != gIOPMTreeTestState)
+	    && gIOPMTreeTestPending && !--gIOPMTreeTestPending) {
+		IOLockWakeup(gIOPMTreeTestLock, &gIOPMTreeTestPending, false);
+	}
+	IOLockUnlock(gIOPMTreeTestLock);
+}
+
+static int
+IOPMTreeTestSetState(OSArray * nodes, unsigned long state)
+{
+	IOPMTreeTestNode * node;
+	uint64_t           deadline;
+	int                result = 0;
+
+	IOLockLock(gIOPMTreeTestLock);
+	gIOPMTreeTestState = state;
+	gIOPMTreeTestPending = 0;
+	for (unsigned int idx = 0; (node = (IOPMTreeTestNode *) nodes->getObject(idx)); idx++) {
+		if (node->getPowerState() != state) {
+			gIOPMTreeTestPending++;
+		}
+	}
+	IOLockUnlock(gIOPMTreeTestLock);
+
+	for (unsigned int idx = 0; (node = (IOPMTreeTestNode *) nodes->getObject(idx)); idx++) {
+		node->changePowerStateTo(state);
+	}
+
+	clock_interval_to_deadline(kIOPMTreeTestTimeoutS, kSecondScale, &deadline);
+	IOLockLock(gIOPMTreeTestLock);
+	while (gIOPMTreeTestPending) {
+		if (THREAD_TIMED_OUT == IOLockSleepDeadline(gIOPMTreeTestLock, &gIOPMTreeTestPending,
+		    deadline, THREAD_UNINT)) {
+			result = ETIMEDOUT;
+			break;
+		}
+	}
+	IOLockUnlock(gIOPMTreeTestLock);
+
+	return result;
+}
+
+static void
+IOPMTreeTestChannel(IOReportChannelList * list)
+{
+	list->nchannels = 1;
+	list->channels[0].channel_id = kPMChangeTimeChID;
+	bzero(&list->channels[0].channel_type, sizeof(list->channels[0].channel_type));
+}
+
+// Enables or disables the kPMChangeTimeChID report of node.
+static IOReturn
+IOPMTreeTestConfigureReport(IOService * node, IOReportConfigureAction action)
+{
+	uint64_t              listBuf[(sizeof(IOReportChannelList) + sizeof(IOReportChannel)) / sizeof(uint64_t) + 1];
+	IOReportChannelList * list = (IOReportChannelList *) &listBuf[0];
+	int                   nelements = 0;
+
+	IOPMTreeTestChannel(list);
+	return node->configureReport(list, action, &nelements, NULL);
+}
+
+// The number of power changes the kPMChangeTimeChID report of node has tallied.
+static IOReturn
+IOPMTreeTestReportHits(IOService * node, uint64_t * hits)
+{
+	uint64_t                   listBuf[(sizeof(IOReportChannelList) + sizeof(IOReportChannel)) / sizeof(uint64_t) + 1];
+	IOReportChannelList *      list = (IOReportChannelList *) &listBuf[0];
+	IOBufferMemoryDescriptor * dest;
+	IOReportElement *          elem;
+	IOReturn                   ret;
+	int                        nelements = 0;
+
+	IOPMTreeTestChannel(list);
+	dest = IOBufferMemoryDescriptor::withCapacity(kIOPMTreeTestReportBuckets * sizeof(IOReportElement), kIODirectionOut);
+	if (!dest) {
+		return kIOReturnNoMemory;
+	}
+	ret = node->updateReport(list, kIOReportCopyChannelData, &nelements, dest);
+	if ((kIOReturnSuccess == ret) && (kIOPMTreeTestReportBuckets != nelements)) {
+		ret = kIOReturnInternalError;
+	}
+	*hits = 0;
+	elem = (IOReportElement *) dest->getBytesNoCopy();
+	for (int idx = 0; (kIOReturnSuccess == ret) && (idx < nelements); idx++) {
+		*hits += ((IOHistogramReportValues *) &elem[idx].values)->bucket_hits;
+	}
+	dest->release();
+
+	return ret;
+}
+
+static int
+IOPMTreeTestPopulate(int newValue)
+{
+	IOPMTreeTestNode * node;
+	IOService *        parent;
+	OSArray *          nodes;
+	char               name[32];
+	int                result;
+
+	nodes = OSArray::withCapacity(kIOPMTreeTestNodes);
+	if (!nodes) {
+		return ENOMEM;
+	}
+	if (!OSCompareAndSwapPtr(NULL, nodes, (void * volatile *) &gIOPMTreeTestNodes)) {
+		nodes->release();
+		return EBUSY;
+	}
+	if (!gIOPMTreeTestLock) {
+		gIOPMTreeTestLock = IOLockAlloc();
+	}
+
+	for (uint32_t idx = 0; idx < kIOPMTreeTestNodes; idx++) {
+		node = OSTypeAlloc(IOPMTreeTestNode);
+		if (!node || !node->init()) {
+			OSSafeReleaseNULL(node);
+			return ENOMEM;
+		}
+		snprintf(name, sizeof(name), "IOPMTreeTest%u", idx);
+		node->setName(name);
+		node->PMinit();
+		if (!idx) {
+			parent = getPMRootDomain();
+		} else if (kIOPMTreeTestPopulateWide == newValue) {
+			parent = (IOService *) nodes->getObject(0);
+		} else if (kIOPMTreeTestPopulateDeep == newValue) {
+			parent = (IOService *) nodes->getObject(idx - 1);
+		} else {
+			parent = (IOService *) nodes->getObject((idx - 1) / 2);
+		}
+		nodes->setObject(node);
+		node->release();
+		parent->addPowerChild(node);
+		node->registerPowerDriver(node, gIOPMTreeTestPowerStates, 2);
+	}
+
+	result = IOPMTreeTestSetState(nodes, 1);
+	if (result) {
+		return result;
+	}
+
+	node = (IOPMTreeTestNode *) nodes->getObject(0);
+	IOLockLock(gIOPMTreeTestLock);
+	node->fChanges = 0;
+	IOLockUnlock(gIOPMTreeTestLock);
+	return (kIOReturnSuccess == IOPMTreeTestConfigureReport(node, kIOReportEnable)) ? 0 : EIO;
+}
+
+static int
+IOPMTreeTest(int newValue)
+{
+	IOPMTreeTestNode * node;
+	OSArray *          nodes;
+	uint64_t           hits;
+	uint32_t           calloutThreadLimit;
+	int                result;
+
+	switch (newValue) {
+	case kIOPMTreeTestPopulateWide:
+	case kIOPMTreeTestPopulateDeep:
+	case kIOPMTreeTestPopulateBalanced:
+		return IOPMTreeTestPopulate(newValue);
+
+	case kIOPMTreeTestSleep:
+	case kIOPMTreeTestWake:
+		nodes = gIOPMTreeTestNodes;
+		if (!nodes) {
+			return ENOENT;
+		}
+		return IOPMTreeTestSetState(nodes, (kIOPMTreeTestWake == newValue) ? 1 : 0);
+
+	case kIOPMTreeTestWakeThreadCall:
+		nodes = gIOPMTreeTestNodes;
+		if (!nodes) {
+			return ENOENT;
+		}
+		// anything else that powers up in between doesn't get the PM
+		// callout threads either
+		calloutThreadLimit = gIOPMCalloutThreadLimit;
+		gIOPMCalloutThreadLimit = 0;
+		result = IOPMTreeTestSetState(nodes, 1);
+		gIOPMCalloutThreadLimit = calloutThreadLimit;
+		return result;
+
+	case kIOPMTreeTestDepopulate:
+		nodes = gIOPMTreeTestNodes;
+		if (!nodes) {
+			return ENOENT;
+		}
+		// not meant to race with the other operations
+		result = 0;
+		node = (IOPMTreeTestNode *) nodes->getObject(0);
+		if (node) {
+			if ((kIOReturnSuccess != IOPMTreeTestReportHits(node, &hits))
+			    || (hits != node->fChanges)) {
+				result = EIO;
+			}
+			IOPMTreeTestConfigureReport(node, kIOReportDisable);
+		}
+		// children first
+		for (unsigned int idx = nodes->getCount(); idx > 0; idx--) {
+			((IOService *) nodes->getObject(idx - 1))->PMstop();
+		}
+		gIOPMTreeTestNodes = NULL;
+		nodes->release();
+		return result;
+	}
+
+	return EINVAL;
+}
+
+// A synthetic catalogue for tests/iocatalogue_matching_perf.c:
+// kIOCatalogueMatchTestPopulate adds kIOCatalogueMatchTestCount personalities
+// for IOCatalogueMatchTestNub, one in eight of them without IONameMatch, and
+// makes an unregistered nub; kIOCatalogueMatchTestFind looks up the drivers for
+// that nub once, the way registering it would; kIOCatalogueMatchTestDepopulate
+// removes them all again.
+#define kIOCatalogueMatchTestPopulate   7779
+#define kIOCatalogueMatchTestFind       7780
+#define kIOCatalogueMatchTestDepopulate 7781
+#define kIOCatalogueMatchTestCount      4000
+
+class IOCatalogueMatchTestNub : public IOService
+{
+	OSDeclareDefaultStructors(IOCatalogueMatchTestNub);
+};
+
+OSDefineMetaClassAndStructors(IOCatalogueMatchTestNub, IOService);
+
+static IOService * gIOCatalogueMatchTestNub;
+
+static int
+IOCatalogueMatchTest(int newValue)
+{
+	OSOrderedSet *   set;
+	OSDictionary *   dict;
+	OSArray *        array;
+	const OSSymbol * sym;
+	OSNumber *       score;
+	IOService *      nub;
+	SInt32           generation;
+	char             name[64];
+	bool             ok;
+
+	if (kIOCatalogueMatchTestFind == newValue) {
+		nub = gIOCatalogueMatchTestNub;
+		if (!nub) {
+			return ENOENT;
+		}
+		set = gIOCatalogue->findDrivers(nub, &generation);
+		if (!set) {
+			return ENOMEM;
+		}
+		set->release();
+		return 0;
+	}
+
+	if (kIOCatalogueMatchTestDepopulate == newValue) {
+		do {
+			nub = gIOCatalogueMatchTestNub;
+			if (!nub) {
+				return ENOENT;
+			}
+		} while (!OSCompareAndSwapPtr(nub, NULL, (void * volatile *) &gIOCatalogueMatchTestNub));
+		dict = OSDictionary::withCapacity(1);
+		if (dict) {
+			dict->setObject(gIOProviderClassKey, nub->getMetaClass()->getClassNameSymbol());
+			gIOCatalogue->removeDrivers(dict, false);
+			dict->release();
+		}
+		nub->release();
+		return 0;
+	}
+
+	nub = OSTypeAlloc(IOCatalogueMatchTestNub);
+	if (!nub || !nub->init()) {
+		OSSafeReleaseNULL(nub);
+		return ENOMEM;
+	}
+	nub->setName("IOCatalogueMatchTest0");
+	array = OSArray::withCapacity(kIOCatalogueMatchTestCount);
+	if (!array) {
+		nub->release();
+		return ENOMEM;
+	}
+	for (uint32_t idx = 0; idx < kIOCatalogueMatchTestCount; idx++) {
+		dict = OSDictionary::withCapacity(4);
+		if (!dict) {
+			break;
+		}
+		dict->setObject(gIOProviderClassKey, nub->getMetaClass()->getClassNameSymbol());
+		dict->setObject(kIOClassKey, gIOServiceKey);
+		if (idx % 8) {
+			snprintf(name, sizeof(name), "IOCatalogueMatchTest%u", idx);
+			sym = OSSymbol::withCString(name);
+			dict->setObject(gIONameMatchKey, sym);
+			OSSafeReleaseNULL(sym);
+		}
+		score = OSNumber::withNumber((idx * 7919) % 1000, 32);
+		dict->setObject(kIOProbeScoreKey, score);
+		OSSafeReleaseNULL(score);
+		array->setObject(dict);
+		dict->release();
+	}
+	ok = (array->getCount() == kIOCatalogueMatchTestCount)
+	    && OSCompareAndSwapPtr(NULL, nub, (void * volatile *) &gIOCatalogueMatchTestNub);
+	if (ok) {
+		ok = gIOCatalogue->addDrivers(array, false);
+	} else {
+		nub->release();
+	}
+	array->release();
+
+	return ok ? 0 : EBUSY;
+}
+
+// A service for tests/ioconnect_batch_perf.c to compare io_connect_method()
+// against io_connect_method_batch(): its user client has one method, which
+// adds two scalars. kIOUserClientBatchTestPublish publishes it as
+// IOUserClientBatchTest and kIOUserClientBatchTestTerminate terminates it.
+#define kIOUserClientBatchTestPublish   7782
+#define kIOUserClientBatchTestTerminate 7783
+
+class IOUserClientBatchTestClient : public IOUserClient
+{
+	OSDeclareDefaultStructors(IOUserClientBatchTestClient);
+public:
+	virtual IOReturn clientClose(void) APPLE_KEXT_OVERRIDE;
+	virtual IOReturn externalMethod(uint32_t selector,
+	    IOExternalMethodArguments * arguments,
+	    IOExternalMethodDispatch * dispatch,
+	    OSObject * target,
+	    void * reference) APPLE_KEXT_OVERRIDE;
+};
+
+OSDefineMetaClassAndStructors(IOUserClientBatchTestClient, IOUserClient);
+
+static IOReturn
+IOUserClientBatchTestAdd(__unused OSObject * target, __unused void * reference,
+    IOExternalMethodArguments * arguments)
+{
+	arguments->scalarOutput[0] = arguments->scalarInput[0] + arguments->scalarInput[1];
+	return kIOReturnSuccess;
+}
+
+static const IOExternalMethodDispatch gIOUserClientBatchTestMethods[] = {
+	{ &IOUserClientBatchTestAdd, 2, 0, 1, 0 },
+};
+
+IOReturn
+IOUserClientBatchTestClient::clientClose(void)
+{
+	terminate();
+	return kIOReturnSuccess;
+}
+
+IOReturn
+IOUserClientBatchTestClient::externalMethod(uint32_t selector,
+    IOExternalMethodArguments * arguments,
+    __unused IOExternalMethodDispatch * dispatch,
+    __unused OSObject * target,
+    __unused void * reference)
+{
+	if (selector >= sizeof(gIOUserClientBatchTestMethods) / sizeof(gIOUserClientBatchTestMethods[0])) {
+		return kIOReturnBadArgument;
+	}
+	return IOUserClient::externalMethod(selector, arguments,
+	           (IOExternalMethodDispatch *) &gIOUserClientBatchTestMethods[selector], this, NULL);
+}
+
+static IOService * gIOUserClientBatchTestService;
+
+static int
+IOUserClientBatchTest(int newValue)
+{
+	IOService * service;
+
+	if (kIOUserClientBatchTestTerminate == newValue) {
+		do {
+			service = gIOUserClientBatchTestService;
+			if (!service) {
+				return ENOENT;
+			}
+		} while (!OSCompareAndSwapPtr(service, NULL, (void * volatile *) &gIOUserClientBatchTestService));
+		service->terminate(kIOServiceSynchronous);
+		service->release();
+		return 0;
+	}
+
+	service = new IOService;
+	if (!service || !service->init()) {
+		OSSafeReleaseNULL(service);
+		return ENOMEM;
+	}
+	if (!OSCompareAndSwapPtr(NULL, service, (void * volatile *) &gIOUserClientBatchTestService)) {
+		service->release();
+		return EBUSY;
+	}
+	service->setName("IOUserClientBatchTest");
+	service->setProperty(kIOUserClientClassKey, "IOUserClientBatchTestClient");
+	service->attach(IOService::getPlatform());
+	service->registerService(kIOServiceSynchronous);
+
+	return 0;
+}
+
 static void
 OSStaticPtrCastTests()
 {
@@ -710,6 +1993,41 @@ sysctl_iokittest(__unused struct sysctl_oid *oidp, __unused void *arg1, __unused
 	}
 
 
+	if (changed && ((kIORegistryMatchTestPopulate == newValue)
+	    || (kIORegistryMatchTestDepopulate == newValue))) {
+		return IORegistryMatchTest(newValue);
+	}
+
+	if (changed && (newValue >= kIOCatalogueMatchTestPopulate)
+	    && (newValue <= kIOCatalogueMatchTestDepopulate)) {
+		return IOCatalogueMatchTest(newValue);
+	}
+
+	if (changed && ((kIOUserClientBatchTestPublish == newValue)
+	    || (kIOUserClientBatchTestTerminate == newValue))) {
+		return IOUserClientBatchTest(newValue);
+	}
+
+	if (changed && (newValue >= kOSUnserializeXMLTestPopulate)
+	    && (newValue <= kOSUnserializeXMLTestDepopulate)) {
+		return OSUnserializeXMLPerfTest(newValue);
+	}
+
+	if (changed && (newValue >= kIORegistryLinkTestPopulate)
+	    && (newValue <= kIORegistryLinkTestDepopulate)) {
+		return IORegistryLinkTestPerf(newValue);
+	}
+
+	if (changed && (newValue >= kIODMACommandSegmentTestPopulate)
+	    && (newValue <= kIODMACommandSegmentTestDepopulate)) {
+		return IODMACommandSegmentTest(newValue);
+	}
+
+	if (changed && (newValue >= kIOPMTreeTestPopulateWide)
+	    && (newValue <= kIOPMTreeTestDepopulate)) {
+		return IOPMTreeTest(newValue);
+	}
+
 	if (changed && newValue) {
 		error = IOWorkLoopTest(newValue);
 		assert(KERN_SUCCESS == error);
@@ -731,6 +2049,12 @@ sysctl_iokittest(__unused struct sysctl_oid *oidp, __unused void *arg1, __unused
 		assert(KERN_SUCCESS == error);
 		error = IOSharedDataQueue_44636964(newValue);
 		assert(KERN_SUCCESS == error);
+		error = IOSharedDataQueueBatchTest(newValue);
+		assert(KERN_SUCCESS == error);
+		error = OSUnserializeXMLTest(newValue);
+		assert(KERN_SUCCESS == error);
+		error = IORegistryLinkTest(newValue);
+		assert(KERN_SUCCESS == error);
 	}
 #endif  /* DEVELOPMENT || DEBUG */
 
@@ -741,3 +2065,45 @@ SYSCTL_PROC(_kern, OID_AUTO, iokittest,
     CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_KERN | CTLFLAG_LOCKED,
     NULL, 0, sysctl_iokittest, "I", "");
 #endif // __clang_analyzer__
+
+#if DEVELOPMENT || DEBUG
+// Takes an XML document as its new value and returns whether OSUnserializeXML()
+// made an object of it, or fails with EILSEQ when OSUnserializeXMLReference()
+// doesn't agree. tests/osunserialize_xml_fuzz.c feeds it.
+#define kOSUnserializeXMLTestMaxSize        (1024 * 1024)
+
+static int
+sysctl_iokittest_unserialize_xml(__unused struct sysctl_oid *oidp, __unused void *arg1, __unused int arg2, struct sysctl_req *req)
+{
+	char * xml;
+	size_t size;
+	bool   parsed;
+	int    result, error;
+
+	if (!req->newptr || (req->newlen > kOSUnserializeXMLTestMaxSize)) {
+		return EINVAL;
+	}
+	size = req->newlen + 1;
+	xml = (typeof(xml))IOMalloc(size);
+	if (!xml) {
+		return ENOMEM;
+	}
+	error = SYSCTL_IN(req, xml, req->newlen);
+	if (!error) {
+		xml[req->newlen] = 0;
+		if (OSUnserializeXMLMatchesReference(xml, &parsed)) {
+			result = parsed;
+			error = SYSCTL_OUT(req, &result, sizeof(result));
+		} else {
+			error = EILSEQ;
+		}
+	}
+	IOFree(xml, size);
+
+	return error;
+}
+
+SYSCTL_PROC(_kern, OID_AUTO, iokittest_unserialize_xml,
+    CTLTYPE_OPAQUE | CTLFLAG_RW | CTLFLAG_KERN | CTLFLAG_LOCKED,
+    NULL, 0, sysctl_iokittest_unserialize_xml, "S", "");
+#endif  /* DEVELOPMENT || DEBUG */
@@ -485,7 +485,7 @@ OSUnserializeBinary(const char *buffer, size_t bufferSize, OSString **errorStrin
 			if (0 != ((const char *)next)[len - 1]) {
 				break;
 			}
-			o = (OSObject *) OSSymbol::withCString((const char *) next);
+			o = (OSObject *) OSSymbol::withCStringOfLength((const char *) next, len - 1);
 			next += wordLen;
 			break;
 
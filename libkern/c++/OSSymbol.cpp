@@ -105,6 +105,33 @@ private:
 		*hashP = hash;
 	}
 
+public:
+	// Same hash as hashSymbol(), for a string whose length is already known,
+	// a word at a time when it is word aligned.
+	static inline unsigned int
+	hashSymbolOfLength(const char *s, unsigned int len)
+	{
+		unsigned int hash = 0;
+		unsigned int idx  = 0;
+
+#if __LITTLE_ENDIAN__
+		if (!(3 & (uintptr_t) s)) {
+			const uint32_t * words = (const uint32_t *) s;
+
+			for (; idx + 4 <= len; idx += 4) {
+				hash ^= *words++;
+			}
+		}
+#endif /* __LITTLE_ENDIAN__ */
+		for (; idx < len; idx++) {
+			hash ^= ((unsigned int)(unsigned char) s[idx]) << (8 * (idx & 3));
+		}
+
+		return hash;
+	}
+
+private:
+
 	static unsigned long log2(unsigned int x);
 	static unsigned long exp2ml(unsigned long x);
 
@@ -150,7 +177,9 @@ public:
 	}
 
 	OSSharedPtr<OSSymbol> findSymbol(const char *cString) const;
+	OSSharedPtr<OSSymbol> findSymbol(const char *cString, unsigned int hash, unsigned int inLen) const;
 	OSSharedPtr<OSSymbol> insertSymbol(OSSymbol *sym);
+	OSSharedPtr<OSSymbol> insertSymbol(OSSymbol *sym, unsigned int hash);
 	void removeSymbol(OSSymbol *sym);
 
 	OSSymbolPoolState initHashState();
@@ -312,13 +341,21 @@ OSSymbolPool::reconstructSymbols(bool grow)
 
 OSSharedPtr<OSSymbol>
 OSSymbolPool::findSymbol(const char *cString) const
+{
+	unsigned int inLen, hash;
+
+	hashSymbol(cString, &hash, &inLen); inLen++;
+	return findSymbol(cString, hash, inLen);
+}
+
+OSSharedPtr<OSSymbol>
+OSSymbolPool::findSymbol(const char *cString, unsigned int hash, unsigned int inLen) const
 {
 	Bucket *thisBucket;
-	unsigned int j, inLen, hash;
+	unsigned int j;
 	OSSymbol *probeSymbol, **list;
 	OSSharedPtr<OSSymbol> ret;
 
-	hashSymbol(cString, &hash, &inLen); inLen++;
 	thisBucket = &buckets[hash % nBuckets];
 	j = thisBucket->count;
 
@@ -330,7 +367,7 @@ OSSymbolPool::findSymbol(const char *cString) const
 		probeSymbol = (OSSymbol *) thisBucket->symbolP;
 
 		if (inLen == probeSymbol->length
-		    && strncmp(probeSymbol->string, cString, probeSymbol->length) == 0
+		    && strncmp(probeSymbol->string, cString, inLen - 1) == 0
 		    && probeSymbol->taggedTryRetain(nullptr)) {
 			ret.reset(probeSymbol, OSNoRetain);
 			return ret;
@@ -341,7 +378,7 @@ OSSymbolPool::findSymbol(const char *cString) const
 	for (list = thisBucket->symbolP; j--; list++) {
 		probeSymbol = *list;
 		if (inLen == probeSymbol->length
-		    && strncmp(probeSymbol->string, cString, probeSymbol->length) == 0
+		    && strncmp(probeSymbol->string, cString, inLen - 1) == 0
 		    && probeSymbol->taggedTryRetain(nullptr)) {
 			ret.reset(probeSymbol, OSNoRetain);
 			return ret;
@@ -353,14 +390,23 @@ OSSymbolPool::findSymbol(const char *cString) const
 
 OSSharedPtr<OSSymbol>
 OSSymbolPool::insertSymbol(OSSymbol *sym)
+{
+	unsigned int inLen, hash;
+
+	hashSymbol(sym->string, &hash, &inLen);
+	return insertSymbol(sym, hash);
+}
+
+OSSharedPtr<OSSymbol>
+OSSymbolPool::insertSymbol(OSSymbol *sym, unsigned int hash)
 {
 	const char *cString = sym->string;
+	const unsigned int inLen = sym->length;
 	Bucket *thisBucket;
-	unsigned int j, inLen, hash;
+	unsigned int j;
 	OSSymbol *probeSymbol, **list;
 	OSSharedPtr<OSSymbol> ret;
 
-	hashSymbol(cString, &hash, &inLen); inLen++;
 	thisBucket = &buckets[hash % nBuckets];
 	j = thisBucket->count;
 
@@ -632,6 +678,44 @@ OSSymbol::withCStringNoCopy(const char *cString)
 	return os::move(newSymb); // return the newly created & inserted symbol.
 }
 
+OSSharedPtr<const OSSymbol>
+OSSymbol::withCStringOfLength(const char *cString, size_t length)
+{
+	OSSharedPtr<OSSymbol> symbol;
+	OSSharedPtr<OSSymbol> newSymb;
+	unsigned int          len, hash;
+
+	// The symbol for a string with a NUL in it ends at the NUL, like withCString()
+	len = (unsigned int) strnlen(cString, length);
+	hash = OSSymbolPool::hashSymbolOfLength(cString, len);
+
+	pool->closeReadGate();
+	symbol = pool->findSymbol(cString, hash, len + 1);
+	pool->openReadGate();
+	if (symbol) {
+		return os::move(symbol);
+	}
+
+	newSymb = OSMakeShared<OSSymbol>();
+	if (!newSymb) {
+		return os::move(newSymb);
+	}
+
+	if (newSymb->OSString::initWithStringOfLength(cString, len)) {
+		pool->closeWriteGate();
+		symbol = pool->insertSymbol(newSymb.get(), hash);
+		pool->openWriteGate();
+
+		if (symbol) {
+			// Somebody must have inserted the new symbol so free our copy
+			newSymb.detach()->OSString::free();
+			return os::move(symbol);
+		}
+	}
+
+	return os::move(newSymb); // return the newly created & inserted symbol.
+}
+
 OSSharedPtr<const OSSymbol>
 OSSymbol::existingSymbolForString(const OSString *aString)
 {
@@ -34,18 +34,18 @@
 
 // parser for unserializing OSContainer objects serialized to XML
 //
-// to build :
-//	bison -p OSUnserializeXML OSUnserializeXML.y
-//	head -50 OSUnserializeXML.y > OSUnserializeXML.cpp
-//	sed -e "s/#include <stdio.h>//" < OSUnserializeXML.tab.c >> OSUnserializeXML.cpp
-//
-//	when changing code check in both OSUnserializeXML.y and OSUnserializeXML.cpp
-//
-//
+// This is the bison parser OSUnserializeXML() used to be, kept on DEVELOPMENT
+// and DEBUG kernels as OSUnserializeXMLReference() for checking the one in
+// OSUnserializeXML.cpp against.
 //
+// to build :
+//	bison -p OSUnserializeXML OSUnserializeXMLReference.y
+//	head -50 OSUnserializeXMLReference.y > OSUnserializeXMLReference.cpp
+//	sed -e "s/#include <stdio.h>//" < OSUnserializeXMLReference.tab.c >> OSUnserializeXMLReference.cpp
 //
+//	when changing code check in both OSUnserializeXMLReference.y and OSUnserializeXMLReference.cpp
 //
-//		 DO NOT EDIT OSUnserializeXML.cpp!
+//		 DO NOT EDIT OSUnserializeXMLReference.cpp!
 //
 //			this means you!
 //
@@ -59,6 +59,8 @@
 %pure_parser
 
 %{
+#if DEVELOPMENT || DEBUG
+
 #include <string.h>
 #include <libkern/c++/OSMetaClass.h>
 #include <libkern/c++/OSContainers.h>
@@ -1371,7 +1373,7 @@ buildBoolean(parser_state_t *state __unused, object_t *o)
 };
 
 OSObject*
-OSUnserializeXML(const char *buffer, OSString **errorString)
+OSUnserializeXMLReference(const char *buffer, OSString **errorString)
 {
 	OSObject *object;
 
@@ -1410,38 +1412,14 @@ OSUnserializeXML(const char *buffer, OSString **errorString)
 	return object;
 }
 
-#include <libkern/OSSerializeBinary.h>
-
-OSObject*
-OSUnserializeXML(const char *buffer, size_t bufferSize, OSString **errorString)
-{
-	if (!buffer) {
-		return 0;
-	}
-	if (bufferSize < sizeof(kOSSerializeBinarySignature)) {
-		return 0;
-	}
-
-	if (!strcmp(kOSSerializeBinarySignature, buffer)
-	    || (kOSSerializeIndexedBinarySignature == (uint8_t)buffer[0])) {
-		return OSUnserializeBinary(buffer, bufferSize, errorString);
-	}
-
-	// XML must be null terminated
-	if (buffer[bufferSize - 1]) {
-		return 0;
-	}
-
-	return OSUnserializeXML(buffer, errorString);
-}
-
+#endif /* DEVELOPMENT || DEBUG */
 
 //
 //
 //
 //
 //
-//		 DO NOT EDIT OSUnserializeXML.cpp!
+//		 DO NOT EDIT OSUnserializeXMLReference.cpp!
 //
 //			this means you!
 //
@@ -414,6 +414,11 @@ public:
 		const void *  array,
 		unsigned int  arrayCount,
 		size_t        memberSize);
+
+/* Like withCString(), for a string of known length that need not be nul terminated. */
+	static OSPtr<const OSSymbol> withCStringOfLength(
+		const char *  cString,
+		size_t        length);
 #endif /* XNU_KERNEL_PRIVATE */
 
 	OSMetaClassDeclareReservedUnused(OSSymbol, 0);
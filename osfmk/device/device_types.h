@@ -75,7 +75,7 @@
 #endif
 
 #if PRIVATE
-#define IOKIT_SERVER_VERSION    20190926
+#define IOKIT_SERVER_VERSION    20201120
 #endif
 
 
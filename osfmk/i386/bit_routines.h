@@ -88,6 +88,19 @@
 								:	\
 			"r" (bit), "m" (*(volatile int *)(l)));
 
+static inline int	bit_lock_try(int bit, volatile void * l)
+{
+	uint8_t	was_set;
+	__asm__ volatile (
+		"	lock		\n\t"
+		"	btsl	%2,%1	\n\t"
+		"	setc	%0"
+		: "=qm" (was_set), "+m" (*(volatile int *)l)
+		: "r" (bit)
+		: "memory");
+	return !was_set;
+}
+
 /*
  *      Set or clear individual bits in a long word.
  *      The locked access is needed only to lock access
@@ -82,6 +82,10 @@ extern void             memset_word(
 	int              pattern,
 	int              nwords);
 
+extern void             bzero_nt(
+	void             *addr,
+	size_t           length);
+
 
 /* Move arbitrarily-aligned data from one physical address to another */
 extern void bcopy_phys(addr64_t from, addr64_t to, vm_size_t nbytes);
@@ -298,6 +298,7 @@ extern int      kernPhysPML4EntryCount;
 #define INTEL_PTE_SWLOCK        (0x1ULL << 52)
 #define INTEL_PDPTE_NESTED      (0x1ULL << 53)
 #define INTEL_PTE_WIRED         (0x1ULL << 54)
+#define INTEL_PDE_PROMOTED      (0x1ULL << 55)  /* PS PDE built by pmap_promote() */
 /* TODO: Compressed markers, potential conflict with protection keys? */
 #define INTEL_PTE_COMPRESSED_ALT (1ULL << 61) /* compressed but with "alternate accounting" */
 #define INTEL_PTE_COMPRESSED    (1ULL << 62) /* marker, for invalid PTE only -- ignored by hardware for both regular/EPT entries*/
@@ -564,6 +565,7 @@ struct pmap {
 	ledger_t        ledger;         /* ledger tracking phys mappings */
 	struct pmap_statistics  stats;  /* map statistics */
 	uint64_t        corrected_compressed_ptes_count;
+	int             pm_promoted;    /* PDEs built by pmap_promote() */
 #if MACH_ASSERT
 	boolean_t       pmap_stats_assert;
 	int             pmap_pid;
@@ -723,6 +725,14 @@ extern ppnum_t pmap_find_phys_nofault(pmap_t pmap, addr64_t va);
 
 extern kern_return_t pmap_get_prot(pmap_t pmap, addr64_t va, vm_prot_t *protp);
 
+/*
+ * Transparent superpages: map a fully populated, physically contiguous
+ * 2MB run of base pages with a single PDE.
+ */
+extern kern_return_t pmap_promote(pmap_t pmap, vm_map_offset_t va);
+extern uint64_t pmap_promote_count;
+extern uint64_t pmap_demote_count;
+
 extern void pmap_cpu_init(void);
 extern void pmap_disable_NX(pmap_t pmap);
 
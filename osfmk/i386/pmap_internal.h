@@ -82,6 +82,8 @@ PMAP_UNLOCK_SHARED(pmap_t p)
 }
 
 #define iswired(pte)    ((pte) & INTEL_PTE_WIRED)
+#define ispromoted(pde) (((pde) & (INTEL_PTE_PS | INTEL_PDE_PROMOTED)) == \
+	                 (INTEL_PTE_PS | INTEL_PDE_PROMOTED))
 
 #ifdef  PMAP_TRACES
 extern  boolean_t       pmap_trace;
@@ -109,6 +111,17 @@ void            phys_attribute_set(
 	ppnum_t         phys,
 	int             bits);
 
+void            pmap_promote_init(
+	ppnum_t         npages);
+
+void            pmap_promoted_purge(
+	pmap_t          pmap);
+
+void            pmap_demote(
+	pmap_t          pmap,
+	vm_map_offset_t vaddr,
+	pd_entry_t      *pdep);
+
 void            pmap_set_reference(
 	ppnum_t pn);
 
@@ -419,6 +432,7 @@ pmap_pv_throttle(__unused pmap_t p)
 
 #define pai_to_pvh(pai)         (&pv_head_table[pai])
 #define lock_pvh_pai(pai)       bit_lock(pai, (void *)pv_lock_table)
+#define lock_pvh_pai_try(pai)   bit_lock_try(pai, (void *)pv_lock_table)
 #define unlock_pvh_pai(pai)     bit_unlock(pai, (void *)pv_lock_table)
 #define pvhash(idx)             (&pv_hash_table[idx])
 #define lock_hash_hash(hash)    bit_lock(hash, (void *)pv_hash_lock_table)
@@ -1276,6 +1290,25 @@ pmap_pte(pmap_t pmap, vm_map_offset_t vaddr)
 	}
 }
 
+/*
+ * Like pmap_pte(), but first breaks a promoted 2MB mapping (see
+ * pmap_promote()) back into base pages, so the caller always gets a
+ * level 1 entry for a promoted range.  The caller must hold the pmap
+ * lock, or the PV lock of a page mapped at vaddr.
+ */
+static inline pt_entry_t *
+pmap_pte_demote(pmap_t pmap, vm_map_offset_t vaddr)
+{
+	pt_entry_t      *ptep;
+
+	ptep = pmap_pte(pmap, vaddr);
+	if (__improbable(ptep != PT_ENTRY_NULL && ispromoted(*ptep))) {
+		pmap_demote(pmap, vaddr, ptep);
+		ptep = pmap_pte(pmap, vaddr);
+	}
+	return ptep;
+}
+
 extern void     pmap_alias(
 	vm_offset_t     ava,
 	vm_map_offset_t start,
@@ -521,7 +521,7 @@ pmap_update_cache_attributes_locked(ppnum_t pn, unsigned attributes)
 		do {
 			pmap = pv_e->pmap;
 			vaddr = PVE_VA(pv_e);
-			ptep = pmap_pte(pmap, vaddr);
+			ptep = pmap_pte_demote(pmap, vaddr);
 
 			if (0 == ptep) {
 				panic("pmap_update_cache_attributes_locked: Missing PTE, pmap: %p, pn: 0x%x vaddr: 0x%llx kernel_pmap: %p", pmap, pn, vaddr, kernel_pmap);
@@ -608,6 +608,343 @@ PTE_LOCK_UNLOCK(pt_entry_t *lpte)
 	__c11_atomic_fetch_and((_Atomic pt_entry_t *)lpte, ~PTE_LOCK(0), memory_order_release_smp);
 }
 
+/*
+ * Transparent superpages.
+ *
+ * pmap_promote() replaces the page table under an aligned 2MB range of a
+ * user pmap with a single PS PDE, once all 512 PTEs map one physically
+ * contiguous, 2MB-aligned run with the same attributes and none of the
+ * pages has another mapping.  The PDE carries INTEL_PDE_PROMOTED, which
+ * tells it apart from a VM_FLAGS_SUPERPAGE_SIZE_2MB mapping.  The pv
+ * entries of the 512 pages are left as they are, and the page table page
+ * stays in pm_obj, with stale contents, until the range is demoted.
+ *
+ * Code that looks at or changes a single base page in a range that may
+ * be promoted goes through pmap_pte_demote(), which rebuilds the page
+ * table from the PDE and puts it back.  Demotion can run with nothing but
+ * a PV lock held, so it cannot allocate or look the page table page up
+ * in pm_obj: pmap_promote() records it in pmap_promoted_table, keyed by
+ * the kernel address of the PDE.
+ *
+ * Promotion holds the pmap lock exclusively and the PV locks of all the
+ * pages, which keeps out every path that could demote.  Concurrent
+ * demotions of the same PDE serialize on its INTEL_PTE_SWLOCK bit.
+ */
+
+struct pmap_promoted {
+	pd_entry_t      *pp_pde;        /* NULL if the slot is free */
+	pmap_t          pp_pmap;
+	ppnum_t         pp_ptpn;        /* page table page */
+};
+
+static struct pmap_promoted *pmap_promoted_table;
+static uint32_t pmap_promoted_mask;
+decl_simple_lock_data(static, pmap_promoted_lock);
+
+uint64_t pmap_promote_count;
+uint64_t pmap_demote_count;
+
+void
+pmap_promote_init(ppnum_t npages)
+{
+	vm_offset_t     addr;
+	vm_size_t       size;
+	uint32_t        slots;
+
+	/*
+	 * Each promoted PDE maps 2MB of managed memory that nothing else
+	 * maps, so there are never more than npages / NPTEPG of them; size
+	 * the table for a load factor of at most 1/2.
+	 */
+	slots = 1024;
+	while (slots < 2 * (npages / NPTEPG)) {
+		slots <<= 1;
+	}
+	size = round_page(slots * sizeof(struct pmap_promoted));
+	if (kernel_memory_allocate(kernel_map, &addr, size, 0,
+	    KMA_KOBJECT | KMA_PERMANENT | KMA_ZERO, VM_KERN_MEMORY_PMAP)
+	    != KERN_SUCCESS) {
+		panic("pmap_promote_init");
+	}
+	pmap_promoted_table = (struct pmap_promoted *)addr;
+	pmap_promoted_mask = slots - 1;
+	simple_lock_init(&pmap_promoted_lock, 0);
+}
+
+static inline uint32_t
+pmap_promoted_hash(pd_entry_t *pdep)
+{
+	return (uint32_t)((((uintptr_t)pdep >> 3) * 0x9E3779B97F4A7C15ULL) >> 32) &
+	       pmap_promoted_mask;
+}
+
+static boolean_t
+pmap_promoted_insert(pmap_t pmap, pd_entry_t *pdep, ppnum_t ptpn)
+{
+	struct pmap_promoted *pp;
+	uint32_t        i, n;
+
+	simple_lock(&pmap_promoted_lock, LCK_GRP_NULL);
+	for (i = pmap_promoted_hash(pdep), n = 0; n <= pmap_promoted_mask;
+	    i = (i + 1) & pmap_promoted_mask, n++) {
+		pp = &pmap_promoted_table[i];
+		if (pp->pp_pde == NULL) {
+			pp->pp_pde = pdep;
+			pp->pp_pmap = pmap;
+			pp->pp_ptpn = ptpn;
+			simple_unlock(&pmap_promoted_lock);
+			return TRUE;
+		}
+	}
+	simple_unlock(&pmap_promoted_lock);
+	return FALSE;
+}
+
+/*
+ * Free slot i, moving later entries of its probe sequence back so that
+ * lookups never stop early at the hole.  Called with pmap_promoted_lock
+ * held.
+ */
+static void
+pmap_promoted_remove_slot(uint32_t i)
+{
+	uint32_t        j, home;
+
+	for (j = (i + 1) & pmap_promoted_mask;
+	    pmap_promoted_table[j].pp_pde != NULL;
+	    j = (j + 1) & pmap_promoted_mask) {
+		home = pmap_promoted_hash(pmap_promoted_table[j].pp_pde);
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+			/* reachable from its home slot without crossing i */
+			continue;
+		}
+		pmap_promoted_table[i] = pmap_promoted_table[j];
+		i = j;
+	}
+	pmap_promoted_table[i].pp_pde = NULL;
+}
+
+static ppnum_t
+pmap_promoted_remove(pd_entry_t *pdep)
+{
+	uint32_t        i, n;
+	ppnum_t         ptpn;
+
+	simple_lock(&pmap_promoted_lock, LCK_GRP_NULL);
+	for (i = pmap_promoted_hash(pdep), n = 0; n <= pmap_promoted_mask;
+	    i = (i + 1) & pmap_promoted_mask, n++) {
+		if (pmap_promoted_table[i].pp_pde == pdep) {
+			ptpn = pmap_promoted_table[i].pp_ptpn;
+			pmap_promoted_remove_slot(i);
+			simple_unlock(&pmap_promoted_lock);
+			return ptpn;
+		}
+		if (pmap_promoted_table[i].pp_pde == NULL) {
+			break;
+		}
+	}
+	panic("pmap_promoted_remove: no page table for promoted PDE %p (0x%llx)",
+	    pdep, *pdep);
+}
+
+/*
+ * Drop the records of a pmap being destroyed that still has promoted
+ * PDEs.  vm_map_destroy() removes every mapping first, so this only
+ * matters for pmaps torn down by other means.
+ */
+void
+pmap_promoted_purge(pmap_t pmap)
+{
+	uint32_t        i;
+
+	simple_lock(&pmap_promoted_lock, LCK_GRP_NULL);
+	for (i = 0; i <= pmap_promoted_mask && pmap->pm_promoted > 0;) {
+		if (pmap_promoted_table[i].pp_pde != NULL &&
+		    pmap_promoted_table[i].pp_pmap == pmap) {
+			/* the slot may be refilled from further along */
+			pmap_promoted_remove_slot(i);
+			OSAddAtomic(-1, &pmap->pm_promoted);
+		} else {
+			i++;
+		}
+	}
+	simple_unlock(&pmap_promoted_lock);
+}
+
+/*
+ *	Routine:	pmap_promote
+ *	Function:
+ *		Map the aligned 2MB range containing vaddr with a single
+ *		PDE, if its page table qualifies (see above).
+ *		Returns KERN_ABORTED if the range may qualify later, e.g.
+ *		because some of it is not mapped yet or has different
+ *		permissions, and KERN_FAILURE if it cannot.
+ */
+kern_return_t
+pmap_promote(pmap_t pmap, vm_map_offset_t vaddr)
+{
+	vm_map_offset_t base;
+	pdpt_entry_t    *pdptp;
+	pd_entry_t      *pdep;
+	pt_entry_t      *ptp;
+	pt_entry_t      template, pte;
+	ppnum_t         ptpn, pn;
+	pv_rooted_entry_t pv_h;
+	int             pai, i, locked;
+	kern_return_t   kr;
+
+	if (pmap == kernel_pmap || is_ept_pmap(pmap)) {
+		return KERN_INVALID_ARGUMENT;
+	}
+	base = vaddr & ~(PDE_MAPPED_SIZE - 1);
+	pn = 0;
+	locked = 0;
+	kr = KERN_FAILURE;
+
+	PMAP_LOCK_EXCLUSIVE(pmap);
+
+	pdptp = pmap64_pdpt(pmap, base);
+	if (pdptp == NULL || (*pdptp & INTEL_PDPTE_NESTED)) {
+		goto out;
+	}
+	pdep = pmap_pde(pmap, base);
+	if (pdep == PD_ENTRY_NULL || !(*pdep & INTEL_PTE_VALID) ||
+	    (*pdep & INTEL_PTE_PS)) {
+		goto out;
+	}
+	ptpn = (ppnum_t)i386_btop(pte_to_pa(*pdep));
+	ptp = (pt_entry_t *)PHYSMAP_PTOV(i386_ptob(ptpn));
+
+	template = ptp[0] & ~(INTEL_PTE_REF | INTEL_PTE_MOD);
+	if ((pte_to_pa(template) & (PDE_MAPPED_SIZE - 1)) != 0 ||
+	    (template & (INTEL_PTE_PAT | INTEL_PTE_GLOBAL))) {
+		goto out;
+	}
+	for (i = 0; i < NPTEPG; i++, pte_increment_pa(template)) {
+		pte = ptp[i];
+		if (!(pte & INTEL_PTE_VALID) ||
+		    iswired(pte) ||
+		    (pte & ~(INTEL_PTE_REF | INTEL_PTE_MOD)) != template) {
+			if ((pte & INTEL_PTE_VALID) &&
+			    pte_to_pa(pte) != pte_to_pa(template)) {
+				/* not one contiguous run */
+				kr = KERN_FAILURE;
+			} else {
+				/* not all faulted in yet, or permissions differ */
+				kr = KERN_ABORTED;
+			}
+			goto out;
+		}
+	}
+
+	/*
+	 * Lock the PV lists of the run.  PV locks are normally taken
+	 * before the pmap lock, so only try: a busy page means someone is
+	 * working on it anyway.
+	 */
+	pn = (ppnum_t)i386_btop(pte_to_pa(ptp[0]));
+	for (locked = 0; locked < NPTEPG; locked++) {
+		pai = ppn_to_pai(pn + locked);
+		if (!IS_MANAGED_PAGE(pai)) {
+			kr = KERN_FAILURE;
+			goto out;
+		}
+		if (!lock_pvh_pai_try(pai)) {
+			kr = KERN_ABORTED;
+			goto out;
+		}
+		pv_h = pai_to_pvh(pai);
+		if (pv_h->pmap != pmap ||
+		    PVE_VA(pv_h) != base + i386_ptob(locked) ||
+		    !queue_empty(&pv_h->qlink)) {
+			/* also mapped elsewhere */
+			locked++;
+			kr = KERN_ABORTED;
+			goto out;
+		}
+	}
+
+	if (!pmap_promoted_insert(pmap, pdep, ptpn)) {
+		kr = KERN_RESOURCE_SHORTAGE;
+		goto out;
+	}
+
+	/*
+	 * Switch over in one store.  The old and new translations agree on
+	 * the frames and attributes of every base page, so the processor
+	 * may use either until the flush.  Ref/mod bits start out clear in
+	 * the PDE; the ones gathered so far are kept in the physical
+	 * attributes, collected after the flush so that none set in the
+	 * meantime get lost.
+	 */
+	template = ptp[0] & ~(INTEL_PTE_REF | INTEL_PTE_MOD);
+	pmap_store_pte(pdep, template | INTEL_PTE_PS | INTEL_PDE_PROMOTED);
+	OSAddAtomic(1, &pmap->pm_promoted);
+	PMAP_UPDATE_TLBS(pmap, base, base + PDE_MAPPED_SIZE);
+
+	for (i = 0; i < NPTEPG; i++) {
+		pmap_phys_attributes[ppn_to_pai(pn + i)] |=
+		    (char)(ptp[i] & (PHYS_MODIFIED | PHYS_REFERENCED));
+	}
+	OSAddAtomic64(1, &pmap_promote_count);
+	kr = KERN_SUCCESS;
+
+out:
+	while (locked > 0) {
+		locked--;
+		unlock_pvh_pai(ppn_to_pai(pn + locked));
+	}
+	PMAP_UNLOCK_EXCLUSIVE(pmap);
+
+	return kr;
+}
+
+/*
+ *	Routine:	pmap_demote
+ *	Function:
+ *		Put back the page table of the promoted range containing
+ *		vaddr, whose PDE is at pdep.  Each base page gets the
+ *		permissions and ref/mod bits of the PDE.
+ *		Call through pmap_pte_demote().
+ */
+void
+pmap_demote(pmap_t pmap, vm_map_offset_t vaddr, pd_entry_t *pdep)
+{
+	vm_map_offset_t base;
+	pd_entry_t      opde, npde;
+	pt_entry_t      *ptp, template;
+	ppnum_t         ptpn;
+	int             i;
+
+	PTE_LOCK_LOCK(pdep);
+	if (!ispromoted(*pdep)) {
+		/* someone else demoted it while we waited */
+		PTE_LOCK_UNLOCK(pdep);
+		return;
+	}
+
+	ptpn = pmap_promoted_remove(pdep);
+	ptp = (pt_entry_t *)PHYSMAP_PTOV(i386_ptob(ptpn));
+	npde = pa_to_pte(i386_ptob(ptpn)) | INTEL_PTE_VALID | INTEL_PTE_USER |
+	    INTEL_PTE_WRITE;
+
+	do {
+		/* the processor may still set ref/mod in the PDE */
+		opde = *pdep;
+		template = opde & ~(INTEL_PTE_PS | INTEL_PDE_PROMOTED |
+		    INTEL_PTE_SWLOCK);
+		for (i = 0; i < NPTEPG; i++, pte_increment_pa(template)) {
+			pmap_store_pte(&ptp[i], template);
+		}
+	} while (!pmap_cmpx_pte(pdep, opde, npde));
+
+	OSAddAtomic(-1, &pmap->pm_promoted);
+	OSAddAtomic64(1, &pmap_demote_count);
+
+	base = vaddr & ~(PDE_MAPPED_SIZE - 1);
+	PMAP_UPDATE_TLBS(pmap, base, base + PDE_MAPPED_SIZE);
+}
+
 kern_return_t
 pmap_enter_options_addr(
 	pmap_t pmap,
@@ -718,7 +1055,7 @@ Retry:
 			PMAP_LOCK_SHARED(pmap);
 		}
 	} else {
-		while ((pte = pmap_pte(pmap, vaddr)) == PT_ENTRY_NULL) {
+		while ((pte = pmap_pte_demote(pmap, vaddr)) == PT_ENTRY_NULL) {
 			/*
 			 * Must unlock to expand the pmap
 			 * going to grow pde level page(s)
@@ -1696,6 +2033,10 @@ pmap_remove_options(
 		pde = pmap_pde(map, s64);
 
 		if (pde && (*pde & PTE_VALID_MASK(is_ept))) {
+			if (ispromoted(*pde)) {
+				/* the base pages each have a pv entry to remove */
+				pmap_demote(map, s64, pde);
+			}
 			if (*pde & PTE_PS) {
 				/*
 				 * If we're removing a superpage, pmap_remove_range()
@@ -1830,7 +2171,7 @@ pmap_page_protect_options(
 		pmap = pv_e->pmap;
 		is_ept = is_ept_pmap(pmap);
 		vaddr = PVE_VA(pv_e);
-		pte = pmap_pte(pmap, vaddr);
+		pte = pmap_pte_demote(pmap, vaddr);
 
 		pmap_assert2((pa_index(pte_to_pa(*pte)) == pn),
 		    "pmap_page_protect: PTE mismatch, pn: 0x%x, pmap: %p, vaddr: 0x%llx, pte: 0x%llx", pn, pmap, vaddr, *pte);
@@ -2148,7 +2489,7 @@ phys_attribute_clear(
 			pte_bits = 0;
 
 			if (bits) {
-				pte = pmap_pte(pmap, va);
+				pte = pmap_pte_demote(pmap, va);
 				/* grab ref/mod bits from this PTE */
 				pte_bits = (*pte & (PTE_REF(is_ept) | PTE_MOD(is_ept)));
 				/* propagate to page's global attributes */
@@ -2394,7 +2735,7 @@ pmap_change_wiring(
 
 	PMAP_LOCK_SHARED(map);
 
-	if ((pte = pmap_pte(map, vaddr)) == PT_ENTRY_NULL) {
+	if ((pte = pmap_pte_demote(map, vaddr)) == PT_ENTRY_NULL) {
 		panic("pmap_change_wiring(%p,0x%llx,%d): pte missing",
 		    map, vaddr, wired);
 	}
@@ -2574,7 +2915,10 @@ pmap_query_resident(
 		pde = pmap_pde(pmap, s64);
 
 		if (pde && (*pde & PTE_VALID_MASK(is_ept))) {
-			if (*pde & PTE_PS) {
+			if (ispromoted(*pde)) {
+				/* every base page is mapped */
+				resident_bytes += l64 - s64;
+			} else if (*pde & PTE_PS) {
 				/* superpage: not supported */
 			} else {
 				spte = pmap_pte(pmap,
@@ -2645,7 +2989,7 @@ pmap_query_page_info(
 	pde = pmap_pde(pmap, va);
 	if (!pde ||
 	    !(*pde & PTE_VALID_MASK(is_ept)) ||
-	    (*pde & PTE_PS)) {
+	    ((*pde & PTE_PS) && !ispromoted(*pde))) {
 		goto done;
 	}
 
@@ -2655,6 +2999,10 @@ pmap_query_page_info(
 	}
 
 	pa = pte_to_pa(*pte);
+	if (ispromoted(*pde)) {
+		/* no need to demote just to look */
+		pa += va & (PDE_MAPPED_SIZE - 1) & ~PAGE_MASK;
+	}
 	if (pa == 0) {
 		if (PTE_IS_COMPRESSED(*pte, pte, pmap, va)) {
 			disp |= PMAP_QUERY_PAGE_COMPRESSED;
@@ -208,6 +208,8 @@ struct i_resource_coalition {
 	uint64_t cpu_time_rqos[COALITION_NUM_THREAD_QOS_TYPES];      /* cpu time per requested QoS class */
 	uint64_t cpu_instructions;
 	uint64_t cpu_cycles;
+	uint64_t workingset_refaults_file;
+	uint64_t workingset_refaults_anon;
 
 	uint64_t task_count;      /* tasks that have started in this coalition */
 	uint64_t dead_task_count; /* tasks that have exited in this coalition;
@@ -655,6 +657,8 @@ i_coal_resource_remove_task(coalition_t coal, task_t task)
 #if CONFIG_PHYS_WRITE_ACCT
 		cr->fs_metadata_writes += task->task_fs_metadata_writes;
 #endif /* CONFIG_PHYS_WRITE_ACCT */
+		cr->workingset_refaults_file += task->task_workingset_refaults_file;
+		cr->workingset_refaults_anon += task->task_workingset_refaults_anon;
 		cr->cpu_ptime += task_cpu_ptime(task);
 		task_update_cpu_time_qos_stats(task, cr->cpu_time_eqos, cr->cpu_time_rqos);
 #if MONOTONIC
@@ -770,6 +774,8 @@ coalition_resource_usage_internal(coalition_t coal, struct coalition_resource_us
 	memcpy(cpu_time_rqos, coal->r.cpu_time_rqos, sizeof(cpu_time_rqos));
 	uint64_t cpu_instructions = coal->r.cpu_instructions;
 	uint64_t cpu_cycles = coal->r.cpu_cycles;
+	uint64_t workingset_refaults_file = coal->r.workingset_refaults_file;
+	uint64_t workingset_refaults_anon = coal->r.workingset_refaults_anon;
 
 	/*
 	 * Add to that all the active tasks' ledgers. Tasks cannot deallocate
@@ -807,6 +813,8 @@ coalition_resource_usage_internal(coalition_t coal, struct coalition_resource_us
 #if CONFIG_PHYS_WRITE_ACCT
 		fs_metadata_writes += task->task_fs_metadata_writes;
 #endif /* CONFIG_PHYS_WRITE_ACCT */
+		workingset_refaults_file += task->task_workingset_refaults_file;
+		workingset_refaults_anon += task->task_workingset_refaults_anon;
 
 		cpu_ptime += task_cpu_ptime(task);
 		task_update_cpu_time_qos_stats(task, cpu_time_eqos, cpu_time_rqos);
@@ -897,6 +905,8 @@ coalition_resource_usage_internal(coalition_t coal, struct coalition_resource_us
 	memcpy(cru_out->cpu_time_eqos, cpu_time_eqos, sizeof(cru_out->cpu_time_eqos));
 	cru_out->cpu_cycles = cpu_cycles;
 	cru_out->cpu_instructions = cpu_instructions;
+	cru_out->workingset_refaults_file = workingset_refaults_file;
+	cru_out->workingset_refaults_anon = workingset_refaults_anon;
 	ledger_dereference(sum_ledger);
 	sum_ledger = LEDGER_NULL;
 
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+#include <kern/assert.h>
+#include <kern/clock.h>
+#include <kern/epoch.h>
+
+void
+epoch_init(struct epoch *ep)
+{
+	ep->e_epoch = 1;
+	ep->e_readers = zalloc_percpu_permanent_type(struct epoch_reader);
+}
+
+void
+epoch_synchronize(struct epoch *ep)
+{
+	uint64_t epoch, seen;
+
+	/* a section of ep on this CPU would never let us through */
+	assert(zpercpu_get(ep->e_readers)->er_depth == 0);
+
+	epoch = os_atomic_inc(&ep->e_epoch, seq_cst);
+	zpercpu_foreach(er, ep->e_readers) {
+		while ((seen = os_atomic_load(&er->er_epoch, acquire)) != 0 &&
+		    seen < epoch) {
+			delay(1);
+		}
+	}
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+#ifdef XNU_KERNEL_PRIVATE
+
+#ifndef _KERN_EPOCH_H_
+#define _KERN_EPOCH_H_
+
+#include <sys/cdefs.h>
+#include <stdint.h>
+#include <kern/cpu_data.h>
+#include <kern/cpu_number.h>
+#include <kern/zalloc.h>
+#include <machine/atomic.h>
+
+__BEGIN_DECLS
+
+/*!
+ * @file <kern/epoch.h>
+ *
+ * @brief
+ * Per-CPU epochs, for readers that walk shared state without a lock.
+ *
+ * @discussion
+ * A reader brackets its walk with @c epoch_enter() and @c epoch_exit(),
+ * which publish, in the reader's per-CPU slot, the epoch it started in.
+ * Preemption stays disabled in between, which bounds how long a writer
+ * can wait, so nothing in the section may block. Sections may nest, on
+ * the same epoch or on different ones; the outermost one is the one
+ * published. They may not be entered from interrupt context.
+ *
+ * A writer unlinks what it wants to free, calls @c epoch_synchronize(),
+ * and may then free it: every reader that could have seen it is gone.
+ */
+
+struct epoch_reader {
+	uint64_t                er_epoch;       /* epoch seen by the reader, or 0 */
+	uint32_t                er_depth;       /* nesting of the current section */
+};
+
+struct epoch {
+	uint64_t                e_epoch;
+	struct epoch_reader *__zpercpu e_readers;
+};
+
+/*!
+ * @function epoch_init
+ *
+ * @abstract
+ * Sets up an epoch, allocating its permanent per-CPU reader slots.
+ */
+extern void epoch_init(
+	struct epoch           *ep);
+
+/*!
+ * @function epoch_enter
+ *
+ * @abstract
+ * Enters a read-side section of @c ep.
+ */
+static inline void
+epoch_enter(struct epoch *ep)
+{
+	struct epoch_reader *er;
+
+	disable_preemption();
+	er = zpercpu_get(ep->e_readers);
+	if (er->er_depth++ == 0) {
+		os_atomic_store(&er->er_epoch,
+		    os_atomic_load(&ep->e_epoch, relaxed), relaxed);
+		os_atomic_thread_fence(seq_cst);
+	}
+}
+
+/*!
+ * @function epoch_exit
+ *
+ * @abstract
+ * Leaves a read-side section entered with @c epoch_enter().
+ */
+static inline void
+epoch_exit(struct epoch *ep)
+{
+	struct epoch_reader *er;
+
+	er = zpercpu_get(ep->e_readers);
+	if (--er->er_depth == 0) {
+		os_atomic_store(&er->er_epoch, 0, release);
+	}
+	enable_preemption();
+}
+
+/*!
+ * @function epoch_synchronize
+ *
+ * @abstract
+ * Waits until every reader of @c ep that may have seen state unlinked
+ * before this call has left its section.
+ *
+ * @discussion
+ * Spins, so it may be called with a mutex held, but not from inside
+ * a section of @c ep.
+ */
+extern void epoch_synchronize(
+	struct epoch           *ep);
+
+__END_DECLS
+
+#endif /* _KERN_EPOCH_H_ */
+
+#endif /* XNU_KERNEL_PRIVATE */
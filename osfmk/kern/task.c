@@ -1593,6 +1593,10 @@ task_create_internal(
 #if CONFIG_PHYS_WRITE_ACCT
 		new_task->task_fs_metadata_writes = 0;
 #endif /* CONFIG_PHYS_WRITE_ACCT */
+		new_task->task_workingset_refaults_file = 0;
+		new_task->task_workingset_refaults_anon = 0;
+		new_task->task_shadow_depth_max = 0;
+		new_task->task_deep_shadow_faults = 0;
 
 		new_task->task_energy = 0;
 #if MONOTONIC
@@ -1742,6 +1746,10 @@ task_rollup_accounting_info(task_t to_task, task_t from_task)
 #if CONFIG_PHYS_WRITE_ACCT
 	to_task->task_fs_metadata_writes = from_task->task_fs_metadata_writes;
 #endif /* CONFIG_PHYS_WRITE_ACCT */
+	to_task->task_workingset_refaults_file = from_task->task_workingset_refaults_file;
+	to_task->task_workingset_refaults_anon = from_task->task_workingset_refaults_anon;
+	to_task->task_shadow_depth_max = from_task->task_shadow_depth_max;
+	to_task->task_deep_shadow_faults = from_task->task_deep_shadow_faults;
 	to_task->task_energy = from_task->task_energy;
 
 	/* Skip ledger roll up for memory accounting entries */
@@ -5482,6 +5490,11 @@ task_info(
 			vm_info->decompressions = total;
 			*task_info_count = TASK_VM_INFO_REV5_COUNT;
 		}
+		if (original_task_info_count >= TASK_VM_INFO_REV6_COUNT) {
+			vm_info->shadow_depth_max = (integer_t)task->task_shadow_depth_max;
+			vm_info->deep_shadow_faults = (integer_t)task->task_deep_shadow_faults;
+			*task_info_count = TASK_VM_INFO_REV6_COUNT;
+		}
 
 		break;
 	}
@@ -482,6 +482,10 @@ struct task {
 #if CONFIG_PHYS_WRITE_ACCT
 	uint64_t        task_fs_metadata_writes;
 #endif /* CONFIG_PHYS_WRITE_ACCT */
+	uint64_t        task_workingset_refaults_file;  /* see vm_phantom_cache_update() */
+	uint64_t        task_workingset_refaults_anon;
+	uint32_t        task_shadow_depth_max;          /* see vm_object_collapser_fault() */
+	uint32_t        task_deep_shadow_faults;
 	uint32_t task_shared_region_slide;   /* cached here to avoid locking during telemetry */
 	uuid_t   task_shared_region_uuid;
 };
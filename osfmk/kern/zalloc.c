@@ -257,7 +257,7 @@ typedef struct zone_magazine {
  * - the Zone Allocator.
  *
  * The per-cpu and recirculation depot layer use magazines (@c zone_magazine_t),
- * which are stacks of up to @c zc_mag_size() elements.
+ * which are stacks of up to @c zc_mag_size() elements (see @c z_mag_fill).
  *
  * <h2>CPU layer</h2>
  *
@@ -308,7 +308,18 @@ typedef struct zone_magazine {
  * might grow into using its local depot.
  *
  * Note that @c zc_depot_max assume that the (a) and (f) pre-loaded magazines
- * on average contain @c zc_mag_size() elements.
+ * on average contain @c z_mag_fill elements.
+ *
+ * Magazines can hold up to @c zc_mag_size() elements, but the per-cpu layer
+ * only fills them with @c z_mag_fill elements before it moves them to the
+ * depots, which starts at @c zc_mag_fill_min. When a zone keeps contending
+ * even after its per-cpu depots were allowed to grow (more than
+ * @c zc_mag_grow_threshold contentions per second for two periods),
+ * @c compute_zone_working_set_size() doubles its magazine fill so that each
+ * trip to the recirculation depot moves more elements, and it lowers it back
+ * one element at a time once the zone is quiet again. The magazines in the
+ * depots are then of mixed sizes, which is why every magazine carries its
+ * own @c zm_cur.
  *
  * When a per-cpu layer cannot hold more full magazines in its depot,
  * then it will overflow about 1/3 of its depot into the recirculation depot
@@ -584,6 +595,16 @@ static TUNABLE(uint32_t, zp_scale, "zp-scale", 4);
  * zc_mag_size():
  *   size of magazines, larger to reduce contention at the expense of memory
  *
+ * zc_mag_fill_min
+ *   number of elements zones fill their magazines with at first,
+ *   and at least (see z_mag_fill).
+ *
+ * zc_mag_grow_threshold
+ *   number of contentions per second after which a zone doubles
+ *   the number of elements it fills its magazines with.
+ *
+ *   0 to disable.
+ *
  * zc_auto_enable_threshold
  *   number of contentions per second after which zone caching engages
  *   automatically.
@@ -607,13 +628,22 @@ static TUNABLE(uint32_t, zp_scale, "zp-scale", 4);
  * zc_free_batch_size
  *   The size of batches of frees/reclaim that can be done keeping
  *   the zone lock held (and preemption disabled).
+ *
+ * zone_gc_trim_budget_us
+ *   how long a trimming zone GC runs for before leaving the remaining
+ *   zones to the next one.
+ *
+ *   0 to trim all zones every time.
  */
-static TUNABLE(uint16_t, zc_magazine_size, "zc_mag_size()", 8);
+static TUNABLE(uint16_t, zc_magazine_size, "zc_mag_size()", 16);
+static TUNABLE(uint16_t, zc_mag_fill_min, "zc_mag_fill_min", 8);
+static TUNABLE(uint32_t, zc_mag_grow_threshold, "zc_mag_grow_threshold", 32);
 static TUNABLE(uint32_t, zc_auto_threshold, "zc_auto_enable_threshold", 20);
 static TUNABLE(uint32_t, zc_grow_threshold, "zc_grow_threshold", 8);
 static TUNABLE(uint32_t, zc_recirc_denom, "zc_recirc_denom", 3);
 static TUNABLE(uint32_t, zc_defrag_ratio, "zc_defrag_ratio", 50);
 static TUNABLE(uint32_t, zc_free_batch_size, "zc_free_batch_size", 1024);
+static TUNABLE(uint32_t, zone_gc_trim_budget_us, "zone_gc_trim_budget_us", 10000);
 
 static SECURITY_READ_ONLY_LATE(uintptr_t) zp_canary;
 /*
@@ -2493,6 +2523,12 @@ zc_mag_size(void)
 	return zc_magazine_size;
 }
 
+static inline uint16_t
+zone_mag_fill(zone_t zone)
+{
+	return zone->z_mag_fill;
+}
+
 __attribute__((noinline, cold))
 static void
 zone_lock_was_contended(zone_t zone, zone_cache_t zc)
@@ -2509,6 +2545,7 @@ zone_lock_was_contended(zone_t zone, zone_cache_t zc)
 	}
 
 	zone->z_contention_cur++;
+	zone->z_contentions++;
 
 	if (zc == NULL || zc->zc_depot_max >= INT16_MAX * zc_mag_size()) {
 		return;
@@ -2562,9 +2599,22 @@ zone_unlock_nopreempt(zone_t zone)
 }
 
 static inline void
-zone_depot_lock_nopreempt(zone_cache_t zc)
+zone_depot_lock_nopreempt(zone_t zone, zone_cache_t zc)
 {
-	hw_lock_bit_nopreempt(&zc->zc_depot_lock, 0, &zone_locks_grp);
+	/*
+	 * Only the zone GC takes the depot lock of another CPU,
+	 * count when it gets in the way.
+	 *
+	 * hw_lock_bit_try() disables preemption once more when it succeeds,
+	 * and leaves it as it was when it fails.
+	 */
+	if (__improbable(!hw_lock_bit_try(&zc->zc_depot_lock, 0,
+	    &zone_locks_grp))) {
+		os_atomic_inc(&zone->z_depot_contentions, relaxed);
+		hw_lock_bit_nopreempt(&zc->zc_depot_lock, 0, &zone_locks_grp);
+	} else {
+		enable_preemption();
+	}
 }
 
 static inline void
@@ -5239,6 +5289,8 @@ zfree_cached_slow(zone_t zone, struct zone_page_metadata *meta,
 {
 	struct zone_depot mags = STAILQ_HEAD_INITIALIZER(mags);
 	zone_magazine_t mag = NULL;
+	uint16_t fill = zone_mag_fill(zone);
+	uint32_t n_elems = 0;
 	uint16_t n = 0;
 
 	if (zone_meta_is_free(meta, ze)) {
@@ -5265,12 +5317,12 @@ zfree_cached_slow(zone_t zone, struct zone_page_metadata *meta,
 	    &cache->zc_free_elems, mag);
 
 	z_debug_assert(cache->zc_free_cur <= 1);
-	z_debug_assert(mag->zm_cur == zc_mag_size());
+	z_debug_assert(mag->zm_cur != 0 && mag->zm_cur <= zc_mag_size());
 
 	STAILQ_INSERT_HEAD(&mags, mag, zm_link);
 	n = 1;
 
-	if (cache->zc_depot_max >= 2 * zc_mag_size()) {
+	if (cache->zc_depot_max >= 2 * fill) {
 		/*
 		 * If we can use the local depot (zc_depot_max allows for
 		 * 2 magazines worth of elements) then:
@@ -5282,16 +5334,15 @@ zfree_cached_slow(zone_t zone, struct zone_page_metadata *meta,
 		 *    of the depot out, in order to migrate it to the
 		 *    recirculation depot.
 		 */
-		zone_depot_lock_nopreempt(cache);
+		zone_depot_lock_nopreempt(zone, cache);
 
-		if ((cache->zc_depot_cur + 2) * zc_mag_size() <=
-		    cache->zc_depot_max) {
+		if ((cache->zc_depot_cur + 2) * fill <= cache->zc_depot_max) {
 			cache->zc_depot_cur++;
 			STAILQ_INSERT_TAIL(&cache->zc_depot, mag, zm_link);
 			return zone_depot_unlock(cache);
 		}
 
-		while (zc_recirc_denom * cache->zc_depot_cur * zc_mag_size() >=
+		while (zc_recirc_denom * cache->zc_depot_cur * fill >=
 		    (zc_recirc_denom - 1) * cache->zc_depot_max) {
 			mag = STAILQ_FIRST(&cache->zc_depot);
 			STAILQ_REMOVE_HEAD(&cache->zc_depot, zm_link);
@@ -5310,15 +5361,16 @@ zfree_cached_slow(zone_t zone, struct zone_page_metadata *meta,
 	 * metadata, and then insert them into the recirculation depot.
 	 */
 	STAILQ_FOREACH(mag, &mags, zm_link) {
-		for (uint16_t i = 0; i < zc_mag_size(); i++) {
+		for (uint16_t i = 0; i < mag->zm_cur; i++) {
 			zone_element_validate(zone, mag->zm_elems[i]);
 		}
+		n_elems += mag->zm_cur;
 	}
 
 	zone_lock_check_contention(zone, cache);
 
 	STAILQ_FOREACH(mag, &mags, zm_link) {
-		for (uint16_t i = 0; i < zc_mag_size(); i++) {
+		for (uint16_t i = 0; i < mag->zm_cur; i++) {
 			zone_element_t e = mag->zm_elems[i];
 
 			if (!zone_meta_mark_free(zone_meta_from_element(e), e)) {
@@ -5329,7 +5381,7 @@ zfree_cached_slow(zone_t zone, struct zone_page_metadata *meta,
 	STAILQ_CONCAT(&zone->z_recirc, &mags);
 	zone->z_recirc_cur += n;
 
-	zone_elems_free_add(zone, n * zc_mag_size());
+	zone_elems_free_add(zone, n_elems);
 
 	zone_unlock(zone);
 }
@@ -5338,9 +5390,10 @@ static void
 zfree_cached(zone_t zone, struct zone_page_metadata *meta, zone_element_t ze)
 {
 	zone_cache_t cache = zpercpu_get(zone->z_pcpu_cache);
+	uint16_t fill = zone_mag_fill(zone);
 
-	if (cache->zc_free_cur >= zc_mag_size()) {
-		if (cache->zc_alloc_cur >= zc_mag_size()) {
+	if (cache->zc_free_cur >= fill) {
+		if (cache->zc_alloc_cur >= fill) {
 			return zfree_cached_slow(zone, meta, ze, cache);
 		}
 		zone_cache_swap_magazines(cache);
@@ -5848,7 +5901,7 @@ zalloc_cached_from_depot(zone_t zone, zone_stats_t zstats, zalloc_flags_t flags,
 	mag = zone_magazine_replace(&cache->zc_alloc_cur,
 	    &cache->zc_alloc_elems, mag);
 
-	z_debug_assert(cache->zc_alloc_cur == zc_mag_size());
+	z_debug_assert(cache->zc_alloc_cur != 0);
 	z_debug_assert(mag->zm_cur == 0);
 
 	if (zone == zc_magazine_zone) {
@@ -5872,7 +5925,7 @@ zalloc_cached_slow(zone_t zone, zone_stats_t zstats, zalloc_flags_t flags,
 	 * Try to allocate from our local depot, if there's one.
 	 */
 	if (STAILQ_FIRST(&cache->zc_depot)) {
-		zone_depot_lock_nopreempt(cache);
+		zone_depot_lock_nopreempt(zone, cache);
 
 		if ((mag = STAILQ_FIRST(&cache->zc_depot)) != NULL) {
 			return zalloc_cached_from_depot(zone, zstats, flags,
@@ -5889,7 +5942,7 @@ zalloc_cached_slow(zone_t zone, zone_stats_t zstats, zalloc_flags_t flags,
 	 * The system is tuned for this to be extremely rare.
 	 */
 	if (__improbable(STAILQ_EMPTY(&zone->z_recirc))) {
-		uint16_t n_elems = zc_mag_size();
+		uint16_t n_elems = zone_mag_fill(zone);
 
 		if (zone->z_elems_free < n_elems + zone->z_elems_rsv / 2 &&
 		    os_sub_overflow(zone->z_elems_free,
@@ -5929,6 +5982,7 @@ zalloc_cached_slow(zone_t zone, zone_stats_t zstats, zalloc_flags_t flags,
 		return zalloc_cached_fast(zone, zstats, flags, cache, NULL);
 	}
 
+	uint32_t n_elems = 0;
 	uint16_t n_mags = 0;
 
 	/*
@@ -5939,9 +5993,10 @@ zalloc_cached_slow(zone_t zone, zone_stats_t zstats, zalloc_flags_t flags,
 		mag = STAILQ_FIRST(&zone->z_recirc);
 		STAILQ_REMOVE_HEAD(&zone->z_recirc, zm_link);
 		STAILQ_INSERT_TAIL(&mags, mag, zm_link);
+		n_elems += mag->zm_cur;
 		n_mags++;
 
-		for (uint16_t i = 0; i < zc_mag_size(); i++) {
+		for (uint16_t i = 0; i < mag->zm_cur; i++) {
 			zone_element_t e = mag->zm_elems[i];
 
 			if (!zone_meta_mark_used(zone_meta_from_element(e), e)) {
@@ -5949,9 +6004,9 @@ zalloc_cached_slow(zone_t zone, zone_stats_t zstats, zalloc_flags_t flags,
 			}
 		}
 	} while (!STAILQ_EMPTY(&zone->z_recirc) &&
-	    zc_recirc_denom * n_mags * zc_mag_size() <= cache->zc_depot_max);
+	    zc_recirc_denom * n_elems <= cache->zc_depot_max);
 
-	zone_elems_free_sub(zone, n_mags * zc_mag_size());
+	zone_elems_free_sub(zone, n_elems);
 	zone_counter_sub(zone, z_recirc_cur, n_mags);
 
 	zone_unlock_nopreempt(zone);
@@ -5963,11 +6018,11 @@ zalloc_cached_slow(zone_t zone, zone_stats_t zstats, zalloc_flags_t flags,
 	STAILQ_REMOVE_HEAD(&mags, zm_link);
 	mag = zone_magazine_replace(&cache->zc_alloc_cur,
 	    &cache->zc_alloc_elems, mag);
-	z_debug_assert(cache->zc_alloc_cur == zc_mag_size());
+	z_debug_assert(cache->zc_alloc_cur != 0);
 	z_debug_assert(mag->zm_cur == 0);
 
 	if (--n_mags > 0) {
-		zone_depot_lock_nopreempt(cache);
+		zone_depot_lock_nopreempt(zone, cache);
 		cache->zc_depot_cur += n_mags;
 		STAILQ_CONCAT(&cache->zc_depot, &mags);
 		zone_depot_unlock_nopreempt(cache);
@@ -6302,14 +6357,15 @@ static uint16_t
 zone_reclaim_recirc_magazine(zone_t z, struct zone_depot *mags)
 {
 	zone_magazine_t mag = STAILQ_FIRST(&z->z_recirc);
+	uint16_t n = mag->zm_cur;
 
 	STAILQ_REMOVE_HEAD(&z->z_recirc, zm_link);
 	STAILQ_INSERT_TAIL(mags, mag, zm_link);
 	zone_counter_sub(z, z_recirc_cur, 1);
 
-	z_debug_assert(mag->zm_cur == zc_mag_size());
+	z_debug_assert(n != 0 && n <= zc_mag_size());
 
-	for (uint16_t i = 0; i < zc_mag_size(); i++) {
+	for (uint16_t i = 0; i < n; i++) {
 		zone_element_t ze = mag->zm_elems[i];
 		mag->zm_elems[i].ze_value = 0;
 		zfree_drop(z, zone_element_validate(z, ze), ze, true);
@@ -6317,23 +6373,24 @@ zone_reclaim_recirc_magazine(zone_t z, struct zone_depot *mags)
 
 	mag->zm_cur = 0;
 
-	return zc_mag_size();
+	return n;
 }
 
 static void
-zone_depot_trim(zone_cache_t zc, struct zone_depot *head)
+zone_depot_trim(zone_t z, zone_cache_t zc, struct zone_depot *head)
 {
+	uint16_t fill = zone_mag_fill(z);
 	zone_magazine_t mag;
 
 	if (zc->zc_depot_cur == 0 ||
-	    2 * (zc->zc_depot_cur + 1) * zc_mag_size() <= zc->zc_depot_max) {
+	    2 * (zc->zc_depot_cur + 1) * fill <= zc->zc_depot_max) {
 		return;
 	}
 
 	zone_depot_lock(zc);
 
 	while (zc->zc_depot_cur &&
-	    2 * (zc->zc_depot_cur + 1) * zc_mag_size() > zc->zc_depot_max) {
+	    2 * (zc->zc_depot_cur + 1) * fill > zc->zc_depot_max) {
 		mag = STAILQ_FIRST(&zc->zc_depot);
 		STAILQ_REMOVE_HEAD(&zc->zc_depot, zm_link);
 		STAILQ_INSERT_TAIL(head, mag, zm_link);
@@ -6361,14 +6418,23 @@ __enum_decl(zone_reclaim_mode_t, uint32_t, {
  * Trimming the zone tries to respect the working set size, and avoids draining
  * the depot when it's not necessary.
  *
+ * When a deadline is passed, reclaiming elements from the recirculation depot
+ * and pages from the zone stops once it has passed, leaving the rest to the
+ * next GC (the per-cpu depots are always trimmed).
+ *
  * @param z             The zone to reclaim from
  * @param mode          The purpose of this reclaim.
+ * @param deadline      The absolute time deadline to stop at, or 0.
+ *
+ * @returns             false if the deadline cut the reclaim short.
  */
-static void
-zone_reclaim(zone_t z, zone_reclaim_mode_t mode)
+static bool
+zone_reclaim(zone_t z, zone_reclaim_mode_t mode, uint64_t deadline)
 {
 	struct zone_depot mags = STAILQ_HEAD_INITIALIZER(mags);
 	zone_magazine_t mag, tmp;
+	uint64_t start = mach_absolute_time();
+	bool deferred = false;
 
 	zone_lock(z);
 
@@ -6397,12 +6463,14 @@ zone_reclaim(zone_t z, zone_reclaim_mode_t mode)
 #endif
 		z->z_destroyed = true;
 	} else if (z->z_destroyed) {
-		return zone_unlock(z);
+		zone_unlock(z);
+		return true;
 	} else if (z->z_replenishes && z->z_async_refilling) {
 		/*
 		 * If the zone is replenishing, leave it alone.
 		 */
-		return zone_unlock(z);
+		zone_unlock(z);
+		return true;
 	}
 
 	if (z->z_pcpu_cache) {
@@ -6422,7 +6490,7 @@ zone_reclaim(zone_t z, zone_reclaim_mode_t mode)
 
 		if (mode == ZONE_RECLAIM_TRIM) {
 			zpercpu_foreach(zc, z->z_pcpu_cache) {
-				zone_depot_trim(zc, &mags);
+				zone_depot_trim(z, zc, &mags);
 			}
 		} else {
 			zpercpu_foreach(zc, z->z_pcpu_cache) {
@@ -6476,6 +6544,11 @@ zone_reclaim(zone_t z, zone_reclaim_mode_t mode)
 		struct zone_page_metadata *meta;
 		uint32_t count, goal, freed = 0;
 
+		if (deadline && mach_absolute_time() >= deadline) {
+			deferred = true;
+			break;
+		}
+
 		goal = z->z_elems_rsv;
 		if (mode == ZONE_RECLAIM_TRIM) {
 			/*
@@ -6511,7 +6584,7 @@ zone_reclaim(zone_t z, zone_reclaim_mode_t mode)
 		 * over time anyway.
 		 */
 		while (z->z_recirc_cur) {
-			if (z->z_recirc_cur * zc_mag_size() <= goal &&
+			if (z->z_recirc_cur * zone_mag_fill(z) <= goal &&
 			    !zone_pva_is_null(z->z_pageq_empty)) {
 				break;
 			}
@@ -6520,13 +6593,17 @@ zone_reclaim(zone_t z, zone_reclaim_mode_t mode)
 				thread_yield_to_preemption();
 				zone_lock(z);
 				freed = 0;
+				if (deadline && mach_absolute_time() >= deadline) {
+					deferred = true;
+					break;
+				}
 				/* we dropped the lock, needs to reassess */
 				continue;
 			}
 			freed += zone_reclaim_recirc_magazine(z, &mags);
 		}
 
-		if (zone_pva_is_null(z->z_pageq_empty)) {
+		if (deferred || zone_pva_is_null(z->z_pageq_empty)) {
 			break;
 		}
 
@@ -6540,11 +6617,19 @@ zone_reclaim(zone_t z, zone_reclaim_mode_t mode)
 		zone_reclaim_chunk(z, meta, count);
 	}
 
+	z->z_reclaims++;
+	if (deferred) {
+		z->z_reclaims_deferred++;
+	}
+	z->z_reclaim_time += mach_absolute_time() - start;
+
 	zone_unlock(z);
 
 	STAILQ_FOREACH_SAFE(mag, &mags, zm_link, tmp) {
 		zone_magazine_free(mag);
 	}
+
+	return !deferred;
 }
 
 static void
@@ -6560,7 +6645,7 @@ zone_reclam_all(zone_reclaim_mode_t mode)
 			continue;
 		}
 		if (z->z_va_sequester && z->collectable) {
-			zone_reclaim(z, mode);
+			zone_reclaim(z, mode, 0);
 		}
 	}
 
@@ -6569,11 +6654,79 @@ zone_reclam_all(zone_reclaim_mode_t mode)
 			continue;
 		}
 		if (!z->z_va_sequester && z->collectable) {
-			zone_reclaim(z, mode);
+			zone_reclaim(z, mode, 0);
 		}
 	}
 
-	zone_reclaim(zc_magazine_zone, mode);
+	zone_reclaim(zc_magazine_zone, mode, 0);
+}
+
+/*
+ * Where the next incremental trim starts, for zones with and without VA
+ * sequester, protected by the zone_gc_lock.
+ */
+static zone_id_t zone_trim_cursor[2] = { 1, 1 };
+
+/*!
+ * @function zone_trim_incremental
+ *
+ * @brief
+ * Trims zones for at most @c zone_gc_trim_budget_us.
+ *
+ * @discussion
+ * Zones are trimmed one at a time, starting with the one the previous
+ * incremental trim stopped at, so that every zone gets its turn even when
+ * the budget is too small to trim all of them in one go. A zone which is
+ * still being trimmed when the budget runs out is where the next
+ * incremental trim starts, so it gets the rest of its trim then.
+ *
+ * Like @c zone_reclam_all(), zones with VA sequester go first, since they
+ * give memory back to the system faster. They may only use half of the
+ * budget though, so that the other zones are never starved of trims.
+ *
+ * The magazine zone is trimmed last every time, without a deadline,
+ * since the other zones give their magazines back to it.
+ */
+static void
+zone_trim_incremental(void)
+{
+	zone_id_t count = os_atomic_load(&num_zones, acquire);
+	uint64_t start, budget, deadline;
+
+	clock_interval_to_absolutetime_interval(zone_gc_trim_budget_us,
+	    NSEC_PER_USEC, &budget);
+	start = mach_absolute_time();
+
+	for (int pass = 0; pass < 2; pass++) {
+		bool sequester = (pass == 0);
+		zone_id_t zid = zone_trim_cursor[pass];
+
+		/* the second pass gets whatever the first one left */
+		deadline = start + (sequester ? budget / 2 : budget);
+
+		for (zone_id_t n = 1; n < count; n++) {
+			zone_t z;
+
+			if (mach_absolute_time() >= deadline) {
+				break;
+			}
+			if (zid >= count) {
+				zid = 1;
+			}
+			z = &zone_array[zid];
+
+			if (z != zc_magazine_zone && z->collectable &&
+			    (bool)z->z_va_sequester == sequester &&
+			    !zone_reclaim(z, ZONE_RECLAIM_TRIM, deadline)) {
+				break;
+			}
+			zid++;
+		}
+
+		zone_trim_cursor[pass] = zid;
+	}
+
+	zone_reclaim(zc_magazine_zone, ZONE_RECLAIM_TRIM, 0);
 }
 
 void
@@ -6597,7 +6750,11 @@ zone_gc(zone_gc_level_t level)
 	current_thread()->options |= TH_OPT_ZONE_PRIV;
 	lck_mtx_lock(&zone_gc_lock);
 
-	zone_reclam_all(mode);
+	if (mode == ZONE_RECLAIM_TRIM && zone_gc_trim_budget_us) {
+		zone_trim_incremental();
+	} else {
+		zone_reclam_all(mode);
+	}
 
 	if (level == ZONE_GC_JETSAM && zone_map_nearing_exhaustion()) {
 		/*
@@ -6626,7 +6783,7 @@ zone_gc_drain(void)
 static bool
 zone_defrag_needed(zone_t z)
 {
-	uint32_t recirc_size = z->z_recirc_cur * zc_mag_size();
+	uint32_t recirc_size = z->z_recirc_cur * zone_mag_fill(z);
 
 	if (recirc_size <= z->z_chunk_elems / 2) {
 		return false;
@@ -6666,9 +6823,9 @@ zone_defrag_async(__unused thread_call_param_t p0, __unused thread_call_param_t
 		zone_lock(z);
 
 		goal = z->z_elems_free_wss + z->z_chunk_elems / 2 +
-		    zc_mag_size() - 1;
+		    zone_mag_fill(z) - 1;
 
-		while (z->z_recirc_cur * zc_mag_size() > goal) {
+		while (z->z_recirc_cur * zone_mag_fill(z) > goal) {
 			if (freed >= zc_free_batch_size) {
 				zone_unlock(z);
 				thread_yield_to_preemption();
@@ -6692,6 +6849,7 @@ void
 compute_zone_working_set_size(__unused void *param)
 {
 	uint32_t zc_auto = zc_auto_threshold;
+	uint32_t zc_mag_grow = zc_mag_grow_threshold;
 	bool kick_defrag = false;
 
 	/*
@@ -6709,6 +6867,9 @@ compute_zone_working_set_size(__unused void *param)
 	if (os_mul_overflow(zc_auto, Z_CONTENTION_WMA_UNIT, &zc_auto)) {
 		zc_auto = 0;
 	}
+	if (os_mul_overflow(zc_mag_grow, Z_CONTENTION_WMA_UNIT, &zc_mag_grow)) {
+		zc_mag_grow = 0;
+	}
 
 	zone_foreach(z) {
 		uint32_t wma;
@@ -6737,15 +6898,32 @@ compute_zone_working_set_size(__unused void *param)
 
 		/*
 		 * If the zone seems to be very quiet,
-		 * gently lower its cpu-local depot size.
+		 * gently lower its cpu-local depot size and magazine fill.
 		 */
 		if (z->z_pcpu_cache && wma < Z_CONTENTION_WMA_UNIT / 2 &&
 		    z->z_contention_wma < Z_CONTENTION_WMA_UNIT / 2) {
 			zpercpu_foreach(zc, z->z_pcpu_cache) {
-				if (zc->zc_depot_max > zc_mag_size()) {
+				if (zc->zc_depot_max > zone_mag_fill(z)) {
 					zc->zc_depot_max--;
 				}
 			}
+			if (z->z_mag_fill > zc_mag_fill_min) {
+				z->z_mag_fill--;
+				z->z_mag_resizes++;
+			}
+		}
+
+		/*
+		 * If the zone is still contending for two periods with
+		 * the per-cpu depots allowed to grow, make its magazines
+		 * bigger so that each trip to the recirculation depot
+		 * moves more elements.
+		 */
+		if (z->z_pcpu_cache && zc_mag_grow && wma >= zc_mag_grow &&
+		    z->z_contention_wma >= zc_mag_grow &&
+		    z->z_mag_fill < zc_mag_size()) {
+			z->z_mag_fill = (uint16_t)MIN(2 * z->z_mag_fill, zc_mag_size());
+			z->z_mag_resizes++;
 		}
 
 		/*
@@ -6827,7 +7005,7 @@ get_zone_info(
 	if (z->z_pcpu_cache) {
 		zpercpu_foreach(zc, z->z_pcpu_cache) {
 			cached += zc->zc_alloc_cur + zc->zc_free_cur;
-			cached += zc->zc_depot_cur * zc_mag_size();
+			cached += zc->zc_depot_cur * zone_mag_fill(z);
 		}
 	}
 	zone_unlock(z);
@@ -7100,6 +7278,50 @@ get_zones_collectable_bytes(void)
 	return zones_collectable_bytes;
 }
 
+#if DEBUG || DEVELOPMENT
+
+/* a zone name, the heap prefix, and 8 columns of counters */
+#define ZONE_CACHE_STATS_LINE   (2 * MAX_ZONE_NAME + 96)
+
+size_t
+zone_cache_stats_size(void)
+{
+	return (os_atomic_load(&num_zones, relaxed) + 1) * ZONE_CACHE_STATS_LINE;
+}
+
+size_t
+zone_cache_stats_print(char *buf, size_t size)
+{
+	size_t len;
+
+	len = scnprintf(buf, size, "%-32s %4s %7s %11s %11s %8s %8s %12s\n",
+	    "zone name", "mag", "resizes", "lock cont", "depot cont",
+	    "gc runs", "gc defer", "gc time (us)");
+
+	zone_foreach(z) {
+		char name[2 * MAX_ZONE_NAME];
+		uint64_t reclaim_ns;
+
+		if (!z->z_self || !z->z_pcpu_cache || len >= size) {
+			continue;
+		}
+
+		snprintf(name, sizeof(name), "%s%s", zone_heap_name(z), z->z_name);
+		absolutetime_to_nanoseconds(z->z_reclaim_time, &reclaim_ns);
+
+		len += scnprintf(buf + len, size - len,
+		    "%-32s %4d %7d %11u %11u %8u %8u %12llu\n",
+		    name, z->z_mag_fill, z->z_mag_resizes, z->z_contentions,
+		    os_atomic_load(&z->z_depot_contentions, relaxed),
+		    z->z_reclaims, z->z_reclaims_deferred,
+		    reclaim_ns / NSEC_PER_USEC);
+	}
+
+	return len;
+}
+
+#endif /* DEBUG || DEVELOPMENT */
+
 kern_return_t
 mach_zone_get_zlog_zones(
 	host_priv_t                             host,
@@ -7812,6 +8034,7 @@ zone_create_ext(
 		z->z_free_zeroes = true;
 	}
 
+	z->z_mag_fill = zc_mag_fill_min;
 	if ((flags & ZC_CACHING) && !z->z_nocaching) {
 		/*
 		 * If zcache hasn't been initialized yet, remember our decision,
@@ -7940,7 +8163,7 @@ zdestroy(zone_t z)
 	current_thread()->options |= TH_OPT_ZONE_PRIV;
 	lck_mtx_lock(&zone_gc_lock);
 
-	zone_reclaim(z, ZONE_RECLAIM_DESTROY);
+	zone_reclaim(z, ZONE_RECLAIM_DESTROY, 0);
 
 	lck_mtx_unlock(&zone_gc_lock);
 	current_thread()->options &= ~TH_OPT_ZONE_PRIV;
@@ -8072,6 +8295,9 @@ zone_tunables_fixup(void)
 	if (zc_magazine_size > PAGE_SIZE / ZONE_MIN_ELEM_SIZE) {
 		zc_magazine_size = (uint16_t)(PAGE_SIZE / ZONE_MIN_ELEM_SIZE);
 	}
+	if (zc_mag_fill_min == 0 || zc_mag_fill_min > zc_magazine_size) {
+		zc_mag_fill_min = zc_magazine_size;
+	}
 }
 STARTUP(TUNABLES, STARTUP_RANK_MIDDLE, zone_tunables_fixup);
 
@@ -263,6 +263,23 @@ struct zone {
 	 *
 	 * z_elems_avail:
 	 *   number of elements in the zone (at all).
+	 *
+	 * z_mag_fill:
+	 *   number of elements the per-cpu layer fills magazines with before
+	 *   it moves them to the depots, between @c zc_mag_fill_min and
+	 *   @c zc_mag_size(), adapted to @c z_contention_wma.
+	 *
+	 * z_mag_resizes:
+	 *   how many times @c z_mag_fill changed.
+	 *
+	 * z_contentions, z_depot_contentions:
+	 *   cumulative count of contentions on the zone lock, and on the per-cpu
+	 *   depot locks (which only the zone GC contends with).
+	 *
+	 * z_reclaims, z_reclaims_deferred, z_reclaim_time:
+	 *   how many times the zone GC reclaimed from this zone, how many of those
+	 *   ran out of time and left the rest for the next pass, and the total
+	 *   time spent reclaiming (in absolute time units).
 	 */
 #define Z_CONTENTION_WMA_UNIT (1u << 8)
 	uint32_t            z_contention_wma;
@@ -273,6 +290,13 @@ struct zone {
 	uint32_t            z_elems_free_min;
 	uint32_t            z_elems_free;   /* Number of free elements             */
 	uint32_t            z_elems_avail;  /* Number of elements available        */
+	uint16_t            z_mag_fill;
+	uint16_t            z_mag_resizes;
+	uint32_t            z_contentions;
+	uint32_t            z_depot_contentions;
+	uint32_t            z_reclaims;
+	uint32_t            z_reclaims_deferred;
+	uint64_t            z_reclaim_time;
 
 #if CONFIG_ZLEAKS
 	uint32_t            zleak_capture;  /* per-zone counter for capturing every N allocations */
@@ -416,12 +440,27 @@ zone_size_wasted(zone_t zone)
  */
 extern uint64_t get_zones_collectable_bytes(void);
 
+#if DEBUG || DEVELOPMENT
+/*
+ * For sysctl kern.zone_cache_stats: prints a zprint-like table of the
+ * magazine sizes, contention and GC counters of the zones with caching
+ * enabled into @c buf, and returns the length of the text.
+ *
+ * @c zone_cache_stats_size() is an upper bound of the size @c buf needs.
+ */
+extern size_t   zone_cache_stats_size(void);
+extern size_t   zone_cache_stats_print(char *buf, size_t size);
+#endif /* DEBUG || DEVELOPMENT */
+
 /*!
  * @enum zone_gc_level_t
  *
  * @const ZONE_GC_TRIM
  * Request a trimming GC: it will trim allocations in excess
  * of the working set size estimate only.
+ * Trimming is incremental: it stops once it has run for
+ * @c zone_gc_trim_budget_us, and the next trimming GC resumes
+ * with the zone it stopped at.
  *
  * @const ZONE_GC_DRAIN
  * Request a draining GC: this is an aggressive mode that will
@@ -153,6 +153,8 @@ struct coalition_resource_usage {
 	uint64_t cpu_cycles;
 	uint64_t fs_metadata_writes;
 	uint64_t pm_writes;
+	uint64_t workingset_refaults_file;      /* refaults of evicted working set pages */
+	uint64_t workingset_refaults_anon;
 };
 
 #ifdef PRIVATE
@@ -76,4 +76,14 @@ typedef int             vm_behavior_t;
 #define VM_BEHAVIOR_CAN_REUSE   ((vm_behavior_t) 10)
 #define VM_BEHAVIOR_PAGEOUT     ((vm_behavior_t) 11)
 
+/*
+ * The following behaviors are stored in the VM map entry and control how
+ * many neighbouring resident pages a read fault maps along with the
+ * faulting page ("fault-around").
+ */
+#define VM_BEHAVIOR_FAULT_AROUND_DEFAULT        ((vm_behavior_t) 12)    /* system default, follows paging behavior */
+#define VM_BEHAVIOR_FAULT_AROUND_NONE           ((vm_behavior_t) 13)    /* map the faulting page only */
+#define VM_BEHAVIOR_FAULT_AROUND_SMALL          ((vm_behavior_t) 14)    /* small window */
+#define VM_BEHAVIOR_FAULT_AROUND_LARGE          ((vm_behavior_t) 15)    /* large window */
+
 #endif  /*_MACH_VM_BEHAVIOR_H_*/
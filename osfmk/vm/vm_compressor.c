@@ -4182,6 +4182,8 @@ bypass_busy_check:
 		uint32_t        age_of_cseg;
 		clock_sec_t     cur_ts_sec;
 		clock_nsec_t    cur_ts_nsec;
+		uint64_t        swap_handle;
+		task_t          swap_owner = TASK_NULL;
 
 		if (C_SEG_IS_ONDISK(c_seg)) {
 #if CONFIG_FREEZE
@@ -4207,9 +4209,16 @@ bypass_busy_check:
 			}
 #endif /* CONFIG_FREEZE */
 			assert(kdp_mode == FALSE);
+			swap_handle = c_seg->c_store.c_swap_handle;
+#if CONFIG_FREEZE
+			/* c_seg_swapin clears the owner */
+			swap_owner = c_seg->c_task_owner;
+#endif /* CONFIG_FREEZE */
 			retval = c_seg_swapin(c_seg, FALSE, TRUE);
 			assert(retval == 0);
 
+			vm_swapin_readahead(swap_handle, swap_owner);
+
 			retval = 1;
 		}
 		if (c_seg->c_state == C_ON_BAD_Q) {
@@ -392,6 +392,7 @@ extern int              vm_swap_out_of_space(void);
 extern kern_return_t    vm_swap_get(c_segment_t, uint64_t, uint64_t);
 extern void             vm_swap_free(uint64_t);
 extern void             vm_swap_consider_defragmenting(int);
+extern void             vm_swapin_readahead(uint64_t, task_t);
 
 extern void             c_seg_swapin_requeue(c_segment_t, boolean_t, boolean_t, boolean_t);
 extern int              c_seg_swapin(c_segment_t, boolean_t, boolean_t);
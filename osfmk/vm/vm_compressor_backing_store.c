@@ -95,6 +95,7 @@ struct swapfile {
 	unsigned int            swp_index;      /* index of this swap file */
 	unsigned int            swp_flags;      /* state of swap file */
 	unsigned int            swp_free_hint;  /* offset of 1st free chunk */
+	unsigned int            swp_next_seg;   /* chunk after the last one handed out */
 	unsigned int            swp_io_count;   /* count of outstanding I/Os */
 	c_segment_t             *swp_csegs;     /* back pointers to the c_segments. Used during swap reclaim. */
 
@@ -119,6 +120,7 @@ static void vm_swapout_thread(void);
 static void vm_swapfile_create_thread(void);
 static void vm_swapfile_gc_thread(void);
 static void vm_swap_defragment(void);
+static void vm_swapin_readahead_init(void);
 static void vm_swap_handle_delayed_trims(boolean_t);
 static void vm_swap_do_delayed_trim(struct swapfile *);
 static void vm_swap_wait_on_trim_handling_in_progress(void);
@@ -400,6 +402,22 @@ vm_swap_decrypt(c_segment_t c_seg)
 #endif /* ENCRYPTED_SWAP */
 
 
+/*
+ * Number of swapouts the swapout thread keeps in flight at each
+ * throttle level.  The unthrottled levels scale with the
+ * vm_swapout_queue_depth boot-arg so that devices that can take deep
+ * queues of writes get them; VM_SWAPOUT_LIMIT_MAX sizes the array of
+ * I/O completion contexts and bounds the boot-arg.
+ */
+#define   VM_SWAPOUT_LIMIT_T2P  4
+#define   VM_SWAPOUT_LIMIT_T1P  4
+#define   VM_SWAPOUT_LIMIT_T0P  ((vm_swapout_queue_depth * 3) / 4)
+#define   VM_SWAPOUT_LIMIT_T0   (vm_swapout_queue_depth)
+#define   VM_SWAPOUT_LIMIT_MAX  32
+
+TUNABLE_WRITEABLE(uint32_t, vm_swapout_queue_depth, "vm_swapout_queue_depth", 16);
+
+
 void
 vm_compressor_swap_init()
 {
@@ -407,6 +425,12 @@ vm_compressor_swap_init()
 
 	queue_init(&swf_global_queue);
 
+	if (vm_swapout_queue_depth > VM_SWAPOUT_LIMIT_MAX) {
+		vm_swapout_queue_depth = VM_SWAPOUT_LIMIT_MAX;
+	} else if (vm_swapout_queue_depth < VM_SWAPOUT_LIMIT_T1P) {
+		vm_swapout_queue_depth = VM_SWAPOUT_LIMIT_T1P;
+	}
+
 	if (kernel_thread_start_priority((thread_continue_t)vm_swapout_thread, NULL,
 	    BASEPRI_VM, &thread) != KERN_SUCCESS) {
 		panic("vm_swapout_thread: create failed");
@@ -424,6 +448,8 @@ vm_compressor_swap_init()
 	thread_set_thread_name(thread, "VM_swapfile_create");
 	thread_deallocate(thread);
 
+	vm_swapin_readahead_init();
+
 	if (kernel_thread_start_priority((thread_continue_t)vm_swapfile_gc_thread, NULL,
 	    BASEPRI_VM, &thread) != KERN_SUCCESS) {
 		panic("vm_swapfile_gc_thread: create failed");
@@ -698,6 +724,265 @@ vm_swap_defragment()
 }
 
 
+/*
+ * Swap-in read-ahead.
+ *
+ * A fault on a swapped out c_segment reads that one segment back in,
+ * synchronously, and a task coming back from the freezer does that for
+ * each of its segments in turn, with the device idle in between.  Since
+ * vm_swap_put() lays out segments that are swapped out together next to
+ * each other, the segments that follow the one we just faulted in are
+ * likely to be needed next.  vm_swapin_readahead() queues the next
+ * vm_swapin_readahead_window chunks of the swapfile and up to
+ * vm_swapin_readahead_depth threads read them in in parallel, so the
+ * device sees a queue of sequential reads.
+ *
+ * A chunk is only read ahead if its c_segment is still swapped out, not
+ * busy, and belongs to the same task as the one that was faulted in
+ * (for segments the freezer swapped out on behalf of a task; for the
+ * others, only if they have no owner either).  Read-ahead is advice:
+ * requests that don't fit in the queue are dropped, and it stops when
+ * free memory or the compressor is running low.
+ */
+
+TUNABLE_WRITEABLE(unsigned int, vm_swapin_readahead_depth, "vm_swapin_readahead_depth", 4);
+/* chunks queued after a swapin fault */
+unsigned int vm_swapin_readahead_window = 8;
+
+uint64_t vm_swapin_readahead_requests = 0;
+uint64_t vm_swapin_readahead_dropped = 0;
+uint64_t vm_swapin_readahead_segments = 0;
+uint64_t vm_swapin_readahead_bytes = 0;
+
+/* also the largest useful vm_swapin_readahead_depth */
+#define VM_SWAPIN_READAHEAD_THREADS     16
+#define VM_SWAPIN_READAHEAD_REQUESTS    64
+
+struct vm_swapin_readahead_request {
+	uint64_t        vsr_f_offset;   /* swap handle of the chunk */
+	void            *vsr_owner;     /* task the segment must belong to, only compared */
+};
+
+static struct vm_swapin_readahead_request
+    vm_swapin_readahead_queue[VM_SWAPIN_READAHEAD_REQUESTS];
+static uint32_t vm_swapin_readahead_head;
+static uint32_t vm_swapin_readahead_nrequests;
+
+/* the chunk each thread is reading, to avoid queueing it twice */
+static uint64_t vm_swapin_readahead_active[VM_SWAPIN_READAHEAD_THREADS];
+
+LCK_GRP_DECLARE(vm_swapin_readahead_lck_grp, "vm_swapin_readahead");
+static LCK_SPIN_DECLARE(vm_swapin_readahead_lock, &vm_swapin_readahead_lck_grp);
+
+/*
+ * Is "f_offset" already queued or being read?
+ * Called with the vm_swapin_readahead_lock held.
+ */
+static boolean_t
+vm_swapin_readahead_pending(uint64_t f_offset)
+{
+	uint32_t        i;
+
+	for (i = 0; i < VM_SWAPIN_READAHEAD_THREADS; i++) {
+		if (vm_swapin_readahead_active[i] == f_offset) {
+			return TRUE;
+		}
+	}
+	for (i = 0; i < vm_swapin_readahead_nrequests; i++) {
+		if (vm_swapin_readahead_queue[(vm_swapin_readahead_head + i) %
+		    VM_SWAPIN_READAHEAD_REQUESTS].vsr_f_offset == f_offset) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Called after a fault swapped in the c_segment that was at "f_offset"
+ * and belonged to "owner" (TASK_NULL if it had none), to queue the
+ * chunks that follow it in the swapfile.
+ *
+ * May be called with the c_segment locked.
+ */
+void
+vm_swapin_readahead(uint64_t f_offset, task_t owner)
+{
+	struct vm_swapin_readahead_request *vsr;
+	uint64_t        next;
+	uint32_t        queued = 0, i;
+
+	if (vm_swapin_readahead_depth == 0 || compressor_store_stop_compaction) {
+		return;
+	}
+	lck_spin_lock(&vm_swapin_readahead_lock);
+	for (i = 1; i <= vm_swapin_readahead_window; i++) {
+		next = f_offset + i * COMPRESSED_SWAP_CHUNK_SIZE;
+		if ((next >> SWAP_DEVICE_SHIFT) != (f_offset >> SWAP_DEVICE_SHIFT)) {
+			break;
+		}
+		if (vm_swapin_readahead_pending(next)) {
+			continue;
+		}
+		if (vm_swapin_readahead_nrequests == VM_SWAPIN_READAHEAD_REQUESTS) {
+			os_atomic_inc(&vm_swapin_readahead_dropped, relaxed);
+			break;
+		}
+		vsr = &vm_swapin_readahead_queue[(vm_swapin_readahead_head +
+		    vm_swapin_readahead_nrequests) % VM_SWAPIN_READAHEAD_REQUESTS];
+		vsr->vsr_f_offset = next;
+		vsr->vsr_owner = owner;
+		vm_swapin_readahead_nrequests++;
+		queued++;
+	}
+	lck_spin_unlock(&vm_swapin_readahead_lock);
+
+	if (queued) {
+		os_atomic_add(&vm_swapin_readahead_requests, queued, relaxed);
+		thread_wakeup((event_t)&vm_swapin_readahead_nrequests);
+	}
+}
+
+/*
+ * Is there room to bring another c_segment back in?
+ */
+static boolean_t
+vm_swapin_readahead_ok(void)
+{
+	if (compressor_store_stop_compaction || vm_page_free_count < vm_page_free_target) {
+		return FALSE;
+	}
+#if CONFIG_FREEZE
+	if (freezer_incore_cseg_acct) {
+		uint32_t incore_seg_count = c_segment_count - c_swappedout_count - c_swappedout_sparse_count;
+
+		if ((incore_seg_count + 1) >= c_segments_nearing_limit) {
+			return FALSE;
+		}
+	}
+#endif /* CONFIG_FREEZE */
+	return TRUE;
+}
+
+/*
+ * Swap in the c_segment at "f_offset", if it's still there and
+ * belongs to "owner".
+ */
+static void
+vm_swapin_readahead_one(uint64_t f_offset, void *owner)
+{
+	struct swapfile *swf;
+	c_segment_t     c_seg;
+	unsigned int    segidx;
+	uint32_t        size;
+
+	PAGE_REPLACEMENT_DISALLOWED(TRUE);
+	lck_mtx_lock(&vm_swap_data_lock);
+
+	swf = vm_swapfile_for_handle(f_offset);
+	if (swf == NULL || !(swf->swp_flags & SWAP_READY)) {
+		goto out;
+	}
+	segidx = (unsigned int)((f_offset & SWAP_SLOT_MASK) / COMPRESSED_SWAP_CHUNK_SIZE);
+	if (segidx >= swf->swp_nsegs ||
+	    ((swf->swp_bitmap)[segidx >> 3] & (1 << (segidx % 8))) == 0 ||
+	    (c_seg = swf->swp_csegs[segidx]) == NULL) {
+		goto out;
+	}
+	/*
+	 * the back pointer is only cleared behind the vm_swap_data_lock,
+	 * so the c_segment can't be freed until we drop it... one that is
+	 * busy is being freed, swapped in or written out, leave it alone
+	 */
+	lck_mtx_lock_spin_always(&c_seg->c_lock);
+
+	if (c_seg->c_busy || !C_SEG_IS_ONDISK(c_seg) ||
+	    c_seg->c_store.c_swap_handle != f_offset) {
+		lck_mtx_unlock_always(&c_seg->c_lock);
+		goto out;
+	}
+#if CONFIG_FREEZE
+	if ((void *)c_seg->c_task_owner != owner) {
+		lck_mtx_unlock_always(&c_seg->c_lock);
+		goto out;
+	}
+#else
+	(void)owner;
+#endif /* CONFIG_FREEZE */
+	lck_mtx_unlock(&vm_swap_data_lock);
+
+	size = round_page_32(C_SEG_OFFSET_TO_BYTES(c_seg->c_populated_offset));
+
+	if (c_seg_swapin(c_seg, FALSE, TRUE) == 0) {
+		lck_mtx_unlock_always(&c_seg->c_lock);
+	}
+	os_atomic_inc(&vm_swapin_readahead_segments, relaxed);
+	os_atomic_add(&vm_swapin_readahead_bytes, size, relaxed);
+
+	PAGE_REPLACEMENT_DISALLOWED(FALSE);
+	return;
+out:
+	lck_mtx_unlock(&vm_swap_data_lock);
+	PAGE_REPLACEMENT_DISALLOWED(FALSE);
+}
+
+static void
+vm_swapin_readahead_thread(void *param, __unused wait_result_t wr)
+{
+	struct vm_swapin_readahead_request vsr;
+	uintptr_t       idx = (uintptr_t)param;
+
+	for (;;) {
+		lck_spin_lock(&vm_swapin_readahead_lock);
+		vm_swapin_readahead_active[idx] = 0;
+		if (vm_swapin_readahead_nrequests == 0 ||
+		    idx >= vm_swapin_readahead_depth) {
+			assert_wait((event_t)&vm_swapin_readahead_nrequests,
+			    THREAD_UNINT);
+			lck_spin_unlock(&vm_swapin_readahead_lock);
+			thread_block(THREAD_CONTINUE_NULL);
+			continue;
+		}
+		if (!vm_swapin_readahead_ok()) {
+			/* drop whatever is queued, it would be stale by the time we could read it */
+			os_atomic_add(&vm_swapin_readahead_dropped,
+			    vm_swapin_readahead_nrequests, relaxed);
+			vm_swapin_readahead_nrequests = 0;
+			lck_spin_unlock(&vm_swapin_readahead_lock);
+			continue;
+		}
+		vsr = vm_swapin_readahead_queue[vm_swapin_readahead_head];
+		vm_swapin_readahead_head = (vm_swapin_readahead_head + 1) %
+		    VM_SWAPIN_READAHEAD_REQUESTS;
+		vm_swapin_readahead_nrequests--;
+		vm_swapin_readahead_active[idx] = vsr.vsr_f_offset;
+		lck_spin_unlock(&vm_swapin_readahead_lock);
+
+		vm_swapin_readahead_one(vsr.vsr_f_offset, vsr.vsr_owner);
+	}
+}
+
+static void
+vm_swapin_readahead_init(void)
+{
+	kern_return_t   kr;
+	thread_t        thread;
+	uintptr_t       i;
+
+	for (i = 0; i < VM_SWAPIN_READAHEAD_THREADS; i++) {
+		kr = kernel_thread_start_priority(
+			vm_swapin_readahead_thread,
+			(void *)i,
+			BASEPRI_DEFAULT,
+			&thread);
+		if (kr != KERN_SUCCESS) {
+			panic("failed to launch vm_swapin_readahead_thread kr=0x%x", kr);
+		}
+		thread_set_thread_name(thread, "VM_swapin_readahead");
+		thread_deallocate(thread);
+	}
+}
+
+
 
 static void
 vm_swapfile_create_thread(void)
@@ -882,12 +1167,6 @@ vm_swapfile_gc_thread(void)
 
 
 
-#define   VM_SWAPOUT_LIMIT_T2P  4
-#define   VM_SWAPOUT_LIMIT_T1P  4
-#define   VM_SWAPOUT_LIMIT_T0P  6
-#define   VM_SWAPOUT_LIMIT_T0   8
-#define   VM_SWAPOUT_LIMIT_MAX  8
-
 #define   VM_SWAPOUT_START      0
 #define   VM_SWAPOUT_T2_PASSIVE 1
 #define   VM_SWAPOUT_T1_PASSIVE 2
@@ -1390,6 +1669,7 @@ vm_swap_create_file()
 			swf->swp_nsegs = (unsigned int) (size / COMPRESSED_SWAP_CHUNK_SIZE);
 			swf->swp_nseginuse = 0;
 			swf->swp_free_hint = 0;
+			swf->swp_next_seg = 0;
 
 			num_bytes_for_bitmap = MAX((swf->swp_nsegs >> 3), 1);
 			/*
@@ -1459,6 +1739,37 @@ vm_swap_create_file()
 	return swap_file_created;
 }
 
+/*
+ * Pick the chunk of "swf" the next swapout goes to.
+ *
+ * Chunks are handed out next-fit: we keep going from the one after the
+ * chunk we last handed out, and only go back to the lowest free chunk
+ * when we reach the end of the file.  c_segments swapped out together,
+ * like those of a task being frozen, then sit next to each other in the
+ * file, which is what lets vm_swapin_readahead() read them back in
+ * sequentially.
+ *
+ * Returns swp_nsegs if there are no free chunks.
+ * Called with the vm_swap_data_lock held.
+ */
+static unsigned int
+vm_swapfile_next_free_seg(struct swapfile *swf)
+{
+	unsigned int    segidx;
+
+	for (segidx = swf->swp_next_seg; segidx < swf->swp_nsegs; segidx++) {
+		if (((swf->swp_bitmap)[segidx >> 3] & (1 << (segidx % 8))) == 0) {
+			return segidx;
+		}
+	}
+	for (segidx = swf->swp_free_hint; segidx < swf->swp_next_seg; segidx++) {
+		if (((swf->swp_bitmap)[segidx >> 3] & (1 << (segidx % 8))) == 0) {
+			return segidx;
+		}
+	}
+	return swf->swp_nsegs;
+}
+
 extern void vnode_put(struct vnode* vp);
 kern_return_t
 vm_swap_get(c_segment_t c_seg, uint64_t f_offset, uint64_t size)
@@ -1552,21 +1863,17 @@ retry:
 	swf = (struct swapfile*) queue_first(&swf_global_queue);
 
 	while (queue_end(&swf_global_queue, (queue_entry_t)swf) == FALSE) {
-		segidx = swf->swp_free_hint;
-
 		swf_eligible =  (swf->swp_flags & SWAP_READY) && (swf->swp_nseginuse < swf->swp_nsegs);
 
 		if (swf_eligible) {
-			while (segidx < swf->swp_nsegs) {
+			segidx = vm_swapfile_next_free_seg(swf);
+
+			if (segidx < swf->swp_nsegs) {
 				byte_for_segidx = segidx >> 3;
 				offset_within_byte = segidx % 8;
 
-				if ((swf->swp_bitmap)[byte_for_segidx] & (1 << offset_within_byte)) {
-					segidx++;
-					continue;
-				}
-
 				(swf->swp_bitmap)[byte_for_segidx] |= (1 << offset_within_byte);
+				swf->swp_next_seg = segidx + 1;
 
 				file_offset = segidx * COMPRESSED_SWAP_CHUNK_SIZE;
 				swf->swp_nseginuse++;
@@ -1765,6 +2072,13 @@ vm_swap_free(uint64_t f_offset)
 		tl->tl_offset = f_offset & SWAP_SLOT_MASK;
 		tl->tl_length = COMPRESSED_SWAP_CHUNK_SIZE;
 
+		/*
+		 * the chunk stays allocated until the trim is done, but
+		 * its c_segment is gone: don't let vm_swapin_readahead
+		 * find it through the back pointer
+		 */
+		swf->swp_csegs[tl->tl_offset / COMPRESSED_SWAP_CHUNK_SIZE] = NULL;
+
 		tl->tl_next = swf->swp_delayed_trim_list_head;
 		swf->swp_delayed_trim_list_head = tl;
 		swf->swp_delayed_trim_count++;
@@ -2170,6 +2484,7 @@ swap_io_failed:
 	swf->swp_vp = NULL;
 	swf->swp_size = 0;
 	swf->swp_free_hint = 0;
+	swf->swp_next_seg = 0;
 	swf->swp_nsegs = 0;
 	swf->swp_flags = SWAP_REUSE;
 
@@ -2239,7 +2554,7 @@ int
 vm_swap_out_of_space(void)
 {
 	if ((vm_num_swap_files == vm_num_swap_files_config) &&
-	    ((vm_swapfile_total_segs_alloced - vm_swapfile_total_segs_used) < VM_SWAPOUT_LIMIT_MAX)) {
+	    ((vm_swapfile_total_segs_alloced - vm_swapfile_total_segs_used) < vm_swapout_queue_depth)) {
 		/*
 		 * Last swapfile and we have only space for the
 		 * last few swapouts.
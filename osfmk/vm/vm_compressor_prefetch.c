@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+
+/*
+ * Asynchronous decompression of anonymous memory ahead of use.
+ *
+ * A fault on a compressed page decompresses just that page, and if its
+ * c_segment was swapped out, brings the whole segment back in first.
+ * A task that touches a large compressed range, typically when it comes
+ * back to the foreground, does so one synchronous fault at a time.
+ *
+ * Two things queue ranges of an object for the prefetch threads, which
+ * decompress whatever is compressed there into pages of the object that
+ * are put on the active queue but not mapped, so the faults that follow
+ * are soft faults:
+ *
+ *  - madvise(MADV_WILLNEED) on anonymous memory that has pages in the
+ *    compressor (vm_compressor_prefetch_range()),
+ *
+ *  - a fault that decompresses a page while the object is being
+ *    accessed sequentially, which queues the next window of pages in
+ *    the direction of the run (vm_compressor_prefetch_refault()).
+ *
+ * Prefetching is advice: requests that don't fit in the queue are
+ * dropped, and a request stops as soon as free memory drops below
+ * vm_page_free_target or its object goes away.  Only pages of the object
+ * itself are prefetched, not those of the objects it shadows.
+ */
+
+#include <mach/mach_types.h>
+#include <mach/kern_return.h>
+
+#include <kern/counter.h>
+#include <kern/host_statistics.h>
+#include <kern/locks.h>
+#include <kern/sched_prim.h>
+#include <kern/thread.h>
+
+#include <vm/vm_compressor_pager.h>
+#include <vm/vm_compressor_prefetch.h>
+#include <vm/vm_object.h>
+#include <vm/vm_page.h>
+
+TUNABLE_WRITEABLE(int, vm_compressor_prefetch_enabled, "vm_compressor_prefetch", 1);
+/* pages queued ahead of a sequential run of compressor faults */
+unsigned int vm_compressor_prefetch_window = 64;
+
+uint64_t vm_compressor_prefetch_requests = 0;
+uint64_t vm_compressor_prefetch_dropped = 0;
+uint64_t vm_compressor_prefetch_pages = 0;
+
+#define VM_COMPRESSOR_PREFETCH_THREADS  2
+#define VM_COMPRESSOR_PREFETCH_REQUESTS 64
+/* madvise ranges are split in requests of at most this many pages */
+#define VM_COMPRESSOR_PREFETCH_CHUNK    256
+/* length of the sequential run that starts the refault prefetch */
+#define VM_COMPRESSOR_PREFETCH_TRIGGER  4
+
+/*
+ * A range of an object to decompress.  Each request, queued or being
+ * worked on, holds a reference on its object.
+ */
+struct vm_compressor_prefetch_request {
+	vm_object_t             vcp_object;
+	vm_object_offset_t      vcp_start;
+	vm_object_offset_t      vcp_end;
+	boolean_t               vcp_reverse;
+};
+
+static struct vm_compressor_prefetch_request
+    vm_compressor_prefetch_queue[VM_COMPRESSOR_PREFETCH_REQUESTS];
+static uint32_t vm_compressor_prefetch_head;
+static uint32_t vm_compressor_prefetch_nrequests;
+
+/* what each prefetch thread is working on, to avoid queueing it twice */
+static struct vm_compressor_prefetch_request
+    vm_compressor_prefetch_active[VM_COMPRESSOR_PREFETCH_THREADS];
+
+LCK_GRP_DECLARE(vm_compressor_prefetch_lck_grp, "vm_compressor_prefetch");
+static LCK_SPIN_DECLARE(vm_compressor_prefetch_lock,
+    &vm_compressor_prefetch_lck_grp);
+
+static boolean_t
+vm_compressor_prefetch_covers(
+	struct vm_compressor_prefetch_request   *vcp,
+	vm_object_t                             object,
+	vm_object_offset_t                      offset)
+{
+	return vcp->vcp_object == object &&
+	       offset >= vcp->vcp_start &&
+	       offset < vcp->vcp_end;
+}
+
+/*
+ * Queue a request for [start, end) of "object", unless one that covers
+ * the first page to be prefetched is already queued or in progress.
+ * Returns FALSE if the queue was full.
+ *
+ * The object must be locked exclusively.
+ */
+static boolean_t
+vm_compressor_prefetch_enqueue(
+	vm_object_t             object,
+	vm_object_offset_t      start,
+	vm_object_offset_t      end,
+	boolean_t               reverse)
+{
+	struct vm_compressor_prefetch_request *vcp;
+	vm_object_offset_t      first;
+	boolean_t               wakeup;
+	uint32_t                i;
+
+	vm_object_lock_assert_exclusive(object);
+	first = reverse ? end - PAGE_SIZE_64 : start;
+
+	lck_spin_lock(&vm_compressor_prefetch_lock);
+	for (i = 0; i < VM_COMPRESSOR_PREFETCH_THREADS; i++) {
+		if (vm_compressor_prefetch_covers(
+			    &vm_compressor_prefetch_active[i], object, first)) {
+			lck_spin_unlock(&vm_compressor_prefetch_lock);
+			return TRUE;
+		}
+	}
+	for (i = 0; i < vm_compressor_prefetch_nrequests; i++) {
+		vcp = &vm_compressor_prefetch_queue[(vm_compressor_prefetch_head + i) %
+		    VM_COMPRESSOR_PREFETCH_REQUESTS];
+		if (vm_compressor_prefetch_covers(vcp, object, first)) {
+			lck_spin_unlock(&vm_compressor_prefetch_lock);
+			return TRUE;
+		}
+	}
+	if (vm_compressor_prefetch_nrequests == VM_COMPRESSOR_PREFETCH_REQUESTS) {
+		lck_spin_unlock(&vm_compressor_prefetch_lock);
+		os_atomic_inc(&vm_compressor_prefetch_dropped, relaxed);
+		return FALSE;
+	}
+	vcp = &vm_compressor_prefetch_queue[(vm_compressor_prefetch_head +
+	    vm_compressor_prefetch_nrequests) % VM_COMPRESSOR_PREFETCH_REQUESTS];
+	vm_object_reference_locked(object);
+	vcp->vcp_object = object;
+	vcp->vcp_start = start;
+	vcp->vcp_end = end;
+	vcp->vcp_reverse = reverse;
+	wakeup = (vm_compressor_prefetch_nrequests++ == 0);
+	lck_spin_unlock(&vm_compressor_prefetch_lock);
+
+	os_atomic_inc(&vm_compressor_prefetch_requests, relaxed);
+	if (wakeup) {
+		thread_wakeup((event_t)&vm_compressor_prefetch_nrequests);
+	}
+	return TRUE;
+}
+
+/*
+ * Can pages of "object" be prefetched at all?
+ */
+static boolean_t
+vm_compressor_prefetch_object_ok(vm_object_t object)
+{
+	return object->internal &&
+	       object->alive &&
+	       !object->terminating &&
+	       object->pager_initialized &&
+	       object->pager != MEMORY_OBJECT_NULL &&
+	       (object->wimg_bits & VM_WIMG_MASK) == VM_WIMG_USE_DEFAULT;
+}
+
+/*
+ * Queue whatever is compressed in [start, end) of "object" for
+ * decompression.  Returns TRUE if the range was queued, FALSE if the
+ * object has nothing in the compressor or the range could not be
+ * queued, in which case the caller should fault the pages in itself.
+ *
+ * The object must be locked exclusively.
+ */
+boolean_t
+vm_compressor_prefetch_range(
+	vm_object_t             object,
+	vm_object_offset_t      start,
+	vm_object_offset_t      end)
+{
+	vm_object_offset_t      chunk_end;
+
+	vm_object_lock_assert_exclusive(object);
+
+	if (!vm_compressor_prefetch_enabled ||
+	    !vm_compressor_prefetch_object_ok(object) ||
+	    vm_compressor_pager_get_count(object->pager) == 0) {
+		return FALSE;
+	}
+	start = vm_object_trunc_page(start);
+	end = vm_object_round_page(MIN(end, object->vo_size));
+
+	for (; start < end; start = chunk_end) {
+		chunk_end = MIN(end, start +
+		    VM_COMPRESSOR_PREFETCH_CHUNK * PAGE_SIZE_64);
+		if (!vm_compressor_prefetch_enqueue(object, start, chunk_end, FALSE)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * Called after a fault decompressed the page at "offset" of "object" and
+ * updated the object's sequential access state.  If the fault continues
+ * a sequential run, queue the next window of pages along the run.
+ *
+ * The object must be locked exclusively.
+ */
+void
+vm_compressor_prefetch_refault(
+	vm_object_t             object,
+	vm_object_offset_t      offset)
+{
+	vm_object_offset_t      window, start, end;
+	boolean_t               reverse;
+	int                     sequential, trigger;
+
+	vm_object_lock_assert_exclusive(object);
+
+	window = (vm_object_offset_t)vm_compressor_prefetch_window * PAGE_SIZE_64;
+	if (!vm_compressor_prefetch_enabled || window == 0 ||
+	    !vm_compressor_prefetch_object_ok(object)) {
+		return;
+	}
+	offset = vm_object_trunc_page(offset);
+	sequential = object->sequential;
+	trigger = (int)(VM_COMPRESSOR_PREFETCH_TRIGGER * PAGE_SIZE);
+
+	if (sequential >= trigger) {
+		start = offset + PAGE_SIZE_64;
+		end = MIN(start + window, vm_object_round_page(object->vo_size));
+		reverse = FALSE;
+	} else if (sequential <= -trigger) {
+		end = offset;
+		start = (end > window) ? end - window : 0;
+		reverse = TRUE;
+	} else {
+		return;
+	}
+	if (start < end) {
+		vm_compressor_prefetch_enqueue(object, start, end, reverse);
+	}
+}
+
+/*
+ * Decompress the page at "offset" of "object", if it is in the
+ * compressor and not resident.  Returns FALSE when the rest of the
+ * request should be abandoned.
+ *
+ * The object must be locked exclusively; the lock is dropped while
+ * the page is decompressed.
+ */
+static boolean_t
+vm_compressor_prefetch_page(
+	vm_object_t             object,
+	vm_object_offset_t      offset)
+{
+	memory_object_t         pager;
+	vm_object_offset_t      paging_offset;
+	vm_page_t               m;
+	kern_return_t           kr;
+	int                     my_fault_type;
+	int                     compressed_count_delta;
+
+	if (!vm_compressor_prefetch_object_ok(object)) {
+		return FALSE;
+	}
+	if (vm_page_lookup(object, offset) != VM_PAGE_NULL) {
+		return TRUE;
+	}
+	pager = object->pager;
+	paging_offset = object->paging_offset;
+	if (vm_compressor_pager_state_get(pager, offset + paging_offset) !=
+	    VM_EXTERNAL_STATE_EXISTS) {
+		return TRUE;
+	}
+	if (vm_page_free_count < vm_page_free_target) {
+		return FALSE;
+	}
+	m = vm_page_grab();
+	if (m == VM_PAGE_NULL) {
+		return FALSE;
+	}
+	/* faults on this page wait for us from here on */
+	m->vmp_absent = TRUE;
+	vm_page_insert(m, object, offset);
+	vm_object_paging_begin(object);
+	vm_object_unlock(object);
+
+	kr = vm_compressor_pager_get(pager, offset + paging_offset,
+	    VM_PAGE_GET_PHYS_PAGE(m), &my_fault_type, 0,
+	    &compressed_count_delta);
+
+	vm_object_lock(object);
+	vm_compressor_pager_count(pager, compressed_count_delta,
+	    FALSE, /* shared_lock */
+	    object);
+
+	if (kr == KERN_SUCCESS) {
+		m->vmp_absent = FALSE;
+		m->vmp_dirty = TRUE;
+		m->vmp_written_by_kernel = TRUE;
+		if ((object->purgable != VM_PURGABLE_DENY ||
+		    object->vo_ledger_tag) &&
+		    object->vo_owner != NULL) {
+			/* one less compressed purgeable/tagged page */
+			vm_object_owner_compressed_update(object, -1);
+		}
+		PAGE_WAKEUP_DONE(m);
+
+		vm_page_lockspin_queues();
+		vm_page_activate(m);
+		vm_page_unlock_queues();
+
+		counter_inc(&vm_statistics_decompressions);
+		os_atomic_inc(&vm_compressor_prefetch_pages, relaxed);
+	} else {
+		/* let a real fault sort it out */
+		VM_PAGE_FREE(m);
+	}
+	vm_object_paging_end(object);
+
+	return kr == KERN_SUCCESS;
+}
+
+static void
+vm_compressor_prefetch_run(struct vm_compressor_prefetch_request *vcp)
+{
+	vm_object_t             object = vcp->vcp_object;
+	vm_object_offset_t      offset, next;
+
+	vm_object_lock(object);
+	if (object->ref_count == 1) {
+		/* nobody but us is left to use these pages */
+		vm_object_unlock(object);
+		return;
+	}
+	if (vcp->vcp_reverse) {
+		for (offset = vcp->vcp_end; offset > vcp->vcp_start;) {
+			offset -= PAGE_SIZE_64;
+			if (!vm_compressor_prefetch_page(object, offset)) {
+				break;
+			}
+		}
+	} else {
+		for (offset = vcp->vcp_start; offset < vcp->vcp_end;
+		    offset += PAGE_SIZE_64) {
+			if (!vm_compressor_prefetch_object_ok(object)) {
+				break;
+			}
+			/* skip over what is not in the compressor */
+			next = vm_compressor_pager_next_compressed(object->pager,
+			    offset + object->paging_offset);
+			if (next == (memory_object_offset_t) -1) {
+				break;
+			}
+			offset = next - object->paging_offset;
+			if (offset >= vcp->vcp_end ||
+			    !vm_compressor_prefetch_page(object, offset)) {
+				break;
+			}
+		}
+	}
+	vm_object_unlock(object);
+}
+
+static void
+vm_compressor_prefetch_thread(void *param, __unused wait_result_t wr)
+{
+	struct vm_compressor_prefetch_request *active, vcp;
+
+	active = &vm_compressor_prefetch_active[(uintptr_t)param];
+
+	for (;;) {
+		lck_spin_lock(&vm_compressor_prefetch_lock);
+		active->vcp_object = VM_OBJECT_NULL;
+		if (vm_compressor_prefetch_nrequests == 0) {
+			assert_wait((event_t)&vm_compressor_prefetch_nrequests,
+			    THREAD_UNINT);
+			lck_spin_unlock(&vm_compressor_prefetch_lock);
+			thread_block(THREAD_CONTINUE_NULL);
+			continue;
+		}
+		vcp = vm_compressor_prefetch_queue[vm_compressor_prefetch_head];
+		vm_compressor_prefetch_head = (vm_compressor_prefetch_head + 1) %
+		    VM_COMPRESSOR_PREFETCH_REQUESTS;
+		vm_compressor_prefetch_nrequests--;
+		*active = vcp;
+		lck_spin_unlock(&vm_compressor_prefetch_lock);
+
+		vm_compressor_prefetch_run(&vcp);
+		vm_object_deallocate(vcp.vcp_object);
+	}
+}
+
+void
+vm_compressor_prefetch_init(void)
+{
+	kern_return_t   kr;
+	thread_t        thread;
+	uintptr_t       i;
+
+	for (i = 0; i < VM_COMPRESSOR_PREFETCH_THREADS; i++) {
+		kr = kernel_thread_start_priority(
+			vm_compressor_prefetch_thread,
+			(void *)i,
+			BASEPRI_DEFAULT,
+			&thread);
+		if (kr != KERN_SUCCESS) {
+			panic("failed to launch vm_compressor_prefetch_thread kr=0x%x", kr);
+		}
+		thread_set_thread_name(thread, "VM_compressor_prefetch_thread");
+		thread_deallocate(thread);
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+
+/*
+ *	File:	vm/vm_compressor_prefetch.h
+ *
+ *	Asynchronous decompression of anonymous memory ahead of use.
+ */
+
+#ifndef _VM_VM_COMPRESSOR_PREFETCH_H_
+#define _VM_VM_COMPRESSOR_PREFETCH_H_
+
+#ifdef  MACH_KERNEL_PRIVATE
+
+#include <mach/boolean.h>
+#include <vm/vm_object.h>
+
+extern int              vm_compressor_prefetch_enabled;
+extern unsigned int     vm_compressor_prefetch_window;
+
+extern uint64_t         vm_compressor_prefetch_requests;
+extern uint64_t         vm_compressor_prefetch_dropped;
+extern uint64_t         vm_compressor_prefetch_pages;
+
+extern void             vm_compressor_prefetch_init(void);
+
+extern boolean_t        vm_compressor_prefetch_range(
+	vm_object_t             object,
+	vm_object_offset_t      start,
+	vm_object_offset_t      end);
+
+extern void             vm_compressor_prefetch_refault(
+	vm_object_t             object,
+	vm_object_offset_t      offset);
+
+#endif  /* MACH_KERNEL_PRIVATE */
+
+#endif  /* _VM_VM_COMPRESSOR_PREFETCH_H_ */
@@ -90,9 +90,11 @@
 
 #include <vm/vm_compressor.h>
 #include <vm/vm_compressor_pager.h>
+#include <vm/vm_compressor_prefetch.h>
 #include <vm/vm_fault.h>
 #include <vm/vm_map.h>
 #include <vm/vm_object.h>
+#include <vm/vm_object_collapser.h>
 #include <vm/vm_page.h>
 #include <vm/vm_kern.h>
 #include <vm/pmap.h>
@@ -102,6 +104,7 @@
 #include <vm/memory_object.h>
 #include <vm/vm_purgeable_internal.h>   /* Needed by some vm_page.h macros */
 #include <vm/vm_shared_region.h>
+#include <vm/vm_superpage.h>
 
 #include <sys/codesign.h>
 #include <sys/reason.h>
@@ -109,6 +112,10 @@
 
 #include <san/kasan.h>
 
+#if CONFIG_PHANTOM_CACHE
+#include <vm/vm_phantom_cache.h>
+#endif
+
 #define VM_FAULT_CLASSIFY       0
 
 #define TRACEFAULTPAGE 0 /* (TEST/DEBUG) */
@@ -799,12 +806,13 @@ vm_fault_enqueue_throttled_locked(vm_page_t m)
 /*
  * do the work to zero fill a page and
  * inject it into the correct paging queue
+ * ("prezeroed": m came from vm_page_alloc_zeroed() already zeroed)
  *
  * m->vmp_object must be locked
  * page queue lock must NOT be held
  */
 static int
-vm_fault_zero_page(vm_page_t m, boolean_t no_zero_fill)
+vm_fault_zero_page(vm_page_t m, boolean_t no_zero_fill, boolean_t prezeroed)
 {
 	int my_fault = DBG_ZERO_FILL_FAULT;
 	vm_object_t     object;
@@ -836,7 +844,9 @@ vm_fault_zero_page(vm_page_t m, boolean_t no_zero_fill)
 			return my_fault;
 		}
 	} else {
-		vm_page_zero_fill(m);
+		if (!prezeroed) {
+			vm_page_zero_fill(m);
+		}
 
 		counter_inc(&vm_statistics_zero_fill_count);
 		DTRACE_VM2(zfod, int, 1, (uint64_t *), NULL);
@@ -1279,7 +1289,7 @@ vm_fault_page(
 					 * zero-fill the page and put it on
 					 * the correct paging queue
 					 */
-					my_fault = vm_fault_zero_page(m, no_zero_fill);
+					my_fault = vm_fault_zero_page(m, no_zero_fill, FALSE);
 
 					break;
 				} else {
@@ -1931,7 +1941,7 @@ dont_look_for_page:
 				m->vmp_absent = TRUE;
 			}
 
-			my_fault = vm_fault_zero_page(m, no_zero_fill);
+			my_fault = vm_fault_zero_page(m, no_zero_fill, FALSE);
 
 			break;
 		} else {
@@ -2394,6 +2404,10 @@ done:
 			vm_fault_deactivate_behind(object, offset, fault_info->behavior);
 		} else if (my_fault == DBG_COMPRESSOR_FAULT || my_fault == DBG_COMPRESSOR_SWAPIN_FAULT) {
 			VM_STAT_DECOMPRESSIONS();
+
+			/* decompress ahead of a sequential run */
+			vm_fault_is_sequential(object, offset, fault_info->behavior);
+			vm_compressor_prefetch_refault(object, m->vmp_offset);
 		}
 		if (type_of_fault) {
 			*type_of_fault = my_fault;
@@ -3128,6 +3142,13 @@ MACRO_END
 			} else {
 				__VM_PAGE_LOCKSPIN_QUEUES_IF_NEEDED();
 
+#if CONFIG_PHANTOM_CACHE
+				if (*type_of_fault == DBG_COMPRESSOR_FAULT ||
+				    *type_of_fault == DBG_COMPRESSOR_SWAPIN_FAULT) {
+					/* back from the compressor: a refault */
+					vm_phantom_cache_update(m);
+				}
+#endif
 				/*
 				 * test again now that we hold the
 				 * page queue lock
@@ -3735,6 +3756,283 @@ current_proc_is_privileged(void)
 
 uint64_t vm_copied_on_read = 0;
 
+/*
+ * FAULT-AROUND:
+ * A read fault that hits a resident page also maps the neighbouring
+ * pages of the same object that are already resident, so that a process
+ * walking a file-backed or shared-cache mapping takes one soft fault per
+ * window instead of one per page.  Only pages that could be entered
+ * without any further work are considered: nothing is paged in, copied,
+ * validated or made writable, and anything unusual is left for its own
+ * fault.
+ *
+ * The window is vm_fault_around_pages (rounded down to a power of 2) for
+ * the default behavior, none for VM_BEHAVIOR_RANDOM and the maximum for
+ * the sequential behaviors; a per-entry VM_BEHAVIOR_FAULT_AROUND_*
+ * setting overrides all of these.
+ */
+#define VM_FAULT_AROUND_SMALL_PAGES     4
+#define VM_FAULT_AROUND_MAX_PAGES       32
+
+TUNABLE_WRITEABLE(unsigned int, vm_fault_around_pages, "vm_fault_around_pages", 16);
+
+uint64_t vm_fault_around_mapped = 0;
+
+static unsigned int
+vm_fault_around_window(
+	vm_object_fault_info_t fault_info)
+{
+	unsigned int pages;
+
+	switch (fault_info->fault_around) {
+	case VM_FAULT_AROUND_NONE:
+		return 0;
+	case VM_FAULT_AROUND_SMALL:
+		return VM_FAULT_AROUND_SMALL_PAGES;
+	case VM_FAULT_AROUND_LARGE:
+		return VM_FAULT_AROUND_MAX_PAGES;
+	default:
+		break;
+	}
+
+	switch (fault_info->behavior) {
+	case VM_BEHAVIOR_RANDOM:
+		return 0;
+	case VM_BEHAVIOR_SEQUENTIAL:
+	case VM_BEHAVIOR_RSEQNTL:
+		return VM_FAULT_AROUND_MAX_PAGES;
+	default:
+		pages = MIN(vm_fault_around_pages, VM_FAULT_AROUND_MAX_PAGES);
+		if (pages < 2) {
+			return 0;
+		}
+		/* round down to a power of 2 so the window can be aligned */
+		return 1U << (31 - __builtin_clz(pages));
+	}
+}
+
+/*
+ * Map the resident neighbours of the page just entered at "vaddr".
+ *
+ * Called from the fast path of vm_fault_internal() with the map locked
+ * shared, or from vm_fault_speculative(), and "object" (the top-level
+ * object, which holds the faulting page at "offset") locked, possibly
+ * shared.  Each page is entered read-only with the pmap told not to
+ * block; we stop at the first page the pmap can't take without blocking,
+ * as the fault itself would retry.
+ */
+static void
+vm_fault_around(
+	pmap_t                  pmap,
+	vm_object_t             object,
+	vm_object_offset_t      offset,
+	vm_map_offset_t         vaddr,
+	vm_prot_t               prot,
+	vm_object_fault_info_t  fault_info)
+{
+	vm_map_offset_t         start, end, va;
+	vm_object_offset_t      page_offset;
+	vm_page_t               m;
+	unsigned int            pages;
+	unsigned int            mapped = 0;
+	boolean_t               need_retry;
+	int                     type_of_fault;
+	kern_return_t           kr;
+
+	pages = vm_fault_around_window(fault_info);
+	if (pages == 0) {
+		return;
+	}
+
+	/* an aligned window containing vaddr, clipped to the mapping ... */
+	start = vaddr & ~((vm_map_offset_t)pages * PAGE_SIZE - 1);
+	end = start + (vm_map_offset_t)pages * PAGE_SIZE;
+	start = MAX(start, fault_info->map_start);
+	end = MIN(end, fault_info->map_end);
+
+	/* ... and to the part of the object it maps */
+	if (offset - fault_info->lo_offset < vaddr - start) {
+		start = vaddr - (offset - fault_info->lo_offset);
+	}
+	if (fault_info->hi_offset - offset < end - vaddr) {
+		end = vaddr + (fault_info->hi_offset - offset);
+	}
+
+	prot &= ~VM_PROT_WRITE;
+
+	for (va = start; va < end; va += PAGE_SIZE) {
+		if (va == vaddr) {
+			continue;
+		}
+		page_offset = offset + va - vaddr;
+
+		m = vm_page_lookup(object, page_offset);
+		if (m == VM_PAGE_NULL ||
+		    m->vmp_busy ||
+		    m->vmp_unusual ||
+		    m->vmp_fictitious ||
+		    m->vmp_laundry ||
+		    m->vmp_cleaning ||
+		    m->vmp_cs_nx ||
+		    m->vmp_cs_tainted != VMP_CS_ALL_FALSE ||
+		    VM_PAGE_GET_PHYS_PAGE(m) == vm_page_guard_addr) {
+			continue;
+		}
+		if (vm_fault_cs_need_validation(pmap, m, object, PAGE_SIZE, 0)) {
+			continue;
+		}
+		if (pmap_find_phys(pmap, va) != 0) {
+			/* already mapped, possibly by a racing fault */
+			continue;
+		}
+
+		need_retry = FALSE;
+		type_of_fault = DBG_CACHE_HIT_FAULT;
+		kr = vm_fault_enter(m, pmap, va, PAGE_SIZE, 0,
+		    prot, VM_PROT_READ, FALSE, FALSE, VM_KERN_MEMORY_NONE,
+		    fault_info, &need_retry, &type_of_fault);
+		if (kr != KERN_SUCCESS || need_retry) {
+			break;
+		}
+		mapped++;
+	}
+
+	if (mapped) {
+		os_atomic_add(&vm_fault_around_mapped, mapped, relaxed);
+	}
+}
+
+/*
+ * SPECULATIVE FAULTS
+ *
+ * A fault on an entry that one of the last few faults in the same map
+ * looked up is first tried without the map lock, so that faults don't
+ * queue up behind threads that mmap, munmap or mprotect something else
+ * (see struct vm_map_spec for how the recorded entries are kept valid).
+ * Only the simple cases are handled here: a page already resident in the
+ * entry's top-level object, or a zero-fill in an anonymous object that
+ * was never shadowed or paged out.  Anything else, including contention
+ * on the object lock, goes through the regular path.
+ */
+TUNABLE_WRITEABLE(int, vm_fault_speculative_enabled, "vm_fault_speculative", 1);
+
+uint64_t vm_fault_speculative_count = 0;
+
+static boolean_t
+vm_fault_speculative(
+	vm_map_t                map,
+	vm_map_offset_t         vaddr,
+	vm_prot_t               fault_type,
+	int                     interruptible,
+	int                     *type_of_fault)
+{
+	struct vm_map_spec_slot slot;
+	vm_object_fault_info_t  fault_info = &slot.vss_fault_info;
+	vm_object_t             object;
+	vm_object_offset_t      offset;
+	vm_prot_t               prot;
+	vm_page_t               m;
+	uint32_t                bucket;
+	boolean_t               need_retry = FALSE;
+	boolean_t               prezeroed = FALSE;
+	boolean_t               resolved = FALSE;
+	kern_return_t           kr;
+
+	if (!vm_map_spec_fault_begin(map, vaddr, &slot, &bucket)) {
+		return FALSE;
+	}
+
+	prot = slot.vss_prot;
+	if ((fault_type & prot) != fault_type) {
+		/* let the regular path report the failure */
+		goto out;
+	}
+	object = slot.vss_object;
+	offset = fault_info->lo_offset + (vaddr - fault_info->map_start);
+	fault_info->interruptible = interruptible;
+
+	if (!vm_object_lock_try(object)) {
+		goto out;
+	}
+	if (!object->alive ||
+	    object->blocked_access ||
+	    object->phys_contiguous ||
+	    object->code_signed ||
+	    object->purgable != VM_PURGABLE_DENY) {
+		goto unlock;
+	}
+	if (object->copy != VM_OBJECT_NULL || !object->internal) {
+		/* copy delay, or dirtying a file page: needs the regular path */
+		if (fault_type & VM_PROT_WRITE) {
+			goto unlock;
+		}
+		if (object->copy != VM_OBJECT_NULL) {
+			prot &= ~VM_PROT_WRITE;
+		}
+	}
+	if (pmap_has_prot_policy(map->pmap,
+	    fault_info->pmap_options & PMAP_OPTIONS_TRANSLATED_ALLOW_EXECUTE, prot)) {
+		goto unlock;
+	}
+
+	m = vm_page_lookup(object, offset);
+	if (m != VM_PAGE_NULL) {
+		if (m->vmp_busy ||
+		    m->vmp_unusual ||
+		    m->vmp_fictitious ||
+		    m->vmp_laundry ||
+		    m->vmp_cleaning ||
+		    VM_PAGE_GET_PHYS_PAGE(m) == vm_page_guard_addr ||
+		    vm_fault_cs_need_validation(map->pmap, m, object, PAGE_SIZE, 0)) {
+			goto unlock;
+		}
+		*type_of_fault = DBG_CACHE_HIT_FAULT;
+	} else {
+		if (!object->internal ||
+		    object->shadow != VM_OBJECT_NULL ||
+		    object->shadow_severed ||
+		    object->pager_created ||
+		    map->no_zero_fill) {
+			goto unlock;
+		}
+		if (vm_superpage_fill_eligible(map, vaddr, object, offset,
+		    fault_info)) {
+			/* leave it to the regular path, which fills the block */
+			goto unlock;
+		}
+		m = vm_page_alloc_zeroed(object, offset, &prezeroed);
+		if (m == VM_PAGE_NULL) {
+			goto unlock;
+		}
+		*type_of_fault = vm_fault_zero_page(m, FALSE, prezeroed);
+	}
+
+	kr = vm_fault_enter(m, map->pmap, vaddr, PAGE_SIZE, 0,
+	    prot, fault_type, FALSE, FALSE, VM_KERN_MEMORY_NONE,
+	    fault_info, &need_retry, type_of_fault);
+	if (m->vmp_busy) {
+		/* the page we just zero-filled */
+		PAGE_WAKEUP_DONE(m);
+	}
+	if (kr == KERN_SUCCESS && !need_retry) {
+		resolved = TRUE;
+		if (!(fault_type & VM_PROT_WRITE) &&
+		    *type_of_fault == DBG_CACHE_HIT_FAULT) {
+			vm_fault_around(map->pmap, object, offset, vaddr, prot,
+			    fault_info);
+		}
+	}
+
+unlock:
+	vm_object_unlock(object);
+out:
+	vm_map_spec_fault_end(map, bucket);
+	if (resolved) {
+		os_atomic_inc(&vm_fault_speculative_count, relaxed);
+	}
+	return resolved;
+}
+
 /*
  * Cleanup after a vm_fault_enter.
  * At this point, the fault should either have failed (kr != KERN_SUCCESS)
@@ -3903,6 +4201,7 @@ vm_fault_internal(
 	vm_object_offset_t      cur_offset;
 	vm_page_t               cur_m;
 	vm_object_t             new_object;
+	unsigned int            shadow_depth;
 	int                     type_of_fault;
 	pmap_t                  pmap;
 	wait_interrupt_t        interruptible_state;
@@ -3915,6 +4214,7 @@ vm_fault_internal(
 	bool                    need_collapse = FALSE;
 	boolean_t               need_retry = FALSE;
 	boolean_t               *need_retry_ptr = NULL;
+	boolean_t               prezeroed = FALSE;
 	uint8_t                 object_lock_type = 0;
 	uint8_t                 cur_object_lock_type;
 	vm_object_t             top_object = VM_OBJECT_NULL;
@@ -4025,6 +4325,22 @@ vm_fault_internal(
 			}
 		}
 	}
+
+	if (vm_fault_speculative_enabled &&
+	    !change_wiring &&
+	    caller_pmap == PMAP_NULL &&
+	    physpage_p == NULL &&
+	    map->pmap != kernel_pmap &&
+	    fault_page_size == PAGE_SIZE &&
+	    (fault_type & ~(VM_PROT_READ | VM_PROT_WRITE)) == 0) {
+		type_of_fault = DBG_CACHE_HIT_FAULT;
+		if (vm_fault_speculative(map, vaddr, fault_type,
+		    interruptible, &type_of_fault)) {
+			need_copy_on_read = FALSE;
+			kr = KERN_SUCCESS;
+			goto done;
+		}
+	}
 RetryFault:
 	assert(written_on_object == VM_OBJECT_NULL);
 
@@ -4076,6 +4392,16 @@ RetryFault:
 	fault_info.mark_zf_absent = FALSE;
 	fault_info.batch_pmap_op = FALSE;
 
+	if (fault_info.spec_eligible &&
+	    vm_fault_speculative_enabled &&
+	    map == original_map &&
+	    real_map == map &&
+	    caller_pmap == PMAP_NULL &&
+	    map->pmap != kernel_pmap &&
+	    fault_page_size == PAGE_SIZE) {
+		vm_map_spec_fault_record(map, object, prot, &fault_info);
+	}
+
 	if (resilient_media_retry) {
 		/*
 		 * We're retrying this fault after having detected a media
@@ -4207,6 +4533,7 @@ RetryFault:
 
 	cur_object = object;
 	cur_offset = offset;
+	shadow_depth = 0;
 
 	grab_options = 0;
 #if CONFIG_SECLUDED_MEMORY
@@ -4595,6 +4922,21 @@ FastPmapEnter:
 					    &type_of_fault);
 				}
 
+				if (kr == KERN_SUCCESS &&
+				    !need_retry &&
+				    top_object == VM_OBJECT_NULL &&
+				    caller_pmap == PMAP_NULL &&
+				    physpage_p == NULL &&
+				    !wired &&
+				    !change_wiring &&
+				    !(fault_type & VM_PROT_WRITE) &&
+				    fault_page_size == PAGE_SIZE &&
+				    type_of_fault == DBG_CACHE_HIT_FAULT &&
+				    !pmap_has_prot_policy(pmap, fault_info.pmap_options & PMAP_OPTIONS_TRANSLATED_ALLOW_EXECUTE, prot)) {
+					vm_fault_around(pmap, object, offset,
+					    vaddr, prot, &fault_info);
+				}
+
 				vm_fault_complete(
 					map,
 					real_map,
@@ -5030,6 +5372,12 @@ FastPmapEnter:
 
 					VM_STAT_DECOMPRESSIONS();
 
+					if (object == cur_object || insert_cur_object) {
+						/* decompress ahead of a sequential run */
+						vm_fault_is_sequential(m_object, m->vmp_offset, fault_info.behavior);
+						vm_compressor_prefetch_refault(m_object, m->vmp_offset);
+					}
+
 					if (cur_object != object) {
 						if (insert_cur_object) {
 							top_object = object;
@@ -5100,7 +5448,26 @@ FastPmapEnter:
 				if (!object->internal) {
 					panic("%s:%d should not zero-fill page at offset 0x%llx in external object %p", __FUNCTION__, __LINE__, (uint64_t)offset, object);
 				}
-				m = vm_page_alloc(object, vm_object_trunc_page(offset));
+				if (caller_pmap == PMAP_NULL &&
+				    map == real_map &&
+				    !wired &&
+				    !change_wiring &&
+				    fault_page_size == PAGE_SIZE &&
+				    vm_superpage_fill(map, vaddr, object,
+				    vm_object_trunc_page(offset), &fault_info) == KERN_SUCCESS) {
+					/*
+					 * the whole 2MB block around this page
+					 * is now resident and zero-filled
+					 */
+					m = vm_page_lookup(object, vm_object_trunc_page(offset));
+					assert(m != VM_PAGE_NULL);
+					m_object = object;
+					m->vmp_pmapped = TRUE;
+					type_of_fault = DBG_ZERO_FILL_FAULT;
+					goto FastPmapEnter;
+				}
+				m = vm_page_alloc_zeroed(object,
+				    vm_object_trunc_page(offset), &prezeroed);
 				m_object = NULL;
 
 				if (m == VM_PAGE_NULL) {
@@ -5181,7 +5548,9 @@ FastPmapEnter:
 						 *   NOTE: This code holds the map
 						 *   lock across the zero fill.
 						 */
-						vm_page_zero_fill(m);
+						if (!prezeroed) {
+							vm_page_zero_fill(m);
+						}
 						counter_inc(&vm_statistics_zero_fill_count);
 						DTRACE_VM2(zfod, int, 1, (uint64_t *), NULL);
 					}
@@ -5284,6 +5653,12 @@ zero_fill_cleanup:
 
 			cur_object = new_object;
 
+			if (++shadow_depth > current_task()->task_shadow_depth_max ||
+			    shadow_depth == vm_object_collapser_depth) {
+				vm_object_collapser_fault(object, object_lock_type,
+				    shadow_depth);
+			}
+
 			continue;
 		}
 	}
@@ -90,6 +90,7 @@
 #include <vm/cpm.h>
 #include <vm/vm_compressor.h>
 #include <vm/vm_compressor_pager.h>
+#include <vm/vm_compressor_prefetch.h>
 #include <vm/vm_init.h>
 #include <vm/vm_fault.h>
 #include <vm/vm_map.h>
@@ -467,16 +468,24 @@ vm_map_lock_read_to_write(vm_map_t map)
 {
 	if (lck_rw_lock_shared_to_exclusive(&(map)->lock)) {
 		DTRACE_VM(vm_map_lock_upgrade);
+		vm_map_spec_write_begin(map);
 		return 0;
 	}
 	return 1;
 }
 
+static boolean_t vm_map_spec_write_try_begin(vm_map_t map);
+
 __attribute__((always_inline))
 boolean_t
 vm_map_try_lock(vm_map_t map)
 {
 	if (lck_rw_try_lock_exclusive(&(map)->lock)) {
+		if (!vm_map_spec_write_try_begin(map)) {
+			/* a speculative fault is still running: don't wait for it */
+			lck_rw_done(&(map)->lock);
+			return FALSE;
+		}
 		DTRACE_VM(vm_map_lock_w);
 		return TRUE;
 	}
@@ -494,6 +503,267 @@ vm_map_try_lock_read(vm_map_t map)
 	return FALSE;
 }
 
+/*
+ * Speculative fault support (see struct vm_map_spec).
+ *
+ * A fault registers in the in-flight bucket of the sequence it started
+ * under.  Odd sequence 2k-1 and the even sequence 2k that follows it
+ * share a bucket, so a writer entering sequence 2k+1 drains the bucket
+ * of 2k-1 and 2k, and new faults go to the other one.
+ */
+#define VM_MAP_SPEC_BUCKET(seq)         ((((seq) + 1) >> 1) & 1)
+
+static void
+vm_map_spec_drain(
+	struct vm_map_spec      *spec,
+	uint32_t                bucket)
+{
+	uint32_t collisions = 0;
+
+	while (os_atomic_load(&spec->vms_inflight[bucket], seq_cst) != 0) {
+		mutex_pause(collisions++);
+	}
+}
+
+static uint32_t
+vm_map_spec_open(
+	struct vm_map_spec      *spec)
+{
+	uint32_t seq;
+
+	seq = os_atomic_load(&spec->vms_seq, relaxed);
+	assert((seq & 1) == 0);
+	spec->vms_ranged = FALSE;
+	os_atomic_store(&spec->vms_start, 0, relaxed);
+	os_atomic_store(&spec->vms_end, (vm_map_offset_t)-1, relaxed);
+	os_atomic_store(&spec->vms_seq, seq + 1, seq_cst);
+	return seq;
+}
+
+/*
+ * Called with the map just locked exclusively: wait for the speculative
+ * faults that could have seen the map as it was.
+ */
+void
+vm_map_spec_write_begin(
+	vm_map_t        map)
+{
+	uint32_t seq;
+
+	seq = vm_map_spec_open(&map->spec);
+	vm_map_spec_drain(&map->spec, VM_MAP_SPEC_BUCKET(seq));
+}
+
+static boolean_t
+vm_map_spec_write_try_begin(
+	vm_map_t        map)
+{
+	uint32_t seq;
+
+	seq = vm_map_spec_open(&map->spec);
+	if (os_atomic_load(&map->spec.vms_inflight[VM_MAP_SPEC_BUCKET(seq)],
+	    seq_cst) != 0) {
+		/* nothing has changed: close the session again */
+		vm_map_spec_write_end(map);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Called before the map is unlocked or downgraded: forget every recorded
+ * entry that this session may have changed.  Ranges are compared
+ * inclusively, since clipping or coalescing can change an entry that
+ * only touches the range.
+ */
+void
+vm_map_spec_write_end(
+	vm_map_t        map)
+{
+	struct vm_map_spec      *spec = &map->spec;
+	struct vm_map_spec_slot *slot;
+	uint32_t                seq, sseq;
+	int                     i;
+
+	seq = os_atomic_load(&spec->vms_seq, relaxed);
+	if ((seq & 1) == 0) {
+		return;
+	}
+	for (i = 0; i < VM_MAP_SPEC_SLOTS; i++) {
+		slot = &spec->vms_slots[i];
+		if (slot->vss_object == VM_OBJECT_NULL ||
+		    slot->vss_fault_info.map_start > spec->vms_end ||
+		    slot->vss_fault_info.map_end < spec->vms_start) {
+			continue;
+		}
+		sseq = os_atomic_load(&slot->vss_seq, relaxed);
+		assert((sseq & 1) == 0);
+		os_atomic_store(&slot->vss_seq, sseq + 1, relaxed);
+		os_atomic_thread_fence(release);
+		slot->vss_object = VM_OBJECT_NULL;
+		slot->vss_fault_info.map_start = 0;
+		slot->vss_fault_info.map_end = 0;
+		os_atomic_store(&slot->vss_seq, sseq + 2, release);
+	}
+	os_atomic_store(&spec->vms_seq, seq + 1, release);
+}
+
+/*
+ * Narrow the range the current writer may change to [start, end], or
+ * widen it to cover [start, end] as well.  Nothing must have been
+ * changed outside of the resulting range during this session.
+ */
+void
+vm_map_spec_write_range(
+	vm_map_t        map,
+	vm_map_offset_t start,
+	vm_map_offset_t end)
+{
+	struct vm_map_spec      *spec = &map->spec;
+	uint32_t                seq;
+
+	vm_map_lock_assert_exclusive(map);
+	seq = os_atomic_load(&spec->vms_seq, relaxed);
+	assert(seq & 1);
+
+	if (!spec->vms_ranged) {
+		/* faults see [start, -1] in between: still a superset */
+		spec->vms_ranged = TRUE;
+		os_atomic_store(&spec->vms_start, start, release);
+		os_atomic_store(&spec->vms_end, end, release);
+		return;
+	}
+	if (start >= spec->vms_start && end <= spec->vms_end) {
+		return;
+	}
+	/*
+	 * Faults that checked their entry against the old range may be
+	 * using one in the new range: move to a new sequence and wait for
+	 * them.
+	 */
+	os_atomic_store(&spec->vms_start, MIN(start, spec->vms_start), relaxed);
+	os_atomic_store(&spec->vms_end, MAX(end, spec->vms_end), relaxed);
+	os_atomic_store(&spec->vms_seq, seq + 2, seq_cst);
+	vm_map_spec_drain(spec, VM_MAP_SPEC_BUCKET(seq));
+}
+
+/*
+ * Find the recorded entry covering "vaddr" and copy it to "snap".
+ * On success the caller may use the entry's object (not locked, not
+ * referenced) until it calls vm_map_spec_fault_end() with "*bucketp".
+ */
+boolean_t
+vm_map_spec_fault_begin(
+	vm_map_t                map,
+	vm_map_offset_t         vaddr,
+	struct vm_map_spec_slot *snap,
+	uint32_t                *bucketp)
+{
+	struct vm_map_spec      *spec = &map->spec;
+	struct vm_map_spec_slot *slot;
+	uint32_t                seq, sseq, bucket;
+	vm_map_offset_t         start, end;
+	int                     i;
+
+	seq = os_atomic_load(&spec->vms_seq, relaxed);
+	bucket = VM_MAP_SPEC_BUCKET(seq);
+	os_atomic_inc(&spec->vms_inflight[bucket], seq_cst);
+	if (os_atomic_load(&spec->vms_seq, seq_cst) != seq) {
+		goto fail;
+	}
+
+	for (i = 0; i < VM_MAP_SPEC_SLOTS; i++) {
+		slot = &spec->vms_slots[i];
+		sseq = os_atomic_load(&slot->vss_seq, acquire);
+		if ((sseq & 1) ||
+		    vaddr < slot->vss_fault_info.map_start ||
+		    vaddr >= slot->vss_fault_info.map_end) {
+			continue;
+		}
+		*snap = *slot;
+		os_atomic_thread_fence(acquire);
+		if (os_atomic_load(&slot->vss_seq, relaxed) != sseq ||
+		    snap->vss_object == VM_OBJECT_NULL ||
+		    vaddr < snap->vss_fault_info.map_start ||
+		    vaddr >= snap->vss_fault_info.map_end) {
+			continue;
+		}
+		break;
+	}
+	if (i == VM_MAP_SPEC_SLOTS) {
+		goto fail;
+	}
+
+	if (seq & 1) {
+		/* a writer is active: stay out of its way */
+		end = os_atomic_load(&spec->vms_end, acquire);
+		start = os_atomic_load(&spec->vms_start, relaxed);
+		if (snap->vss_fault_info.map_start <= end &&
+		    snap->vss_fault_info.map_end >= start) {
+			goto fail;
+		}
+	}
+
+	*bucketp = bucket;
+	return TRUE;
+
+fail:
+	os_atomic_dec(&spec->vms_inflight[bucket], release);
+	return FALSE;
+}
+
+void
+vm_map_spec_fault_end(
+	vm_map_t        map,
+	uint32_t        bucket)
+{
+	os_atomic_dec(&map->spec.vms_inflight[bucket], release);
+}
+
+/*
+ * Record the entry a fault just looked up, so that the next faults on it
+ * can be handled speculatively.  The map must still be locked from the
+ * lookup.
+ */
+void
+vm_map_spec_fault_record(
+	vm_map_t                map,
+	vm_object_t             object,
+	vm_prot_t               prot,
+	vm_object_fault_info_t  fault_info)
+{
+	struct vm_map_spec      *spec = &map->spec;
+	struct vm_map_spec_slot *slot;
+	uint32_t                sseq;
+	int                     i;
+
+	vm_map_lock_assert_held(map);
+
+	for (i = 0; i < VM_MAP_SPEC_SLOTS; i++) {
+		slot = &spec->vms_slots[i];
+		if (slot->vss_object == object &&
+		    slot->vss_fault_info.lo_offset == fault_info->lo_offset &&
+		    slot->vss_prot == prot &&
+		    slot->vss_fault_info.map_start == fault_info->map_start &&
+		    slot->vss_fault_info.map_end == fault_info->map_end) {
+			return;
+		}
+	}
+
+	i = os_atomic_inc_orig(&spec->vms_next_slot, relaxed) % VM_MAP_SPEC_SLOTS;
+	slot = &spec->vms_slots[i];
+	sseq = os_atomic_load(&slot->vss_seq, relaxed);
+	if ((sseq & 1) ||
+	    !os_atomic_cmpxchg(&slot->vss_seq, sseq, sseq + 1, acquire)) {
+		/* another fault is filling it */
+		return;
+	}
+	slot->vss_prot = prot;
+	slot->vss_object = object;
+	slot->vss_fault_info = *fault_info;
+	os_atomic_store(&slot->vss_seq, sseq + 2, release);
+}
+
 /*
  * Routines to get the page size the caller should
  * use while inspecting the target address space.
@@ -1904,6 +2174,7 @@ vm_map_find_space(
 	} else {
 		new_entry->vme_atomic = FALSE;
 	}
+	new_entry->vme_fault_around = VM_FAULT_AROUND_DEFAULT;
 
 	VME_ALIAS_SET(new_entry, tag);
 
@@ -2665,6 +2936,9 @@ StartAgain:;
 		*address = start;
 		assert(VM_MAP_PAGE_ALIGNED(*address,
 		    VM_MAP_PAGE_MASK(map)));
+		if (!keep_map_locked) {
+			vm_map_spec_write_range(map, start, end);
+		}
 	} else {
 		if (VM_MAP_PAGE_SHIFT(map) < PAGE_SHIFT &&
 		    !overwrite &&
@@ -2700,6 +2974,9 @@ StartAgain:;
 		    (start >= end)) {
 			RETURN(KERN_INVALID_ADDRESS);
 		}
+		if (!keep_map_locked) {
+			vm_map_spec_write_range(map, start, end);
+		}
 
 		if (overwrite && zap_old_map != VM_MAP_NULL) {
 			int remove_flags;
@@ -2894,6 +3171,7 @@ StartAgain:;
 	    (!entry->vme_resilient_media) &&
 	    (!entry->vme_atomic) &&
 	    (entry->vme_no_copy_on_read == no_copy_on_read) &&
+	    (entry->vme_fault_around == VM_FAULT_AROUND_DEFAULT) &&
 
 	    ((entry->vme_end - entry->vme_start) + size <=
 	    (user_alias == VM_MEMORY_REALLOC ?
@@ -5893,6 +6171,7 @@ vm_map_protect(
 	if (entry->superpage_size) {
 		end = SUPERPAGE_ROUND_UP(end);
 	}
+	vm_map_spec_write_range(map, start, end);
 
 	/*
 	 *	Make a first pass to check for protection and address
@@ -7707,6 +7986,7 @@ vm_map_delete(
 	__unused vm_map_offset_t save_end = end;
 	const vm_map_offset_t   FIND_GAP = 1;   /* a not page aligned value */
 	const vm_map_offset_t   GAPS_OK = 2;    /* a different not page aligned value */
+	boolean_t               spec_ranged = map->spec.vms_ranged;
 
 	if (map != kernel_map && !(flags & VM_MAP_REMOVE_GAPS_OK) && !map->terminated) {
 		gap_start = FIND_GAP;
@@ -7812,6 +8092,14 @@ vm_map_delete(
 	if (entry->superpage_size) {
 		end = SUPERPAGE_ROUND_UP(end);
 	}
+	/*
+	 * Superpages may have grown the range our caller advertised to
+	 * speculative faults, and it has to be advertised again each time
+	 * we relock the map below.
+	 */
+	if (spec_ranged) {
+		vm_map_spec_write_range(map, start, end);
+	}
 
 	need_wakeup = FALSE;
 	/*
@@ -7957,6 +8245,9 @@ vm_map_delete(
 			}
 
 			wait_result = vm_map_entry_wait(map, interruptible);
+			if (spec_ranged) {
+				vm_map_spec_write_range(map, start, end);
+			}
 
 			if (interruptible &&
 			    wait_result == THREAD_INTERRUPTED) {
@@ -8025,6 +8316,9 @@ vm_map_delete(
 					entry->needs_wakeup = TRUE;
 					wait_result = vm_map_entry_wait(map,
 					    interruptible);
+					if (spec_ranged) {
+						vm_map_spec_write_range(map, start, end);
+					}
 
 					if (interruptible &&
 					    wait_result == THREAD_INTERRUPTED) {
@@ -8115,6 +8409,9 @@ vm_map_delete(
 			}
 
 			vm_map_lock(map);
+			if (spec_ranged) {
+				vm_map_spec_write_range(map, start, end);
+			}
 
 			if (last_timestamp + 1 != map->timestamp) {
 				/*
@@ -8352,6 +8649,9 @@ vm_map_delete(
 			vm_map_entry_delete(map, entry);
 			/* vm_map_entry_delete unlocks the map */
 			vm_map_lock(map);
+			if (spec_ranged) {
+				vm_map_spec_write_range(map, start, end);
+			}
 		}
 
 		entry = next;
@@ -8460,6 +8760,7 @@ vm_map_remove(
 
 	vm_map_lock(map);
 	VM_MAP_RANGE_CHECK(map, start, end);
+	vm_map_spec_write_range(map, start, end);
 	/*
 	 * For the zone maps, the kernel controls the allocation/freeing of memory.
 	 * Any free to the zone maps should be within the bounds of the map and
@@ -13040,6 +13341,8 @@ vm_map_lookup_locked(
 	boolean_t                       submap_needed_copy;
 	vm_prot_t                       original_fault_type;
 	vm_map_size_t                   fault_page_mask;
+	unsigned int                    old_fault_around = VM_FAULT_AROUND_DEFAULT;
+	int                             submap_depth = 0;
 
 	/*
 	 * VM_PROT_MASK means that the caller wants us to use "fault_type"
@@ -13093,6 +13396,8 @@ RetryLookup:
 	if (map == old_map) {
 		old_start = entry->vme_start;
 		old_end = entry->vme_end;
+		old_fault_around = entry->vme_fault_around;
+		submap_depth = 0;
 	}
 
 	/*
@@ -13121,6 +13426,7 @@ submap_recurse:
 		    VME_SUBMAP(entry), VM_MAP_PAGE_SHIFT(VME_SUBMAP(entry)));
 
 		local_vaddr = vaddr;
+		submap_depth++;
 
 		if ((entry->use_pmap &&
 		    !((fault_type & VM_PROT_WRITE) ||
@@ -13152,6 +13458,7 @@ submap_recurse:
 				old_end = entry->vme_end;
 				cow_parent_vaddr = vaddr;
 				mapped_needs_copy = TRUE;
+				old_fault_around = VM_FAULT_AROUND_NONE;
 			} else {
 				vm_map_lock_read(VME_SUBMAP(entry));
 				*var_map = VME_SUBMAP(entry);
@@ -13711,6 +14018,7 @@ protection_failure:
 				vm_map_lock_read(map);
 				goto RetryLookup;
 			}
+			vm_map_spec_write_range(map, entry->vme_start, entry->vme_end);
 
 			if (VME_OBJECT(entry)->shadowed == FALSE) {
 				vm_object_lock(VME_OBJECT(entry));
@@ -13755,6 +14063,7 @@ protection_failure:
 			vm_map_lock_read(map);
 			goto RetryLookup;
 		}
+		vm_map_spec_write_range(map, entry->vme_start, entry->vme_end);
 
 		VME_OBJECT_SET(entry,
 		    vm_object_allocate(
@@ -13813,6 +14122,35 @@ protection_failure:
 		fault_info->batch_pmap_op = FALSE;
 		fault_info->resilient_media = entry->vme_resilient_media;
 		fault_info->no_copy_on_read = entry->vme_no_copy_on_read;
+		/*
+		 * Fault-around follows the setting of the entry in the
+		 * faulting map, or of the submap entry if that one was
+		 * left at the default, and is bounded by the range the
+		 * former maps.  old_start/old_end only track that range exactly
+		 * through a single level of submap, and not at all once
+		 * they have been rebased for a copy-on-write submap.
+		 */
+		if (submap_depth > 1) {
+			fault_info->fault_around = VM_FAULT_AROUND_NONE;
+		} else if (old_fault_around != VM_FAULT_AROUND_DEFAULT) {
+			fault_info->fault_around = old_fault_around;
+		} else {
+			fault_info->fault_around = entry->vme_fault_around;
+		}
+		fault_info->map_start = old_start;
+		fault_info->map_end = old_end;
+		/*
+		 * Only a plain entry of the faulting map, which the next
+		 * faults could resolve without looking it up again.
+		 */
+		fault_info->spec_eligible = (submap_depth == 0 &&
+		    *object != VM_OBJECT_NULL &&
+		    !entry->needs_copy &&
+		    !entry->in_transition &&
+		    entry->wired_count == 0 &&
+		    !entry->used_for_jit &&
+		    !entry->superpage_size &&
+		    !entry->vme_resilient_media);
 		if (entry->translated_allow_execute) {
 			fault_info->pmap_options |= PMAP_OPTIONS_TRANSLATED_ALLOW_EXECUTE;
 		}
@@ -15073,6 +15411,7 @@ vm_map_simplify_entry(
 	    (prev_entry->vme_resilient_media ==
 	    this_entry->vme_resilient_media) &&
 	    (prev_entry->vme_no_copy_on_read == this_entry->vme_no_copy_on_read) &&
+	    (prev_entry->vme_fault_around == this_entry->vme_fault_around) &&
 
 	    (prev_entry->wired_count == this_entry->wired_count) &&
 	    (prev_entry->user_wired_count == this_entry->user_wired_count) &&
@@ -15338,6 +15677,10 @@ vm_map_behavior_set(
 	case VM_BEHAVIOR_SEQUENTIAL:
 	case VM_BEHAVIOR_RSEQNTL:
 	case VM_BEHAVIOR_ZERO_WIRED_PAGES:
+	case VM_BEHAVIOR_FAULT_AROUND_DEFAULT:
+	case VM_BEHAVIOR_FAULT_AROUND_NONE:
+	case VM_BEHAVIOR_FAULT_AROUND_SMALL:
+	case VM_BEHAVIOR_FAULT_AROUND_LARGE:
 		vm_map_lock(map);
 
 		/*
@@ -15363,6 +15706,9 @@ vm_map_behavior_set(
 
 			if (new_behavior == VM_BEHAVIOR_ZERO_WIRED_PAGES) {
 				entry->zero_wired_pages = TRUE;
+			} else if (new_behavior >= VM_BEHAVIOR_FAULT_AROUND_DEFAULT) {
+				entry->vme_fault_around = new_behavior -
+				    VM_BEHAVIOR_FAULT_AROUND_DEFAULT;
 			} else {
 				entry->behavior = new_behavior;
 			}
@@ -15512,23 +15858,58 @@ vm_map_willneed(
 			 */
 			vm_size_t region_size = 0, effective_page_size = 0;
 			vm_map_offset_t addr = 0, effective_page_mask = 0;
+			vm_object_t prefetch_object = VM_OBJECT_NULL;
 
 			region_size = len;
 			addr = start;
 
+			if (object != VM_OBJECT_NULL) {
+				/*
+				 * If some of it is in the compressor, leave the
+				 * compressed pages to the prefetch threads rather
+				 * than taking one decompression fault per page
+				 * here.  The zero-fill and shadowed pages are
+				 * still faulted in below.
+				 */
+				vm_object_lock(object);
+				if (vm_compressor_prefetch_range(object, offset, offset + len)) {
+					vm_object_reference_locked(object);
+					prefetch_object = object;
+				}
+				vm_object_unlock(object);
+			}
+
 			effective_page_mask = MIN(vm_map_page_mask(current_map()), PAGE_MASK);
 			effective_page_size = effective_page_mask + 1;
 
 			vm_map_unlock_read(map);
 
 			while (region_size) {
-				vm_pre_fault(
-					vm_map_trunc_page(addr, effective_page_mask),
-					VM_PROT_READ | VM_PROT_WRITE);
+				boolean_t compressed = FALSE;
+
+				if (prefetch_object != VM_OBJECT_NULL) {
+					vm_object_offset_t obj_off;
+
+					obj_off = vm_object_trunc_page(offset + (addr - start));
+					vm_object_lock(prefetch_object);
+					compressed =
+					    vm_page_lookup(prefetch_object, obj_off) == VM_PAGE_NULL &&
+					    VM_COMPRESSOR_PAGER_STATE_GET(prefetch_object, obj_off) ==
+					    VM_EXTERNAL_STATE_EXISTS;
+					vm_object_unlock(prefetch_object);
+				}
+				if (!compressed) {
+					vm_pre_fault(
+						vm_map_trunc_page(addr, effective_page_mask),
+						VM_PROT_READ | VM_PROT_WRITE);
+				}
 
 				region_size -= effective_page_size;
 				addr += effective_page_size;
 			}
+			if (prefetch_object != VM_OBJECT_NULL) {
+				vm_object_deallocate(prefetch_object);
+			}
 		} else {
 			/*
 			 * Find the file object backing this map entry.  If there is
@@ -16190,6 +16571,7 @@ vm_map_entry_insert(
 	new_entry->vme_resilient_media = FALSE;
 	new_entry->vme_atomic = FALSE;
 	new_entry->vme_no_copy_on_read = no_copy_on_read;
+	new_entry->vme_fault_around = VM_FAULT_AROUND_DEFAULT;
 
 	/*
 	 *	Insert the new entry into the list.
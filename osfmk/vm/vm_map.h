@@ -303,7 +303,7 @@ struct vm_map_entry {
 	/* boolean_t */ vme_atomic:1, /* entry cannot be split/coalesced */
 	/* boolean_t */ vme_no_copy_on_read:1,
 	/* boolean_t */ translated_allow_execute:1, /* execute in translated processes */
-	__unused:2;
+	/* unsigned */ vme_fault_around:2; /* VM_FAULT_AROUND_* */
 
 	unsigned short          wired_count;    /* can be paged if = 0 */
 	unsigned short          user_wired_count; /* for vm_wire */
@@ -322,6 +322,16 @@ struct vm_map_entry {
 #endif
 };
 
+/*
+ * Values of vme_fault_around: how many neighbouring resident pages a
+ * read fault on this entry also maps (see vm_fault_around()).  Set with
+ * the VM_BEHAVIOR_FAULT_AROUND_* behaviors, in the same order.
+ */
+#define VM_FAULT_AROUND_DEFAULT         0       /* vm_fault_around_pages, per behavior */
+#define VM_FAULT_AROUND_NONE            1
+#define VM_FAULT_AROUND_SMALL           2
+#define VM_FAULT_AROUND_LARGE           3
+
 #define VME_SUBMAP_PTR(entry)                   \
 	(&((entry)->vme_object.vmo_submap))
 #define VME_SUBMAP(entry)                                       \
@@ -442,6 +452,53 @@ struct vm_map_header {
 #define VM_MAP_HDR_PAGE_SIZE(hdr) (1 << VM_MAP_HDR_PAGE_SHIFT((hdr)))
 #define VM_MAP_HDR_PAGE_MASK(hdr) (VM_MAP_HDR_PAGE_SIZE((hdr)) - 1)
 
+/*
+ *	Type:		struct vm_map_spec [internal use only]
+ *
+ *	Description:
+ *		State for resolving page faults without the map lock.
+ *
+ *	Implementation:
+ *		Every fault that goes through vm_map_lookup_locked() on a
+ *		plain top-level entry records that entry (its object, and
+ *		the fault info which has its range) in one of a few per-map
+ *		slots.  A later fault that hits a recorded entry can then be
+ *		handled by vm_fault_speculative() without the map lock.
+ *
+ *		"vms_seq" is odd while a thread holds the map exclusively.
+ *		A writer publishes the range it is about to change in
+ *		vms_start/vms_end (the whole map until it says otherwise),
+ *		and when it is done invalidates every slot touching that
+ *		range before making the sequence even again.  Speculative
+ *		faults announce themselves in vms_inflight[] for the sequence
+ *		they started under; a writer waits for the faults of the
+ *		previous sequence to drain before changing anything, so a
+ *		slot can't be torn down under a fault using it.  A fault
+ *		that starts while a writer is active only proceeds if its
+ *		slot is outside the writer's range.
+ *
+ *		Each slot has its own sequence, odd while it is being filled
+ *		or invalidated.
+ */
+#define VM_MAP_SPEC_SLOTS       4
+
+struct vm_map_spec_slot {
+	uint32_t                        vss_seq;
+	vm_prot_t                       vss_prot;       /* as from vm_map_lookup_locked() */
+	vm_object_t                     vss_object;     /* top-level object */
+	struct vm_object_fault_info     vss_fault_info; /* map_start/map_end: the entry */
+};
+
+struct vm_map_spec {
+	uint32_t                vms_seq;
+	uint32_t                vms_inflight[2];        /* faults, by sequence */
+	uint32_t                vms_next_slot;
+	boolean_t               vms_ranged;             /* writer narrowed its range */
+	vm_map_offset_t         vms_start;              /* writer's range, inclusive */
+	vm_map_offset_t         vms_end;
+	struct vm_map_spec_slot vms_slots[VM_MAP_SPEC_SLOTS];
+};
+
 /*
  *	Type:		vm_map_t [exported; contents invisible]
  *
@@ -525,6 +582,7 @@ struct _vm_map {
 	/* boolean_t */ single_jit:1,        /* only allow one JIT mapping */
 	/* reserved */ pad:15;
 	unsigned int            timestamp;      /* Version number */
+	struct vm_map_spec      spec;           /* speculative fault state */
 };
 
 #define CAST_TO_VM_MAP_ENTRY(x) ((struct vm_map_entry *)(uintptr_t)(x))
@@ -641,19 +699,28 @@ vm_map_copy_adjust_to_target(
 
 #define vm_map_lock_init(map)                                           \
 	((map)->timestamp = 0 ,                                         \
+	bzero(&(map)->spec, sizeof((map)->spec)) ,                      \
 	lck_rw_init(&(map)->lock, &vm_map_lck_grp, &vm_map_lck_rw_attr))
 
 #define vm_map_lock(map)                     \
 	MACRO_BEGIN                          \
 	DTRACE_VM(vm_map_lock_w);            \
 	lck_rw_lock_exclusive(&(map)->lock); \
+	vm_map_spec_write_begin(map);        \
 	MACRO_END
 
-#define vm_map_unlock(map)          \
-	MACRO_BEGIN                 \
-	DTRACE_VM(vm_map_unlock_w); \
-	(map)->timestamp++;         \
-	lck_rw_done(&(map)->lock);  \
+/*
+ * Also used to drop a shared lock: the speculative sequence is only
+ * odd while the map is held exclusively.
+ */
+#define vm_map_unlock(map)                   \
+	MACRO_BEGIN                          \
+	DTRACE_VM(vm_map_unlock_w);          \
+	(map)->timestamp++;                  \
+	if ((map)->spec.vms_seq & 1) {       \
+	        vm_map_spec_write_end(map);  \
+	}                                    \
+	lck_rw_done(&(map)->lock);           \
 	MACRO_END
 
 #define vm_map_lock_read(map)             \
@@ -672,9 +739,30 @@ vm_map_copy_adjust_to_target(
 	MACRO_BEGIN                                    \
 	DTRACE_VM(vm_map_lock_downgrade);              \
 	(map)->timestamp++;                            \
+	vm_map_spec_write_end(map);                    \
 	lck_rw_lock_exclusive_to_shared(&(map)->lock); \
 	MACRO_END
 
+extern void vm_map_spec_write_begin(vm_map_t map);
+extern void vm_map_spec_write_end(vm_map_t map);
+extern void vm_map_spec_write_range(
+	vm_map_t                map,
+	vm_map_offset_t         start,
+	vm_map_offset_t         end);
+extern boolean_t vm_map_spec_fault_begin(
+	vm_map_t                map,
+	vm_map_offset_t         vaddr,
+	struct vm_map_spec_slot *snap,
+	uint32_t                *bucketp);
+extern void vm_map_spec_fault_end(
+	vm_map_t                map,
+	uint32_t                bucket);
+extern void vm_map_spec_fault_record(
+	vm_map_t                map,
+	vm_object_t             object,
+	vm_prot_t               prot,
+	vm_object_fault_info_t  fault_info);
+
 __attribute__((always_inline))
 int vm_map_lock_read_to_write(vm_map_t map);
 
@@ -829,9 +917,16 @@ extern vm_object_t      vm_submap_object;
  *	Wait and wakeup macros for in_transition map entries.
  */
 #define vm_map_entry_wait(map, interruptible)           \
-	((map)->timestamp++ ,                           \
-	 lck_rw_sleep(&(map)->lock, LCK_SLEEP_EXCLUSIVE|LCK_SLEEP_PROMOTED_PRI, \
-	                          (event_t)&(map)->hdr,	interruptible))
+	({                                              \
+	        wait_result_t __wr;                     \
+	        (map)->timestamp++;                     \
+	        vm_map_spec_write_end(map);             \
+	        __wr = lck_rw_sleep(&(map)->lock,       \
+	            LCK_SLEEP_EXCLUSIVE|LCK_SLEEP_PROMOTED_PRI, \
+	            (event_t)&(map)->hdr, interruptible); \
+	        vm_map_spec_write_begin(map);           \
+	        __wr;                                   \
+	})
 
 
 #define vm_map_entry_wakeup(map)        \
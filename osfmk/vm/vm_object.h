@@ -129,8 +129,13 @@ struct vm_object_fault_info {
 	/* boolean_t */ batch_pmap_op:1,
 	/* boolean_t */ resilient_media:1,
 	/* boolean_t */ no_copy_on_read:1,
-	    __vm_object_fault_info_unused_bits:23;
+	/* unsigned */ fault_around:2,          /* VM_FAULT_AROUND_* */
+	/* boolean_t */ spec_eligible:1,        /* may be recorded for vm_fault_speculative() */
+	    __vm_object_fault_info_unused_bits:20;
 	int             pmap_options;
+	/* address range of the mapping, in the faulting map */
+	vm_map_offset_t map_start;
+	vm_map_offset_t map_end;
 };
 
 
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+
+/*
+ * Background collapse of deep shadow chains.
+ *
+ * Every fork copies anonymous memory by giving parent and child a new
+ * object each, shadowing the old one, and a process that forks the
+ * process it came from, over and over, ends up at the top of a shadow
+ * chain with one object per generation.  Any fault that doesn't find
+ * its page in the top object walks the chain down until it does.
+ *
+ * vm_object_collapse() can fold an object into the one above it once
+ * nothing else refers to it, or skip it if the object above already
+ * has all its pages, but it only gets called when a reference goes away
+ * or a copy-on-write fault copies a page, and with the locks the fault
+ * path holds it often can't do anything then.  So the fault path tells
+ * us whenever it walks a chain deeper than vm_object_collapser_depth
+ * (vm_object_collapser_fault()), which queues the top object for a
+ * thread that runs at a throttled priority and calls
+ * vm_object_collapse() on it from there.  The thread only try-locks
+ * the object, so it gives up on an object a fault is using rather than
+ * wait for it, and the next deep fault queues it again.
+ *
+ * The fault path also keeps track, per task, of the deepest chain it
+ * walked and of how many faults went deeper than the threshold; they
+ * are reported by task_info(TASK_VM_INFO).
+ */
+
+#include <mach/mach_types.h>
+#include <mach/kern_return.h>
+
+#include <kern/locks.h>
+#include <kern/sched_prim.h>
+#include <kern/task.h>
+#include <kern/thread.h>
+
+#include <vm/vm_object.h>
+#include <vm/vm_object_collapser.h>
+
+TUNABLE_WRITEABLE(int, vm_object_collapser_enabled, "vm_object_collapser", 1);
+/* shadow chain depth at which a fault queues its object for collapse */
+unsigned int vm_object_collapser_depth = 8;
+
+uint64_t vm_object_collapser_requests = 0;
+uint64_t vm_object_collapser_dropped = 0;
+uint64_t vm_object_collapser_busy = 0;
+uint64_t vm_object_collapser_shortened = 0;
+
+#define VM_OBJECT_COLLAPSER_REQUESTS    64
+
+/* each queued object holds a reference */
+static vm_object_t vm_object_collapser_queue[VM_OBJECT_COLLAPSER_REQUESTS];
+static uint32_t vm_object_collapser_head;
+static uint32_t vm_object_collapser_nrequests;
+
+LCK_GRP_DECLARE(vm_object_collapser_lck_grp, "vm_object_collapser");
+static LCK_SPIN_DECLARE(vm_object_collapser_lock,
+    &vm_object_collapser_lck_grp);
+
+/*
+ * Queue "object" for collapse, unless it already is.
+ *
+ * The object must be locked, as described by "object_lock_type".
+ */
+static void
+vm_object_collapser_enqueue(
+	vm_object_t     object,
+	int             object_lock_type)
+{
+	boolean_t       wakeup;
+	uint32_t        i;
+
+	lck_spin_lock(&vm_object_collapser_lock);
+	for (i = 0; i < vm_object_collapser_nrequests; i++) {
+		if (vm_object_collapser_queue[(vm_object_collapser_head + i) %
+		    VM_OBJECT_COLLAPSER_REQUESTS] == object) {
+			lck_spin_unlock(&vm_object_collapser_lock);
+			return;
+		}
+	}
+	if (vm_object_collapser_nrequests == VM_OBJECT_COLLAPSER_REQUESTS) {
+		lck_spin_unlock(&vm_object_collapser_lock);
+		os_atomic_inc(&vm_object_collapser_dropped, relaxed);
+		return;
+	}
+	if (object_lock_type == OBJECT_LOCK_SHARED) {
+		vm_object_reference_shared(object);
+	} else {
+		vm_object_reference_locked(object);
+	}
+	vm_object_collapser_queue[(vm_object_collapser_head +
+	    vm_object_collapser_nrequests) % VM_OBJECT_COLLAPSER_REQUESTS] = object;
+	wakeup = (vm_object_collapser_nrequests++ == 0);
+	lck_spin_unlock(&vm_object_collapser_lock);
+
+	os_atomic_inc(&vm_object_collapser_requests, relaxed);
+	if (wakeup) {
+		thread_wakeup((event_t)&vm_object_collapser_nrequests);
+	}
+}
+
+/*
+ * Called by the fault path each time it goes down the shadow chain of
+ * "object", if "depth", the number of objects it went through below
+ * "object", is either more than the current task has seen so far or
+ * vm_object_collapser_depth.
+ *
+ * The object must be locked, as described by "object_lock_type".
+ */
+void
+vm_object_collapser_fault(
+	vm_object_t     object,
+	int             object_lock_type,
+	unsigned int    depth)
+{
+	task_t          task = current_task();
+
+	os_atomic_max(&task->task_shadow_depth_max, depth, relaxed);
+	if (depth != vm_object_collapser_depth) {
+		return;
+	}
+	os_atomic_inc(&task->task_deep_shadow_faults, relaxed);
+
+	if (vm_object_collapser_enabled &&
+	    object->internal &&
+	    object->alive &&
+	    !object->terminating &&
+	    object->purgable == VM_PURGABLE_DENY) {
+		vm_object_collapser_enqueue(object, object_lock_type);
+	}
+}
+
+static void
+vm_object_collapser_run(vm_object_t object)
+{
+	vm_object_t     shadow;
+
+	if (!vm_object_lock_try(object)) {
+		os_atomic_inc(&vm_object_collapser_busy, relaxed);
+		return;
+	}
+	/* the chain goes away with the object if we hold the last reference */
+	if (object->ref_count > 1 &&
+	    object->alive &&
+	    !object->terminating &&
+	    object->shadow != VM_OBJECT_NULL) {
+		shadow = object->shadow;
+		vm_object_collapse(object, 0, TRUE);
+		if (object->shadow != shadow) {
+			os_atomic_inc(&vm_object_collapser_shortened, relaxed);
+		}
+	}
+	vm_object_unlock(object);
+}
+
+static void
+vm_object_collapser_thread(__unused void *param, __unused wait_result_t wr)
+{
+	vm_object_t     object;
+
+	for (;;) {
+		lck_spin_lock(&vm_object_collapser_lock);
+		if (vm_object_collapser_nrequests == 0) {
+			assert_wait((event_t)&vm_object_collapser_nrequests,
+			    THREAD_UNINT);
+			lck_spin_unlock(&vm_object_collapser_lock);
+			thread_block(THREAD_CONTINUE_NULL);
+			continue;
+		}
+		object = vm_object_collapser_queue[vm_object_collapser_head];
+		vm_object_collapser_head = (vm_object_collapser_head + 1) %
+		    VM_OBJECT_COLLAPSER_REQUESTS;
+		vm_object_collapser_nrequests--;
+		lck_spin_unlock(&vm_object_collapser_lock);
+
+		vm_object_collapser_run(object);
+		vm_object_deallocate(object);
+	}
+}
+
+void
+vm_object_collapser_init(void)
+{
+	kern_return_t   kr;
+	thread_t        thread;
+
+	kr = kernel_thread_start_priority(
+		vm_object_collapser_thread,
+		NULL,
+		MAXPRI_THROTTLE,
+		&thread);
+	if (kr != KERN_SUCCESS) {
+		panic("failed to launch vm_object_collapser_thread kr=0x%x", kr);
+	}
+	thread_set_thread_name(thread, "VM_object_collapser_thread");
+	thread_deallocate(thread);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+
+/*
+ *	File:	vm/vm_object_collapser.h
+ *
+ *	Background collapse of deep shadow chains.
+ */
+
+#ifndef _VM_VM_OBJECT_COLLAPSER_H_
+#define _VM_VM_OBJECT_COLLAPSER_H_
+
+#ifdef  MACH_KERNEL_PRIVATE
+
+#include <mach/boolean.h>
+#include <vm/vm_object.h>
+
+extern int              vm_object_collapser_enabled;
+extern unsigned int     vm_object_collapser_depth;
+
+extern uint64_t         vm_object_collapser_requests;
+extern uint64_t         vm_object_collapser_dropped;
+extern uint64_t         vm_object_collapser_busy;
+extern uint64_t         vm_object_collapser_shortened;
+
+extern void             vm_object_collapser_init(void);
+
+extern void             vm_object_collapser_fault(
+	vm_object_t             object,
+	int                     object_lock_type,
+	unsigned int            depth);
+
+#endif  /* MACH_KERNEL_PRIVATE */
+
+#endif  /* _VM_VM_OBJECT_COLLAPSER_H_ */
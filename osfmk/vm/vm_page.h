@@ -1467,6 +1467,17 @@ extern vm_page_t        vm_page_alloc(
 	vm_object_t             object,
 	vm_object_offset_t      offset);
 
+extern vm_page_t        vm_page_alloc_zeroed(
+	vm_object_t             object,
+	vm_object_offset_t      offset,
+	boolean_t               *zeroed);
+
+extern void             vm_page_zeroed_init(void);
+
+extern void             vm_page_zeroed_drain(void);
+
+extern unsigned int     vm_page_zeroed_count;
+
 extern void             vm_page_init(
 	vm_page_t       page,
 	ppnum_t         phys_page,
@@ -1620,6 +1631,7 @@ extern void memorystatus_pages_update(unsigned int pages_avail);
 	memorystatus_pages_update(              \
 	        vm_page_pageable_external_count + \
 	        vm_page_free_count +            \
+	        vm_page_zeroed_count +          \
 	        VM_PAGE_SECLUDED_COUNT_OVER_TARGET() + \
 	        (VM_DYNAMIC_PAGING_ENABLED() ? 0 : vm_page_purgeable_count) \
 	        ); \
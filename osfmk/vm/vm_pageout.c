@@ -98,15 +98,18 @@
 
 #include <vm/pmap.h>
 #include <vm/vm_compressor_pager.h>
+#include <vm/vm_compressor_prefetch.h>
 #include <vm/vm_fault.h>
 #include <vm/vm_map.h>
 #include <vm/vm_object.h>
+#include <vm/vm_object_collapser.h>
 #include <vm/vm_page.h>
 #include <vm/vm_pageout.h>
 #include <vm/vm_protos.h> /* must be last */
 #include <vm/memory_object.h>
 #include <vm/vm_purgeable_internal.h>
 #include <vm/vm_shared_region.h>
+#include <vm/vm_superpage.h>
 #include <vm/vm_compressor.h>
 
 #include <san/kasan.h>
@@ -1461,6 +1464,13 @@ uint64_t vm_pageout_skipped_bq_internal = 0;
 
 #define ANONS_GRABBED_LIMIT     2
 
+/*
+ * How many anonymous pages in a row vm_pageout_scan() takes before it
+ * takes a file page.  Rebalanced from working set refaults when the
+ * phantom cache is configured, ANONS_GRABBED_LIMIT otherwise.
+ */
+static int vm_pageout_anons_grabbed_limit = ANONS_GRABBED_LIMIT;
+
 
 #if 0
 static void vm_pageout_delayed_unlock(int *, int *, vm_page_t *);
@@ -1818,6 +1828,11 @@ vps_init_page_targets(void)
 	 */
 	vm_page_anonymous_min = vm_page_inactive_target / 20;
 
+#if CONFIG_PHANTOM_CACHE
+	vm_pageout_anons_grabbed_limit =
+	    (int)vm_phantom_cache_anons_grabbed_limit(ANONS_GRABBED_LIMIT);
+#endif
+
 	if (vm_pageout_state.vm_page_speculative_percentage > 50) {
 		vm_pageout_state.vm_page_speculative_percentage = 50;
 	} else if (vm_pageout_state.vm_page_speculative_percentage <= 0) {
@@ -2148,7 +2163,7 @@ vps_flow_control(struct flow_control *flow_control, int *anons_grabbed, vm_objec
 
 				if (vm_page_pageable_external_count > vm_pageout_state.vm_page_filecache_min &&
 				    (inactive_external_count >= VM_PAGE_INACTIVE_TARGET(vm_page_pageable_external_count))) {
-					*anons_grabbed = ANONS_GRABBED_LIMIT;
+					*anons_grabbed = vm_pageout_anons_grabbed_limit;
 					VM_PAGEOUT_DEBUG(vm_pageout_scan_throttle_deferred, 1);
 					return VM_PAGEOUT_SCAN_PROCEED;
 				}
@@ -2463,7 +2478,7 @@ vps_choose_victim_page(vm_page_t *victim_page, int *anons_grabbed, boolean_t *gr
 #endif /* CONFIG_JETSAM */
 
 want_anonymous:
-	if (*grab_anonymous == FALSE || *anons_grabbed >= ANONS_GRABBED_LIMIT || vm_page_queue_empty(&vm_page_queue_anonymous)) {
+	if (*grab_anonymous == FALSE || *anons_grabbed >= vm_pageout_anons_grabbed_limit || vm_page_queue_empty(&vm_page_queue_anonymous)) {
 		if (!vm_page_queue_empty(&vm_page_queue_inactive)) {
 			m = (vm_page_t) vm_page_queue_first(&vm_page_queue_inactive);
 
@@ -3167,7 +3182,7 @@ return_from_scan:
 		 * already got the lock
 		 */
 		if (m_object != object) {
-			boolean_t avoid_anon_pages = (grab_anonymous == FALSE || anons_grabbed >= ANONS_GRABBED_LIMIT);
+			boolean_t avoid_anon_pages = (grab_anonymous == FALSE || anons_grabbed >= vm_pageout_anons_grabbed_limit);
 
 			/*
 			 * vps_switch_object() will always drop the 'object' lock first
@@ -3649,6 +3664,12 @@ throttle_inactive:
 		 * and upon completion will end up on 'vm_page_queue_cleaned' which
 		 * is a preferred queue to steal from
 		 */
+#if CONFIG_PHANTOM_CACHE
+		if (object->internal) {
+			/* leaving memory for the compressor: track its refault */
+			vm_phantom_cache_add_ghost(m);
+		}
+#endif
 		vm_pageout_cluster(m);
 		inactive_burst_count = 0;
 
@@ -3715,6 +3736,11 @@ vm_pageout_continue(void)
 	vm_pageout_running = TRUE;
 	lck_mtx_unlock(&vm_page_queue_free_lock);
 
+	if (vm_page_zeroed_count != 0) {
+		/* free pages before paging anything out for them */
+		vm_page_zeroed_drain();
+	}
+
 	vm_pageout_scan();
 	/*
 	 * we hold both the vm_page_queue_free_lock
@@ -4383,8 +4409,9 @@ vm_pressure_response(void)
 
 #else /* !XNU_TARGET_OS_OSX */
 
-	available_memory = (uint64_t) AVAILABLE_NON_COMPRESSED_MEMORY;
-	memorystatus_available_pages = (uint64_t) AVAILABLE_NON_COMPRESSED_MEMORY;
+	/* the pool of pre-zeroed pages goes back to the free list on demand */
+	available_memory = (uint64_t) AVAILABLE_NON_COMPRESSED_MEMORY + vm_page_zeroed_count;
+	memorystatus_available_pages = (uint64_t) AVAILABLE_NON_COMPRESSED_MEMORY + vm_page_zeroed_count;
 
 #endif /* !XNU_TARGET_OS_OSX */
 
@@ -4529,6 +4556,10 @@ vm_pressure_thread(void)
 
 	if (thread_initialized == TRUE) {
 		vm_pageout_state.vm_pressure_thread_running = TRUE;
+		if (memorystatus_vm_pressure_level != kVMPressureNormal &&
+		    vm_page_zeroed_count != 0) {
+			vm_page_zeroed_drain();
+		}
 		consider_vm_pressure_events();
 		vm_pageout_state.vm_pressure_thread_running = FALSE;
 	}
@@ -4900,6 +4931,9 @@ vm_pageout(void)
 #endif
 
 	vm_object_reaper_init();
+	vm_object_collapser_init();
+	vm_superpage_init();
+	vm_page_zeroed_init();
 
 
 	bzero(&vm_config, sizeof(vm_config));
@@ -4947,6 +4981,7 @@ vm_pageout(void)
 	}
 	if (VM_CONFIG_COMPRESSOR_IS_PRESENT) {
 		vm_compressor_pager_init();
+		vm_compressor_prefetch_init();
 	}
 
 #if VM_PRESSURE_EVENTS
@@ -26,6 +26,7 @@
  * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
  */
 
+#include <kern/task.h>
 #include <vm/vm_page.h>
 #include <vm/vm_object.h>
 #include <vm/vm_kern.h>
@@ -64,6 +65,32 @@ uint32_t        sample_period_ghost_added_count_ssd = 0;
 uint32_t        sample_period_ghost_found_count = 0;
 uint32_t        sample_period_ghost_found_count_ssd = 0;
 
+/*
+ * Refault distance.
+ *
+ * The eviction clock ticks once for every page that leaves memory,
+ * either reclaimed from the file cache or sent to the compressor, and
+ * each ghost remembers the clock at its last eviction.  When a page is
+ * read back in, the number of evictions since its own is how many more
+ * pages memory would have needed to hold for it to still be resident.
+ * If that fits in the active queue, the page was part of the working
+ * set and was only evicted because the inactive queues of its kind were
+ * too small: a working set refault.
+ *
+ * Ghosts cover VM_GHOST_PAGES_PER_ENTRY pages each and only keep the
+ * clock of the latest eviction among them, so distances are a little
+ * short for the other pages of the entry.
+ */
+uint32_t        vm_phantom_cache_evict_clock = 0;
+
+uint64_t        vm_phantom_cache_refault_file = 0;
+uint64_t        vm_phantom_cache_refault_anon = 0;
+uint64_t        vm_phantom_cache_workingset_file = 0;
+uint64_t        vm_phantom_cache_workingset_anon = 0;
+
+uint32_t        sample_period_workingset_file = 0;
+uint32_t        sample_period_workingset_anon = 0;
+
 uint32_t        vm_phantom_object_id = 1;
 #define         VM_PHANTOM_OBJECT_ID_AFTER_WRAP 1000000
 
@@ -191,7 +218,9 @@ vm_phantom_cache_add_ghost(vm_page_t m)
 	pg_mask = pg_masks[(m->vmp_offset >> PAGE_SHIFT) & VM_GHOST_PAGE_MASK];
 
 	if (object->phantom_object_id == 0) {
-		vnode_pager_get_isSSD(object->pager, &isSSD);
+		if (!object->internal) {
+			vnode_pager_get_isSSD(object->pager, &isSSD);
+		}
 
 		if (isSSD == TRUE) {
 			object->phantom_isssd = TRUE;
@@ -265,9 +294,13 @@ vm_phantom_cache_add_ghost(vm_page_t m)
 	vm_phantom_cache_hash[ghost_hash_index] = ghost_index;
 
 done:
+	vpce->g_evict_clock = vm_phantom_cache_evict_clock++;
+
 	vm_pageout_vminfo.vm_phantom_cache_added_ghost++;
 
-	if (object->phantom_isssd) {
+	if (object->internal) {
+		/* the file cache thrashing samples are about file pages only */
+	} else if (object->phantom_isssd) {
 		OSAddAtomic(1, &sample_period_ghost_added_count_ssd);
 	} else {
 		OSAddAtomic(1, &sample_period_ghost_added_count);
@@ -319,12 +352,19 @@ vm_phantom_cache_lookup_ghost(vm_page_t m, uint32_t pg_mask)
 
 
 
+/*
+ * Called with the page that was just read back in for "m"'s object and
+ * offset, from the file system or from the compressor.
+ */
 void
 vm_phantom_cache_update(vm_page_t m)
 {
 	int             pg_mask;
 	vm_ghost_t      vpce;
 	vm_object_t     object;
+	uint32_t        distance;
+	boolean_t       workingset;
+	task_t          task;
 
 	object = VM_PAGE_OBJECT(m);
 
@@ -343,6 +383,31 @@ vm_phantom_cache_update(vm_page_t m)
 		phantom_cache_stats.pcs_updated_phantom_state++;
 		vm_pageout_vminfo.vm_phantom_cache_found_ghost++;
 
+		distance = vm_phantom_cache_evict_clock - vpce->g_evict_clock;
+		workingset = (distance <= vm_page_active_count);
+		task = current_task();
+
+		if (object->internal) {
+			vm_phantom_cache_refault_anon++;
+			if (workingset) {
+				vm_phantom_cache_workingset_anon++;
+				OSAddAtomic(1, &sample_period_workingset_anon);
+				OSAddAtomic64(1, (SInt64 *)&task->task_workingset_refaults_anon);
+			}
+			return;
+		}
+		vm_phantom_cache_refault_file++;
+		if (!workingset) {
+			/*
+			 * It would not have stayed resident without taking
+			 * memory away from the active queue: not thrashing.
+			 */
+			return;
+		}
+		vm_phantom_cache_workingset_file++;
+		OSAddAtomic(1, &sample_period_workingset_file);
+		OSAddAtomic64(1, (SInt64 *)&task->task_workingset_refaults_file);
+
 		if (object->phantom_isssd) {
 			OSAddAtomic(1, &sample_period_ghost_found_count_ssd);
 		} else {
@@ -373,7 +438,8 @@ struct {
  * Determine if the file cache is thrashing from sampling interval statistics.
  *
  * Pages added to the phantom cache = pages evicted from the file cache.
- * Pages found in the phantom cache = reads of pages that were recently evicted.
+ * Pages found in the phantom cache = working set refaults, reads of pages
+ * whose refault distance shows they were evicted from the working set.
  * Threshold is the latency-dependent number of reads we consider thrashing.
  */
 static boolean_t
@@ -508,3 +574,60 @@ vm_phantom_cache_restart_sample(void)
 {
 	pc_need_eval_reset = TRUE;
 }
+
+/*
+ * How many anonymous pages in a row vm_pageout_scan() may take from the
+ * inactive queues before it has to take a file page.
+ *
+ * Once per evaluation period, the limit moves up when most working set
+ * refaults are file pages (the file cache is too small, take more from
+ * anonymous memory), and down when most are anonymous pages.  Without
+ * enough refaults to go by, it drifts back to "default_limit".
+ *
+ * Only called from vm_pageout_scan(), so needs no locking.
+ */
+uint32_t        phantom_cache_balance_min_refaults = 32;
+#define PHANTOM_CACHE_MAX_ANONS_GRABBED 8
+
+static unsigned int     pc_anons_grabbed_limit = 0;
+static uint64_t         pc_balance_start = 0;
+
+unsigned int
+vm_phantom_cache_anons_grabbed_limit(unsigned int default_limit)
+{
+	uint64_t        now, elapsed_ns;
+	uint32_t        file, anon;
+
+	if (pc_anons_grabbed_limit == 0) {
+		pc_anons_grabbed_limit = default_limit;
+	}
+	if (vm_phantom_cache_num_entries == 0) {
+		return default_limit;
+	}
+	now = mach_absolute_time();
+	absolutetime_to_nanoseconds(now - pc_balance_start, &elapsed_ns);
+	if (elapsed_ns < (uint64_t)phantom_cache_eval_period_in_msecs * NSEC_PER_MSEC) {
+		return pc_anons_grabbed_limit;
+	}
+	pc_balance_start = now;
+
+	file = os_atomic_xchg(&sample_period_workingset_file, 0, relaxed);
+	anon = os_atomic_xchg(&sample_period_workingset_anon, 0, relaxed);
+
+	if (file + anon < phantom_cache_balance_min_refaults) {
+		if (pc_anons_grabbed_limit > default_limit) {
+			pc_anons_grabbed_limit--;
+		} else if (pc_anons_grabbed_limit < default_limit) {
+			pc_anons_grabbed_limit++;
+		}
+	} else if (file > 2 * anon) {
+		if (pc_anons_grabbed_limit < PHANTOM_CACHE_MAX_ANONS_GRABBED) {
+			pc_anons_grabbed_limit++;
+		}
+	} else if (anon > 2 * file) {
+		if (pc_anons_grabbed_limit > 1) {
+			pc_anons_grabbed_limit--;
+		}
+	}
+	return pc_anons_grabbed_limit;
+}
@@ -88,6 +88,7 @@
 #include <kern/misc_protos.h>
 #include <mach_debug/zone_info.h>
 #include <vm/cpm.h>
+#include <machine/machine_routines.h>
 #include <pexpert/pexpert.h>
 #include <san/kasan.h>
 
@@ -128,6 +129,9 @@
 #endif /* MACH_ASSERT */
 
 extern boolean_t vm_pageout_running;
+#if VM_PRESSURE_EVENTS
+extern vm_pressure_level_t memorystatus_vm_pressure_level;
+#endif /* VM_PRESSURE_EVENTS */
 extern thread_t  vm_pageout_scan_thread;
 extern boolean_t vps_dynamic_priority_enabled;
 
@@ -3825,6 +3829,11 @@ vm_page_wait(
 	int             is_privileged = current_thread()->options & TH_OPT_VMPRIV;
 	event_t         wait_event = NULL;
 
+	if (vm_page_zeroed_count != 0) {
+		/* pre-zeroed pages are a luxury at this point */
+		vm_page_zeroed_drain();
+	}
+
 	lck_mtx_lock_spin(&vm_page_queue_free_lock);
 
 	if (is_privileged && vm_page_free_count) {
@@ -3967,6 +3976,226 @@ vm_page_alloc(
 	return mem;
 }
 
+/*
+ * Pre-zeroed pages.
+ *
+ * Zero-fill faults on freshly allocated memory spend much of their time
+ * zeroing.  The vm_page_zeroed thread runs at background priority and
+ * keeps up to vm_page_zeroed_target pages grabbed from the free list and
+ * zeroed with non-temporal stores (bzero_phys_nc()), so that the zeroing
+ * doesn't evict the caller's working set.  vm_page_alloc_zeroed() takes
+ * from that pool first and falls back to vm_page_alloc().
+ *
+ * Pool pages are off the free queues, so they are counted apart, in
+ * vm_page_zeroed_count, which memorystatus counts as available.  The pool
+ * is only refilled while there are more than vm_page_free_target free
+ * pages, the pageout daemon is idle and there is no memory pressure.  It
+ * is given back to the free list by vm_page_wait() before blocking, by the
+ * pageout daemon before it scans and by the pressure thread when the
+ * pressure level rises.
+ */
+TUNABLE_WRITEABLE(unsigned int, vm_page_zeroed_target, "vm_page_zeroed_target", 4096);
+unsigned int    vm_page_zeroed_count = 0;
+uint64_t        vm_page_zeroed_hits = 0;
+uint64_t        vm_page_zeroed_misses = 0;
+
+static vm_page_t vm_page_zeroed_list = VM_PAGE_NULL;
+static boolean_t vm_page_zeroed_thread_active = TRUE;
+LCK_SPIN_DECLARE_ATTR(vm_page_zeroed_lock, &vm_page_lck_grp_alloc, &vm_page_lck_attr);
+
+/* refill in batches so the pool lock isn't taken for every page */
+#define VM_PAGE_ZEROED_BATCH    32
+
+/* memory the pool would be better off given back */
+static boolean_t
+vm_page_zeroed_low(void)
+{
+	if (vm_page_free_count <= vm_page_free_target + VM_PAGE_ZEROED_BATCH ||
+	    vm_pageout_running) {
+		return TRUE;
+	}
+#if VM_PRESSURE_EVENTS
+	if (memorystatus_vm_pressure_level != kVMPressureNormal) {
+		return TRUE;
+	}
+#endif /* VM_PRESSURE_EVENTS */
+	return FALSE;
+}
+
+static vm_page_t
+vm_page_zeroed_get(void)
+{
+	vm_page_t       mem;
+
+	lck_spin_lock(&vm_page_zeroed_lock);
+	mem = vm_page_zeroed_list;
+	if (mem != VM_PAGE_NULL) {
+		vm_page_zeroed_list = mem->vmp_snext;
+		mem->vmp_snext = VM_PAGE_NULL;
+		vm_page_zeroed_count--;
+	}
+	lck_spin_unlock(&vm_page_zeroed_lock);
+	return mem;
+}
+
+/* start refilling once the pool is half empty */
+static void
+vm_page_zeroed_wakeup(void)
+{
+	boolean_t       wakeup = FALSE;
+
+	if (vm_page_zeroed_thread_active ||
+	    vm_page_zeroed_count >= vm_page_zeroed_target / 2) {
+		return;
+	}
+	lck_spin_lock(&vm_page_zeroed_lock);
+	if (!vm_page_zeroed_thread_active) {
+		vm_page_zeroed_thread_active = TRUE;
+		wakeup = TRUE;
+	}
+	lck_spin_unlock(&vm_page_zeroed_lock);
+
+	if (wakeup) {
+		thread_wakeup((event_t)&vm_page_zeroed_list);
+	}
+}
+
+/*
+ *	vm_page_alloc_zeroed:
+ *
+ *	Like vm_page_alloc(), for a page about to be zero-filled.
+ *	Sets "*zeroed" if the page came from the pool of pre-zeroed
+ *	pages and doesn't need vm_page_zero_fill().
+ *
+ *	Object must be locked.
+ */
+vm_page_t
+vm_page_alloc_zeroed(
+	vm_object_t             object,
+	vm_object_offset_t      offset,
+	boolean_t               *zeroed)
+{
+	vm_page_t       mem;
+
+	vm_object_lock_assert_exclusive(object);
+
+	*zeroed = FALSE;
+	if (vm_page_zeroed_target == 0 && vm_page_zeroed_count == 0) {
+		return vm_page_alloc(object, offset);
+	}
+	vm_page_zeroed_wakeup();
+
+	if (vm_page_zeroed_count != 0 &&
+	    (mem = vm_page_zeroed_get()) != VM_PAGE_NULL) {
+		vm_page_insert(mem, object, offset);
+		os_atomic_inc(&vm_page_zeroed_hits, relaxed);
+		*zeroed = TRUE;
+		return mem;
+	}
+	os_atomic_inc(&vm_page_zeroed_misses, relaxed);
+	return vm_page_alloc(object, offset);
+}
+
+/*
+ * Give the pool back to the free list.
+ */
+void
+vm_page_zeroed_drain(void)
+{
+	vm_page_t       list;
+
+	lck_spin_lock(&vm_page_zeroed_lock);
+	list = vm_page_zeroed_list;
+	vm_page_zeroed_list = VM_PAGE_NULL;
+	vm_page_zeroed_count = 0;
+	lck_spin_unlock(&vm_page_zeroed_lock);
+
+	if (list != VM_PAGE_NULL) {
+		vm_page_free_list(list, FALSE);
+	}
+}
+
+static void
+vm_page_zeroed_thread(void)
+{
+	vm_page_t       batch, mem;
+	unsigned int    n;
+	boolean_t       low;
+
+	for (;;) {
+		low = FALSE;
+		while (vm_page_zeroed_count < vm_page_zeroed_target) {
+			batch = VM_PAGE_NULL;
+			for (n = 0; n < VM_PAGE_ZEROED_BATCH; n++) {
+				if (vm_page_zeroed_low()) {
+					low = TRUE;
+					break;
+				}
+				mem = vm_page_grab();
+				if (mem == VM_PAGE_NULL) {
+					low = TRUE;
+					break;
+				}
+				bzero_phys_nc(ptoa_64(VM_PAGE_GET_PHYS_PAGE(mem)), PAGE_SIZE);
+				mem->vmp_snext = batch;
+				batch = mem;
+			}
+			if (n != 0) {
+				lck_spin_lock(&vm_page_zeroed_lock);
+				for (mem = batch; NEXT_PAGE(mem) != VM_PAGE_NULL;
+				    mem = NEXT_PAGE(mem)) {
+					;
+				}
+				mem->vmp_snext = vm_page_zeroed_list;
+				vm_page_zeroed_list = batch;
+				vm_page_zeroed_count += n;
+				lck_spin_unlock(&vm_page_zeroed_lock);
+			}
+			if (low) {
+				break;
+			}
+		}
+		if (vm_page_zeroed_count > vm_page_zeroed_target) {
+			/* the target was lowered */
+			vm_page_zeroed_drain();
+		}
+
+		lck_spin_lock(&vm_page_zeroed_lock);
+		vm_page_zeroed_thread_active = FALSE;
+		if (low) {
+			/* memory is tight: look again later */
+			assert_wait_timeout((event_t)&vm_page_zeroed_list,
+			    THREAD_UNINT, 1000, NSEC_PER_MSEC);
+		} else {
+			assert_wait((event_t)&vm_page_zeroed_list, THREAD_UNINT);
+		}
+		lck_spin_unlock(&vm_page_zeroed_lock);
+		thread_block(THREAD_CONTINUE_NULL);
+
+		lck_spin_lock(&vm_page_zeroed_lock);
+		vm_page_zeroed_thread_active = TRUE;
+		lck_spin_unlock(&vm_page_zeroed_lock);
+	}
+}
+
+void
+vm_page_zeroed_init(void)
+{
+	kern_return_t   kr;
+	thread_t        thread;
+
+	kr = kernel_thread_start_priority(
+		(thread_continue_t) vm_page_zeroed_thread,
+		NULL,
+		MAXPRI_THROTTLE,
+		&thread);
+	if (kr != KERN_SUCCESS) {
+		panic("failed to launch vm_page_zeroed_thread kr=0x%x", kr);
+	}
+	thread_set_thread_name(thread, "VM_page_zeroed_thread");
+	thread_deallocate(thread);
+}
+
 /*
  *	vm_page_free_prepare:
  *
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Transparent superpages for anonymous memory.
+ *
+ * Unlike VM_FLAGS_SUPERPAGE_SIZE_2MB mappings, which are wired and
+ * allocated up front, these are ordinary pageable memory that happens to
+ * sit in a physically contiguous, 2MB-aligned run:
+ *
+ *  - The first zero-fill fault in an aligned 2MB block of an anonymous
+ *    entry that covers it whole, and of which nothing is resident yet,
+ *    backs the entire block at once with a contiguous run from
+ *    cpm_allocate() (vm_superpage_fill()).  The pages are inserted in
+ *    the object like any other zero-filled page and are mapped one by
+ *    one as they fault in.
+ *
+ *  - The block is then queued for the superpage scanner, a kernel
+ *    thread that asks the pmap to replace the page table of the block
+ *    with a single 2MB mapping (pmap_promote()) once every page is
+ *    mapped with the same permissions.  Blocks that are not there yet
+ *    are retried for a few seconds before they are given up on.
+ *
+ *  - Anything that needs to look at a single base page again (partial
+ *    unmap or protect, pageout and compression, wiring, ...) goes through
+ *    the pmap, which demotes the block back to 4K mappings on the spot.
+ *    Demoted blocks are not promoted again.
+ *
+ * Contiguous runs are only taken while memory is plentiful, and a failed
+ * cpm_allocate() turns filling off for a while: finding a run can be
+ * expensive when physical memory is fragmented.
+ */
+
+#include <mach/mach_types.h>
+#include <mach/kern_return.h>
+
+#include <kern/clock.h>
+#include <kern/counter.h>
+#include <kern/host_statistics.h>
+#include <kern/locks.h>
+#include <kern/sched_prim.h>
+#include <kern/thread.h>
+
+#include <vm/cpm.h>
+#include <vm/pmap.h>
+#include <vm/vm_map.h>
+#include <vm/vm_object.h>
+#include <vm/vm_page.h>
+#include <vm/vm_superpage.h>
+
+#if __x86_64__
+
+TUNABLE_WRITEABLE(int, vm_superpage_enabled, "vm_superpage", 1);
+uint32_t vm_superpage_scan_interval_ms = 100;
+
+uint64_t vm_superpage_fill_count = 0;
+uint64_t vm_superpage_fill_failed = 0;
+uint64_t vm_superpage_promoted = 0;
+
+/* how long filling stays off after cpm_allocate() fails */
+#define VM_SUPERPAGE_FILL_BACKOFF_NS    NSEC_PER_SEC
+static uint64_t vm_superpage_fill_resume;
+
+/*
+ * Blocks waiting to be promoted.  Each candidate holds a reference on
+ * its map.  When the queue is full, new candidates are dropped.
+ */
+#define VM_SUPERPAGE_CANDIDATES         64
+#define VM_SUPERPAGE_MAX_TRIES          50
+
+struct vm_superpage_candidate {
+	vm_map_t                vsc_map;
+	vm_map_offset_t         vsc_base;
+	uint32_t                vsc_tries;
+};
+
+static struct vm_superpage_candidate
+    vm_superpage_candidates[VM_SUPERPAGE_CANDIDATES];
+static uint32_t vm_superpage_candidate_head;
+static uint32_t vm_superpage_ncandidates;
+
+LCK_GRP_DECLARE(vm_superpage_lck_grp, "vm_superpage");
+static LCK_SPIN_DECLARE(vm_superpage_lock, &vm_superpage_lck_grp);
+
+static boolean_t
+vm_superpage_enqueue(struct vm_superpage_candidate *vsc)
+{
+	boolean_t       wakeup;
+
+	lck_spin_lock(&vm_superpage_lock);
+	if (vm_superpage_ncandidates == VM_SUPERPAGE_CANDIDATES) {
+		lck_spin_unlock(&vm_superpage_lock);
+		return FALSE;
+	}
+	vm_superpage_candidates[(vm_superpage_candidate_head +
+	    vm_superpage_ncandidates) % VM_SUPERPAGE_CANDIDATES] = *vsc;
+	wakeup = (vm_superpage_ncandidates++ == 0);
+	lck_spin_unlock(&vm_superpage_lock);
+
+	if (wakeup) {
+		thread_wakeup((event_t)&vm_superpage_ncandidates);
+	}
+	return TRUE;
+}
+
+static boolean_t
+vm_superpage_dequeue(struct vm_superpage_candidate *vsc)
+{
+	lck_spin_lock(&vm_superpage_lock);
+	if (vm_superpage_ncandidates == 0) {
+		lck_spin_unlock(&vm_superpage_lock);
+		return FALSE;
+	}
+	*vsc = vm_superpage_candidates[vm_superpage_candidate_head];
+	vm_superpage_candidate_head =
+	    (vm_superpage_candidate_head + 1) % VM_SUPERPAGE_CANDIDATES;
+	vm_superpage_ncandidates--;
+	lck_spin_unlock(&vm_superpage_lock);
+	return TRUE;
+}
+
+/*
+ * Quick check, with "object" locked, of whether the zero-fill fault at
+ * "vaddr" (object "offset") should go to vm_superpage_fill().  Only the
+ * pages around the faulting one are looked at; vm_superpage_fill()
+ * checks the whole block.
+ */
+boolean_t
+vm_superpage_fill_eligible(
+	vm_map_t                map,
+	vm_map_offset_t         vaddr,
+	vm_object_t             object,
+	vm_object_offset_t      offset,
+	vm_object_fault_info_t  fault_info)
+{
+	vm_map_offset_t         base;
+
+	if (!vm_superpage_enabled || !fault_info->spec_eligible) {
+		return FALSE;
+	}
+	if (map->pmap == kernel_pmap ||
+	    map->no_zero_fill ||
+	    VM_MAP_PAGE_SHIFT(map) != PAGE_SHIFT) {
+		return FALSE;
+	}
+
+	/* the entry must map the whole aligned block ... */
+	base = vaddr & ~((vm_map_offset_t)SUPERPAGE_SIZE - 1);
+	if (base < fault_info->map_start ||
+	    base + SUPERPAGE_SIZE > fault_info->map_end ||
+	    offset - fault_info->lo_offset < vaddr - base ||
+	    offset - (vaddr - base) + SUPERPAGE_SIZE > object->vo_size) {
+		return FALSE;
+	}
+
+	/* ... to a private anonymous object that was never paged out */
+	if (!object->internal ||
+	    object->shadow != VM_OBJECT_NULL ||
+	    object->copy != VM_OBJECT_NULL ||
+	    object->pager_created ||
+	    object->true_share ||
+	    object->phys_contiguous ||
+	    object->purgable != VM_PURGABLE_DENY ||
+	    object->wimg_bits != VM_WIMG_USE_DEFAULT) {
+		return FALSE;
+	}
+
+	if (vm_page_free_count < vm_page_free_target + SUPERPAGE_NBASEPAGES ||
+	    mach_absolute_time() < vm_superpage_fill_resume) {
+		return FALSE;
+	}
+
+	/* a block being populated a page at a time stays that way */
+	if (object->resident_page_count != 0 &&
+	    ((vaddr > base &&
+	    vm_page_lookup(object, offset - PAGE_SIZE) != VM_PAGE_NULL) ||
+	    (vaddr + PAGE_SIZE < base + SUPERPAGE_SIZE &&
+	    vm_page_lookup(object, offset + PAGE_SIZE) != VM_PAGE_NULL))) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Back the aligned 2MB block containing "vaddr" with zero-filled pages
+ * from one contiguous, aligned physical run, and queue the block for
+ * promotion.  Called from the zero-fill path of vm_fault_internal() with
+ * "map" locked shared and "object" locked exclusive; nothing is mapped.
+ * Returns KERN_SUCCESS if the page at "offset" is now resident.
+ */
+kern_return_t
+vm_superpage_fill(
+	vm_map_t                map,
+	vm_map_offset_t         vaddr,
+	vm_object_t             object,
+	vm_object_offset_t      offset,
+	vm_object_fault_info_t  fault_info)
+{
+	struct vm_superpage_candidate vsc;
+	vm_map_offset_t         base;
+	vm_object_offset_t      obase, o;
+	vm_page_t               pages, m;
+	uint64_t                interval;
+	kern_return_t           kr;
+
+	vm_object_lock_assert_exclusive(object);
+
+	if (!vm_superpage_fill_eligible(map, vaddr, object, offset, fault_info)) {
+		return KERN_FAILURE;
+	}
+	base = vaddr & ~((vm_map_offset_t)SUPERPAGE_SIZE - 1);
+	obase = offset - (vaddr - base);
+
+	if (object->resident_page_count != 0) {
+		for (o = obase; o < obase + SUPERPAGE_SIZE; o += PAGE_SIZE) {
+			if (vm_page_lookup(object, o) != VM_PAGE_NULL) {
+				return KERN_FAILURE;
+			}
+		}
+	}
+
+	kr = cpm_allocate(SUPERPAGE_SIZE, &pages, 0, SUPERPAGE_NBASEPAGES - 1,
+	    FALSE, 0);
+	if (kr != KERN_SUCCESS) {
+		nanoseconds_to_absolutetime(VM_SUPERPAGE_FILL_BACKOFF_NS, &interval);
+		vm_superpage_fill_resume = mach_absolute_time() + interval;
+		os_atomic_inc(&vm_superpage_fill_failed, relaxed);
+		return kr;
+	}
+
+	for (o = obase; o < obase + SUPERPAGE_SIZE; o += PAGE_SIZE) {
+		m = pages;
+		pages = NEXT_PAGE(m);
+		*(NEXT_PAGE_PTR(m)) = VM_PAGE_NULL;
+
+		assert(m->vmp_busy);
+		assert(m->vmp_gobbled);
+		pmap_zero_page(VM_PAGE_GET_PHYS_PAGE(m));
+		m->vmp_busy = FALSE;
+		vm_page_insert(m, object, o);
+	}
+	counter_add(&vm_statistics_zero_fill_count, SUPERPAGE_NBASEPAGES);
+
+	/* put them on the paging queues, which ungobbles them */
+	vm_page_lockspin_queues();
+	for (o = obase; o < obase + SUPERPAGE_SIZE; o += PAGE_SIZE) {
+		vm_page_activate(vm_page_lookup(object, o));
+	}
+	vm_page_unlock_queues();
+
+	os_atomic_inc(&vm_superpage_fill_count, relaxed);
+
+	vm_map_reference(map);
+	vsc.vsc_map = map;
+	vsc.vsc_base = base;
+	vsc.vsc_tries = 0;
+	if (!vm_superpage_enqueue(&vsc)) {
+		vm_map_deallocate(map);
+	}
+	return KERN_SUCCESS;
+}
+
+/*
+ * Try to promote the block at "base", if the map still has a plain
+ * entry covering it.
+ */
+static kern_return_t
+vm_superpage_promote(vm_map_t map, vm_map_offset_t base)
+{
+	vm_map_entry_t          entry;
+	kern_return_t           kr;
+
+	vm_map_lock_read(map);
+	if (!vm_map_lookup_entry(map, base, &entry) ||
+	    entry->vme_end < base + SUPERPAGE_SIZE ||
+	    entry->is_sub_map ||
+	    VME_OBJECT(entry) == VM_OBJECT_NULL ||
+	    entry->needs_copy ||
+	    entry->in_transition ||
+	    entry->wired_count != 0 ||
+	    entry->used_for_jit ||
+	    entry->superpage_size) {
+		kr = KERN_FAILURE;
+	} else {
+		kr = pmap_promote(map->pmap, base);
+	}
+	vm_map_unlock_read(map);
+
+	if (kr == KERN_SUCCESS) {
+		os_atomic_inc(&vm_superpage_promoted, relaxed);
+	}
+	return kr;
+}
+
+static void
+vm_superpage_scan(void)
+{
+	struct vm_superpage_candidate vsc;
+	uint32_t                n;
+	kern_return_t           kr;
+
+	lck_spin_lock(&vm_superpage_lock);
+	n = vm_superpage_ncandidates;
+	lck_spin_unlock(&vm_superpage_lock);
+
+	while (n-- > 0 && vm_superpage_dequeue(&vsc)) {
+		if (os_ref_get_count(&vsc.vsc_map->map_refcnt) == 1) {
+			/* the task is gone */
+			kr = KERN_FAILURE;
+		} else {
+			kr = vm_superpage_promote(vsc.vsc_map, vsc.vsc_base);
+		}
+		if (kr == KERN_ABORTED &&
+		    ++vsc.vsc_tries < VM_SUPERPAGE_MAX_TRIES &&
+		    vm_superpage_enqueue(&vsc)) {
+			/* not fully faulted in yet: the queue keeps the reference */
+			continue;
+		}
+		vm_map_deallocate(vsc.vsc_map);
+	}
+}
+
+static void
+vm_superpage_scan_thread(void)
+{
+	for (;;) {
+		lck_spin_lock(&vm_superpage_lock);
+		if (vm_superpage_ncandidates == 0) {
+			assert_wait((event_t)&vm_superpage_ncandidates, THREAD_UNINT);
+			lck_spin_unlock(&vm_superpage_lock);
+			thread_block(THREAD_CONTINUE_NULL);
+			continue;
+		}
+		lck_spin_unlock(&vm_superpage_lock);
+
+		/* give the new blocks time to fault in */
+		assert_wait_timeout((event_t)&vm_superpage_scan_interval_ms,
+		    THREAD_UNINT, vm_superpage_scan_interval_ms, NSEC_PER_MSEC);
+		thread_block(THREAD_CONTINUE_NULL);
+
+		vm_superpage_scan();
+	}
+}
+
+void
+vm_superpage_init(void)
+{
+	kern_return_t   kr;
+	thread_t        thread;
+
+	kr = kernel_thread_start_priority(
+		(thread_continue_t) vm_superpage_scan_thread,
+		NULL,
+		BASEPRI_VM,
+		&thread);
+	if (kr != KERN_SUCCESS) {
+		panic("failed to launch vm_superpage_scan_thread kr=0x%x", kr);
+	}
+	thread_set_thread_name(thread, "VM_superpage_scan_thread");
+	thread_deallocate(thread);
+}
+
+#endif /* __x86_64__ */
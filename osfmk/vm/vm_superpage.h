@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ *	File:	vm/vm_superpage.h
+ *
+ *	Transparent superpages for anonymous memory.
+ */
+
+#ifndef _VM_VM_SUPERPAGE_H_
+#define _VM_VM_SUPERPAGE_H_
+
+#ifdef  MACH_KERNEL_PRIVATE
+
+#include <mach/boolean.h>
+#include <mach/kern_return.h>
+#include <vm/vm_map.h>
+#include <vm/vm_object.h>
+
+#if __x86_64__
+
+extern int              vm_superpage_enabled;
+extern uint32_t         vm_superpage_scan_interval_ms;
+
+extern uint64_t         vm_superpage_fill_count;
+extern uint64_t         vm_superpage_fill_failed;
+extern uint64_t         vm_superpage_promoted;
+
+extern void             vm_superpage_init(void);
+
+extern boolean_t        vm_superpage_fill_eligible(
+	vm_map_t                map,
+	vm_map_offset_t         vaddr,
+	vm_object_t             object,
+	vm_object_offset_t      offset,
+	vm_object_fault_info_t  fault_info);
+
+extern kern_return_t    vm_superpage_fill(
+	vm_map_t                map,
+	vm_map_offset_t         vaddr,
+	vm_object_t             object,
+	vm_object_offset_t      offset,
+	vm_object_fault_info_t  fault_info);
+
+#else /* __x86_64__ */
+
+static inline void
+vm_superpage_init(void)
+{
+}
+
+static inline boolean_t
+vm_superpage_fill_eligible(
+	__unused vm_map_t               map,
+	__unused vm_map_offset_t        vaddr,
+	__unused vm_object_t            object,
+	__unused vm_object_offset_t     offset,
+	__unused vm_object_fault_info_t fault_info)
+{
+	return FALSE;
+}
+
+static inline kern_return_t
+vm_superpage_fill(
+	__unused vm_map_t               map,
+	__unused vm_map_offset_t        vaddr,
+	__unused vm_object_t            object,
+	__unused vm_object_offset_t     offset,
+	__unused vm_object_fault_info_t fault_info)
+{
+	return KERN_NOT_SUPPORTED;
+}
+
+#endif /* __x86_64__ */
+
+#endif  /* MACH_KERNEL_PRIVATE */
+
+#endif  /* _VM_VM_SUPERPAGE_H_ */
@@ -112,3 +112,29 @@ ENTRY2(bzero,__bzero)
 	rep
 	stosb
 	ret
+
+/*
+ * void bzero_nt(void * addr, size_t length)
+ *
+ * Zero with non-temporal stores, which don't pull the lines into the
+ * caches.  addr must be 8-byte aligned and length a multiple of 64.
+ */
+ENTRY(bzero_nt)
+	xorl	%eax,%eax
+	shrq	$6,%rsi
+	jz	2f
+1:
+	movnti	%rax,0(%rdi)
+	movnti	%rax,8(%rdi)
+	movnti	%rax,16(%rdi)
+	movnti	%rax,24(%rdi)
+	movnti	%rax,32(%rdi)
+	movnti	%rax,40(%rdi)
+	movnti	%rax,48(%rdi)
+	movnti	%rax,56(%rdi)
+	addq	$64,%rdi
+	decq	%rsi
+	jnz	1b
+2:
+	sfence
+	ret
@@ -220,7 +220,11 @@ bzero_phys_nc(
 	addr64_t src64,
 	uint32_t bytes)
 {
-	bzero_phys(src64, bytes);
+	if ((src64 & 7) == 0 && (bytes & 63) == 0) {
+		bzero_nt(PHYSMAP_PTOV(src64), bytes);
+	} else {
+		bzero_phys(src64, bytes);
+	}
 }
 
 void
@@ -810,6 +810,8 @@ pmap_init(void)
 	pv_hashed_list_zone = zone_create("pv_list", sizeof(struct pv_hashed_entry),
 	    ZC_NOENCRYPT | ZC_ALIGNMENT_REQUIRED);
 
+	pmap_promote_init((ppnum_t)npages);
+
 	/*
 	 * Create pv entries for kernel pages that might get pmap_remove()ed.
 	 *
@@ -1654,6 +1656,10 @@ pmap_destroy(pmap_t     p)
 	 */
 	int inuse_ptepages = 0;
 
+	if (p->pm_promoted) {
+		pmap_promoted_purge(p);
+	}
+
 	zfree(pmap_anchor_zone, p->pm_pml4);
 	zfree(pmap_uanchor_zone, p->pm_upml4);
 
@@ -1783,6 +1789,11 @@ pmap_protect_options(
 		}
 		pde = pmap_pde(map, sva);
 		if (pde && (*pde & PTE_VALID_MASK(is_ept))) {
+			if (ispromoted(*pde) &&
+			    ((sva & (PDE_MAPPED_SIZE - 1)) || lva - sva < PDE_MAPPED_SIZE)) {
+				/* only part of the superpage changes */
+				pmap_demote(map, sva, pde);
+			}
 			if (*pde & PTE_PS) {
 				/* superpage */
 				spte = pde;
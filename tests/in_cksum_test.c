@@ -1,14 +1,24 @@
 /* <rdar://problem/49479689> arm64 os_cpu_in_cksum_mbuf sometimes incorrect with unaligned input buffer */
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <time.h>
+#include <sys/param.h>
+#include <sys/sysctl.h>
 
 #include <darwintest.h>
 
 T_GLOBAL_META(T_META_RUN_CONCURRENTLY(true));
 
 extern uint32_t os_cpu_in_cksum(const void *, uint32_t, uint32_t);
+#if defined(__x86_64__)
+/* ../bsd/dev/i386/cpu_in_cksum_avx2.s, assembled into this test */
+extern uint64_t os_cpu_in_cksum_avx2(const void *, uint32_t);
+extern uint64_t os_cpu_copy_in_cksum_avx2(const void *, void *, uint32_t);
+#endif /* __x86_64__ */
 
 /****************************************************************/
 static void
@@ -233,3 +243,219 @@ T_DECL(in_cksum_49479689b, "tests os_cpu_in_cksum with many random packets in va
 		test_one_random_packet(4096);
 	}
 }
+
+/*
+ * Sum a buffer divided into segments of any length, the way sosend()
+ * sums each mbuf as it copies it in: a segment that starts at an odd
+ * offset contributes its sum byte-swapped.
+ */
+static uint16_t
+odd_split_in_cksum(const uint8_t *buf, int nsegs, const uint32_t *seglens, const uint8_t *aligns, uint8_t *tmpbuf)
+{
+	uint32_t sum = 0, done = 0;
+
+	for (int i = 0; i < nsegs; i++) {
+		uint32_t psum;
+
+		memcpy(tmpbuf + aligns[i], buf + done, seglens[i]);
+		psum = os_cpu_in_cksum(tmpbuf + aligns[i], seglens[i], 0);
+		if (done & 1) {
+			psum = ((psum & 0xff) << 8) | (psum >> 8);
+		}
+		sum += psum;
+		done += seglens[i];
+	}
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum = (sum >> 16) + (sum & 0xffff);
+
+	return ~sum & 0xffff;
+}
+
+T_DECL(in_cksum_odd_splits, "tests combining per-segment sums across odd-length and odd-offset segments")
+{
+	const uint32_t MAXLEN = 4096;
+	const int MAXSEGS = 6;
+	const uint8_t MAXALIGN = 8;
+	uint8_t *data, *tmpbuf;
+
+	data = malloc(MAXLEN);
+	tmpbuf = malloc(MAXLEN + MAXALIGN);
+	T_QUIET; T_ASSERT_NOTNULL(data, "malloc");
+	T_QUIET; T_ASSERT_NOTNULL(tmpbuf, "malloc");
+
+	for (int i = 0; i < 2000; i++) {
+		uint32_t len = arc4random_uniform(MAXLEN) + 1;
+		uint32_t seglens[MAXSEGS], left = len;
+		uint8_t aligns[MAXSEGS];
+		uint16_t dsum, osum;
+		int nsegs;
+
+		arc4random_buf(data, len);
+		/* every split is odd until the last segment takes the rest */
+		for (nsegs = 0; nsegs < MAXSEGS && left > 0; nsegs++) {
+			uint32_t seglen = arc4random_uniform(left) | 1;
+
+			if (nsegs + 1 == MAXSEGS || seglen > left) {
+				seglen = left;
+			}
+			seglens[nsegs] = seglen;
+			aligns[nsegs] = (uint8_t)arc4random_uniform(MAXALIGN);
+			left -= seglen;
+		}
+
+		dsum = dumb_in_cksum(data, len);
+		osum = odd_split_in_cksum(data, nsegs, seglens, aligns, tmpbuf);
+		if (osum != dsum) {
+			for (int j = 0; j < nsegs; j++) {
+				T_LOG("seg[%d] %u align %u", j, seglens[j], aligns[j]);
+			}
+		}
+		T_QUIET; T_ASSERT_EQ(osum, dsum, "len %u nsegs %d checksum mismatch got 0x%04x expecting 0x%04x",
+		    len, nsegs, htons(osum), htons(dsum));
+	}
+	T_PASS("odd-offset segment sums match the reference sum");
+
+	free(data);
+	free(tmpbuf);
+}
+
+#if defined(__x86_64__)
+static bool
+has_avx2(void)
+{
+	int avx2 = 0;
+	size_t size = sizeof(avx2);
+
+	if (sysctlbyname("hw.optional.avx2_0", &avx2, &size, NULL, 0) != 0) {
+		return false;
+	}
+	return avx2 != 0;
+}
+
+static uint16_t
+fold_avx2_sum(uint64_t sum)
+{
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum = (sum >> 16) + (sum & 0xffff);
+	return ~sum & 0xffff;
+}
+#endif /* __x86_64__ */
+
+T_DECL(in_cksum_avx2, "tests the AVX2 checksum and copy-and-checksum kernels against the reference sum")
+{
+#if defined(__x86_64__)
+	const uint32_t MAXLEN = 16384;
+	const uint8_t MAXALIGN = 32;
+	uint8_t *src, *dst;
+
+	if (!has_avx2()) {
+		T_SKIP("AVX2 not available");
+	}
+
+	src = malloc(MAXLEN + MAXALIGN);
+	dst = malloc(MAXLEN + MAXALIGN);
+	T_QUIET; T_ASSERT_NOTNULL(src, "malloc");
+	T_QUIET; T_ASSERT_NOTNULL(dst, "malloc");
+
+	/* an all-ones buffer exercises every carry in the lane sums */
+	memset(src, 0xff, MAXLEN + MAXALIGN);
+	T_ASSERT_EQ(fold_avx2_sum(os_cpu_in_cksum_avx2(src, MAXLEN)),
+	    dumb_in_cksum(src, MAXLEN), "all-ones buffer");
+
+	for (int i = 0; i < 2000; i++) {
+		uint32_t len = arc4random_uniform(MAXLEN / 64 + 1) * 64;
+		uint8_t salign = (uint8_t)arc4random_uniform(MAXALIGN);
+		uint8_t dalign = (uint8_t)arc4random_uniform(MAXALIGN);
+		uint16_t dsum, osum;
+
+		arc4random_buf(src + salign, len);
+		dsum = dumb_in_cksum(src + salign, len);
+
+		osum = fold_avx2_sum(os_cpu_in_cksum_avx2(src + salign, len));
+		T_QUIET; T_ASSERT_EQ(osum, dsum, "sum len %u align %u", len, salign);
+
+		memset(dst, 0, MAXLEN + MAXALIGN);
+		osum = fold_avx2_sum(os_cpu_copy_in_cksum_avx2(src + salign,
+		    dst + dalign, len));
+		T_QUIET; T_ASSERT_EQ(osum, dsum, "copy sum len %u align %u/%u",
+		    len, salign, dalign);
+		T_QUIET; T_ASSERT_EQ(memcmp(src + salign, dst + dalign, len), 0,
+		    "copy len %u align %u/%u", len, salign, dalign);
+	}
+	T_PASS("AVX2 kernels match the reference sum");
+
+	free(src);
+	free(dst);
+#else /* !__x86_64__ */
+	T_SKIP("AVX2 kernels are x86_64 only");
+#endif /* !__x86_64__ */
+}
+
+static double
+cksum_rate(const uint8_t *buf, uint32_t len, bool avx2)
+{
+	const uint64_t total = 1ULL << 30;
+	uint64_t iters = MAX(total / len, 1);
+	struct timespec start, end;
+	volatile uint32_t sink = 0;
+	double elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	for (uint64_t i = 0; i < iters; i++) {
+#if defined(__x86_64__)
+		if (avx2) {
+			sink += (uint32_t)os_cpu_in_cksum_avx2(buf, len);
+			continue;
+		}
+#endif /* __x86_64__ */
+		sink += os_cpu_in_cksum(buf, len, 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+	(void)sink;
+
+	elapsed = (double)(end.tv_sec - start.tv_sec) +
+	    (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+	return (double)(iters * len) / elapsed / 1e9;
+}
+
+T_DECL(in_cksum_perf, "measures checksum throughput across sizes and alignments",
+    T_META_TAG_PERF, T_META_RUN_CONCURRENTLY(false))
+{
+	static const uint32_t sizes[] = { 64, 256, 1500, 4096, 65536 };
+	bool avx2 = false;
+	uint8_t *buf;
+	char name[64];
+
+#if defined(__x86_64__)
+	avx2 = has_avx2();
+#endif /* __x86_64__ */
+
+	buf = malloc(65536 + 8);
+	T_QUIET; T_ASSERT_NOTNULL(buf, "malloc");
+	arc4random_buf(buf, 65536 + 8);
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (uint32_t align = 0; align < 8; align++) {
+			double rate;
+
+			rate = cksum_rate(buf + align, sizes[i], false);
+			snprintf(name, sizeof(name), "in_cksum_%u_align%u",
+			    sizes[i], align);
+			T_LOG("%s: %.2f GB/s", name, rate);
+			T_PERF(name, rate, "GB/s", "os_cpu_in_cksum throughput");
+
+			/* the vector kernel only takes whole 64-byte blocks */
+			if (!avx2 || (sizes[i] % 64) != 0) {
+				continue;
+			}
+			rate = cksum_rate(buf + align, sizes[i], true);
+			snprintf(name, sizeof(name), "in_cksum_avx2_%u_align%u",
+			    sizes[i], align);
+			T_LOG("%s: %.2f GB/s", name, rate);
+			T_PERF(name, rate, "GB/s", "AVX2 checksum kernel throughput");
+		}
+	}
+
+	free(buf);
+}
@@ -0,0 +1,54 @@
+/*
+ * Measures how long IOCatalogue::findDrivers() takes to come up with the
+ * candidate drivers for a nub, against a synthetic catalogue of a few
+ * thousand personalities for its class, as it would when the nub is
+ * registered at boot.
+ *
+ * The catalogue is populated through kern.iokittest, which is only there on
+ * development kernels.
+ */
+#include <darwintest.h>
+#include <sys/sysctl.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false));
+
+/* see IOCatalogueMatchTest() in iokit/Tests/Tests.cpp */
+#define kIOCatalogueMatchTestPopulate   7779
+#define kIOCatalogueMatchTestFind       7780
+#define kIOCatalogueMatchTestDepopulate 7781
+
+static int
+catalogue_match_test(int value)
+{
+	return sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+}
+
+static void
+catalogue_match_depopulate(void)
+{
+	catalogue_match_test(kIOCatalogueMatchTestDepopulate);
+}
+
+T_DECL(iocatalogue_matching_perf, "Finding the drivers for a nub in a large catalogue",
+    T_META_TAG_PERF)
+{
+	dt_stat_time_t s;
+	int rc;
+
+	rc = catalogue_match_test(kIOCatalogueMatchTestPopulate);
+	if (rc != 0) {
+		T_SKIP("kern.iokittest can't populate the catalogue");
+	}
+	T_ATEND(catalogue_match_depopulate);
+
+	s = dt_stat_time_create("find_drivers");
+	while (!dt_stat_stable(s)) {
+		T_STAT_MEASURE(s) {
+			rc = catalogue_match_test(kIOCatalogueMatchTestFind);
+		}
+		T_QUIET; T_ASSERT_POSIX_SUCCESS(rc, "kern.iokittest find drivers");
+	}
+	dt_stat_finalize(s);
+}
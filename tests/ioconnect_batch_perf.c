@@ -0,0 +1,134 @@
+/*
+ * Measures how many user client calls per second go through
+ * IOConnectCallScalarMethod(), one io_connect_method() round trip each,
+ * against the same calls submitted with io_connect_method_batch() in
+ * batches of various sizes.
+ *
+ * The user client is published through kern.iokittest, which is only there
+ * on development kernels.
+ */
+#include <darwintest.h>
+#include <mach/mach_time.h>
+#include <sys/sysctl.h>
+#include <IOKit/IOKitLib.h>
+#include <IOKit/IOKitServer.h>
+#include "iokitmig.h"
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false));
+
+/* see IOUserClientBatchTest() in iokit/Tests/Tests.cpp */
+#define kIOUserClientBatchTestPublish   7782
+#define kIOUserClientBatchTestTerminate 7783
+#define kIOUserClientBatchTestAdd       0
+
+#define kBatchTestCalls                 4096
+
+static IOConnectMethodBatchCall calls[kIOConnectMethodBatchMaxCalls];
+
+static void
+batch_test_terminate(void)
+{
+	int value = kIOUserClientBatchTestTerminate;
+
+	sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+}
+
+static io_connect_t
+batch_test_open(void)
+{
+	io_service_t  service;
+	io_connect_t  connect;
+	kern_return_t kr;
+	int           value = kIOUserClientBatchTestPublish;
+
+	if (sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value)) != 0) {
+		T_SKIP("kern.iokittest can't publish the test user client");
+	}
+	T_ATEND(batch_test_terminate);
+
+	service = IOServiceGetMatchingService(kIOMasterPortDefault,
+	    IOServiceNameMatching("IOUserClientBatchTest"));
+	T_ASSERT_NE(service, IO_OBJECT_NULL, "find the test service");
+	kr = IOServiceOpen(service, mach_task_self(), 0, &connect);
+	T_ASSERT_MACH_SUCCESS(kr, "IOServiceOpen");
+	IOObjectRelease(service);
+
+	return connect;
+}
+
+static void
+measure_single(io_connect_t connect)
+{
+	dt_stat_t s = dt_stat_create("calls/s", "single");
+	mach_timebase_info_data_t tb;
+	uint64_t input[2], output, start, ns;
+	uint32_t outputCount;
+	kern_return_t kr;
+
+	mach_timebase_info(&tb);
+	while (!dt_stat_stable(s)) {
+		start = mach_absolute_time();
+		for (uint32_t idx = 0; idx < kBatchTestCalls; idx++) {
+			input[0] = idx;
+			input[1] = 1;
+			outputCount = 1;
+			kr = IOConnectCallScalarMethod(connect, kIOUserClientBatchTestAdd,
+			    input, 2, &output, &outputCount);
+			T_QUIET; T_ASSERT_MACH_SUCCESS(kr, "IOConnectCallScalarMethod");
+			T_QUIET; T_ASSERT_EQ(output, (uint64_t)idx + 1, "method result");
+		}
+		ns = (mach_absolute_time() - start) * tb.numer / tb.denom;
+		dt_stat_add(s, (double)kBatchTestCalls * NSEC_PER_SEC / ns);
+	}
+	dt_stat_finalize(s);
+}
+
+static void
+measure_batch(io_connect_t connect, uint32_t batch)
+{
+	dt_stat_t s = dt_stat_create("calls/s", "batch_%u", batch);
+	mach_timebase_info_data_t tb;
+	uint64_t start, ns;
+	uint32_t completed;
+	kern_return_t kr;
+
+	mach_timebase_info(&tb);
+	while (!dt_stat_stable(s)) {
+		start = mach_absolute_time();
+		for (uint32_t idx = 0; idx < kBatchTestCalls; idx += batch) {
+			for (uint32_t call = 0; call < batch; call++) {
+				calls[call] = (IOConnectMethodBatchCall) {
+					.selector = kIOUserClientBatchTestAdd,
+					.scalarInputCount = 2,
+					.scalarInput = { idx + call, 1 },
+					.scalarOutputCount = 1,
+				};
+			}
+			kr = io_connect_method_batch(connect, kIOConnectMethodBatchStopOnError,
+			    (mach_vm_address_t)calls, batch, &completed);
+			T_QUIET; T_ASSERT_MACH_SUCCESS(kr, "io_connect_method_batch");
+			T_QUIET; T_ASSERT_EQ(completed, batch, "all the calls completed");
+			T_QUIET; T_ASSERT_EQ(calls[batch - 1].result, kIOReturnSuccess, "last call succeeded");
+			T_QUIET; T_ASSERT_EQ(calls[batch - 1].scalarOutput[0], (uint64_t)idx + batch,
+			    "method result");
+		}
+		ns = (mach_absolute_time() - start) * tb.numer / tb.denom;
+		dt_stat_add(s, (double)kBatchTestCalls * NSEC_PER_SEC / ns);
+	}
+	dt_stat_finalize(s);
+}
+
+T_DECL(ioconnect_batch_perf, "User client calls one at a time and in batches",
+    T_META_TAG_PERF)
+{
+	io_connect_t connect = batch_test_open();
+
+	measure_single(connect);
+	for (uint32_t batch = 1; batch <= kIOConnectMethodBatchMaxCalls; batch *= 4) {
+		measure_batch(connect, batch);
+	}
+
+	IOServiceClose(connect);
+}
@@ -0,0 +1,238 @@
+/*
+ * Measures how many records per second go through an IODataQueue ring from
+ * a producer thread to a consumer thread, depending on how the producer
+ * publishes them:
+ *
+ *  - one record at a time, with a notification every time the queue stops
+ *    being empty, like IOSharedDataQueue::enqueue();
+ *  - in batches, one tail update and at most one notification per batch,
+ *    like IOSharedDataQueue::enqueueBatch();
+ *  - one record at a time, with the notification held back until the
+ *    queue holds a watermark worth of records, like
+ *    IOSharedDataQueue::setNotificationWatermark().
+ *
+ * The ring uses the same layout and the same barriers as the kernel side,
+ * so this runs anywhere and doesn't need a driver.
+ */
+#include <darwintest.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <IOKit/IODataQueueShared.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_CHECK_LEAKS(false));
+
+#define kRingRecordSize     32
+#define kRingRecords        (1024 * 1024)
+#define kRingQueueSize      (64 * 1024)
+#define kRingBatch          32
+#define kRingWatermark      (kRingBatch * (kRingRecordSize + DATA_QUEUE_ENTRY_HEADER_SIZE))
+
+struct ring {
+	IODataQueueMemory * queue;
+	mach_port_t         port;
+	unsigned int        batch;
+	uint32_t            watermark;
+	_Atomic bool        done;
+};
+
+static void
+ring_notify(struct ring * ring)
+{
+	mach_msg_header_t msgh = {
+		.msgh_bits = MACH_MSGH_BITS(MACH_MSG_TYPE_MAKE_SEND, 0),
+		.msgh_size = sizeof(mach_msg_header_t),
+		.msgh_remote_port = ring->port,
+	};
+
+	/* qlimit is 1, a notification already queued is as good as this one */
+	mach_msg(&msgh, MACH_SEND_MSG | MACH_SEND_TIMEOUT, msgh.msgh_size,
+	    0, MACH_PORT_NULL, 0, MACH_PORT_NULL);
+}
+
+static bool
+ring_wait(struct ring * ring)
+{
+	struct {
+		mach_msg_header_t  msgh;
+		mach_msg_trailer_t trailer;
+	} msg;
+	kern_return_t kr;
+
+	kr = mach_msg(&msg.msgh, MACH_RCV_MSG | MACH_RCV_TIMEOUT, 0, sizeof(msg),
+	    ring->port, 10, MACH_PORT_NULL);
+	return kr == KERN_SUCCESS || kr == MACH_RCV_TIMED_OUT;
+}
+
+static uint32_t
+ring_used(IODataQueueMemory * queue, uint32_t head, uint32_t tail)
+{
+	return tail >= head ? tail - head : queue->queueSize - head + tail;
+}
+
+/* Same rules as IOSharedDataQueue::allocateEntry() */
+static IODataQueueEntry *
+ring_allocate(IODataQueueMemory * queue, uint32_t tail, uint32_t head, uint32_t * newTail)
+{
+	const uint32_t entrySize = kRingRecordSize + DATA_QUEUE_ENTRY_HEADER_SIZE;
+	IODataQueueEntry * entry;
+
+	if (tail >= head) {
+		if (tail + entrySize <= queue->queueSize) {
+			entry = (IODataQueueEntry *)((uint8_t *)queue->queue + tail);
+			*newTail = tail + entrySize;
+		} else if (head > entrySize) {
+			if (queue->queueSize - tail >= DATA_QUEUE_ENTRY_HEADER_SIZE) {
+				((IODataQueueEntry *)((uint8_t *)queue->queue + tail))->size = kRingRecordSize;
+			}
+			entry = queue->queue;
+			*newTail = entrySize;
+		} else {
+			return NULL;
+		}
+	} else if (head - tail > entrySize) {
+		entry = (IODataQueueEntry *)((uint8_t *)queue->queue + tail);
+		*newTail = tail + entrySize;
+	} else {
+		return NULL;
+	}
+	entry->size = kRingRecordSize;
+	return entry;
+}
+
+static void *
+ring_producer(void * arg)
+{
+	struct ring * ring = arg;
+	IODataQueueMemory * queue = ring->queue;
+	_Atomic uint32_t * headp = (_Atomic uint32_t *)&queue->head;
+	_Atomic uint32_t * tailp = (_Atomic uint32_t *)&queue->tail;
+	uint64_t record[kRingRecordSize / sizeof(uint64_t)] = { 0 };
+	unsigned int sent = 0, pending = 0;
+	uint32_t tail = 0, published = 0, newTail, head;
+	IODataQueueEntry * entry;
+
+	while (sent < kRingRecords) {
+		head = atomic_load_explicit(headp, memory_order_acquire);
+		entry = ring_allocate(queue, tail, head, &newTail);
+		if (entry) {
+			record[0] = sent++;
+			memcpy(entry->data, record, kRingRecordSize);
+			tail = newTail;
+			if (++pending < ring->batch && sent < kRingRecords) {
+				continue;
+			}
+		} else if (!pending) {
+			/* full, wait for the consumer to make room */
+			continue;
+		}
+
+		atomic_store_explicit(tailp, tail, memory_order_release);
+		atomic_thread_fence(memory_order_seq_cst);
+		head = atomic_load_explicit(headp, memory_order_relaxed);
+		if (ring->watermark) {
+			if (ring_used(queue, head, tail) >= ring->watermark || sent == kRingRecords) {
+				ring_notify(ring);
+			}
+		} else if (head == published) {
+			/* the consumer had drained everything before this update */
+			ring_notify(ring);
+		}
+		published = tail;
+		pending = 0;
+	}
+	atomic_store(&ring->done, true);
+	ring_notify(ring);
+	return NULL;
+}
+
+static unsigned int
+ring_consume(struct ring * ring)
+{
+	IODataQueueMemory * queue = ring->queue;
+	_Atomic uint32_t * headp = (_Atomic uint32_t *)&queue->head;
+	_Atomic uint32_t * tailp = (_Atomic uint32_t *)&queue->tail;
+	const uint32_t entrySize = kRingRecordSize + DATA_QUEUE_ENTRY_HEADER_SIZE;
+	uint64_t record[kRingRecordSize / sizeof(uint64_t)];
+	unsigned int received = 0, misordered = 0;
+	uint32_t head = 0, tail;
+	IODataQueueEntry * entry;
+
+	for (;;) {
+		tail = atomic_load_explicit(tailp, memory_order_acquire);
+		while (head != tail) {
+			if (head + entrySize > queue->queueSize) {
+				head = 0;
+			}
+			entry = (IODataQueueEntry *)((uint8_t *)queue->queue + head);
+			memcpy(record, entry->data, kRingRecordSize);
+			misordered += (record[0] != received);
+			received++;
+			head += entrySize;
+		}
+		atomic_store_explicit(headp, head, memory_order_release);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (head != atomic_load_explicit(tailp, memory_order_relaxed)) {
+			continue;
+		}
+		if (received == kRingRecords && atomic_load(&ring->done)) {
+			T_QUIET; T_ASSERT_EQ(misordered, 0, "records in order");
+			return received;
+		}
+		T_QUIET; T_ASSERT_TRUE(ring_wait(ring), "wait for data");
+	}
+}
+
+static void
+measure(const char * name, unsigned int batch, uint32_t watermark)
+{
+	dt_stat_t s = dt_stat_create("records/s", "%s", name);
+	mach_port_limits_t limits = { .mpl_qlimit = 1 };
+	mach_timebase_info_data_t tb;
+	struct ring ring = { .batch = batch, .watermark = watermark };
+	pthread_t producer;
+	uint64_t start, ns;
+	kern_return_t kr;
+	int rc;
+
+	mach_timebase_info(&tb);
+	ring.queue = calloc(1, DATA_QUEUE_MEMORY_HEADER_SIZE + kRingQueueSize);
+	T_QUIET; T_ASSERT_NOTNULL(ring.queue, "calloc");
+	ring.queue->queueSize = kRingQueueSize;
+	kr = mach_port_allocate(mach_task_self(), MACH_PORT_RIGHT_RECEIVE, &ring.port);
+	T_QUIET; T_ASSERT_MACH_SUCCESS(kr, "mach_port_allocate");
+	kr = mach_port_set_attributes(mach_task_self(), ring.port, MACH_PORT_LIMITS_INFO,
+	    (mach_port_info_t)&limits, MACH_PORT_LIMITS_INFO_COUNT);
+	T_QUIET; T_ASSERT_MACH_SUCCESS(kr, "mach_port_set_attributes");
+
+	while (!dt_stat_stable(s)) {
+		ring.queue->head = ring.queue->tail = 0;
+		atomic_store(&ring.done, false);
+
+		start = mach_absolute_time();
+		rc = pthread_create(&producer, NULL, ring_producer, &ring);
+		T_QUIET; T_ASSERT_POSIX_ZERO(rc, "pthread_create");
+		T_QUIET; T_ASSERT_EQ(ring_consume(&ring), kRingRecords, "all the records received");
+		ns = (mach_absolute_time() - start) * tb.numer / tb.denom;
+		rc = pthread_join(producer, NULL);
+		T_QUIET; T_ASSERT_POSIX_ZERO(rc, "pthread_join");
+
+		dt_stat_add(s, (double)kRingRecords * NSEC_PER_SEC / ns);
+	}
+	dt_stat_finalize(s);
+
+	mach_port_mod_refs(mach_task_self(), ring.port, MACH_PORT_RIGHT_RECEIVE, -1);
+	free(ring.queue);
+}
+
+T_DECL(iodataqueue_ring_perf, "IODataQueue ring throughput by publication mode",
+    T_META_TAG_PERF)
+{
+	measure("per_record", 1, 0);
+	measure("batched", kRingBatch, 0);
+	measure("watermark", 1, kRingWatermark);
+}
@@ -0,0 +1,73 @@
+/*
+ * Measures how many 128KB I/Os a second an unmapped IODMACommand gets through
+ * on a long-lived wired buffer, preparing it, generating the segments and
+ * completing it each time, and how much CPU time each I/O takes, when the
+ * descriptor keeps the segments it found on the first walk against when it
+ * finds them again from its page lists on every walk.
+ *
+ * The buffer is made through kern.iokittest, which is only there on
+ * development kernels.
+ */
+#include <darwintest.h>
+#include <mach/mach_time.h>
+#include <sys/sysctl.h>
+#include <time.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false));
+
+/* see IODMACommandSegmentTest() in iokit/Tests/Tests.cpp */
+#define kIODMACommandSegmentTestPopulate     7798
+#define kIODMACommandSegmentTestIO           7799
+#define kIODMACommandSegmentTestIOUncached   7800
+#define kIODMACommandSegmentTestDepopulate   7801
+#define kIODMACommandSegmentTestIOs          10000
+
+static int
+segment_test(int value)
+{
+	return sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+}
+
+static void
+segment_test_depopulate(void)
+{
+	segment_test(kIODMACommandSegmentTestDepopulate);
+}
+
+static void
+measure(const char * name, int value)
+{
+	dt_stat_t iops = dt_stat_create("IOs/s", "%s", name);
+	dt_stat_t cpu = dt_stat_create("ns CPU/IO", "%s_cpu", name);
+	mach_timebase_info_data_t tb;
+	uint64_t start, cpuStart, ns;
+	int rc;
+
+	mach_timebase_info(&tb);
+	while (!dt_stat_stable(iops) || !dt_stat_stable(cpu)) {
+		cpuStart = clock_gettime_nsec_np(CLOCK_THREAD_CPUTIME_ID);
+		start = mach_absolute_time();
+		rc = segment_test(value);
+		ns = (mach_absolute_time() - start) * tb.numer / tb.denom;
+		T_QUIET; T_ASSERT_POSIX_SUCCESS(rc, "kern.iokittest %s", name);
+		dt_stat_add(iops, (double)kIODMACommandSegmentTestIOs * NSEC_PER_SEC / ns);
+		dt_stat_add(cpu, (double)(clock_gettime_nsec_np(CLOCK_THREAD_CPUTIME_ID) - cpuStart) / kIODMACommandSegmentTestIOs);
+	}
+	dt_stat_finalize(iops);
+	dt_stat_finalize(cpu);
+}
+
+T_DECL(iodmacommand_segments_perf, "Unmapped IODMACommand I/Os with and without the descriptor keeping its segments",
+    T_META_TAG_PERF)
+{
+	if (segment_test(kIODMACommandSegmentTestPopulate) != 0) {
+		segment_test_depopulate();
+		T_SKIP("kern.iokittest can't make the buffer");
+	}
+	T_ATEND(segment_test_depopulate);
+
+	measure("cached", kIODMACommandSegmentTestIO);
+	measure("uncached", kIODMACommandSegmentTestIOUncached);
+}
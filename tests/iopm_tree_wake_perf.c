@@ -0,0 +1,97 @@
+/*
+ * Measures how long a simulated power tree of a couple of hundred drivers
+ * takes to come back up from its off state, for a tree as wide as it can be,
+ * for a single chain and for a binary tree, with the driver callouts made on
+ * the PM callout threads against on the thread call group they used to share
+ * with the rest of the kernel.
+ *
+ * The tree is made through kern.iokittest, which is only there on development
+ * kernels.
+ */
+#include <darwintest.h>
+#include <mach/mach_time.h>
+#include <sys/sysctl.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false));
+
+/* see IOPMTreeTest() in iokit/Tests/Tests.cpp */
+#define kIOPMTreeTestPopulateWide       7802
+#define kIOPMTreeTestPopulateDeep       7803
+#define kIOPMTreeTestPopulateBalanced   7804
+#define kIOPMTreeTestSleep              7805
+#define kIOPMTreeTestWake               7806
+#define kIOPMTreeTestWakeThreadCall     7807
+#define kIOPMTreeTestDepopulate         7808
+
+static int
+tree_test(int value)
+{
+	return sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+}
+
+static void
+tree_test_depopulate(void)
+{
+	tree_test(kIOPMTreeTestDepopulate);
+}
+
+static void
+measure(const char * name, int value)
+{
+	dt_stat_t s = dt_stat_create("ms", "%s", name);
+	mach_timebase_info_data_t tb;
+	uint64_t start, ns;
+	int rc;
+
+	mach_timebase_info(&tb);
+	while (!dt_stat_stable(s)) {
+		T_QUIET; T_ASSERT_POSIX_SUCCESS(tree_test(kIOPMTreeTestSleep), "kern.iokittest sleep");
+		start = mach_absolute_time();
+		rc = tree_test(value);
+		ns = (mach_absolute_time() - start) * tb.numer / tb.denom;
+		T_QUIET; T_ASSERT_POSIX_SUCCESS(rc, "kern.iokittest %s", name);
+		dt_stat_add(s, (double)ns / NSEC_PER_MSEC);
+	}
+	dt_stat_finalize(s);
+}
+
+static void
+measure_shape(const char * shape, int populate)
+{
+	char name[64];
+
+	if (tree_test(populate) != 0) {
+		tree_test_depopulate();
+		T_SKIP("kern.iokittest can't make the %s tree", shape);
+	}
+
+	snprintf(name, sizeof(name), "%s_wake", shape);
+	measure(name, kIOPMTreeTestWake);
+	snprintf(name, sizeof(name), "%s_wake_thread_call", shape);
+	measure(name, kIOPMTreeTestWakeThreadCall);
+
+	T_ASSERT_POSIX_SUCCESS(tree_test(kIOPMTreeTestDepopulate), "%s tree power change time report", shape);
+}
+
+T_DECL(iopm_tree_wake_perf_wide, "Wake of a power tree with one parent for all its drivers",
+    T_META_TAG_PERF)
+{
+	T_ATEND(tree_test_depopulate);
+	measure_shape("wide", kIOPMTreeTestPopulateWide);
+}
+
+T_DECL(iopm_tree_wake_perf_deep, "Wake of a power tree that is a single chain of drivers",
+    T_META_TAG_PERF)
+{
+	T_ATEND(tree_test_depopulate);
+	measure_shape("deep", kIOPMTreeTestPopulateDeep);
+}
+
+T_DECL(iopm_tree_wake_perf_balanced, "Wake of a power tree that is a binary tree of drivers",
+    T_META_TAG_PERF)
+{
+	T_ATEND(tree_test_depopulate);
+	measure_shape("balanced", kIOPMTreeTestPopulateBalanced);
+}
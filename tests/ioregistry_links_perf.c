@@ -0,0 +1,100 @@
+/*
+ * Measures how many parent, depth and sibling lookups a second one thread per
+ * CPU gets through on a registry plane of a few thousand entries, now that
+ * they read the plane links without gIORegistryLock, against the same lookups
+ * with the lock taken shared around each one, the way they used to. Both are
+ * measured again while another thread keeps attaching and detaching entries
+ * in the same plane.
+ *
+ * The plane is made through kern.iokittest, which is only there on development
+ * kernels.
+ */
+#include <darwintest.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <sys/sysctl.h>
+#include <unistd.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false));
+
+/* see IORegistryLinkTestPerf() in iokit/Tests/Tests.cpp */
+#define kIORegistryLinkTestPopulate     7792
+#define kIORegistryLinkTestRead         7793
+#define kIORegistryLinkTestReadLocked   7794
+#define kIORegistryLinkTestChurnStart   7795
+#define kIORegistryLinkTestChurnStop    7796
+#define kIORegistryLinkTestDepopulate   7797
+#define kIORegistryLinkTestReads        10000
+
+#define kCallsPerThread                 8
+
+static int
+registry_link_test(int value)
+{
+	return sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+}
+
+static void
+registry_link_depopulate(void)
+{
+	registry_link_test(kIORegistryLinkTestDepopulate);
+}
+
+static void *
+reader(void * arg)
+{
+	int value = *(int *)arg;
+
+	for (int call = 0; call < kCallsPerThread; call++) {
+		if (registry_link_test(value) != 0) {
+			return (void *)(uintptr_t)1;
+		}
+	}
+	return NULL;
+}
+
+static void
+measure(const char * name, int value, int nthreads)
+{
+	dt_stat_t s = dt_stat_create("lookups/s", "%s", name);
+	mach_timebase_info_data_t tb;
+	pthread_t threads[nthreads];
+	uint64_t start, ns;
+	void * failed;
+
+	mach_timebase_info(&tb);
+	while (!dt_stat_stable(s)) {
+		start = mach_absolute_time();
+		for (int idx = 0; idx < nthreads; idx++) {
+			T_QUIET; T_ASSERT_POSIX_ZERO(pthread_create(&threads[idx], NULL, reader, &value), NULL);
+		}
+		for (int idx = 0; idx < nthreads; idx++) {
+			T_QUIET; T_ASSERT_POSIX_ZERO(pthread_join(threads[idx], &failed), NULL);
+			T_QUIET; T_ASSERT_NULL(failed, "kern.iokittest %s", name);
+		}
+		ns = (mach_absolute_time() - start) * tb.numer / tb.denom;
+		dt_stat_add(s, (double)nthreads * kCallsPerThread * kIORegistryLinkTestReads * NSEC_PER_SEC / ns);
+	}
+	dt_stat_finalize(s);
+}
+
+T_DECL(ioregistry_links_perf, "Registry plane lookups with and without gIORegistryLock",
+    T_META_TAG_PERF)
+{
+	int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (registry_link_test(kIORegistryLinkTestPopulate) != 0) {
+		T_SKIP("kern.iokittest can't make the plane");
+	}
+	T_ATEND(registry_link_depopulate);
+
+	measure("lockless", kIORegistryLinkTestRead, nthreads);
+	measure("locked", kIORegistryLinkTestReadLocked, nthreads);
+
+	T_ASSERT_POSIX_SUCCESS(registry_link_test(kIORegistryLinkTestChurnStart), "attach/detach churn");
+	measure("lockless_churn", kIORegistryLinkTestRead, nthreads);
+	measure("locked_churn", kIORegistryLinkTestReadLocked, nthreads);
+	T_ASSERT_POSIX_SUCCESS(registry_link_test(kIORegistryLinkTestChurnStop), "attach/detach churn stopped");
+}
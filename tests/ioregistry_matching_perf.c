@@ -0,0 +1,152 @@
+/*
+ * Measures how long IOServiceGetMatchingServices() takes on a large
+ * registry, for the keys the kernel keeps indexes for (registry ID, BSD name
+ * and name) and for a property match that has to visit every service.
+ *
+ * The registry is populated through kern.iokittest, which is only there on
+ * development kernels.
+ */
+#include <darwintest.h>
+#include <sys/sysctl.h>
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false));
+
+/* see IORegistryMatchTest() in iokit/Tests/Tests.cpp */
+#define kIORegistryMatchTestPopulate    7777
+#define kIORegistryMatchTestDepopulate  7778
+#define kIORegistryMatchTestCount       20000
+
+static uint64_t regIDs[kIORegistryMatchTestCount];
+
+static void
+registry_match_test(int value)
+{
+	int rc;
+
+	rc = sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+	if (rc != 0 && value == kIORegistryMatchTestPopulate) {
+		T_SKIP("kern.iokittest can't populate the registry");
+	}
+	T_QUIET; T_ASSERT_POSIX_SUCCESS(rc, "kern.iokittest %d", value);
+}
+
+static void
+registry_match_depopulate(void)
+{
+	int value = kIORegistryMatchTestDepopulate;
+
+	sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+}
+
+/* Consumes the matching dictionary, like IOServiceGetMatchingServices() */
+static unsigned int
+count_matches(CFMutableDictionaryRef matching)
+{
+	io_iterator_t iter;
+	io_object_t   object;
+	unsigned int  count = 0;
+	kern_return_t kr;
+
+	kr = IOServiceGetMatchingServices(kIOMasterPortDefault, matching, &iter);
+	T_QUIET; T_ASSERT_MACH_SUCCESS(kr, "IOServiceGetMatchingServices");
+	while ((object = IOIteratorNext(iter))) {
+		IOObjectRelease(object);
+		count++;
+	}
+	IOObjectRelease(iter);
+	return count;
+}
+
+static void
+measure(const char * name, CFMutableDictionaryRef (^make_matching)(unsigned int idx))
+{
+	dt_stat_time_t s = dt_stat_time_create("%s", name);
+	unsigned int   idx = 0;
+	unsigned int   count;
+
+	while (!dt_stat_stable(s)) {
+		CFMutableDictionaryRef matching = make_matching(idx);
+		T_STAT_MEASURE(s) {
+			count = count_matches(matching);
+		}
+		T_QUIET; T_ASSERT_EQ(count, 1, "%s matched one service", name);
+		idx = (idx + 7919) % kIORegistryMatchTestCount;
+	}
+	dt_stat_finalize(s);
+}
+
+T_DECL(ioregistry_matching_perf, "Matching against a large registry",
+    T_META_TAG_PERF)
+{
+	io_iterator_t iter;
+	io_object_t   object;
+	kern_return_t kr;
+	unsigned int  found = 0;
+
+	registry_match_test(kIORegistryMatchTestPopulate);
+	T_ATEND(registry_match_depopulate);
+
+	kr = IOServiceGetMatchingServices(kIOMasterPortDefault,
+	    IOServiceNameMatching("IORegistryMatchTestRoot"), &iter);
+	T_ASSERT_MACH_SUCCESS(kr, "find the test root");
+	object = IOIteratorNext(iter);
+	IOObjectRelease(iter);
+	T_ASSERT_NE(object, IO_OBJECT_NULL, "test root published");
+
+	/* the order of the children isn't the order they were made in */
+	kr = IORegistryEntryGetChildIterator(object, kIOServicePlane, &iter);
+	T_ASSERT_MACH_SUCCESS(kr, "IORegistryEntryGetChildIterator");
+	IOObjectRelease(object);
+	while ((object = IOIteratorNext(iter))) {
+		CFNumberRef number;
+		int         idx;
+
+		number = IORegistryEntryCreateCFProperty(object,
+		    CFSTR("IORegistryMatchTestIndex"), kCFAllocatorDefault, 0);
+		if (number && CFNumberGetValue(number, kCFNumberIntType, &idx)
+		    && idx >= 0 && idx < kIORegistryMatchTestCount) {
+			IORegistryEntryGetRegistryEntryID(object, &regIDs[idx]);
+			found++;
+		}
+		if (number) {
+			CFRelease(number);
+		}
+		IOObjectRelease(object);
+	}
+	IOObjectRelease(iter);
+	T_ASSERT_EQ(found, kIORegistryMatchTestCount, "all the test services published");
+
+	measure("registry_id_match", ^CFMutableDictionaryRef (unsigned int idx) {
+		return IORegistryEntryIDMatching(regIDs[idx]);
+	});
+	measure("bsd_name_match", ^CFMutableDictionaryRef (unsigned int idx) {
+		char name[32];
+		snprintf(name, sizeof(name), "iomt%u", idx);
+		return IOBSDNameMatching(kIOMasterPortDefault, 0, name);
+	});
+	measure("name_match", ^CFMutableDictionaryRef (unsigned int idx) {
+		char name[64];
+		snprintf(name, sizeof(name), "IORegistryMatchTest%u", idx);
+		return IOServiceNameMatching(name);
+	});
+	/* not indexed, visits every IOService */
+	measure("property_match", ^CFMutableDictionaryRef (unsigned int idx) {
+		CFMutableDictionaryRef matching, property;
+		CFNumberRef number;
+
+		matching = CFDictionaryCreateMutable(kCFAllocatorDefault, 0,
+		    &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+		property = CFDictionaryCreateMutable(kCFAllocatorDefault, 0,
+		    &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+		number = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &idx);
+		CFDictionarySetValue(property, CFSTR("IORegistryMatchTestIndex"), number);
+		CFDictionarySetValue(matching, CFSTR(kIOPropertyMatchKey), property);
+		CFRelease(number);
+		CFRelease(property);
+		return matching;
+	});
+}
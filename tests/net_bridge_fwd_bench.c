@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * net_bridge_fwd_bench.c
+ * - measure the rate at which a bridge forwards known unicast frames
+ *   between feth members, with net.link.bridge.fast_forward off and on
+ */
+
+#include <darwintest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/sockio.h>
+#include <sys/ioctl.h>
+#include <sys/sysctl.h>
+#include <net/if.h>
+#include <net/if_dl.h>
+#include <net/ethernet.h>
+#include <net/if_bridgevar.h>
+#include <net/if_fake_var.h>
+#include <netinet/in.h>
+#include "bpflib.h"
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.net"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false),
+    T_META_TAG_PERF);
+
+#define BRIDGE_NAME     "bridge210"
+#define FETH_UNIT_BASE  3000
+#define NPORTS          4
+
+#define FAST_SYSCTL     "net.link.bridge.fast_forward"
+#define SEND_SECONDS    5
+#define FRAME_SIZE      64
+#define ETHERTYPE_BENCH 0x88b5          /* IEEE local experimental */
+
+/*
+ * Port i is a feth pair: the member side (FETH_UNIT_BASE + i) is in the
+ * bridge, frames are injected on and counted at the outer side
+ * (FETH_UNIT_BASE + NPORTS + i).
+ */
+static char member_name[NPORTS][IFNAMSIZ];
+static char outer_name[NPORTS][IFNAMSIZ];
+static atomic_bool stop_sending;
+
+static int
+inet_dgram_socket(void)
+{
+	int s;
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(s, "socket(AF_INET, SOCK_DGRAM, 0)");
+	return s;
+}
+
+static void
+ifnet_destroy(int s, const char *ifname)
+{
+	struct ifreq ifr;
+
+	bzero(&ifr, sizeof(ifr));
+	strlcpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	(void)ioctl(s, SIOCIFDESTROY, &ifr);
+}
+
+static void
+ifnet_create(int s, const char *ifname)
+{
+	struct ifreq ifr;
+	int error = 0;
+
+	bzero(&ifr, sizeof(ifr));
+	strlcpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	for (int i = 0; i < 600; i++) {
+		if (ioctl(s, SIOCIFCREATE, &ifr) == 0) {
+			error = 0;
+			break;
+		}
+		error = errno;
+		if (error == EEXIST) {
+			ifnet_destroy(s, ifname);
+		} else if (error != EBUSY) {
+			break;
+		}
+		usleep(10000);
+	}
+	T_QUIET;
+	T_ASSERT_POSIX_ZERO(error, "SIOCIFCREATE %s", ifname);
+
+	bzero(&ifr, sizeof(ifr));
+	strlcpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(ioctl(s, SIOCGIFFLAGS, &ifr), "SIOCGIFFLAGS");
+	ifr.ifr_flags |= IFF_UP;
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(ioctl(s, SIOCSIFFLAGS, &ifr), "SIOCSIFFLAGS");
+}
+
+static int
+siocdrvspec(int s, const char *ifname, u_long op, void *arg, size_t argsize)
+{
+	struct ifdrv ifd;
+
+	bzero(&ifd, sizeof(ifd));
+	strlcpy(ifd.ifd_name, ifname, sizeof(ifd.ifd_name));
+	ifd.ifd_cmd = op;
+	ifd.ifd_len = argsize;
+	ifd.ifd_data = arg;
+	return ioctl(s, SIOCSDRVSPEC, &ifd);
+}
+
+static void
+feth_set_peer(int s, const char *ifname, const char *peer)
+{
+	struct if_fake_request iffr;
+
+	bzero(&iffr, sizeof(iffr));
+	strlcpy(iffr.iffr_peer_name, peer, sizeof(iffr.iffr_peer_name));
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(siocdrvspec(s, ifname, IF_FAKE_S_CMD_SET_PEER,
+	    &iffr, sizeof(iffr)), "IF_FAKE_S_CMD_SET_PEER %s %s", ifname, peer);
+}
+
+static void
+bridge_add_member(int s, const char *bridge, const char *member)
+{
+	struct ifbreq req;
+
+	bzero(&req, sizeof(req));
+	strlcpy(req.ifbr_ifsname, member, sizeof(req.ifbr_ifsname));
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(siocdrvspec(s, bridge, BRDGADD, &req,
+	    sizeof(req)), "BRDGADD %s %s", bridge, member);
+}
+
+static void
+bridge_setup(void)
+{
+	int s = inet_dgram_socket();
+
+	ifnet_create(s, BRIDGE_NAME);
+	for (int i = 0; i < NPORTS; i++) {
+		snprintf(member_name[i], IFNAMSIZ, "feth%d", FETH_UNIT_BASE + i);
+		snprintf(outer_name[i], IFNAMSIZ, "feth%d",
+		    FETH_UNIT_BASE + NPORTS + i);
+		ifnet_create(s, member_name[i]);
+		ifnet_create(s, outer_name[i]);
+		feth_set_peer(s, member_name[i], outer_name[i]);
+		bridge_add_member(s, BRIDGE_NAME, member_name[i]);
+	}
+	close(s);
+}
+
+static void
+bridge_cleanup(void)
+{
+	int s = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (s < 0) {
+		return;
+	}
+	ifnet_destroy(s, BRIDGE_NAME);
+	for (int i = 0; i < NPORTS; i++) {
+		if (member_name[i][0] != '\0') {
+			ifnet_destroy(s, member_name[i]);
+			ifnet_destroy(s, outer_name[i]);
+		}
+	}
+	close(s);
+}
+
+/*
+ * Synthetic station behind port i; nothing on the host owns it, so the
+ * bridge can only forward frames addressed to it.
+ */
+static void
+port_station(int i, u_char *ea)
+{
+	ea[0] = 0x02;
+	ea[1] = 0x00;
+	ea[2] = 0x00;
+	ea[3] = 0x00;
+	ea[4] = (u_char)i;
+	ea[5] = 0x01;
+}
+
+static void
+frame_init(int i, u_char *frame)
+{
+	struct ether_header *eh = (struct ether_header *)(void *)frame;
+
+	bzero(frame, FRAME_SIZE);
+	port_station((i + 1) % NPORTS, eh->ether_dhost);
+	port_station(i, eh->ether_shost);
+	eh->ether_type = htons(ETHERTYPE_BENCH);
+}
+
+static int
+port_bpf_open(int i)
+{
+	int fd;
+
+	fd = bpf_new();
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(fd, "bpf_new");
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(bpf_setif(fd, outer_name[i]), "bpf_setif %s",
+	    outer_name[i]);
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(bpf_set_header_complete(fd, 1), NULL);
+	return fd;
+}
+
+static void *
+sender_thread(void *arg)
+{
+	int i = (int)(uintptr_t)arg;
+	u_char frame[FRAME_SIZE];
+	int fd;
+
+	fd = port_bpf_open(i);
+	frame_init(i, frame);
+	while (!atomic_load_explicit(&stop_sending, memory_order_relaxed)) {
+		(void)write(fd, frame, sizeof(frame));
+	}
+	bpf_dispose(fd);
+	return NULL;
+}
+
+/*
+ * Every forwarded frame arrives as input on exactly one outer interface.
+ */
+static uint64_t
+outer_ipackets(void)
+{
+	struct ifaddrs *ifap, *ifa;
+	uint64_t total = 0;
+
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(getifaddrs(&ifap), "getifaddrs");
+	for (ifa = ifap; ifa != NULL; ifa = ifa->ifa_next) {
+		struct if_data *ifd = ifa->ifa_data;
+
+		if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_LINK ||
+		    ifd == NULL) {
+			continue;
+		}
+		for (int i = 0; i < NPORTS; i++) {
+			if (strcmp(ifa->ifa_name, outer_name[i]) == 0) {
+				total += ifd->ifi_ipackets;
+			}
+		}
+	}
+	freeifaddrs(ifap);
+	return total;
+}
+
+static void
+learn_stations(void)
+{
+	u_char frame[FRAME_SIZE];
+
+	for (int i = 0; i < NPORTS; i++) {
+		int fd = port_bpf_open(i);
+
+		frame_init(i, frame);
+		T_QUIET;
+		T_ASSERT_EQ(write(fd, frame, sizeof(frame)),
+		    (ssize_t)sizeof(frame), "write %s", outer_name[i]);
+		bpf_dispose(fd);
+	}
+	usleep(100000);
+}
+
+static double
+run_senders(void)
+{
+	pthread_t threads[NPORTS];
+	struct timespec start, end;
+	uint64_t before, after;
+	double elapsed;
+
+	atomic_store(&stop_sending, false);
+	before = outer_ipackets();
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	for (int i = 0; i < NPORTS; i++) {
+		T_QUIET;
+		T_ASSERT_POSIX_ZERO(pthread_create(&threads[i], NULL,
+		    sender_thread, (void *)(uintptr_t)i), "pthread_create");
+	}
+	sleep(SEND_SECONDS);
+	atomic_store(&stop_sending, true);
+	for (int i = 0; i < NPORTS; i++) {
+		T_QUIET;
+		T_ASSERT_POSIX_ZERO(pthread_join(threads[i], NULL),
+		    "pthread_join");
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+	after = outer_ipackets();
+
+	elapsed = (double)(end.tv_sec - start.tv_sec) +
+	    (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+	return (double)(after - before) / elapsed;
+}
+
+static int saved_fast_forward = -1;
+
+static void
+restore_fast_forward(void)
+{
+	if (saved_fast_forward != -1) {
+		(void)sysctlbyname(FAST_SYSCTL, NULL, NULL, &saved_fast_forward,
+		    sizeof(saved_fast_forward));
+	}
+}
+
+static void
+run_benchmark(int fast_forward, const char *label)
+{
+	int old = 0;
+	size_t old_len = sizeof(old);
+	double fps;
+
+	if (sysctlbyname(FAST_SYSCTL, &old, &old_len, &fast_forward,
+	    sizeof(fast_forward)) != 0) {
+		T_SKIP("%s not available: %s", FAST_SYSCTL, strerror(errno));
+	}
+	saved_fast_forward = old;
+	T_ATEND(restore_fast_forward);
+	T_ATEND(bridge_cleanup);
+
+	bridge_setup();
+	learn_stations();
+	fps = run_senders();
+	T_LOG("%s: %d ports, %.0f frames/s", label, NPORTS, fps);
+	T_EXPECT_GT(fps, 0.0, "frames were forwarded");
+	T_PERF(label, fps, "frames/s",
+	    "known unicast forwarding rate through a bridge of feth members");
+	bridge_cleanup();
+}
+
+T_DECL(bridge_fwd_locked,
+    "bridge forwarding rate with the locked forwarding path")
+{
+	run_benchmark(0, "bridge_fwd_locked");
+}
+
+T_DECL(bridge_fwd_fast,
+    "bridge forwarding rate with lock-free, batched forwarding")
+{
+	run_benchmark(1, "bridge_fwd_fast");
+}
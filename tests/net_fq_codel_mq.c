@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * net_fq_codel_mq.c
+ * - measure transmit rate through fq_codel over a feth pair, with a single
+ *   fq_codel instance and with net.classq.fq_codel_mq_count instances
+ */
+
+#include <darwintest.h>
+#include <darwintest_utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/sockio.h>
+#include <sys/ioctl.h>
+#include <sys/sysctl.h>
+#include <net/if.h>
+#include <net/if_fake_var.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.net"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false),
+    T_META_TAG_PERF);
+
+#define FETH_TX         "feth2100"
+#define FETH_RX         "feth2101"
+#define FETH_TX_ADDR    "10.210.0.1"
+#define FETH_TX_BCAST   "10.210.0.255"
+#define FETH_TX_MASK    "255.255.255.0"
+
+#define MQ_SYSCTL       "net.classq.fq_codel_mq_count"
+#define SEND_SECONDS    5
+#define PAYLOAD_SIZE    64
+#define MAX_SENDERS     64
+
+static unsigned int ifindex_tx;
+static atomic_bool stop_sending;
+static _Atomic uint64_t packets_sent;
+
+static int
+inet_dgram_socket(void)
+{
+	int s;
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(s, "socket(AF_INET, SOCK_DGRAM, 0)");
+	return s;
+}
+
+static void
+feth_destroy(int s, const char *ifname)
+{
+	struct ifreq ifr;
+
+	bzero(&ifr, sizeof(ifr));
+	strlcpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	(void)ioctl(s, SIOCIFDESTROY, &ifr);
+}
+
+static void
+feth_create(int s, const char *ifname)
+{
+	struct ifreq ifr;
+	int error = 0;
+
+	bzero(&ifr, sizeof(ifr));
+	strlcpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	for (int i = 0; i < 600; i++) {
+		if (ioctl(s, SIOCIFCREATE, &ifr) == 0) {
+			error = 0;
+			break;
+		}
+		error = errno;
+		if (error == EEXIST) {
+			feth_destroy(s, ifname);
+		} else if (error != EBUSY) {
+			break;
+		}
+		usleep(10000);
+	}
+	T_QUIET;
+	T_ASSERT_POSIX_ZERO(error, "SIOCIFCREATE %s", ifname);
+
+	bzero(&ifr, sizeof(ifr));
+	strlcpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(ioctl(s, SIOCGIFFLAGS, &ifr), "SIOCGIFFLAGS");
+	ifr.ifr_flags |= IFF_UP;
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(ioctl(s, SIOCSIFFLAGS, &ifr), "SIOCSIFFLAGS");
+}
+
+static void
+feth_set_peer(int s, const char *ifname, const char *peer)
+{
+	struct if_fake_request iffr;
+	struct ifdrv ifd;
+
+	bzero(&iffr, sizeof(iffr));
+	strlcpy(iffr.iffr_peer_name, peer, sizeof(iffr.iffr_peer_name));
+	bzero(&ifd, sizeof(ifd));
+	strlcpy(ifd.ifd_name, ifname, sizeof(ifd.ifd_name));
+	ifd.ifd_cmd = IF_FAKE_S_CMD_SET_PEER;
+	ifd.ifd_len = sizeof(iffr);
+	ifd.ifd_data = &iffr;
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(ioctl(s, SIOCSDRVSPEC, &ifd),
+	    "IF_FAKE_S_CMD_SET_PEER %s %s", ifname, peer);
+}
+
+static void
+inet_set_addr(int s, const char *ifname, const char *addr, const char *mask)
+{
+	struct in_aliasreq ifra;
+	struct sockaddr_in *sin;
+
+	bzero(&ifra, sizeof(ifra));
+	strlcpy(ifra.ifra_name, ifname, sizeof(ifra.ifra_name));
+	sin = (struct sockaddr_in *)&ifra.ifra_addr;
+	sin->sin_len = sizeof(*sin);
+	sin->sin_family = AF_INET;
+	inet_pton(AF_INET, addr, &sin->sin_addr);
+	sin = (struct sockaddr_in *)&ifra.ifra_mask;
+	sin->sin_len = sizeof(*sin);
+	sin->sin_family = AF_INET;
+	inet_pton(AF_INET, mask, &sin->sin_addr);
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(ioctl(s, SIOCAIFADDR, &ifra),
+	    "SIOCAIFADDR %s %s", ifname, addr);
+}
+
+static void
+feth_pair_setup(void)
+{
+	int s = inet_dgram_socket();
+
+	feth_create(s, FETH_TX);
+	feth_create(s, FETH_RX);
+	feth_set_peer(s, FETH_TX, FETH_RX);
+	inet_set_addr(s, FETH_TX, FETH_TX_ADDR, FETH_TX_MASK);
+	ifindex_tx = if_nametoindex(FETH_TX);
+	T_QUIET;
+	T_ASSERT_NE(ifindex_tx, 0U, "if_nametoindex(%s)", FETH_TX);
+	close(s);
+}
+
+static void
+feth_pair_cleanup(void)
+{
+	int s = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (s < 0) {
+		return;
+	}
+	feth_destroy(s, FETH_TX);
+	feth_destroy(s, FETH_RX);
+	close(s);
+}
+
+/*
+ * Each sender owns one socket, and therefore one flow hash, and pushes
+ * subnet broadcasts out the feth interface so that no ARP is involved.
+ */
+static void *
+sender_thread(void *arg)
+{
+	struct sockaddr_in dst;
+	char payload[PAYLOAD_SIZE];
+	uint64_t sent = 0;
+	int on = 1;
+	int s;
+
+	s = inet_dgram_socket();
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(setsockopt(s, SOL_SOCKET, SO_BROADCAST, &on,
+	    sizeof(on)), "SO_BROADCAST");
+	T_QUIET;
+	T_ASSERT_POSIX_SUCCESS(setsockopt(s, IPPROTO_IP, IP_BOUND_IF,
+	    &ifindex_tx, sizeof(ifindex_tx)), "IP_BOUND_IF");
+
+	bzero(&dst, sizeof(dst));
+	dst.sin_len = sizeof(dst);
+	dst.sin_family = AF_INET;
+	dst.sin_port = htons((uint16_t)(20000 + (uintptr_t)arg));
+	inet_pton(AF_INET, FETH_TX_BCAST, &dst.sin_addr);
+	memset(payload, (int)(uintptr_t)arg, sizeof(payload));
+
+	while (!atomic_load_explicit(&stop_sending, memory_order_relaxed)) {
+		if (sendto(s, payload, sizeof(payload), 0,
+		    (struct sockaddr *)&dst, sizeof(dst)) == sizeof(payload)) {
+			sent++;
+		}
+	}
+	atomic_fetch_add(&packets_sent, sent);
+	close(s);
+	return NULL;
+}
+
+static double
+run_senders(unsigned int nsenders)
+{
+	pthread_t threads[MAX_SENDERS];
+	struct timespec start, end;
+	double elapsed;
+
+	atomic_store(&stop_sending, false);
+	atomic_store(&packets_sent, 0);
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	for (unsigned int i = 0; i < nsenders; i++) {
+		T_QUIET;
+		T_ASSERT_POSIX_ZERO(pthread_create(&threads[i], NULL,
+		    sender_thread, (void *)(uintptr_t)i), "pthread_create");
+	}
+	sleep(SEND_SECONDS);
+	atomic_store(&stop_sending, true);
+	for (unsigned int i = 0; i < nsenders; i++) {
+		T_QUIET;
+		T_ASSERT_POSIX_ZERO(pthread_join(threads[i], NULL),
+		    "pthread_join");
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+
+	elapsed = (double)(end.tv_sec - start.tv_sec) +
+	    (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+	return (double)atomic_load(&packets_sent) / elapsed;
+}
+
+static void
+run_benchmark(unsigned int mq_count, const char *label)
+{
+	unsigned int old_count = 0, nsenders;
+	size_t old_len = sizeof(old_count);
+	int ncpu = dt_ncpu();
+	double pps;
+
+	if (sysctlbyname(MQ_SYSCTL, &old_count, &old_len, &mq_count,
+	    sizeof(mq_count)) != 0) {
+		T_SKIP("%s not available: %s", MQ_SYSCTL, strerror(errno));
+	}
+	T_ATEND(feth_pair_cleanup);
+
+	/* the fq_codel instances are created when the interface attaches */
+	feth_pair_setup();
+	(void)sysctlbyname(MQ_SYSCTL, NULL, NULL, &old_count,
+	    sizeof(old_count));
+
+	nsenders = (unsigned int)MIN(MAX(ncpu, 1), MAX_SENDERS);
+	pps = run_senders(nsenders);
+	T_LOG("%s: %u senders, %.0f packets/s", label, nsenders, pps);
+	T_PERF(label, pps, "packets/s",
+	    "UDP transmit rate through fq_codel on feth");
+	feth_pair_cleanup();
+}
+
+T_DECL(fq_codel_single_queue_tx,
+    "transmit rate with a single fq_codel instance")
+{
+	run_benchmark(0, "fq_codel_single_queue_tx");
+}
+
+T_DECL(fq_codel_multi_queue_tx,
+    "transmit rate with one fq_codel instance per CPU")
+{
+	int ncpu = dt_ncpu();
+
+	run_benchmark((unsigned int)MIN(MAX(ncpu, 2), 16),
+	    "fq_codel_multi_queue_tx");
+}
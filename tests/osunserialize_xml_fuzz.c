@@ -0,0 +1,254 @@
+/*
+ * Checks that OSUnserializeXML() and OSUnserializeXMLReference(), the bison
+ * parser it replaced, agree on random documents: plist-like ones built from
+ * every element and attribute the grammar has, half of them then mangled a
+ * little so that the error paths get their share.
+ *
+ * kern.iokittest_unserialize_xml runs both parsers on each document and
+ * compares what they return, so this test only drives it. It is only there on
+ * development kernels.
+ */
+#include <darwintest.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysctl.h>
+#include <time.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true));
+
+#define kFuzzIterations 50000
+#define kFuzzMaxSize    (64 * 1024)
+
+struct doc {
+	char   buf[kFuzzMaxSize];
+	size_t len;
+};
+
+static uint64_t rnd_state;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	rnd_state = rnd_state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (uint32_t)((rnd_state >> 33) % n);
+}
+
+static void
+add(struct doc *d, const char *s)
+{
+	size_t len = strlen(s);
+
+	if (d->len + len < sizeof(d->buf)) {
+		memcpy(d->buf + d->len, s, len);
+		d->len += len;
+	}
+	d->buf[d->len] = '\0';
+}
+
+static void
+addf(struct doc *d, const char *fmt, ...) __printflike(2, 3);
+
+static void
+addf(struct doc *d, const char *fmt, ...)
+{
+	char s[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(s, sizeof(s), fmt, ap);
+	va_end(ap);
+	add(d, s);
+}
+
+#define PICK(a) (a)[rnd(sizeof(a) / sizeof((a)[0]))]
+
+static const char *words[] = {
+	"a", "b", "IOClass", "IOProviderClass", "CFBundleIdentifier", "x&amp;y",
+	"&lt;t&gt;", "&bad;", "&am", "", "line\nbreak", "sp ace", "\xc3\xa9t\xc3\xa9",
+};
+
+static void
+space(struct doc *d)
+{
+	static const char *spaces[] = { "\n", "\t", "  ", "<!-- c\n -->", "", "", "", "" };
+
+	add(d, PICK(spaces));
+}
+
+static void
+id(char *s, size_t size)
+{
+	if (rnd(6) == 0) {
+		snprintf(s, size, " ID=\"%u\"", rnd(8));
+	} else {
+		s[0] = '\0';
+	}
+}
+
+static void
+gen(struct doc *d, int depth)
+{
+	static const char *integers[] = { "0", "1", "-5", "0x1f", "0xFF", "123456789012345678901", "0-3", "", " 4" };
+	static const char *sizes[] = { "", " size=\"32\"", " size=\"8\"", " size=\"0\"", " size=\"65\"", " size=\"0x10\"" };
+	static const char *base64[] = { "", "AAEC", "AAE=", "AA==", "SGVsbG8gV29ybGQ=\n", "A\nB C=D", "@@@", "AAECAwQF\n\tBgcI" };
+	static const char *hex[] = { "", "00ff", "0a 1b", "0a\n1b", "0A", "abc", "00 " };
+	static const char *types[] = { "string", "integer", "dict", "array", "key", "true", "plist", "set" };
+	char attr[32];
+	uint32_t count;
+
+	space(d);
+	id(attr, sizeof(attr));
+	switch (rnd(depth > 6 ? 9 : 13)) {
+	case 0:
+		addf(d, "<string%s>%s</string>", attr, PICK(words));
+		break;
+	case 1:
+		addf(d, "<string%s/>", attr);
+		break;
+	case 2:
+		addf(d, "<integer%s%s>%s</integer>", attr, PICK(sizes), PICK(integers));
+		break;
+	case 3:
+		addf(d, "<data%s>%s</data>", attr, PICK(base64));
+		break;
+	case 4:
+		addf(d, "<data%s format=\"hex\">%s</data>", attr, PICK(hex));
+		break;
+	case 5:
+		if (rnd(2)) {
+			add(d, "<true/>");
+		} else {
+			addf(d, "<false%s/>", attr);
+		}
+		break;
+	case 6:
+		addf(d, "<integer%s/>", attr);
+		break;
+	case 7:
+		add(d, "<data/>");
+		break;
+	case 8:
+		addf(d, "<%s IDREF=\"%u\"/>", PICK(types), rnd(8));
+		break;
+	case 9:
+	case 10:
+		addf(d, "<dict%s>", attr);
+		for (count = rnd(5); count > 0; count--) {
+			space(d);
+			if (rnd(8)) {
+				addf(d, "<key>%s</key>", words[rnd(6)]);
+			} else {
+				addf(d, "<key ID=\"%u\">%s</key>", rnd(8), words[rnd(6)]);
+			}
+			gen(d, depth + 1);
+		}
+		space(d);
+		add(d, "</dict>");
+		break;
+	case 11:
+		addf(d, "<array%s>", attr);
+		for (count = rnd(5); count > 0; count--) {
+			gen(d, depth + 1);
+		}
+		space(d);
+		add(d, "</array>");
+		break;
+	case 12:
+		addf(d, "<set%s>", attr);
+		for (count = rnd(4); count > 0; count--) {
+			gen(d, depth + 1);
+		}
+		space(d);
+		add(d, "</set>");
+		break;
+	}
+}
+
+static void
+mutate(struct doc *d)
+{
+	static const char *fragments[] = {
+		"<", ">", "/", "</dict>", "<dict>", "<key>k</key>", "</array>", "<plist>",
+		"<?xml?>", "<!DOCTYPE x>", "&", "=", "\"", "\x80", "\x8a", "<set/>", "<array/>",
+	};
+	const char *fragment;
+	size_t pos, len;
+
+	for (uint32_t count = 1 + rnd(3); (count > 0) && d->len; count--) {
+		pos = rnd((uint32_t)d->len);
+		switch (rnd(4)) {
+		case 0:
+			len = 1 + rnd(4);
+			if (len > d->len - pos) {
+				len = d->len - pos;
+			}
+			memmove(d->buf + pos, d->buf + pos + len, d->len - pos - len);
+			d->len -= len;
+			break;
+		case 1:
+			fragment = PICK(fragments);
+			len = strlen(fragment);
+			if (d->len + len < sizeof(d->buf)) {
+				memmove(d->buf + pos + len, d->buf + pos, d->len - pos);
+				memcpy(d->buf + pos, fragment, len);
+				d->len += len;
+			}
+			break;
+		case 2:
+			d->buf[pos] = (char)(1 + rnd(255));
+			break;
+		case 3:
+			d->len = pos;
+			break;
+		}
+		d->buf[d->len] = '\0';
+	}
+}
+
+static struct doc doc;
+
+T_DECL(osunserialize_xml_fuzz, "OSUnserializeXML() agrees with the bison parser it replaced")
+{
+	uint64_t seed = (uint64_t)time(NULL);
+	uint32_t parsed = 0;
+	size_t size;
+	int result, rc;
+
+	if (getenv("OSUNSERIALIZE_XML_FUZZ_SEED")) {
+		seed = strtoull(getenv("OSUNSERIALIZE_XML_FUZZ_SEED"), NULL, 0);
+	}
+	T_LOG("seed %llu, set OSUNSERIALIZE_XML_FUZZ_SEED to repeat", seed);
+	rnd_state = seed;
+
+	for (uint32_t idx = 0; idx < kFuzzIterations; idx++) {
+		doc.len = 0;
+		doc.buf[0] = '\0';
+		if (rnd(4) == 0) {
+			add(&doc, "<?xml version=\"1.0\"?>\n<plist version=\"1.0\">\n");
+		}
+		gen(&doc, 0);
+		if (rnd(3) == 0) {
+			add(&doc, "\n</plist>\n");
+		}
+		if (rnd(2)) {
+			mutate(&doc);
+		}
+
+		// with its nul, so that an empty document is still a new value
+		size = sizeof(result);
+		rc = sysctlbyname("kern.iokittest_unserialize_xml", &result, &size, doc.buf, doc.len + 1);
+		if ((rc != 0) && (errno == ENOENT)) {
+			T_SKIP("kern.iokittest_unserialize_xml isn't there");
+		}
+		if (rc != 0) {
+			T_LOG("document %u:\n%s", idx, doc.buf);
+		}
+		T_QUIET; T_ASSERT_POSIX_SUCCESS(rc, "both parsers agree on document %u", idx);
+		parsed += result;
+	}
+	T_PASS("%u documents, %u of them parsed", kFuzzIterations, parsed);
+}
@@ -0,0 +1,65 @@
+/*
+ * Measures how many driver personalities a second OSUnserializeXML() gets
+ * through, out of an XML serialization of a couple of thousand of them,
+ * against OSUnserializeXMLReference(), the bison parser it replaced.
+ *
+ * The serialization is made through kern.iokittest, which is only there on
+ * development kernels.
+ */
+#include <darwintest.h>
+#include <mach/mach_time.h>
+#include <sys/sysctl.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.iokit"),
+    T_META_ASROOT(true),
+    T_META_CHECK_LEAKS(false));
+
+/* see OSUnserializeXMLPerfTest() in iokit/Tests/Tests.cpp */
+#define kOSUnserializeXMLTestPopulate       7788
+#define kOSUnserializeXMLTestParse          7789
+#define kOSUnserializeXMLTestParseReference 7790
+#define kOSUnserializeXMLTestDepopulate     7791
+#define kOSUnserializeXMLTestPersonalities  2000
+
+static int
+unserialize_xml_test(int value)
+{
+	return sysctlbyname("kern.iokittest", NULL, NULL, &value, sizeof(value));
+}
+
+static void
+unserialize_xml_depopulate(void)
+{
+	unserialize_xml_test(kOSUnserializeXMLTestDepopulate);
+}
+
+static void
+measure(const char * name, int value)
+{
+	dt_stat_t s = dt_stat_create("personalities/s", "%s", name);
+	mach_timebase_info_data_t tb;
+	uint64_t start, ns;
+	int rc;
+
+	mach_timebase_info(&tb);
+	while (!dt_stat_stable(s)) {
+		start = mach_absolute_time();
+		rc = unserialize_xml_test(value);
+		ns = (mach_absolute_time() - start) * tb.numer / tb.denom;
+		T_QUIET; T_ASSERT_POSIX_SUCCESS(rc, "kern.iokittest %s", name);
+		dt_stat_add(s, (double)kOSUnserializeXMLTestPersonalities * NSEC_PER_SEC / ns);
+	}
+	dt_stat_finalize(s);
+}
+
+T_DECL(osunserialize_xml_perf, "Unserializing driver personalities with the streaming and the bison XML parser",
+    T_META_TAG_PERF)
+{
+	if (unserialize_xml_test(kOSUnserializeXMLTestPopulate) != 0) {
+		T_SKIP("kern.iokittest can't make the serialization");
+	}
+	T_ATEND(unserialize_xml_depopulate);
+
+	measure("streaming", kOSUnserializeXMLTestParse);
+	measure("bison", kOSUnserializeXMLTestParseReference);
+}
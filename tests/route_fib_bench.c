@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * route_fib_bench.c
+ * - build bsd/net/fib_trie.c in userspace, load a routing table dump into
+ *   it and measure longest prefix match lookups/sec
+ *
+ * The table comes from the file named by ROUTE_FIB_TABLE, one prefix per
+ * line in CIDR notation as the first field (the format of "bgpdump -m"
+ * reduced with cut, or of most looking-glass exports); other lines are
+ * ignored.  Without it, a synthetic table with the prefix length
+ * distribution of a full Internet table is generated.
+ */
+
+#include <darwintest.h>
+#include <darwintest_utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/param.h>
+#include <arpa/inet.h>
+
+#include "fib_trie.h"
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.net"),
+    T_META_CHECK_LEAKS(false),
+    T_META_TAG_PERF);
+
+#define TABLE_ENV               "ROUTE_FIB_TABLE"
+#define LOOKUPS_PER_THREAD      (8 * 1024 * 1024)
+#define KEY_POOL                (1024 * 1024)
+#define MAX_THREADS             64
+
+#define countof(a)              (sizeof(a) / sizeof((a)[0]))
+
+/* share of each IPv4 prefix length in a full table, in 1/10000 */
+static const struct {
+	unsigned int    plen;
+	unsigned int    share;
+} inet_plen_dist[] = {
+	{ 8, 2 }, { 12, 5 }, { 13, 10 }, { 14, 30 }, { 15, 55 }, { 16, 140 },
+	{ 17, 85 }, { 18, 150 }, { 19, 270 }, { 20, 420 }, { 21, 460 },
+	{ 22, 1150 }, { 23, 1050 }, { 24, 6173 },
+};
+
+#define SYNTH_INET_PREFIXES     900000
+#define SYNTH_INET6_PREFIXES    200000
+#define SYNTH_INET6_BLOCKS      25000
+
+struct prefix {
+	uint8_t         key[16];
+	unsigned int    plen;
+};
+
+struct bench {
+	struct fib_trie *trie;
+	uint8_t         *keys;          /* KEY_POOL keys of keylen bytes */
+	size_t          keybytes;
+	uint64_t        checksum;
+};
+
+static uint64_t
+rng_next(uint64_t *state)
+{
+	/* xorshift64* */
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+static void
+prefix_mask(uint8_t *key, unsigned int plen, size_t keybytes)
+{
+	for (size_t i = 0; i < keybytes; i++) {
+		if (plen >= 8) {
+			plen -= 8;
+		} else {
+			key[i] &= (uint8_t)(0xff << (8 - plen));
+			plen = 0;
+		}
+	}
+}
+
+static size_t
+load_table(const char *path, int af, struct prefix **out)
+{
+	char line[512], *slash, *field;
+	size_t n = 0, cap = 1024;
+	struct prefix *p;
+	FILE *f;
+
+	f = fopen(path, "r");
+	T_QUIET;
+	T_ASSERT_NOTNULL(f, "fopen(%s)", path);
+	p = calloc(cap, sizeof(*p));
+	T_QUIET;
+	T_ASSERT_NOTNULL(p, "calloc");
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		field = strtok(line, " \t|\n");
+		if (field == NULL || (slash = strchr(field, '/')) == NULL) {
+			continue;
+		}
+		*slash++ = '\0';
+		if (n == cap) {
+			cap *= 2;
+			p = realloc(p, cap * sizeof(*p));
+			T_QUIET;
+			T_ASSERT_NOTNULL(p, "realloc");
+		}
+		bzero(&p[n], sizeof(p[n]));
+		if (inet_pton(af, field, p[n].key) != 1) {
+			continue;
+		}
+		p[n].plen = (unsigned int)strtoul(slash, NULL, 10);
+		if (p[n].plen > (af == AF_INET ? 32U : 128U)) {
+			continue;
+		}
+		prefix_mask(p[n].key, p[n].plen, af == AF_INET ? 4 : 16);
+		n++;
+	}
+	fclose(f);
+	*out = p;
+	return n;
+}
+
+static size_t
+synth_table(int af, struct prefix **out)
+{
+	uint64_t rng = 0x9e3779b97f4a7c15ULL;
+	size_t n, i, j;
+	struct prefix *p;
+
+	n = (af == AF_INET) ? SYNTH_INET_PREFIXES : SYNTH_INET6_PREFIXES;
+	p = calloc(n, sizeof(*p));
+	T_QUIET;
+	T_ASSERT_NOTNULL(p, "calloc");
+
+	for (i = 0; i < n; i++) {
+		uint64_t r = rng_next(&rng), r2 = rng_next(&rng);
+
+		if (af == AF_INET) {
+			unsigned int pick = (unsigned int)(r % 10000), acc = 0;
+
+			for (j = 0; j < countof(inet_plen_dist) - 1; j++) {
+				acc += inet_plen_dist[j].share;
+				if (pick < acc) {
+					break;
+				}
+			}
+			p[i].plen = inet_plen_dist[j].plen;
+			/* unicast space, 1.0.0.0 - 223.255.255.255 */
+			p[i].key[0] = (uint8_t)(1 + (r2 >> 32) % 223);
+			memcpy(&p[i].key[1], &r2, 3);
+			prefix_mask(p[i].key, p[i].plen, 4);
+		} else {
+			/*
+			 * Global unicast space is handed out in /32 and
+			 * shorter blocks, and most announcements are /48s
+			 * carved out of those; cluster the prefixes likewise.
+			 */
+			uint64_t block = rng_next(&rng) % SYNTH_INET6_BLOCKS;
+			unsigned int pick = (unsigned int)(r % 100);
+
+			p[i].plen = (pick < 15) ? 32 : (pick < 25) ? 36 :
+			    (pick < 35) ? 40 : (pick < 45) ? 44 : 48;
+			p[i].key[0] = 0x20 | (uint8_t)((block * 0x9e37) >> 8 & 0x1f);
+			p[i].key[1] = (uint8_t)(block * 0x9e37);
+			p[i].key[2] = (uint8_t)(block >> 8);
+			p[i].key[3] = (uint8_t)(block >> 16);
+			memcpy(&p[i].key[4], &r2, 2);
+			prefix_mask(p[i].key, p[i].plen, 16);
+		}
+	}
+	*out = p;
+	return n;
+}
+
+static void
+bench_setup(struct bench *b, int af)
+{
+	const char *path = getenv(TABLE_ENV);
+	struct prefix *p;
+	uint64_t rng = 0x2545f4914f6cdd1dULL;
+	size_t n, i;
+
+	b->keybytes = (af == AF_INET) ? 4 : 16;
+	n = (path != NULL) ? load_table(path, af, &p) : synth_table(af, &p);
+	if (n == 0) {
+		T_SKIP("no %s prefixes in %s", af == AF_INET ? "IPv4" : "IPv6",
+		    path);
+	}
+
+	b->trie = fib_trie_create((unsigned int)b->keybytes * 8);
+	T_QUIET;
+	T_ASSERT_NOTNULL(b->trie, "fib_trie_create");
+	for (i = 0; i < n; i++) {
+		T_QUIET;
+		T_ASSERT_POSIX_ZERO(fib_trie_insert(b->trie, p[i].key,
+		    p[i].plen, (uint32_t)(i + 1)), "fib_trie_insert");
+	}
+	fib_trie_reclaim(b->trie);
+	T_LOG("%s: %zu prefixes from %s, %u chunks, %zu KB",
+	    af == AF_INET ? "IPv4" : "IPv6", n, path ? path : "synthetic table",
+	    b->trie->ft_nchunks, fib_trie_memory(b->trie) / 1024);
+
+	/*
+	 * Look up addresses inside random table prefixes, as forwarded
+	 * traffic would, rather than uniformly random addresses that
+	 * mostly miss.
+	 */
+	b->keys = malloc(KEY_POOL * b->keybytes);
+	T_QUIET;
+	T_ASSERT_NOTNULL(b->keys, "malloc");
+	for (i = 0; i < KEY_POOL; i++) {
+		const struct prefix *pi = &p[rng_next(&rng) % n];
+		uint8_t *key = &b->keys[i * b->keybytes];
+		uint64_t host = rng_next(&rng);
+
+		for (size_t j = 0; j < b->keybytes; j++) {
+			unsigned int bit = (unsigned int)j * 8;
+			uint8_t hostmask = 0;
+
+			if (bit + 8 <= pi->plen) {
+				hostmask = 0;
+			} else if (bit >= pi->plen) {
+				hostmask = 0xff;
+			} else {
+				hostmask = (uint8_t)(0xff >> (pi->plen - bit));
+			}
+			key[j] = pi->key[j] | ((uint8_t)(host >> (8 * (j % 8))) &
+			    hostmask);
+		}
+		T_QUIET;
+		T_ASSERT_NE(fib_trie_lookup(b->trie, key), 0U,
+		    "address inside a table prefix matches");
+	}
+	free(p);
+}
+
+static void
+bench_teardown(struct bench *b)
+{
+	fib_trie_destroy(b->trie);
+	free(b->keys);
+}
+
+static void *
+lookup_thread(void *arg)
+{
+	struct bench *b = arg;
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < LOOKUPS_PER_THREAD; i++) {
+		sum += fib_trie_lookup(b->trie,
+		    &b->keys[(i % KEY_POOL) * b->keybytes]);
+	}
+	return (void *)(uintptr_t)sum;
+}
+
+static double
+run_lookups(struct bench *b, unsigned int nthreads)
+{
+	pthread_t threads[MAX_THREADS];
+	struct timespec start, end;
+	double elapsed;
+	void *ret;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	for (unsigned int i = 0; i < nthreads; i++) {
+		T_QUIET;
+		T_ASSERT_POSIX_ZERO(pthread_create(&threads[i], NULL,
+		    lookup_thread, b), "pthread_create");
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		T_QUIET;
+		T_ASSERT_POSIX_ZERO(pthread_join(threads[i], &ret),
+		    "pthread_join");
+		b->checksum += (uintptr_t)ret;
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+
+	elapsed = (double)(end.tv_sec - start.tv_sec) +
+	    (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+	return (double)nthreads * LOOKUPS_PER_THREAD / elapsed;
+}
+
+static void
+run_benchmark(int af, const char *label)
+{
+	unsigned int nthreads = (unsigned int)MIN(MAX(dt_ncpu(), 1),
+	    MAX_THREADS);
+	struct bench b = { .trie = NULL };
+	char name[64];
+	double rate;
+
+	bench_setup(&b, af);
+
+	rate = run_lookups(&b, 1);
+	snprintf(name, sizeof(name), "%s_1thread", label);
+	T_LOG("%s: %.0f lookups/s", name, rate);
+	T_PERF(name, rate, "lookups/s", "trie lookups on one thread");
+
+	rate = run_lookups(&b, nthreads);
+	snprintf(name, sizeof(name), "%s_%uthreads", label, nthreads);
+	T_LOG("%s: %.0f lookups/s", name, rate);
+	T_PERF(label, rate, "lookups/s", "lock-free trie lookups, all CPUs");
+
+	T_LOG("checksum %llu", (unsigned long long)b.checksum);
+	bench_teardown(&b);
+}
+
+T_DECL(route_fib_inet_lookups,
+    "IPv4 longest prefix match rate of the forwarding trie")
+{
+	run_benchmark(AF_INET, "route_fib_inet");
+}
+
+T_DECL(route_fib_inet6_lookups,
+    "IPv6 longest prefix match rate of the forwarding trie")
+{
+	run_benchmark(AF_INET6, "route_fib_inet6");
+}
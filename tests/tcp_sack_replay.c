@@ -0,0 +1,664 @@
+/*
+ * Copyright (c) 2021 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * tcp_sack_replay.c
+ * - replay a deterministic lossy-path packet trace through a userspace copy
+ *   of the SACK scoreboard update (tcp_sack_doack) and of the reassembly
+ *   queue insertion (tcp_reass), once with the linear list walks and once
+ *   with the tree lookups, check that both produce the same state, and
+ *   report the cost per ACK and per out-of-order segment.
+ */
+
+#include <darwintest.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/param.h>
+#include <sys/queue.h>
+#include <libkern/tree.h>
+
+T_GLOBAL_META(T_META_NAMESPACE("xnu.net"),
+    T_META_CHECK_LEAKS(false),
+    T_META_TAG_PERF);
+
+typedef uint32_t tcp_seq;
+
+#define SEQ_LT(a, b)    ((int)((a)-(b)) < 0)
+#define SEQ_LEQ(a, b)   ((int)((a)-(b)) <= 0)
+#define SEQ_GT(a, b)    ((int)((a)-(b)) > 0)
+#define SEQ_GEQ(a, b)   ((int)((a)-(b)) >= 0)
+#define SEQ_MIN(a, b)   ((SEQ_LT(a, b)) ? (a) : (b))
+#define SEQ_MAX(a, b)   ((SEQ_GT(a, b)) ? (a) : (b))
+
+#define TRACE_MSS       1448
+#define TRACE_WINDOW    32768           /* segments per recovery episode */
+#define TRACE_EPISODES  8
+#define TRACE_SEGMENTS  (TRACE_WINDOW * TRACE_EPISODES)
+#define TRACE_ISS       0xfff00000U     /* wraps mid-trace */
+#define TRACE_MAX_SACK  3               /* with timestamps */
+
+/*
+ * Trace
+ */
+struct trace_ack {
+	tcp_seq         ack;
+	uint8_t         nsacks;
+	struct {
+		tcp_seq start, end;
+	} sacks[TRACE_MAX_SACK];
+};
+
+struct trace_seg {
+	tcp_seq         seq;
+};
+
+struct trace {
+	struct trace_seg        *segs;  /* segments as they reach the receiver */
+	size_t                  nsegs;
+	struct trace_ack        *acks;  /* ACKs as they reach the sender */
+	size_t                  nacks;
+};
+
+static uint64_t trace_rand_state = 0x2545f4914f6cdd1dULL;
+
+static uint32_t
+trace_rand(void)
+{
+	trace_rand_state ^= trace_rand_state << 13;
+	trace_rand_state ^= trace_rand_state >> 7;
+	trace_rand_state ^= trace_rand_state << 17;
+	return (uint32_t)(trace_rand_state >> 32);
+}
+
+/* Gilbert-Elliott loss: 3% in the good state, 30% in short bursts */
+static bool
+trace_lost(void)
+{
+	static bool bad = false;
+
+	if (bad) {
+		bad = (trace_rand() % 100) >= 25;
+	} else {
+		bad = (trace_rand() % 1000) < 3;
+	}
+	return (trace_rand() % 100) < (bad ? 30 : 3);
+}
+
+/*
+ * Receiver side of the trace: which segments arrived, reported as SACK
+ * blocks the way tcp_update_sack_list() does, most recent block first.
+ */
+struct rcv_state {
+	uint8_t         *have;          /* per segment index */
+	size_t          nsegs;
+	size_t          rcv_nxt;        /* first missing segment index */
+	size_t          recent[TRACE_MAX_SACK];
+	unsigned int    nrecent;
+};
+
+static void
+rcv_block(const struct rcv_state *rs, size_t idx, size_t *first, size_t *last)
+{
+	*first = *last = idx;
+	while (*first > rs->rcv_nxt && rs->have[*first - 1]) {
+		(*first)--;
+	}
+	while (*last + 1 < rs->nsegs && rs->have[*last + 1]) {
+		(*last)++;
+	}
+}
+
+static void
+rcv_segment(struct rcv_state *rs, struct trace *tr, size_t idx)
+{
+	struct trace_ack *ta = &tr->acks[tr->nacks++];
+	size_t first, last, blocks[TRACE_MAX_SACK][2];
+	unsigned int i, j, n = 0;
+
+	tr->segs[tr->nsegs++].seq = TRACE_ISS + (tcp_seq)(idx * TRACE_MSS);
+	rs->have[idx] = 1;
+	while (rs->rcv_nxt < rs->nsegs && rs->have[rs->rcv_nxt]) {
+		rs->rcv_nxt++;
+	}
+	if (idx >= rs->rcv_nxt) {
+		/* remember the most recently touched blocks */
+		for (i = 0; i < rs->nrecent && rs->recent[i] != idx; i++) {
+			;
+		}
+		if (i == rs->nrecent && rs->nrecent < TRACE_MAX_SACK) {
+			rs->nrecent++;
+		}
+		memmove(&rs->recent[1], &rs->recent[0],
+		    (MIN(i, TRACE_MAX_SACK - 1)) * sizeof(rs->recent[0]));
+		rs->recent[0] = idx;
+	}
+
+	ta->ack = TRACE_ISS + (tcp_seq)(rs->rcv_nxt * TRACE_MSS);
+	for (i = 0; i < rs->nrecent; i++) {
+		if (rs->recent[i] < rs->rcv_nxt) {
+			continue;
+		}
+		rcv_block(rs, rs->recent[i], &first, &last);
+		for (j = 0; j < n && blocks[j][0] != first; j++) {
+			;
+		}
+		if (j < n) {
+			continue;
+		}
+		blocks[n][0] = first;
+		blocks[n][1] = last;
+		ta->sacks[n].start = TRACE_ISS + (tcp_seq)(first * TRACE_MSS);
+		ta->sacks[n].end = TRACE_ISS + (tcp_seq)((last + 1) * TRACE_MSS);
+		n++;
+	}
+	ta->nsacks = (uint8_t)n;
+}
+
+/*
+ * A series of loss recovery episodes over a long fat pipe.  Each one is a
+ * window of first transmissions with bursty loss, then retransmissions of
+ * the holes from the bottom up, each of which may be lost again.  The
+ * retransmissions are what the list walk is slow on: they SACK data far
+ * below snd_fack.
+ */
+static void
+trace_build(struct trace *tr)
+{
+	struct rcv_state rs = { .nsegs = TRACE_SEGMENTS };
+	size_t *lost, nlost, nlost_total = 0, i, base, round;
+
+	rs.have = calloc(TRACE_SEGMENTS, 1);
+	lost = calloc(TRACE_WINDOW, sizeof(*lost));
+	tr->segs = calloc(TRACE_SEGMENTS * 2, sizeof(*tr->segs));
+	tr->acks = calloc(TRACE_SEGMENTS * 2, sizeof(*tr->acks));
+	T_QUIET; T_ASSERT_NOTNULL(rs.have, "calloc");
+	T_QUIET; T_ASSERT_NOTNULL(lost, "calloc");
+	T_QUIET; T_ASSERT_NOTNULL(tr->segs, "calloc");
+	T_QUIET; T_ASSERT_NOTNULL(tr->acks, "calloc");
+
+	for (base = 0; base < TRACE_SEGMENTS; base += TRACE_WINDOW) {
+		nlost = 0;
+		for (i = base; i < base + TRACE_WINDOW; i++) {
+			if (trace_lost()) {
+				lost[nlost++] = i;
+			} else {
+				rcv_segment(&rs, tr, i);
+			}
+		}
+		nlost_total += nlost;
+		for (round = 0; nlost > 0; round++) {
+			size_t nstill = 0;
+
+			for (i = 0; i < nlost; i++) {
+				if (round < 4 && trace_lost()) {
+					lost[nstill++] = lost[i];
+				} else {
+					rcv_segment(&rs, tr, lost[i]);
+				}
+			}
+			nlost = nstill;
+		}
+	}
+	T_LOG("trace: %zu segments, %zu lost on first transmission",
+	    (size_t)TRACE_SEGMENTS, nlost_total);
+	T_QUIET; T_ASSERT_EQ(rs.rcv_nxt, (size_t)TRACE_SEGMENTS,
+	    "everything delivered");
+	free(lost);
+	free(rs.have);
+}
+
+static double
+elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+	return (double)(end->tv_sec - start->tv_sec) * 1e9 +
+	       (double)(end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * Sender scoreboard: the hole bookkeeping of tcp_sack_doack(),
+ * tcp_sackhole_insert() and tcp_sackhole_remove(), without the
+ * congestion control side effects.
+ */
+struct sackhole {
+	tcp_seq start;
+	tcp_seq end;
+	tcp_seq rxmit;
+	TAILQ_ENTRY(sackhole) scblink;
+	RB_ENTRY(sackhole) sclink;
+};
+TAILQ_HEAD(sackhole_head, sackhole);
+RB_HEAD(sackhole_tree, sackhole);
+
+struct scoreboard {
+	bool                    use_tree;
+	struct sackhole_head    holes;
+	struct sackhole_tree    tree;
+	size_t                  nholes;
+	size_t                  maxholes;
+	tcp_seq                 snd_una;
+	tcp_seq                 snd_fack;
+	tcp_seq                 snd_max;
+	struct sackhole         *nexthole;
+	int                     sack_bytes_rexmit;
+	uint32_t                sack_bytes_holes;
+};
+
+static int
+sackhole_cmp(const struct sackhole *a, const struct sackhole *b)
+{
+	if (SEQ_LT(a->start, b->start)) {
+		return -1;
+	}
+	return SEQ_GT(a->start, b->start);
+}
+
+RB_PROTOTYPE(sackhole_tree, sackhole, sclink, sackhole_cmp);
+RB_GENERATE(sackhole_tree, sackhole, sclink, sackhole_cmp);
+
+static struct sackhole *
+sb_insert(struct scoreboard *sb, tcp_seq start, tcp_seq end,
+    struct sackhole *after)
+{
+	struct sackhole *hole = calloc(1, sizeof(*hole));
+
+	T_QUIET; T_ASSERT_NOTNULL(hole, "calloc");
+	hole->start = hole->rxmit = start;
+	hole->end = end;
+	if (after != NULL) {
+		TAILQ_INSERT_AFTER(&sb->holes, after, hole, scblink);
+	} else {
+		TAILQ_INSERT_TAIL(&sb->holes, hole, scblink);
+	}
+	if (sb->use_tree) {
+		RB_INSERT(sackhole_tree, &sb->tree, hole);
+	}
+	sb->sack_bytes_holes += end - start;
+	if (sb->nexthole == NULL) {
+		sb->nexthole = hole;
+	}
+	if (++sb->nholes > sb->maxholes) {
+		sb->maxholes = sb->nholes;
+	}
+	return hole;
+}
+
+static void
+sb_remove(struct scoreboard *sb, struct sackhole *hole)
+{
+	if (sb->nexthole == hole) {
+		sb->nexthole = TAILQ_NEXT(hole, scblink);
+	}
+	TAILQ_REMOVE(&sb->holes, hole, scblink);
+	if (sb->use_tree) {
+		RB_REMOVE(sackhole_tree, &sb->tree, hole);
+	}
+	sb->sack_bytes_holes -= hole->end - hole->start;
+	sb->nholes--;
+	free(hole);
+}
+
+static struct sackhole *
+sb_lookup(struct scoreboard *sb, tcp_seq seq)
+{
+	struct sackhole find, *hole;
+
+	find.start = seq;
+	hole = RB_NFIND(sackhole_tree, &sb->tree, &find);
+	if (hole == NULL) {
+		return TAILQ_LAST(&sb->holes, sackhole_head);
+	}
+	return TAILQ_PREV(hole, sackhole_head, scblink);
+}
+
+static void
+sb_doack(struct scoreboard *sb, const struct trace_ack *ta)
+{
+	struct sackhole *cur, *temp;
+	struct { tcp_seq start, end; } blocks[TRACE_MAX_SACK + 1], sack, *sblkp;
+	int i, j, nblocks = 0;
+
+	if (SEQ_LT(sb->snd_una, ta->ack) && !TAILQ_EMPTY(&sb->holes)) {
+		blocks[nblocks].start = sb->snd_una;
+		blocks[nblocks++].end = ta->ack;
+	}
+	for (i = 0; i < ta->nsacks; i++) {
+		if (SEQ_GT(ta->sacks[i].start, sb->snd_una) &&
+		    SEQ_GT(ta->sacks[i].start, ta->ack)) {
+			blocks[nblocks].start = ta->sacks[i].start;
+			blocks[nblocks++].end = ta->sacks[i].end;
+		}
+	}
+	if (SEQ_GT(ta->ack, sb->snd_una)) {
+		sb->snd_una = ta->ack;
+	}
+	if (nblocks == 0) {
+		return;
+	}
+	for (i = 0; i < nblocks; i++) {
+		for (j = i + 1; j < nblocks; j++) {
+			if (SEQ_GT(blocks[i].end, blocks[j].end)) {
+				sack = blocks[i];
+				blocks[i] = blocks[j];
+				blocks[j] = sack;
+			}
+		}
+	}
+	if (TAILQ_EMPTY(&sb->holes)) {
+		sb->snd_fack = SEQ_MAX(sb->snd_una, ta->ack);
+	}
+	sblkp = &blocks[nblocks - 1];
+	if (SEQ_LT(sb->snd_fack, sblkp->start)) {
+		sb_insert(sb, sb->snd_fack, sblkp->start, NULL);
+		sb->snd_fack = sblkp->end;
+		sblkp--;
+	} else if (SEQ_LT(sb->snd_fack, sblkp->end)) {
+		sb->snd_fack = sblkp->end;
+	}
+	cur = TAILQ_LAST(&sb->holes, sackhole_head);
+	while (sblkp >= blocks && cur != NULL) {
+		if (SEQ_GEQ(sblkp->start, cur->end)) {
+			sblkp--;
+			continue;
+		}
+		if (SEQ_LEQ(sblkp->end, cur->start)) {
+			if (sb->use_tree) {
+				cur = sb_lookup(sb, sblkp->end);
+			} else {
+				cur = TAILQ_PREV(cur, sackhole_head, scblink);
+			}
+			continue;
+		}
+		sb->sack_bytes_rexmit -= (cur->rxmit - cur->start);
+		if (SEQ_LEQ(sblkp->start, cur->start)) {
+			if (SEQ_GEQ(sblkp->end, cur->end)) {
+				temp = cur;
+				cur = TAILQ_PREV(cur, sackhole_head, scblink);
+				sb_remove(sb, temp);
+				continue;
+			}
+			sb->sack_bytes_holes -= sblkp->end - cur->start;
+			cur->start = sblkp->end;
+			cur->rxmit = SEQ_MAX(cur->rxmit, cur->start);
+		} else if (SEQ_GEQ(sblkp->end, cur->end)) {
+			sb->sack_bytes_holes -= cur->end - sblkp->start;
+			cur->end = sblkp->start;
+			cur->rxmit = SEQ_MIN(cur->rxmit, cur->end);
+		} else {
+			temp = sb_insert(sb, sblkp->end, cur->end, cur);
+			if (SEQ_GT(cur->rxmit, temp->rxmit)) {
+				temp->rxmit = cur->rxmit;
+				sb->sack_bytes_rexmit += (temp->rxmit - temp->start);
+			}
+			sb->sack_bytes_holes -= cur->end - sblkp->start;
+			cur->end = sblkp->start;
+			cur->rxmit = SEQ_MIN(cur->rxmit, cur->end);
+		}
+		sb->sack_bytes_rexmit += (cur->rxmit - cur->start);
+		if (SEQ_LEQ(sblkp->start, cur->start)) {
+			cur = TAILQ_PREV(cur, sackhole_head, scblink);
+		} else {
+			sblkp--;
+		}
+	}
+}
+
+/* tcp_sack_output(): the next hole to retransmit, via the hint */
+static struct sackhole *
+sb_output(struct scoreboard *sb)
+{
+	struct sackhole *hole = sb->nexthole;
+
+	if (hole == NULL || SEQ_LT(hole->rxmit, hole->end)) {
+		return hole;
+	}
+	while ((hole = TAILQ_NEXT(hole, scblink)) != NULL) {
+		if (SEQ_LT(hole->rxmit, hole->end)) {
+			sb->nexthole = hole;
+			break;
+		}
+	}
+	return hole;
+}
+
+static void
+sb_free(struct scoreboard *sb)
+{
+	struct sackhole *hole;
+
+	while ((hole = TAILQ_FIRST(&sb->holes)) != NULL) {
+		sb_remove(sb, hole);
+	}
+}
+
+static uint64_t
+sb_digest(const struct scoreboard *sb)
+{
+	const struct sackhole *hole;
+	uint64_t h = 14695981039346656037ULL;
+
+	TAILQ_FOREACH(hole, &sb->holes, scblink) {
+		h = (h ^ hole->start) * 1099511628211ULL;
+		h = (h ^ hole->end) * 1099511628211ULL;
+		h = (h ^ hole->rxmit) * 1099511628211ULL;
+	}
+	return h ^ sb->snd_fack ^ ((uint64_t)sb->sack_bytes_rexmit << 32);
+}
+
+/*
+ * Replay the ACKs.  Every ACK also retransmits one MSS from the next hole,
+ * as tcp_output() would, so that the hint and rxmit are exercised.
+ */
+static double
+sack_replay(const struct trace *tr, bool use_tree, uint64_t *digest,
+    size_t *maxholes)
+{
+	struct scoreboard sb = { .use_tree = use_tree };
+	struct timespec start, end;
+	struct sackhole *hole;
+	uint64_t h = 0;
+	size_t i;
+
+	TAILQ_INIT(&sb.holes);
+	RB_INIT(&sb.tree);
+	sb.snd_una = sb.snd_fack = TRACE_ISS;
+	sb.snd_max = TRACE_ISS + TRACE_SEGMENTS * TRACE_MSS;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	for (i = 0; i < tr->nacks; i++) {
+		sb_doack(&sb, &tr->acks[i]);
+		if ((hole = sb_output(&sb)) != NULL) {
+			tcp_seq len = MIN(TRACE_MSS, hole->end - hole->rxmit);
+
+			hole->rxmit += len;
+			sb.sack_bytes_rexmit += len;
+		}
+		if ((i & 1023) == 0) {
+			h = (h * 31) ^ sb_digest(&sb);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+
+	*digest = h ^ sb_digest(&sb);
+	*maxholes = sb.maxholes;
+	T_QUIET; T_EXPECT_EQ(sb.sack_bytes_holes, 0U, "no hole bytes left");
+	sb_free(&sb);
+	return elapsed_ns(&start, &end) / (double)tr->nacks;
+}
+
+/*
+ * Receiver reassembly queue: the queue insertion of tcp_reass().  The
+ * trace carries no payload, so every entry stands for one MSS.
+ */
+struct tseg_qent {
+	LIST_ENTRY(tseg_qent) tqe_q;
+	RB_ENTRY(tseg_qent) tqe_link;
+	int             tqe_len;
+	tcp_seq         tqe_seq;
+};
+LIST_HEAD(tsegqe_head, tseg_qent);
+RB_HEAD(tsegqe_tree, tseg_qent);
+
+static int
+reass_cmp(const struct tseg_qent *a, const struct tseg_qent *b)
+{
+	if (SEQ_LT(a->tqe_seq, b->tqe_seq)) {
+		return -1;
+	}
+	if (SEQ_GT(a->tqe_seq, b->tqe_seq)) {
+		return 1;
+	}
+	return a->tqe_len - b->tqe_len;
+}
+
+RB_PROTOTYPE_PREV(tsegqe_tree, tseg_qent, tqe_link, reass_cmp);
+RB_GENERATE_PREV(tsegqe_tree, tseg_qent, tqe_link, reass_cmp);
+
+static double
+reass_replay(const struct trace *tr, bool use_tree, size_t *maxlen)
+{
+	struct tsegqe_head segq = LIST_HEAD_INITIALIZER(segq);
+	struct tsegqe_tree segq_tree = RB_INITIALIZER(&segq_tree);
+	struct tseg_qent *q, *p, *te, find;
+	struct timespec start, end;
+	tcp_seq rcv_nxt = TRACE_ISS;
+	size_t i, len = 0, nooo = 0;
+
+	*maxlen = 0;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	for (i = 0; i < tr->nsegs; i++) {
+		tcp_seq seq = tr->segs[i].seq;
+
+		if (seq == rcv_nxt && LIST_EMPTY(&segq)) {
+			rcv_nxt += TRACE_MSS;
+			continue;
+		}
+		nooo++;
+		p = NULL;
+		if (use_tree) {
+			find.tqe_seq = seq + 1;
+			find.tqe_len = 0;
+			q = RB_NFIND(tsegqe_tree, &segq_tree, &find);
+			p = q != NULL ? RB_PREV(tsegqe_tree, &segq_tree, q) :
+			    RB_MAX(tsegqe_tree, &segq_tree);
+		} else {
+			LIST_FOREACH(q, &segq, tqe_q) {
+				if (SEQ_GT(q->tqe_seq, seq)) {
+					break;
+				}
+				p = q;
+			}
+		}
+		te = malloc(sizeof(*te));
+		T_QUIET; T_ASSERT_NOTNULL(te, "malloc");
+		te->tqe_seq = seq;
+		te->tqe_len = TRACE_MSS;
+		if (use_tree) {
+			RB_INSERT(tsegqe_tree, &segq_tree, te);
+		}
+		if (p == NULL) {
+			LIST_INSERT_HEAD(&segq, te, tqe_q);
+		} else {
+			LIST_INSERT_AFTER(p, te, tqe_q);
+		}
+		len++;
+		*maxlen = MAX(*maxlen, len);
+
+		while ((q = LIST_FIRST(&segq)) != NULL &&
+		    q->tqe_seq == rcv_nxt) {
+			rcv_nxt += (tcp_seq)q->tqe_len;
+			LIST_REMOVE(q, tqe_q);
+			if (use_tree) {
+				RB_REMOVE(tsegqe_tree, &segq_tree, q);
+			}
+			free(q);
+			len--;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+
+	T_QUIET; T_EXPECT_TRUE(LIST_EMPTY(&segq), "reassembly queue drained");
+	T_QUIET; T_EXPECT_EQ(rcv_nxt, (tcp_seq)(TRACE_ISS +
+	    TRACE_SEGMENTS * TRACE_MSS), "everything reassembled");
+	return elapsed_ns(&start, &end) / (double)nooo;
+}
+
+static struct trace replay_trace;
+
+static void
+replay_setup(void)
+{
+	if (replay_trace.acks == NULL) {
+		trace_build(&replay_trace);
+		T_LOG("trace: %zu ACKs", replay_trace.nacks);
+	}
+}
+
+T_DECL(tcp_sack_scoreboard_replay,
+    "per-ACK SACK scoreboard cost, linear walk vs. tree lookup")
+{
+	uint64_t list_digest, tree_digest;
+	size_t list_holes, tree_holes;
+	double list_ns, tree_ns;
+
+	replay_setup();
+	list_ns = sack_replay(&replay_trace, false, &list_digest, &list_holes);
+	tree_ns = sack_replay(&replay_trace, true, &tree_digest, &tree_holes);
+	T_LOG("scoreboard: up to %zu holes, list %.1f ns/ACK, tree %.1f ns/ACK",
+	    tree_holes, list_ns, tree_ns);
+
+	T_ASSERT_EQ(list_digest, tree_digest,
+	    "list and tree scoreboards evolve identically");
+	T_ASSERT_EQ(list_holes, tree_holes, "same peak number of holes");
+	T_PERF("sack_doack_list", list_ns, "ns/ack",
+	    "SACK processing with the linear hole walk");
+	T_PERF("sack_doack_tree", tree_ns, "ns/ack",
+	    "SACK processing with the hole tree");
+}
+
+T_DECL(tcp_reass_queue_replay,
+    "per-segment reassembly queue cost, linear walk vs. tree lookup")
+{
+	size_t list_len, tree_len;
+	double list_ns, tree_ns;
+
+	replay_setup();
+	list_ns = reass_replay(&replay_trace, false, &list_len);
+	tree_ns = reass_replay(&replay_trace, true, &tree_len);
+	T_LOG("reassembly: up to %zu segments, list %.1f ns/seg, "
+	    "tree %.1f ns/seg", tree_len, list_ns, tree_ns);
+
+	T_ASSERT_EQ(list_len, tree_len, "same peak queue length");
+	T_PERF("reass_list", list_ns, "ns/segment",
+	    "out-of-order insertion with the linear queue walk");
+	T_PERF("reass_tree", tree_ns, "ns/segment",
+	    "out-of-order insertion with the queue tree");
+}
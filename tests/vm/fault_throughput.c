@@ -1,17 +1,25 @@
 /*
  * Benchmark VM fault throughput.
  * This test faults memory for a configurable amount of time across a
- * configurable number of threads. Currently it only measures zero fill faults.
- * Currently it supports two variants:
- * 1. Each thread gets its own vm objects to fault in
- * 2. Threads share vm objects
+ * configurable number of threads. It supports these variants:
+ * 1. Each thread gets its own vm objects to fault in (zero fill)
+ * 2. Threads share vm objects (zero fill)
+ * 3. Each thread gets its own read-only mapping of a file that is already
+ *    in the page cache (soft faults on file-backed memory)
+ * 4. Process launch: spawn a trivial binary in a loop and count the faults
+ *    each launch takes
  *
  * We'll add more fault types as we identify problematic user-facing workloads
  * in macro benchmarks.
  *
  * Throughput is reported as pages / second using both wall time and cpu time.
  * CPU time is a more reliable metric for regression testing, but wall time can
- * highlight blocking in the VM.
+ * highlight blocking in the VM. The number of faults taken per page touched
+ * is reported too, which shows how many pages each fault-around maps.
+ * The launch variant reports launches / second and faults / launch instead.
+ *
+ * -n turns fault-around off: on the mappings for the file-backed variant,
+ * and system wide (vm.fault_around_pages) for the launch variant.
  *
  * Running this benchmark directly is not recommended.
  * Use fault_throughput.lua which provides a nicer interface and outputs
@@ -21,13 +29,19 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <fcntl.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <unistd.h>
 
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/sysctl.h>
+#include <sys/wait.h>
 
 /*
  * TODO: Make this benchmark runnable on linux so we can do a perf comparison.
@@ -36,6 +50,7 @@
  * with the linux equivalent.
  */
 #include <mach/mach.h>
+#include <mach/mach_vm.h>
 
 #include <TargetConditionals.h>
 
@@ -61,6 +76,8 @@ const static size_t kVmObjectSize = 128 * (1UL << 20);
 const static size_t kVmObjectSize = 4 * (1UL << 20);
 #endif /* (TARGET_OS_OSX || TARGET_OS_SIMULATOR) */
 static const clockid_t kWallTimeClock = CLOCK_MONOTONIC_RAW;
+/* Size of the region the map churn thread maps and unmaps. */
+const static size_t kMapChurnSize = 64 * (1UL << 10);
 static const clockid_t kThreadCPUTimeClock = CLOCK_THREAD_CPUTIME_ID;
 /* These globals are set dynamically during test setup based on sysctls. */
 static uint64_t kCacheLineSize = 0;
@@ -75,7 +92,9 @@ typedef struct fault_buffer {
 
 typedef enum test_variant {
 	VARIANT_SEPARATE_VM_OBJECTS,
-	VARIANT_SHARE_VM_OBJECTS
+	VARIANT_SHARE_VM_OBJECTS,
+	VARIANT_FILE_BACKED,
+	VARIANT_LAUNCH
 } test_variant_t;
 
 typedef struct test_globals {
@@ -90,6 +109,20 @@ typedef struct test_globals {
 	size_t tg_iterations_completed;
 	unsigned int tg_num_threads;
 	test_variant_t tg_variant;
+	/* Backing file for the file-backed variant. */
+	int tg_fd;
+	/* Don't fault-around on the buffers. */
+	bool tg_no_fault_around;
+	/* Faults taken by the task before the first iteration. */
+	uint64_t tg_faults_start;
+	/* Change the address space from another thread while faulting. */
+	bool tg_map_churn;
+	pthread_t tg_churn_thread;
+	_Atomic bool tg_churn_stop;
+	/* mmap/mprotect/munmap rounds done by the churn thread, and over how long. */
+	_Atomic uint64_t tg_churn_rounds;
+	uint64_t tg_churn_start_ns;
+	uint64_t tg_churn_elapsed_ns;
 	/*
 	 * An array of memory objects to fault in.
 	 * This is basically a workqueue of
@@ -112,6 +145,10 @@ typedef struct test_globals {
 
 static const char* kSeparateObjectsArgument = "separate-objects";
 static const char* kShareObjectsArgument = "share-objects";
+static const char* kFileBackedArgument = "file-backed";
+static const char* kLaunchArgument = "launch";
+/* The binary spawned by the launch variant. */
+static const char* kLaunchPath = "/usr/bin/true";
 
 /* Arguments parsed from the command line */
 typedef struct test_args {
@@ -119,6 +156,8 @@ typedef struct test_args {
 	uint64_t duration_seconds;
 	test_variant_t variant;
 	bool verbose;
+	bool no_fault_around;
+	bool map_churn;
 } test_args_t;
 
 /*
@@ -172,12 +211,24 @@ static void setup_memory(test_globals_t* globals, test_variant_t variant);
  */
 static void output_results(const test_globals_t *globals, double walltime_elapsed_seconds, double cputime_elapsed_seconds);
 static void cleanup_test(test_globals_t *globals);
+/*
+ * Run the launch variant for the given duration and dump its results.
+ */
+static void run_launch_test(const test_args_t *args);
+/* Total number of faults taken by this task so far. */
+static uint64_t task_fault_count(void);
 /*
  * Join the background threads and return the total microseconds
  * of cpu time spent faulting across all of the threads.
  * Takes ownership of the threads array and frees it.
  */
 static uint64_t join_background_threads(test_globals_t *globals, pthread_t *threads);
+/*
+ * The map churn thread: maps, reprotects and unmaps a small region in a loop
+ * until the test is over, so that the faulting threads compete with
+ * address space changes as they would in a real multi-threaded process.
+ */
+static void *map_churn_thread(void *arg);
 static void unmap_fault_buffers(test_globals_t *globals);
 /*
  * Get the stride between each vm object in the fault buffer array.
@@ -202,7 +253,13 @@ main(int argc, char **argv)
 	uint64_t start_time_ns;
 	test_args_t args;
 	parse_arguments(argc, argv, &args);
+	if (args.variant == VARIANT_LAUNCH) {
+		run_launch_test(&args);
+		free(globals);
+		return 0;
+	}
 	pthread_t* threads = setup_test(globals, &args, kMemSize, args.verbose);
+	globals->tg_faults_start = task_fault_count();
 
 	/* Keep doing more iterations until we've hit our (wall) time budget */
 	while (wall_time_elapsed_ns < args.duration_seconds * kNumNanosecondsInSecond) {
@@ -390,13 +447,33 @@ finish_iteration(test_globals_t* globals, uint64_t start_time)
 	return end_time - start_time;
 }
 
+static unsigned char *
+mmap_file_buffer(test_globals_t *globals, size_t size)
+{
+	unsigned char *addr;
+	kern_return_t kr;
+
+	addr = mmap(NULL, size, PROT_READ, MAP_SHARED, globals->tg_fd, 0);
+	assert(addr != MAP_FAILED);
+	if (globals->tg_no_fault_around) {
+		kr = mach_vm_behavior_set(mach_task_self(), (mach_vm_address_t)addr,
+		    size, VM_BEHAVIOR_FAULT_AROUND_NONE);
+		assert(kr == KERN_SUCCESS);
+	}
+	return addr;
+}
+
 static void
 setup_memory(test_globals_t* globals, test_variant_t variant)
 {
 	size_t stride = fault_buffer_stride(globals);
 	for (size_t i = 0; i < globals->tg_fault_buffer_arr_length; i += stride) {
 		fault_buffer_t *object = &globals->tg_fault_buffer_arr[i];
-		object->fb_start = mmap_buffer(kVmObjectSize);
+		if (variant == VARIANT_FILE_BACKED) {
+			object->fb_start = mmap_file_buffer(globals, kVmObjectSize);
+		} else {
+			object->fb_start = mmap_buffer(kVmObjectSize);
+		}
 		object->fb_size = kVmObjectSize;
 		if (variant == VARIANT_SHARE_VM_OBJECTS) {
 			/*
@@ -410,7 +487,8 @@ setup_memory(test_globals_t* globals, test_variant_t variant)
 				offset_object->fb_start = object->fb_start + offset;
 				offset_object->fb_size = object->fb_size - offset;
 			}
-		} else if (variant != VARIANT_SEPARATE_VM_OBJECTS) {
+		} else if (variant != VARIANT_SEPARATE_VM_OBJECTS &&
+		    variant != VARIANT_FILE_BACKED) {
 			fprintf(stderr, "Unknown test variant.\n");
 			exit(2);
 		}
@@ -476,6 +554,37 @@ init_globals(test_globals_t *globals, const test_args_t *args)
 
 	globals->tg_num_threads = args->n_threads;
 	globals->tg_variant = args->variant;
+	globals->tg_no_fault_around = args->no_fault_around;
+	globals->tg_map_churn = args->map_churn;
+	globals->tg_fd = -1;
+}
+
+/*
+ * Create the file the file-backed variant maps, and leave its contents in
+ * the page cache so that every fault on it is a soft fault.
+ */
+static void
+init_backing_file(test_globals_t *globals)
+{
+	char path[] = "/tmp/fault_throughput.XXXXXX";
+	unsigned char *chunk;
+	size_t chunk_size = 1UL << 20;
+	ssize_t written;
+	int ret;
+
+	globals->tg_fd = mkstemp(path);
+	assert(globals->tg_fd >= 0);
+	ret = unlink(path);
+	assert(ret == 0);
+
+	chunk = malloc(chunk_size);
+	assert(chunk != NULL);
+	memset(chunk, 0xa5, chunk_size);
+	for (size_t off = 0; off < kVmObjectSize; off += chunk_size) {
+		written = pwrite(globals->tg_fd, chunk, chunk_size, (off_t)off);
+		assert(written == (ssize_t)chunk_size);
+	}
+	free(chunk);
 }
 
 static void
@@ -488,6 +597,9 @@ init_fault_buffer_arr(test_globals_t *globals, const test_args_t *args, size_t m
 		// This variant creates separate vm objects up to memory size bytes total
 		// And places a pointer into each vm object for each thread.
 		globals->tg_fault_buffer_arr_length = memory_size / kVmObjectSize * globals->tg_num_threads;
+	} else if (args->variant == VARIANT_FILE_BACKED) {
+		// This variant creates separate mappings of one file up to memory size bytes total
+		globals->tg_fault_buffer_arr_length = memory_size / kVmObjectSize;
 	} else {
 		fprintf(stderr, "Unsupported test variant.\n");
 		exit(2);
@@ -525,12 +637,42 @@ setup_test(test_globals_t *globals, const test_args_t *args, size_t memory_size,
 {
 	init_globals(globals, args);
 	init_fault_buffer_arr(globals, args, memory_size);
+	if (args->variant == VARIANT_FILE_BACKED) {
+		init_backing_file(globals);
+	}
 	benchmark_log(verbose, "Initialized global data structures.\n");
 	pthread_t *workers = spawn_worker_threads(globals, args->n_threads);
 	benchmark_log(verbose, "Spawned workers.\n");
+	if (globals->tg_map_churn) {
+		int ret;
+		globals->tg_churn_start_ns = current_timestamp_ns();
+		ret = pthread_create(&globals->tg_churn_thread, NULL, map_churn_thread, globals);
+		assert(ret == 0);
+		benchmark_log(verbose, "Spawned map churn thread.\n");
+	}
 	return workers;
 }
 
+static void *
+map_churn_thread(void *arg)
+{
+	test_globals_t *globals = arg;
+	unsigned char *addr;
+	int ret;
+
+	while (!atomic_load_explicit(&globals->tg_churn_stop, memory_order_acquire)) {
+		addr = mmap(NULL, kMapChurnSize, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+		assert(addr != MAP_FAILED);
+		*addr = 1;
+		ret = mprotect(addr, kMapChurnSize, PROT_READ);
+		assert(ret == 0);
+		ret = munmap(addr, kMapChurnSize);
+		assert(ret == 0);
+		atomic_fetch_add_explicit(&globals->tg_churn_rounds, 1, memory_order_relaxed);
+	}
+	return NULL;
+}
+
 static uint64_t
 join_background_threads(test_globals_t *globals, pthread_t *threads)
 {
@@ -545,6 +687,13 @@ join_background_threads(test_globals_t *globals, pthread_t *threads)
 	ret = pthread_mutex_unlock(&globals->tg_lock);
 	assert(ret == 0);
 
+	if (globals->tg_map_churn) {
+		atomic_store_explicit(&globals->tg_churn_stop, true, memory_order_release);
+		ret = pthread_join(globals->tg_churn_thread, NULL);
+		assert(ret == 0);
+		globals->tg_churn_elapsed_ns = current_timestamp_ns() - globals->tg_churn_start_ns;
+	}
+
 	// Join the background threads
 	for (unsigned int i = 0; i < globals->tg_num_threads; i++) {
 		uint64_t cputime_spent_faulting = 0;
@@ -564,6 +713,10 @@ cleanup_test(test_globals_t* globals)
 	assert(ret == 0);
 	ret = pthread_cond_destroy(&globals->tg_cv);
 	assert(ret == 0);
+	if (globals->tg_fd >= 0) {
+		ret = close(globals->tg_fd);
+		assert(ret == 0);
+	}
 	free(globals->tg_fault_buffer_arr);
 	free(globals);
 }
@@ -576,6 +729,7 @@ output_results(const test_globals_t* globals, double walltime_elapsed_seconds, d
 	int ret = sysctlbyname("vm.pagesize", &pgsize, &sysctl_size, NULL, 0);
 	assert(ret == 0);
 	size_t num_pages = 0;
+	uint64_t num_faults = task_fault_count() - globals->tg_faults_start;
 	double walltime_throughput, cputime_throughput;
 	size_t stride = fault_buffer_stride(globals);
 	for (size_t i = 0; i < globals->tg_fault_buffer_arr_length; i += stride) {
@@ -585,17 +739,98 @@ output_results(const test_globals_t* globals, double walltime_elapsed_seconds, d
 	walltime_throughput = num_pages / walltime_elapsed_seconds;
 	cputime_throughput = num_pages / cputime_elapsed_seconds;
 	printf("-----Results-----\n");
-	printf("Throughput (pages / wall second), Throughput (pages / CPU second)\n");
-	printf("%f,%f\n", walltime_throughput, cputime_throughput);
+	if (globals->tg_map_churn) {
+		printf("Throughput (pages / wall second), Throughput (pages / CPU second), Faults per page, Map churn (rounds / wall second)\n");
+		printf("%f,%f,%f,%f\n", walltime_throughput, cputime_throughput,
+		    num_pages ? (double)num_faults / num_pages : 0.0,
+		    (double)atomic_load(&globals->tg_churn_rounds) * kNumNanosecondsInSecond / globals->tg_churn_elapsed_ns);
+	} else {
+		printf("Throughput (pages / wall second), Throughput (pages / CPU second), Faults per page\n");
+		printf("%f,%f,%f\n", walltime_throughput, cputime_throughput,
+		    num_pages ? (double)num_faults / num_pages : 0.0);
+	}
+}
+
+static uint64_t
+task_fault_count(void)
+{
+	task_events_info_data_t info;
+	mach_msg_type_number_t count = TASK_EVENTS_INFO_COUNT;
+	kern_return_t kr;
+
+	kr = task_info(mach_task_self(), TASK_EVENTS_INFO, (task_info_t)&info, &count);
+	assert(kr == KERN_SUCCESS);
+	return (uint64_t)info.faults;
+}
+
+static void
+set_fault_around_pages(unsigned int pages, unsigned int *old_pages)
+{
+	size_t size = sizeof(*old_pages);
+	int ret;
+
+	ret = sysctlbyname("vm.fault_around_pages", old_pages, &size, &pages, sizeof(pages));
+	if (ret != 0) {
+		fprintf(stderr, "Unable to set vm.fault_around_pages: %s\n", strerror(errno));
+		exit(1);
+	}
+}
+
+static void
+run_launch_test(const test_args_t *args)
+{
+	char *spawn_argv[] = { (char *)(uintptr_t)kLaunchPath, NULL };
+	extern char **environ;
+	struct rusage ru;
+	uint64_t start_time_ns, wall_time_elapsed_ns = 0;
+	uint64_t num_launches = 0, num_faults = 0;
+	unsigned int old_pages = 0;
+	pid_t pid;
+	int ret, status;
+
+	if (args->no_fault_around) {
+		set_fault_around_pages(0, &old_pages);
+	}
+
+	/*
+	 * One spawn at a time: the child's faults come from its rusage, so
+	 * the number of threads doesn't change what is measured.
+	 */
+	start_time_ns = current_timestamp_ns();
+	while (wall_time_elapsed_ns < args->duration_seconds * kNumNanosecondsInSecond) {
+		ret = posix_spawn(&pid, kLaunchPath, NULL, NULL, spawn_argv, environ);
+		assert(ret == 0);
+		ret = wait4(pid, &status, 0, &ru);
+		assert(ret == pid);
+		assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		num_faults += (uint64_t)(ru.ru_minflt + ru.ru_majflt);
+		num_launches++;
+		wall_time_elapsed_ns = current_timestamp_ns() - start_time_ns;
+	}
+	benchmark_log(args->verbose, "Completed %llu launches\n", num_launches);
+
+	if (args->no_fault_around) {
+		set_fault_around_pages(old_pages, &old_pages);
+	}
+
+	printf("-----Results-----\n");
+	printf("Throughput (launches / wall second), Faults per launch\n");
+	printf("%f,%f\n", (double)num_launches * kNumNanosecondsInSecond / wall_time_elapsed_ns,
+	    (double)num_faults / num_launches);
 }
 
 static void
 print_help(char** argv)
 {
-	fprintf(stderr, "%s: <test-variant> [-v] duration num_threads\n", argv[0]);
+	fprintf(stderr, "%s: [-v] [-n] [-c] <test-variant> duration num_threads\n", argv[0]);
+	fprintf(stderr, "\n	-v	Verbose.\n");
+	fprintf(stderr, "	-n	Disable fault-around.\n");
+	fprintf(stderr, "	-c	Map, mprotect and unmap memory in another thread while faulting.\n");
 	fprintf(stderr, "\ntest variants:\n");
 	fprintf(stderr, "	%s	Fault in different vm objects in each thread.\n", kSeparateObjectsArgument);
 	fprintf(stderr, "	%s		Share vm objects across faulting threads.\n", kShareObjectsArgument);
+	fprintf(stderr, "	%s		Fault in separate mappings of a cached file in each thread.\n", kFileBackedArgument);
+	fprintf(stderr, "	%s			Spawn %s in a loop.\n", kLaunchArgument, kLaunchPath);
 }
 
 static void
@@ -603,13 +838,17 @@ parse_arguments(int argc, char** argv, test_args_t *args)
 {
 	int current_argument = 1;
 	memset(args, 0, sizeof(test_args_t));
-	if (argc < 4 || argc > 6) {
+	if (argc < 4 || argc > 7) {
 		print_help(argv);
 		exit(1);
 	}
-	if (argv[current_argument][0] == '-') {
+	while (current_argument < argc - 3 && argv[current_argument][0] == '-') {
 		if (strcmp(argv[current_argument], "-v") == 0) {
 			args->verbose = true;
+		} else if (strcmp(argv[current_argument], "-n") == 0) {
+			args->no_fault_around = true;
+		} else if (strcmp(argv[current_argument], "-c") == 0) {
+			args->map_churn = true;
 		} else {
 			fprintf(stderr, "Unknown argument %s\n", argv[current_argument]);
 			print_help(argv);
@@ -621,6 +860,10 @@ parse_arguments(int argc, char** argv, test_args_t *args)
 		args->variant = VARIANT_SEPARATE_VM_OBJECTS;
 	} else if (strncasecmp(argv[current_argument], kShareObjectsArgument, strlen(kShareObjectsArgument)) == 0) {
 		args->variant = VARIANT_SHARE_VM_OBJECTS;
+	} else if (strncasecmp(argv[current_argument], kFileBackedArgument, strlen(kFileBackedArgument)) == 0) {
+		args->variant = VARIANT_FILE_BACKED;
+	} else if (strncasecmp(argv[current_argument], kLaunchArgument, strlen(kLaunchArgument)) == 0) {
+		args->variant = VARIANT_LAUNCH;
 	} else {
 		print_help(argv);
 		exit(1);
@@ -652,7 +895,8 @@ static size_t
 fault_buffer_stride(const test_globals_t *globals)
 {
 	size_t stride;
-	if (globals->tg_variant == VARIANT_SEPARATE_VM_OBJECTS) {
+	if (globals->tg_variant == VARIANT_SEPARATE_VM_OBJECTS ||
+	    globals->tg_variant == VARIANT_FILE_BACKED) {
 		stride = 1;
 	} else if (globals->tg_variant == VARIANT_SHARE_VM_OBJECTS) {
 		stride = globals->tg_num_threads;
@@ -37,23 +37,46 @@ local benchmark = benchrun.new {
         }
         parser:option{
             name = '--variant',
-            description = 'Which benchmark variant to run (sparate-objects or share-objects)',
+            description = 'Which benchmark variant to run (sparate-objects, share-objects, file-backed or launch)',
             default = 'separate-objects'
         }
+        parser:flag{
+            name = '--no-fault-around',
+            description = 'Disable fault-around'
+        }
+        parser:flag{
+            name = '--map-churn',
+            description = 'Map and unmap memory in another thread while faulting'
+        }
     end
 }
 
 assert(benchmark.opt.path, "No path supplied for fault throughput binary")
 assert(benchmark.opt.variant == "separate-objects" or
-    benchmark.opt.variant == "share-objects", "Unsupported benchmark variant")
+    benchmark.opt.variant == "share-objects" or
+    benchmark.opt.variant == "file-backed" or
+    benchmark.opt.variant == "launch", "Unsupported benchmark variant")
 
 local ncpus, err = sysctl('hw.logicalcpu_max')
 assert(ncpus > 0, 'invalid number of logical cpus')
 local cpu_workers = tonumber(benchmark.opt.cpu_workers) or ncpus
 
-local unit = perfdata.unit.custom('pages/sec')
 local tests = {}
 
+-- Throughput columns are larger-is-better, fault counts smaller-is-better.
+function ColumnUnit(name)
+    if name:match("^Faults per page") then
+        return perfdata.unit.custom('faults/page'), false
+    elseif name:match("^Faults per launch") then
+        return perfdata.unit.custom('faults/launch'), false
+    elseif name:match("launches") then
+        return perfdata.unit.custom('launches/sec'), true
+    elseif name:match("^Map churn") then
+        return perfdata.unit.custom('rounds/sec'), true
+    end
+    return perfdata.unit.custom('pages/sec'), true
+end
+
 function QueueTest(num_cores)
     table.insert(tests, {
         path = benchmark.opt.path,
@@ -61,7 +84,10 @@ function QueueTest(num_cores)
     })
 end
 
-if benchmark.opt.through_max_workers then
+if benchmark.opt.variant == "launch" then
+    -- Launches are measured one at a time.
+    QueueTest(1)
+elseif benchmark.opt.through_max_workers then
     for i = 1, cpu_workers do
         QueueTest(i)
     end
@@ -84,16 +110,25 @@ end
 for _, test in ipairs(tests) do
     local args = {test.path, "-v", benchmark.opt.variant, benchmark.opt.duration, test.num_cores,
                      echo = true}
+    if benchmark.opt.no_fault_around then
+        table.insert(args, 3, "-n")
+    end
+    if benchmark.opt.map_churn then
+        table.insert(args, 3, "-c")
+    end
     for out in benchmark:run(args) do
         local result = out:match("-----Results-----\n(.*)")
         benchmark:assert(result, "Unable to find result data in output")
         local data = csv.openstring(result, {header = true})
         for field in data:lines() do
             for k, v in pairs(field) do
+                local unit, larger_better = ColumnUnit(k)
                 benchmark.writer:add_value(k, unit, tonumber(v), {
-                  [perfdata.larger_better] = true,
+                  [perfdata.larger_better] = larger_better,
                   threads = test.num_cores,
-                  variant = benchmark.opt.variant
+                  variant = benchmark.opt.variant,
+                  fault_around = not benchmark.opt.no_fault_around,
+                  map_churn = benchmark.opt.map_churn and true or false
                 })
             end
         end
@@ -26,7 +26,7 @@ typedef struct {
  * Children pids spawned by this test that need to be cleaned up.
  * Has to be a global because the T_ATEND API doesn't take any arguments.
  */
-#define kMaxChildrenProcs 16
+#define kMaxChildrenProcs 128
 static pid_t children_pids[kMaxChildrenProcs];
 static size_t num_children = 0;
 
@@ -193,6 +193,57 @@ T_DECL(memorystatus_sort_footprint, "Footprint sort order",
 #undef kNumChildren
 }
 
+/*
+ * Measure how long sorting the idle band by footprint takes.
+ *
+ * Spawns a bunch of children with different footprints in the idle
+ * band, in no particular order, and then has the kernel sort the band
+ * over and over.
+ */
+T_DECL(memorystatus_sort_footprint_perf, "Footprint sort latency",
+    T_META_ASROOT(true), T_META_TAG_PERF) {
+#define kNumChildren 96
+#define kFootprintStepPages 64
+	static const int kJetsamBand = JETSAM_PRIORITY_IDLE;
+	__block pid_t pid;
+	sig_t res;
+	dispatch_source_t ds_allocated;
+	T_ATEND(cleanup_children);
+
+	res = signal(SIGUSR1, SIG_IGN);
+	T_WITH_ERRNO; T_ASSERT_NE(res, SIG_ERR, "SIG_IGN SIGUSR1");
+	ds_allocated = dispatch_source_create(DISPATCH_SOURCE_TYPE_SIGNAL, SIGUSR1, 0, dispatch_get_main_queue());
+	T_QUIET; T_ASSERT_NOTNULL(ds_allocated, "dispatch_source_create (ds_allocated)");
+
+	dispatch_source_set_event_handler(ds_allocated, ^{
+		if (num_children < kNumChildren) {
+			/* 37 and kNumChildren are coprime, so every size shows up once */
+			pid = launch_proc_in_coalition(NULL, 0, (int)((num_children * 37) % kNumChildren) * kFootprintStepPages);
+			place_proc_in_band(pid, kJetsamBand);
+		} else {
+			dt_stat_time_t s = dt_stat_time_create("sort_time");
+			int ret = 0;
+			while (!dt_stat_stable(s)) {
+				T_STAT_MEASURE(s) {
+					ret = memorystatus_control(MEMORYSTATUS_CMD_TEST_JETSAM_SORT, kJetsamBand, 0, NULL, 0);
+				}
+				T_QUIET; T_ASSERT_EQ(ret, 0, "sort the idle band");
+			}
+			dt_stat_finalize(s);
+			T_END;
+		}
+	});
+	dispatch_activate(ds_allocated);
+
+	pid = launch_proc_in_coalition(NULL, 0, 0);
+	place_proc_in_band(pid, kJetsamBand);
+
+	dispatch_main();
+
+#undef kFootprintStepPages
+#undef kNumChildren
+}
+
 static pid_t
 launch_proc_in_coalition(uint64_t *coalition_ids, int role, int num_pages)
 {
@@ -0,0 +1,200 @@
+/*
+ * Time-to-first-touch benchmark.
+ *
+ * Allocates an anonymous buffer (1GB by default), writes one byte to
+ * each of its pages, and reports how long that took.  Nearly all of it
+ * is zero-fill faults, whose cost is dominated by zeroing the pages
+ * unless they come from the pool of pre-zeroed pages
+ * (vm.page_zeroed_target).
+ *
+ * -n turns the pre-zeroed pool off for the run, which needs root; the
+ * previous target is restored on exit.  Pages already in the pool still
+ * get used, so touch a buffer much larger than the pool.  On x86_64,
+ * run with vm.superpage=0: the blocks backed by transparent superpages
+ * are zeroed when they are filled and don't come from the pool.
+ *
+ * The time is wall time, since the pool is filled by another thread;
+ * the run pauses before each iteration to give that thread a chance.
+ *
+ * Running this benchmark directly is not recommended.
+ * Use perf_first_touch.lua which provides a nicer interface and
+ * outputs perfdata.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/sysctl.h>
+
+#include "benchmark/helpers.h"
+
+/* Arguments parsed from the command line */
+typedef struct test_args {
+	uint64_t ta_iterations;
+	uint64_t ta_size;
+	bool ta_no_pool;
+	bool ta_verbose;
+} test_args_t;
+
+static void print_help(char **argv);
+static void parse_arguments(int argc, char** argv, test_args_t *args);
+static double first_touch_test(const test_args_t *args);
+static uint64_t read_pool_hits(void);
+static void set_pool_target(unsigned int target);
+static void restore_pool_target(void);
+static void output_time(double seconds);
+
+/* how long to let the pool refill between iterations */
+static const unsigned int kRefillSeconds = 2;
+static size_t kPageSize = 0;
+static int64_t saved_pool_target = -1;
+
+int
+main(int argc, char** argv)
+{
+	test_args_t args;
+	parse_arguments(argc, argv, &args);
+	if (args.ta_no_pool) {
+		set_pool_target(0);
+	}
+	output_time(first_touch_test(&args));
+	return 0;
+}
+
+static double
+first_touch_test(const test_args_t *args)
+{
+	size_t pagesize_size = sizeof(kPageSize);
+	uint64_t total_ns = 0, start, end, hits;
+	unsigned char *buffer;
+	int ret;
+
+	ret = sysctlbyname("vm.pagesize", &kPageSize, &pagesize_size, NULL, 0);
+	assert(ret == 0);
+	assert(kPageSize > 0);
+
+	for (uint64_t i = 0; i < args->ta_iterations; i++) {
+		sleep(kRefillSeconds);
+		hits = read_pool_hits();
+		buffer = mmap_buffer(args->ta_size);
+
+		start = current_timestamp_ns();
+		for (size_t offset = 0; offset < args->ta_size; offset += kPageSize) {
+			buffer[offset] = 1;
+		}
+		end = current_timestamp_ns();
+		total_ns += end - start;
+
+		benchmark_log(args->ta_verbose, "Iteration %llu: %llu pages from the pre-zeroed pool\n",
+		    i + 1, read_pool_hits() - hits);
+		ret = munmap(buffer, args->ta_size);
+		assert(ret == 0);
+	}
+	return (double)total_ns / args->ta_iterations / kNumNanosecondsInSecond;
+}
+
+static uint64_t
+read_pool_hits(void)
+{
+	uint64_t value = 0;
+	size_t size = sizeof(value);
+
+	if (sysctlbyname("vm.page_zeroed_hits", &value, &size, NULL, 0) != 0) {
+		return 0;
+	}
+	return value;
+}
+
+static void
+set_pool_target(unsigned int target)
+{
+	unsigned int old;
+	size_t size = sizeof(old);
+
+	if (sysctlbyname("vm.page_zeroed_target", &old, &size, &target, sizeof(target)) != 0) {
+		fprintf(stderr, "Unable to set vm.page_zeroed_target: %s\n", strerror(errno));
+		exit(1);
+	}
+	saved_pool_target = old;
+	atexit(restore_pool_target);
+}
+
+static void
+restore_pool_target(void)
+{
+	unsigned int target;
+
+	if (saved_pool_target >= 0) {
+		target = (unsigned int)saved_pool_target;
+		sysctlbyname("vm.page_zeroed_target", NULL, NULL, &target, sizeof(target));
+	}
+}
+
+static void
+parse_arguments(int argc, char** argv, test_args_t *args)
+{
+	int current_positional_argument = 0;
+	long iterations = -1, size_mb = -1;
+	memset(args, 0, sizeof(test_args_t));
+	for (int current_argument = 1; current_argument < argc; current_argument++) {
+		if (argv[current_argument][0] == '-') {
+			if (strcmp(argv[current_argument], "-v") == 0) {
+				args->ta_verbose = true;
+			} else if (strcmp(argv[current_argument], "-n") == 0) {
+				args->ta_no_pool = true;
+			} else {
+				fprintf(stderr, "Unknown argument %s\n", argv[current_argument]);
+				print_help(argv);
+				exit(1);
+			}
+		} else {
+			if (current_positional_argument == 0) {
+				iterations = strtol(argv[current_argument], NULL, 10);
+				if (iterations <= 0) {
+					print_help(argv);
+					exit(1);
+				}
+				current_positional_argument++;
+			} else if (current_positional_argument == 1) {
+				size_mb = strtol(argv[current_argument], NULL, 10);
+				if (size_mb <= 0) {
+					print_help(argv);
+					exit(1);
+				}
+				current_positional_argument++;
+			} else {
+				print_help(argv);
+				exit(1);
+			}
+		}
+	}
+	if (current_positional_argument != 2) {
+		fprintf(stderr, "Expected 2 positional arguments. %d were supplied.\n", current_positional_argument);
+		print_help(argv);
+		exit(1);
+	}
+	args->ta_iterations = (uint64_t) iterations;
+	args->ta_size = ((uint64_t) size_mb * (1UL << 20));
+}
+
+static void
+print_help(char** argv)
+{
+	fprintf(stderr, "%s: [-v] [-n] iterations size_mb\n", argv[0]);
+	fprintf(stderr, "\n	-n	Turn the pre-zeroed page pool off for the run (needs root).\n");
+}
+
+static void
+output_time(double seconds)
+{
+	printf("-----Results-----\n");
+	printf("Time to first touch (seconds)\n");
+	printf("%f\n", seconds);
+}
@@ -0,0 +1,70 @@
+#!/usr/local/bin/recon
+
+local benchrun = require 'benchrun'
+local perfdata = require 'perfdata'
+local csv = require 'csv'
+
+require 'strict'
+
+local kDefaultIterations = 5
+local kDefaultSizeMb = 1024
+
+local benchmark = benchrun.new {
+    name = 'xnu.first_touch',
+    version = 1,
+    arg = arg,
+    modify_argparser = function(parser)
+        parser:argument {
+          name = 'path',
+          description = 'Path to perf_first_touch binary'
+        }
+        parser:option{
+          name = '--iterations',
+          description = 'How many buffers to allocate and touch',
+          default = kDefaultIterations
+        }
+        parser:option{
+            name = '--size',
+            description = 'Buffer size (MB)',
+            default = kDefaultSizeMb
+        }
+        parser:flag{
+            name = '--no-pool',
+            description = 'Turn the pre-zeroed page pool off for the run (needs root)'
+        }
+        parser:flag{
+            name = '--verbose',
+            description = 'Enable verbose logging',
+        }
+    end
+}
+
+local unit = perfdata.unit.custom('seconds')
+local variant = benchmark.opt.no_pool and 'inline-zeroing' or 'pre-zeroed-pool'
+
+local args = {benchmark.opt.path}
+if benchmark.opt.no_pool then
+    table.insert(args, "-n")
+end
+if benchmark.opt.verbose then
+    table.insert(args, "-v")
+end
+table.insert(args, benchmark.opt.iterations)
+table.insert(args, benchmark.opt.size)
+args.echo = true
+for out in benchmark:run(args) do
+    local result = out:match("-----Results-----\n(.*)")
+    benchmark:assert(result, "Unable to find result data in output")
+    local data = csv.openstring(result, {header = true})
+    for field in data:lines() do
+        for k, v in pairs(field) do
+            benchmark.writer:add_value(k, unit, tonumber(v), {
+              [perfdata.larger_better] = false,
+              variant = variant
+            })
+        end
+    end
+end
+benchmark.writer:set_primary_metric("Time to first touch (seconds)")
+
+benchmark:finish()
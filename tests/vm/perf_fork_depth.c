@@ -0,0 +1,304 @@
+/*
+ * Fork depth benchmark.
+ *
+ * Measures the cost of read faults on anonymous memory inherited through
+ * a chain of forks.  For each depth (1, 2, 4, ... up to max_depth), the
+ * benchmark fills a buffer and forks that many generations of processes,
+ * each of which writes to the first page of the buffer before forking
+ * the next, so that each generation gets its own object shadowing the
+ * one of its parent.  The deepest generation then forks one reader per
+ * iteration, which reads every other page of the buffer; each of those
+ * faults walks the whole shadow chain down to the pages of the first
+ * object.
+ *
+ * By default every generation stays around until the readers are done,
+ * which keeps the intermediate objects referenced by their maps so no
+ * part of the chain can be collapsed.  With -x, each generation exits
+ * as soon as its child has made its own object, which is what happens
+ * with a server that forks a worker and replaces itself with it: the
+ * objects in the middle of the chain are then only referenced by the
+ * object above them, and the background collapser (vm.object_collapser)
+ * can shorten the chain between iterations.
+ *
+ * Running this benchmark directly is not recommended.
+ * Use perf_fork_depth.lua which provides a nicer interface and
+ * outputs perfdata.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <mach/mach.h>
+#include <sys/mman.h>
+#include <sys/sysctl.h>
+#include <sys/wait.h>
+
+#include "benchmark/helpers.h"
+
+/* Arguments parsed from the command line */
+typedef struct test_args {
+	uint64_t ta_iterations;
+	uint64_t ta_size;
+	unsigned int ta_max_depth;
+	bool ta_exit_early;
+	bool ta_verbose;
+} test_args_t;
+
+static void print_help(char **argv);
+static void parse_arguments(int argc, char** argv, test_args_t *args);
+/*
+ * Build a chain of the given depth and return the average time of a
+ * read fault at the bottom of it, in nanoseconds.
+ */
+static double fork_depth_test(const test_args_t *args, unsigned int depth);
+/*
+ * Runs in generation "generation" of the chain.  Writes the average
+ * fault time to result_fd once the deepest generation is done, and
+ * a byte to ready_fd once this generation has its own object.
+ */
+static void run_generation(const test_args_t *args, unsigned char *buffer,
+    unsigned int generation, unsigned int depth, int result_fd, int ready_fd);
+static uint64_t run_reader(const test_args_t *args, unsigned char *buffer);
+static void output_results(const test_args_t *args, const double *latencies);
+
+/* how long the deepest generation waits before each reader */
+static const unsigned int kSettleSeconds = 1;
+static size_t kPageSize = 0;
+
+int
+main(int argc, char** argv)
+{
+	test_args_t args;
+	double latencies[32];
+	size_t pagesize_size = sizeof(kPageSize);
+	unsigned int depth, i;
+	int ret;
+
+	parse_arguments(argc, argv, &args);
+	ret = sysctlbyname("vm.pagesize", &kPageSize, &pagesize_size, NULL, 0);
+	assert(ret == 0);
+	assert(kPageSize > 0);
+
+	for (depth = 1, i = 0; depth <= args.ta_max_depth; depth *= 2, i++) {
+		latencies[i] = fork_depth_test(&args, depth);
+		benchmark_log(args.ta_verbose, "Depth %u: %f ns per fault\n", depth, latencies[i]);
+	}
+	output_results(&args, latencies);
+	return 0;
+}
+
+static double
+fork_depth_test(const test_args_t *args, unsigned int depth)
+{
+	unsigned char *buffer;
+	int result_pipe[2];
+	double latency;
+	ssize_t count;
+	pid_t pid;
+	int ret, status;
+
+	buffer = mmap_buffer(args->ta_size);
+	for (size_t offset = 0; offset < args->ta_size; offset += kPageSize) {
+		buffer[offset] = 1;
+	}
+
+	ret = pipe(result_pipe);
+	assert(ret == 0);
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		close(result_pipe[0]);
+		run_generation(args, buffer, 1, depth, result_pipe[1], -1);
+		_exit(0);
+	}
+	close(result_pipe[1]);
+
+	count = read(result_pipe[0], &latency, sizeof(latency));
+	if (count != sizeof(latency)) {
+		fprintf(stderr, "No result from the chain of depth %u\n", depth);
+		exit(1);
+	}
+	close(result_pipe[0]);
+	ret = waitpid(pid, &status, 0);
+	assert(ret == pid);
+
+	ret = munmap(buffer, args->ta_size);
+	assert(ret == 0);
+	return latency;
+}
+
+static void
+run_generation(const test_args_t *args, unsigned char *buffer,
+    unsigned int generation, unsigned int depth, int result_fd, int ready_fd)
+{
+	int ready_pipe[2];
+	uint64_t total_ns = 0;
+	double latency;
+	char ready = 1;
+	pid_t pid;
+	int ret, status;
+
+	/* copy-on-write fault: this generation gets its own shadow object */
+	buffer[0] = (unsigned char)generation;
+
+	if (generation == depth) {
+		if (ready_fd >= 0) {
+			write(ready_fd, &ready, sizeof(ready));
+			close(ready_fd);
+		}
+		for (uint64_t i = 0; i < args->ta_iterations; i++) {
+			sleep(kSettleSeconds);
+			total_ns += run_reader(args, buffer);
+		}
+		latency = (double)total_ns / args->ta_iterations /
+		    (args->ta_size / kPageSize - 1);
+		write(result_fd, &latency, sizeof(latency));
+		return;
+	}
+
+	ret = pipe(ready_pipe);
+	assert(ret == 0);
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		close(ready_pipe[0]);
+		if (ready_fd >= 0) {
+			close(ready_fd);
+		}
+		run_generation(args, buffer, generation + 1, depth, result_fd, ready_pipe[1]);
+		_exit(0);
+	}
+	close(ready_pipe[1]);
+	close(result_fd);
+
+	/* wait for the child to have its own object */
+	read(ready_pipe[0], &ready, sizeof(ready));
+	close(ready_pipe[0]);
+	if (ready_fd >= 0) {
+		write(ready_fd, &ready, sizeof(ready));
+		close(ready_fd);
+	}
+	if (!args->ta_exit_early) {
+		ret = waitpid(pid, &status, 0);
+		assert(ret == pid);
+	}
+}
+
+static uint64_t
+run_reader(const test_args_t *args, unsigned char *buffer)
+{
+	task_vm_info_data_t info;
+	mach_msg_type_number_t count;
+	volatile unsigned char val;
+	uint64_t start, end, elapsed;
+	int time_pipe[2];
+	kern_return_t kr;
+	pid_t pid;
+	int ret, status;
+
+	ret = pipe(time_pipe);
+	assert(ret == 0);
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		close(time_pipe[0]);
+		/* page 0 is in our own object, every other one at the bottom */
+		start = current_timestamp_ns();
+		for (size_t offset = kPageSize; offset < args->ta_size; offset += kPageSize) {
+			val = buffer[offset];
+		}
+		end = current_timestamp_ns();
+		(void)val;
+		elapsed = end - start;
+
+		count = TASK_VM_INFO_COUNT;
+		kr = task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count);
+		if (kr == KERN_SUCCESS && count >= TASK_VM_INFO_REV6_COUNT) {
+			benchmark_log(args->ta_verbose, "Reader walked shadow chains of up to %d objects, %d deep faults\n",
+			    info.shadow_depth_max, info.deep_shadow_faults);
+		}
+		write(time_pipe[1], &elapsed, sizeof(elapsed));
+		_exit(0);
+	}
+	close(time_pipe[1]);
+	if (read(time_pipe[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed)) {
+		fprintf(stderr, "No result from the reader\n");
+		exit(1);
+	}
+	close(time_pipe[0]);
+	ret = waitpid(pid, &status, 0);
+	assert(ret == pid);
+	return elapsed;
+}
+
+static void
+parse_arguments(int argc, char** argv, test_args_t *args)
+{
+	int current_positional_argument = 0;
+	long values[3] = {-1, -1, -1};
+	memset(args, 0, sizeof(test_args_t));
+	for (int current_argument = 1; current_argument < argc; current_argument++) {
+		if (argv[current_argument][0] == '-') {
+			if (strcmp(argv[current_argument], "-v") == 0) {
+				args->ta_verbose = true;
+			} else if (strcmp(argv[current_argument], "-x") == 0) {
+				args->ta_exit_early = true;
+			} else {
+				fprintf(stderr, "Unknown argument %s\n", argv[current_argument]);
+				print_help(argv);
+				exit(1);
+			}
+		} else if (current_positional_argument < 3) {
+			values[current_positional_argument] = strtol(argv[current_argument], NULL, 10);
+			if (values[current_positional_argument] <= 0) {
+				print_help(argv);
+				exit(1);
+			}
+			current_positional_argument++;
+		} else {
+			print_help(argv);
+			exit(1);
+		}
+	}
+	if (current_positional_argument != 3) {
+		fprintf(stderr, "Expected 3 positional arguments. %d were supplied.\n", current_positional_argument);
+		print_help(argv);
+		exit(1);
+	}
+	if (values[2] > 32) {
+		fprintf(stderr, "max_depth can be at most 32.\n");
+		print_help(argv);
+		exit(1);
+	}
+	args->ta_iterations = (uint64_t) values[0];
+	args->ta_size = ((uint64_t) values[1] * (1UL << 20));
+	args->ta_max_depth = (unsigned int) values[2];
+}
+
+static void
+print_help(char** argv)
+{
+	fprintf(stderr, "%s: [-v] [-x] iterations size_mb max_depth\n", argv[0]);
+	fprintf(stderr, "\n	-x	Have each generation exit once its child has its own object.\n");
+}
+
+static void
+output_results(const test_args_t *args, const double *latencies)
+{
+	unsigned int depth, i;
+
+	printf("-----Results-----\n");
+	for (depth = 1; depth <= args->ta_max_depth; depth *= 2) {
+		printf("%sFault latency at depth %u (ns)", depth == 1 ? "" : ",", depth);
+	}
+	printf("\n");
+	for (depth = 1, i = 0; depth <= args->ta_max_depth; depth *= 2, i++) {
+		printf("%s%f", depth == 1 ? "" : ",", latencies[i]);
+	}
+	printf("\n");
+}
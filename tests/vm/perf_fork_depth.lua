@@ -0,0 +1,81 @@
+#!/usr/local/bin/recon
+
+local benchrun = require 'benchrun'
+local perfdata = require 'perfdata'
+local csv = require 'csv'
+
+require 'strict'
+
+local kDefaultIterations = 5
+local kDefaultSizeMb = 256
+local kDefaultMaxDepth = 32
+
+local benchmark = benchrun.new {
+    name = 'xnu.fork_depth',
+    version = 1,
+    arg = arg,
+    modify_argparser = function(parser)
+        parser:argument {
+          name = 'path',
+          description = 'Path to perf_fork_depth binary'
+        }
+        parser:option{
+          name = '--iterations',
+          description = 'How many times to read the buffer at each depth',
+          default = kDefaultIterations
+        }
+        parser:option{
+            name = '--size',
+            description = 'Buffer size (MB)',
+            default = kDefaultSizeMb
+        }
+        parser:option{
+            name = '--max-depth',
+            description = 'Deepest chain of forks to measure (at most 32)',
+            default = kDefaultMaxDepth
+        }
+        parser:flag{
+            name = '--exit-early',
+            description = 'Have each generation exit once its child has its own object'
+        }
+        parser:flag{
+            name = '--verbose',
+            description = 'Enable verbose logging',
+        }
+    end
+}
+
+local unit = perfdata.unit.custom('ns')
+local variant = benchmark.opt.exit_early and 'exit-early' or 'keep-parents'
+
+local args = {benchmark.opt.path}
+if benchmark.opt.exit_early then
+    table.insert(args, "-x")
+end
+if benchmark.opt.verbose then
+    table.insert(args, "-v")
+end
+table.insert(args, benchmark.opt.iterations)
+table.insert(args, benchmark.opt.size)
+table.insert(args, benchmark.opt.max_depth)
+args.echo = true
+local deepest = 1
+while deepest * 2 <= tonumber(benchmark.opt.max_depth) do
+    deepest = deepest * 2
+end
+for out in benchmark:run(args) do
+    local result = out:match("-----Results-----\n(.*)")
+    benchmark:assert(result, "Unable to find result data in output")
+    local data = csv.openstring(result, {header = true})
+    for field in data:lines() do
+        for k, v in pairs(field) do
+            benchmark.writer:add_value(k, unit, tonumber(v), {
+              [perfdata.larger_better] = false,
+              variant = variant
+            })
+        end
+    end
+end
+benchmark.writer:set_primary_metric("Fault latency at depth " .. deepest .. " (ns)")
+
+benchmark:finish()
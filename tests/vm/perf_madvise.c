@@ -1,6 +1,13 @@
 /*
  * Madvise benchmark.
- * Currently only times various types of madvise frees.
+ * Times various types of madvise frees, and how long it takes to get
+ * back to memory that was compressed (resume latency).
+ *
+ * The resume variants compress the buffer with MADV_PAGEOUT, which needs
+ * a DEVELOPMENT or DEBUG kernel, and time reading it back in order,
+ * RESUME_WILLNEED after an madvise(MADV_WILLNEED) of the whole buffer.
+ * -n turns off vm.compressor_prefetch for the run (needs root); the
+ * previous setting is restored on exit.
  */
 
 #include <assert.h>
@@ -8,14 +15,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include <mach/mach.h>
 #include <sys/mman.h>
 #include <sys/sysctl.h>
 
 #include "benchmark/helpers.h"
 
 typedef enum test_variant {
-	VARIANT_MADVISE_FREE
+	VARIANT_MADVISE_FREE,
+	VARIANT_RESUME,
+	VARIANT_RESUME_WILLNEED
 } test_variant_t;
 
 /* Arguments parsed from the command line */
@@ -23,12 +34,14 @@ typedef struct test_args {
 	uint64_t ta_duration_seconds;
 	uint64_t ta_size;
 	test_variant_t ta_variant;
+	bool ta_no_prefetch;
 	bool ta_verbose;
 } test_args_t;
 
 static void print_help(char **argv);
 static void parse_arguments(int argc, char** argv, test_args_t *args);
 static double madvise_free_test(const test_args_t* args);
+static double resume_test(const test_args_t* args);
 /*
  * Allocate a buffer of the given size and fault in all of its pages.
  */
@@ -37,16 +50,36 @@ static void *allocate_and_init_buffer(uint64_t size);
  * Fault in the pages in the given buffer.
  */
 static void fault_pages(unsigned char *buffer, size_t size, size_t stride);
+/*
+ * Write to every page of the buffer, with contents that don't compress
+ * to nothing.
+ */
+static void dirty_pages(unsigned char *buffer, size_t size);
+/*
+ * Wait until at least "size" bytes of the task are compressed.
+ */
+static void wait_for_compressed(uint64_t size, bool verbose);
+static void set_prefetch(int enabled);
+static void restore_prefetch(void);
 /*
  * Output the results of the test in pages / CPU second.
  */
 static void output_throughput(double throughput);
+/*
+ * Output the average resume latency in seconds.
+ */
+static void output_latency(double seconds);
 
 /* Test Variants */
 static const char* kMadviseFreeArgument = "MADV_FREE";
+static const char* kResumeArgument = "RESUME";
+static const char* kResumeWillneedArgument = "RESUME_WILLNEED";
 /* The VM page size */
 static size_t kPageSize = 0;
 static const clockid_t kThreadCPUTimeClock = CLOCK_THREAD_CPUTIME_ID;
+/* How long to wait for the pageout of the buffer to complete */
+static const uint64_t kCompressTimeoutSeconds = 30;
+static int saved_prefetch = -1;
 
 int
 main(int argc, char** argv)
@@ -54,8 +87,15 @@ main(int argc, char** argv)
 	test_args_t args;
 	parse_arguments(argc, argv, &args);
 	double throughput = 0.0;
+	if (args.ta_no_prefetch) {
+		set_prefetch(0);
+	}
 	if (args.ta_variant == VARIANT_MADVISE_FREE) {
 		throughput = madvise_free_test(&args);
+	} else if (args.ta_variant == VARIANT_RESUME ||
+	    args.ta_variant == VARIANT_RESUME_WILLNEED) {
+		output_latency(resume_test(&args));
+		return 0;
 	} else {
 		fprintf(stderr, "Unknown test variant\n");
 		exit(2);
@@ -99,6 +139,98 @@ madvise_free_test(const test_args_t* args)
 	return throughput;
 }
 
+static double
+resume_test(const test_args_t* args)
+{
+	int ret;
+	benchmark_log(args->ta_verbose, "Running resume test\n");
+	uint64_t time_elapsed_ns = 0, start, end;
+	size_t count = 0;
+
+	while (time_elapsed_ns < args->ta_duration_seconds * kNumNanosecondsInSecond) {
+		benchmark_log(args->ta_verbose, "Starting iteration %zu\n", count + 1);
+		unsigned char *buffer = allocate_and_init_buffer(args->ta_size);
+		dirty_pages(buffer, args->ta_size);
+
+		ret = madvise(buffer, args->ta_size, MADV_PAGEOUT);
+		if (ret != 0) {
+			fprintf(stderr, "madvise(MADV_PAGEOUT) failed: %s\n", strerror(errno));
+			fprintf(stderr, "The resume variants need a DEVELOPMENT or DEBUG kernel.\n");
+			exit(1);
+		}
+		wait_for_compressed(args->ta_size, args->ta_verbose);
+
+		/* Wall time: the decompression may happen on other threads. */
+		start = current_timestamp_ns();
+		if (args->ta_variant == VARIANT_RESUME_WILLNEED) {
+			ret = madvise(buffer, args->ta_size, MADV_WILLNEED);
+			assert(ret == 0);
+		}
+		fault_pages(buffer, args->ta_size, kPageSize);
+		end = current_timestamp_ns();
+		time_elapsed_ns += end - start;
+
+		ret = munmap(buffer, args->ta_size);
+		assert(ret == 0);
+		benchmark_log(args->ta_verbose, "Completed iteration %zu\nMeasured %llu ns so far.\n", count + 1, time_elapsed_ns);
+
+		count++;
+	}
+	return (double)time_elapsed_ns / count / kNumNanosecondsInSecond;
+}
+
+static void
+dirty_pages(unsigned char *buffer, size_t size)
+{
+	uint64_t *words = (uint64_t *)buffer;
+	for (size_t i = 0; i < size / sizeof(*words); i++) {
+		words[i] = i * 0x9e3779b97f4a7c15ULL;
+	}
+}
+
+static void
+wait_for_compressed(uint64_t size, bool verbose)
+{
+	task_vm_info_data_t info;
+	mach_msg_type_number_t count;
+	kern_return_t kr;
+
+	for (uint64_t waited_ms = 0; waited_ms < kCompressTimeoutSeconds * 1000; waited_ms += 10) {
+		count = TASK_VM_INFO_COUNT;
+		kr = task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count);
+		assert(kr == KERN_SUCCESS);
+		if (info.compressed >= size) {
+			benchmark_log(verbose, "Buffer compressed after %llu ms\n", waited_ms);
+			return;
+		}
+		usleep(10 * 1000);
+	}
+	fprintf(stderr, "Timed out waiting for the buffer to be compressed\n");
+	exit(1);
+}
+
+static void
+set_prefetch(int enabled)
+{
+	int old;
+	size_t size = sizeof(old);
+
+	if (sysctlbyname("vm.compressor_prefetch", &old, &size, &enabled, sizeof(enabled)) != 0) {
+		fprintf(stderr, "Unable to set vm.compressor_prefetch: %s\n", strerror(errno));
+		exit(1);
+	}
+	saved_prefetch = old;
+	atexit(restore_prefetch);
+}
+
+static void
+restore_prefetch(void)
+{
+	if (saved_prefetch >= 0) {
+		sysctlbyname("vm.compressor_prefetch", NULL, NULL, &saved_prefetch, sizeof(saved_prefetch));
+	}
+}
+
 static void *
 allocate_and_init_buffer(uint64_t size)
 {
@@ -136,6 +268,8 @@ parse_arguments(int argc, char** argv, test_args_t *args)
 		if (argv[current_argument][0] == '-') {
 			if (strcmp(argv[current_argument], "-v") == 0) {
 				args->ta_verbose = true;
+			} else if (strcmp(argv[current_argument], "-n") == 0) {
+				args->ta_no_prefetch = true;
 			} else {
 				fprintf(stderr, "Unknown argument %s\n", argv[current_argument]);
 				print_help(argv);
@@ -149,6 +283,10 @@ parse_arguments(int argc, char** argv, test_args_t *args)
 			if (current_positional_argument == 0) {
 				if (strcasecmp(argv[current_argument], kMadviseFreeArgument) == 0) {
 					args->ta_variant = VARIANT_MADVISE_FREE;
+				} else if (strcasecmp(argv[current_argument], kResumeArgument) == 0) {
+					args->ta_variant = VARIANT_RESUME;
+				} else if (strcasecmp(argv[current_argument], kResumeWillneedArgument) == 0) {
+					args->ta_variant = VARIANT_RESUME_WILLNEED;
 				} else {
 					print_help(argv);
 					exit(1);
@@ -186,9 +324,12 @@ parse_arguments(int argc, char** argv, test_args_t *args)
 static void
 print_help(char** argv)
 {
-	fprintf(stderr, "%s: <test-variant> [-v] duration_seconds size_mb\n", argv[0]);
+	fprintf(stderr, "%s: <test-variant> [-v] [-n] duration_seconds size_mb\n", argv[0]);
 	fprintf(stderr, "\ntest variants:\n");
 	fprintf(stderr, "	%s	Measure MADV_FREE time.\n", kMadviseFreeArgument);
+	fprintf(stderr, "	%s	Measure the time to read back a compressed buffer.\n", kResumeArgument);
+	fprintf(stderr, "	%s	Same, after madvise(MADV_WILLNEED) of the buffer.\n", kResumeWillneedArgument);
+	fprintf(stderr, "\n	-n	Turn compressor prefetch off for the run (needs root).\n");
 }
 
 static void
@@ -198,3 +339,11 @@ output_throughput(double throughput)
 	printf("Throughput (bytes / CPU second)\n");
 	printf("%f\n", throughput);
 }
+
+static void
+output_latency(double seconds)
+{
+	printf("-----Results-----\n");
+	printf("Resume latency (seconds)\n");
+	printf("%f\n", seconds);
+}
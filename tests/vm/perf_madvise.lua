@@ -25,9 +25,13 @@ local benchmark = benchrun.new {
         }
         parser:option{
             name = '--variant',
-            description = 'Which benchmark variant to run (MADV_FREE)',
+            description = 'Which benchmark variant to run (MADV_FREE, RESUME, RESUME_WILLNEED)',
             default = 'MADV_FREE',
-            choices = {"MADV_FREE"}
+            choices = {"MADV_FREE", "RESUME", "RESUME_WILLNEED"}
+        }
+        parser:flag{
+            name = '--no-prefetch',
+            description = 'Turn compressor prefetch off for the resume variants (needs root)'
         }
         parser:option{
             name = '--verbose',
@@ -41,7 +45,13 @@ local benchmark = benchrun.new {
     end
 }
 
-local unit = perfdata.unit.custom('pages/sec')
+local resume = benchmark.opt.variant ~= 'MADV_FREE'
+local unit = resume and perfdata.unit.custom('seconds') or perfdata.unit.custom('pages/sec')
+local metric = resume and "Resume latency (seconds)" or "Throughput (bytes / CPU second)"
+local variant = benchmark.opt.variant
+if benchmark.opt.no_prefetch then
+    variant = variant .. '-no-prefetch'
+end
 local tests = {
     path = benchmark.opt.path,
 }
@@ -50,6 +60,9 @@ local args = {benchmark.opt.path, benchmark.opt.variant, benchmark.opt.duration,
 if benchmark.opt.verbose then
     table.insert(args, "-v")
 end
+if benchmark.opt.no_prefetch then
+    table.insert(args, "-n")
+end
 args.echo = true
 for out in benchmark:run(args) do
     local result = out:match("-----Results-----\n(.*)")
@@ -58,12 +71,12 @@ for out in benchmark:run(args) do
     for field in data:lines() do
         for k, v in pairs(field) do
             benchmark.writer:add_value(k, unit, tonumber(v), {
-              [perfdata.larger_better] = true,
-              variant = benchmark.opt.variant
+              [perfdata.larger_better] = not resume,
+              variant = variant
             })
         end
     end
 end
-benchmark.writer:set_primary_metric("Throughput (bytes / CPU second)")
+benchmark.writer:set_primary_metric(metric)
 
 benchmark:finish()
@@ -0,0 +1,326 @@
+/*
+ * Refault replay benchmark.
+ *
+ * Replays a trace of page accesses against an anonymous region and a
+ * file mapping, and reports how long the replay took along with the
+ * working set refaults the kernel counted for each kind of memory
+ * while it ran (vm.workingset_refault_file, vm.workingset_refault_anon).
+ *
+ * A trace is a text file with one access per line:
+ *
+ *	a <page>	write to page <page> of the anonymous region
+ *	f <page>	read page <page> of the file
+ *
+ * The regions are sized to fit the largest page numbers in the trace.
+ * Without -t, a synthetic trace is replayed instead: each pass writes a
+ * hot anonymous set, reads a hot file set and then streams through a
+ * cold part of the file once, which is the kind of mix that makes the
+ * pageout daemon evict the file cache and compress anonymous memory in
+ * turn.  The sizes only cause refaults if together they exceed the
+ * memory available to the benchmark.
+ *
+ * Running this benchmark directly is not recommended.
+ * Use perf_refault_replay.lua which provides a nicer interface and
+ * outputs perfdata.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/sysctl.h>
+
+#include "benchmark/helpers.h"
+
+typedef enum access_kind {
+	ACCESS_ANON,
+	ACCESS_FILE
+} access_kind_t;
+
+typedef struct trace_access {
+	access_kind_t tr_kind;
+	uint64_t tr_page;
+} trace_access_t;
+
+typedef struct trace {
+	trace_access_t *t_accesses;
+	size_t t_count;
+	size_t t_capacity;
+	uint64_t t_anon_pages;
+	uint64_t t_file_pages;
+} trace_t;
+
+/* Arguments parsed from the command line */
+typedef struct test_args {
+	const char *ta_trace_path;
+	uint64_t ta_passes;
+	uint64_t ta_anon_size;
+	uint64_t ta_file_size;
+	uint64_t ta_stream_size;
+	bool ta_verbose;
+} test_args_t;
+
+static void print_help(char **argv);
+static void parse_arguments(int argc, char** argv, test_args_t *args);
+static void trace_append(trace_t *trace, access_kind_t kind, uint64_t page);
+static void load_trace(const char *path, trace_t *trace);
+static void generate_trace(const test_args_t *args, trace_t *trace);
+/*
+ * Create a file of the given number of pages in the temporary
+ * directory, unlinked, and map it.
+ */
+static unsigned char *map_file(uint64_t pages);
+static double replay(const trace_t *trace, unsigned char *anon, unsigned char *file);
+static uint64_t read_counter(const char *name);
+static void output_results(double seconds, uint64_t file_refaults, uint64_t anon_refaults);
+
+static size_t kPageSize = 0;
+
+int
+main(int argc, char** argv)
+{
+	test_args_t args;
+	trace_t trace = {};
+	unsigned char *anon, *file;
+	uint64_t file_before, anon_before;
+	size_t pagesize_size = sizeof(kPageSize);
+	double seconds;
+	int ret;
+
+	parse_arguments(argc, argv, &args);
+	ret = sysctlbyname("vm.pagesize", &kPageSize, &pagesize_size, NULL, 0);
+	assert(ret == 0);
+	assert(kPageSize > 0);
+
+	if (args.ta_trace_path != NULL) {
+		load_trace(args.ta_trace_path, &trace);
+	} else {
+		generate_trace(&args, &trace);
+	}
+	benchmark_log(args.ta_verbose, "Replaying %zu accesses over %llu anonymous and %llu file pages\n",
+	    trace.t_count, trace.t_anon_pages, trace.t_file_pages);
+
+	anon = trace.t_anon_pages ? mmap_buffer(trace.t_anon_pages * kPageSize) : NULL;
+	file = trace.t_file_pages ? map_file(trace.t_file_pages) : NULL;
+
+	file_before = read_counter("vm.workingset_refault_file");
+	anon_before = read_counter("vm.workingset_refault_anon");
+	seconds = replay(&trace, anon, file);
+	output_results(seconds,
+	    read_counter("vm.workingset_refault_file") - file_before,
+	    read_counter("vm.workingset_refault_anon") - anon_before);
+
+	free(trace.t_accesses);
+	return 0;
+}
+
+static void
+trace_append(trace_t *trace, access_kind_t kind, uint64_t page)
+{
+	if (trace->t_count == trace->t_capacity) {
+		trace->t_capacity = trace->t_capacity ? trace->t_capacity * 2 : 4096;
+		trace->t_accesses = realloc(trace->t_accesses, trace->t_capacity * sizeof(trace_access_t));
+		assert(trace->t_accesses != NULL);
+	}
+	trace->t_accesses[trace->t_count].tr_kind = kind;
+	trace->t_accesses[trace->t_count].tr_page = page;
+	trace->t_count++;
+
+	if (kind == ACCESS_ANON && page >= trace->t_anon_pages) {
+		trace->t_anon_pages = page + 1;
+	} else if (kind == ACCESS_FILE && page >= trace->t_file_pages) {
+		trace->t_file_pages = page + 1;
+	}
+}
+
+static void
+load_trace(const char *path, trace_t *trace)
+{
+	FILE *f;
+	char kind;
+	unsigned long long page;
+	int matched;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	while ((matched = fscanf(f, " %c %llu", &kind, &page)) == 2) {
+		if (kind == 'a') {
+			trace_append(trace, ACCESS_ANON, page);
+		} else if (kind == 'f') {
+			trace_append(trace, ACCESS_FILE, page);
+		} else {
+			fprintf(stderr, "%s: unknown access kind '%c'\n", path, kind);
+			exit(1);
+		}
+	}
+	if (matched != EOF) {
+		fprintf(stderr, "%s: malformed line after %zu accesses\n", path, trace->t_count);
+		exit(1);
+	}
+	fclose(f);
+}
+
+static void
+generate_trace(const test_args_t *args, trace_t *trace)
+{
+	uint64_t anon_pages = args->ta_anon_size / kPageSize;
+	uint64_t file_pages = args->ta_file_size / kPageSize;
+	uint64_t stream_pages = args->ta_stream_size / kPageSize;
+
+	for (uint64_t pass = 0; pass < args->ta_passes; pass++) {
+		for (uint64_t page = 0; page < anon_pages; page++) {
+			trace_append(trace, ACCESS_ANON, page);
+		}
+		for (uint64_t page = 0; page < file_pages; page++) {
+			trace_append(trace, ACCESS_FILE, page);
+		}
+		/* the cold part of the file follows the hot one */
+		for (uint64_t page = 0; page < stream_pages; page++) {
+			trace_append(trace, ACCESS_FILE, file_pages + page);
+		}
+	}
+}
+
+static unsigned char *
+map_file(uint64_t pages)
+{
+	char path[] = "/tmp/perf_refault_replay.XXXXXX";
+	unsigned char *page_buffer, *mapping;
+	int fd, ret;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to create %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	ret = unlink(path);
+	assert(ret == 0);
+
+	page_buffer = malloc(kPageSize);
+	assert(page_buffer != NULL);
+	for (uint64_t page = 0; page < pages; page++) {
+		/* no two pages alike */
+		memset(page_buffer, (int)(page & 0xff) | 1, kPageSize);
+		memcpy(page_buffer, &page, sizeof(page));
+		if (write(fd, page_buffer, kPageSize) != (ssize_t)kPageSize) {
+			fprintf(stderr, "Unable to write the test file: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+	free(page_buffer);
+	ret = fsync(fd);
+	assert(ret == 0);
+
+	mapping = mmap(NULL, pages * kPageSize, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED) {
+		fprintf(stderr, "Unable to map the test file: %s\n", strerror(errno));
+		exit(1);
+	}
+	close(fd);
+	return mapping;
+}
+
+static double
+replay(const trace_t *trace, unsigned char *anon, unsigned char *file)
+{
+	volatile unsigned char val;
+	uint64_t start, end;
+
+	start = current_timestamp_ns();
+	for (size_t i = 0; i < trace->t_count; i++) {
+		const trace_access_t *access = &trace->t_accesses[i];
+		if (access->tr_kind == ACCESS_ANON) {
+			anon[access->tr_page * kPageSize] = (unsigned char)(i | 1);
+		} else {
+			val = file[access->tr_page * kPageSize];
+		}
+	}
+	end = current_timestamp_ns();
+	(void)val;
+	return (double)(end - start) / kNumNanosecondsInSecond;
+}
+
+static uint64_t
+read_counter(const char *name)
+{
+	uint64_t value = 0;
+	size_t size = sizeof(value);
+
+	if (sysctlbyname(name, &value, &size, NULL, 0) != 0) {
+		return 0;
+	}
+	return value;
+}
+
+static void
+parse_arguments(int argc, char** argv, test_args_t *args)
+{
+	int current_positional_argument = 0;
+	long values[4] = {-1, -1, -1, -1};
+	memset(args, 0, sizeof(test_args_t));
+	for (int current_argument = 1; current_argument < argc; current_argument++) {
+		if (argv[current_argument][0] == '-') {
+			if (strcmp(argv[current_argument], "-v") == 0) {
+				args->ta_verbose = true;
+			} else if (strcmp(argv[current_argument], "-t") == 0 && current_argument + 1 < argc) {
+				args->ta_trace_path = argv[++current_argument];
+			} else {
+				fprintf(stderr, "Unknown argument %s\n", argv[current_argument]);
+				print_help(argv);
+				exit(1);
+			}
+		} else if (current_positional_argument < 4) {
+			values[current_positional_argument] = strtol(argv[current_argument], NULL, 10);
+			if (values[current_positional_argument] < 0) {
+				print_help(argv);
+				exit(1);
+			}
+			current_positional_argument++;
+		} else {
+			print_help(argv);
+			exit(1);
+		}
+	}
+	if (args->ta_trace_path != NULL) {
+		if (current_positional_argument != 0) {
+			fprintf(stderr, "No positional arguments are expected with a trace.\n");
+			print_help(argv);
+			exit(1);
+		}
+		return;
+	}
+	if (current_positional_argument != 4 || values[0] == 0) {
+		fprintf(stderr, "Expected 4 positional arguments. %d were supplied.\n", current_positional_argument);
+		print_help(argv);
+		exit(1);
+	}
+	args->ta_passes = (uint64_t) values[0];
+	args->ta_anon_size = ((uint64_t) values[1] * (1UL << 20));
+	args->ta_file_size = ((uint64_t) values[2] * (1UL << 20));
+	args->ta_stream_size = ((uint64_t) values[3] * (1UL << 20));
+}
+
+static void
+print_help(char** argv)
+{
+	fprintf(stderr, "%s: [-v] passes anon_mb file_mb stream_mb\n", argv[0]);
+	fprintf(stderr, "%s: [-v] -t trace\n", argv[0]);
+	fprintf(stderr, "\n	-t	Replay the accesses in <trace> (lines of \"a <page>\" or \"f <page>\").\n");
+}
+
+static void
+output_results(double seconds, uint64_t file_refaults, uint64_t anon_refaults)
+{
+	printf("-----Results-----\n");
+	printf("Replay time (seconds),Working set refaults (file),Working set refaults (anon)\n");
+	printf("%f,%llu,%llu\n", seconds, file_refaults, anon_refaults);
+}
@@ -0,0 +1,85 @@
+#!/usr/local/bin/recon
+
+local benchrun = require 'benchrun'
+local perfdata = require 'perfdata'
+local csv = require 'csv'
+
+require 'strict'
+
+local kDefaultPasses = 4
+local kDefaultAnonMb = 1024
+local kDefaultFileMb = 1024
+local kDefaultStreamMb = 2048
+
+local benchmark = benchrun.new {
+    name = 'xnu.refault_replay',
+    version = 1,
+    arg = arg,
+    modify_argparser = function(parser)
+        parser:argument {
+          name = 'path',
+          description = 'Path to perf_refault_replay binary'
+        }
+        parser:option{
+          name = '--trace',
+          description = 'Trace of accesses to replay instead of the synthetic one'
+        }
+        parser:option{
+          name = '--passes',
+          description = 'How many passes of the synthetic trace to replay',
+          default = kDefaultPasses
+        }
+        parser:option{
+            name = '--anon-size',
+            description = 'Hot anonymous set of the synthetic trace (MB)',
+            default = kDefaultAnonMb
+        }
+        parser:option{
+            name = '--file-size',
+            description = 'Hot file set of the synthetic trace (MB)',
+            default = kDefaultFileMb
+        }
+        parser:option{
+            name = '--stream-size',
+            description = 'Cold file data streamed once per pass (MB)',
+            default = kDefaultStreamMb
+        }
+        parser:flag{
+            name = '--verbose',
+            description = 'Enable verbose logging',
+        }
+    end
+}
+
+local time_metric = "Replay time (seconds)"
+
+local args = {benchmark.opt.path}
+if benchmark.opt.verbose then
+    table.insert(args, "-v")
+end
+if benchmark.opt.trace then
+    table.insert(args, "-t")
+    table.insert(args, benchmark.opt.trace)
+else
+    table.insert(args, benchmark.opt.passes)
+    table.insert(args, benchmark.opt.anon_size)
+    table.insert(args, benchmark.opt.file_size)
+    table.insert(args, benchmark.opt.stream_size)
+end
+args.echo = true
+for out in benchmark:run(args) do
+    local result = out:match("-----Results-----\n(.*)")
+    benchmark:assert(result, "Unable to find result data in output")
+    local data = csv.openstring(result, {header = true})
+    for field in data:lines() do
+        for k, v in pairs(field) do
+            local unit = k == time_metric and perfdata.unit.custom('seconds') or perfdata.unit.custom('pages')
+            benchmark.writer:add_value(k, unit, tonumber(v), {
+              [perfdata.larger_better] = false
+            })
+        end
+    end
+end
+benchmark.writer:set_primary_metric(time_metric)
+
+benchmark:finish()
@@ -0,0 +1,285 @@
+/*
+ * Swap-in benchmark.
+ *
+ * Measures how fast a frozen process gets its memory back from swap,
+ * as a function of the swap-in read-ahead queue depth
+ * (vm.swapin_readahead_depth).  For each depth (0, 1, 2, 4, ... up to
+ * max_depth), the benchmark forks a child that fills a buffer, freezes
+ * it with kern.memorystatus_freeze so its compressed memory is written
+ * out to the swapfile, then has the child read one byte of every page
+ * of the buffer.  With a depth of 0 each swapped out segment is read by
+ * the fault that needs it; with a higher depth the segments that follow
+ * it in the swapfile are read ahead in parallel.
+ *
+ * This needs root, a kernel with the freezer enabled (vm.freeze_enabled)
+ * and swap.  The swapfiles go where vm.swapfileprefix points, so to
+ * measure a given device, set that to a path on it before the first
+ * swapfile gets created (e.g. from the boot-time sysctl.conf), and
+ * vm_swapout_queue_depth=<n> in the boot-args to size the swap-out side.
+ *
+ * Running this benchmark directly is not recommended.
+ * Use perf_swapin.lua which provides a nicer interface and
+ * outputs perfdata.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/sysctl.h>
+#include <sys/wait.h>
+
+#include "benchmark/helpers.h"
+
+/* Arguments parsed from the command line */
+typedef struct test_args {
+	uint64_t ta_iterations;
+	uint64_t ta_size;
+	unsigned int ta_max_depth;
+	bool ta_verbose;
+} test_args_t;
+
+static void print_help(char **argv);
+static void parse_arguments(int argc, char** argv, test_args_t *args);
+/*
+ * Freeze a child with a buffer of the given size and return how long
+ * it took the child to read it all back in, in nanoseconds.
+ */
+static uint64_t swapin_test(const test_args_t *args);
+/*
+ * Runs in the child.  Fills the buffer, writes a byte to ready_fd,
+ * waits for one on go_fd and writes the time it took to touch every
+ * page of the buffer to result_fd.
+ */
+static void run_child(const test_args_t *args, int ready_fd, int go_fd, int result_fd);
+static void set_readahead_depth(unsigned int depth);
+static void output_results(const test_args_t *args, const double *throughputs);
+
+/* how long we give the swapout thread to write the frozen segments */
+static const unsigned int kSwapoutSeconds = 5;
+static size_t kPageSize = 0;
+
+int
+main(int argc, char** argv)
+{
+	test_args_t args;
+	double throughputs[8];
+	size_t pagesize_size = sizeof(kPageSize);
+	unsigned int saved_depth, depth, i;
+	size_t depth_size = sizeof(saved_depth);
+	int freeze_enabled = 0;
+	size_t freeze_enabled_size = sizeof(freeze_enabled);
+	uint64_t total_ns;
+	int ret;
+
+	parse_arguments(argc, argv, &args);
+	ret = sysctlbyname("vm.pagesize", &kPageSize, &pagesize_size, NULL, 0);
+	assert(ret == 0);
+	assert(kPageSize > 0);
+
+	ret = sysctlbyname("vm.freeze_enabled", &freeze_enabled, &freeze_enabled_size, NULL, 0);
+	if (ret != 0 || !freeze_enabled) {
+		fprintf(stderr, "This benchmark needs the freezer (vm.freeze_enabled).\n");
+		exit(1);
+	}
+	ret = sysctlbyname("vm.swapin_readahead_depth", &saved_depth, &depth_size, NULL, 0);
+	if (ret != 0) {
+		fprintf(stderr, "vm.swapin_readahead_depth: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	for (depth = 0, i = 0; depth <= args.ta_max_depth; depth = depth ? depth * 2 : 1, i++) {
+		set_readahead_depth(depth);
+		total_ns = 0;
+		for (uint64_t j = 0; j < args.ta_iterations; j++) {
+			total_ns += swapin_test(&args);
+		}
+		/* MB read per second */
+		throughputs[i] = ((double)args.ta_size * args.ta_iterations / (1UL << 20)) /
+		    ((double)total_ns / kNumNanosecondsInSecond);
+		benchmark_log(args.ta_verbose, "Depth %u: %f MB/s\n", depth, throughputs[i]);
+	}
+	set_readahead_depth(saved_depth);
+	output_results(&args, throughputs);
+	return 0;
+}
+
+static void
+set_readahead_depth(unsigned int depth)
+{
+	int ret;
+
+	ret = sysctlbyname("vm.swapin_readahead_depth", NULL, NULL, &depth, sizeof(depth));
+	if (ret != 0) {
+		fprintf(stderr, "Unable to set vm.swapin_readahead_depth to %u: %s\n", depth, strerror(errno));
+		exit(1);
+	}
+}
+
+static uint64_t
+swapin_test(const test_args_t *args)
+{
+	int ready_pipe[2], go_pipe[2], result_pipe[2];
+	uint64_t elapsed;
+	char ready = 1;
+	pid_t pid;
+	int ret, status;
+
+	ret = pipe(ready_pipe);
+	assert(ret == 0);
+	ret = pipe(go_pipe);
+	assert(ret == 0);
+	ret = pipe(result_pipe);
+	assert(ret == 0);
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		close(ready_pipe[0]);
+		close(go_pipe[1]);
+		close(result_pipe[0]);
+		run_child(args, ready_pipe[1], go_pipe[0], result_pipe[1]);
+		_exit(0);
+	}
+	close(ready_pipe[1]);
+	close(go_pipe[0]);
+	close(result_pipe[1]);
+
+	if (read(ready_pipe[0], &ready, sizeof(ready)) != sizeof(ready)) {
+		fprintf(stderr, "Child didn't fill its buffer\n");
+		exit(1);
+	}
+	close(ready_pipe[0]);
+
+	benchmark_log(args->ta_verbose, "Freezing child pid %d\n", pid);
+	ret = sysctlbyname("kern.memorystatus_freeze", NULL, NULL, &pid, sizeof(pid));
+	if (ret != 0) {
+		fprintf(stderr, "kern.memorystatus_freeze failed: %s\n", strerror(errno));
+		kill(pid, SIGKILL);
+		exit(1);
+	}
+	sleep(kSwapoutSeconds);
+	ret = sysctlbyname("kern.memorystatus_thaw", NULL, NULL, &pid, sizeof(pid));
+	if (ret != 0) {
+		fprintf(stderr, "kern.memorystatus_thaw failed: %s\n", strerror(errno));
+		kill(pid, SIGKILL);
+		exit(1);
+	}
+
+	write(go_pipe[1], &ready, sizeof(ready));
+	close(go_pipe[1]);
+	if (read(result_pipe[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed)) {
+		fprintf(stderr, "No result from the child\n");
+		exit(1);
+	}
+	close(result_pipe[0]);
+	ret = waitpid(pid, &status, 0);
+	assert(ret == pid);
+	return elapsed;
+}
+
+static void
+run_child(const test_args_t *args, int ready_fd, int go_fd, int result_fd)
+{
+	volatile unsigned char val;
+	unsigned char *buffer;
+	uint64_t start, end, elapsed;
+	char go = 1;
+
+	/*
+	 * Half of each page is random, so that it compresses to about half
+	 * a page and the segments hold a realistic amount of data.
+	 */
+	buffer = mmap_buffer(args->ta_size);
+	for (size_t offset = 0; offset < args->ta_size; offset += sizeof(uint32_t)) {
+		if (offset % kPageSize < kPageSize / 2) {
+			*(uint32_t *)(buffer + offset) = arc4random();
+		}
+	}
+	write(ready_fd, &go, sizeof(go));
+	close(ready_fd);
+	if (read(go_fd, &go, sizeof(go)) != sizeof(go)) {
+		_exit(1);
+	}
+	close(go_fd);
+
+	start = current_timestamp_ns();
+	for (size_t offset = 0; offset < args->ta_size; offset += kPageSize) {
+		val = buffer[offset];
+	}
+	end = current_timestamp_ns();
+	(void)val;
+	elapsed = end - start;
+
+	write(result_fd, &elapsed, sizeof(elapsed));
+	close(result_fd);
+}
+
+static void
+parse_arguments(int argc, char** argv, test_args_t *args)
+{
+	int current_positional_argument = 0;
+	long values[3] = {-1, -1, -1};
+	memset(args, 0, sizeof(test_args_t));
+	for (int current_argument = 1; current_argument < argc; current_argument++) {
+		if (argv[current_argument][0] == '-') {
+			if (strcmp(argv[current_argument], "-v") == 0) {
+				args->ta_verbose = true;
+			} else {
+				fprintf(stderr, "Unknown argument %s\n", argv[current_argument]);
+				print_help(argv);
+				exit(1);
+			}
+		} else if (current_positional_argument < 3) {
+			values[current_positional_argument] = strtol(argv[current_argument], NULL, 10);
+			if (values[current_positional_argument] <= 0) {
+				print_help(argv);
+				exit(1);
+			}
+			current_positional_argument++;
+		} else {
+			print_help(argv);
+			exit(1);
+		}
+	}
+	if (current_positional_argument != 3) {
+		fprintf(stderr, "Expected 3 positional arguments. %d were supplied.\n", current_positional_argument);
+		print_help(argv);
+		exit(1);
+	}
+	if (values[2] > 16) {
+		fprintf(stderr, "max_depth can be at most 16.\n");
+		print_help(argv);
+		exit(1);
+	}
+	args->ta_iterations = (uint64_t) values[0];
+	args->ta_size = ((uint64_t) values[1] * (1UL << 20));
+	args->ta_max_depth = (unsigned int) values[2];
+}
+
+static void
+print_help(char** argv)
+{
+	fprintf(stderr, "%s: [-v] iterations size_mb max_depth\n", argv[0]);
+}
+
+static void
+output_results(const test_args_t *args, const double *throughputs)
+{
+	unsigned int depth, i;
+
+	printf("-----Results-----\n");
+	for (depth = 0; depth <= args->ta_max_depth; depth = depth ? depth * 2 : 1) {
+		printf("%sSwap-in MB/s at depth %u", depth == 0 ? "" : ",", depth);
+	}
+	printf("\n");
+	for (depth = 0, i = 0; depth <= args->ta_max_depth; depth = depth ? depth * 2 : 1, i++) {
+		printf("%s%f", depth == 0 ? "" : ",", throughputs[i]);
+	}
+	printf("\n");
+}
@@ -0,0 +1,72 @@
+#!/usr/local/bin/recon
+
+local benchrun = require 'benchrun'
+local perfdata = require 'perfdata'
+local csv = require 'csv'
+
+require 'strict'
+
+local kDefaultIterations = 3
+local kDefaultSizeMb = 128
+local kDefaultMaxDepth = 16
+
+local benchmark = benchrun.new {
+    name = 'xnu.swapin',
+    version = 1,
+    arg = arg,
+    modify_argparser = function(parser)
+        parser:argument {
+          name = 'path',
+          description = 'Path to perf_swapin binary'
+        }
+        parser:option{
+          name = '--iterations',
+          description = 'How many times to freeze and read back the buffer at each depth',
+          default = kDefaultIterations
+        }
+        parser:option{
+            name = '--size',
+            description = 'Buffer size (MB)',
+            default = kDefaultSizeMb
+        }
+        parser:option{
+            name = '--max-depth',
+            description = 'Largest swap-in read-ahead depth to measure (at most 16)',
+            default = kDefaultMaxDepth
+        }
+        parser:flag{
+            name = '--verbose',
+            description = 'Enable verbose logging',
+        }
+    end
+}
+
+local unit = perfdata.unit.custom('MB/s')
+
+local args = {benchmark.opt.path}
+if benchmark.opt.verbose then
+    table.insert(args, "-v")
+end
+table.insert(args, benchmark.opt.iterations)
+table.insert(args, benchmark.opt.size)
+table.insert(args, benchmark.opt.max_depth)
+args.echo = true
+local deepest = 1
+while deepest * 2 <= tonumber(benchmark.opt.max_depth) do
+    deepest = deepest * 2
+end
+for out in benchmark:run(args) do
+    local result = out:match("-----Results-----\n(.*)")
+    benchmark:assert(result, "Unable to find result data in output")
+    local data = csv.openstring(result, {header = true})
+    for field in data:lines() do
+        for k, v in pairs(field) do
+            benchmark.writer:add_value(k, unit, tonumber(v), {
+              [perfdata.larger_better] = true
+            })
+        end
+    end
+end
+benchmark.writer:set_primary_metric("Swap-in MB/s at depth " .. deepest)
+
+benchmark:finish()
@@ -0,0 +1,262 @@
+/*
+ * TLB-sensitive random access benchmark.
+ *
+ * Allocates a large anonymous buffer, faults it in, and then walks a
+ * random cyclic permutation of its pages, touching one cache line in
+ * each.  Every access goes to a different page than the last, so the
+ * walk mostly misses in the TLB unless the buffer is mapped with 2MB
+ * superpages (vm.superpage on x86_64).
+ *
+ * Throughput is reported as accesses / CPU second.
+ *
+ * -n turns transparent superpages off system wide (vm.superpage) for the
+ * run, which needs root; the previous setting is restored on exit.
+ * -w waits this many seconds after faulting the buffer in, to give the
+ * superpage scanner time to promote it.
+ *
+ * Running this benchmark directly is not recommended.
+ * Use perf_tlb_random_access.lua which provides a nicer interface and
+ * outputs perfdata.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/sysctl.h>
+
+#include "benchmark/helpers.h"
+
+/* Arguments parsed from the command line */
+typedef struct test_args {
+	uint64_t ta_duration_seconds;
+	uint64_t ta_size;
+	uint64_t ta_wait_seconds;
+	bool ta_no_superpages;
+	bool ta_verbose;
+} test_args_t;
+
+static void print_help(char **argv);
+static void parse_arguments(int argc, char** argv, test_args_t *args);
+static double random_access_test(const test_args_t *args);
+/*
+ * Link the pages of the buffer into one random cycle: the first word of
+ * each page holds the offset of the next page to visit.
+ */
+static void build_cycle(unsigned char *buffer, size_t npages);
+static uint64_t read_superpage_stat(const char *name);
+static void set_superpages(int enabled);
+static void restore_superpages(void);
+static void output_throughput(double throughput);
+
+static const size_t kSuperpageSize = 2UL << 20;
+/* accesses between two looks at the clock */
+static const uint64_t kAccessesPerRound = 1UL << 20;
+static size_t kPageSize = 0;
+static const clockid_t kThreadCPUTimeClock = CLOCK_THREAD_CPUTIME_ID;
+static int saved_superpage_setting = -1;
+
+int
+main(int argc, char** argv)
+{
+	test_args_t args;
+	parse_arguments(argc, argv, &args);
+	if (args.ta_no_superpages) {
+		set_superpages(0);
+	}
+	output_throughput(random_access_test(&args));
+	return 0;
+}
+
+static double
+random_access_test(const test_args_t *args)
+{
+	size_t pagesize_size = sizeof(kPageSize);
+	unsigned char *region, *buffer;
+	uint64_t promoted, time_elapsed_us = 0, count = 0;
+	size_t npages, offset = 0;
+	struct timespec start_time, end_time;
+	int ret;
+
+	ret = sysctlbyname("vm.pagesize", &kPageSize, &pagesize_size, NULL, 0);
+	assert(ret == 0);
+	assert(kPageSize > 0);
+
+	/* align the buffer so that all of it can be mapped with superpages */
+	region = mmap_buffer(args->ta_size + kSuperpageSize);
+	buffer = (unsigned char *)(((uintptr_t)region + kSuperpageSize - 1) &
+	    ~(kSuperpageSize - 1));
+	npages = args->ta_size / kPageSize;
+
+	promoted = read_superpage_stat("vm.superpage_promoted");
+	build_cycle(buffer, npages);
+	if (args->ta_wait_seconds) {
+		sleep((unsigned int)args->ta_wait_seconds);
+	}
+	benchmark_log(args->ta_verbose, "Faulted in %zu pages, %llu blocks promoted\n",
+	    npages, read_superpage_stat("vm.superpage_promoted") - promoted);
+
+	while (time_elapsed_us < args->ta_duration_seconds * kNumMicrosecondsInSecond) {
+		ret = clock_gettime(kThreadCPUTimeClock, &start_time);
+		assert(ret == 0);
+		for (uint64_t i = 0; i < kAccessesPerRound; i++) {
+			offset = *(volatile size_t *)(buffer + offset);
+		}
+		ret = clock_gettime(kThreadCPUTimeClock, &end_time);
+		assert(ret == 0);
+		time_elapsed_us += timespec_difference_us(&end_time, &start_time);
+		count += kAccessesPerRound;
+	}
+	benchmark_log(args->ta_verbose, "Made %llu accesses in %llu us\n",
+	    count, time_elapsed_us);
+
+	ret = munmap(region, args->ta_size + kSuperpageSize);
+	assert(ret == 0);
+	return count / ((double)time_elapsed_us / kNumMicrosecondsInSecond);
+}
+
+static void
+build_cycle(unsigned char *buffer, size_t npages)
+{
+	size_t *order, i, j, tmp, line;
+
+	order = malloc(npages * sizeof(*order));
+	assert(order != NULL);
+	for (i = 0; i < npages; i++) {
+		order[i] = i;
+	}
+	for (i = npages - 1; i > 0; i--) {
+		j = arc4random_uniform((uint32_t)(i + 1));
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	/*
+	 * Touch the pages in address order first, the way an application
+	 * initializing its heap would.  Then vary the cache line used in
+	 * each page so the walk doesn't keep hitting the same cache sets.
+	 */
+	for (i = 0; i < npages; i++) {
+		buffer[i * kPageSize] = 0;
+	}
+	for (i = 0; i < npages; i++) {
+		line = (order[i] * 64) % kPageSize;
+		*(size_t *)(buffer + order[i] * kPageSize + line) =
+		    order[(i + 1) % npages] * kPageSize +
+		    (order[(i + 1) % npages] * 64) % kPageSize;
+	}
+	/* page 0 uses line 0, so the walk can start at offset 0 */
+	free(order);
+}
+
+static uint64_t
+read_superpage_stat(const char *name)
+{
+	uint64_t value = 0;
+	size_t size = sizeof(value);
+
+	if (sysctlbyname(name, &value, &size, NULL, 0) != 0) {
+		/* not an x86_64 kernel */
+		return 0;
+	}
+	return value;
+}
+
+static void
+set_superpages(int enabled)
+{
+	int old;
+	size_t size = sizeof(old);
+
+	if (sysctlbyname("vm.superpage", &old, &size, &enabled, sizeof(enabled)) != 0) {
+		fprintf(stderr, "Unable to set vm.superpage: %s\n", strerror(errno));
+		exit(1);
+	}
+	saved_superpage_setting = old;
+	atexit(restore_superpages);
+}
+
+static void
+restore_superpages(void)
+{
+	if (saved_superpage_setting >= 0) {
+		sysctlbyname("vm.superpage", NULL, NULL, &saved_superpage_setting,
+		    sizeof(saved_superpage_setting));
+	}
+}
+
+static void
+parse_arguments(int argc, char** argv, test_args_t *args)
+{
+	int current_positional_argument = 0;
+	long duration = -1, size_mb = -1, wait = 0;
+	memset(args, 0, sizeof(test_args_t));
+	for (int current_argument = 1; current_argument < argc; current_argument++) {
+		if (argv[current_argument][0] == '-') {
+			if (strcmp(argv[current_argument], "-v") == 0) {
+				args->ta_verbose = true;
+			} else if (strcmp(argv[current_argument], "-n") == 0) {
+				args->ta_no_superpages = true;
+			} else if (strcmp(argv[current_argument], "-w") == 0 &&
+			    current_argument + 1 < argc) {
+				wait = strtol(argv[++current_argument], NULL, 10);
+				if (wait < 0) {
+					print_help(argv);
+					exit(1);
+				}
+			} else {
+				fprintf(stderr, "Unknown argument %s\n", argv[current_argument]);
+				print_help(argv);
+				exit(1);
+			}
+		} else {
+			if (current_positional_argument == 0) {
+				duration = strtol(argv[current_argument], NULL, 10);
+				if (duration <= 0) {
+					print_help(argv);
+					exit(1);
+				}
+				current_positional_argument++;
+			} else if (current_positional_argument == 1) {
+				size_mb = strtol(argv[current_argument], NULL, 10);
+				if (size_mb <= 0) {
+					print_help(argv);
+					exit(1);
+				}
+				current_positional_argument++;
+			} else {
+				print_help(argv);
+				exit(1);
+			}
+		}
+	}
+	if (current_positional_argument != 2) {
+		fprintf(stderr, "Expected 2 positional arguments. %d were supplied.\n", current_positional_argument);
+		print_help(argv);
+		exit(1);
+	}
+	args->ta_duration_seconds = (uint64_t) duration;
+	args->ta_size = ((uint64_t) size_mb * (1UL << 20));
+	args->ta_wait_seconds = (uint64_t) wait;
+}
+
+static void
+print_help(char** argv)
+{
+	fprintf(stderr, "%s: [-v] [-n] [-w wait_seconds] duration_seconds size_mb\n", argv[0]);
+	fprintf(stderr, "\n	-n	Turn transparent superpages off for the run (needs root).\n");
+	fprintf(stderr, "	-w	Seconds to wait for promotion before measuring.\n");
+}
+
+static void
+output_throughput(double throughput)
+{
+	printf("-----Results-----\n");
+	printf("Throughput (accesses / CPU second)\n");
+	printf("%f\n", throughput);
+}
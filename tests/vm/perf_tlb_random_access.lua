@@ -0,0 +1,76 @@
+#!/usr/local/bin/recon
+
+local benchrun = require 'benchrun'
+local perfdata = require 'perfdata'
+local csv = require 'csv'
+
+require 'strict'
+
+local kDefaultDuration = 15
+local kDefaultSizeMb = 1024
+local kDefaultWait = 2
+
+local benchmark = benchrun.new {
+    name = 'xnu.tlb_random_access',
+    version = 1,
+    arg = arg,
+    modify_argparser = function(parser)
+        parser:argument {
+          name = 'path',
+          description = 'Path to perf_tlb_random_access binary'
+        }
+        parser:option{
+          name = '--duration',
+          description = 'How long, in seconds, to run each iteration',
+          default = kDefaultDuration
+        }
+        parser:option{
+            name = '--size',
+            description = 'Buffer size (MB)',
+            default = kDefaultSizeMb
+        }
+        parser:option{
+            name = '--wait',
+            description = 'Seconds to wait for superpage promotion before measuring',
+            default = kDefaultWait
+        }
+        parser:flag{
+            name = '--no-superpages',
+            description = 'Turn transparent superpages off for the run (needs root)'
+        }
+        parser:flag{
+            name = '--verbose',
+            description = 'Enable verbose logging',
+        }
+    end
+}
+
+local unit = perfdata.unit.custom('accesses/sec')
+local variant = benchmark.opt.no_superpages and 'base-pages' or 'superpages'
+
+local args = {benchmark.opt.path, '-w', benchmark.opt.wait}
+if benchmark.opt.no_superpages then
+    table.insert(args, "-n")
+end
+if benchmark.opt.verbose then
+    table.insert(args, "-v")
+end
+table.insert(args, benchmark.opt.duration)
+table.insert(args, benchmark.opt.size)
+args.echo = true
+for out in benchmark:run(args) do
+    local result = out:match("-----Results-----\n(.*)")
+    benchmark:assert(result, "Unable to find result data in output")
+    local data = csv.openstring(result, {header = true})
+    for field in data:lines() do
+        for k, v in pairs(field) do
+            benchmark.writer:add_value(k, unit, tonumber(v), {
+              [perfdata.larger_better] = true,
+              variant = variant
+            })
+        end
+    end
+end
+benchmark.writer:set_primary_metric("Throughput (accesses / CPU second)")
+
+benchmark:finish()
@@ -1,3 +1,6 @@
+#include <mach/mach.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <sys/sysctl.h>
 #include <darwintest.h>
 #include <darwintest_utils.h>
@@ -13,3 +16,81 @@ T_DECL(basic_zone_test, "General zalloc test",
 	rc = sysctlbyname("kern.run_zone_test", &count, &s, &count, s);
 	T_ASSERT_POSIX_SUCCESS(rc, "run_zone_test");
 }
+
+#define kStressThreads  16
+#define kStressPorts    64
+#define kStressRounds   2000
+
+/*
+ * Allocates and frees bursts of ports as fast as possible, so that all
+ * the threads hammer the same zones (ipc ports, ipc entries, ...) and
+ * their magazines keep going back and forth through the depots.
+ */
+static void *
+zone_stress_thread(__unused void *arg)
+{
+	mach_port_t ports[kStressPorts];
+	kern_return_t kr;
+
+	for (int round = 0; round < kStressRounds; round++) {
+		for (int i = 0; i < kStressPorts; i++) {
+			kr = mach_port_allocate(mach_task_self(),
+			    MACH_PORT_RIGHT_RECEIVE, &ports[i]);
+			T_QUIET; T_ASSERT_MACH_SUCCESS(kr, "mach_port_allocate");
+		}
+		for (int i = 0; i < kStressPorts; i++) {
+			kr = mach_port_mod_refs(mach_task_self(), ports[i],
+			    MACH_PORT_RIGHT_RECEIVE, -1);
+			T_QUIET; T_ASSERT_MACH_SUCCESS(kr, "mach_port_mod_refs");
+		}
+	}
+	return NULL;
+}
+
+static void
+zone_stress_run(void)
+{
+	pthread_t threads[kStressThreads];
+	int rc;
+
+	for (int i = 0; i < kStressThreads; i++) {
+		rc = pthread_create(&threads[i], NULL, zone_stress_thread, NULL);
+		T_QUIET; T_ASSERT_POSIX_ZERO(rc, "pthread_create");
+	}
+	for (int i = 0; i < kStressThreads; i++) {
+		rc = pthread_join(threads[i], NULL);
+		T_QUIET; T_ASSERT_POSIX_ZERO(rc, "pthread_join");
+	}
+}
+
+T_DECL(zone_cache_stress, "Contended zalloc/zfree throughput",
+    T_META_NAMESPACE("xnu.vm"),
+    T_META_CHECK_LEAKS(false),
+    T_META_TAG_PERF)
+{
+	dt_stat_time_t s = dt_stat_time_create("burst_time");
+	size_t size = 0;
+	char *stats;
+	int rc;
+
+	while (!dt_stat_stable(s)) {
+		T_STAT_MEASURE(s) {
+			zone_stress_run();
+		}
+	}
+	dt_stat_finalize(s);
+
+	/* zprint-style counters are only there on development kernels */
+	rc = sysctlbyname("kern.zone_cache_stats", NULL, &size, NULL, 0);
+	if (rc != 0) {
+		T_SKIP("kern.zone_cache_stats not available");
+	}
+	/* leave room for the zones made in between */
+	size *= 2;
+	stats = malloc(size);
+	T_QUIET; T_ASSERT_NOTNULL(stats, "malloc");
+	rc = sysctlbyname("kern.zone_cache_stats", stats, &size, NULL, 0);
+	T_ASSERT_POSIX_SUCCESS(rc, "kern.zone_cache_stats");
+	T_LOG("%s", stats);
+	free(stats);
+}